@@ -0,0 +1,41 @@
+#ifndef ADPCM_CODEC_PLUGIN_H
+#define ADPCM_CODEC_PLUGIN_H
+/* ADPCMCodecPlugin.h include file */
+
+/* Imported from sqADPCMStreams.c. Mono ADPCM streams coded many at a
+   time, each exactly as primitiveDecodeMono and primitiveEncodeMono code
+   it. The fields are those of an ADPCMCodec, except that byteIndex and
+   sampleIndex count the bytes and samples already used, so they index
+   the arrays from 0. */
+#define ADPCM_MAX_INDEX 88
+
+typedef struct {
+	int bitsPerSample;
+	int deltaSignMask;
+	int deltaValueMask;
+	int deltaValueHighBit;
+	int frameSizeMask;
+	short *stepSizeTable;	/* ADPCM_MAX_INDEX + 1 entries */
+	short *indexTable;
+} ADPCMFormat;
+
+typedef struct {
+	int predicted;
+	int index;
+	int currentByte;
+	int bitPosition;
+	int byteIndex;
+	int sampleIndex;
+	unsigned char *encodedBytes;
+	short *samples;
+} ADPCMStream;
+
+/* Answer the number of bits that count samples take in a stream, frame
+   headers included */
+int adpcmStreamBits(ADPCMFormat *format, int count);
+
+/* Code count samples of each of streamCount streams of one format */
+void adpcmDecodeStreams(ADPCMFormat *format, ADPCMStream *streams, int streamCount, int count);
+void adpcmEncodeStreams(ADPCMFormat *format, ADPCMStream *streams, int streamCount, int count);
+
+#endif /* ADPCM_CODEC_PLUGIN_H */
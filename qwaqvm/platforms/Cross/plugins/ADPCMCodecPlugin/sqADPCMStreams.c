@@ -0,0 +1,399 @@
+/*
+ *  sqADPCMStreams.c
+ *  ADPCMCodecPlugin
+ *
+ *  Decoding and encoding of many independent mono ADPCM streams in one
+ *  call, for primitiveDecodeMonoStreams and primitiveEncodeMonoStreams.
+ *  Each stream comes out exactly as primitiveDecodeMono and
+ *  primitiveEncodeMono would code it on its own.
+ *
+ *  A stream is a serial chain: every sample's step size and prediction
+ *  depend on the one before. Streams of one format coded together for the
+ *  same number of samples start their frames on the same samples, though,
+ *  so they are coded four at a time, in lock step.
+ *
+ *  Decoding a sample of one of the usual formats, whose deltas are a sign
+ *  bit and 1 to 5 value bits, comes down to two table lookups: the
+ *  prediction delta and the next step index depend only on the current
+ *  step index and the delta's value bits, so both are tabulated for the
+ *  format on first use. Four streams are interleaved so that their chains
+ *  of lookups overlap. Encoding has to compare each difference with the
+ *  step size bit by bit; with SSE2 four streams do that together, one to
+ *  a lane, and only the bit packing and the table lookups are done lane by
+ *  lane. Everything else is coded one stream at a time, without branching
+ *  on the delta bits.
+ */
+
+#include <string.h>
+
+#include "ADPCMCodecPlugin.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define ADPCM_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#define HeaderSampleBits 16
+#define HeaderIndexBits 6
+#define HeaderMaxIndex 63
+
+#define isFrameStart(format, i) (((i) & (format)->frameSizeMask) == 1)
+
+#define MaxTableDeltas 32
+
+/* The prediction delta and next index of every step index and delta
+   value of the last format decoded, if it is a usual one */
+static struct {
+	short stepSizeTable[ADPCM_MAX_INDEX + 1];
+	short indexTable[MaxTableDeltas];
+	int deltaCount;
+	int predictedDelta[(ADPCM_MAX_INDEX + 1) * MaxTableDeltas];
+	unsigned char nextIndex[(ADPCM_MAX_INDEX + 1) * MaxTableDeltas];
+} tables;
+
+int
+adpcmStreamBits(ADPCMFormat *format, int count)
+{
+	int bits = 0, i;
+
+	for(i = 1; i <= count; i++)
+		bits += isFrameStart(format, i)
+			? HeaderSampleBits + HeaderIndexBits
+			: format->bitsPerSample;
+	return bits;
+}
+
+
+/*** Bit streams ***/
+
+/* Answer the next n bits, high bit first, as ADPCMCodec>>nextBits: does */
+static int
+nextBits(ADPCMStream *s, int n)
+{
+	int bits = s->bitPosition, buffer = s->currentByte, result;
+
+	while(bits < n) {
+		buffer = (buffer << 8) | s->encodedBytes[s->byteIndex++];
+		bits += 8;
+	}
+	result = buffer >> (bits - n);
+	s->bitPosition = bits - n;
+	s->currentByte = buffer & ((1 << s->bitPosition) - 1);
+	return result;
+}
+
+/* Append the n bits of buf, as ADPCMCodec>>nextBits:put: does */
+static void
+putBits(ADPCMStream *s, int buf, int n)
+{
+	for(;;) {
+		int available = 8 - s->bitPosition;
+		int shift = available - n;
+
+		if(shift >= 0) {
+			s->currentByte += buf << shift;
+			s->bitPosition += n;
+			return;
+		}
+		s->currentByte += (unsigned) buf >> -shift;
+		s->encodedBytes[s->byteIndex++] = (unsigned char) s->currentByte;
+		s->bitPosition = 0;
+		s->currentByte = 0;
+		buf &= (1 << -shift) - 1;
+		n -= available;
+	}
+}
+
+
+/*** Coding ***/
+
+static int
+clampSample(int sample)
+{
+	return sample > 32767 ? 32767 : (sample < -32768 ? -32768 : sample);
+}
+
+static int
+nextIndex(ADPCMFormat *format, int index, int delta)
+{
+	index += format->indexTable[delta];
+	return index < 0 ? 0 : (index > ADPCM_MAX_INDEX ? ADPCM_MAX_INDEX : index);
+}
+
+/* The index a frame header gives for a first difference of diff */
+static int
+headerIndex(ADPCMFormat *format, int diff)
+{
+	int j;
+
+	if(diff < 0) diff = 0 - diff;
+	for(j = 0; j < HeaderMaxIndex - 1; j++)
+		if(format->stepSizeTable[j] >= diff)
+			return j + 1;
+	return HeaderMaxIndex;
+}
+
+/* Read a frame header, answering its sample */
+static int
+decodeHeader(ADPCMStream *s)
+{
+	int predicted = nextBits(s, HeaderSampleBits);
+
+	if(predicted > 32767) predicted -= 65536;
+	s->index = nextBits(s, HeaderIndexBits);
+	return s->samples[s->sampleIndex++] = (short) predicted;
+}
+
+/* Write a frame header for the next sample, answering it */
+static int
+encodeHeader(ADPCMFormat *format, ADPCMStream *s, int isLast)
+{
+	int predicted = s->samples[s->sampleIndex++];
+
+	putBits(s, predicted < 0 ? predicted + 65536 : predicted, HeaderSampleBits);
+	if(!isLast)
+		s->index = headerIndex(format, s->samples[s->sampleIndex] - predicted);
+	putBits(s, s->index, HeaderIndexBits);
+	return predicted;
+}
+
+/* Make the tables for format if it is a usual one, answering whether it is */
+static int
+loadTables(ADPCMFormat *format)
+{
+	int highBit = format->deltaValueHighBit;
+	int index, value;
+
+	if(highBit < 1 || highBit > MaxTableDeltas / 2 || (highBit & (highBit - 1)) != 0
+	 || format->deltaValueMask != (2 * highBit) - 1 || format->deltaSignMask != 2 * highBit)
+		return 0;
+	if(tables.deltaCount == 2 * highBit
+	 && memcmp(tables.stepSizeTable, format->stepSizeTable, sizeof(tables.stepSizeTable)) == 0
+	 && memcmp(tables.indexTable, format->indexTable, 2 * highBit * sizeof(short)) == 0)
+		return 1;
+	tables.deltaCount = 2 * highBit;
+	memcpy(tables.stepSizeTable, format->stepSizeTable, sizeof(tables.stepSizeTable));
+	memcpy(tables.indexTable, format->indexTable, 2 * highBit * sizeof(short));
+	for(index = 0; index <= ADPCM_MAX_INDEX; index++)
+		for(value = 0; value < tables.deltaCount; value++) {
+			int step = format->stepSizeTable[index];
+			int predictedDelta = 0, bit;
+
+			for(bit = highBit; bit > 0; bit >>= 1) {
+				if(value & bit) predictedDelta += step;
+				step >>= 1;
+			}
+			tables.predictedDelta[index * MaxTableDeltas + value] = predictedDelta + step;
+			tables.nextIndex[index * MaxTableDeltas + value] = (unsigned char) nextIndex(format, index, value);
+		}
+	return 1;
+}
+
+/* Decode the next sample with the tables */
+#define decodeTabulated(format, s) do { \
+	int delta = nextBits(s, (format)->bitsPerSample); \
+	int entry = ((s)->index * MaxTableDeltas) + (delta & (format)->deltaValueMask); \
+	int predictedDelta = tables.predictedDelta[entry]; \
+	(s)->predicted = clampSample(delta & (format)->deltaSignMask \
+				     ? (s)->predicted - predictedDelta \
+				     : (s)->predicted + predictedDelta); \
+	(s)->index = tables.nextIndex[entry]; \
+	(s)->samples[(s)->sampleIndex++] = (short) (s)->predicted; \
+} while(0)
+
+static void
+decodeTabulatedStream(ADPCMFormat *format, ADPCMStream *s, int count)
+{
+	int i;
+
+	for(i = 1; i <= count; i++) {
+		if(isFrameStart(format, i))
+			s->predicted = decodeHeader(s);
+		else
+			decodeTabulated(format, s);
+	}
+}
+
+static void
+decodeTabulatedFour(ADPCMFormat *format, ADPCMStream *s, int count)
+{
+	int i;
+
+	for(i = 1; i <= count; i++) {
+		if(isFrameStart(format, i)) {
+			s[0].predicted = decodeHeader(s);
+			s[1].predicted = decodeHeader(s + 1);
+			s[2].predicted = decodeHeader(s + 2);
+			s[3].predicted = decodeHeader(s + 3);
+		} else {
+			decodeTabulated(format, s);
+			decodeTabulated(format, s + 1);
+			decodeTabulated(format, s + 2);
+			decodeTabulated(format, s + 3);
+		}
+	}
+}
+
+static void
+decodeStream(ADPCMFormat *format, ADPCMStream *s, int count)
+{
+	int i;
+
+	for(i = 1; i <= count; i++) {
+		int delta, step, predictedDelta, bit;
+
+		if(isFrameStart(format, i)) {
+			s->predicted = decodeHeader(s);
+			continue;
+		}
+		delta = nextBits(s, format->bitsPerSample);
+		step = format->stepSizeTable[s->index];
+		predictedDelta = 0;
+		for(bit = format->deltaValueHighBit; bit > 0; bit >>= 1) {
+			predictedDelta += (delta & bit) ? step : 0;
+			step >>= 1;
+		}
+		predictedDelta += step;
+		s->predicted = clampSample(delta & format->deltaSignMask
+					   ? s->predicted - predictedDelta
+					   : s->predicted + predictedDelta);
+		s->index = nextIndex(format, s->index, delta & format->deltaValueMask);
+		s->samples[s->sampleIndex++] = (short) s->predicted;
+	}
+}
+
+static void
+encodeStream(ADPCMFormat *format, ADPCMStream *s, int count)
+{
+	int step = format->stepSizeTable[0];
+	int i;
+
+	for(i = 1; i <= count; i++) {
+		int diff, sign, delta, predictedDelta, bit;
+
+		if(isFrameStart(format, i)) {
+			s->predicted = encodeHeader(format, s, i == count);
+			continue;
+		}
+		diff = s->samples[s->sampleIndex++] - s->predicted;
+		sign = diff < 0 ? format->deltaSignMask : 0;
+		if(diff < 0) diff = 0 - diff;
+		delta = predictedDelta = 0;
+		for(bit = format->deltaValueHighBit; bit > 0; bit >>= 1) {
+			int taken = diff >= step;
+
+			delta += taken ? bit : 0;
+			predictedDelta += taken ? step : 0;
+			diff -= taken ? step : 0;
+			step >>= 1;
+		}
+		predictedDelta += step;
+		s->predicted = clampSample(sign ? s->predicted - predictedDelta : s->predicted + predictedDelta);
+		s->index = nextIndex(format, s->index, delta);
+		step = format->stepSizeTable[s->index];
+		putBits(s, sign | delta, format->bitsPerSample);
+	}
+	if(s->bitPosition > 0)
+		s->encodedBytes[s->byteIndex++] = (unsigned char) s->currentByte;
+}
+
+
+/*** Four streams at a time ***/
+
+#ifdef ADPCM_SSE2
+#define lanes(a, b, c, d) _mm_set_epi32(d, c, b, a)
+
+static __m128i
+clampSamples(__m128i samples)
+{
+	__m128i packed = _mm_packs_epi32(samples, samples);
+
+	return _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+}
+
+/* Negate the lanes of x where negative is all ones */
+static __m128i
+negateWhere(__m128i x, __m128i negative)
+{
+	return _mm_sub_epi32(_mm_xor_si128(x, negative), negative);
+}
+
+static void
+encodeFour(ADPCMFormat *format, ADPCMStream *s, int count)
+{
+	__m128i predicted, step, zero = _mm_setzero_si128(), one = _mm_set1_epi32(1);
+	int deltas[4], negatives[4], out[4], i, j;
+
+	predicted = lanes(s[0].predicted, s[1].predicted, s[2].predicted, s[3].predicted);
+	step = _mm_set1_epi32(format->stepSizeTable[0]);
+	for(i = 1; i <= count; i++) {
+		__m128i diff, delta, predictedDelta, negative;
+		int bit;
+
+		if(isFrameStart(format, i)) {
+			predicted = lanes(encodeHeader(format, s, i == count), encodeHeader(format, s + 1, i == count),
+					  encodeHeader(format, s + 2, i == count), encodeHeader(format, s + 3, i == count));
+			continue;
+		}
+		diff = _mm_sub_epi32(lanes(s[0].samples[s[0].sampleIndex++], s[1].samples[s[1].sampleIndex++],
+					   s[2].samples[s[2].sampleIndex++], s[3].samples[s[3].sampleIndex++]),
+				     predicted);
+		negative = _mm_cmpgt_epi32(zero, diff);
+		diff = negateWhere(diff, negative);
+		delta = predictedDelta = zero;
+		for(bit = format->deltaValueHighBit; bit > 0; bit >>= 1) {
+			__m128i taken = _mm_cmpgt_epi32(diff, _mm_sub_epi32(step, one));
+			__m128i takenStep = _mm_and_si128(taken, step);
+
+			delta = _mm_add_epi32(delta, _mm_and_si128(taken, _mm_set1_epi32(bit)));
+			predictedDelta = _mm_add_epi32(predictedDelta, takenStep);
+			diff = _mm_sub_epi32(diff, takenStep);
+			step = _mm_srli_epi32(step, 1);
+		}
+		predictedDelta = _mm_add_epi32(predictedDelta, step);
+		predicted = clampSamples(_mm_add_epi32(predicted, negateWhere(predictedDelta, negative)));
+		_mm_storeu_si128((__m128i *) deltas, delta);
+		_mm_storeu_si128((__m128i *) negatives, negative);
+		for(j = 0; j < 4; j++) {
+			s[j].index = nextIndex(format, s[j].index, deltas[j]);
+			putBits(s + j, (negatives[j] & format->deltaSignMask) | deltas[j], format->bitsPerSample);
+		}
+		step = lanes(format->stepSizeTable[s[0].index], format->stepSizeTable[s[1].index],
+			     format->stepSizeTable[s[2].index], format->stepSizeTable[s[3].index]);
+	}
+	_mm_storeu_si128((__m128i *) out, predicted);
+	for(j = 0; j < 4; j++) {
+		s[j].predicted = out[j];
+		if(s[j].bitPosition > 0)
+			s[j].encodedBytes[s[j].byteIndex++] = (unsigned char) s[j].currentByte;
+	}
+}
+#endif /* ADPCM_SSE2 */
+
+void
+adpcmDecodeStreams(ADPCMFormat *format, ADPCMStream *streams, int streamCount, int count)
+{
+	int k = 0;
+
+	if(loadTables(format)) {
+		for(; k + 4 <= streamCount; k += 4)
+			decodeTabulatedFour(format, streams + k, count);
+		for(; k < streamCount; k++)
+			decodeTabulatedStream(format, streams + k, count);
+	} else
+		for(; k < streamCount; k++)
+			decodeStream(format, streams + k, count);
+}
+
+void
+adpcmEncodeStreams(ADPCMFormat *format, ADPCMStream *streams, int streamCount, int count)
+{
+	int k = 0;
+
+#ifdef ADPCM_SSE2
+	for(; k + 4 <= streamCount; k += 4)
+		encodeFour(format, streams + k, count);
+#endif
+	for(; k < streamCount; k++)
+		encodeStream(format, streams + k, count);
+}
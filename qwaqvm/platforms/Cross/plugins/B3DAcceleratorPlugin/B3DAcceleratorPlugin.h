@@ -139,6 +139,15 @@ typedef struct B3DPrimitiveLight {
 #define b3dxSetIntPropertyOS     glSetIntPropertyOS
 #define b3dxSetVerboseLevel      glSetVerboseLevel
 #define b3dxSetFog               glSetFog
+
+#define b3dxCreateBuffer         glCreateBuffer
+#define b3dxUpdateBuffer         glUpdateBuffer
+#define b3dxDestroyBuffer        glDestroyBuffer
+#define b3dxLoadBufferState      glLoadBufferState
+#define b3dxDrawBufferElements   glDrawBufferElements
+#define b3dxDrawBufferArrays     glDrawBufferArrays
+#define b3dxCheckBufferElements  glCheckBufferElements
+#define b3dxUploadTextureRects   glUploadTextureRects
 #endif
 
 #if defined(B3DX_D3D)
@@ -179,6 +188,15 @@ typedef struct B3DPrimitiveLight {
 #define b3dxSetIntProperty       d3dSetIntProperty
 #define b3dxSetVerboseLevel     d3dSetVerboseLevel
 #define b3dxSetFog               d3dSetFog
+
+#define b3dxCreateBuffer         d3dCreateBuffer
+#define b3dxUpdateBuffer         d3dUpdateBuffer
+#define b3dxDestroyBuffer        d3dDestroyBuffer
+#define b3dxLoadBufferState      d3dLoadBufferState
+#define b3dxDrawBufferElements   d3dDrawBufferElements
+#define b3dxDrawBufferArrays     d3dDrawBufferArrays
+#define b3dxCheckBufferElements  d3dCheckBufferElements
+#define b3dxUploadTextureRects   d3dUploadTextureRects
 #endif
 
 /* module initialization support */
@@ -229,6 +247,26 @@ int b3dDrawArrays(int handle, int mode, int minIdx, int maxIdx);
 int b3dDrawElements(int handle, int mode, int nFaces, unsigned int *facePtr);
 int b3dDrawRangeElements(int handle, int mode, int minIdx, int maxIdx, int nFaces, unsigned int *facePtr);
 
+/* Qwaq buffer object primitives. Buffers are GL buffer object names; the
+   target is B3D_VERTEX_BUFFER or B3D_INDEX_BUFFER, sizes are in bytes. */
+#define B3D_VERTEX_BUFFER 0
+#define B3D_INDEX_BUFFER  1
+
+#define B3D_STATIC_BUFFER  0
+#define B3D_DYNAMIC_BUFFER 1
+#define B3D_STREAM_BUFFER  2
+
+int b3dxCreateBuffer(int handle, int target, int usage, int size, void *data); /* return buffer handle or 0 on error */
+int b3dxUpdateBuffer(int handle, int buffer, int offset, int size, void *data); /* return true on success, false on error */
+int b3dxDestroyBuffer(int handle, int buffer); /* return true on success, false on error */
+int b3dxLoadBufferState(int handle, int vtxBuffer, int colorBuffer, int normalBuffer, int txBuffer, int txSize); /* return true on success, false on error */
+int b3dxDrawBufferElements(int handle, int mode, int idxBuffer, int first, int count); /* return true on success, false on error */
+int b3dxDrawBufferArrays(int handle, int mode, int first, int count); /* return true on success, false on error */
+int b3dxCheckBufferElements(int handle, int idxBuffer, int first, int count); /* return true if all indices are within the loaded buffers */
+
+/* Upload only the given dirty rectangles (x, y, w, h quads) of a texture */
+int b3dxUploadTextureRects(int renderer, int handle, int w, int h, int d, void *bits, int *rects, int nRects, int streaming); /* return true on success, false on error */
+
 #if defined(B3DX_DUAL)
 extern int glMode;
 
@@ -306,6 +344,23 @@ extern int glMode;
 #define b3dxSetFog(h,t,d,s,e,rgba) \
   (glMode ? glSetFog(h,t,d,s,e,rgba) : d3dSetFog(h,t,d,s,e,rgba))
 
+#define b3dxCreateBuffer(h,t,u,s,d) \
+  (glMode ? glCreateBuffer(h,t,u,s,d) : d3dCreateBuffer(h,t,u,s,d))
+#define b3dxUpdateBuffer(h,b,o,s,d) \
+  (glMode ? glUpdateBuffer(h,b,o,s,d) : d3dUpdateBuffer(h,b,o,s,d))
+#define b3dxDestroyBuffer(h,b) \
+  (glMode ? glDestroyBuffer(h,b) : d3dDestroyBuffer(h,b))
+#define b3dxLoadBufferState(h,v,c,n,t,ts) \
+  (glMode ? glLoadBufferState(h,v,c,n,t,ts) : d3dLoadBufferState(h,v,c,n,t,ts))
+#define b3dxDrawBufferElements(h,m,i,f,c) \
+  (glMode ? glDrawBufferElements(h,m,i,f,c) : d3dDrawBufferElements(h,m,i,f,c))
+#define b3dxDrawBufferArrays(h,m,f,c) \
+  (glMode ? glDrawBufferArrays(h,m,f,c) : d3dDrawBufferArrays(h,m,f,c))
+#define b3dxCheckBufferElements(h,i,f,c) \
+  (glMode ? glCheckBufferElements(h,i,f,c) : d3dCheckBufferElements(h,i,f,c))
+#define b3dxUploadTextureRects(r,hh,w,h,d,b,rs,n,s) \
+  (glMode ? glUploadTextureRects(r,hh,w,h,d,b,rs,n,s) : d3dUploadTextureRects(r,hh,w,h,d,b,rs,n,s))
+
 #define B3DX_GL
 #define B3DX_D3D
 
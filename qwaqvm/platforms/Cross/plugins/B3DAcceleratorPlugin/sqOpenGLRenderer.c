@@ -19,6 +19,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
+
+#if !defined(WIN32)
+/* we want the GL 1.5 buffer object prototypes from glext.h */
+# define GL_GLEXT_PROTOTYPES 1
+#endif
 
 #include "sqVirtualMachine.h"
 #include "sqConfig.h"
@@ -35,6 +41,229 @@
 
 static float blackLight[4] = { 0.0, 0.0, 0.0, 0.0 };
 
+/*****************************************************************************/
+/*****************************************************************************/
+/* Buffer object support (GL 1.5). Win32 only exports GL 1.1 so the entry
+   points are looked up at runtime there; elsewhere we link against them. */
+
+#ifndef GL_ARRAY_BUFFER
+# define GL_ARRAY_BUFFER         0x8892
+# define GL_ELEMENT_ARRAY_BUFFER 0x8893
+# define GL_BUFFER_SIZE          0x8764
+# define GL_STREAM_DRAW          0x88E0
+# define GL_STATIC_DRAW          0x88E4
+# define GL_DYNAMIC_DRAW         0x88E8
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER
+# define GL_PIXEL_UNPACK_BUFFER  0x88EC
+#endif
+#ifndef GL_WRITE_ONLY
+# define GL_WRITE_ONLY           0x88B9
+#endif
+
+#ifndef GL_VERSION_1_5
+typedef ptrdiff_t GLsizeiptr;
+typedef ptrdiff_t GLintptr;
+#endif
+
+#if defined(WIN32)
+typedef void (APIENTRY *glGenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *glDeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *glBindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *glBufferDataProc)(GLenum target, GLsizeiptr size, const GLvoid *data, GLenum usage);
+typedef void (APIENTRY *glBufferSubDataProc)(GLenum target, GLintptr offset, GLsizeiptr size, const GLvoid *data);
+typedef GLboolean (APIENTRY *glIsBufferProc)(GLuint buffer);
+typedef void (APIENTRY *glGetBufferParameterivProc)(GLenum target, GLenum pname, GLint *params);
+typedef GLvoid* (APIENTRY *glMapBufferProc)(GLenum target, GLenum access);
+typedef GLboolean (APIENTRY *glUnmapBufferProc)(GLenum target);
+
+static glGenBuffersProc b3dGenBuffers;
+static glDeleteBuffersProc b3dDeleteBuffers;
+static glBindBufferProc b3dBindBuffer;
+static glBufferDataProc b3dBufferData;
+static glBufferSubDataProc b3dBufferSubData;
+static glIsBufferProc b3dIsBuffer;
+static glGetBufferParameterivProc b3dGetBufferParameteriv;
+static glMapBufferProc b3dMapBuffer;
+static glUnmapBufferProc b3dUnmapBuffer;
+
+static int glLoadBufferProcs(void)
+{
+	if(b3dGenBuffers) return 1;
+	b3dDeleteBuffers = (glDeleteBuffersProc) wglGetProcAddress("glDeleteBuffers");
+	b3dBindBuffer = (glBindBufferProc) wglGetProcAddress("glBindBuffer");
+	b3dBufferData = (glBufferDataProc) wglGetProcAddress("glBufferData");
+	b3dBufferSubData = (glBufferSubDataProc) wglGetProcAddress("glBufferSubData");
+	b3dIsBuffer = (glIsBufferProc) wglGetProcAddress("glIsBuffer");
+	b3dGetBufferParameteriv = (glGetBufferParameterivProc) wglGetProcAddress("glGetBufferParameteriv");
+	b3dMapBuffer = (glMapBufferProc) wglGetProcAddress("glMapBuffer");
+	b3dUnmapBuffer = (glUnmapBufferProc) wglGetProcAddress("glUnmapBuffer");
+	if(!b3dDeleteBuffers || !b3dBindBuffer || !b3dBufferData || !b3dBufferSubData
+	   || !b3dIsBuffer || !b3dGetBufferParameteriv || !b3dMapBuffer || !b3dUnmapBuffer) {
+		DPRINTF3D(1, (fp, "ERROR: Cannot find buffer object support\n"));
+		return 0;
+	}
+	/* set last so that a partial lookup is retried */
+	b3dGenBuffers = (glGenBuffersProc) wglGetProcAddress("glGenBuffers");
+	return b3dGenBuffers != NULL;
+}
+#else
+# define b3dGenBuffers glGenBuffers
+# define b3dDeleteBuffers glDeleteBuffers
+# define b3dBindBuffer glBindBuffer
+# define b3dBufferData glBufferData
+# define b3dBufferSubData glBufferSubData
+# define b3dIsBuffer glIsBuffer
+# define b3dGetBufferParameteriv glGetBufferParameteriv
+# define b3dMapBuffer glMapBuffer
+# define b3dUnmapBuffer glUnmapBuffer
+# define glLoadBufferProcs() 1
+#endif
+
+/* Buffer bindings and enabled client arrays of the last renderer that used
+   them. Static scenes issue long runs of draws from the same buffers so
+   remembering these lets us skip the redundant binds between draws. */
+#define B3D_STATE_UNKNOWN ((GLuint)-1)
+static struct glRenderer *stateRenderer = NULL;
+static GLuint boundArrayBuffer = B3D_STATE_UNKNOWN;
+static GLuint boundElementBuffer = B3D_STATE_UNKNOWN;
+
+static void glSetStateRenderer(struct glRenderer *renderer)
+{
+	if(renderer == stateRenderer) return;
+	stateRenderer = renderer;
+	boundArrayBuffer = boundElementBuffer = B3D_STATE_UNKNOWN;
+}
+
+/* Pairs of pixel unpack buffers used for streaming texture uploads. They
+   are used alternately so that filling one never waits for the GL to be
+   done reading the other. */
+#define MAX_PIXEL_BUFFERS 4
+static struct {
+	struct glRenderer *renderer;
+	GLuint pbo[2];
+	int next;
+} pixelBuffers[MAX_PIXEL_BUFFERS];
+
+/* What we know of each retained buffer: its size in bytes and, for index
+   buffers, a copy of the indices so that draws can be range checked
+   without reading the buffer back. Buffer names are per context, so
+   records are hashed by name and matched by renderer and name. GL hands
+   out small consecutive names, so the chains stay short. */
+typedef struct glBufferRecord {
+	struct glRenderer *renderer;
+	GLuint id;
+	int target;
+	int size;
+	unsigned int *indices;
+	struct glBufferRecord *next;
+} glBufferRecord;
+
+#define BUFFER_HASH_SIZE 256 /* must be a power of two */
+#define BUFFER_HASH(id) ((id) & (BUFFER_HASH_SIZE - 1))
+static glBufferRecord *bufferRecords[BUFFER_HASH_SIZE];
+
+/* The number of whole vertices in the arrays set up by each renderer's
+   last glLoadBufferState(), indexed by renderer handle; buffer draws may
+   not reach beyond it. Zero while client arrays are loaded. */
+#ifndef MAX_RENDERER
+# define MAX_RENDERER 16
+#endif
+typedef struct glBufferState {
+	struct glRenderer *renderer;
+	int vertices;
+} glBufferState;
+
+static glBufferState bufferStates[MAX_RENDERER];
+
+static glBufferRecord *glFindBufferRecord(struct glRenderer *renderer, GLuint id)
+{
+	glBufferRecord *record;
+	for(record = bufferRecords[BUFFER_HASH(id)]; record; record = record->next)
+		if(record->renderer == renderer && record->id == id)
+			return record;
+	return NULL;
+}
+
+static void glAddBufferRecord(glBufferRecord *record)
+{
+	glBufferRecord **bucket = &bufferRecords[BUFFER_HASH(record->id)];
+	record->next = *bucket;
+	*bucket = record;
+}
+
+static void glFreeBufferRecord(glBufferRecord *record)
+{
+	glBufferRecord **link;
+	for(link = &bufferRecords[BUFFER_HASH(record->id)]; *link; link = &(*link)->next)
+		if(*link == record) {
+			*link = record->next;
+			break;
+		}
+	if(record->indices) free(record->indices);
+	free(record);
+}
+
+/* Answer the buffer state of the renderer with the given handle, or NULL
+   if it has not loaded any buffers */
+static glBufferState *glFindBufferState(struct glRenderer *renderer, int handle)
+{
+	if(handle < 0 || handle >= MAX_RENDERER) return NULL;
+	if(bufferStates[handle].renderer != renderer) return NULL;
+	return &bufferStates[handle];
+}
+
+/* Called by the platform code when a renderer goes away */
+void glForgetBufferState(struct glRenderer *renderer)
+{
+	int i;
+	glBufferRecord *record, *nextRecord;
+
+	if(renderer == stateRenderer) stateRenderer = NULL;
+	/* the buffers went away with the context */
+	for(i = 0; i < MAX_PIXEL_BUFFERS; i++)
+		if(pixelBuffers[i].renderer == renderer)
+			pixelBuffers[i].renderer = NULL;
+	for(i = 0; i < BUFFER_HASH_SIZE; i++)
+		for(record = bufferRecords[i]; record; record = nextRecord) {
+			nextRecord = record->next;
+			if(record->renderer == renderer) glFreeBufferRecord(record);
+		}
+	for(i = 0; i < MAX_RENDERER; i++)
+		if(bufferStates[i].renderer == renderer) {
+			bufferStates[i].renderer = NULL;
+			bufferStates[i].vertices = 0;
+		}
+}
+
+static void glBindBufferCached(struct glRenderer *renderer, GLenum target, GLuint buffer)
+{
+	glSetStateRenderer(renderer);
+	if(target == GL_ARRAY_BUFFER) {
+		if(boundArrayBuffer == buffer) return;
+		boundArrayBuffer = buffer;
+	} else {
+		if(boundElementBuffer == buffer) return;
+		boundElementBuffer = buffer;
+	}
+	if(!glLoadBufferProcs()) return;
+	b3dBindBuffer(target, buffer);
+	ERROR_CHECK;
+}
+
+/* Client side array pointers are taken as buffer offsets while a buffer is
+   bound, so everything passing real pointers must unbind first. Doing so
+   replaces the arrays of the last glLoadBufferState(), so buffer draws
+   fail until the buffers are loaded again. */
+static void glUnbindBuffers(struct glRenderer *renderer, int handle)
+{
+	glBufferState *state = glFindBufferState(renderer, handle);
+
+	if(state) state->vertices = 0;
+	glBindBufferCached(renderer, GL_ARRAY_BUFFER, 0);
+	glBindBufferCached(renderer, GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
 /*****************************************************************************/
 /*****************************************************************************/
 /*****************************************************************************/
@@ -226,6 +455,136 @@ int glUploadTexture(int rendererHandle, int handle, int w, int h, int d, void* b
 	return 1;
 }
 
+/* Clip the i-th rectangle (x, y, w, h) of rects to the w by h texture.
+   Answer false if nothing is left of it. The rectangles come from the
+   image, so this is written to never add two of their values. */
+static int glClipTextureRect(int *rects, int i, int w, int h, int r[4])
+{
+	int left = rects[i*4], top = rects[i*4+1];
+	int width = rects[i*4+2], height = rects[i*4+3];
+	if(w <= 0 || h <= 0 || width <= 0 || height <= 0) return 0;
+	if(left >= w || top >= h) return 0;
+	/* a negative origin and a positive extent cannot overflow */
+	if(left < 0) { width += left; left = 0; }
+	if(top < 0) { height += top; top = 0; }
+	if(width > w - left) width = w - left;
+	if(height > h - top) height = h - top;
+	if(width <= 0 || height <= 0) return 0;
+	r[0] = left; r[1] = top; r[2] = width; r[3] = height;
+	return 1;
+}
+
+/* Answer the pixel buffer pair for the renderer, allocating it if needed,
+   or -1 if pixel buffer objects are not available */
+static int glPixelBufferIndex(struct glRenderer *renderer)
+{
+	static int hasPixelBuffers = -1;
+	int i, unused = -1;
+
+	if(hasPixelBuffers < 0) {
+		const char *extensions = (const char*)glGetString(GL_EXTENSIONS);
+		hasPixelBuffers = extensions && strstr(extensions, "_pixel_buffer_object")
+			&& glLoadBufferProcs();
+	}
+	if(!hasPixelBuffers) return -1;
+	for(i = 0; i < MAX_PIXEL_BUFFERS; i++) {
+		if(pixelBuffers[i].renderer == renderer) return i;
+		if(!pixelBuffers[i].renderer && unused < 0) unused = i;
+	}
+	if(unused < 0) return -1;
+	b3dGenBuffers(2, pixelBuffers[unused].pbo);
+	if((glErr = glGetError()) != GL_NO_ERROR) {
+		DPRINTF3D(1, (fp, "ERROR (glPixelBufferIndex): glGenBuffers() failed -- %s\n", glErrString()));
+		return -1;
+	}
+	pixelBuffers[unused].renderer = renderer;
+	pixelBuffers[unused].next = 0;
+	return unused;
+}
+
+/* Copy the dirty rectangles into the next pixel buffer and upload them
+   from there. The buffer is orphaned before mapping so the driver can hand
+   out fresh storage instead of stalling on a pending upload. */
+static int glStreamTextureRects(struct glRenderer *renderer, int w, int h, char *bits, int *rects, int nRects)
+{
+	int i, y, r[4], index;
+	GLsizeiptr size = 0, offset = 0;
+	char *dst;
+
+	if((index = glPixelBufferIndex(renderer)) < 0) return 0;
+	for(i = 0; i < nRects; i++)
+		if(glClipTextureRect(rects, i, w, h, r)) size += (GLsizeiptr)r[2] * r[3] * 4;
+	if(size == 0) return 1;
+
+	b3dBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[index].pbo[pixelBuffers[index].next]);
+	pixelBuffers[index].next ^= 1;
+	b3dBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+	dst = (char*) b3dMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+	if(!dst) {
+		DPRINTF3D(1, (fp, "ERROR (glStreamTextureRects): glMapBuffer() failed -- %s\n", glErrString()));
+		b3dBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return 0;
+	}
+	for(i = 0; i < nRects; i++) {
+		if(!glClipTextureRect(rects, i, w, h, r)) continue;
+		for(y = 0; y < r[3]; y++) {
+			memcpy(dst, bits + ((size_t)(r[1] + y) * w + r[0]) * 4, r[2] * 4);
+			dst += r[2] * 4;
+		}
+	}
+	if(!b3dUnmapBuffer(GL_PIXEL_UNPACK_BUFFER)) {
+		/* contents were lost (e.g., mode switch); let the caller retry */
+		b3dBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return 0;
+	}
+	for(i = 0; i < nRects; i++) {
+		if(!glClipTextureRect(rects, i, w, h, r)) continue;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, r[0], r[1], r[2], r[3],
+						GL_RGBA, GL_UNSIGNED_BYTE, (char*)NULL + offset);
+		ERROR_CHECK;
+		offset += (GLsizeiptr)r[2] * r[3] * 4;
+	}
+	b3dBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return 1;
+}
+
+/* Like glUploadTexture but only uploading the given dirty rectangles, each
+   being x, y, width, height in texture pixels. If streaming is requested
+   and supported the data goes through pixel buffer objects. */
+int glUploadTextureRects(int rendererHandle, int handle, int w, int h, int d, void *bits, int *rects, int nRects, int streaming)
+{
+	int i, r[4];
+
+	struct glRenderer *renderer = glRendererFromHandle(rendererHandle);
+
+	if(!renderer || !glMakeCurrentRenderer(renderer)) {
+		DPRINTF3D(4, (fp, "ERROR: Invalid renderer specified\n"));
+		return 0;
+	}
+
+	if(d != 32) return 0;
+
+	if(!glIsTexture(handle)) {
+		return 0;
+	}
+	DPRINTF3D(5, (fp, "### Uploading %d texture rects (w = %d, h = %d, d = %d, id = %d)\n", nRects, w, h, d, handle));
+	glBindTexture(GL_TEXTURE_2D, handle);
+	ERROR_CHECK;
+	if(streaming && glStreamTextureRects(renderer, w, h, (char*)bits, rects, nRects))
+		return 1;
+	/* upload straight from the form bits, skipping the rest of each row */
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, w);
+	for(i = 0; i < nRects; i++) {
+		if(!glClipTextureRect(rects, i, w, h, r)) continue;
+		glTexSubImage2D(GL_TEXTURE_2D, 0, r[0], r[1], r[2], r[3],
+						GL_RGBA, GL_UNSIGNED_BYTE,
+						((char*)bits) + ((size_t)r[1] * w + r[0]) * 4);
+		ERROR_CHECK;
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	return 1;
+}
+
 int glCompositeTexture(int rendererHandle, int handle, int x, int y, int w, int h, int translucent)
 {
 	struct glRenderer *renderer = glRendererFromHandle(rendererHandle);
@@ -863,6 +1222,9 @@ int glRenderVertexBuffer(int handle, int primType, int flags, int texHandle, flo
 		glDisable(GL_TEXTURE_2D);
 		ERROR_CHECK;
 	}
+	/* client side arrays below; make sure no buffer object is bound */
+	glUnbindBuffers(renderer, handle);
+
 	vtxFlags = 0;
 	if(tracking)
 		vtxFlags |= 1;
@@ -1013,13 +1375,22 @@ int b3dLoadClientState(int handle, float *vtxData, int vtxSize, float *colorData
     return 0;
   }
 
-  if(colorData) glColorPointer(colorSize, GL_FLOAT, colorSize*4, colorData);
-  else glDisableClientState(GL_COLOR_ARRAY);
-  if(normalData) glNormalPointer(GL_FLOAT, normalSize*4, normalData);
-  else glDisableClientState(GL_NORMAL_ARRAY);
-  if(txData) glTexCoordPointer(txSize, GL_FLOAT, txSize*4, txData);
-  else glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glUnbindBuffers(renderer, handle);
+  /* enable what we are given; a previous state may have disabled it */
+  if(colorData) {
+    glColorPointer(colorSize, GL_FLOAT, colorSize*4, colorData);
+    glEnableClientState(GL_COLOR_ARRAY);
+  } else glDisableClientState(GL_COLOR_ARRAY);
+  if(normalData) {
+    glNormalPointer(GL_FLOAT, normalSize*4, normalData);
+    glEnableClientState(GL_NORMAL_ARRAY);
+  } else glDisableClientState(GL_NORMAL_ARRAY);
+  if(txData) {
+    glTexCoordPointer(txSize, GL_FLOAT, txSize*4, txData);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  } else glDisableClientState(GL_TEXTURE_COORD_ARRAY);
   glVertexPointer(vtxSize, GL_FLOAT, vtxSize*4, vtxData);
+  glEnableClientState(GL_VERTEX_ARRAY);
   return 1;
 }
 
@@ -1027,6 +1398,7 @@ int b3dDrawRangeElements(int handle, int mode, int minIdx, int maxIdx, int nFace
   glRenderer *renderer = glRendererFromHandle(handle);
   if(!renderer || !glMakeCurrentRenderer(renderer)) return 0;
 
+  glBindBufferCached(renderer, GL_ELEMENT_ARRAY_BUFFER, 0);
 #ifdef WIN32
   if(!renderer->glDrawRangeElements) {
     void *fn;
@@ -1052,6 +1424,7 @@ int b3dDrawRangeElements(int handle, int mode, int minIdx, int maxIdx, int nFace
 int b3dDrawElements(int handle, int mode, int nFaces, unsigned int *facePtr) {
   glRenderer *renderer = glRendererFromHandle(handle);
   if(!renderer || !glMakeCurrentRenderer(renderer)) return 0;
+  glBindBufferCached(renderer, GL_ELEMENT_ARRAY_BUFFER, 0);
   glDrawElements(mode, nFaces, GL_UNSIGNED_INT, facePtr);
   return 1;
 }
@@ -1063,5 +1436,277 @@ int b3dDrawArrays(int handle, int mode, int minIdx, int maxIdx) {
   return 1;
 }
 
+/*****************************************************************************/
+/*****************************************************************************/
+/* Retained vertex and index buffers. Geometry is uploaded once with
+   glCreateBuffer(), patched with glUpdateBuffer() and drawn any number
+   of times via glLoadBufferState() + glDrawBufferElements() or
+   glDrawBufferArrays() without passing through the VM again. */
+
+static GLenum glBufferTarget(int target)
+{
+	if(target == B3D_VERTEX_BUFFER) return GL_ARRAY_BUFFER;
+	if(target == B3D_INDEX_BUFFER) return GL_ELEMENT_ARRAY_BUFFER;
+	return 0;
+}
+
+static GLenum glBufferUsage(int usage)
+{
+	if(usage == B3D_STATIC_BUFFER) return GL_STATIC_DRAW;
+	if(usage == B3D_DYNAMIC_BUFFER) return GL_DYNAMIC_DRAW;
+	if(usage == B3D_STREAM_BUFFER) return GL_STREAM_DRAW;
+	return 0;
+}
+
+int glCreateBuffer(int handle, int target, int usage, int size, void *data)
+{
+	GLuint buffer;
+	GLenum glTarget = glBufferTarget(target);
+	GLenum glUsage = glBufferUsage(usage);
+	glBufferRecord *record;
+
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer || !glMakeCurrentRenderer(renderer)) {
+		DPRINTF3D(4, (fp, "ERROR: Invalid renderer specified\n"));
+		return 0;
+	}
+	if(!glTarget || !glUsage || size < 0) return 0;
+	if(!glLoadBufferProcs()) return 0;
+
+	record = (glBufferRecord*) calloc(1, sizeof(glBufferRecord));
+	if(!record) return 0;
+	if(target == B3D_INDEX_BUFFER) {
+		/* indices of a buffer created without data read as zero */
+		record->indices = (unsigned int*) calloc(1, size ? size : 1);
+		if(!record->indices) {
+			free(record);
+			return 0;
+		}
+		if(data) memcpy(record->indices, data, size);
+	}
+
+	b3dGenBuffers(1, &buffer);
+	if((glErr = glGetError()) != GL_NO_ERROR) {
+		DPRINTF3D(1, (fp, "ERROR (glCreateBuffer): glGenBuffers() failed -- %s\n", glErrString()));
+		if(record->indices) free(record->indices);
+		free(record);
+		return 0;
+	}
+	glBindBufferCached(renderer, glTarget, buffer);
+	b3dBufferData(glTarget, size, data, glUsage);
+	if((glErr = glGetError()) != GL_NO_ERROR) {
+		DPRINTF3D(1, (fp, "ERROR (glCreateBuffer): glBufferData() failed -- %s\n", glErrString()));
+		b3dDeleteBuffers(1, &buffer);
+		glSetStateRenderer(NULL);
+		if(record->indices) free(record->indices);
+		free(record);
+		return 0;
+	}
+	record->renderer = renderer;
+	record->id = buffer;
+	record->target = target;
+	record->size = size;
+	glAddBufferRecord(record);
+	DPRINTF3D(5, (fp, "### Allocated buffer id = %d (target = %d, size = %d)\n", buffer, target, size));
+	return buffer;
+}
+
+/* Replace size bytes at offset in the buffer; used to upload only the
+   dirty range of a mesh rather than all of it */
+int glUpdateBuffer(int handle, int buffer, int offset, int size, void *data)
+{
+	glBufferRecord *record;
+
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer || !glMakeCurrentRenderer(renderer)) {
+		DPRINTF3D(4, (fp, "ERROR: Invalid renderer specified\n"));
+		return 0;
+	}
+	if(!glLoadBufferProcs() || !b3dIsBuffer(buffer)) return 0;
+	record = glFindBufferRecord(renderer, buffer);
+	if(!record) return 0;
+	/* written so that it cannot overflow */
+	if(offset < 0 || size < 0 || offset > record->size || size > record->size - offset) return 0;
+	if(size == 0) return 1;
+
+	/* Index and vertex buffers may both be updated through
+	   GL_ARRAY_BUFFER; the binding point doesn't matter for the data */
+	glBindBufferCached(renderer, GL_ARRAY_BUFFER, buffer);
+	b3dBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	if((glErr = glGetError()) != GL_NO_ERROR) {
+		DPRINTF3D(1, (fp, "ERROR (glUpdateBuffer): glBufferSubData() failed -- %s\n", glErrString()));
+		return 0;
+	}
+	if(record->indices) memcpy((char*)record->indices + offset, data, size);
+	return 1;
+}
+
+int glDestroyBuffer(int handle, int buffer)
+{
+	GLuint id = buffer;
+	glBufferRecord *record;
+	glBufferState *state;
+
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer || !glMakeCurrentRenderer(renderer)) {
+		DPRINTF3D(4, (fp, "ERROR: Invalid renderer specified\n"));
+		return 0;
+	}
+	if(!glLoadBufferProcs() || !b3dIsBuffer(id)) return 0;
+	record = glFindBufferRecord(renderer, id);
+	if(!record) return 0;
+	DPRINTF3D(5, (fp, "### Destroying buffer id = %d\n", buffer));
+	glSetStateRenderer(renderer);
+	/* deleting a bound buffer reverts the binding to zero */
+	if(boundArrayBuffer == id) boundArrayBuffer = 0;
+	if(boundElementBuffer == id) boundElementBuffer = 0;
+	b3dDeleteBuffers(1, &id);
+	ERROR_CHECK;
+	/* the buffer may have been one of the loaded arrays */
+	if(record->target == B3D_VERTEX_BUFFER && (state = glFindBufferState(renderer, handle)))
+		state->vertices = 0;
+	glFreeBufferRecord(record);
+	return 1;
+}
+
+/* Answer how many whole elements of the given size the vertex buffer
+   holds, or -1 if it is not a vertex buffer of this renderer */
+static int glVertexBufferCount(struct glRenderer *renderer, int buffer, int elementSize)
+{
+	glBufferRecord *record;
+
+	if(!b3dIsBuffer(buffer)) return -1;
+	record = glFindBufferRecord(renderer, buffer);
+	if(!record || record->target != B3D_VERTEX_BUFFER) return -1;
+	return record->size / elementSize;
+}
+
+/* Like b3dLoadClientState but sourcing the arrays from buffer objects.
+   Vertices are 3 floats, colors 4 floats, normals 3 floats and texture
+   coordinates txSize floats; a buffer of zero disables that array. */
+int glLoadBufferState(int handle, int vtxBuffer, int colorBuffer, int normalBuffer, int txBuffer, int txSize)
+{
+	int vertices, n;
+	glBufferState *state;
+
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer || !glMakeCurrentRenderer(renderer)) {
+		DPRINTF3D(0, (fp, "ERROR: Invalid renderer specified: %d\n", handle));
+		return 0;
+	}
+	if(!glLoadBufferProcs()) return 0;
+	if(txBuffer && (txSize < 1 || txSize > 4)) return 0;
+
+	/* All the arrays must be vertex buffers; draws are limited to the
+	   vertices that every one of them holds */
+	vertices = glVertexBufferCount(renderer, vtxBuffer, 3*4);
+	if(vertices < 0) return 0;
+	if(colorBuffer) {
+		if((n = glVertexBufferCount(renderer, colorBuffer, 4*4)) < 0) return 0;
+		if(n < vertices) vertices = n;
+	}
+	if(normalBuffer) {
+		if((n = glVertexBufferCount(renderer, normalBuffer, 3*4)) < 0) return 0;
+		if(n < vertices) vertices = n;
+	}
+	if(txBuffer) {
+		if((n = glVertexBufferCount(renderer, txBuffer, txSize*4)) < 0) return 0;
+		if(n < vertices) vertices = n;
+	}
+	if(handle < 0 || handle >= MAX_RENDERER) return 0;
+	state = &bufferStates[handle];
+	state->renderer = renderer;
+	state->vertices = 0;
+
+	if(colorBuffer) {
+		glBindBufferCached(renderer, GL_ARRAY_BUFFER, colorBuffer);
+		glColorPointer(4, GL_FLOAT, 4*4, NULL);
+		glEnableClientState(GL_COLOR_ARRAY);
+	} else glDisableClientState(GL_COLOR_ARRAY);
+	if(normalBuffer) {
+		glBindBufferCached(renderer, GL_ARRAY_BUFFER, normalBuffer);
+		glNormalPointer(GL_FLOAT, 3*4, NULL);
+		glEnableClientState(GL_NORMAL_ARRAY);
+	} else glDisableClientState(GL_NORMAL_ARRAY);
+	if(txBuffer) {
+		glBindBufferCached(renderer, GL_ARRAY_BUFFER, txBuffer);
+		glTexCoordPointer(txSize, GL_FLOAT, txSize*4, NULL);
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	} else glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glBindBufferCached(renderer, GL_ARRAY_BUFFER, vtxBuffer);
+	glVertexPointer(3, GL_FLOAT, 3*4, NULL);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	if((glErr = glGetError()) != GL_NO_ERROR) {
+		DPRINTF3D(1, (fp, "ERROR (glLoadBufferState): %s\n", glErrString()));
+		return 0;
+	}
+	state->vertices = vertices;
+	return 1;
+}
+
+/* Draw count vertices starting at first from the loaded buffers */
+int glDrawBufferArrays(int handle, int mode, int first, int count)
+{
+	glBufferState *state;
+
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer || !glMakeCurrentRenderer(renderer)) return 0;
+	state = glFindBufferState(renderer, handle);
+	if(!state) return 0;
+	if(first < 0 || count < 0 || first > state->vertices || count > state->vertices - first) return 0;
+	glDrawArrays(mode, first, count);
+	ERROR_CHECK;
+	return 1;
+}
+
+/* Answer the record of the index buffer if it holds count indices
+   starting at first, or NULL */
+static glBufferRecord *glIndexBufferRange(struct glRenderer *renderer, int idxBuffer, int first, int count)
+{
+	glBufferRecord *record;
+	int nIndices;
+
+	if(!glLoadBufferProcs() || !b3dIsBuffer(idxBuffer)) return NULL;
+	record = glFindBufferRecord(renderer, idxBuffer);
+	if(!record || record->target != B3D_INDEX_BUFFER) return NULL;
+	nIndices = record->size / 4;
+	if(first < 0 || count < 0 || first > nIndices || count > nIndices - first) return NULL;
+	return record;
+}
+
+/* Draw count indices starting at index first of the given index buffer */
+int glDrawBufferElements(int handle, int mode, int idxBuffer, int first, int count)
+{
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer || !glMakeCurrentRenderer(renderer)) return 0;
+	if(!glIndexBufferRange(renderer, idxBuffer, first, count)) return 0;
+
+	glBindBufferCached(renderer, GL_ELEMENT_ARRAY_BUFFER, idxBuffer);
+	glDrawElements(mode, count, GL_UNSIGNED_INT, (GLvoid*)((char*)NULL + ((size_t)first * 4)));
+	ERROR_CHECK;
+	return 1;
+}
+
+/* Check that count indices starting at first of the index buffer refer to
+   vertices of the loaded buffers; the range check of the index buffer
+   primitives */
+int glCheckBufferElements(int handle, int idxBuffer, int first, int count)
+{
+	glBufferRecord *record;
+	glBufferState *state;
+	unsigned int *indices;
+	int i;
+
+	glRenderer *renderer = glRendererFromHandle(handle);
+	if(!renderer) return 0;
+	record = glIndexBufferRange(renderer, idxBuffer, first, count);
+	state = glFindBufferState(renderer, handle);
+	if(!record || !state) return 0;
+	indices = record->indices + first;
+	for(i = 0; i < count; i++)
+		if(indices[i] >= (unsigned int) state->vertices) return 0;
+	return 1;
+}
+
 
 #endif /* defined B3DX_GL */
@@ -19,6 +19,7 @@ typedef struct glRenderer {
 struct glRenderer *glRendererFromHandle(int rendererHandle);
 int glMakeCurrentRenderer(struct glRenderer *renderer);
 int glSwapBuffers(struct glRenderer *renderer);
+void glForgetBufferState(struct glRenderer *renderer);
 
 
 /*****************************************************************************/
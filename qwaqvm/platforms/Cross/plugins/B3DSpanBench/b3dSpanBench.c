@@ -0,0 +1,238 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  b3dSpanBench.c
+ *  B3DSpanBench
+ *
+ *  Command-line check and benchmark of the Squeak3D span shaders, the
+ *  scalar ones against the vectorized ones picked by b3dFillFunctionsFor():
+ *
+ *      b3dSpanBench [-spans n] [-width n] [-seconds n]
+ *
+ *  First -spans random spans (random length, gradients and perspective, on
+ *  power of two and wrapped textures) are drawn by both sets of shaders for
+ *  each of RGB, RGBA, STW+RGB and STW+RGBA, and the span buffers must agree
+ *  bit for bit.  Then each shader of each set fills spans of -width pixels
+ *  for -seconds and the rate is reported in Mpixels/s.  Exits non-zero if
+ *  any span differs, or if the vectorized shaders are not compiled in.
+ *
+ *  It is built from the plugin's support sources, with the byte order the
+ *  VM is built with, e.g. on x86 unix:
+ *
+ *      gcc -O2 -msse2 -DLSB_FIRST -I../Squeak3D b3dSpanBench.c ../Squeak3D/b3dDraw.c
+ *          ../Squeak3D/b3dMain.c ../Squeak3D/b3dInit.c ../Squeak3D/b3dAlloc.c
+ *          ../Squeak3D/b3dRemap.c -o b3dSpanBench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "b3d.h"
+
+#define SPAN_BUFFER_SIZE 2048
+#define TEXTURE_SIZE 256
+
+static unsigned int spanBuffer[SPAN_BUFFER_SIZE];
+static unsigned int textureBits[TEXTURE_SIZE * TEXTURE_SIZE];
+
+static B3DRasterizerState state;
+static B3DPrimitiveVertex vertex;
+static B3DPrimitiveAttribute attributes[7];
+static B3DPrimitiveFace face;
+static B3DTexture texture;
+
+static const struct { int index; const char *name; } shaders[] = {
+	{ B3D_FACE_RGB >> B3D_ATTR_SHIFT, "RGB" },
+	{ (B3D_FACE_RGB | B3D_FACE_ALPHA) >> B3D_ATTR_SHIFT, "RGBA" },
+	{ (B3D_FACE_STW | B3D_FACE_RGB) >> B3D_ATTR_SHIFT, "STWRGB" },
+	{ (B3D_FACE_STW | B3D_FACE_RGB | B3D_FACE_ALPHA) >> B3D_ATTR_SHIFT, "STWARGB" },
+};
+#define NUM_SHADERS (sizeof(shaders) / sizeof(shaders[0]))
+
+static double
+frand(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+static double
+now(void)
+{
+	return clock() / (double)CLOCKS_PER_SEC;
+}
+
+/* A 32 bit texture of the given size; the power of two sizes get masks */
+static void
+setTexture(int width, int height)
+{
+	texture.width = width;
+	texture.height = height;
+	texture.depth = 32;
+	texture.rowLength = width;
+	texture.sMask = (width & (width - 1)) ? 0 : width - 1;
+	texture.tMask = (height & (height - 1)) ? 0 : height - 1;
+	texture.cmSize = 0;
+	texture.colormap = NULL;
+	texture.data = textureBits;
+}
+
+/* Random attributes for a face whose v0 is at the left of the span, chained in the order the
+   shaders read them: R, G, B, [A,] [W, S, T]. Colors may run outside
+   0..255 to exercise the clamping; S and T stay positive. */
+static void
+setFace(int shader, int width)
+{
+	int hasAlpha = shader & (B3D_FACE_ALPHA >> B3D_ATTR_SHIFT);
+	int hasSTW = shader & (B3D_FACE_STW >> B3D_ATTR_SHIFT);
+	int n = 0, i;
+
+	for (i = 0; i < 3 + (hasAlpha ? 1 : 0); i++, n++) {
+		attributes[n].value = (float)frand(-32, 287);
+		attributes[n].dvdx = (float)frand(-320, 320) / width;
+		attributes[n].dvdy = (float)frand(-1, 1);
+	}
+	if (hasSTW) {
+		double w0 = frand(0.5, 2), w1 = frand(0.5, 2);
+		attributes[n].value = (float)w0;
+		attributes[n].dvdx = (float)((w1 - w0) / width);
+		attributes[n++].dvdy = 0;
+		for (i = 0; i < 2; i++, n++) {
+			double u0 = frand(0, 4), u1 = frand(0, 4);
+			attributes[n].value = (float)(u0 * w0);
+			attributes[n].dvdx = (float)((u1 * w1 - u0 * w0) / width);
+			attributes[n].dvdy = 0;
+		}
+	}
+	for (i = 0; i < n; i++)
+		attributes[i].next = i + 1 < n ? &attributes[i + 1] : NULL;
+	face.attributes = attributes;
+	face.texture = hasSTW ? &texture : NULL;
+}
+
+static int
+checkEquivalence(b3dPixelDrawer *scalar, b3dPixelDrawer *vector, int spans)
+{
+	static unsigned int expected[SPAN_BUFFER_SIZE];
+	int failures = 0, s, i;
+
+	for (s = 0; s < spans; s++) {
+		int which = rand() % NUM_SHADERS;
+		int shader = shaders[which].index;
+		int length = 1 + rand() % (s & 1 ? 40 : 600);
+		int leftX = rand() % (SPAN_BUFFER_SIZE - length);
+		int yValue = rand() % 8;
+
+		if (rand() & 1)
+			setTexture(64 << (rand() % 3), 32 << (rand() % 3));
+		else
+			setTexture(50 + rand() % 150, 20 + rand() % 200);
+		vertex.rasterPos[0] = (float)leftX;
+		setFace(shader, length);
+
+		memset(spanBuffer, 0x5A, sizeof(spanBuffer));
+		scalar[shader](leftX, leftX + length - 1, yValue, &face);
+		memcpy(expected, spanBuffer, sizeof(spanBuffer));
+		memset(spanBuffer, 0x5A, sizeof(spanBuffer));
+		vector[shader](leftX, leftX + length - 1, yValue, &face);
+		for (i = 0; i < SPAN_BUFFER_SIZE; i++)
+			if (spanBuffer[i] != expected[i]) {
+				if (failures++ < 10)
+					printf("  %s span %d..%d differs at %d: %08x, expected %08x\n",
+						   shaders[which].name, leftX, leftX + length - 1, i,
+						   spanBuffer[i], expected[i]);
+				break;
+			}
+	}
+	printf("%d random spans: %d differ\n", spans, failures);
+	return failures;
+}
+
+/* Mpixels/s of one shader filling spans of the given width */
+static double
+spanRate(b3dPixelDrawer drawer, int shader, int width, double seconds)
+{
+	double start = now(), elapsed;
+	long pixels = 0;
+	int i;
+
+	setTexture(TEXTURE_SIZE, TEXTURE_SIZE);
+	vertex.rasterPos[0] = 0;
+	setFace(shader, width);
+	do {
+		for (i = 0; i < 1000; i++)
+			drawer(0, width - 1, i & 7, &face);
+		pixels += 1000L * width;
+	} while ((elapsed = now() - start) < seconds);
+	return pixels / elapsed / 1e6;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int spans = 200000, width = 512, i;
+	double seconds = 1;
+	b3dPixelDrawer *scalar, *vector;
+	int failures;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-spans") && i + 1 < argc)
+			spans = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-width") && i + 1 < argc)
+			width = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seconds") && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-spans n] [-width n] [-seconds n]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (width < 1 || width > SPAN_BUFFER_SIZE) {
+		fprintf(stderr, "width must be 1..%d\n", SPAN_BUFFER_SIZE);
+		return 2;
+	}
+
+	srand(1);
+	for (i = 0; i < TEXTURE_SIZE * TEXTURE_SIZE; i++)
+		textureBits[i] = ((unsigned)rand() << 16) ^ (unsigned)rand();
+	face.v0 = face.v1 = face.v2 = &vertex;
+	state.spanBuffer = spanBuffer;
+	state.spanSize = SPAN_BUFFER_SIZE;
+	currentState = &state;
+
+	b3dSetFillMode(B3D_FILL_SCALAR);
+	scalar = b3dFillFunctionsFor(&state);
+	b3dSetFillMode(B3D_FILL_DEFAULT);
+	vector = b3dFillFunctionsFor(&state);
+	if (scalar == vector) {
+		printf("The vectorized span shaders are not available\n");
+		return 1;
+	}
+
+	failures = checkEquivalence(scalar, vector, spans);
+
+	printf("%-8s %10s %10s   (Mpixels/s, %d pixel spans)\n", "shader", "scalar", "vector", width);
+	for (i = 0; i < (int)NUM_SHADERS; i++) {
+		int shader = shaders[i].index;
+		printf("%-8s %10.1f %10.1f\n", shaders[i].name,
+			   spanRate(scalar[shader], shader, width, seconds),
+			   spanRate(vector[shader], shader, width, seconds));
+	}
+	printf("%s\n", failures ? "FAILURE" : "SUCCESS");
+	return failures ? 1 : 0;
+}
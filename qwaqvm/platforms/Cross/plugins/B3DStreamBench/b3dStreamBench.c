@@ -0,0 +1,537 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  b3dStreamBench.c
+ *  B3DStreamBench
+ *
+ *  Command-line check and benchmark of the OpenGL B3D accelerator's retained
+ *  vertex and index buffers, against the client arrays that the image
+ *  otherwise sends with every draw, and of its texture rectangle uploads:
+ *
+ *      b3dStreamBench [-triangles n] [-texture n] [-frames n] [-dirty percent]
+ *
+ *  A grid mesh of about -triangles triangles is drawn once from client arrays
+ *  and once from buffers, and the two images must be identical.  The range
+ *  checks must refuse draws, updates and buffer states that go beyond the
+ *  buffers.  Then -frames frames are timed for each of:
+ *
+ *      static   client arrays every frame vs. buffers uploaded once
+ *      dynamic  -dirty percent of the vertices change every frame: client
+ *               arrays vs. b3dxUpdateBuffer() of the dirty range
+ *      texture  -dirty percent of a -texture pixels square texture changes
+ *               every frame, in a few rectangles: the whole texture with
+ *               glUploadTexture() vs. b3dxUploadTextureRects() of the
+ *               rectangles, directly and streamed through pixel buffers
+ *
+ *  Before that, rectangle uploads must leave the texture equal to the bits,
+ *  for rectangles that are partly or (with values near INT_MIN/INT_MAX)
+ *  hugely outside the texture too.
+ *
+ *  The renderer is the plugin's own (sqOpenGLRenderer.c and sqUnixOpenGL.c);
+ *  the display module's ioGL* functions are supplied here on an EGL pbuffer,
+ *  so no window system is needed (with Mesa and no display, run it with
+ *  EGL_PLATFORM=surfaceless).  Software GL drivers have no bus to save
+ *  transfers over, so the differences only show on hardware.  Exits non-zero
+ *  if a check fails.
+ *
+ *  It is built from the plugin's sources with the unix build's config.h,
+ *  e.g. from the build directory:
+ *
+ *      gcc -O2 -I. -I<src>/platforms/Cross/vm -I<src>/platforms/unix/vm
+ *          -I<src>/platforms/Cross/plugins/B3DAcceleratorPlugin
+ *          -I<src>/platforms/unix/plugins/B3DAcceleratorPlugin
+ *          <src>/platforms/Cross/plugins/B3DStreamBench/b3dStreamBench.c
+ *          <src>/platforms/Cross/plugins/B3DAcceleratorPlugin/sqOpenGLRenderer.c
+ *          <src>/platforms/unix/plugins/B3DAcceleratorPlugin/sqUnixOpenGL.c
+ *          -lEGL -lGL -o b3dStreamBench
+ */
+
+#include "sq.h"
+#include "B3DAcceleratorPlugin.h"
+#include "sqOpenGLRenderer.h"
+#include "SqDisplay.h"
+
+#include <EGL/egl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#define WIDTH 512
+#define HEIGHT 512
+
+int verboseLevel = 0;
+struct VirtualMachine *interpreterProxy = NULL;
+
+static int failures = 0;
+
+static void
+check(const char *what, int ok)
+{
+	if (!ok) {
+		printf("  FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+static double
+now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+/* The display module's part of the renderer, on EGL pbuffers */
+
+static EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+static EGLConfig eglConfig;
+
+static sqInt
+benchGLinitialise(void)
+{
+	static const EGLint attributes[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 16,
+		EGL_NONE
+	};
+	EGLint count;
+
+	if (eglDisplay != EGL_NO_DISPLAY) return 1;
+	eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL)) return 0;
+	if (!eglBindAPI(EGL_OPENGL_API)) return 0;
+	return eglChooseConfig(eglDisplay, attributes, &eglConfig, 1, &count) && count == 1;
+}
+
+static sqInt
+benchGLcreateRenderer(glRenderer *r, sqInt x, sqInt y, sqInt w, sqInt h, sqInt flags)
+{
+	EGLint surfaceAttributes[] = { EGL_WIDTH, 0, EGL_HEIGHT, 0, EGL_NONE };
+
+	surfaceAttributes[1] = w;
+	surfaceAttributes[3] = h;
+	r->drawable = eglCreatePbufferSurface(eglDisplay, eglConfig, surfaceAttributes);
+	if (r->drawable == EGL_NO_SURFACE) return 0;
+	r->context = eglCreateContext(eglDisplay, eglConfig, EGL_NO_CONTEXT, NULL);
+	if (r->context == EGL_NO_CONTEXT) {
+		eglDestroySurface(eglDisplay, r->drawable);
+		return 0;
+	}
+	return 1;
+}
+
+static sqInt
+benchGLmakeCurrentRenderer(glRenderer *r)
+{
+	if (!r) return eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	return eglMakeCurrent(eglDisplay, r->drawable, r->drawable, r->context);
+}
+
+static void
+benchGLdestroyRenderer(glRenderer *r)
+{
+	eglDestroyContext(eglDisplay, r->context);
+	eglDestroySurface(eglDisplay, r->drawable);
+}
+
+static void
+benchGLswapBuffers(glRenderer *r)
+{
+	eglSwapBuffers(eglDisplay, r->drawable);
+}
+
+static void
+benchGLsetBufferRect(glRenderer *r, sqInt x, sqInt y, sqInt w, sqInt h)
+{
+}
+
+static struct SqDisplay display;
+
+struct SqDisplay *
+ioGetDisplayModule(void)
+{
+	display.ioGLinitialise = benchGLinitialise;
+	display.ioGLcreateRenderer = benchGLcreateRenderer;
+	display.ioGLmakeCurrentRenderer = benchGLmakeCurrentRenderer;
+	display.ioGLdestroyRenderer = benchGLdestroyRenderer;
+	display.ioGLswapBuffers = benchGLswapBuffers;
+	display.ioGLsetBufferRect = benchGLsetBufferRect;
+	return &display;
+}
+
+
+/* A grid of quads in clip space, two triangles each */
+
+typedef struct Mesh {
+	int nVertices, nIndices;
+	float *vertices, *colors, *normals;
+	unsigned int *indices;
+} Mesh;
+
+static void
+makeMesh(Mesh *mesh, int triangles)
+{
+	int n = 1, i, j, k;
+
+	while (2 * n * n < triangles) n++;
+	mesh->nVertices = (n + 1) * (n + 1);
+	mesh->nIndices = 6 * n * n;
+	mesh->vertices = (float*) malloc(mesh->nVertices * 3 * sizeof(float));
+	mesh->colors = (float*) malloc(mesh->nVertices * 4 * sizeof(float));
+	mesh->normals = (float*) malloc(mesh->nVertices * 3 * sizeof(float));
+	mesh->indices = (unsigned int*) malloc(mesh->nIndices * sizeof(unsigned int));
+	for (j = 0, k = 0; j <= n; j++)
+		for (i = 0; i <= n; i++, k++) {
+			mesh->vertices[3*k] = -0.95f + 1.9f * i / n;
+			mesh->vertices[3*k+1] = -0.95f + 1.9f * j / n;
+			mesh->vertices[3*k+2] = 0.1f * ((i + j) % 5) / 5;
+			mesh->colors[4*k] = (float) i / n;
+			mesh->colors[4*k+1] = (float) j / n;
+			mesh->colors[4*k+2] = (float) ((i * 7 + j * 3) % 11) / 10;
+			mesh->colors[4*k+3] = 1;
+			mesh->normals[3*k] = mesh->normals[3*k+1] = 0;
+			mesh->normals[3*k+2] = 1;
+		}
+	for (j = 0, k = 0; j < n; j++)
+		for (i = 0; i < n; i++) {
+			unsigned int v = j * (n + 1) + i;
+			mesh->indices[k++] = v;
+			mesh->indices[k++] = v + 1;
+			mesh->indices[k++] = v + n + 1;
+			mesh->indices[k++] = v + 1;
+			mesh->indices[k++] = v + n + 2;
+			mesh->indices[k++] = v + n + 1;
+		}
+}
+
+/* Move the z of count vertices starting at first, as an animation would */
+static void
+touchVertices(Mesh *mesh, int first, int count, int frame)
+{
+	int i;
+	for (i = first; i < first + count; i++)
+		mesh->vertices[3*i+2] = 0.1f * ((i + frame) % 7) / 7;
+}
+
+static void
+clearFrame(int handle)
+{
+	glClearViewport(handle, 0xFF202020, 0);
+	glClearDepthBuffer(handle);
+}
+
+static void
+drawClientArrays(int handle, Mesh *mesh)
+{
+	b3dLoadClientState(handle, mesh->vertices, 3, mesh->colors, 4, mesh->normals, 3, NULL, 0);
+	b3dDrawElements(handle, GL_TRIANGLES, mesh->nIndices, mesh->indices);
+}
+
+static unsigned int *
+readFrame(int handle)
+{
+	unsigned int *pixels = (unsigned int*) malloc(WIDTH * HEIGHT * 4);
+	glFinishRenderer(handle);
+	glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	return pixels;
+}
+
+static void
+checkBuffers(int handle, Mesh *mesh, int vtx, int color, int normal, int idx)
+{
+	unsigned int *expected, *actual;
+	unsigned int badIndex;
+	float texCoords[8];
+	int tx;
+
+	printf("Checking buffers against client arrays\n");
+	clearFrame(handle);
+	drawClientArrays(handle, mesh);
+	expected = readFrame(handle);
+	check("client arrays draw the mesh", expected[WIDTH * HEIGHT / 2 + WIDTH / 2] != expected[0]);
+
+	clearFrame(handle);
+	check("load buffer state", b3dxLoadBufferState(handle, vtx, color, normal, 0, 0));
+	check("draw buffer elements", b3dxDrawBufferElements(handle, GL_TRIANGLES, idx, 0, mesh->nIndices));
+	actual = readFrame(handle);
+	check("buffers draw the same pixels", !memcmp(expected, actual, WIDTH * HEIGHT * 4));
+	free(actual);
+
+	clearFrame(handle);
+	check("draw buffer arrays", b3dxDrawBufferArrays(handle, GL_POINTS, 0, mesh->nVertices));
+	free(expected);
+
+	printf("Checking range checks\n");
+	check("elements past the index buffer fail",
+		  !b3dxDrawBufferElements(handle, GL_TRIANGLES, idx, 3, mesh->nIndices));
+	check("elements with a huge first fail",
+		  !b3dxDrawBufferElements(handle, GL_TRIANGLES, idx, INT_MAX / 2, 3));
+	check("arrays past the vertices fail",
+		  !b3dxDrawBufferArrays(handle, GL_POINTS, 1, mesh->nVertices));
+	check("arrays with a huge count fail",
+		  !b3dxDrawBufferArrays(handle, GL_POINTS, 10, INT_MAX - 5));
+	check("an update past the end fails",
+		  !b3dxUpdateBuffer(handle, vtx, INT_MAX - 4, 8, mesh->vertices));
+	check("an index buffer as colors fails",
+		  !b3dxLoadBufferState(handle, vtx, idx, normal, 0, 0));
+	check("an unknown normal buffer fails",
+		  !b3dxLoadBufferState(handle, vtx, color, 9999, 0, 0));
+	tx = b3dxCreateBuffer(handle, B3D_VERTEX_BUFFER, B3D_STATIC_BUFFER, sizeof(texCoords), texCoords);
+	check("a texture coordinate size of 5 fails",
+		  !b3dxLoadBufferState(handle, vtx, color, normal, tx, 5));
+	check("a short texture coordinate buffer limits the vertices",
+		  b3dxLoadBufferState(handle, vtx, color, normal, tx, 2)
+		  && !b3dxDrawBufferArrays(handle, GL_POINTS, 0, 5)
+		  && b3dxDrawBufferArrays(handle, GL_POINTS, 0, 4));
+	b3dxDestroyBuffer(handle, tx);
+	check("destroying a loaded buffer disables buffer draws",
+		  !b3dxDrawBufferArrays(handle, GL_POINTS, 0, 1));
+	check("reload buffer state", b3dxLoadBufferState(handle, vtx, color, normal, 0, 0));
+	drawClientArrays(handle, mesh);
+	check("loading client arrays disables buffer draws",
+		  !b3dxDrawBufferArrays(handle, GL_POINTS, 0, 1));
+	check("reload buffer state", b3dxLoadBufferState(handle, vtx, color, normal, 0, 0));
+	check("the indices are in range", b3dxCheckBufferElements(handle, idx, 0, mesh->nIndices));
+	badIndex = mesh->nVertices;
+	b3dxUpdateBuffer(handle, idx, 4 * 5, 4, &badIndex);
+	check("an index past the vertices is found",
+		  !b3dxCheckBufferElements(handle, idx, 0, mesh->nIndices));
+	check("but not outside the checked range",
+		  b3dxCheckBufferElements(handle, idx, 6, mesh->nIndices - 6));
+	b3dxUpdateBuffer(handle, idx, 4 * 5, 4, mesh->indices + 5);
+}
+
+/* The reference for glClipTextureRect(): clip in 64 bits */
+static int
+clipRect(const int *rect, int w, int h, int r[4])
+{
+	long long left = rect[0], top = rect[1];
+	long long right = left + rect[2], bottom = top + rect[3];
+
+	if (left < 0) left = 0;
+	if (top < 0) top = 0;
+	if (right > w) right = w;
+	if (bottom > h) bottom = h;
+	if (left >= right || top >= bottom) return 0;
+	r[0] = (int)left; r[1] = (int)top; r[2] = (int)(right - left); r[3] = (int)(bottom - top);
+	return 1;
+}
+
+static void
+randomizeBits(unsigned int *bits, int n, int seed)
+{
+	int i;
+	for (i = 0; i < n; i++)
+		bits[i] = (unsigned int)(i * 2654435761u) ^ (unsigned int)(seed * 40503);
+}
+
+/* Change the bits, upload the rectangles, and check that the texture holds
+   the new bits inside the clipped rectangles and the old ones elsewhere */
+static void
+checkRectUpload(int handle, int tex, int size, int *rects, int nRects, int streaming, int seed, const char *what)
+{
+	unsigned int *bits = (unsigned int*) malloc(size * size * 4);
+	unsigned int *expected = (unsigned int*) malloc(size * size * 4);
+	unsigned int *actual = (unsigned int*) malloc(size * size * 4);
+	int i, x, y, r[4];
+
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, expected);
+	randomizeBits(bits, size * size, seed);
+	for (i = 0; i < nRects; i++)
+		if (clipRect(rects + 4 * i, size, size, r))
+			for (y = r[1]; y < r[1] + r[3]; y++)
+				for (x = r[0]; x < r[0] + r[2]; x++)
+					expected[y * size + x] = bits[y * size + x];
+	check(what, b3dxUploadTextureRects(handle, tex, size, size, 32, bits, rects, nRects, streaming));
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, actual);
+	check(what, !memcmp(expected, actual, size * size * 4));
+	free(bits);
+	free(expected);
+	free(actual);
+}
+
+static void
+checkTextureRects(int handle)
+{
+	int size = 256, streaming;
+	unsigned int *bits = (unsigned int*) malloc(size * size * 4);
+	int tex = glAllocateTexture(handle, size, size, 32);
+	int inside[] = { 0, 0, 10, 10,  100, 50, 60, 70,  size - 1, size - 1, 1, 1 };
+	int partly[] = { -20, -5, 40, 30,  200, 240, 100, 100,  -10, 100, 5, 5,  300, 0, 10, 10 };
+	int huge[] = { INT_MAX - 10, 0, 100, 10,  INT_MIN + 5, 0, INT_MAX, 4,
+				   0, 5, 10, INT_MAX,  20, 20, INT_MIN, 5,  INT_MIN, INT_MIN, INT_MAX, INT_MAX };
+
+	printf("Checking texture rectangle uploads\n");
+	randomizeBits(bits, size * size, 0);
+	check("allocate and upload a texture", tex > 0 && glUploadTexture(handle, tex, size, size, 32, bits));
+	for (streaming = 0; streaming < 2; streaming++) {
+		checkRectUpload(handle, tex, size, inside, 3, streaming, 1 + 3 * streaming,
+						streaming ? "streamed rectangles" : "rectangles");
+		checkRectUpload(handle, tex, size, partly, 4, streaming, 2 + 3 * streaming,
+						streaming ? "streamed partly outside rectangles" : "partly outside rectangles");
+		checkRectUpload(handle, tex, size, huge, 5, streaming, 3 + 3 * streaming,
+						streaming ? "streamed huge rectangles" : "huge rectangles");
+	}
+	free(bits);
+}
+
+/* Milliseconds per frame of changing dirty percent of the texture, in four
+   bands, uploading it (all of it, or the rectangles directly or streamed)
+   and compositing it */
+static double
+timeTextureFrames(int handle, int tex, unsigned int *bits, int size, int frames, int dirtyPercent, int how)
+{
+	int rects[16], nRects = 4, frame, i, rows = size * dirtyPercent / 100 / nRects;
+	double start;
+
+	glFinishRenderer(handle);
+	start = now();
+	for (frame = 0; frame < frames; frame++) {
+		for (i = 0; i < nRects; i++) {
+			rects[4*i] = (frame * 37 + i * 101) % (size / 2);
+			rects[4*i+1] = (i * size / nRects + frame * 7) % (size - rows + 1);
+			rects[4*i+2] = size / 2;
+			rects[4*i+3] = rows;
+			randomizeBits(bits + rects[4*i+1] * size, rows * size, frame);
+		}
+		clearFrame(handle);
+		if (how == 0)
+			glUploadTexture(handle, tex, size, size, 32, bits);
+		else
+			b3dxUploadTextureRects(handle, tex, size, size, 32, bits, rects, nRects, how == 2);
+		glCompositeTexture(handle, tex, 0, 0, WIDTH, HEIGHT, 0);
+		glSwapRendererBuffers(handle);
+	}
+	glFinishRenderer(handle);
+	return (now() - start) * 1000 / frames;
+}
+
+/* Milliseconds per frame of drawing the mesh, changing dirty vertices per
+   frame first, from client arrays or from the buffers */
+static double
+timeFrames(int handle, Mesh *mesh, int frames, int dirty, int useBuffers, int vtx, int idx)
+{
+	double start;
+	int frame;
+
+	if (useBuffers) b3dxLoadBufferState(handle, vtx, 0, 0, 0, 0);
+	glFinishRenderer(handle);
+	start = now();
+	for (frame = 0; frame < frames; frame++) {
+		int first = (frame * 997) % (mesh->nVertices - dirty + 1);
+		clearFrame(handle);
+		if (dirty) touchVertices(mesh, first, dirty, frame);
+		if (useBuffers) {
+			if (dirty)
+				b3dxUpdateBuffer(handle, vtx, first * 12, dirty * 12, mesh->vertices + 3 * first);
+			b3dxDrawBufferElements(handle, GL_TRIANGLES, idx, 0, mesh->nIndices);
+		} else {
+			b3dLoadClientState(handle, mesh->vertices, 3, NULL, 0, NULL, 0, NULL, 0);
+			b3dDrawElements(handle, GL_TRIANGLES, mesh->nIndices, mesh->indices);
+		}
+		glSwapRendererBuffers(handle);
+	}
+	glFinishRenderer(handle);
+	return (now() - start) * 1000 / frames;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int triangles = 100000, textureSize = 1024, frames = 50, dirtyPercent = 10, i;
+	int handle, vtx, color, normal, idx, dirty, tex;
+	unsigned int *bits;
+	Mesh mesh;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-triangles") && i + 1 < argc)
+			triangles = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-texture") && i + 1 < argc)
+			textureSize = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-frames") && i + 1 < argc)
+			frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-dirty") && i + 1 < argc)
+			dirtyPercent = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-triangles n] [-texture n] [-frames n] [-dirty percent]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (triangles < 2 || frames < 1 || dirtyPercent < 0 || dirtyPercent > 100
+		|| textureSize < 16 || (textureSize & (textureSize - 1))) {
+		fprintf(stderr, "bad arguments\n");
+		return 2;
+	}
+
+	if (!glInitialize() || (handle = glCreateRendererFlags(0, 0, WIDTH, HEIGHT, B3D_HARDWARE_RENDERER)) < 0) {
+		printf("Cannot create a renderer\n");
+		return 1;
+	}
+	glSetViewport(handle, 0, 0, WIDTH, HEIGHT);
+	printf("GL_RENDERER: %s\n", (const char*) glGetString(GL_RENDERER));
+
+	makeMesh(&mesh, triangles);
+	printf("Mesh: %d vertices, %d triangles\n", mesh.nVertices, mesh.nIndices / 3);
+	vtx = b3dxCreateBuffer(handle, B3D_VERTEX_BUFFER, B3D_DYNAMIC_BUFFER, mesh.nVertices * 12, mesh.vertices);
+	color = b3dxCreateBuffer(handle, B3D_VERTEX_BUFFER, B3D_STATIC_BUFFER, mesh.nVertices * 16, mesh.colors);
+	normal = b3dxCreateBuffer(handle, B3D_VERTEX_BUFFER, B3D_STATIC_BUFFER, mesh.nVertices * 12, mesh.normals);
+	idx = b3dxCreateBuffer(handle, B3D_INDEX_BUFFER, B3D_STATIC_BUFFER, mesh.nIndices * 4, mesh.indices);
+	if (!vtx || !color || !normal || !idx) {
+		printf("Cannot create buffers\n");
+		return 1;
+	}
+
+	checkBuffers(handle, &mesh, vtx, color, normal, idx);
+	checkTextureRects(handle);
+
+	dirty = mesh.nVertices * dirtyPercent / 100;
+	printf("%-8s %14s %14s   (ms per frame, %d frames)\n", "scene", "client arrays", "buffers", frames);
+	printf("%-8s %14.2f %14.2f\n", "static",
+		   timeFrames(handle, &mesh, frames, 0, 0, vtx, idx),
+		   timeFrames(handle, &mesh, frames, 0, 1, vtx, idx));
+	printf("%-8s %14.2f %14.2f   (%d%% of the vertices change)\n", "dynamic",
+		   timeFrames(handle, &mesh, frames, dirty, 0, vtx, idx),
+		   timeFrames(handle, &mesh, frames, dirty, 1, vtx, idx),
+		   dirtyPercent);
+
+	tex = glAllocateTexture(handle, textureSize, textureSize, 32);
+	bits = (unsigned int*) malloc(textureSize * textureSize * 4);
+	randomizeBits(bits, textureSize * textureSize, 0);
+	printf("%-8s %14s %14s %14s\n", "", "whole texture", "rectangles", "streamed");
+	printf("%-8s %14.2f %14.2f %14.2f   (%d%% of %d^2 pixels change)\n", "texture",
+		   timeTextureFrames(handle, tex, bits, textureSize, frames, dirtyPercent, 0),
+		   timeTextureFrames(handle, tex, bits, textureSize, frames, dirtyPercent, 1),
+		   timeTextureFrames(handle, tex, bits, textureSize, frames, dirtyPercent, 2),
+		   dirtyPercent, textureSize);
+	free(bits);
+
+	b3dxDestroyBuffer(handle, vtx);
+	b3dxDestroyBuffer(handle, color);
+	b3dxDestroyBuffer(handle, normal);
+	b3dxDestroyBuffer(handle, idx);
+	glDestroyRenderer(handle);
+	glShutdown();
+	printf("%s\n", failures ? "FAILURE" : "SUCCESS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,329 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  batchXformBench.c
+ *  BatchXformBench
+ *
+ *  Command-line check and benchmark of the CroquetPlugin's batched
+ *  transforms (batchxform.c), the SSE kernels against the scalar ones:
+ *
+ *      batchXformBench [-tests n] [-count n] [-seconds n]
+ *
+ *  First -tests random matrices, each with a batch of random points,
+ *  directions, matrices and boxes, are transformed by both versions, which
+ *  must agree to within float rounding; every box either version answers
+ *  must contain the eight transformed corners of its source box.  Then
+ *  batches of -count elements are transformed for -seconds each, one
+ *  element per call (as the single element primitives do) and all in one
+ *  call, and the rates are reported in M elements/s.  Exits non-zero if any
+ *  check fails, or if the SSE kernels are not compiled in.
+ *
+ *  batchxform.c is included twice, once as compiled for the plugin and
+ *  once with __SSE__ undefined for the scalar versions, so it is built
+ *  from that file alone, e.g. on x86 unix:
+ *
+ *      gcc -O2 -I../CroquetPlugin batchXformBench.c -o batchXformBench -lm
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../CroquetPlugin/batchxform.c"
+
+#ifdef __SSE__
+#define HAVE_SSE_KERNELS 1
+#undef __SSE__
+#else
+#define HAVE_SSE_KERNELS 0
+#endif
+
+#undef LOAD_COLUMNS
+#undef STORE3
+#define transformPoints scalarTransformPoints
+#define transformDirections scalarTransformDirections
+#define transformMatrices scalarTransformMatrices
+#define transformBoxes scalarTransformBoxes
+void transformPoints(float *matrix, float *src, float *dst, int count);
+void transformDirections(float *matrix, float *src, float *dst, int count);
+void transformMatrices(float *m1, int m1Step, float *m2, float *m3, int count);
+void transformBoxes(float *matrix, float *src, float *dst, int count);
+#include "../CroquetPlugin/batchxform.c"
+#undef transformPoints
+#undef transformDirections
+#undef transformMatrices
+#undef transformBoxes
+
+#define MAX_BATCH 64
+
+typedef void (*vectorKernel)(float *matrix, float *src, float *dst, int count);
+
+static double
+frand(double lo, double hi)
+{
+	return lo + (hi - lo) * (rand() / (double)RAND_MAX);
+}
+
+static double
+now(void)
+{
+	return clock() / (double)CLOCKS_PER_SEC;
+}
+
+static void
+randomFloats(float *v, int n, double lo, double hi)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		v[i] = (float)frand(lo, hi);
+}
+
+/* A random affine matrix, made projective with a bottom row that keeps w
+   in 0.5..2 for the coordinates used here */
+static void
+randomMatrix(float *m, int projective)
+{
+	randomFloats(m, 12, -2, 2);
+	if (projective) {
+		randomFloats(m + 12, 3, -0.03, 0.03);
+		m[15] = (float)frand(0.8, 1.2);
+	} else {
+		m[12] = m[13] = m[14] = 0;
+		m[15] = 1;
+	}
+}
+
+static int
+nearlyEqual(float a, float b, float scale)
+{
+	return fabs(a - b) <= 1e-5 * (1 + scale);
+}
+
+static int
+sameFloats(const char *what, float *a, float *b, int n, float scale)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (!nearlyEqual(a[i], b[i], scale + fabs(b[i]))) {
+			printf("  %s element %d: SSE %.9g, scalar %.9g\n", what, i, a[i], b[i]);
+			return 0;
+		}
+	return 1;
+}
+
+/* every corner of src's boxes, transformed as a point, must be in dst's */
+static int
+boxesContainCorners(const char *what, float *matrix, float *src, float *dst, int count)
+{
+	float corners[8 * 3], xformed[8 * 3];
+	int i, c, k;
+
+	for (i = 0; i < count; i++, src += 6, dst += 6) {
+		for (c = 0; c < 8; c++)
+			for (k = 0; k < 3; k++)
+				corners[c * 3 + k] = src[(c >> k & 1) ? k + 3 : k];
+		scalarTransformPoints(matrix, corners, xformed, 8);
+		for (c = 0; c < 8; c++)
+			for (k = 0; k < 3; k++) {
+				float v = xformed[c * 3 + k], slack = 1e-5 * (1 + fabs(v));
+				if (v < dst[k] - slack || v > dst[k + 3] + slack) {
+					printf("  %s box %d: corner %d %c = %.9g outside %.9g..%.9g\n",
+						   what, i, c, "xyz"[k], v, dst[k], dst[k + 3]);
+					return 0;
+				}
+			}
+	}
+	return 1;
+}
+
+static int
+checkEquivalence(int tests)
+{
+	static float src[MAX_BATCH * 16], sse[MAX_BATCH * 16], scalar[MAX_BATCH * 16];
+	static float m1[MAX_BATCH * 16];
+	float matrix[16];
+	int failures = 0, t, i;
+
+	for (t = 0; t < tests; t++) {
+		int count = 1 + rand() % MAX_BATCH;
+		int ok = 1;
+
+		/* points, projective half the time, and once in a while with w = 0 */
+		randomMatrix(matrix, t & 1);
+		if (t % 97 == 0) {
+			matrix[12] = matrix[13] = matrix[14] = 0;
+			matrix[15] = 0;
+		}
+		randomFloats(src, count * 3, -10, 10);
+		transformPoints(matrix, src, sse, count);
+		scalarTransformPoints(matrix, src, scalar, count);
+		ok &= sameFloats("point", sse, scalar, count * 3, 100);
+
+		randomFloats(src, count * 3, -10, 10);
+		transformDirections(matrix, src, sse, count);
+		scalarTransformDirections(matrix, src, scalar, count);
+		ok &= sameFloats("direction", sse, scalar, count * 3, 100);
+
+		/* matrices, with one m1 for all and with one each */
+		randomFloats(m1, count * 16, -2, 2);
+		randomFloats(src, count * 16, -2, 2);
+		for (i = 0; i < 2; i++) {
+			transformMatrices(m1, i ? 16 : 0, src, sse, count);
+			scalarTransformMatrices(m1, i ? 16 : 0, src, scalar, count);
+			ok &= sameFloats("matrix", sse, scalar, count * 16, 10);
+		}
+
+		/* boxes, affine only; some empty and some flat */
+		randomMatrix(matrix, 0);
+		for (i = 0; i < count; i++) {
+			float *box = src + i * 6;
+			int k;
+			for (k = 0; k < 3; k++) {
+				box[k] = (float)frand(-10, 10);
+				box[k + 3] = rand() % 8 ? box[k] + (float)frand(0, 10) : box[k];
+			}
+		}
+		transformBoxes(matrix, src, sse, count);
+		scalarTransformBoxes(matrix, src, scalar, count);
+		ok &= sameFloats("box", sse, scalar, count * 6, 100);
+		ok &= boxesContainCorners("SSE", matrix, src, sse, count);
+		ok &= boxesContainCorners("scalar", matrix, src, scalar, count);
+
+		/* in place must give the same answer */
+		memcpy(sse, src, count * 6 * sizeof(float));
+		transformBoxes(matrix, sse, sse, count);
+		transformBoxes(matrix, src, scalar, count);
+		ok &= sameFloats("in place box", sse, scalar, count * 6, 0);
+
+		if (!ok && failures++ < 10)
+			printf("  test %d (%d elements) failed\n", t, count);
+	}
+	printf("%d random batches: %d failed\n", tests, failures);
+	return failures;
+}
+
+/* M elements/s of a kernel called once per element or once per batch */
+static double
+vectorRate(vectorKernel kernel, float *matrix, float *src, float *dst,
+		   int width, int count, int perElement, double seconds)
+{
+	double start = now(), elapsed;
+	long done = 0;
+	int i;
+
+	do {
+		if (perElement)
+			for (i = 0; i < count; i++)
+				kernel(matrix, src + i * width, dst + i * width, 1);
+		else
+			kernel(matrix, src, dst, count);
+		done += count;
+	} while ((elapsed = now() - start) < seconds);
+	return done / elapsed / 1e6;
+}
+
+static double
+matrixRate(void (*kernel)(float *, int, float *, float *, int), float *m1, float *src,
+		   float *dst, int count, int perElement, double seconds)
+{
+	double start = now(), elapsed;
+	long done = 0;
+	int i;
+
+	do {
+		if (perElement)
+			for (i = 0; i < count; i++)
+				kernel(m1, 0, src + i * 16, dst + i * 16, 1);
+		else
+			kernel(m1, 0, src, dst, count);
+		done += count;
+	} while ((elapsed = now() - start) < seconds);
+	return done / elapsed / 1e6;
+}
+
+int
+main(int argc, char *argv[])
+{
+	static const struct {
+		const char *name;
+		vectorKernel sse, scalar;
+		int width;
+	} kernels[] = {
+		{ "points", transformPoints, scalarTransformPoints, 3 },
+		{ "directions", transformDirections, scalarTransformDirections, 3 },
+		{ "boxes", transformBoxes, scalarTransformBoxes, 6 },
+	};
+	int tests = 20000, count = 100000, failures, i;
+	double seconds = 0.5;
+	float matrix[16], *src, *dst;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-tests") && i + 1 < argc)
+			tests = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-count") && i + 1 < argc)
+			count = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seconds") && i + 1 < argc)
+			seconds = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-tests n] [-count n] [-seconds n]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (count < 1 || count > 10000000) {
+		fprintf(stderr, "count must be 1..10000000\n");
+		return 2;
+	}
+	if (!HAVE_SSE_KERNELS) {
+		printf("The SSE kernels are not available\n");
+		return 1;
+	}
+
+	srand(1);
+	failures = checkEquivalence(tests);
+
+	src = malloc(count * 16 * sizeof(float));
+	dst = malloc(count * 16 * sizeof(float));
+	if (!src || !dst) {
+		fprintf(stderr, "out of memory\n");
+		return 2;
+	}
+	randomFloats(src, count * 16, -10, 10);
+	randomMatrix(matrix, 0);
+
+	printf("%-11s %12s %12s %12s %12s   (M elements/s, %d per batch)\n", "",
+		   "scalar 1", "scalar all", "SSE 1", "SSE all", count);
+	for (i = 0; i < (int)(sizeof(kernels) / sizeof(kernels[0])); i++)
+		printf("%-11s %12.1f %12.1f %12.1f %12.1f\n", kernels[i].name,
+			   vectorRate(kernels[i].scalar, matrix, src, dst, kernels[i].width, count, 1, seconds),
+			   vectorRate(kernels[i].scalar, matrix, src, dst, kernels[i].width, count, 0, seconds),
+			   vectorRate(kernels[i].sse, matrix, src, dst, kernels[i].width, count, 1, seconds),
+			   vectorRate(kernels[i].sse, matrix, src, dst, kernels[i].width, count, 0, seconds));
+	printf("%-11s %12.1f %12.1f %12.1f %12.1f\n", "matrices",
+		   matrixRate(scalarTransformMatrices, matrix, src, dst, count, 1, seconds),
+		   matrixRate(scalarTransformMatrices, matrix, src, dst, count, 0, seconds),
+		   matrixRate(transformMatrices, matrix, src, dst, count, 1, seconds),
+		   matrixRate(transformMatrices, matrix, src, dst, count, 0, seconds));
+
+	free(src);
+	free(dst);
+	printf("%s\n", failures ? "FAILURE" : "SUCCESS");
+	return failures ? 1 : 0;
+}
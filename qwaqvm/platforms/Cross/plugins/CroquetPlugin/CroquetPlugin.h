@@ -24,8 +24,22 @@ int ioGatherEntropy(char *bufPtr, int bufSize);
 int triBoxOverlap(float minCorner[3],float maxCorner[3],
 		  float vert0[3], float vert1[3], float vert2[3]);
 
+/* Imported from batchxform.c. Batched Matrix4x4 transforms of packed
+   xyz points and directions, of matrices (m3[i] = m1[i] * m2[i], with
+   m1Step 0 to use the same m1 for all), and of boxes given as min xyz,
+   max xyz (affine matrices only). */
+void transformPoints(float *matrix, float *src, float *dst, int count);
+void transformDirections(float *matrix, float *src, float *dst, int count);
+void transformMatrices(float *m1, int m1Step, float *m2, float *m3, int count);
+void transformBoxes(float *matrix, float *src, float *dst, int count);
+
 /* In-place rearrangement of vertex indices to improve
    vertex cache locality. */		  
 int optimizeVertexIndices(int* indices, int triCount);
 
+/* Renumber vertices in order of first use by the indices (rewritten
+   in-place); remap[old] receives the new index or -1 if unused. Returns
+   the number of vertices used or -1 on error. */
+int optimizeVertexFetch(int* indices, int triCount, int* remap, int vertexCount);
+
 #endif /* CROQUET_PLUGIN_H */
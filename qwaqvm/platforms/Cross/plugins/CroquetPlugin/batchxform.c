@@ -0,0 +1,190 @@
+/*
+ *  batchxform.c
+ *  CroquetPlugin
+ *
+ *  Batched versions of the Matrix4x4 point, direction and matrix
+ *  transforms, plus transformed bounding boxes, for scene graph updates
+ *  that touch many objects per frame.
+ *
+ *  Matrices are 16 floats in row-major order as in Matrix4x4; points and
+ *  directions are packed x, y, z triples; boxes are min x, y, z followed
+ *  by max x, y, z. Sources and destinations may be the same array.
+ *
+ *  The SSE kernels compute in single precision while the scalar code
+ *  (and the single element primitives) use doubles, so results may
+ *  differ in the last bit.
+ */
+
+#include <math.h>
+
+#include "CroquetPlugin.h"
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+
+/* column j of the matrix: m[j], m[4+j], m[8+j], m[12+j] */
+#define LOAD_COLUMNS(m, c0, c1, c2, c3) do { \
+	__m128 r0_ = _mm_loadu_ps((m)); \
+	__m128 r1_ = _mm_loadu_ps((m) + 4); \
+	__m128 r2_ = _mm_loadu_ps((m) + 8); \
+	__m128 r3_ = _mm_loadu_ps((m) + 12); \
+	_MM_TRANSPOSE4_PS(r0_, r1_, r2_, r3_); \
+	c0 = r0_; c1 = r1_; c2 = r2_; c3 = r3_; \
+} while(0)
+
+/* store x, y, z of v without touching the following float */
+#define STORE3(p, v) do { \
+	_mm_storel_pi((__m64*)(p), (v)); \
+	_mm_store_ss((p) + 2, _mm_movehl_ps((v), (v))); \
+} while(0)
+
+void transformPoints(float *matrix, float *src, float *dst, int count)
+{
+	__m128 c0, c1, c2, c3, one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+	int i;
+
+	LOAD_COLUMNS(matrix, c0, c1, c2, c3);
+	for(i = 0; i < count; i++, src += 3, dst += 3) {
+		__m128 r = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(src[0])), _mm_mul_ps(c1, _mm_set1_ps(src[1]))),
+			_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(src[2])), c3));
+		__m128 w = _mm_shuffle_ps(r, r, _MM_SHUFFLE(3,3,3,3));
+		if(_mm_comineq_ss(w, one)) {
+			/* projective; a zero w collapses the point like the primitive does */
+			__m128 nonZero = _mm_cmpneq_ps(w, zero);
+			r = _mm_and_ps(_mm_div_ps(r, w), nonZero);
+		}
+		STORE3(dst, r);
+	}
+}
+
+void transformDirections(float *matrix, float *src, float *dst, int count)
+{
+	__m128 c0, c1, c2, c3;
+	int i;
+
+	LOAD_COLUMNS(matrix, c0, c1, c2, c3);
+	(void) c3; /* directions ignore the translation */
+	for(i = 0; i < count; i++, src += 3, dst += 3) {
+		__m128 r = _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(src[0])), _mm_mul_ps(c1, _mm_set1_ps(src[1]))),
+			_mm_mul_ps(c2, _mm_set1_ps(src[2])));
+		STORE3(dst, r);
+	}
+}
+
+void transformMatrices(float *m1, int m1Step, float *m2, float *m3, int count)
+{
+	int i, row;
+
+	for(i = 0; i < count; i++, m1 += m1Step, m2 += 16, m3 += 16) {
+		__m128 b0 = _mm_loadu_ps(m2);
+		__m128 b1 = _mm_loadu_ps(m2 + 4);
+		__m128 b2 = _mm_loadu_ps(m2 + 8);
+		__m128 b3 = _mm_loadu_ps(m2 + 12);
+		for(row = 0; row < 16; row += 4) {
+			__m128 r = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m1[row]), b0), _mm_mul_ps(_mm_set1_ps(m1[row+1]), b1)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(m1[row+2]), b2), _mm_mul_ps(_mm_set1_ps(m1[row+3]), b3)));
+			_mm_storeu_ps(m3 + row, r);
+		}
+	}
+}
+
+void transformBoxes(float *matrix, float *src, float *dst, int count)
+{
+	__m128 c0, c1, c2, c3;
+	int i;
+
+	LOAD_COLUMNS(matrix, c0, c1, c2, c3);
+	for(i = 0; i < count; i++, src += 6, dst += 6) {
+		__m128 a0 = _mm_mul_ps(c0, _mm_set1_ps(src[0]));
+		__m128 b0 = _mm_mul_ps(c0, _mm_set1_ps(src[3]));
+		__m128 a1 = _mm_mul_ps(c1, _mm_set1_ps(src[1]));
+		__m128 b1 = _mm_mul_ps(c1, _mm_set1_ps(src[4]));
+		__m128 a2 = _mm_mul_ps(c2, _mm_set1_ps(src[2]));
+		__m128 b2 = _mm_mul_ps(c2, _mm_set1_ps(src[5]));
+		__m128 lo = _mm_add_ps(
+			_mm_add_ps(_mm_min_ps(a0, b0), _mm_min_ps(a1, b1)),
+			_mm_add_ps(_mm_min_ps(a2, b2), c3));
+		__m128 hi = _mm_add_ps(
+			_mm_add_ps(_mm_max_ps(a0, b0), _mm_max_ps(a1, b1)),
+			_mm_add_ps(_mm_max_ps(a2, b2), c3));
+		STORE3(dst, lo);
+		STORE3(dst + 3, hi);
+	}
+}
+
+#else /* !__SSE__ */
+
+void transformPoints(float *matrix, float *src, float *dst, int count)
+{
+	float *m = matrix;
+	int i;
+
+	for(i = 0; i < count; i++, src += 3, dst += 3) {
+		double x = src[0], y = src[1], z = src[2];
+		double rx = x*m[0] + y*m[1] + z*m[2] + m[3];
+		double ry = x*m[4] + y*m[5] + z*m[6] + m[7];
+		double rz = x*m[8] + y*m[9] + z*m[10] + m[11];
+		double rw = x*m[12] + y*m[13] + z*m[14] + m[15];
+		if(rw != 1.0) {
+			rw = rw == 0.0 ? 0.0 : 1.0 / rw;
+			rx *= rw; ry *= rw; rz *= rw;
+		}
+		dst[0] = (float) rx;
+		dst[1] = (float) ry;
+		dst[2] = (float) rz;
+	}
+}
+
+void transformDirections(float *matrix, float *src, float *dst, int count)
+{
+	float *m = matrix;
+	int i;
+
+	for(i = 0; i < count; i++, src += 3, dst += 3) {
+		double x = src[0], y = src[1], z = src[2];
+		dst[0] = (float) (x*m[0] + y*m[1] + z*m[2]);
+		dst[1] = (float) (x*m[4] + y*m[5] + z*m[6]);
+		dst[2] = (float) (x*m[8] + y*m[9] + z*m[10]);
+	}
+}
+
+void transformMatrices(float *m1, int m1Step, float *m2, float *m3, int count)
+{
+	int i, row, col;
+
+	for(i = 0; i < count; i++, m1 += m1Step, m2 += 16, m3 += 16) {
+		for(row = 0; row < 16; row += 4) {
+			double a0 = m1[row], a1 = m1[row+1], a2 = m1[row+2], a3 = m1[row+3];
+			for(col = 0; col < 4; col++)
+				m3[row+col] = (float) (a0*m2[col] + a1*m2[col+4] + a2*m2[col+8] + a3*m2[col+12]);
+		}
+	}
+}
+
+void transformBoxes(float *matrix, float *src, float *dst, int count)
+{
+	float *m = matrix;
+	int i, row, col;
+
+	for(i = 0; i < count; i++, src += 6, dst += 6) {
+		double lo[3], hi[3];
+		for(row = 0; row < 3; row++) {
+			lo[row] = hi[row] = m[row*4+3];
+			for(col = 0; col < 3; col++) {
+				double a = m[row*4+col] * src[col];
+				double b = m[row*4+col] * src[col+3];
+				if(a < b) { lo[row] += a; hi[row] += b; }
+				else { lo[row] += b; hi[row] += a; }
+			}
+		}
+		for(row = 0; row < 3; row++) {
+			dst[row] = (float) lo[row];
+			dst[row+3] = (float) hi[row];
+		}
+	}
+}
+
+#endif /* __SSE__ */
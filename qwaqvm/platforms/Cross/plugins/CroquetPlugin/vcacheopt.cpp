@@ -12,6 +12,7 @@
 #ifdef WIN32
  extern "C" {
 	int optimizeVertexIndices(int* indices, int triCount) { return -1; }
+	int optimizeVertexFetch(int* indices, int triCount, int* remap, int vertexCount) { return -1; }
 }
 #else
 
@@ -23,6 +24,11 @@ extern "C" {
 		VertexCacheOptimizer vco;
 		return (int) vco.Optimize(indices, triCount);	
 	}	
+
+	int optimizeVertexFetch(int* indices, int triCount, int* remap, int vertexCount)
+	{
+		return VertexCacheOptimizer::OptimizeFetch(indices, triCount, remap, vertexCount);
+	}
 }
 
 #endif
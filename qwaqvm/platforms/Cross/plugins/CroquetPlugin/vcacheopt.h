@@ -28,65 +28,8 @@
 #include <math.h>
 #include <assert.h>
 
-class VertexCacheData
-{
-public:
-	int position_in_cache;
-	float current_score;
-	int total_valence; // toatl number of triangles using this vertex
-	int remaining_valence; // number of triangles using it but not yet rendered
-	std::vector<int> tri_indices; // indices to the indices that use this vertex
-	bool calculated; // was the score calculated during this iteration?
-
-
-	int FindTriangle(int tri)
-	{
-		for (int i=0; i<(int)tri_indices.size(); i++)
-		{
-			if (tri_indices[i] == tri) return i;
-		}
-
-		return -1;
-	}
-
-	void MoveTriangleToEnd(int tri)
-	{
-		int t_ind = FindTriangle(tri);
-
-		assert(t_ind >= 0);
-
-		tri_indices.erase(tri_indices.begin() + t_ind,
-			tri_indices.begin() + t_ind + 1);
-
-		tri_indices.push_back(tri);
-	}
-
-	VertexCacheData()
-	{
-		position_in_cache = -1;
-		current_score = 0.0f;
-		total_valence = 0;
-		remaining_valence = 0;
-	}
-};
-
-class TriangleCacheData
-{
-public:
-	bool rendered; // has the triangle been added to the draw list yet?
-	float current_score; // sum of the score of its vertices
-	int verts[3]; // indices to the triangle's vertices
-	bool calculated; // was the score calculated during this iteration?
-
-	TriangleCacheData()
-	{
-		rendered = false;
-		current_score = 0.0f;
-		verts[0] = verts[1] = verts[2] = -1;
-		calculated = false;
-	}
-};
-
+// Simulated LRU vertex cache; only used for measuring the cache miss
+// count (ACMR) of an index list.
 class VertexCache
 {
 protected:
@@ -173,6 +116,18 @@ public:
 	}
 };
 
+// Forsyth's linear-speed vertex cache optimizer.
+//
+// All per-vertex and per-triangle state lives in flat arrays that are
+// sized once per Optimize() call. The triangle corners using each vertex
+// are stored in compressed sparse row form: the corners (3 * tri + k) of
+// vertex v are vert_corners[vert_tri_start[v] .. vert_tri_start[v+1]-1],
+// and the first remaining_valence[v] of them belong to triangles not yet
+// drawn. corner_slot[] gives each corner's position in that list so a
+// drawn triangle is moved out of the active part in constant time. Scores are
+// looked up in tables computed from the constants below, and after each
+// triangle only the scores of the vertices whose cache position changed
+// (and of their triangles) are updated.
 class VertexCacheOptimizer
 {
 public:
@@ -194,303 +149,266 @@ public:
 		return r != Success;
 	}
 
+	enum
+	{
+		CacheSize = 32, // size of the simulated cache used for scoring
+		MaxValence = 64 // valences beyond this all score the same
+	};
+
 protected:
-	std::vector<VertexCacheData> verts;
-	std::vector<TriangleCacheData> tris;
-	std::vector<int> inds;
-	int best_tri; // the next triangle to add to the render list
-	VertexCache vertex_cache;
+	// per vertex
+	std::vector<int> vert_tri_start;
+	std::vector<int> vert_corners;
+	std::vector<int> corner_slot;
+	std::vector<int> remaining_valence;
+	std::vector<int> position_in_cache;
+	std::vector<float> vert_score;
+
+	// per triangle
+	std::vector<int> tri_verts;
+	std::vector<float> tri_score;
+	std::vector<char> rendered;
+
 	std::vector<int> draw_list;
 
-	float CalculateVertexScore(int vertex)
+	// LRU cache of the last CacheSize vertices, most recent first; the
+	// extra three slots hold the vertices pushed out by a new triangle
+	int cache[CacheSize + 3];
+	int cache_count;
+
+	float cache_position_score[CacheSize];
+	float valence_score[MaxValence];
+
+	// next triangle to consider when no cached vertex has triangles left
+	int next_unrendered;
+
+	void ComputeScoreTables()
 	{
-		VertexCacheData *v = &verts[vertex];
-		if (v->remaining_valence <= 0)
-		{
-			// No tri needs this vertex!
-			return -1.0f;
-		}
-	 
-		float ret = 0.0f;
-		if (v->position_in_cache < 0)
+		for (int i=0; i<CacheSize; i++)
 		{
-			// Vertex is not in FIFO cache - no score.
-		}
-		else
-		{
-			if (v->position_in_cache < 3)
+			if (i < 3)
 			{
 				// This vertex was used in the last triangle,
 				// so it has a fixed score, whichever of the three
 				// it's in. Otherwise, you can get very different
 				// answers depending on whether you add
 				// the triangle 1,2,3 or 3,1,2 - which is silly.
-				ret = LastTriScore;
+				cache_position_score[i] = LastTriScore;
 			}
 			else
 			{
 				// Points for being high in the cache.
-				const float Scaler = 1.0f / (32  - 3);
-				ret = 1.0f - (v->position_in_cache - 3) * Scaler;
-				ret = powf(ret, CacheDecayPower);
+				const float Scaler = 1.0f / (CacheSize - 3);
+				cache_position_score[i] = powf(1.0f - (i - 3) * Scaler, CacheDecayPower);
 			}
 		}
-	 
+
 		// Bonus points for having a low number of tris still to
 		// use the vert, so we get rid of lone verts quickly.
-		float valence_boost = powf((float)v->remaining_valence, -ValenceBoostPower);
-		ret += ValenceBoostScale * valence_boost;
-	 
-		return ret;
-	}
-
-	// returns the index of the triangle with the highest score
-	// (or -1, if there aren't any active triangles)
-	int FullScoreRecalculation()
-	{
-		// calculate score for all vertices
-		for (int i=0; i<(int)verts.size(); i++)
-		{
-			verts[i].current_score = CalculateVertexScore(i);
-		}
-
-		// calculate scores for all active triangles
-		float max_score;
-		int max_score_tri = -1;
-		bool first_time = true;
-		for (int i=0; i<(int)tris.size(); i++)
+		valence_score[0] = 0.0f;
+		for (int i=1; i<MaxValence; i++)
 		{
-			if (tris[i].rendered) continue;
-			// sum the score of all the triangle's vertices
-			float sc = verts[tris[i].verts[0]].current_score +
-				verts[tris[i].verts[1]].current_score +
-				verts[tris[i].verts[2]].current_score;
-			
-			tris[i].current_score = sc;
-	
-			if (first_time || sc > max_score)
-			{
-				first_time = false;
-				max_score = sc;
-				max_score_tri = i;
-			}
+			valence_score[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
 		}
-
-		return max_score_tri;
 	}
 
-	Result InitialPass()
+	float CalculateVertexScore(int vertex)
 	{
-		for (int i=0; i<(int)inds.size(); i++)
+		int valence = remaining_valence[vertex];
+		if (valence <= 0)
 		{
-			int index = inds[i];
-			if (index < 0 || index >= (int)verts.size()) return Fail_BadIndex;
-
-			verts[index].total_valence++;
-			verts[index].remaining_valence++;
-			
-			verts[index].tri_indices.push_back(i/3);
+			// No tri needs this vertex!
+			return -1.0f;
 		}
 
-		best_tri = FullScoreRecalculation();
+		// Clamping the valence keeps the score of a hub vertex constant
+		// while it stays at the top of the cache, so its many triangles
+		// don't all need updating after every step.
+		int position = position_in_cache[vertex];
+		float ret = position < 0 ? 0.0f : cache_position_score[position];
+		ret += valence_score[valence < MaxValence ? valence : MaxValence - 1];
 
-		return Success;
+		return ret;
 	}
 
 	Result Init(int *inds, int tri_count, int vertex_count)
 	{
-		// clear the draw list
-		draw_list.clear();
+		int index_count = tri_count * 3;
 
-		// allocate and initialize vertices and triangles
-		verts.clear();
-		for (int i=0; i<vertex_count; i++) verts.push_back(VertexCacheData());
-		
-		tris.clear();
-		for (int i=0; i<tri_count; i++)
+		// count the triangles using each vertex and lay out the CSR offsets
+		vert_tri_start.assign(vertex_count + 1, 0);
+		for (int i=0; i<index_count; i++)
 		{
-			TriangleCacheData dat;
-			for (int j=0; j<3; j++)
-			{
-				dat.verts[j] = inds[i * 3 + j];
-			}
-			tris.push_back(dat);
+			int index = inds[i];
+			if (index < 0 || index >= vertex_count) return Fail_BadIndex;
+			vert_tri_start[index + 1]++;
 		}
-
-		// copy the indices
-		this->inds.clear();
-		for (int i=0; i<tri_count * 3; i++) this->inds.push_back(inds[i]);
-
-		vertex_cache.Clear();
-		best_tri = -1;
-
-		return InitialPass();
-	}
-
-	void AddTriangleToDrawList(int tri)
-	{
-		// reset all cache positions
-		for (int i=0; i<32; i++)
+		for (int i=0; i<vertex_count; i++)
 		{
-			int ind = vertex_cache.GetCachedVertex(i);
-			if (ind < 0) continue;
-			verts[ind].position_in_cache = -1;
+			vert_tri_start[i + 1] += vert_tri_start[i];
 		}
 
-		TriangleCacheData *t = &tris[tri];
-		if (t->rendered) return; // triangle is already in the draw list
-	
-		for (int i=0; i<3; i++)
+		remaining_valence.assign(vertex_count, 0);
+		vert_corners.resize(index_count);
+		corner_slot.resize(index_count);
+		for (int i=0; i<index_count; i++)
 		{
-			// add all triangle vertices to the cache
-			vertex_cache.AddVertex(t->verts[i]);
-
-			VertexCacheData *v = &verts[t->verts[i]];
-
-			// decrease remaining velence
-			v->remaining_valence--;
-
-			// move the added triangle to the end of the vertex's
-			// triangle index list, so that the first 'remaining_valence'
-			// triangles in the list are the active ones
-			v->MoveTriangleToEnd(tri);
+			int index = inds[i];
+			int slot = remaining_valence[index]++;
+			vert_corners[vert_tri_start[index] + slot] = i;
+			corner_slot[i] = slot;
 		}
 
-		draw_list.push_back(tri);
-
-		t->rendered = true;
+		position_in_cache.assign(vertex_count, -1);
+		vert_score.resize(vertex_count);
+		for (int i=0; i<vertex_count; i++)
+		{
+			vert_score[i] = CalculateVertexScore(i);
+		}
 
-		// update all vertex cache positions
-		for (int i=0; i<32; i++)
+		tri_verts.assign(inds, inds + index_count);
+		tri_score.resize(tri_count);
+		for (int i=0; i<tri_count; i++)
 		{
-			int ind = vertex_cache.GetCachedVertex(i);
-			if (ind < 0) continue;
-			verts[ind].position_in_cache = i;
+			tri_score[i] = vert_score[inds[3 * i + 0]] +
+				vert_score[inds[3 * i + 1]] +
+				vert_score[inds[3 * i + 2]];
 		}
+		rendered.assign(tri_count, 0);
 
+		draw_list.clear();
+		draw_list.reserve(tri_count);
+		cache_count = 0;
+		next_unrendered = 0;
+
+		return Success;
 	}
 
-	// Optimization: to avoid duplicate calculations durind the same iteration,
-	// both vertices and triangles have a 'calculated' flag. This flag
-	// must be cleared at the beginning of the iteration to all *active* triangles
-	// that have one or more of their vertices currently cached, and all their
-	// other vertices.
-	// If there aren't any active triangles in the cache, the function returns
-	// false and full recalculation is performed.
-	bool CleanCalculationFlags()
+	// returns the index of the undrawn triangle with the highest score
+	int BestTriangle()
 	{
-		bool ret = false;
-		for (int i=0; i<32; i++)
+		float max_score = 0.0f;
+		int max_score_tri = -1;
+		for (int i=0; i<(int)rendered.size(); i++)
 		{
-			int vert = vertex_cache.GetCachedVertex(i);
-			if (vert < 0) continue;
-
-			VertexCacheData *v = &verts[vert];
-
-			for (int j=0; j<v->remaining_valence; j++)
+			if (rendered[i]) continue;
+			if (max_score_tri < 0 || tri_score[i] > max_score)
 			{
-				TriangleCacheData *t = &tris[v->tri_indices[j]];
-
-				// we actually found a triangle to process
-				ret = true;
-
-				// clear triangle flag
-				t->calculated = false;
-
-				// clear vertex flags
-				for (int tri_vert=0; tri_vert<3; tri_vert++)
-				{
-					verts[t->verts[tri_vert]].calculated = false;
-				}
+				max_score = tri_score[i];
+				max_score_tri = i;
 			}
 		}
-
-		return ret;
+		return max_score_tri;
 	}
 
-	void TriangleScoreRecalculation(int tri)
+	// Once no cached vertex has any triangles left, the best candidates
+	// are all scored by valence alone; rather than rescanning the whole
+	// mesh for each of these restarts take the next undrawn triangle in
+	// the original order, which tends to be near the previous one.
+	int NextUnrenderedTriangle()
 	{
-		TriangleCacheData *t = &tris[tri];
-
-		// calculate vertex scores
-		float sum = 0.0f;
-		for (int i=0; i<3; i++)
+		while (next_unrendered < (int)rendered.size() && rendered[next_unrendered])
 		{
-			VertexCacheData *v = &verts[t->verts[i]];
-			float sc = v->current_score;
-			if (!v->calculated)
-			{
-				sc = CalculateVertexScore(t->verts[i]);
-			}
-			v->current_score = sc;
-			v->calculated = true;
-			sum += sc;
+			next_unrendered++;
 		}
+		return next_unrendered < (int)rendered.size() ? next_unrendered : -1;
+	}
 
-		t->current_score = sum;
-		t->calculated = true;
+	// swap the corner to the end of the active part of its vertex's list
+	void RemoveActiveCorner(int vertex, int corner)
+	{
+		int *list = &vert_corners[vert_tri_start[vertex]];
+		int last = --remaining_valence[vertex];
+		int slot = corner_slot[corner];
+		int moved = list[last];
+
+		assert(slot <= last && list[slot] == corner);
+		list[slot] = moved;
+		corner_slot[moved] = slot;
+		list[last] = corner;
+		corner_slot[corner] = last;
 	}
 
-	int PartialScoreRecalculation()
+	// set the vertex's cache position, updating its score and that of
+	// all of its undrawn triangles
+	void UpdateVertex(int vertex, int position)
 	{
-		// iterate through all the vertices of the cache
-		bool first_time = true;
-		float max_score;
-		int max_score_tri = -1;
-		for (int i=0; i<32; i++)
+		position_in_cache[vertex] = position;
+		float score = CalculateVertexScore(vertex);
+		float delta = score - vert_score[vertex];
+		vert_score[vertex] = score;
+		if (delta == 0.0f) return;
+
+		const int *list = &vert_corners[vert_tri_start[vertex]];
+		for (int i=0; i<remaining_valence[vertex]; i++)
 		{
-			int vert = vertex_cache.GetCachedVertex(i);
-			if (vert < 0) continue;
-
-			VertexCacheData *v = &verts[vert];
-
-			// iterate through all *active* triangles of this vertex
-			for (int j=0; j<v->remaining_valence; j++)
-			{
-				int tri = v->tri_indices[j];
-				TriangleCacheData *t = &tris[tri];
-				if (!t->calculated)
-				{
-					// calculate triangle score
-					TriangleScoreRecalculation(tri);
-				}
-				
-				float sc = t->current_score;
-
-				// we actually found a triangle to process
-				if (first_time || sc > max_score)
-				{
-					first_time = false;
-					max_score = sc;
-					max_score_tri = tri;
-				}
-			}
+			tri_score[list[i] / 3] += delta;
 		}
-
-		return max_score_tri;
 	}
 
-	// returns true while there are more steps to take
-	// false when optimization is complete
-	bool Iterate()
+	// adds the triangle to the draw list and answers the next one to add
+	// (or -1 if there isn't any undrawn triangle left)
+	int AddTriangleToDrawList(int tri)
 	{
-		if (draw_list.size() == tris.size()) return false;
+		const int *t = &tri_verts[3 * tri];
+		int new_cache[CacheSize + 3];
+		int new_count = 0;
 
-		// add the selected triangle to the draw list
-		AddTriangleToDrawList(best_tri);
+		draw_list.push_back(tri);
+		rendered[tri] = 1;
 
-		// recalculate vertex and triangle scores and
-		// select the best triangle for the next iteration
-		if (CleanCalculationFlags())
+		// the triangle's vertices go on top of the cache
+		for (int i=0; i<3; i++)
 		{
-			best_tri = PartialScoreRecalculation();
+			int v = t[i];
+			RemoveActiveCorner(v, 3 * tri + i);
+			if (i > 0 && v == t[0]) continue;
+			if (i > 1 && v == t[1]) continue;
+			new_cache[new_count++] = v;
 		}
-		else
+		for (int i=0; i<cache_count; i++)
+		{
+			int v = cache[i];
+			if (v == t[0] || v == t[1] || v == t[2]) continue;
+			new_cache[new_count++] = v;
+		}
+
+		// rescore the cached vertices; the ones pushed out of the cache
+		// lose their position bonus
+		for (int i=0; i<new_count; i++)
+		{
+			UpdateVertex(new_cache[i], i < CacheSize ? i : -1);
+		}
+
+		cache_count = new_count < CacheSize ? new_count : CacheSize;
+		for (int i=0; i<cache_count; i++)
 		{
-			best_tri = FullScoreRecalculation();
+			cache[i] = new_cache[i];
 		}
 
-		return true;
+		// Only triangles of cached vertices can have gained score. For a
+		// high valence vertex looking at some of its triangles is enough;
+		// the ones that also use other cached vertices are found through
+		// those.
+		float max_score = 0.0f;
+		int max_score_tri = -1;
+		for (int i=0; i<cache_count; i++)
+		{
+			int v = cache[i];
+			const int *list = &vert_corners[vert_tri_start[v]];
+			int count = remaining_valence[v] < MaxValence ? remaining_valence[v] : MaxValence;
+			for (int j=0; j<count; j++)
+			{
+				float sc = tri_score[list[j] / 3];
+				if (max_score_tri < 0 || sc > max_score)
+				{
+					max_score = sc;
+					max_score_tri = list[j] / 3;
+				}
+			}
+		}
+
+		return max_score_tri >= 0 ? max_score_tri : NextUnrenderedTriangle();
 	}
 
 public:
@@ -502,7 +420,8 @@ public:
 		ValenceBoostScale = 2.0f;
 		ValenceBoostPower = 0.5f;
 
-		best_tri = 0;
+		cache_count = 0;
+		next_unrendered = 0;
 	}
 	
 	// stores new indices in place
@@ -517,22 +436,52 @@ public:
 
 		if (max_vert == -1) return Fail_NoVerts;
 
+		ComputeScoreTables();
 		Result res = Init(inds, tri_count, max_vert + 1);
 		if (res) return res;
 
-		// iterate until Iterate returns false
-		while (Iterate());
+		int tri = BestTriangle();
+		while (tri >= 0)
+		{
+			tri = AddTriangleToDrawList(tri);
+		}
+		assert((int)draw_list.size() == tri_count);
 
 		// rewrite optimized index list
 		for (int i=0; i<(int)draw_list.size(); i++)
 		{
-			inds[3 * i + 0] = tris[draw_list[i]].verts[0];
-			inds[3 * i + 1] = tris[draw_list[i]].verts[1];
-			inds[3 * i + 2] = tris[draw_list[i]].verts[2];
+			inds[3 * i + 0] = tri_verts[3 * draw_list[i] + 0];
+			inds[3 * i + 1] = tri_verts[3 * draw_list[i] + 1];
+			inds[3 * i + 2] = tri_verts[3 * draw_list[i] + 2];
 		}
 
 		return Success;
 	}
+
+	// Renumbers the vertices in the order the index list first uses them,
+	// so that vertex fetches also walk memory sequentially. remap[old]
+	// receives the new index of each vertex, or -1 if it isn't used.
+	// Returns the number of vertices used, or -1 on a bad index, in which
+	// case inds is left untouched.
+	static int OptimizeFetch(int *inds, int tri_count, int *remap, int vertex_count)
+	{
+		int next = 0;
+
+		for (int i=0; i<tri_count * 3; i++)
+		{
+			if (inds[i] < 0 || inds[i] >= vertex_count) return -1;
+		}
+
+		for (int i=0; i<vertex_count; i++) remap[i] = -1;
+		for (int i=0; i<tri_count * 3; i++)
+		{
+			int index = inds[i];
+			if (remap[index] < 0) remap[index] = next++;
+			inds[i] = remap[index];
+		}
+
+		return next;
+	}
 };
 
 #endif // ndef _VCACHEOPT_H_
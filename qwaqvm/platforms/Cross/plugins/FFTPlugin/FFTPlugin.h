@@ -0,0 +1,30 @@
+#ifndef FFT_PLUGIN_H
+#define FFT_PLUGIN_H
+/* FFTPlugin.h include file */
+
+/* Imported from sqFFTPlan.c. FFT plans of power of two sizes, named by
+   small integer handles. Data is split into real and imaginary parts and
+   may hold several frames back to back. Forward transforms use
+   exp(+2 pi i j k / n) as FFT>>transformForward: does; inverse
+   transforms are scaled by 1/n. */
+#define FFT_MAX_PLANS 64
+#define FFT_MAX_SIZE (1 << 20)
+
+/* Answer a handle for transforms of size points, or -1. Complex plans
+   take sizes from 2, real plans from 4. */
+int fftPlanCreate(int size, int isReal);
+int fftPlanDestroy(int handle);
+int fftPlansShutdown(void);
+/* Answer the size of a plan, or 0 if handle is not in use */
+int fftPlanSize(int handle);
+int fftPlanIsReal(int handle);
+
+/* Complex plans: transform frames of size points in place */
+int fftPlanTransform(int handle, float *re, float *im, int frames, int forward);
+
+/* Real plans: size samples per frame to size/2+1 frequencies per frame,
+   and back */
+int fftPlanRealForward(int handle, float *samples, float *re, float *im, int frames);
+int fftPlanRealInverse(int handle, float *re, float *im, float *samples, int frames);
+
+#endif /* FFT_PLUGIN_H */
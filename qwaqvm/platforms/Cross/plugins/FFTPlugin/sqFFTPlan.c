@@ -0,0 +1,542 @@
+/*
+ *  sqFFTPlan.c
+ *  FFTPlugin
+ *
+ *  FFT plans: transforms of one power of two size with everything that
+ *  depends only on the size worked out in advance. Plans are named by
+ *  small integer handles.
+ *
+ *  A complex plan runs a Stockham autosort FFT of radix-4 passes, with a
+ *  final radix-2 pass when the size is an odd power of two, going back
+ *  and forth between the data and a work buffer owned by the plan. The
+ *  Stockham ordering needs no bit reversal, and every pass reads and
+ *  writes with unit stride, so with SSE2 the butterflies handle four
+ *  points at a time: across the inner index once its stride is 4 or more,
+ *  and across the outer index, with a 4x4 transpose on the way out, in
+ *  the first pass. Twiddles are computed in double precision when the
+ *  plan is made.
+ *
+ *  A real plan of size n runs a complex transform of size n/2 with the
+ *  even samples as real and the odd samples as imaginary parts, then
+ *  separates the two spectra, answering the n/2+1 frequencies 0 to n/2.
+ *
+ *  Data is in split form, real and imaginary parts in separate
+ *  FloatArrays, with any number of frames back to back. Signs follow
+ *  FFT>>transformForward:, whose forward transform multiplies by
+ *  exp(+2 pi i j k / n); inverse transforms are scaled by 1/n.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FFTPlugin.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define FFT_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+# define M_PI 3.14159265358979323846
+#endif
+
+typedef struct FFTPlan {
+	int size;		/* points per frame */
+	int isReal;
+	int complexSize;	/* size of the complex transform; size/2 for real plans */
+	float *twiddles;	/* for each radix-4 pass of length n, m = n/4 each of
+				   w1, w2 and w3 real parts then imaginary parts */
+	float *workReal, *workImag;
+	float *packedReal, *packedImag;	/* real plans: the samples as complex data */
+	float *halfCos, *halfSin;	/* real plans: exp(i pi k / complexSize), k = 0..complexSize */
+} FFTPlan;
+
+static FFTPlan *fftPlans[FFT_MAX_PLANS];
+
+
+/*** Passes ***/
+
+/* One radix-4 pass: x holds s interleaved sequences of length n, y gets
+   4s of length n/4 */
+static void
+pass4(int n, int s, float *xr, float *xi, float *yr, float *yi, float *tw, float sign)
+{
+	int m = n / 4, p, q;
+
+#ifdef FFT_SSE2
+	__m128 vsign = _mm_set1_ps(sign);
+
+	if(s >= 4) {
+		for(p = 0; p < m; p++) {
+			__m128 w1r = _mm_set1_ps(tw[p]), w1i = _mm_set1_ps(sign * tw[m + p]);
+			__m128 w2r = _mm_set1_ps(tw[2 * m + p]), w2i = _mm_set1_ps(sign * tw[3 * m + p]);
+			__m128 w3r = _mm_set1_ps(tw[4 * m + p]), w3i = _mm_set1_ps(sign * tw[5 * m + p]);
+			float *ar = xr + s * p, *ai = xi + s * p;
+			float *zr = yr + 4 * s * p, *zi = yi + 4 * s * p;
+
+			for(q = 0; q < s; q += 4) {
+				__m128 a_r = _mm_loadu_ps(ar + q), a_i = _mm_loadu_ps(ai + q);
+				__m128 b_r = _mm_loadu_ps(ar + q + s * m), b_i = _mm_loadu_ps(ai + q + s * m);
+				__m128 c_r = _mm_loadu_ps(ar + q + 2 * s * m), c_i = _mm_loadu_ps(ai + q + 2 * s * m);
+				__m128 d_r = _mm_loadu_ps(ar + q + 3 * s * m), d_i = _mm_loadu_ps(ai + q + 3 * s * m);
+				__m128 apc_r = _mm_add_ps(a_r, c_r), apc_i = _mm_add_ps(a_i, c_i);
+				__m128 amc_r = _mm_sub_ps(a_r, c_r), amc_i = _mm_sub_ps(a_i, c_i);
+				__m128 bpd_r = _mm_add_ps(b_r, d_r), bpd_i = _mm_add_ps(b_i, d_i);
+				__m128 jr = _mm_mul_ps(vsign, _mm_sub_ps(b_i, d_i));
+				__m128 ji = _mm_mul_ps(vsign, _mm_sub_ps(b_r, d_r));
+				__m128 t_r, t_i;
+
+				_mm_storeu_ps(zr + q, _mm_add_ps(apc_r, bpd_r));
+				_mm_storeu_ps(zi + q, _mm_add_ps(apc_i, bpd_i));
+				t_r = _mm_sub_ps(amc_r, jr);
+				t_i = _mm_add_ps(amc_i, ji);
+				_mm_storeu_ps(zr + q + s, _mm_sub_ps(_mm_mul_ps(t_r, w1r), _mm_mul_ps(t_i, w1i)));
+				_mm_storeu_ps(zi + q + s, _mm_add_ps(_mm_mul_ps(t_r, w1i), _mm_mul_ps(t_i, w1r)));
+				t_r = _mm_sub_ps(apc_r, bpd_r);
+				t_i = _mm_sub_ps(apc_i, bpd_i);
+				_mm_storeu_ps(zr + q + 2 * s, _mm_sub_ps(_mm_mul_ps(t_r, w2r), _mm_mul_ps(t_i, w2i)));
+				_mm_storeu_ps(zi + q + 2 * s, _mm_add_ps(_mm_mul_ps(t_r, w2i), _mm_mul_ps(t_i, w2r)));
+				t_r = _mm_add_ps(amc_r, jr);
+				t_i = _mm_sub_ps(amc_i, ji);
+				_mm_storeu_ps(zr + q + 3 * s, _mm_sub_ps(_mm_mul_ps(t_r, w3r), _mm_mul_ps(t_i, w3i)));
+				_mm_storeu_ps(zi + q + 3 * s, _mm_add_ps(_mm_mul_ps(t_r, w3i), _mm_mul_ps(t_i, w3r)));
+			}
+		}
+		return;
+	}
+	if(s == 1 && (m & 3) == 0) {
+		for(p = 0; p < m; p += 4) {
+			__m128 w1r = _mm_loadu_ps(tw + p), w1i = _mm_mul_ps(vsign, _mm_loadu_ps(tw + m + p));
+			__m128 w2r = _mm_loadu_ps(tw + 2 * m + p), w2i = _mm_mul_ps(vsign, _mm_loadu_ps(tw + 3 * m + p));
+			__m128 w3r = _mm_loadu_ps(tw + 4 * m + p), w3i = _mm_mul_ps(vsign, _mm_loadu_ps(tw + 5 * m + p));
+			__m128 a_r = _mm_loadu_ps(xr + p), a_i = _mm_loadu_ps(xi + p);
+			__m128 b_r = _mm_loadu_ps(xr + p + m), b_i = _mm_loadu_ps(xi + p + m);
+			__m128 c_r = _mm_loadu_ps(xr + p + 2 * m), c_i = _mm_loadu_ps(xi + p + 2 * m);
+			__m128 d_r = _mm_loadu_ps(xr + p + 3 * m), d_i = _mm_loadu_ps(xi + p + 3 * m);
+			__m128 apc_r = _mm_add_ps(a_r, c_r), apc_i = _mm_add_ps(a_i, c_i);
+			__m128 amc_r = _mm_sub_ps(a_r, c_r), amc_i = _mm_sub_ps(a_i, c_i);
+			__m128 bpd_r = _mm_add_ps(b_r, d_r), bpd_i = _mm_add_ps(b_i, d_i);
+			__m128 jr = _mm_mul_ps(vsign, _mm_sub_ps(b_i, d_i));
+			__m128 ji = _mm_mul_ps(vsign, _mm_sub_ps(b_r, d_r));
+			__m128 y0r, y0i, y1r, y1i, y2r, y2i, y3r, y3i, t_r, t_i;
+
+			y0r = _mm_add_ps(apc_r, bpd_r);
+			y0i = _mm_add_ps(apc_i, bpd_i);
+			t_r = _mm_sub_ps(amc_r, jr);
+			t_i = _mm_add_ps(amc_i, ji);
+			y1r = _mm_sub_ps(_mm_mul_ps(t_r, w1r), _mm_mul_ps(t_i, w1i));
+			y1i = _mm_add_ps(_mm_mul_ps(t_r, w1i), _mm_mul_ps(t_i, w1r));
+			t_r = _mm_sub_ps(apc_r, bpd_r);
+			t_i = _mm_sub_ps(apc_i, bpd_i);
+			y2r = _mm_sub_ps(_mm_mul_ps(t_r, w2r), _mm_mul_ps(t_i, w2i));
+			y2i = _mm_add_ps(_mm_mul_ps(t_r, w2i), _mm_mul_ps(t_i, w2r));
+			t_r = _mm_add_ps(amc_r, jr);
+			t_i = _mm_sub_ps(amc_i, ji);
+			y3r = _mm_sub_ps(_mm_mul_ps(t_r, w3r), _mm_mul_ps(t_i, w3i));
+			y3i = _mm_add_ps(_mm_mul_ps(t_r, w3i), _mm_mul_ps(t_i, w3r));
+			/* output 4p + k: transpose so each p's four outputs are adjacent */
+			_MM_TRANSPOSE4_PS(y0r, y1r, y2r, y3r);
+			_MM_TRANSPOSE4_PS(y0i, y1i, y2i, y3i);
+			_mm_storeu_ps(yr + 4 * p, y0r);
+			_mm_storeu_ps(yr + 4 * p + 4, y1r);
+			_mm_storeu_ps(yr + 4 * p + 8, y2r);
+			_mm_storeu_ps(yr + 4 * p + 12, y3r);
+			_mm_storeu_ps(yi + 4 * p, y0i);
+			_mm_storeu_ps(yi + 4 * p + 4, y1i);
+			_mm_storeu_ps(yi + 4 * p + 8, y2i);
+			_mm_storeu_ps(yi + 4 * p + 12, y3i);
+		}
+		return;
+	}
+#endif
+	for(p = 0; p < m; p++) {
+		float w1r = tw[p], w1i = sign * tw[m + p];
+		float w2r = tw[2 * m + p], w2i = sign * tw[3 * m + p];
+		float w3r = tw[4 * m + p], w3i = sign * tw[5 * m + p];
+
+		for(q = 0; q < s; q++) {
+			int i = q + s * p, o = q + 4 * s * p;
+			float apc_r = xr[i] + xr[i + 2 * s * m], apc_i = xi[i] + xi[i + 2 * s * m];
+			float amc_r = xr[i] - xr[i + 2 * s * m], amc_i = xi[i] - xi[i + 2 * s * m];
+			float bpd_r = xr[i + s * m] + xr[i + 3 * s * m], bpd_i = xi[i + s * m] + xi[i + 3 * s * m];
+			float jr = sign * (xi[i + s * m] - xi[i + 3 * s * m]);
+			float ji = sign * (xr[i + s * m] - xr[i + 3 * s * m]);
+			float t_r, t_i;
+
+			yr[o] = apc_r + bpd_r;
+			yi[o] = apc_i + bpd_i;
+			t_r = amc_r - jr;
+			t_i = amc_i + ji;
+			yr[o + s] = t_r * w1r - t_i * w1i;
+			yi[o + s] = t_r * w1i + t_i * w1r;
+			t_r = apc_r - bpd_r;
+			t_i = apc_i - bpd_i;
+			yr[o + 2 * s] = t_r * w2r - t_i * w2i;
+			yi[o + 2 * s] = t_r * w2i + t_i * w2r;
+			t_r = amc_r + jr;
+			t_i = amc_i - ji;
+			yr[o + 3 * s] = t_r * w3r - t_i * w3i;
+			yi[o + 3 * s] = t_r * w3i + t_i * w3r;
+		}
+	}
+}
+
+/* The last pass for odd powers of two: n is 2, so no twiddles */
+static void
+pass2(int s, float *xr, float *xi, float *yr, float *yi)
+{
+	int q = 0;
+
+#ifdef FFT_SSE2
+	for(; q + 4 <= s; q += 4) {
+		__m128 a_r = _mm_loadu_ps(xr + q), a_i = _mm_loadu_ps(xi + q);
+		__m128 b_r = _mm_loadu_ps(xr + q + s), b_i = _mm_loadu_ps(xi + q + s);
+
+		_mm_storeu_ps(yr + q, _mm_add_ps(a_r, b_r));
+		_mm_storeu_ps(yi + q, _mm_add_ps(a_i, b_i));
+		_mm_storeu_ps(yr + q + s, _mm_sub_ps(a_r, b_r));
+		_mm_storeu_ps(yi + q + s, _mm_sub_ps(a_i, b_i));
+	}
+#endif
+	for(; q < s; q++) {
+		float a_r = xr[q], a_i = xi[q], b_r = xr[q + s], b_i = xi[q + s];
+
+		yr[q] = a_r + b_r;
+		yi[q] = a_i + b_i;
+		yr[q + s] = a_r - b_r;
+		yi[q + s] = a_i - b_i;
+	}
+}
+
+static void
+scaleBy(float *data, int count, float factor)
+{
+	int i = 0;
+
+#ifdef FFT_SSE2
+	__m128 f = _mm_set1_ps(factor);
+
+	for(; i + 4 <= count; i += 4)
+		_mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), f));
+#endif
+	for(; i < count; i++)
+		data[i] *= factor;
+}
+
+/* Unscaled complex transform of plan->complexSize points, in place */
+static void
+complexTransform(FFTPlan *plan, float *re, float *im, int forward)
+{
+	float *xr = re, *xi = im, *yr = plan->workReal, *yi = plan->workImag, *t;
+	float *tw = plan->twiddles;
+	float sign = forward ? 1.0f : -1.0f;
+	int n = plan->complexSize, s = 1;
+
+	for(; n >= 4; n /= 4, s *= 4) {
+		pass4(n, s, xr, xi, yr, yi, tw, sign);
+		tw += 6 * (n / 4);
+		t = xr; xr = yr; yr = t;
+		t = xi; xi = yi; yi = t;
+	}
+	if(n == 2) {
+		pass2(s, xr, xi, yr, yi);
+		t = xr; xr = yr; yr = t;
+		t = xi; xi = yi; yi = t;
+	}
+	if(xr != re) {
+		memcpy(re, xr, plan->complexSize * sizeof(float));
+		memcpy(im, xi, plan->complexSize * sizeof(float));
+	}
+}
+
+
+/*** Real transforms ***/
+
+/* Split the complex transform z of the packed samples into the spectrum
+   x of the real signal: with a = z[k] and b = z[m-k],
+	x[k] = (a + conj b) / 2 + w^k (a - conj b) / 2i,  w = exp(i pi / m) */
+static void
+unpackSpectrum(FFTPlan *plan, float *zr, float *zi, float *xr, float *xi)
+{
+	int m = plan->complexSize, k = 1;
+	float *wr = plan->halfCos, *wi = plan->halfSin;
+
+	xr[0] = zr[0] + zi[0];
+	xi[0] = 0.0f;
+	xr[m] = zr[0] - zi[0];
+	xi[m] = 0.0f;
+#ifdef FFT_SSE2
+	{
+		__m128 half = _mm_set1_ps(0.5f);
+
+		for(; k + 4 <= m; k += 4) {
+			__m128 a_r = _mm_loadu_ps(zr + k), a_i = _mm_loadu_ps(zi + k);
+			__m128 b_r = _mm_loadu_ps(zr + m - k - 3), b_i = _mm_loadu_ps(zi + m - k - 3);
+			__m128 w_r = _mm_loadu_ps(wr + k), w_i = _mm_loadu_ps(wi + k);
+			__m128 e_r, e_i, o_r, o_i;
+
+			b_r = _mm_shuffle_ps(b_r, b_r, _MM_SHUFFLE(0, 1, 2, 3));
+			b_i = _mm_shuffle_ps(b_i, b_i, _MM_SHUFFLE(0, 1, 2, 3));
+			e_r = _mm_mul_ps(half, _mm_add_ps(a_r, b_r));
+			e_i = _mm_mul_ps(half, _mm_sub_ps(a_i, b_i));
+			o_r = _mm_mul_ps(half, _mm_add_ps(a_i, b_i));
+			o_i = _mm_mul_ps(half, _mm_sub_ps(b_r, a_r));
+			_mm_storeu_ps(xr + k, _mm_add_ps(e_r, _mm_sub_ps(_mm_mul_ps(w_r, o_r), _mm_mul_ps(w_i, o_i))));
+			_mm_storeu_ps(xi + k, _mm_add_ps(e_i, _mm_add_ps(_mm_mul_ps(w_r, o_i), _mm_mul_ps(w_i, o_r))));
+		}
+	}
+#endif
+	for(; k < m; k++) {
+		float a_r = zr[k], a_i = zi[k], b_r = zr[m - k], b_i = zi[m - k];
+		float e_r = 0.5f * (a_r + b_r), e_i = 0.5f * (a_i - b_i);
+		float o_r = 0.5f * (a_i + b_i), o_i = 0.5f * (b_r - a_r);
+
+		xr[k] = e_r + (wr[k] * o_r - wi[k] * o_i);
+		xi[k] = e_i + (wr[k] * o_i + wi[k] * o_r);
+	}
+}
+
+/* The inverse of unpackSpectrum, with the 1/m of the inverse transform
+   folded in: z[k] = e + i o where e = (a + conj b) / 2 and
+   o = w^-k (a - conj b) / 2, with a = x[k] and b = x[m-k] */
+static void
+packSpectrum(FFTPlan *plan, float *xr, float *xi, float *zr, float *zi)
+{
+	int m = plan->complexSize, k = 0;
+	float *wr = plan->halfCos, *wi = plan->halfSin;
+	float h = 0.5f / m;
+
+#ifdef FFT_SSE2
+	{
+		__m128 vh = _mm_set1_ps(h);
+
+		for(; k + 4 <= m; k += 4) {
+			__m128 a_r = _mm_loadu_ps(xr + k), a_i = _mm_loadu_ps(xi + k);
+			__m128 b_r = _mm_loadu_ps(xr + m - k - 3), b_i = _mm_loadu_ps(xi + m - k - 3);
+			__m128 w_r = _mm_loadu_ps(wr + k), w_i = _mm_loadu_ps(wi + k);
+			__m128 e_r, e_i, d_r, d_i, o_r, o_i;
+
+			b_r = _mm_shuffle_ps(b_r, b_r, _MM_SHUFFLE(0, 1, 2, 3));
+			b_i = _mm_shuffle_ps(b_i, b_i, _MM_SHUFFLE(0, 1, 2, 3));
+			e_r = _mm_mul_ps(vh, _mm_add_ps(a_r, b_r));
+			e_i = _mm_mul_ps(vh, _mm_sub_ps(a_i, b_i));
+			d_r = _mm_mul_ps(vh, _mm_sub_ps(a_r, b_r));
+			d_i = _mm_mul_ps(vh, _mm_add_ps(a_i, b_i));
+			o_r = _mm_add_ps(_mm_mul_ps(d_r, w_r), _mm_mul_ps(d_i, w_i));
+			o_i = _mm_sub_ps(_mm_mul_ps(d_i, w_r), _mm_mul_ps(d_r, w_i));
+			_mm_storeu_ps(zr + k, _mm_sub_ps(e_r, o_i));
+			_mm_storeu_ps(zi + k, _mm_add_ps(e_i, o_r));
+		}
+	}
+#endif
+	for(; k < m; k++) {
+		float a_r = xr[k], a_i = xi[k], b_r = xr[m - k], b_i = xi[m - k];
+		float e_r = h * (a_r + b_r), e_i = h * (a_i - b_i);
+		float d_r = h * (a_r - b_r), d_i = h * (a_i + b_i);
+		float o_r = d_r * wr[k] + d_i * wi[k], o_i = d_i * wr[k] - d_r * wi[k];
+
+		zr[k] = e_r - o_i;
+		zi[k] = e_i + o_r;
+	}
+}
+
+static void
+deinterleave(float *samples, int m, float *even, float *odd)
+{
+	int k = 0;
+
+#ifdef FFT_SSE2
+	for(; k + 4 <= m; k += 4) {
+		__m128 lo = _mm_loadu_ps(samples + 2 * k), hi = _mm_loadu_ps(samples + 2 * k + 4);
+
+		_mm_storeu_ps(even + k, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(odd + k, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+#endif
+	for(; k < m; k++) {
+		even[k] = samples[2 * k];
+		odd[k] = samples[2 * k + 1];
+	}
+}
+
+static void
+interleave(float *even, float *odd, int m, float *samples)
+{
+	int k = 0;
+
+#ifdef FFT_SSE2
+	for(; k + 4 <= m; k += 4) {
+		__m128 e = _mm_loadu_ps(even + k), o = _mm_loadu_ps(odd + k);
+
+		_mm_storeu_ps(samples + 2 * k, _mm_unpacklo_ps(e, o));
+		_mm_storeu_ps(samples + 2 * k + 4, _mm_unpackhi_ps(e, o));
+	}
+#endif
+	for(; k < m; k++) {
+		samples[2 * k] = even[k];
+		samples[2 * k + 1] = odd[k];
+	}
+}
+
+
+/*** Plans ***/
+
+static void
+freePlan(FFTPlan *plan)
+{
+	free(plan->twiddles);
+	free(plan->workReal);
+	free(plan->workImag);
+	free(plan->packedReal);
+	free(plan->packedImag);
+	free(plan->halfCos);
+	free(plan->halfSin);
+	free(plan);
+}
+
+static FFTPlan *
+validPlan(int handle)
+{
+	return handle >= 0 && handle < FFT_MAX_PLANS ? fftPlans[handle] : NULL;
+}
+
+int
+fftPlanCreate(int size, int isReal)
+{
+	FFTPlan *plan;
+	int handle, n, m, p, count, k;
+	float *tw;
+
+	if(size < (isReal ? 4 : 2) || size > FFT_MAX_SIZE || (size & (size - 1))) return -1;
+	for(handle = 0; handle < FFT_MAX_PLANS && fftPlans[handle]; handle++);
+	if(handle >= FFT_MAX_PLANS) return -1;
+	plan = calloc(1, sizeof(FFTPlan));
+	if(!plan) return -1;
+	plan->size = size;
+	plan->isReal = isReal;
+	plan->complexSize = n = isReal ? size / 2 : size;
+
+	/* 6 * (n/4 + n/16 + ...) < 2n */
+	plan->twiddles = malloc(2 * n * sizeof(float));
+	plan->workReal = malloc(n * sizeof(float));
+	plan->workImag = malloc(n * sizeof(float));
+	if(isReal) {
+		plan->packedReal = malloc(n * sizeof(float));
+		plan->packedImag = malloc(n * sizeof(float));
+		plan->halfCos = malloc((n + 1) * sizeof(float));
+		plan->halfSin = malloc((n + 1) * sizeof(float));
+	}
+	if(!plan->twiddles || !plan->workReal || !plan->workImag
+	 || (isReal && (!plan->packedReal || !plan->packedImag || !plan->halfCos || !plan->halfSin))) {
+		freePlan(plan);
+		return -1;
+	}
+	for(tw = plan->twiddles; n >= 4; n /= 4) {
+		m = n / 4;
+		for(k = 1; k <= 3; k++)
+			for(p = 0; p < m; p++) {
+				double angle = 2.0 * M_PI * k * p / n;
+
+				tw[(2 * k - 2) * m + p] = (float) cos(angle);
+				tw[(2 * k - 1) * m + p] = (float) sin(angle);
+			}
+		tw += 6 * m;
+	}
+	if(isReal) {
+		count = plan->complexSize;
+		for(k = 0; k <= count; k++) {
+			plan->halfCos[k] = (float) cos(M_PI * k / count);
+			plan->halfSin[k] = (float) sin(M_PI * k / count);
+		}
+	}
+	fftPlans[handle] = plan;
+	return handle;
+}
+
+int
+fftPlanDestroy(int handle)
+{
+	FFTPlan *plan = validPlan(handle);
+
+	if(!plan) return 0;
+	fftPlans[handle] = NULL;
+	freePlan(plan);
+	return 1;
+}
+
+int
+fftPlanSize(int handle)
+{
+	FFTPlan *plan = validPlan(handle);
+
+	return plan ? plan->size : 0;
+}
+
+int
+fftPlanIsReal(int handle)
+{
+	FFTPlan *plan = validPlan(handle);
+
+	return plan && plan->isReal;
+}
+
+int
+fftPlanTransform(int handle, float *re, float *im, int frames, int forward)
+{
+	FFTPlan *plan = validPlan(handle);
+	int n, f;
+
+	if(!plan || plan->isReal || frames < 0) return 0;
+	n = plan->size;
+	for(f = 0; f < frames; f++) {
+		complexTransform(plan, re + f * n, im + f * n, forward);
+		if(!forward) {
+			scaleBy(re + f * n, n, 1.0f / n);
+			scaleBy(im + f * n, n, 1.0f / n);
+		}
+	}
+	return 1;
+}
+
+int
+fftPlanRealForward(int handle, float *samples, float *re, float *im, int frames)
+{
+	FFTPlan *plan = validPlan(handle);
+	int m, f;
+
+	if(!plan || !plan->isReal || frames < 0) return 0;
+	m = plan->complexSize;
+	for(f = 0; f < frames; f++) {
+		deinterleave(samples + f * 2 * m, m, plan->packedReal, plan->packedImag);
+		complexTransform(plan, plan->packedReal, plan->packedImag, 1);
+		unpackSpectrum(plan, plan->packedReal, plan->packedImag, re + f * (m + 1), im + f * (m + 1));
+	}
+	return 1;
+}
+
+int
+fftPlanRealInverse(int handle, float *re, float *im, float *samples, int frames)
+{
+	FFTPlan *plan = validPlan(handle);
+	int m, f;
+
+	if(!plan || !plan->isReal || frames < 0) return 0;
+	m = plan->complexSize;
+	for(f = 0; f < frames; f++) {
+		packSpectrum(plan, re + f * (m + 1), im + f * (m + 1), plan->packedReal, plan->packedImag);
+		complexTransform(plan, plan->packedReal, plan->packedImag, 0);
+		interleave(plan->packedReal, plan->packedImag, m, samples + f * 2 * m);
+	}
+	return 1;
+}
+
+int
+fftPlansShutdown(void)
+{
+	int i;
+
+	for(i = 0; i < FFT_MAX_PLANS; i++)
+		fftPlanDestroy(i);
+	return 1;
+}
@@ -0,0 +1,44 @@
+#ifndef FLOAT_ARRAY_PLUGIN_H
+#define FLOAT_ARRAY_PLUGIN_H
+/* FloatArrayPlugin.h include file */
+
+/* Imported from sqFloatArrayOps.c. Element-wise kernels on float arrays
+   of count elements. The ...Array functions update dst in place from
+   src; the ...Scalar functions compute in double precision and round
+   each result to float, like the original primitives did. */
+void floatArrayAddArray(float *dst, float *src, int count);
+void floatArraySubArray(float *dst, float *src, int count);
+void floatArrayMulArray(float *dst, float *src, int count);
+void floatArrayDivArray(float *dst, float *src, int count);
+void floatArrayAddScalar(float *dst, double value, int count);
+void floatArrayMulScalar(float *dst, double value, int count);
+void floatArrayDivScalar(float *dst, double value, int count);
+
+/* Reductions, accumulated in double precision */
+double floatArraySum(float *src, int count);
+double floatArrayDotProduct(float *a, float *b, int count);
+
+/* Answer true if any element has all bits zero (a positive zero) */
+int floatArrayHasZero(float *src, int count);
+int floatArrayEqual(float *a, float *b, int count);
+/* Sum of the elements as 32-bit integers, modulo 2^32 */
+unsigned int floatArrayHashWords(int *src, int count);
+
+/* Fused operations:
+     axpy       dst[i] := a * x[i] + dst[i]
+     mulAdd     dst[i] := dst[i] + x[i] * y[i]
+     scaleAdd   dst[i] := dst[i] * scale + offset
+     clamp      dst[i] := min(max(dst[i], lo), hi), NaNs are kept
+     gather     dst[i] := src[i * stride], stride may be negative */
+void floatArrayAxpy(float *dst, double a, float *x, int count);
+void floatArrayMulAdd(float *dst, float *x, float *y, int count);
+void floatArrayScaleAdd(float *dst, double scale, double offset, int count);
+void floatArrayClamp(float *dst, float lo, float hi, int count);
+void floatArrayGather(float *dst, float *src, int stride, int count);
+
+/* Zero-based index of the first largest (smallest) element, ignoring
+   NaNs. Answers 0 if all elements are NaN; count must be positive. */
+int floatArrayMaxIndex(float *src, int count);
+int floatArrayMinIndex(float *src, int count);
+
+#endif /* FLOAT_ARRAY_PLUGIN_H */
@@ -0,0 +1,337 @@
+/*
+ *  sqFloatArrayOps.c
+ *  FloatArrayPlugin
+ *
+ *  Kernels for the FloatArray primitives.
+ *
+ *  The SSE2 versions work four floats at a time (two when computing in
+ *  double precision). Squeak objects are only word aligned, so each loop
+ *  first handles single elements until the destination is 16 byte
+ *  aligned, then does aligned stores with unaligned loads from the
+ *  sources, and finishes the last few elements one at a time.
+ *
+ *  Results are the same as those of the scalar loops, except that sums
+ *  and dot products add in a different order and may differ in the last
+ *  bits of the double result. Array with array arithmetic is done in
+ *  single precision, which rounds the same as computing in double and
+ *  rounding to float.
+ */
+
+#include <math.h>
+#include <stddef.h>
+
+#include "FloatArrayPlugin.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define FLOAT_ARRAY_SSE2 1
+# include <emmintrin.h>
+#endif
+
+/* elements to do singly before dst is 16 byte aligned */
+#define HEAD(dst, count) \
+	((int) ((((size_t) 16 - ((size_t) (dst) & 15)) & 15) >> 2) < (count) \
+		? (int) ((((size_t) 16 - ((size_t) (dst) & 15)) & 15) >> 2) : (count))
+
+#ifdef FLOAT_ARRAY_SSE2
+
+/* dst op= src, four at a time */
+#define ARRAY_OP(dst, src, count, op, mmop) { \
+	int i_ = 0, head_ = HEAD(dst, count); \
+	for(; i_ < head_; i_++) dst[i_] = dst[i_] op src[i_]; \
+	for(; i_ + 8 <= count; i_ += 8) { \
+		_mm_store_ps(dst + i_, mmop(_mm_load_ps(dst + i_), _mm_loadu_ps(src + i_))); \
+		_mm_store_ps(dst + i_ + 4, mmop(_mm_load_ps(dst + i_ + 4), _mm_loadu_ps(src + i_ + 4))); \
+	} \
+	for(; i_ + 4 <= count; i_ += 4) \
+		_mm_store_ps(dst + i_, mmop(_mm_load_ps(dst + i_), _mm_loadu_ps(src + i_))); \
+	for(; i_ < count; i_++) dst[i_] = dst[i_] op src[i_]; \
+}
+
+/* dst[i] := f(dst[i]) in double precision; EXPR sees d (two doubles) */
+#define DOUBLE_OP(dst, count, scalarExpr, EXPR) { \
+	int i_ = 0, head_ = HEAD(dst, count); \
+	double s_; \
+	for(; i_ < head_; i_++) { s_ = dst[i_]; dst[i_] = (float) (scalarExpr); } \
+	for(; i_ + 4 <= count; i_ += 4) { \
+		__m128 f_ = _mm_load_ps(dst + i_), lo_, hi_; \
+		__m128d d; \
+		d = _mm_cvtps_pd(f_); \
+		lo_ = _mm_cvtpd_ps(EXPR); \
+		d = _mm_cvtps_pd(_mm_movehl_ps(f_, f_)); \
+		hi_ = _mm_cvtpd_ps(EXPR); \
+		_mm_store_ps(dst + i_, _mm_movelh_ps(lo_, hi_)); \
+	} \
+	for(; i_ < count; i_++) { s_ = dst[i_]; dst[i_] = (float) (scalarExpr); } \
+}
+
+#else /* FLOAT_ARRAY_SSE2 */
+
+#define ARRAY_OP(dst, src, count, op, mmop) { \
+	int i_; \
+	for(i_ = 0; i_ < count; i_++) dst[i_] = dst[i_] op src[i_]; \
+}
+
+#define DOUBLE_OP(dst, count, scalarExpr, EXPR) { \
+	int i_; \
+	double s_; \
+	for(i_ = 0; i_ < count; i_++) { s_ = dst[i_]; dst[i_] = (float) (scalarExpr); } \
+}
+
+#endif /* FLOAT_ARRAY_SSE2 */
+
+void floatArrayAddArray(float *dst, float *src, int count)
+	ARRAY_OP(dst, src, count, +, _mm_add_ps)
+
+void floatArraySubArray(float *dst, float *src, int count)
+	ARRAY_OP(dst, src, count, -, _mm_sub_ps)
+
+void floatArrayMulArray(float *dst, float *src, int count)
+	ARRAY_OP(dst, src, count, *, _mm_mul_ps)
+
+void floatArrayDivArray(float *dst, float *src, int count)
+	ARRAY_OP(dst, src, count, /, _mm_div_ps)
+
+void floatArrayAddScalar(float *dst, double value, int count)
+{
+#ifdef FLOAT_ARRAY_SSE2
+	__m128d v = _mm_set1_pd(value);
+#endif
+	DOUBLE_OP(dst, count, s_ + value, _mm_add_pd(d, v))
+}
+
+void floatArrayMulScalar(float *dst, double value, int count)
+{
+#ifdef FLOAT_ARRAY_SSE2
+	__m128d v = _mm_set1_pd(value);
+#endif
+	DOUBLE_OP(dst, count, s_ * value, _mm_mul_pd(d, v))
+}
+
+void floatArrayDivScalar(float *dst, double value, int count)
+{
+#ifdef FLOAT_ARRAY_SSE2
+	__m128d v = _mm_set1_pd(value);
+#endif
+	DOUBLE_OP(dst, count, s_ / value, _mm_div_pd(d, v))
+}
+
+void floatArrayScaleAdd(float *dst, double scale, double offset, int count)
+{
+#ifdef FLOAT_ARRAY_SSE2
+	__m128d s = _mm_set1_pd(scale), o = _mm_set1_pd(offset);
+#endif
+	DOUBLE_OP(dst, count, s_ * scale + offset, _mm_add_pd(_mm_mul_pd(d, s), o))
+}
+
+void floatArrayAxpy(float *dst, double a, float *x, int count)
+{
+	int i = 0;
+#ifdef FLOAT_ARRAY_SSE2
+	int head = HEAD(dst, count);
+	__m128d va = _mm_set1_pd(a);
+
+	for(; i < head; i++) dst[i] = (float) (a * x[i] + dst[i]);
+	for(; i + 4 <= count; i += 4) {
+		__m128 y = _mm_load_ps(dst + i), xs = _mm_loadu_ps(x + i), lo, hi;
+		lo = _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(va, _mm_cvtps_pd(xs)), _mm_cvtps_pd(y)));
+		hi = _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(va, _mm_cvtps_pd(_mm_movehl_ps(xs, xs))),
+					     _mm_cvtps_pd(_mm_movehl_ps(y, y))));
+		_mm_store_ps(dst + i, _mm_movelh_ps(lo, hi));
+	}
+#endif
+	for(; i < count; i++) dst[i] = (float) (a * x[i] + dst[i]);
+}
+
+/* The product of two floats is exact in double, so this rounds once */
+void floatArrayMulAdd(float *dst, float *x, float *y, int count)
+{
+	int i = 0;
+#ifdef FLOAT_ARRAY_SSE2
+	int head = HEAD(dst, count);
+
+	for(; i < head; i++) dst[i] = (float) ((double) dst[i] + (double) x[i] * y[i]);
+	for(; i + 4 <= count; i += 4) {
+		__m128 d = _mm_load_ps(dst + i), xs = _mm_loadu_ps(x + i), ys = _mm_loadu_ps(y + i), lo, hi;
+		lo = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(d),
+					     _mm_mul_pd(_mm_cvtps_pd(xs), _mm_cvtps_pd(ys))));
+		hi = _mm_cvtpd_ps(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(d, d)),
+					     _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(xs, xs)),
+							_mm_cvtps_pd(_mm_movehl_ps(ys, ys)))));
+		_mm_store_ps(dst + i, _mm_movelh_ps(lo, hi));
+	}
+#endif
+	for(; i < count; i++) dst[i] = (float) ((double) dst[i] + (double) x[i] * y[i]);
+}
+
+void floatArrayClamp(float *dst, float lo, float hi, int count)
+{
+	int i = 0;
+#ifdef FLOAT_ARRAY_SSE2
+	int head = HEAD(dst, count);
+	__m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+
+	for(; i < head; i++)
+		dst[i] = dst[i] < lo ? lo : dst[i] > hi ? hi : dst[i];
+	/* maxps/minps answer the second operand if either is a NaN */
+	for(; i + 4 <= count; i += 4)
+		_mm_store_ps(dst + i, _mm_min_ps(vhi, _mm_max_ps(vlo, _mm_load_ps(dst + i))));
+#endif
+	for(; i < count; i++)
+		dst[i] = dst[i] < lo ? lo : dst[i] > hi ? hi : dst[i];
+}
+
+void floatArrayGather(float *dst, float *src, int stride, int count)
+{
+	int i = 0;
+
+	if(stride == 1) {
+		for(; i < count; i++) dst[i] = src[i];
+		return;
+	}
+	for(; i + 4 <= count; i += 4, src += 4 * stride) {
+		float a = src[0], b = src[stride], c = src[2 * stride], d = src[3 * stride];
+		dst[i] = a; dst[i + 1] = b; dst[i + 2] = c; dst[i + 3] = d;
+	}
+	for(; i < count; i++, src += stride) dst[i] = src[0];
+}
+
+double floatArraySum(float *src, int count)
+{
+	int i = 0;
+	double sum = 0.0;
+#ifdef FLOAT_ARRAY_SSE2
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	double parts[2];
+
+	for(; i + 4 <= count; i += 4) {
+		__m128 f = _mm_loadu_ps(src + i);
+		s0 = _mm_add_pd(s0, _mm_cvtps_pd(f));
+		s1 = _mm_add_pd(s1, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+	}
+	_mm_storeu_pd(parts, _mm_add_pd(s0, s1));
+	sum = parts[0] + parts[1];
+#endif
+	for(; i < count; i++) sum += src[i];
+	return sum;
+}
+
+double floatArrayDotProduct(float *a, float *b, int count)
+{
+	int i = 0;
+	double sum = 0.0;
+#ifdef FLOAT_ARRAY_SSE2
+	__m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+	double parts[2];
+
+	for(; i + 4 <= count; i += 4) {
+		__m128 fa = _mm_loadu_ps(a + i), fb = _mm_loadu_ps(b + i);
+		s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_cvtps_pd(fa), _mm_cvtps_pd(fb)));
+		s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(fa, fa)),
+					       _mm_cvtps_pd(_mm_movehl_ps(fb, fb))));
+	}
+	_mm_storeu_pd(parts, _mm_add_pd(s0, s1));
+	sum = parts[0] + parts[1];
+#endif
+	for(; i < count; i++) sum += (double) a[i] * b[i];
+	return sum;
+}
+
+int floatArrayHasZero(float *src, int count)
+{
+	int *words = (int *) src;
+	int i = 0;
+#ifdef FLOAT_ARRAY_SSE2
+	__m128i zero = _mm_setzero_si128();
+
+	for(; i + 4 <= count; i += 4)
+		if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_loadu_si128((__m128i *) (words + i)), zero)))
+			return 1;
+#endif
+	for(; i < count; i++)
+		if(words[i] == 0) return 1;
+	return 0;
+}
+
+int floatArrayEqual(float *a, float *b, int count)
+{
+	int i = 0;
+#ifdef FLOAT_ARRAY_SSE2
+	for(; i + 4 <= count; i += 4)
+		if(_mm_movemask_ps(_mm_cmpneq_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i))))
+			return 0;
+#endif
+	for(; i < count; i++)
+		if(!(a[i] == b[i])) return 0;
+	return 1;
+}
+
+unsigned int floatArrayHashWords(int *src, int count)
+{
+	int i = 0;
+	unsigned int sum = 0;
+#ifdef FLOAT_ARRAY_SSE2
+	__m128i s = _mm_setzero_si128();
+	unsigned int parts[4];
+
+	for(; i + 4 <= count; i += 4)
+		s = _mm_add_epi32(s, _mm_loadu_si128((__m128i *) (src + i)));
+	_mm_storeu_si128((__m128i *) parts, s);
+	sum = parts[0] + parts[1] + parts[2] + parts[3];
+#endif
+	for(; i < count; i++) sum += (unsigned int) src[i];
+	return sum;
+}
+
+/* First index holding value, or 0 if there is none (all NaNs) */
+static int
+firstIndexOf(float *src, float value, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		if(src[i] == value) return i;
+	return 0;
+}
+
+int floatArrayMaxIndex(float *src, int count)
+{
+	int i = 0;
+	float best = (float) -HUGE_VAL;
+#ifdef FLOAT_ARRAY_SSE2
+	__m128 m = _mm_set1_ps(best);
+	float parts[4];
+
+	/* maxps answers the second operand, the running maximum, for a NaN */
+	for(; i + 4 <= count; i += 4)
+		m = _mm_max_ps(_mm_loadu_ps(src + i), m);
+	_mm_storeu_ps(parts, m);
+	best = parts[0];
+	if(parts[1] > best) best = parts[1];
+	if(parts[2] > best) best = parts[2];
+	if(parts[3] > best) best = parts[3];
+#endif
+	for(; i < count; i++)
+		if(src[i] > best) best = src[i];
+	return firstIndexOf(src, best, count);
+}
+
+int floatArrayMinIndex(float *src, int count)
+{
+	int i = 0;
+	float best = (float) HUGE_VAL;
+#ifdef FLOAT_ARRAY_SSE2
+	__m128 m = _mm_set1_ps(best);
+	float parts[4];
+
+	for(; i + 4 <= count; i += 4)
+		m = _mm_min_ps(_mm_loadu_ps(src + i), m);
+	_mm_storeu_ps(parts, m);
+	best = parts[0];
+	if(parts[1] < best) best = parts[1];
+	if(parts[2] < best) best = parts[2];
+	if(parts[3] < best) best = parts[3];
+#endif
+	for(; i < count; i++)
+		if(src[i] < best) best = src[i];
+	return firstIndexOf(src, best, count);
+}
@@ -14,4 +14,27 @@ typedef struct error_mgr2* error_ptr2;
 void error_exit (j_common_ptr cinfo);
 GLOBAL(void) jpeg_mem_src (j_decompress_ptr cinfo, char * pSourceData, unsigned sourceDataSize);
 GLOBAL(int) jpeg_mem_src_newLocationOfData (j_decompress_ptr cinfo, char * pSourceData, unsigned sourceDataSize);
-GLOBAL(void) jpeg_mem_dest (j_compress_ptr cinfo, char * pDestination, unsigned *pDestinationSize);
\ No newline at end of file
+GLOBAL(void) jpeg_mem_dest (j_compress_ptr cinfo, char * pDestination, unsigned *pDestinationSize);
+
+/* Imported from sqJPEGScaledDecode.c. Decoding scaled by 1/scale, where
+   scale is 1, 2, 4 or 8, of a region given in scaled pixels, into the
+   bits of a 32 or 16 bit Form. The Start/Status/Result functions do the
+   same on a pool of worker threads; each job is named by a small integer
+   handle and signals semaIndex when done. */
+#define JPEG_MAX_DECODES 64
+#define jpegValidScale(scale) ((scale) == 1 || (scale) == 2 || (scale) == 4 || (scale) == 8)
+
+int jpegScaledExtent(char *source, unsigned sourceSize, int scale, int *width, int *height);
+int jpegDecodeScaled(char *source, unsigned sourceSize, int scale, int x, int y,
+		     unsigned int *bits, int width, int height, int depth, int dither);
+int jpegDecodeInit(void);
+int jpegDecodeShutdown(void);
+/* Answer a handle, or -1 if the job cannot be queued */
+int jpegDecodeStart(char *source, unsigned sourceSize, int scale,
+		    int x, int y, int width, int height, int semaIndex);
+/* Answer -1 while decoding, -2 if decoding failed, 0 when done */
+int jpegDecodeStatus(int handle);
+/* Copy a finished decode into Form bits and release the handle */
+int jpegDecodeResult(int handle, unsigned int *bits, int width, int height, int depth, int dither);
+/* Release the handle, abandoning the decode if it is queued or running */
+int jpegDecodeRelease(int handle);
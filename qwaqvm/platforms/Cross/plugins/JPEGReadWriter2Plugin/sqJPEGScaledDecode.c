@@ -0,0 +1,492 @@
+/*
+ *  sqJPEGScaledDecode.c
+ *  JPEGReadWriter2Plugin
+ *
+ *  Scaled, region of interest and asynchronous decoding with libjpeg.
+ *
+ *  Scaling by 1/2, 1/4 or 1/8 happens in the DCT domain: libjpeg's
+ *  reduced size inverse DCTs (jidctred.c) produce 4x4, 2x2 or 1x1 pixels
+ *  per block, so there is neither a full IDCT nor a full size image to
+ *  shrink afterwards. A region is given in scaled pixels. Sequential
+ *  JPEGs must still be entropy decoded from the top, but decoding stops
+ *  after the last row of the region and only the region's columns are
+ *  stored into the Form.
+ *
+ *  Asynchronous decodes are named by small integer handles, as the
+ *  ZipPlugin streams are. The source bytes are copied, since the
+ *  ByteArray may move, and the job is queued for a small pool of worker
+ *  threads started on first use. A worker decodes into a malloced buffer
+ *  of 32 bit pixels and signals the job's semaphore; the VM thread then
+ *  copies the pixels into a Form with jpegDecodeResult().
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sqVirtualMachine.h"
+#include "JPEGReadWriter2Plugin.h"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+extern struct VirtualMachine *interpreterProxy;
+
+#define DECODE_THREADS 4
+
+/* Job states */
+#define JOB_QUEUED 0
+#define JOB_RUNNING 1
+#define JOB_DONE 2
+#define JOB_FAILED 3
+
+typedef struct JPEGDecodeJob {
+	unsigned char *source;
+	unsigned sourceSize;
+	int scale, x, y, width, height, semaIndex;
+	unsigned int *pixels;
+	int state, released;
+	struct JPEGDecodeJob *next;
+} JPEGDecodeJob;
+
+static JPEGDecodeJob *decodeJobs[JPEG_MAX_DECODES];
+static JPEGDecodeJob *queueHead, *queueTail;
+static int workerCount, stopping;
+
+#ifdef _WIN32
+static CRITICAL_SECTION decodeLock;
+static HANDLE queueSemaphore;
+static HANDLE workers[DECODE_THREADS];
+# define LOCK() EnterCriticalSection(&decodeLock)
+# define UNLOCK() LeaveCriticalSection(&decodeLock)
+#else
+static pthread_mutex_t decodeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queueReady = PTHREAD_COND_INITIALIZER;
+static pthread_t workers[DECODE_THREADS];
+# define LOCK() pthread_mutex_lock(&decodeLock)
+# define UNLOCK() pthread_mutex_unlock(&decodeLock)
+#endif
+
+
+/*** Decoding ***/
+
+static void
+storeRow(JSAMPROW row, int components, int width, unsigned int *pixels)
+{
+	int i;
+
+	if(components == 3)
+		for(i = 0; i < width; i++, row += 3)
+			pixels[i] = 0xFF000000U | (row[0] << 16) | (row[1] << 8) | row[2];
+	else
+		for(i = 0; i < width; i++)
+			pixels[i] = 0xFF000000U | (row[i] * 0x010101U);
+}
+
+/* Set up cinfo to decode source scaled by 1/scale, and compute the output
+   extent. Must be called within the caller's setjmp, with a valid scale;
+   the caller destroys cinfo whatever the answer. */
+static int
+readHeader(j_decompress_ptr cinfo, unsigned char *source, unsigned sourceSize, int scale)
+{
+	jpeg_create_decompress(cinfo);
+	jpeg_mem_src(cinfo, (char *) source, sourceSize);
+	jpeg_read_header(cinfo, TRUE);
+	cinfo->scale_num = 1;
+	cinfo->scale_denom = scale;
+	jpeg_calc_output_dimensions(cinfo);
+	return cinfo->output_components == 1 || cinfo->output_components == 3;
+}
+
+/* Decode the width by height region at x, y of the image scaled by
+   1/scale into pixels, pitch words apart. Answer true on success. */
+static int
+decodeRegion(unsigned char *source, unsigned sourceSize, int scale,
+	     int x, int y, int width, int height,
+	     unsigned int *pixels, int pitch)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct error_mgr2 jerr;
+	JSAMPARRAY buffer;
+	int row, n, i;
+
+	if(sourceSize == 0 || !jpegValidScale(scale)) return 0;
+	cinfo.err = jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = error_exit;
+	if(setjmp(jerr.setjmp_buffer)) {
+		jpeg_destroy_decompress(&cinfo);
+		return 0;
+	}
+	if(!readHeader(&cinfo, source, sourceSize, scale)
+	 || x < 0 || y < 0 || width < 0 || height < 0
+	 || x > (int) cinfo.output_width - width
+	 || y > (int) cinfo.output_height - height) {
+		jpeg_destroy_decompress(&cinfo);
+		return 0;
+	}
+	jpeg_start_decompress(&cinfo);
+	buffer = (*cinfo.mem->alloc_sarray)
+		((j_common_ptr) &cinfo, JPOOL_IMAGE,
+		 cinfo.output_width * cinfo.output_components, cinfo.rec_outbuf_height);
+	while((int) cinfo.output_scanline < y + height) {
+		row = cinfo.output_scanline;
+		n = jpeg_read_scanlines(&cinfo, buffer, cinfo.rec_outbuf_height);
+		for(i = 0; i < n; i++, row++)
+			if(row >= y && row < y + height)
+				storeRow(buffer[i] + x * cinfo.output_components, cinfo.output_components,
+					 width, pixels + (row - y) * pitch);
+	}
+	/* rows below the region are never decoded */
+	jpeg_destroy_decompress(&cinfo);
+	return 1;
+}
+
+/* Pack 32 bit pixels two to a word into the bits of a 16 bit Form, with
+   the same rounding or ordered dither as the full size decoder */
+static void
+packPixels16(unsigned int *pixels, int width, int height, unsigned int *bits, int dither)
+{
+	static const int ditherMatrix1[] = { 2, 0, 14, 12, 1, 3, 13, 15 };
+	static const int ditherMatrix2[] = { 10, 8, 6, 4, 9, 11, 5, 7 };
+	int pitch = (width + 1) / 2;
+	int row, i, k;
+
+	for(row = 0; row < height; row++) {
+		unsigned int *src = pixels + row * width;
+		unsigned int *dst = bits + row * pitch;
+
+		for(i = 0; i < pitch; i++) {
+			unsigned int word = 0;
+
+			for(k = 0; k < 2; k++) {
+				unsigned int pix = 2 * i + k < width ? src[2 * i + k] : 0;
+				int c[3], j, half;
+
+				c[0] = (pix >> 16) & 255;
+				c[1] = (pix >> 8) & 255;
+				c[2] = pix & 255;
+				for(j = 0; j < 3; j++) {
+					if(dither) {
+						/* as in Form>>orderedDither32To16; row and pair
+						   count from 1 there */
+						int dmv = (k ? ditherMatrix2 : ditherMatrix1)[(((row + 1) & 3) << 1) | ((i + 1) & 1)];
+						int di = (c[j] * 496) >> 8;
+						c[j] = dmv < (di & 15) ? (di >> 4) + 1 : di >> 4;
+					} else
+						c[j] >>= 3;
+				}
+				half = (c[0] << 10) | (c[1] << 5) | c[2];
+				if(!half) half = 1;
+				word = (word << 16) | half;
+			}
+			dst[i] = word;
+		}
+	}
+}
+
+/* Copy width by height 32 bit pixels into the bits of a Form of the
+   given depth. Answer false if the depth is not handled or memory runs
+   out. */
+static int
+storePixels(unsigned int *pixels, unsigned int *bits, int width, int height, int depth, int dither)
+{
+	if(depth == 32)
+		memcpy(bits, pixels, (size_t) width * height * 4);
+	else if(depth == 16)
+		packPixels16(pixels, width, height, bits, dither);
+	else
+		return 0;
+	return 1;
+}
+
+int
+jpegScaledExtent(char *source, unsigned sourceSize, int scale, int *width, int *height)
+{
+	struct jpeg_decompress_struct cinfo;
+	struct error_mgr2 jerr;
+	int ok;
+
+	if(sourceSize == 0 || !jpegValidScale(scale)) return 0;
+	cinfo.err = jpeg_std_error(&jerr.pub);
+	jerr.pub.error_exit = error_exit;
+	if(setjmp(jerr.setjmp_buffer)) {
+		jpeg_destroy_decompress(&cinfo);
+		return 0;
+	}
+	ok = readHeader(&cinfo, (unsigned char *) source, sourceSize, scale);
+	*width = cinfo.output_width;
+	*height = cinfo.output_height;
+	jpeg_destroy_decompress(&cinfo);
+	return ok;
+}
+
+int
+jpegDecodeScaled(char *source, unsigned sourceSize, int scale, int x, int y,
+		 unsigned int *bits, int width, int height, int depth, int dither)
+{
+	unsigned int *pixels;
+	int ok;
+
+	if(depth == 32)
+		return decodeRegion((unsigned char *) source, sourceSize, scale,
+				    x, y, width, height, bits, width);
+	if(depth != 16) return 0;
+	pixels = malloc((size_t) width * height * 4 + 4);
+	if(!pixels) return 0;
+	ok = decodeRegion((unsigned char *) source, sourceSize, scale,
+			  x, y, width, height, pixels, width)
+		&& storePixels(pixels, bits, width, height, depth, dither);
+	free(pixels);
+	return ok;
+}
+
+
+/*** Worker pool ***/
+
+static void
+freeJob(JPEGDecodeJob *job)
+{
+	free(job->source);
+	free(job->pixels);
+	free(job);
+}
+
+static void
+runJob(JPEGDecodeJob *job)
+{
+	int ok, released, semaIndex;
+
+	job->pixels = malloc((size_t) job->width * job->height * 4 + 4);
+	ok = job->pixels
+		&& decodeRegion(job->source, job->sourceSize, job->scale,
+				job->x, job->y, job->width, job->height,
+				job->pixels, job->width);
+	free(job->source);
+	job->source = NULL;
+	/* once the state is final the VM thread may free the job, so take
+	   everything needed from it first */
+	LOCK();
+	job->state = ok ? JOB_DONE : JOB_FAILED;
+	released = job->released;
+	semaIndex = job->semaIndex;
+	UNLOCK();
+	if(released)
+		freeJob(job);
+	else
+		interpreterProxy->signalSemaphoreWithIndex(semaIndex);
+}
+
+/* Answer the next queued job, or NULL when the pool is stopping */
+static JPEGDecodeJob *
+nextJob(void)
+{
+	JPEGDecodeJob *job;
+
+#ifdef _WIN32
+	for(;;) {
+		WaitForSingleObject(queueSemaphore, INFINITE);
+		LOCK();
+		if(stopping || queueHead) break;
+		UNLOCK();	/* its job was released while queued */
+	}
+#else
+	LOCK();
+	while(!stopping && !queueHead)
+		pthread_cond_wait(&queueReady, &decodeLock);
+#endif
+	job = stopping ? NULL : queueHead;
+	if(job) {
+		queueHead = job->next;
+		if(!queueHead) queueTail = NULL;
+		job->state = JOB_RUNNING;
+	}
+	UNLOCK();
+	return job;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+decodeWorker(LPVOID arg)
+#else
+static void *
+decodeWorker(void *arg)
+#endif
+{
+	JPEGDecodeJob *job;
+
+	while((job = nextJob()))
+		runJob(job);
+	return 0;
+}
+
+static void
+startWorkers(void)
+{
+	while(workerCount < DECODE_THREADS) {
+#ifdef _WIN32
+		workers[workerCount] = CreateThread(NULL, 0, decodeWorker, NULL, 0, NULL);
+		if(!workers[workerCount]) return;
+#else
+		if(pthread_create(&workers[workerCount], NULL, decodeWorker, NULL)) return;
+#endif
+		workerCount++;
+	}
+}
+
+static void
+stopWorkers(void)
+{
+	int i;
+
+	LOCK();
+	stopping = 1;
+#ifdef _WIN32
+	ReleaseSemaphore(queueSemaphore, workerCount, NULL);
+#else
+	pthread_cond_broadcast(&queueReady);
+#endif
+	UNLOCK();
+	for(i = 0; i < workerCount; i++) {
+#ifdef _WIN32
+		WaitForSingleObject(workers[i], INFINITE);
+		CloseHandle(workers[i]);
+#else
+		pthread_join(workers[i], NULL);
+#endif
+	}
+	workerCount = 0;
+	stopping = 0;
+}
+
+int
+jpegDecodeStart(char *source, unsigned sourceSize, int scale,
+		int x, int y, int width, int height, int semaIndex)
+{
+	JPEGDecodeJob *job;
+	int handle;
+
+	if(!jpegValidScale(scale) || width < 0 || height < 0
+	 || (height > 0 && width > 0x1FFFFFFF / height))
+		return -1;
+	for(handle = 0; handle < JPEG_MAX_DECODES && decodeJobs[handle]; handle++);
+	if(handle >= JPEG_MAX_DECODES) return -1;
+	job = calloc(1, sizeof(JPEGDecodeJob));
+	if(!job) return -1;
+	job->source = malloc(sourceSize > 0 ? sourceSize : 1);
+	if(!job->source) {
+		free(job);
+		return -1;
+	}
+	memcpy(job->source, source, sourceSize);
+	job->sourceSize = sourceSize;
+	job->scale = scale;
+	job->x = x;
+	job->y = y;
+	job->width = width;
+	job->height = height;
+	job->semaIndex = semaIndex;
+	job->state = JOB_QUEUED;
+	decodeJobs[handle] = job;
+
+	startWorkers();
+	if(workerCount == 0) {
+		/* no threads: decode now and signal right away */
+		job->state = JOB_RUNNING;
+		runJob(job);
+		return handle;
+	}
+	LOCK();
+	if(queueTail)
+		queueTail->next = job;
+	else
+		queueHead = job;
+	queueTail = job;
+#ifdef _WIN32
+	ReleaseSemaphore(queueSemaphore, 1, NULL);
+#else
+	pthread_cond_signal(&queueReady);
+#endif
+	UNLOCK();
+	return handle;
+}
+
+int
+jpegDecodeStatus(int handle)
+{
+	int status;
+
+	if(handle < 0 || handle >= JPEG_MAX_DECODES || !decodeJobs[handle]) return -2;
+	LOCK();
+	switch(decodeJobs[handle]->state) {
+		case JOB_DONE: status = 0; break;
+		case JOB_FAILED: status = -2; break;
+		default: status = -1;
+	}
+	UNLOCK();
+	return status;
+}
+
+int
+jpegDecodeRelease(int handle)
+{
+	JPEGDecodeJob *job, **link;
+	int running;
+
+	if(handle < 0 || handle >= JPEG_MAX_DECODES || !decodeJobs[handle]) return 0;
+	job = decodeJobs[handle];
+	decodeJobs[handle] = NULL;
+	LOCK();
+	running = job->state == JOB_RUNNING;
+	if(running)
+		job->released = 1;
+	else if(job->state == JOB_QUEUED) {
+		for(link = &queueHead; *link != job; link = &(*link)->next);
+		*link = job->next;
+		if(queueTail == job) {
+			for(queueTail = queueHead; queueTail && queueTail->next; queueTail = queueTail->next);
+		}
+	}
+	UNLOCK();
+	if(!running) freeJob(job);
+	return 1;
+}
+
+int
+jpegDecodeResult(int handle, unsigned int *bits, int width, int height, int depth, int dither)
+{
+	JPEGDecodeJob *job;
+	int ok;
+
+	if(jpegDecodeStatus(handle) != 0) return 0;
+	job = decodeJobs[handle];
+	if(width != job->width || height != job->height) return 0;
+	ok = storePixels(job->pixels, bits, width, height, depth, dither);
+	if(ok) jpegDecodeRelease(handle);
+	return ok;
+}
+
+int
+jpegDecodeInit(void)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(&decodeLock);
+	queueSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+#endif
+	memset(decodeJobs, 0, sizeof(decodeJobs));
+	queueHead = queueTail = NULL;
+	workerCount = stopping = 0;
+	return 1;
+}
+
+int
+jpegDecodeShutdown(void)
+{
+	int i;
+
+	stopWorkers();
+	for(i = 0; i < JPEG_MAX_DECODES; i++)
+		if(decodeJobs[i]) jpegDecodeRelease(i);
+	return 1;
+}
@@ -0,0 +1,25 @@
+#ifndef JPEG_READER_PLUGIN_H
+#define JPEG_READER_PLUGIN_H
+/* JPEGReaderPlugin.h include file */
+
+/* Imported from sqJPEGDecode.c. Whole image decoding of sequential
+   Huffman coded JPEGs (baseline and extended, 8 bit samples) with one
+   (grayscale) or three (YCbCr) components. Progressive, arithmetic coded,
+   CMYK and multi-scan images are not handled; the Smalltalk decoder is
+   used for those. */
+
+/* Answer true if data holds an image that jpegDecodeImage can decode,
+   and its extent and number of components */
+int jpegImageInfo(unsigned char *data, int size,
+		  int *width, int *height, int *components);
+
+/* Decode data into the 32 bit pixels of a width by height Form, giving
+   the same pixels as the per-MCU primitives with no dithering. The image
+   is clipped to the Form. With threads > 1, and restart markers in the
+   image, the restart intervals are decoded on that many threads. Corrupt
+   entropy coded data decodes as far as possible. Answer false if the
+   image is not supported or memory runs out. */
+int jpegDecodeImage(unsigned char *data, int size,
+		    unsigned int *bits, int width, int height, int threads);
+
+#endif /* JPEG_READER_PLUGIN_H */
@@ -0,0 +1,1054 @@
+/*
+ *  sqJPEGDecode.c
+ *  JPEGReaderPlugin
+ *
+ *  Whole image decoding for the JPEGReaderPlugin.
+ *
+ *  The Smalltalk decoder calls primitiveDecodeMCU, primitiveIdctInt and
+ *  primitiveColorConvertMCU once per block or MCU. Here the headers are
+ *  parsed and the entropy coded data is Huffman decoded, transformed and
+ *  converted to RGB in one call, straight into the bits of a 32 bit Form.
+ *  The arithmetic is that of the per-MCU primitives: the same integer
+ *  IDCT (with its offset of 127 rather than 128), replicated chroma and
+ *  the same fixed point color conversion, so the pixels are identical.
+ *
+ *  With SSE2 the IDCT works on 8 columns (then 8 rows) at a time with
+ *  16 bit inputs, and the products of the fixed point constants are
+ *  combined pairwise with _mm_madd_epi16. That is exact while the inputs
+ *  of each pass fit in 15 bits, which holds for any sensible image; a
+ *  block outside that range goes through the scalar IDCT instead. The
+ *  color conversion splits the constants above 2^15 into a multiple of
+ *  2^16 and a remainder so that it can use _mm_mulhi_epi16, and is exact
+ *  as well.
+ *
+ *  The component planes for the whole image are decoded first. Each
+ *  restart interval is independent of the others, so with restart
+ *  markers and more than one thread the intervals are shared out between
+ *  threads, and so are the rows for the color conversion. Without threads
+ *  each MCU row is converted as soon as it has been decoded.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "JPEGReaderPlugin.h"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define JPEG_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#define FAST_BITS 10
+/* The bit buffer is a size_t, so 64 bits where pointers are */
+#define BUFFER_BITS ((int) (8 * sizeof(size_t)))
+#define MAX_THREADS 8
+/* Images with fewer blocks are not worth starting threads for */
+#define THREAD_BLOCKS 4096
+
+#define SAMPLE_OFFSET 127
+#define CONST_BITS 13
+#define PASS1_SHIFT 11
+#define PASS2_SHIFT 18
+
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+
+/* YCbCr to RGB, scaled by 2^16 */
+#define FIX_0_34414 22554
+#define FIX_0_71414 46802
+#define FIX_1_40200 91881
+#define FIX_1_77200 116130
+
+typedef struct {
+	unsigned short fast[1 << FAST_BITS];	/* length << 8 + value, 0 if longer */
+	/* For AC codes that fit with their extra bits: value << 8 + run << 4
+	   + length of code and bits, 0 if longer */
+	short fastAC[1 << FAST_BITS];
+	int maxCode[17];
+	int valueOffset[17];
+	unsigned char values[256];
+} JPEGHuffman;
+
+typedef struct {
+	int id, h, v, hScale, vScale;
+	int quant, dcTable, acTable;
+	int blocksWide, blocksHigh, stride;
+	unsigned char *plane;
+} JPEGComponent;
+
+typedef struct {
+	int width, height, components;
+	int hMax, vMax, mcuWide, mcuHigh, restartInterval;
+	int quant[4][64];
+	JPEGHuffman dc[4], ac[4];
+	int quantDefined, dcDefined, acDefined;
+	JPEGComponent comp[3];
+	int order[3];				/* components in scan order */
+	unsigned char *scan, *end;		/* entropy coded data */
+	int segmentCount;
+	unsigned char **starts, **ends;		/* of the restart intervals */
+	unsigned int *bits;
+	int formWidth, formHeight;
+} JPEGImage;
+
+typedef struct {
+	JPEGImage *image;
+	int decoding, first, last;
+	unsigned char *next, *end;
+	size_t buffer;
+	int count;
+	int pred[3];
+	unsigned char *samples;
+	int coef[64];
+} JPEGJob;
+
+static const unsigned char naturalOrder[64] = {
+	0, 1, 8, 16, 9, 2, 3, 10,
+	17, 24, 32, 25, 18, 11, 4, 5,
+	12, 19, 26, 33, 40, 48, 41, 34,
+	27, 20, 13, 6, 7, 14, 21, 28,
+	35, 42, 49, 56, 57, 50, 43, 36,
+	29, 22, 15, 23, 30, 37, 44, 51,
+	58, 59, 52, 45, 38, 31, 39, 46,
+	53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/*** Headers ***/
+
+static int
+readShort(unsigned char *p)
+{
+	return (p[0] << 8) | p[1];
+}
+
+static int
+parseFrame(JPEGImage *img, unsigned char *seg, int length)
+{
+	int i, j, blocks = 0;
+
+	if(length < 6 || seg[0] != 8) return 0;
+	img->height = readShort(seg + 1);
+	img->width = readShort(seg + 3);
+	img->components = seg[5];
+	/* a height of zero is only given in a later DNL marker */
+	if(img->width == 0 || img->height == 0) return 0;
+	if(img->components != 1 && img->components != 3) return 0;
+	if(length < 6 + 3 * img->components) return 0;
+	img->hMax = img->vMax = 1;
+	for(i = 0; i < img->components; i++) {
+		JPEGComponent *c = &img->comp[i];
+		unsigned char *p = seg + 6 + 3 * i;
+
+		c->id = p[0];
+		c->h = p[1] >> 4;
+		c->v = p[1] & 15;
+		c->quant = p[2];
+		if(c->h < 1 || c->h > 4 || c->v < 1 || c->v > 4 || c->quant > 3) return 0;
+		for(j = 0; j < i; j++)
+			if(img->comp[j].id == c->id) return 0;
+		/* a single component is coded one block at a time */
+		if(img->components == 1) c->h = c->v = 1;
+		if(c->h > img->hMax) img->hMax = c->h;
+		if(c->v > img->vMax) img->vMax = c->v;
+		blocks += c->h * c->v;
+	}
+	if(blocks > 10) return 0;
+	img->mcuWide = (img->width + 8 * img->hMax - 1) / (8 * img->hMax);
+	img->mcuHigh = (img->height + 8 * img->vMax - 1) / (8 * img->vMax);
+	for(i = 0; i < img->components; i++) {
+		JPEGComponent *c = &img->comp[i];
+
+		/* chroma is replicated, so it must divide evenly */
+		if(img->hMax % c->h || img->vMax % c->v) return 0;
+		c->hScale = img->hMax / c->h;
+		c->vScale = img->vMax / c->v;
+		c->blocksWide = img->mcuWide * c->h;
+		c->blocksHigh = img->mcuHigh * c->v;
+		c->stride = c->blocksWide * 8;
+	}
+	return 1;
+}
+
+static int
+parseQuant(JPEGImage *img, unsigned char *seg, int length)
+{
+	while(length > 0) {
+		int precision = seg[0] >> 4, table = seg[0] & 15, k;
+
+		if(precision > 1 || table > 3 || length < 1 + 64 * (precision + 1)) return 0;
+		for(k = 0; k < 64; k++)
+			img->quant[table][naturalOrder[k]] =
+				precision ? readShort(seg + 1 + 2 * k) : seg[1 + k];
+		img->quantDefined |= 1 << table;
+		seg += 1 + 64 * (precision + 1);
+		length -= 1 + 64 * (precision + 1);
+	}
+	return 1;
+}
+
+static int
+buildHuffman(JPEGHuffman *h, unsigned char *counts, unsigned char *values, int total)
+{
+	int length, i, k = 0, code = 0;
+
+	memset(h->fast, 0, sizeof(h->fast));
+	memcpy(h->values, values, total);
+	for(length = 1; length <= 16; length++) {
+		int n = counts[length - 1];
+
+		h->valueOffset[length] = k - code;
+		for(i = 0; i < n; i++, k++, code++) {
+			/* more codes than fit in this length */
+			if(code >= 1 << length) return 0;
+			if(length <= FAST_BITS) {
+				int j, shift = FAST_BITS - length;
+
+				for(j = 0; j < 1 << shift; j++)
+					h->fast[(code << shift) + j] = (unsigned short) ((length << 8) + values[k]);
+			}
+		}
+		h->maxCode[length] = n ? code - 1 : -1;
+		code <<= 1;
+	}
+	memset(h->fastAC, 0, sizeof(h->fastAC));
+	for(i = 0; i < 1 << FAST_BITS; i++) {
+		int entry = h->fast[i];
+		int s = entry & 15, total = (entry >> 8) + s;
+
+		if(entry && s && total <= FAST_BITS) {
+			int v = (i >> (FAST_BITS - total)) & ((1 << s) - 1);
+
+			if(v < 1 << (s - 1)) v -= (1 << s) - 1;
+			if(v >= -128 && v <= 127)
+				h->fastAC[i] = (short) (v * 256 + (entry & 0xF0) + total);
+		}
+	}
+	return 1;
+}
+
+static int
+parseHuffman(JPEGImage *img, unsigned char *seg, int length)
+{
+	while(length > 0) {
+		int tableClass, table, total = 0, i;
+
+		if(length < 17) return 0;
+		tableClass = seg[0] >> 4;
+		table = seg[0] & 15;
+		if(tableClass > 1 || table > 3) return 0;
+		for(i = 1; i <= 16; i++) total += seg[i];
+		if(total > 256 || length < 17 + total) return 0;
+		if(!buildHuffman(tableClass ? &img->ac[table] : &img->dc[table], seg + 1, seg + 17, total))
+			return 0;
+		if(tableClass) img->acDefined |= 1 << table;
+		else img->dcDefined |= 1 << table;
+		seg += 17 + total;
+		length -= 17 + total;
+	}
+	return 1;
+}
+
+static int
+parseScan(JPEGImage *img, unsigned char *seg, int length)
+{
+	int i, j;
+
+	/* only a single scan holding every component */
+	if(length < 1 || seg[0] != img->components || length < 4 + 2 * img->components) return 0;
+	for(i = 0; i < img->components; i++) {
+		unsigned char *p = seg + 1 + 2 * i;
+		JPEGComponent *c = NULL;
+
+		for(j = 0; j < img->components; j++)
+			if(img->comp[j].id == p[0]) c = &img->comp[j];
+		if(!c) return 0;
+		img->order[i] = (int) (c - img->comp);
+		c->dcTable = p[1] >> 4;
+		c->acTable = p[1] & 15;
+		if(c->dcTable > 3 || c->acTable > 3) return 0;
+		if(!(img->dcDefined & (1 << c->dcTable)) || !(img->acDefined & (1 << c->acTable))) return 0;
+		if(!(img->quantDefined & (1 << c->quant))) return 0;
+	}
+	seg += 1 + 2 * img->components;
+	return seg[0] == 0 && seg[1] == 63 && seg[2] == 0;
+}
+
+/* Read the headers up to the start of the scan. Answer false for
+   anything we do not decode. */
+static int
+parseImage(JPEGImage *img, unsigned char *data, int size)
+{
+	unsigned char *p = data + 2, *end = data + size;
+	int sawFrame = 0;
+
+	memset(img, 0, sizeof(*img));
+	if(size < 4 || data[0] != 0xFF || data[1] != 0xD8) return 0;
+	for(;;) {
+		int marker, length;
+
+		while(p < end && *p != 0xFF) p++;
+		while(p < end && *p == 0xFF) p++;
+		if(end - p < 3) return 0;
+		marker = *p++;
+		/* markers without a segment */
+		if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) continue;
+		if(marker == 0xD9) return 0;
+		length = readShort(p);
+		if(length < 2 || length > end - p) return 0;
+		switch(marker) {
+		case 0xC0:	/* baseline */
+		case 0xC1:	/* extended sequential, Huffman */
+			if(sawFrame || !parseFrame(img, p + 2, length - 2)) return 0;
+			sawFrame = 1;
+			break;
+		case 0xC4:
+			if(!parseHuffman(img, p + 2, length - 2)) return 0;
+			break;
+		case 0xDB:
+			if(!parseQuant(img, p + 2, length - 2)) return 0;
+			break;
+		case 0xDD:
+			if(length < 4) return 0;
+			img->restartInterval = readShort(p + 2);
+			break;
+		case 0xDA:
+			if(!sawFrame || !parseScan(img, p + 2, length - 2)) return 0;
+			img->scan = p + length;
+			img->end = end;
+			return 1;
+		default:
+			/* progressive, lossless and arithmetic coded frames */
+			if(marker >= 0xC2 && marker <= 0xCF) return 0;
+			break;
+		}
+		p += length;
+	}
+}
+
+/* Find where each restart interval starts and ends. Missing intervals
+   are left empty, which decodes them from zero bits. */
+static int
+findSegments(JPEGImage *img)
+{
+	int mcus = img->mcuWide * img->mcuHigh;
+	int count = img->restartInterval ? (mcus + img->restartInterval - 1) / img->restartInterval : 1;
+	unsigned char *start = img->scan, *p = img->scan, *end = img->end;
+	int i = 0;
+
+	img->starts = (unsigned char **) malloc(2 * count * sizeof(unsigned char *));
+	if(!img->starts) return 0;
+	img->ends = img->starts + count;
+	img->segmentCount = count;
+	while(p < end) {
+		p = (unsigned char *) memchr(p, 0xFF, end - p);
+		if(!p || p + 1 >= end) {
+			p = end;
+			break;
+		}
+		if(p[1] == 0) p += 2;
+		else if(p[1] == 0xFF) p++;
+		else if(p[1] >= 0xD0 && p[1] <= 0xD7) {
+			if(i < count - 1) {
+				img->starts[i] = start;
+				img->ends[i++] = p;
+				start = p + 2;
+			}
+			p += 2;
+		}
+		else break;
+	}
+	img->starts[i] = start;
+	img->ends[i++] = p;
+	for(; i < count; i++)
+		img->starts[i] = img->ends[i] = p;
+	return 1;
+}
+
+/*** Huffman decoding ***/
+
+static void
+startSegment(JPEGJob *job, int segment)
+{
+	job->next = job->image->starts[segment];
+	job->end = job->image->ends[segment];
+	job->buffer = 0;
+	job->count = 0;
+	job->pred[0] = job->pred[1] = job->pred[2] = 0;
+}
+
+/* Top up the bit buffer to more than BUFFER_BITS - 8 bits. At a marker
+   or the end of the data it is padded with zeros. */
+static void
+fillBits(JPEGJob *job)
+{
+	while(job->count <= BUFFER_BITS - 8) {
+		unsigned int byte = 0;
+
+		if(job->next < job->end) {
+			byte = *job->next++;
+			if(byte == 0xFF) {
+				if(job->next < job->end && *job->next == 0)
+					job->next++;
+				else {
+					byte = 0;
+					job->next = job->end;
+				}
+			}
+		}
+		job->buffer |= (size_t) byte << (BUFFER_BITS - 8 - job->count);
+		job->count += 8;
+	}
+}
+
+/* Answer the next symbol, or 0 (an end of block or a zero difference)
+   for a code that is not in the table */
+static int
+decodeSymbol(JPEGJob *job, JPEGHuffman *h)
+{
+	int entry, length;
+
+	if(job->count < 16) fillBits(job);
+	entry = h->fast[job->buffer >> (BUFFER_BITS - FAST_BITS)];
+	if(entry) {
+		length = entry >> 8;
+		entry &= 0xFF;
+	}
+	else {
+		for(length = FAST_BITS + 1; length <= 16; length++) {
+			int code = (int) (job->buffer >> (BUFFER_BITS - length));
+
+			if(code <= h->maxCode[length]) break;
+		}
+		if(length > 16) return 0;
+		entry = h->values[(int) (job->buffer >> (BUFFER_BITS - length)) + h->valueOffset[length]];
+	}
+	job->buffer <<= length;
+	job->count -= length;
+	return entry;
+}
+
+/* Read an s bit difference, 1 <= s <= 15 */
+static int
+receiveExtend(JPEGJob *job, int s)
+{
+	int value;
+
+	if(job->count < s) fillBits(job);
+	value = (int) (job->buffer >> (BUFFER_BITS - s));
+	job->buffer <<= s;
+	job->count -= s;
+	return value < 1 << (s - 1) ? value - (1 << s) + 1 : value;
+}
+
+/* Decode one block into job->coef, dequantized and in natural order.
+   Answer -1 if there are no AC coefficients, 1 if a coefficient does not
+   fit in 15 bits and 0 otherwise. Products are taken modulo 2^32, as the
+   per-MCU primitives do with 32 bit integers. */
+static int
+decodeBlock(JPEGJob *job, JPEGComponent *c, int *pred)
+{
+	JPEGImage *img = job->image;
+	JPEGHuffman *ac = &img->ac[c->acTable];
+	int *q = img->quant[c->quant];
+	int *coef = job->coef;
+	unsigned int magnitude;
+	int s, k, hasAC = 0;
+
+	memset(coef, 0, 64 * sizeof(int));
+	s = decodeSymbol(job, &img->dc[c->dcTable]);
+	if(s > 0 && s <= 15)
+		*pred = (int) ((unsigned int) *pred + receiveExtend(job, s));
+	coef[0] = (int) ((unsigned int) *pred * q[0]);
+	magnitude = coef[0] < 0 ? 0U - (unsigned int) coef[0] : (unsigned int) coef[0];
+	for(k = 1; k < 64; k++) {
+		int rs, v, fast;
+
+		if(job->count < 16) fillBits(job);
+		fast = ac->fastAC[job->buffer >> (BUFFER_BITS - FAST_BITS)];
+		if(fast) {
+			job->buffer <<= fast & 15;
+			job->count -= fast & 15;
+			k += (fast >> 4) & 15;
+			if(k > 63) break;
+			v = (int) ((unsigned int) (fast >> 8) * q[naturalOrder[k]]);
+			coef[naturalOrder[k]] = v;
+			magnitude |= v < 0 ? 0U - (unsigned int) v : (unsigned int) v;
+			hasAC = 1;
+			continue;
+		}
+		rs = decodeSymbol(job, ac);
+		s = rs & 15;
+		if(!s) {
+			if(rs != 0xF0) break;
+			k += 15;
+			continue;
+		}
+		k += rs >> 4;
+		if(k > 63) break;
+		v = (int) ((unsigned int) receiveExtend(job, s) * q[naturalOrder[k]]);
+		coef[naturalOrder[k]] = v;
+		magnitude |= v < 0 ? 0U - (unsigned int) v : (unsigned int) v;
+		hasAC = 1;
+	}
+	return hasAC ? magnitude >= 16384 : -1;
+}
+
+/*** IDCT ***/
+
+#define DESCALE(x, n) ((int) (x) >> (n))
+#define CLAMP_SAMPLE(x) ((x) < 0 ? 0 : (x) > 255 ? 255 : (x))
+
+/* The IDCT of the per-MCU primitives, in 32 bit arithmetic */
+static void
+idctBlock(int *coef, unsigned char *out, int stride)
+{
+	int ws[64];
+	unsigned int z1, z2, z3, z4, z5, t0, t1, t2, t3, t10, t11, t12, t13;
+	int i, j;
+
+	for(i = 0; i < 8; i++) {
+		int *in = coef + i;
+
+		if(!(in[8] | in[16] | in[24] | in[32] | in[40] | in[48] | in[56])) {
+			int dc = (int) ((unsigned int) in[0] << 2);
+
+			for(j = 0; j < 8; j++) ws[j * 8 + i] = dc;
+			continue;
+		}
+		z2 = in[16];
+		z3 = in[48];
+		z1 = (z2 + z3) * FIX_0_541196100;
+		t2 = z1 - z3 * FIX_1_847759065;
+		t3 = z1 + z2 * FIX_0_765366865;
+		t0 = ((unsigned int) in[0] + in[32]) << CONST_BITS;
+		t1 = ((unsigned int) in[0] - in[32]) << CONST_BITS;
+		t10 = t0 + t3;
+		t13 = t0 - t3;
+		t11 = t1 + t2;
+		t12 = t1 - t2;
+		t0 = in[56];
+		t1 = in[40];
+		t2 = in[24];
+		t3 = in[8];
+		z1 = t0 + t3;
+		z2 = t1 + t2;
+		z3 = t0 + t2;
+		z4 = t1 + t3;
+		z5 = (z3 + z4) * FIX_1_175875602;
+		t0 *= FIX_0_298631336;
+		t1 *= FIX_2_053119869;
+		t2 *= FIX_3_072711026;
+		t3 *= FIX_1_501321110;
+		z1 *= 0U - FIX_0_899976223;
+		z2 *= 0U - FIX_2_562915447;
+		z3 = z3 * (0U - FIX_1_961570560) + z5;
+		z4 = z4 * (0U - FIX_0_390180644) + z5;
+		t0 += z1 + z3;
+		t1 += z2 + z4;
+		t2 += z2 + z3;
+		t3 += z1 + z4;
+		ws[i] = DESCALE(t10 + t3, PASS1_SHIFT);
+		ws[56 + i] = DESCALE(t10 - t3, PASS1_SHIFT);
+		ws[8 + i] = DESCALE(t11 + t2, PASS1_SHIFT);
+		ws[48 + i] = DESCALE(t11 - t2, PASS1_SHIFT);
+		ws[16 + i] = DESCALE(t12 + t1, PASS1_SHIFT);
+		ws[40 + i] = DESCALE(t12 - t1, PASS1_SHIFT);
+		ws[24 + i] = DESCALE(t13 + t0, PASS1_SHIFT);
+		ws[32 + i] = DESCALE(t13 - t0, PASS1_SHIFT);
+	}
+	for(i = 0; i < 8; i++, out += stride) {
+		int *in = ws + 8 * i;
+		int v;
+
+		z2 = in[2];
+		z3 = in[6];
+		z1 = (z2 + z3) * FIX_0_541196100;
+		t2 = z1 - z3 * FIX_1_847759065;
+		t3 = z1 + z2 * FIX_0_765366865;
+		t0 = ((unsigned int) in[0] + in[4]) << CONST_BITS;
+		t1 = ((unsigned int) in[0] - in[4]) << CONST_BITS;
+		t10 = t0 + t3;
+		t13 = t0 - t3;
+		t11 = t1 + t2;
+		t12 = t1 - t2;
+		t0 = in[7];
+		t1 = in[5];
+		t2 = in[3];
+		t3 = in[1];
+		z1 = t0 + t3;
+		z2 = t1 + t2;
+		z3 = t0 + t2;
+		z4 = t1 + t3;
+		z5 = (z3 + z4) * FIX_1_175875602;
+		t0 *= FIX_0_298631336;
+		t1 *= FIX_2_053119869;
+		t2 *= FIX_3_072711026;
+		t3 *= FIX_1_501321110;
+		z1 *= 0U - FIX_0_899976223;
+		z2 *= 0U - FIX_2_562915447;
+		z3 = z3 * (0U - FIX_1_961570560) + z5;
+		z4 = z4 * (0U - FIX_0_390180644) + z5;
+		t0 += z1 + z3;
+		t1 += z2 + z4;
+		t2 += z2 + z3;
+		t3 += z1 + z4;
+		v = DESCALE(t10 + t3, PASS2_SHIFT) + SAMPLE_OFFSET; out[0] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t10 - t3, PASS2_SHIFT) + SAMPLE_OFFSET; out[7] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t11 + t2, PASS2_SHIFT) + SAMPLE_OFFSET; out[1] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t11 - t2, PASS2_SHIFT) + SAMPLE_OFFSET; out[6] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t12 + t1, PASS2_SHIFT) + SAMPLE_OFFSET; out[2] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t12 - t1, PASS2_SHIFT) + SAMPLE_OFFSET; out[5] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t13 + t0, PASS2_SHIFT) + SAMPLE_OFFSET; out[3] = (unsigned char) CLAMP_SAMPLE(v);
+		v = DESCALE(t13 - t0, PASS2_SHIFT) + SAMPLE_OFFSET; out[4] = (unsigned char) CLAMP_SAMPLE(v);
+	}
+}
+
+/* A block with only a DC coefficient is flat: both passes reduce to
+   (dc << 15) >> 18 */
+static void
+idctFlat(int dc, unsigned char *out, int stride)
+{
+	int v = DESCALE((unsigned int) dc << (2 + CONST_BITS), PASS2_SHIFT) + SAMPLE_OFFSET;
+	int i;
+
+	v = CLAMP_SAMPLE(v);
+	for(i = 0; i < 8; i++, out += stride)
+		memset(out, v, 8);
+}
+
+#ifdef JPEG_SSE2
+
+#define PAIR(a, b) _mm_setr_epi16(a, b, a, b, a, b, a, b)
+
+/* One half (four lanes) of the 1-D IDCT. The x.. arguments are pairs of
+   16 bit inputs interleaved for _mm_madd_epi16, e0 and e4 are inputs 0
+   and 4 shifted left by CONST_BITS; out[2 * k] receives output k. The
+   sums of products are those of the scalar IDCT regrouped, for example
+   t2 = (z2 + z3) * c1 - z3 * c2 = z2 * c1 + z3 * (c1 - c2). */
+static void
+idctHalf(__m128i x26, __m128i x34, __m128i x71, __m128i x53,
+	 __m128i e0, __m128i e4, __m128i *out)
+{
+	__m128i t0, t1, t2, t3, t10, t11, t12, t13, z3, z4;
+
+	t2 = _mm_madd_epi16(x26, PAIR(FIX_0_541196100, FIX_0_541196100 - FIX_1_847759065));
+	t3 = _mm_madd_epi16(x26, PAIR(FIX_0_541196100 + FIX_0_765366865, FIX_0_541196100));
+	t0 = _mm_add_epi32(e0, e4);
+	t1 = _mm_sub_epi32(e0, e4);
+	t10 = _mm_add_epi32(t0, t3);
+	t13 = _mm_sub_epi32(t0, t3);
+	t11 = _mm_add_epi32(t1, t2);
+	t12 = _mm_sub_epi32(t1, t2);
+	z3 = _mm_madd_epi16(x34, PAIR(FIX_1_175875602 - FIX_1_961570560, FIX_1_175875602));
+	z4 = _mm_madd_epi16(x34, PAIR(FIX_1_175875602, FIX_1_175875602 - FIX_0_390180644));
+	t0 = _mm_add_epi32(z3, _mm_madd_epi16(x71, PAIR(FIX_0_298631336 - FIX_0_899976223, -FIX_0_899976223)));
+	t3 = _mm_add_epi32(z4, _mm_madd_epi16(x71, PAIR(-FIX_0_899976223, FIX_1_501321110 - FIX_0_899976223)));
+	t1 = _mm_add_epi32(z4, _mm_madd_epi16(x53, PAIR(FIX_2_053119869 - FIX_2_562915447, -FIX_2_562915447)));
+	t2 = _mm_add_epi32(z3, _mm_madd_epi16(x53, PAIR(-FIX_2_562915447, FIX_3_072711026 - FIX_2_562915447)));
+	out[0] = _mm_add_epi32(t10, t3);
+	out[14] = _mm_sub_epi32(t10, t3);
+	out[2] = _mm_add_epi32(t11, t2);
+	out[12] = _mm_sub_epi32(t11, t2);
+	out[4] = _mm_add_epi32(t12, t1);
+	out[10] = _mm_sub_epi32(t12, t1);
+	out[6] = _mm_add_epi32(t13, t0);
+	out[8] = _mm_sub_epi32(t13, t0);
+}
+
+/* The 1-D IDCT of eight 16 bit vectors, across the vectors. out[2 * k]
+   and out[2 * k + 1] are lanes 0-3 and 4-7 of output k. */
+static void
+idctPass(__m128i *in, __m128i *out)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i z3 = _mm_add_epi16(in[7], in[3]);
+	__m128i z4 = _mm_add_epi16(in[5], in[1]);
+
+	idctHalf(_mm_unpacklo_epi16(in[2], in[6]), _mm_unpacklo_epi16(z3, z4),
+		 _mm_unpacklo_epi16(in[7], in[1]), _mm_unpacklo_epi16(in[5], in[3]),
+		 _mm_srai_epi32(_mm_unpacklo_epi16(zero, in[0]), 16 - CONST_BITS),
+		 _mm_srai_epi32(_mm_unpacklo_epi16(zero, in[4]), 16 - CONST_BITS),
+		 out);
+	idctHalf(_mm_unpackhi_epi16(in[2], in[6]), _mm_unpackhi_epi16(z3, z4),
+		 _mm_unpackhi_epi16(in[7], in[1]), _mm_unpackhi_epi16(in[5], in[3]),
+		 _mm_srai_epi32(_mm_unpackhi_epi16(zero, in[0]), 16 - CONST_BITS),
+		 _mm_srai_epi32(_mm_unpackhi_epi16(zero, in[4]), 16 - CONST_BITS),
+		 out + 1);
+}
+
+static void
+transpose8x16(__m128i *r)
+{
+	__m128i a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+	__m128i a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+	__m128i a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+	__m128i a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+
+	r[0] = _mm_unpacklo_epi64(b0, b4);
+	r[1] = _mm_unpackhi_epi64(b0, b4);
+	r[2] = _mm_unpacklo_epi64(b1, b5);
+	r[3] = _mm_unpackhi_epi64(b1, b5);
+	r[4] = _mm_unpacklo_epi64(b2, b6);
+	r[5] = _mm_unpackhi_epi64(b2, b6);
+	r[6] = _mm_unpacklo_epi64(b3, b7);
+	r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/* Answer false, without storing anything, if the intermediate results do
+   not fit in 15 bits */
+static int
+idctBlockSSE2(int *coef, unsigned char *out, int stride)
+{
+	__m128i in[8], ws[16];
+	__m128i bad = _mm_setzero_si128();
+	int i;
+
+	for(i = 0; i < 8; i++)
+		in[i] = _mm_packs_epi32(_mm_loadu_si128((__m128i *) (coef + 8 * i)),
+					_mm_loadu_si128((__m128i *) (coef + 8 * i + 4)));
+	idctPass(in, ws);
+	for(i = 0; i < 16; i++) {
+		ws[i] = _mm_srai_epi32(ws[i], PASS1_SHIFT);
+		bad = _mm_or_si128(bad, _mm_xor_si128(_mm_srai_epi32(ws[i], 14), _mm_srai_epi32(ws[i], 31)));
+	}
+	if(_mm_movemask_epi8(_mm_cmpeq_epi32(bad, _mm_setzero_si128())) != 0xFFFF) return 0;
+	for(i = 0; i < 8; i++)
+		in[i] = _mm_packs_epi32(ws[2 * i], ws[2 * i + 1]);
+	transpose8x16(in);
+	idctPass(in, ws);
+	for(i = 0; i < 8; i++)
+		in[i] = _mm_adds_epi16(_mm_packs_epi32(_mm_srai_epi32(ws[2 * i], PASS2_SHIFT),
+						       _mm_srai_epi32(ws[2 * i + 1], PASS2_SHIFT)),
+				       _mm_set1_epi16(SAMPLE_OFFSET));
+	transpose8x16(in);
+	for(i = 0; i < 8; i += 2) {
+		__m128i rows = _mm_packus_epi16(in[i], in[i + 1]);
+
+		_mm_storel_epi64((__m128i *) out, rows);
+		_mm_storel_epi64((__m128i *) (out + stride), _mm_srli_si128(rows, 8));
+		out += 2 * stride;
+	}
+	return 1;
+}
+
+#endif /* JPEG_SSE2 */
+
+/*** Decoding ***/
+
+static void
+decodeMCUs(JPEGJob *job, int first, int last)
+{
+	JPEGImage *img = job->image;
+	int m, i, h, v;
+
+	for(m = first; m < last; m++) {
+		int mx = m % img->mcuWide, my = m / img->mcuWide;
+
+		if(img->restartInterval ? m % img->restartInterval == 0 : m == 0)
+			startSegment(job, img->restartInterval ? m / img->restartInterval : 0);
+		for(i = 0; i < img->components; i++) {
+			int index = img->order[i];
+			JPEGComponent *c = &img->comp[index];
+
+			for(v = 0; v < c->v; v++)
+				for(h = 0; h < c->h; h++) {
+					unsigned char *out = c->plane
+						+ ((my * c->v + v) * 8) * c->stride
+						+ (mx * c->h + h) * 8;
+					int large = decodeBlock(job, c, &job->pred[index]);
+
+					if(large < 0)
+						idctFlat(job->coef[0], out, c->stride);
+#ifdef JPEG_SSE2
+					else if(!large && idctBlockSSE2(job->coef, out, c->stride))
+						;
+#endif
+					else
+						idctBlock(job->coef, out, c->stride);
+				}
+		}
+	}
+}
+
+/*** Color conversion ***/
+
+/* Answer row y of component c, with replicated samples if it is
+   subsampled horizontally */
+static unsigned char *
+sampleRow(JPEGComponent *c, int y, int width, unsigned char *buffer)
+{
+	unsigned char *row = c->plane + (y / c->vScale) * c->stride;
+	int x;
+
+	if(c->hScale == 1) return row;
+	if(c->hScale == 2) {
+		for(x = 0; x + 1 < width; x += 2)
+			buffer[x] = buffer[x + 1] = row[x >> 1];
+		if(x < width) buffer[x] = row[x >> 1];
+	}
+	else
+		for(x = 0; x < width; x++)
+			buffer[x] = row[x / c->hScale];
+	return buffer;
+}
+
+static void
+convertGray(unsigned char *y, unsigned int *out, int n)
+{
+	int i = 0;
+#ifdef JPEG_SSE2
+	__m128i one = _mm_set1_epi8(1), alpha = _mm_set1_epi8((char) 0xFF);
+
+	for(; i + 16 <= n; i += 16) {
+		__m128i v = _mm_max_epu8(_mm_loadu_si128((__m128i *) (y + i)), one);
+		__m128i vv = _mm_unpacklo_epi8(v, v), va = _mm_unpacklo_epi8(v, alpha);
+
+		_mm_storeu_si128((__m128i *) (out + i), _mm_unpacklo_epi16(vv, va));
+		_mm_storeu_si128((__m128i *) (out + i + 4), _mm_unpackhi_epi16(vv, va));
+		vv = _mm_unpackhi_epi8(v, v);
+		va = _mm_unpackhi_epi8(v, alpha);
+		_mm_storeu_si128((__m128i *) (out + i + 8), _mm_unpacklo_epi16(vv, va));
+		_mm_storeu_si128((__m128i *) (out + i + 12), _mm_unpackhi_epi16(vv, va));
+	}
+#endif
+	for(; i < n; i++) {
+		unsigned int v = y[i] < 1 ? 1 : y[i];
+
+		out[i] = 0xFF000000U + (v << 16) + (v << 8) + v;
+	}
+}
+
+static void
+convertYCbCr(unsigned char *y, unsigned char *cb, unsigned char *cr, unsigned int *out, int n)
+{
+	int i = 0;
+#ifdef JPEG_SSE2
+	__m128i zero = _mm_setzero_si128(), offset = _mm_set1_epi16(SAMPLE_OFFSET);
+	__m128i one = _mm_set1_epi8(1), alpha = _mm_set1_epi8((char) 0xFF);
+
+	/* 91881 = 2^16 + 26345, 46802 = 2^16 - 18734, 116130 = 2^17 - 14942 */
+	for(; i + 8 <= n; i += 8) {
+		__m128i vy = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (y + i)), zero);
+		__m128i vb = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (cb + i)), zero), offset);
+		__m128i vr = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *) (cr + i)), zero), offset);
+		__m128i r = _mm_add_epi16(_mm_add_epi16(vy, vr), _mm_mulhi_epi16(vr, _mm_set1_epi16(26345)));
+		__m128i g = _mm_sub_epi16(_mm_sub_epi16(vy, _mm_mulhi_epi16(vb, _mm_set1_epi16(FIX_0_34414))),
+					  _mm_add_epi16(vr, _mm_mulhi_epi16(vr, _mm_set1_epi16(-18734))));
+		__m128i b = _mm_add_epi16(_mm_add_epi16(vy, _mm_add_epi16(vb, vb)),
+					  _mm_mulhi_epi16(vb, _mm_set1_epi16(-14942)));
+		__m128i rg, bg, ra;
+
+		r = _mm_max_epu8(_mm_packus_epi16(r, r), one);
+		g = _mm_max_epu8(_mm_packus_epi16(g, g), one);
+		b = _mm_max_epu8(_mm_packus_epi16(b, b), one);
+		bg = _mm_unpacklo_epi8(b, g);
+		ra = _mm_unpacklo_epi8(r, alpha);
+		rg = _mm_unpacklo_epi16(bg, ra);
+		_mm_storeu_si128((__m128i *) (out + i), rg);
+		_mm_storeu_si128((__m128i *) (out + i + 4), _mm_unpackhi_epi16(bg, ra));
+	}
+#endif
+	for(; i < n; i++) {
+		int yy = y[i], vb = cb[i] - SAMPLE_OFFSET, vr = cr[i] - SAMPLE_OFFSET;
+		int r = yy + ((FIX_1_40200 * vr) >> 16);
+		int g = yy - ((FIX_0_34414 * vb) >> 16) - ((FIX_0_71414 * vr) >> 16);
+		int b = yy + ((FIX_1_77200 * vb) >> 16);
+
+		r = CLAMP_SAMPLE(r);
+		g = CLAMP_SAMPLE(g);
+		b = CLAMP_SAMPLE(b);
+		out[i] = 0xFF000000U
+			+ ((unsigned int) (r < 1 ? 1 : r) << 16)
+			+ ((unsigned int) (g < 1 ? 1 : g) << 8)
+			+ (unsigned int) (b < 1 ? 1 : b);
+	}
+}
+
+static void
+convertRows(JPEGJob *job, int first, int last)
+{
+	JPEGImage *img = job->image;
+	int n = img->width < img->formWidth ? img->width : img->formWidth;
+	int y;
+
+	if(last > img->formHeight) last = img->formHeight;
+	for(y = first; y < last; y++) {
+		unsigned int *out = img->bits + (size_t) y * img->formWidth;
+		unsigned char *luma = sampleRow(&img->comp[0], y, n, job->samples);
+
+		if(img->components == 1)
+			convertGray(luma, out, n);
+		else
+			convertYCbCr(luma,
+				     sampleRow(&img->comp[1], y, n, job->samples + n),
+				     sampleRow(&img->comp[2], y, n, job->samples + 2 * n),
+				     out, n);
+	}
+}
+
+/*** Threads ***/
+
+static void
+runJob(JPEGJob *job)
+{
+	if(job->decoding)
+		decodeMCUs(job, job->first, job->last);
+	else
+		convertRows(job, job->first, job->last);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+jpegWorker(LPVOID arg)
+#else
+static void *
+jpegWorker(void *arg)
+#endif
+{
+	runJob((JPEGJob *) arg);
+	return 0;
+}
+
+/* Run jobs[1..count-1] on threads and jobs[0] here, and wait for all.
+   A job whose thread cannot be started is run here as well. */
+static void
+runJobs(JPEGJob *jobs, int count)
+{
+#ifdef _WIN32
+	HANDLE threads[MAX_THREADS];
+#else
+	pthread_t threads[MAX_THREADS];
+#endif
+	int started[MAX_THREADS];
+	int i;
+
+	for(i = 1; i < count; i++) {
+#ifdef _WIN32
+		threads[i] = CreateThread(NULL, 0, jpegWorker, &jobs[i], 0, NULL);
+		started[i] = threads[i] != NULL;
+#else
+		started[i] = pthread_create(&threads[i], NULL, jpegWorker, &jobs[i]) == 0;
+#endif
+		if(!started[i]) runJob(&jobs[i]);
+	}
+	runJob(&jobs[0]);
+	for(i = 1; i < count; i++)
+		if(started[i]) {
+#ifdef _WIN32
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+#else
+			pthread_join(threads[i], NULL);
+#endif
+		}
+}
+
+/*** Entry points ***/
+
+int
+jpegImageInfo(unsigned char *data, int size, int *width, int *height, int *components)
+{
+	JPEGImage img;
+
+	if(!data || !parseImage(&img, data, size)) return 0;
+	*width = img.width;
+	*height = img.height;
+	*components = img.components;
+	return 1;
+}
+
+int
+jpegDecodeImage(unsigned char *data, int size,
+		unsigned int *bits, int width, int height, int threads)
+{
+	JPEGImage *img;
+	JPEGJob jobs[MAX_THREADS];
+	unsigned char *planes = NULL, *samples = NULL;
+	size_t planeBytes = 0;
+	int i, count, rowBytes, ok = 0;
+
+	if(!data || !bits || width < 0 || height < 0) return 0;
+	img = (JPEGImage *) malloc(sizeof(JPEGImage));
+	if(!img) return 0;
+	if(!parseImage(img, data, size) || !findSegments(img)) goto done;
+	img->bits = bits;
+	img->formWidth = width;
+	img->formHeight = height;
+	for(i = 0; i < img->components; i++)
+		planeBytes += (size_t) img->comp[i].stride * img->comp[i].blocksHigh * 8;
+	planes = (unsigned char *) malloc(planeBytes);
+	if(!planes) goto done;
+	planeBytes = 0;
+	for(i = 0; i < img->components; i++) {
+		img->comp[i].plane = planes + planeBytes;
+		planeBytes += (size_t) img->comp[i].stride * img->comp[i].blocksHigh * 8;
+	}
+
+	count = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+	if(count > img->segmentCount) count = img->segmentCount;
+	if(planeBytes / 64 < THREAD_BLOCKS) count = 1;
+	rowBytes = 3 * img->width + 16;
+	samples = (unsigned char *) malloc((size_t) count * rowBytes);
+	if(!samples) goto done;
+	memset(jobs, 0, count * sizeof(JPEGJob));
+	for(i = 0; i < count; i++) {
+		jobs[i].image = img;
+		jobs[i].samples = samples + (size_t) i * rowBytes;
+	}
+
+	if(count == 1) {
+		int rowHeight = 8 * img->vMax, my;
+
+		for(my = 0; my < img->mcuHigh; my++) {
+			decodeMCUs(&jobs[0], my * img->mcuWide, (my + 1) * img->mcuWide);
+			convertRows(&jobs[0], my * rowHeight,
+				    (my + 1) * rowHeight < img->height ? (my + 1) * rowHeight : img->height);
+		}
+	}
+	else {
+		int mcus = img->mcuWide * img->mcuHigh;
+
+		for(i = 0; i < count; i++) {
+			int first = img->segmentCount * i / count;
+			int last = img->segmentCount * (i + 1) / count;
+
+			jobs[i].decoding = 1;
+			jobs[i].first = first * img->restartInterval;
+			jobs[i].last = last * img->restartInterval < mcus ? last * img->restartInterval : mcus;
+		}
+		runJobs(jobs, count);
+		for(i = 0; i < count; i++) {
+			jobs[i].decoding = 0;
+			jobs[i].first = img->height * i / count;
+			jobs[i].last = img->height * (i + 1) / count;
+		}
+		runJobs(jobs, count);
+	}
+	ok = 1;
+done:
+	free(samples);
+	free(planes);
+	free(img->starts);
+	free(img);
+	return ok;
+}
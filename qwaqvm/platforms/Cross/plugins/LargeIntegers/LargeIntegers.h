@@ -0,0 +1,19 @@
+/* LargeIntegers.h: support for the LargeIntegers plugin */
+
+/* Imported from sqLargeIntegerArith.c. Magnitudes are passed as the
+   little-endian byte digits of LargePositiveInteger but are processed
+   as 32-bit limbs. Both answer zero if their scratch memory could not
+   be allocated, in which case the caller should use the byte loops. */
+
+/* res gets aLen + bLen bytes */
+int liMultiply(unsigned char *a, int aLen, unsigned char *b, int bLen,
+	       unsigned char *res);
+
+/* The high byte of den must be non-zero and numLen >= denLen.
+   quo gets numLen - denLen + 1 bytes, rem gets denLen bytes. */
+int liDivide(unsigned char *num, int numLen, unsigned char *den, int denLen,
+	     unsigned char *quo, unsigned char *rem);
+
+/* Operand sizes (in bytes) below which the byte loops are faster */
+#define LI_MULTIPLY_THRESHOLD 16
+#define LI_DIVIDE_THRESHOLD 16
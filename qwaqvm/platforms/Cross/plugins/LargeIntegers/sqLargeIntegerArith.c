@@ -0,0 +1,488 @@
+/*
+ *  sqLargeIntegerArith.c
+ *  LargeIntegers
+ *
+ *  Multiplication and division of large magnitudes on 32-bit limbs.
+ *  The image sees little-endian byte digits; these are copied into limb
+ *  arrays, worked on four bytes at a time and copied back.
+ *
+ *  Products use schoolbook multiplication for small operands, Karatsuba
+ *  above KARATSUBA_THRESHOLD limbs and Toom-3 above TOOM3_THRESHOLD limbs.
+ *  Operands of very different length are cut into pieces of the shorter
+ *  length. Division is Knuth's algorithm D (TAOCP vol. 2, 4.3.1).
+ *
+ *  The thresholds were measured on x86-64 with gcc -O2.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "LargeIntegers.h"
+
+typedef unsigned int limb;
+#if defined(_MSC_VER)
+typedef unsigned __int64 dlimb;
+#else
+typedef unsigned long long dlimb;
+#endif
+
+#define KARATSUBA_THRESHOLD 32
+#define TOOM3_THRESHOLD 192
+
+static void
+loadLimbs(limb *r, int n, unsigned char *p, int len)
+{
+	int i;
+
+	memset(r, 0, n * sizeof(limb));
+	for(i = 0; i < len; i++)
+		r[i >> 2] |= (limb) p[i] << ((i & 3) * 8);
+}
+
+static void
+storeLimbs(unsigned char *p, int len, limb *r)
+{
+	int i;
+
+	for(i = 0; i < len; i++)
+		p[i] = (unsigned char) (r[i >> 2] >> ((i & 3) * 8));
+}
+
+/* r = a + b; answer the carry */
+static limb
+addN(limb *r, limb *a, limb *b, int n)
+{
+	dlimb t = 0;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		t += (dlimb) a[i] + b[i];
+		r[i] = (limb) t;
+		t >>= 32;
+	}
+	return (limb) t;
+}
+
+/* r = a - b; answer the borrow */
+static limb
+subN(limb *r, limb *a, limb *b, int n)
+{
+	dlimb t;
+	limb borrow = 0;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		t = (dlimb) a[i] - b[i] - borrow;
+		r[i] = (limb) t;
+		borrow = (limb) (t >> 63);
+	}
+	return borrow;
+}
+
+/* r += c over n limbs; answer the carry out */
+static limb
+add1(limb *r, int n, limb c)
+{
+	int i;
+
+	for(i = 0; i < n && c; i++) {
+		r[i] += c;
+		c = r[i] < c;
+	}
+	return c;
+}
+
+/* r -= c over n limbs; answer the borrow out */
+static limb
+sub1(limb *r, int n, limb c)
+{
+	int i;
+
+	for(i = 0; i < n && c; i++) {
+		limb old = r[i];
+		r[i] = old - c;
+		c = old < c;
+	}
+	return c;
+}
+
+/* r += a * b; answer the carry limb */
+static limb
+addmul1(limb *r, limb *a, int n, limb b)
+{
+	dlimb t = 0;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		t += (dlimb) a[i] * b + r[i];
+		r[i] = (limb) t;
+		t >>= 32;
+	}
+	return (limb) t;
+}
+
+/* r -= a * b; answer the borrow limb */
+static limb
+submul1(limb *r, limb *a, int n, limb b)
+{
+	dlimb p;
+	limb lo, borrow = 0;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		p = (dlimb) a[i] * b + borrow;
+		lo = (limb) p;
+		borrow = (limb) (p >> 32);
+		if(r[i] < lo) borrow++;
+		r[i] -= lo;
+	}
+	return borrow;
+}
+
+/* Shift r left by 0 < s < 32 bits; answer the bits shifted out */
+static limb
+lshiftN(limb *r, int n, int s)
+{
+	limb out = 0, w;
+	int i;
+
+	for(i = 0; i < n; i++) {
+		w = r[i];
+		r[i] = (w << s) | out;
+		out = w >> (32 - s);
+	}
+	return out;
+}
+
+/* Shift r right by 0 < s < 32 bits */
+static void
+rshiftN(limb *r, int n, int s)
+{
+	limb in = 0, w;
+	int i;
+
+	for(i = n - 1; i >= 0; i--) {
+		w = r[i];
+		r[i] = (w >> s) | in;
+		in = w << (32 - s);
+	}
+}
+
+/* r = r / 3 where r is known to be a multiple of 3 */
+static void
+divExact3(limb *r, int n)
+{
+	dlimb cur;
+	limb rem = 0;
+	int i;
+
+	for(i = n - 1; i >= 0; i--) {
+		cur = ((dlimb) rem << 32) | r[i];
+		r[i] = (limb) (cur / 3);
+		rem = (limb) (cur % 3);
+	}
+}
+
+/* Compare a (an limbs) with b (bn <= an limbs) */
+static int
+cmpExt(limb *a, int an, limb *b, int bn)
+{
+	int i;
+
+	for(i = an - 1; i >= bn; i--)
+		if(a[i]) return 1;
+	for(; i >= 0; i--)
+		if(a[i] != b[i]) return a[i] < b[i] ? -1 : 1;
+	return 0;
+}
+
+/* r (an limbs) = |a - b| where b has bn <= an limbs; answer 1 if a < b */
+static int
+absDiff(limb *r, limb *a, int an, limb *b, int bn)
+{
+	if(cmpExt(a, an, b, bn) >= 0) {
+		limb borrow = subN(r, a, b, bn);
+		memmove(r + bn, a + bn, (an - bn) * sizeof(limb));
+		sub1(r + bn, an - bn, borrow);
+		return 0;
+	}
+	/* a < b, so the limbs of a above bn are zero */
+	subN(r, b, a, bn);
+	memset(r + bn, 0, (an - bn) * sizeof(limb));
+	return 1;
+}
+
+/* r (rn limbs) += c (cn limbs) << (32 * off); the sum must fit */
+static void
+addAt(limb *r, int rn, int off, limb *c, int cn)
+{
+	limb carry;
+
+	while(cn > 0 && c[cn - 1] == 0) cn--;
+	if(cn == 0) return;
+	carry = addN(r + off, r + off, c, cn);
+	add1(r + off + cn, rn - off - cn, carry);
+}
+
+/* r (an + bn limbs) = a * b */
+static void
+mulBasecase(limb *r, limb *a, int an, limb *b, int bn)
+{
+	int j;
+
+	memset(r, 0, an * sizeof(limb));
+	for(j = 0; j < bn; j++)
+		r[an + j] = addmul1(r + j, a, an, b[j]);
+}
+
+static void mulN(limb *r, limb *a, limb *b, int n, limb *ws);
+
+/* Number of scratch limbs mulN needs for n-limb operands */
+static int
+mulScratch(int n)
+{
+	int k, s1, s2;
+
+	if(n < KARATSUBA_THRESHOLD) return 0;
+	if(n < TOOM3_THRESHOLD) {
+		k = (n + 1) / 2;
+		s1 = mulScratch(k);
+		s2 = mulScratch(n - k);
+		return 6 * k + 1 + (s1 > s2 ? s1 : s2);
+	}
+	k = (n + 2) / 3;
+	s1 = mulScratch(k + 1);
+	s2 = mulScratch(n - 2 * k);
+	if(s2 < mulScratch(k)) s2 = mulScratch(k);
+	return 6 * (k + 1) + 8 * (k + 1) + (s1 > s2 ? s1 : s2);
+}
+
+/* Karatsuba: a0*b1 + a1*b0 = a0*b0 + a1*b1 - (a0 - a1)*(b0 - b1) */
+static void
+mulKaratsuba(limb *r, limb *a, limb *b, int n, limb *ws)
+{
+	int lo = (n + 1) / 2, hi = n - lo;
+	limb *da = ws, *db = ws + lo, *p = ws + 2 * lo, *t = ws + 4 * lo;
+	limb *next = ws + 6 * lo + 1;
+	int neg;
+
+	neg = absDiff(da, a, lo, a + lo, hi);
+	neg ^= absDiff(db, b, lo, b + lo, hi);
+	mulN(p, da, db, lo, next);
+	mulN(r, a, b, lo, next);
+	mulN(r + 2 * lo, a + lo, b + lo, hi, next);
+
+	/* t = a0*b0 + a1*b1 -/+ p */
+	memcpy(t, r, 2 * lo * sizeof(limb));
+	t[2 * lo] = 0;
+	add1(t + 2 * hi, 2 * lo + 1 - 2 * hi, addN(t, t, r + 2 * lo, 2 * hi));
+	if(neg)
+		t[2 * lo] += addN(t, t, p, 2 * lo);
+	else
+		t[2 * lo] -= subN(t, t, p, 2 * lo);
+	addAt(r, 2 * n, lo, t, 2 * lo + 1);
+}
+
+/* Evaluate the three pieces of a at 1, -1 and 2; answer the sign of a(-1) */
+static int
+toomEvaluate(limb *a, int k, int h, limb *e1, limb *em1, limb *e2)
+{
+	limb *a0 = a, *a1 = a + k, *a2 = a + 2 * k;
+	int neg;
+
+	/* e1 = a0 + a2, em1 = |a0 - a1 + a2|, e1 += a1 */
+	memcpy(e1, a0, k * sizeof(limb));
+	e1[k] = add1(e1 + h, k - h, addN(e1, a0, a2, h));
+	neg = absDiff(em1, e1, k + 1, a1, k);
+	e1[k] += addN(e1, e1, a1, k);
+
+	/* e2 = ((a2 * 2) + a1) * 2 + a0 */
+	memset(e2, 0, (k + 1) * sizeof(limb));
+	memcpy(e2, a2, h * sizeof(limb));
+	lshiftN(e2, k + 1, 1);
+	e2[k] += addN(e2, e2, a1, k);
+	lshiftN(e2, k + 1, 1);
+	e2[k] += addN(e2, e2, a0, k);
+	return neg;
+}
+
+/* Toom-3 with evaluation points 0, 1, -1, 2 and infinity */
+static void
+mulToom3(limb *r, limb *a, limb *b, int n, limb *ws)
+{
+	int k = (n + 2) / 3, h = n - 2 * k, k1 = k + 1, w = 2 * (k + 1);
+	limb *ea1 = ws, *eam1 = ws + k1, *ea2 = ws + 2 * k1;
+	limb *eb1 = ws + 3 * k1, *ebm1 = ws + 4 * k1, *eb2 = ws + 5 * k1;
+	limb *v1 = ws + 6 * k1, *vm1 = v1 + w, *v2 = vm1 + w, *t = v2 + w;
+	limb *next = t + w;
+	limb *v0 = r, *vinf = r + 4 * k;
+	int neg;
+
+	neg = toomEvaluate(a, k, h, ea1, eam1, ea2);
+	neg ^= toomEvaluate(b, k, h, eb1, ebm1, eb2);
+	mulN(v0, a, b, k, next);
+	mulN(vinf, a + 2 * k, b + 2 * k, h, next);
+	mulN(v1, ea1, eb1, k1, next);
+	mulN(vm1, eam1, ebm1, k1, next);
+	mulN(v2, ea2, eb2, k1, next);
+
+	/* t = (v1 + vm1) / 2 = c0 + c2 + c4, vm1 = (v1 - vm1) / 2 = c1 + c3 */
+	if(neg) {
+		subN(t, v1, vm1, w);
+		addN(vm1, v1, vm1, w);
+	} else {
+		addN(t, v1, vm1, w);
+		subN(vm1, v1, vm1, w);
+	}
+	rshiftN(t, w, 1);
+	rshiftN(vm1, w, 1);
+
+	/* t = c2 */
+	sub1(t + 2 * k, w - 2 * k, subN(t, t, v0, 2 * k));
+	sub1(t + 2 * h, w - 2 * h, subN(t, t, vinf, 2 * h));
+
+	/* v2 = (v2 - c0 - 4 c2 - 16 c4) / 2 = c1 + 4 c3 */
+	sub1(v2 + 2 * k, w - 2 * k, subN(v2, v2, v0, 2 * k));
+	memcpy(v1, t, w * sizeof(limb));
+	lshiftN(v1, w, 2);
+	subN(v2, v2, v1, w);
+	memset(v1, 0, w * sizeof(limb));
+	memcpy(v1, vinf, 2 * h * sizeof(limb));
+	lshiftN(v1, w, 4);
+	subN(v2, v2, v1, w);
+	rshiftN(v2, w, 1);
+
+	/* v2 = c3, vm1 = c1 */
+	subN(v2, v2, vm1, w);
+	divExact3(v2, w);
+	subN(vm1, vm1, v2, w);
+
+	memset(r + 2 * k, 0, 2 * k * sizeof(limb));
+	addAt(r, 2 * n, k, vm1, w);
+	addAt(r, 2 * n, 2 * k, t, w);
+	addAt(r, 2 * n, 3 * k, v2, w);
+}
+
+/* r (2n limbs) = a * b for n-limb operands */
+static void
+mulN(limb *r, limb *a, limb *b, int n, limb *ws)
+{
+	if(n < KARATSUBA_THRESHOLD)
+		mulBasecase(r, a, n, b, n);
+	else if(n < TOOM3_THRESHOLD)
+		mulKaratsuba(r, a, b, n, ws);
+	else
+		mulToom3(r, a, b, n, ws);
+}
+
+int
+liMultiply(unsigned char *a, int aLen, unsigned char *b, int bLen,
+	   unsigned char *res)
+{
+	int an = (aLen + 3) / 4, bn = (bLen + 3) / 4, rn, off, c;
+	limb *mem, *pa, *pb, *pr, *tmp, *pad, *ws;
+
+	if(an < bn) {
+		unsigned char *swap = a; a = b; b = swap;
+		c = aLen; aLen = bLen; bLen = c;
+		c = an; an = bn; bn = c;
+	}
+	mem = malloc((2 * an + 5 * bn + mulScratch(bn)) * sizeof(limb));
+	if(mem == NULL) return 0;
+	pa = mem; pb = pa + an; pr = pb + bn; tmp = pr + an + bn;
+	pad = tmp + 2 * bn; ws = pad + bn;
+	memset(pr, 0, (an + bn) * sizeof(limb));
+	loadLimbs(pa, an, a, aLen);
+	loadLimbs(pb, bn, b, bLen);
+	while(an > 0 && pa[an - 1] == 0) an--;
+	while(bn > 0 && pb[bn - 1] == 0) bn--;
+	if(an < bn) {
+		limb *swap = pa; pa = pb; pb = swap;
+		c = an; an = bn; bn = c;
+	}
+	rn = an + bn;
+
+	if(bn < KARATSUBA_THRESHOLD) {
+		if(bn > 0) mulBasecase(pr, pa, an, pb, bn);
+	} else {
+		/* cut a into pieces of bn limbs */
+		for(off = 0; off < an; off += bn) {
+			c = an - off < bn ? an - off : bn;
+			if(c == bn) {
+				mulN(tmp, pa + off, pb, bn, ws);
+				addAt(pr, rn, off, tmp, 2 * bn);
+			} else if(c < KARATSUBA_THRESHOLD) {
+				mulBasecase(tmp, pb, bn, pa + off, c);
+				addAt(pr, rn, off, tmp, bn + c);
+			} else {
+				memset(pad, 0, bn * sizeof(limb));
+				memcpy(pad, pa + off, c * sizeof(limb));
+				mulN(tmp, pad, pb, bn, ws);
+				addAt(pr, rn, off, tmp, 2 * bn);
+			}
+		}
+	}
+	storeLimbs(res, aLen + bLen, pr);
+	free(mem);
+	return 1;
+}
+
+int
+liDivide(unsigned char *num, int numLen, unsigned char *den, int denLen,
+	 unsigned char *quo, unsigned char *rem)
+{
+	int un = (numLen + 3) / 4, n = (denLen + 3) / 4, qn = un - n + 1;
+	int i, j, s;
+	limb *mem, *u, *v, *q, top, borrow;
+	dlimb num2, qhat, rhat;
+
+	mem = malloc((un + 1 + n + qn) * sizeof(limb));
+	if(mem == NULL) return 0;
+	u = mem; v = u + un + 1; q = v + n;
+	loadLimbs(u, un, num, numLen);
+	loadLimbs(v, n, den, denLen);
+	u[un] = 0;
+
+	if(n == 1) {
+		rhat = 0;
+		for(i = un - 1; i >= 0; i--) {
+			num2 = (rhat << 32) | u[i];
+			q[i] = (limb) (num2 / v[0]);
+			rhat = num2 % v[0];
+		}
+		u[0] = (limb) rhat;
+	} else {
+		/* normalize so that the top bit of the divisor is set */
+		for(s = 0, top = v[n - 1]; !(top & 0x80000000U); top <<= 1) s++;
+		if(s) {
+			lshiftN(v, n, s);
+			u[un] = lshiftN(u, un, s);
+		}
+		for(j = un - n; j >= 0; j--) {
+			num2 = ((dlimb) u[j + n] << 32) | u[j + n - 1];
+			qhat = num2 / v[n - 1];
+			rhat = num2 % v[n - 1];
+			while(qhat > 0xFFFFFFFFU
+			      || qhat * v[n - 2] > ((rhat << 32) | u[j + n - 2])) {
+				qhat--;
+				rhat += v[n - 1];
+				if(rhat > 0xFFFFFFFFU) break;
+			}
+			borrow = submul1(u + j, v, n, (limb) qhat);
+			if(u[j + n] < borrow) {
+				/* qhat was one too large; add the divisor back */
+				u[j + n] -= borrow;
+				qhat--;
+				u[j + n] += addN(u + j, u + j, v, n);
+			} else {
+				u[j + n] -= borrow;
+			}
+			q[j] = (limb) qhat;
+		}
+		if(s) rshiftN(u, n, s);
+	}
+	storeLimbs(quo, numLen - denLen + 1, q);
+	storeLimbs(rem, denLen, u);
+	free(mem);
+	return 1;
+}
@@ -0,0 +1,31 @@
+#ifndef MISC_PRIMITIVE_PLUGIN_H
+#define MISC_PRIMITIVE_PLUGIN_H
+/* MiscPrimitivePlugin.h include file */
+
+/* Imported from sqMiscStringPrims.c. Offsets are zero-based; the search
+   functions answer -1 if there is no match. */
+
+/* Offset of the first byte equal to value */
+int miscIndexOfByte(unsigned char *string, int size, int value);
+
+/* Offset of the first byte whose entry in the 256 byte inclusionMap is
+   non-zero */
+int miscIndexOfByteInMap(unsigned char *string, int size, char *inclusionMap);
+
+/* Offset, at or beyond start, of the first occurrence of key in body,
+   comparing bytes through matchTable */
+int miscFindSubstring(unsigned char *key, int keySize,
+		      unsigned char *body, int bodySize, int start,
+		      unsigned char *matchTable);
+
+/* Answer 1, 2 or 3 if string1 is <, = or > string2 in the collating
+   order given by the 256 byte order table */
+int miscCompareStrings(unsigned char *string1, int size1,
+		       unsigned char *string2, int size2,
+		       unsigned char *order);
+
+/* SmallInteger>>hashMultiply applied to hash + each byte in turn; the
+   answer is in 0 .. 16r0FFFFFFF */
+unsigned int miscStringHash(unsigned char *string, int size, unsigned int hash);
+
+#endif /* MISC_PRIMITIVE_PLUGIN_H */
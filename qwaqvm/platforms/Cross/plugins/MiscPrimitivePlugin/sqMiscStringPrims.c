@@ -0,0 +1,293 @@
+/*
+ *  sqMiscStringPrims.c
+ *  MiscPrimitivePlugin
+ *
+ *  Kernels for the string search, compare and hash primitives.
+ *
+ *  With SSE2 the scans look at 16 bytes per step. A byte class (the bytes
+ *  that a matchTable maps to the same value, or the members of an
+ *  inclusion map) of up to four bytes is tested with one compare per
+ *  member. Larger classes fall back to table lookups. All loads stay
+ *  within the strings; the last few bytes are done one at a time.
+ *
+ *  Substring search uses the classes of the first and last key bytes to
+ *  pick candidate positions 16 at a time, and checks each candidate
+ *  through matchTable. When either class is too large it uses Horspool's
+ *  algorithm on the translated bytes. Both find the leftmost match, as
+ *  the original loop did.
+ */
+
+#include "MiscPrimitivePlugin.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define MISC_SSE2 1
+# include <emmintrin.h>
+#endif
+
+/* The largest byte class tested with vector compares */
+#define MAX_CLASS 4
+
+/* Shorter scans are not worth building byte classes or shift tables for */
+#define SHORT_SCAN 64
+
+#ifdef MISC_SSE2
+
+#ifdef _MSC_VER
+# include <intrin.h>
+static int
+lowestBit(unsigned int mask)
+{
+	unsigned long index;
+
+	_BitScanForward(&index, mask);
+	return (int) index;
+}
+#else
+# define lowestBit(mask) __builtin_ctz(mask)
+#endif
+
+/* Answer a 16 bit mask of the bytes in v that are members of set */
+static int
+classMask(__m128i v, __m128i *set, int count)
+{
+	__m128i m = _mm_cmpeq_epi8(v, set[0]);
+	int i;
+
+	for(i = 1; i < count; i++)
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, set[i]));
+	return _mm_movemask_epi8(m);
+}
+
+static void
+splatClass(unsigned char *members, int count, __m128i *set)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		set[i] = _mm_set1_epi8((char) members[i]);
+}
+
+#endif /* MISC_SSE2 */
+
+/* Collect the bytes whose entry in table is value (or, if value is -1,
+   any non-zero entry). Answer how many there are; at most MAX_CLASS are
+   stored into members. */
+static int
+byteClass(unsigned char *table, int value, unsigned char *members)
+{
+	int c, count = 0;
+#ifdef MISC_SSE2
+	__m128i v = _mm_set1_epi8((char) (value < 0 ? 0 : value));
+
+	for(c = 0; c < 256; c += 16) {
+		int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (table + c)), v));
+		if(value < 0) m ^= 0xFFFF;
+		while(m) {
+			if(count < MAX_CLASS) members[count] = (unsigned char) (c + lowestBit(m));
+			count++;
+			m &= m - 1;
+		}
+	}
+#else
+	for(c = 0; c < 256; c++)
+		if(value < 0 ? table[c] != 0 : table[c] == value) {
+			if(count < MAX_CLASS) members[count] = (unsigned char) c;
+			count++;
+		}
+#endif
+	return count;
+}
+
+int
+miscIndexOfByte(unsigned char *string, int size, int value)
+{
+	int i = 0;
+#ifdef MISC_SSE2
+	__m128i v;
+#endif
+
+	if(value < 0 || value > 255) return -1;
+#ifdef MISC_SSE2
+	v = _mm_set1_epi8((char) value);
+	for(; i + 32 <= size; i += 32) {
+		int lo = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (string + i)), v));
+		int hi = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (string + i + 16)), v));
+		if(lo | hi)
+			return lo ? i + lowestBit(lo) : i + 16 + lowestBit(hi);
+	}
+	for(; i + 16 <= size; i += 16) {
+		int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (string + i)), v));
+		if(m) return i + lowestBit(m);
+	}
+#endif
+	for(; i < size; i++)
+		if(string[i] == value) return i;
+	return -1;
+}
+
+int
+miscIndexOfByteInMap(unsigned char *string, int size, char *inclusionMap)
+{
+	unsigned char members[MAX_CLASS];
+	int count, i = 0;
+
+	if(size < SHORT_SCAN) {
+		for(; i < size; i++)
+			if(inclusionMap[string[i]]) return i;
+		return -1;
+	}
+	count = byteClass((unsigned char *) inclusionMap, -1, members);
+	if(count == 0) return -1;
+	if(count == 1) return miscIndexOfByte(string, size, members[0]);
+#ifdef MISC_SSE2
+	if(count <= MAX_CLASS) {
+		__m128i set[MAX_CLASS];
+
+		splatClass(members, count, set);
+		for(; i + 16 <= size; i += 16) {
+			int m = classMask(_mm_loadu_si128((__m128i *) (string + i)), set, count);
+			if(m) return i + lowestBit(m);
+		}
+	}
+#endif
+	for(; i + 4 <= size; i += 4) {
+		if(inclusionMap[string[i]]) return i;
+		if(inclusionMap[string[i + 1]]) return i + 1;
+		if(inclusionMap[string[i + 2]]) return i + 2;
+		if(inclusionMap[string[i + 3]]) return i + 3;
+	}
+	for(; i < size; i++)
+		if(inclusionMap[string[i]]) return i;
+	return -1;
+}
+
+static int
+matchesAt(unsigned char *key, int keySize, unsigned char *body, unsigned char *matchTable)
+{
+	int i;
+
+	for(i = 0; i < keySize; i++)
+		if(matchTable[body[i]] != matchTable[key[i]]) return 0;
+	return 1;
+}
+
+/* Horspool's algorithm, with the shifts indexed by translated byte */
+static int
+horspool(unsigned char *key, int keySize, unsigned char *body, int bodySize,
+	 int start, unsigned char *matchTable)
+{
+	int shift[256];
+	int i, pos, last = matchTable[key[keySize - 1]];
+
+	for(i = 0; i < 256; i++) shift[i] = keySize;
+	for(i = 0; i < keySize - 1; i++)
+		shift[matchTable[key[i]]] = keySize - 1 - i;
+	for(pos = start; pos <= bodySize - keySize; ) {
+		int v = matchTable[body[pos + keySize - 1]];
+		if(v == last && matchesAt(key, keySize - 1, body + pos, matchTable))
+			return pos;
+		pos += shift[v];
+	}
+	return -1;
+}
+
+int
+miscFindSubstring(unsigned char *key, int keySize,
+		  unsigned char *body, int bodySize, int start,
+		  unsigned char *matchTable)
+{
+#ifdef MISC_SSE2
+	unsigned char firstMembers[MAX_CLASS], lastMembers[MAX_CLASS];
+	__m128i firstSet[MAX_CLASS], lastSet[MAX_CLASS];
+	int firstCount, lastCount, pos;
+#endif
+
+	if(keySize <= 0 || start < 0 || start > bodySize - keySize) return -1;
+	if(bodySize - start < SHORT_SCAN) {
+		for(; start <= bodySize - keySize; start++)
+			if(matchesAt(key, keySize, body + start, matchTable)) return start;
+		return -1;
+	}
+#ifdef MISC_SSE2
+	firstCount = byteClass(matchTable, matchTable[key[0]], firstMembers);
+	lastCount = byteClass(matchTable, matchTable[key[keySize - 1]], lastMembers);
+	if(firstCount > MAX_CLASS || lastCount > MAX_CLASS)
+		return horspool(key, keySize, body, bodySize, start, matchTable);
+	splatClass(firstMembers, firstCount, firstSet);
+	splatClass(lastMembers, lastCount, lastSet);
+	for(pos = start; pos + 16 + keySize - 1 <= bodySize; pos += 16) {
+		int m = classMask(_mm_loadu_si128((__m128i *) (body + pos)), firstSet, firstCount)
+		      & classMask(_mm_loadu_si128((__m128i *) (body + pos + keySize - 1)), lastSet, lastCount);
+		while(m) {
+			int j = lowestBit(m);
+			if(matchesAt(key + 1, keySize - 2 > 0 ? keySize - 2 : 0, body + pos + j + 1, matchTable))
+				return pos + j;
+			m &= m - 1;
+		}
+	}
+	for(; pos <= bodySize - keySize; pos++)
+		if(matchesAt(key, keySize, body + pos, matchTable)) return pos;
+	return -1;
+#else
+	return horspool(key, keySize, body, bodySize, start, matchTable);
+#endif
+}
+
+int
+miscCompareStrings(unsigned char *string1, int size1,
+		   unsigned char *string2, int size2,
+		   unsigned char *order)
+{
+	int size = size1 < size2 ? size1 : size2;
+	int i = 0;
+
+	/* Equal bytes collate equally, so only mismatches need the table */
+#ifdef MISC_SSE2
+	while(i + 16 <= size) {
+		int m = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i *) (string1 + i)),
+							 _mm_loadu_si128((__m128i *) (string2 + i)))) ^ 0xFFFF;
+		if(m) {
+			int j = i + lowestBit(m);
+			int c1 = order[string1[j]], c2 = order[string2[j]];
+			if(c1 != c2) return c1 < c2 ? 1 : 3;
+			i = j + 1;
+		}
+		else
+			i += 16;
+	}
+#endif
+	for(; i < size; i++)
+		if(string1[i] != string2[i]) {
+			int c1 = order[string1[i]], c2 = order[string2[i]];
+			if(c1 != c2) return c1 < c2 ? 1 : 3;
+		}
+	return size1 == size2 ? 2 : (size1 < size2 ? 1 : 3);
+}
+
+/* hashMultiply is multiplication by 1664525 modulo 2^28, so eight steps
+   fold into hash * M^8 + b0 * M^8 + b1 * M^7 + ... + b7 * M. The byte
+   terms are summed in two groups of four, giving (hash * M^4 + a) * M^4
+   + b, which breaks the one multiply per byte dependency chain.
+   Arithmetic is modulo 2^32 and masked at the end. */
+#define M1 1664525U
+#define M2 (M1 * M1)
+#define M3 (M2 * M1)
+#define M4 (M3 * M1)
+
+unsigned int
+miscStringHash(unsigned char *string, int size, unsigned int hash)
+{
+	int i = 0;
+
+	hash &= 0x0FFFFFFF;
+	for(; i + 8 <= size; i += 8) {
+		unsigned int a = (string[i] * M4 + string[i + 1] * M3)
+			       + (string[i + 2] * M2 + string[i + 3] * M1);
+		unsigned int b = (string[i + 4] * M4 + string[i + 5] * M3)
+			       + (string[i + 6] * M2 + string[i + 7] * M1);
+		hash = (hash * M4 + a) * M4 + b;
+	}
+	for(; i < size; i++)
+		hash = (hash + string[i]) * M1;
+	return hash & 0x0FFFFFFF;
+}
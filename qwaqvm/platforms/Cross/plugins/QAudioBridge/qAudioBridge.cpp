@@ -0,0 +1,566 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qAudioBridge.cpp
+ *  QAudioBridge
+ *
+ */
+
+#include "qAudioBridge.hpp"
+using namespace Qwaq;
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#define closesocket_(s) closesocket(s)
+#else
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#define closesocket_(s) close(s)
+#define INVALID_SOCKET (-1)
+#endif
+
+const int TICK_MSECS = 20;
+// A speaker stays one for this long after falling quiet, so that it isn't
+// dropped between words.
+const int HANGOVER_TICKS = 25;
+// Enough packets to fill a sink's margin (1280 samples) when someone starts speaking.
+const unsigned PREROLL_PACKETS = 4;
+// Someone not heard from for this long isn't speaking, whatever they last sent.
+const usqLong SILENT_MICROSECONDS = 200000;
+
+
+int Qwaq::qBridgeLevel(const short* samples, int count)
+{
+	double power = 0;
+	for (int i = 0; i < count; i++) power += (double)samples[i] * samples[i];
+	if (count) power /= count;
+	if (power < 1) return 0;
+	int level = (int)(10 * log10(power) + 0.5);
+	return level > QBRIDGE_LEVEL_MAX ? QBRIDGE_LEVEL_MAX : level;
+}
+
+
+usqLong Qwaq::qBridgeMicroseconds()
+{
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+	static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+	return (now - epoch).total_microseconds();
+}
+
+
+double Qwaq::qBridgeCpuSeconds()
+{
+#ifdef WIN32
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime; u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+		+ (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+#endif
+}
+
+
+QAudioBridge::Participant::Participant(unsigned participantId)
+{
+	id = participantId;
+	memset(&address, 0, sizeof(address));
+	lastHeard = 0;
+	level = 0;
+	speaking = playing = false;
+	hangover = 0;
+
+	// Sinks belong to the Tickee map (see qMappedResourceBoilerplate.hpp).
+	QAudioSinkSpeex* s = new QAudioSinkSpeex();
+	sinkKey = s->key();
+	sink = boost::dynamic_pointer_cast<QAudioSinkSpeex>(Tickee::withKey(sinkKey));
+	encoder = qSpeexCreateHandle();
+	sequence = 0;
+
+	playedOrigin = mixOrigin = 0;
+	encodedSize = 0;
+}
+
+
+QAudioBridge::Participant::~Participant()
+{
+	if (playing) sink->stopDebugRecording();
+	Tickee::releaseKey(sinkKey);
+	qSpeexDestroyHandle(encoder);
+}
+
+
+QAudioBridge::QAudioBridge(const QBridgeSettings& s) : settings(s), workers(s.threads, "bridge worker")
+{
+	sock = INVALID_SOCKET;
+	receiver = ticker = NULL;
+	stopping = false;
+
+	QAudioSinkMixer* m = new QAudioSinkMixer();
+	mixerKey = m->key();
+	mixer = boost::dynamic_pointer_cast<QAudioSinkMixer>(Tickee::withKey(mixerKey));
+	commonEncoder = qSpeexCreateHandle();
+	commonEncodedSize = 0;
+	commonOrigin = 0;
+
+	ticks = lateTicks = playerTicks = decodes = encodes = 0;
+	tickSeconds = maxTickSeconds = 0;
+	packetsIn = packetsOut = 0;
+	statsStart = qBridgeMicroseconds();
+	statsCpuStart = qBridgeCpuSeconds();
+}
+
+
+QAudioBridge::~QAudioBridge()
+{
+	stop();
+	for (std::map<unsigned, ParticipantPtr>::iterator it = participants.begin(); it != participants.end(); it++) {
+		std::deque<Packet*>& preroll = it->second->preroll;
+		for (size_t i = 0; i < preroll.size(); i++) delete preroll[i];
+	}
+	participants.clear();
+	for (size_t i = 0; i < freePackets.size(); i++) delete freePackets[i];
+	Tickee::releaseKey(mixerKey);
+	qSpeexDestroyHandle(commonEncoder);
+}
+
+
+bool QAudioBridge::start()
+{
+	stop();
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock == INVALID_SOCKET) return false;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(settings.port);
+	if (bind(sock, (sockaddr*)&addr, sizeof(addr)) != 0) {
+		closesocket_(sock);
+		sock = INVALID_SOCKET;
+		return false;
+	}
+	// A tick sends a packet to every participant at once.
+	int bufferSize = 4 * 1024 * 1024;
+	setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char*)&bufferSize, sizeof(bufferSize));
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&bufferSize, sizeof(bufferSize));
+
+	stopping = false;
+	receiver = new boost::thread(boost::bind(&QAudioBridge::receiveLoop, this));
+	ticker = new boost::thread(boost::bind(&QAudioBridge::tickLoop, this));
+	return true;
+}
+
+
+void QAudioBridge::stop()
+{
+	stopping = true;
+	if (ticker) {
+		ticker->join();
+		delete ticker;
+		ticker = NULL;
+	}
+	if (receiver) {
+		receiver->join();
+		delete receiver;
+		receiver = NULL;
+	}
+	if (sock != INVALID_SOCKET) {
+		closesocket_(sock);
+		sock = INVALID_SOCKET;
+	}
+}
+
+
+void QAudioBridge::receiveLoop()
+{
+	char bytes[QBRIDGE_MAX_PACKET];
+	while (!stopping) {
+		// Wake up now and then to see whether to stop.
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(sock, &readable);
+		timeval timeout = { 0, 100000 };
+		if (select((int)sock + 1, &readable, NULL, NULL, &timeout) <= 0) continue;
+
+		sockaddr_in from;
+#ifdef WIN32
+		int fromSize = sizeof(from);
+#else
+		socklen_t fromSize = sizeof(from);
+#endif
+		int size = recvfrom(sock, bytes, sizeof(bytes), 0, (sockaddr*)&from, &fromSize);
+		if (size > 0) receive(bytes, size, from);
+	}
+}
+
+
+void QAudioBridge::receive(const char* bytes, int size, const sockaddr_in& from)
+{
+	QBridgePacketHeader hdr;
+	if (size <= (int)sizeof(hdr)) return;
+	memcpy(&hdr, bytes, sizeof(hdr));
+	if (hdr.magic[0] != 'Q' || hdr.magic[1] != 'B' || hdr.version != QBRIDGE_VERSION) return;
+	const char* payload = bytes + sizeof(hdr);
+	int payloadSize = size - sizeof(hdr);
+	unsigned origin = ntohl(hdr.originMicroseconds);
+	int level = hdr.level > QBRIDGE_LEVEL_MAX ? QBRIDGE_LEVEL_MAX : hdr.level;
+
+	scoped_lock lk(mutex);
+	++packetsIn;
+	ParticipantPtr& p = participants[ntohl(hdr.participant)];
+	if (!p) p.reset(new Participant(ntohl(hdr.participant)));
+	p->address = from;
+	p->lastHeard = qBridgeMicroseconds();
+	// Quick to rise, so that speakers are chosen promptly, and slow to fall,
+	// so that they aren't dropped between syllables.
+	p->level += (level - p->level) * (level > p->level ? 0.5f : 0.1f);
+
+	if (p->speaking) {
+		p->sink->pushEncodedSpeex((void*)payload, payloadSize, (int)origin);
+		return;
+	}
+	Packet* packet = newPacket();
+	packet->size = payloadSize;
+	packet->origin = origin;
+	memcpy(packet->bytes, payload, payloadSize);
+	p->preroll.push_back(packet);
+	if (p->preroll.size() > PREROLL_PACKETS) {
+		freePacket(p->preroll.front());
+		p->preroll.pop_front();
+	}
+}
+
+
+void QAudioBridge::tickLoop()
+{
+	boost::system_time next = boost::get_system_time();
+	usqLong lastReport = qBridgeMicroseconds();
+	while (!stopping) {
+		tick();
+
+		usqLong now = qBridgeMicroseconds();
+		if (settings.reportSeconds && now - lastReport >= (usqLong)settings.reportSeconds * 1000000) {
+			report();
+			lastReport = now;
+		}
+
+		next += boost::posix_time::milliseconds(TICK_MSECS);
+		boost::system_time current = boost::get_system_time();
+		if (next + boost::posix_time::milliseconds(TICK_MSECS) < current) {
+			// We've fallen a whole tick behind; start again from now rather than
+			// rushing to catch up.
+			scoped_lock lk(statsMutex);
+			++lateTicks;
+			next = current;
+		}
+		else boost::this_thread::sleep(next);
+	}
+}
+
+
+void QAudioBridge::tick()
+{
+	usqLong start = qBridgeMicroseconds();
+
+	// Who is to be heard, and who is to hear them.
+	std::vector<ParticipantPtr> everyone;
+	std::vector<sockaddr_in> addresses;
+	{
+		scoped_lock lk(mutex);
+		for (std::map<unsigned, ParticipantPtr>::iterator it = participants.begin(); it != participants.end(); ) {
+			Participant* p = it->second.get();
+			if (start - p->lastHeard > (usqLong)settings.timeoutSeconds * 1000000) {
+				if (p->playing) mixer->removeSource(p->sink);
+				for (size_t i = 0; i < p->preroll.size(); i++) freePacket(p->preroll[i]);
+				participants.erase(it++);
+			}
+			else it++;
+		}
+		choosePlayers(start);
+
+		players.clear();
+		everyone.reserve(participants.size());
+		addresses.reserve(participants.size());
+		for (std::map<unsigned, ParticipantPtr>::iterator it = participants.begin(); it != participants.end(); it++) {
+			everyone.push_back(it->second);
+			addresses.push_back(it->second->address);
+			if (it->second->playing) players.push_back(it->second);
+		}
+	}
+
+	// Decode the speakers (and any that are playing out).
+	workers.run(players.size(), boost::bind(&QAudioBridge::decode, this, _1));
+
+	// Everyone hears all of the players, except that players don't hear themselves.
+	int sum[FRAME_SIZE];
+	memset(sum, 0, sizeof(sum));
+	int played = 0;
+	for (size_t i = 0; i < players.size(); i++) {
+		if (!players[i]->sink->hasValidBuffer()) continue;
+		short* buf = players[i]->sink->getBuffer();
+		for (int j = 0; j < FRAME_SIZE; j++) sum[j] += buf[j];
+		++played;
+	}
+	mixer->tick();
+
+	Participant* loudest = NULL;
+	for (size_t i = 0; i < players.size(); i++) {
+		Participant* p = players[i].get();
+		if (p->playedOrigin && (!loudest || p->level > loudest->level)) loudest = p;
+	}
+	commonOrigin = loudest ? loudest->playedOrigin : 0;
+
+	int others[FRAME_SIZE];
+	for (size_t i = 0; i < players.size(); i++) {
+		Participant* p = players[i].get();
+		if (p->sink->hasValidBuffer()) {
+			short* own = p->sink->getBuffer();
+			for (int j = 0; j < FRAME_SIZE; j++) others[j] = sum[j] - own[j];
+		}
+		else memcpy(others, sum, sizeof(others));
+		QAudioSinkMixer::scaleToFit(others, p->mix);
+
+		Participant* loudestOther = NULL;
+		for (size_t k = 0; k < players.size(); k++) {
+			Participant* o = players[k].get();
+			if (o != p && o->playedOrigin && (!loudestOther || o->level > loudestOther->level)) loudestOther = o;
+		}
+		p->mixOrigin = loudestOther ? loudestOther->playedOrigin : 0;
+	}
+
+	// A job for each player's mix, and one more for the listeners' if there are any.
+	bool anyListeners = everyone.size() > players.size();
+	workers.run(players.size() + (anyListeners ? 1 : 0), boost::bind(&QAudioBridge::encode, this, _1));
+
+	for (size_t i = 0; i < everyone.size(); i++) {
+		Participant* p = everyone[i].get();
+		if (p->playing) send(p, addresses[i], p->encoded, p->encodedSize, p->mixOrigin);
+		else send(p, addresses[i], commonEncoded, commonEncodedSize, commonOrigin);
+	}
+
+	// Players who have stopped speaking drop out once they've played out.
+	{
+		scoped_lock lk(mutex);
+		for (size_t i = 0; i < players.size(); i++) {
+			Participant* p = players[i].get();
+			if (p->speaking || p->sink->hasValidBuffer()) continue;
+			p->playing = false;
+			p->sink->stopDebugRecording();
+			mixer->removeSource(p->sink);
+		}
+	}
+
+	double seconds = (qBridgeMicroseconds() - start) / 1e6;
+	scoped_lock lk(statsMutex);
+	++ticks;
+	playerTicks += players.size();
+	decodes += played;
+	encodes += players.size() + (anyListeners ? 1 : 0);
+	packetsOut += everyone.size();
+	tickSeconds += seconds;
+	if (seconds > maxTickSeconds) maxTickSeconds = seconds;
+}
+
+
+// Choose up to maxSpeakers speakers.  Speakers stay on while they're loud,
+// and for HANGOVER_TICKS after; a louder newcomer can take the place of one
+// who has fallen quiet.  Called with the mutex held.
+void QAudioBridge::choosePlayers(usqLong now)
+{
+	std::vector<Participant*> candidates;
+	std::vector<Participant*> quiet;	// speakers in their hangover
+	int speakers = 0;
+
+	for (std::map<unsigned, ParticipantPtr>::iterator it = participants.begin(); it != participants.end(); it++) {
+		Participant* p = it->second.get();
+		bool loud = p->level >= QBRIDGE_LEVEL_SPEECH && now - p->lastHeard < SILENT_MICROSECONDS;
+		if (p->speaking) {
+			if (loud) p->hangover = HANGOVER_TICKS;
+			else if (--p->hangover <= 0) {
+				p->speaking = false;
+				p->sink->resetTimestamps();
+				continue;
+			}
+			else quiet.push_back(p);
+			++speakers;
+		}
+		else if (loud) candidates.push_back(p);
+	}
+
+	std::sort(candidates.begin(), candidates.end(),
+		boost::bind(&Participant::level, _1) > boost::bind(&Participant::level, _2));
+	std::sort(quiet.begin(), quiet.end(),
+		boost::bind(&Participant::level, _1) < boost::bind(&Participant::level, _2));
+
+	size_t displaced = 0;
+	for (size_t i = 0; i < candidates.size(); i++) {
+		if (speakers >= settings.maxSpeakers) {
+			if (displaced >= quiet.size()) break;
+			Participant* q = quiet[displaced++];
+			q->speaking = false;
+			q->sink->resetTimestamps();
+		}
+		else ++speakers;
+		startPlaying(candidates[i]);
+	}
+}
+
+
+// Make a speaker of 'p', starting its sink off with what it has just sent.
+// Called with the mutex held.
+void QAudioBridge::startPlaying(Participant* p)
+{
+	p->speaking = true;
+	p->hangover = HANGOVER_TICKS;
+	if (!p->playing) {
+		p->playing = true;
+		p->playedOrigin = 0;
+		// The sink's trace tells us which packet it played, for measuring latency.
+		p->sink->startDebugRecording(NULL);
+		mixer->addSource(p->sink);
+	}
+	for (size_t i = 0; i < p->preroll.size(); i++) {
+		Packet* packet = p->preroll[i];
+		p->sink->pushEncodedSpeex(packet->bytes, packet->size, (int)packet->origin);
+		freePacket(packet);
+	}
+	p->preroll.clear();
+}
+
+
+void QAudioBridge::decode(int index)
+{
+	Participant* p = players[index].get();
+	p->sink->tick();
+
+	char payload[QJT_MAX_PAYLOAD];  // of traced puts; not needed
+	QJitterTraceRecord rec;
+	p->playedOrigin = 0;
+	while (p->sink->readDebugRecording(rec, payload)) {
+		// Only 0 and 3 take a packet from the jitter-buffer (see QJitterReplay).
+		if (rec.kind == QJT_GET && (rec.values[4] == 0 || rec.values[4] == 3))
+			p->playedOrigin = (unsigned)rec.values[3];
+	}
+}
+
+
+void QAudioBridge::encode(int index)
+{
+	if (index == (int)players.size()) {
+		int size = qSpeexEncode(commonEncoder, mixer->getBuffer(), FRAME_SIZE);
+		commonEncodedSize = size > QBRIDGE_MAX_PACKET ? QBRIDGE_MAX_PACKET : size;
+		qSpeexEncodeRead(commonEncoder, commonEncoded, commonEncodedSize);
+		return;
+	}
+	Participant* p = players[index].get();
+	int size = qSpeexEncode(p->encoder, p->mix, FRAME_SIZE);
+	p->encodedSize = size > QBRIDGE_MAX_PACKET ? QBRIDGE_MAX_PACKET : size;
+	qSpeexEncodeRead(p->encoder, p->encoded, p->encodedSize);
+}
+
+
+void QAudioBridge::send(Participant* p, const sockaddr_in& to, const char* encoded, int encodedSize, unsigned origin)
+{
+	char bytes[sizeof(QBridgePacketHeader) + QBRIDGE_MAX_PACKET];
+	QBridgePacketHeader hdr;
+	hdr.magic[0] = 'Q';
+	hdr.magic[1] = 'B';
+	hdr.version = QBRIDGE_VERSION;
+	hdr.level = 0;
+	hdr.participant = htonl(p->id);
+	hdr.sequence = htonl(p->sequence++);
+	hdr.originMicroseconds = htonl(origin);
+	memcpy(bytes, &hdr, sizeof(hdr));
+	memcpy(bytes + sizeof(hdr), encoded, encodedSize);
+	sendto(sock, bytes, sizeof(hdr) + encodedSize, 0, (sockaddr*)&to, sizeof(to));
+}
+
+
+QAudioBridge::Stats QAudioBridge::takeStats()
+{
+	Stats stats;
+	{
+		scoped_lock lk(mutex);
+		stats.participants = participants.size();
+	}
+	usqLong now = qBridgeMicroseconds();
+	double cpu = qBridgeCpuSeconds();
+
+	scoped_lock lk(statsMutex);
+	double seconds = (now - statsStart) / 1e6;
+	if (seconds <= 0) seconds = 1e-6;
+	stats.speakers = ticks ? (double)playerTicks / ticks : 0;
+	stats.decodes = ticks ? (double)decodes / ticks : 0;
+	stats.encodes = ticks ? (double)encodes / ticks : 0;
+	stats.tickMsecs = ticks ? tickSeconds * 1000 / ticks : 0;
+	stats.maxTickMsecs = maxTickSeconds * 1000;
+	stats.lateTicks = lateTicks;
+	stats.cpuPercent = 100 * (cpu - statsCpuStart) / seconds;
+	stats.packetsIn = packetsIn / seconds;
+	stats.packetsOut = packetsOut / seconds;
+
+	ticks = lateTicks = playerTicks = decodes = encodes = 0;
+	tickSeconds = maxTickSeconds = 0;
+	packetsIn = packetsOut = 0;
+	statsStart = now;
+	statsCpuStart = cpu;
+	return stats;
+}
+
+
+void QAudioBridge::report()
+{
+	Stats s = takeStats();
+	printf("%5d participants  %4.1f speakers  %4.1f decodes  %4.1f encodes  "
+		"tick %6.3f ms (max %6.3f)  %ld late  cpu %5.1f%% (%.3f%% per participant)  "
+		"%6.0f in/s  %6.0f out/s\n",
+		s.participants, s.speakers, s.decodes, s.encodes,
+		s.tickMsecs, s.maxTickMsecs, s.lateTicks,
+		s.cpuPercent, s.participants ? s.cpuPercent / s.participants : 0.0,
+		s.packetsIn, s.packetsOut);
+	fflush(stdout);
+}
+
+
+// Packets are only ever taken and given back with the mutex held.
+QAudioBridge::Packet* QAudioBridge::newPacket()
+{
+	if (freePackets.empty()) return new Packet;
+	Packet* packet = freePackets.back();
+	freePackets.pop_back();
+	return packet;
+}
+
+
+void QAudioBridge::freePacket(Packet* packet)
+{
+	freePackets.push_back(packet);
+}
@@ -0,0 +1,223 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qAudioBridge.hpp
+ *  QAudioBridge
+ *
+ *  A conference bridge: participants send it a Speex packet every 20ms over
+ *  UDP, and it sends each of them back the mix of everyone else.
+ *
+ *  Each participant has a QAudioSinkSpeex, for its jitter-buffer and decoder.
+ *  Only the loudest few participants (the speakers) are decoded.  Each packet
+ *  carries the sender's own measure of how loud it is, so speakers are chosen
+ *  without decoding anyone; a speaker stays one for a while after falling
+ *  quiet, and its sink plays out what it has buffered when it stops being one.
+ *  Everyone else's packets are only kept for long enough to fill the sink's
+ *  margin straight away if they start to speak.
+ *
+ *  Every tick, the speakers' sinks are ticked in parallel on a pool of worker
+ *  threads.  Someone who is not speaking hears all of the speakers, so they all
+ *  share one mix, made by a QAudioSinkMixer and encoded once.  Each speaker
+ *  hears the others, which is the same sum less their own frame; those mixes
+ *  are encoded in parallel, each with the speaker's own encoder.  So the work
+ *  done each tick grows with the number of speakers, not of participants.
+ *
+ *  A listener who becomes a speaker, or stops being one, switches from one
+ *  encoder's stream to another's; Speex decoders get over that within a frame
+ *  or two.
+ */
+
+#ifndef __Q_AUDIO_BRIDGE_HPP__
+#define __Q_AUDIO_BRIDGE_HPP__
+
+#include "qAudioSinkSpeex.hpp"
+#include "qAudioSinkMixer.hpp"
+#include "qAudioSpeex.h"
+#include "qWorkerPool.hpp"
+
+#include <boost/thread/thread.hpp>
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#ifdef WIN32
+#include <winsock2.h>
+typedef SOCKET QSocket;
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+typedef int QSocket;
+#endif
+
+namespace Qwaq
+{
+
+// Every packet, in either direction, starts with this header, in network
+// byte order, and is followed by one encoded Speex frame.
+#pragma pack(push, 1)
+struct QBridgePacketHeader
+{
+	char magic[2];					// "QB"
+	unsigned char version;
+	unsigned char level;			// to the bridge: how loud the frame is (see QBRIDGE_LEVEL_*)
+	unsigned int participant;		// to the bridge: the sender; from it: the recipient
+	unsigned int sequence;			// counts the packets of each participant's stream
+	unsigned int originMicroseconds;// to the bridge: when the packet was sent (the low 32 bits);
+									// from it: the same, for the loudest speech in the mix, or 0
+};
+#pragma pack(pop)
+
+const int QBRIDGE_VERSION = 1;
+const int QBRIDGE_MAX_PACKET = 2048;
+
+// Levels are in dB above an RMS of one, as for QSpeexSetVADLevel: silence is
+// 0, a full-scale sine wave 87 and a full-scale square wave, the loudest a
+// 16-bit frame can be, 90.  Below QBRIDGE_LEVEL_SPEECH isn't speech.
+const int QBRIDGE_LEVEL_MAX = 90;
+const int QBRIDGE_LEVEL_SPEECH = 40;
+
+// Answer the level of a frame of samples.
+int qBridgeLevel(const short* samples, int count);
+
+// Microseconds since 1970 (UTC), as interpreterProxy->utcMicroseconds() answers.
+usqLong qBridgeMicroseconds();
+
+// Process CPU time (user and system) in seconds.
+double qBridgeCpuSeconds();
+
+
+struct QBridgeSettings
+{
+	int port;
+	int maxSpeakers;
+	int threads;					// workers, including the tick thread
+	int reportSeconds;				// between reports on stdout; 0 for none
+	int timeoutSeconds;				// a participant is forgotten this long after its last packet
+};
+
+
+class QAudioBridge
+{
+	public:
+		QAudioBridge(const QBridgeSettings& settings);
+		~QAudioBridge();
+
+		// Open the socket and start ticking.  Answer false if the port can't be had.
+		bool start();
+		void stop();
+
+		// Figures since the last call, as printed by the reports.
+		struct Stats
+		{
+			int participants;
+			double speakers;			// per tick, including those playing out
+			double decodes;				// per tick
+			double encodes;				// per tick
+			double tickMsecs;			// mean time to do a tick's work
+			double maxTickMsecs;
+			long lateTicks;				// started a whole tick late
+			double cpuPercent;			// of one core, for the whole process
+			double packetsIn;			// per second
+			double packetsOut;			// per second
+		};
+		Stats takeStats();
+
+	protected:
+		struct Packet
+		{
+			int size;
+			unsigned origin;
+			char bytes[QBRIDGE_MAX_PACKET];
+		};
+
+		struct Participant
+		{
+			Participant(unsigned id);
+			~Participant();
+
+			unsigned id;
+			sockaddr_in address;			// where its packets last came from
+			usqLong lastHeard;
+			float level;					// smoothed from its packets' levels
+			bool speaking;					// chosen as a speaker
+			bool playing;					// its sink is ticked: speaking, or playing out
+			int hangover;					// ticks left as a speaker once quiet
+			std::deque<Packet*> preroll;	// latest packets while not speaking
+
+			boost::shared_ptr<QAudioSinkSpeex> sink;
+			unsigned sinkKey;
+			QSpeexCodecPtr encoder;			// for the mix it hears while playing
+			unsigned sequence;				// of packets sent to it
+
+			// Filled in during a tick, while playing.
+			unsigned playedOrigin;			// origin of the packet it played, or 0
+			short mix[FRAME_SIZE];
+			char encoded[QBRIDGE_MAX_PACKET];
+			int encodedSize;
+			unsigned mixOrigin;
+		};
+		typedef boost::shared_ptr<Participant> ParticipantPtr;
+
+		QBridgeSettings settings;
+		QSocket sock;
+		boost::thread* receiver;
+		boost::thread* ticker;
+		volatile bool stopping;
+		QWorkerPool workers;
+
+		// Guards the participants and what the receiver changes in them.
+		boost::mutex mutex;
+		std::map<unsigned, ParticipantPtr> participants;
+		std::vector<Packet*> freePackets;
+
+		// Used only by the ticker.
+		std::vector<ParticipantPtr> players;
+		boost::shared_ptr<QAudioSinkMixer> mixer;
+		unsigned mixerKey;
+		QSpeexCodecPtr commonEncoder;
+		char commonEncoded[QBRIDGE_MAX_PACKET];
+		int commonEncodedSize;
+		unsigned commonOrigin;
+
+		// Figures for takeStats().
+		boost::mutex statsMutex;
+		long ticks, lateTicks, playerTicks, decodes, encodes;
+		double tickSeconds, maxTickSeconds;
+		long packetsIn, packetsOut;
+		usqLong statsStart;
+		double statsCpuStart;
+
+		void receiveLoop();
+		void receive(const char* bytes, int size, const sockaddr_in& from);
+		void tickLoop();
+		void tick();
+		void choosePlayers(usqLong now);
+		void startPlaying(Participant* p);
+		void decode(int index);
+		void encode(int index);
+		void send(Participant* p, const sockaddr_in& to, const char* encoded, int encodedSize, unsigned origin);
+		void report();
+
+		Packet* newPacket();
+		void freePacket(Packet* packet);
+};
+
+}; // namespace Qwaq
+
+#endif // #ifndef __Q_AUDIO_BRIDGE_HPP__
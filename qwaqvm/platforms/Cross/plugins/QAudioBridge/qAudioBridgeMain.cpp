@@ -0,0 +1,444 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qAudioBridgeMain.cpp
+ *  QAudioBridge
+ *
+ *  Headless conference bridge (see qAudioBridge.hpp), and a load generator
+ *  to try it out with:
+ *
+ *      qAudioBridge [-port n] [-speakers n] [-threads n] [-report seconds] [-seconds n]
+ *      qAudioBridge -load participants [-host address] [-port n] [-talkers n] [-seconds n]
+ *
+ *  The bridge reports, every few seconds, the time taken by its ticks and the
+ *  CPU that it uses, in all and per participant.  The load generator plays
+ *  synthetic participants, who take turns to talk so that about -talkers of
+ *  them talk at once.  Their speech is encoded before they start, so that
+ *  the load generator takes little CPU itself, and all of them share one
+ *  socket.  When it finishes, it reports how long it took for what the
+ *  participants said to come back to the others in their mixes: from when a
+ *  packet was sent to when the first mix with it was received, which is
+ *  everything but the listener's own jitter-buffer.  To load-test a bridge
+ *  locally, run the two in separate processes:
+ *
+ *      qAudioBridge -seconds 70 &
+ *      qAudioBridge -load 200 -seconds 60
+ *
+ *  It is built from the plugin's own sources rather than as part of it, e.g.
+ *  on unix:
+ *
+ *      g++ -O2 -DEXCLUDE_IAX=1 -DEXCLUDE_PORTAUDIO=1 -I../QAudioPlugin -I../QwaqLib
+ *          -I../../vm -I../../../unix/vm -I../../third-party -I../../third-party/speexclient
+ *          -I../../../unix/third-party/openal-soft-1.10.622/include
+ *          qAudioBridgeMain.cpp qAudioBridge.cpp ../QAudioPlugin/qAudioSinkSpeex.cpp
+ *          ../QAudioPlugin/qAudioSinkMixer.cpp ../QAudioPlugin/qJitterTrace.cpp
+ *          ../QAudioPlugin/qTickee.cpp ../QwaqLib/qEventTimeLogger.cpp ../QwaqLib/qLogger.cpp
+ *          ../QwaqLib/qTrace.cpp ../QwaqLib/qWorkerPool.cpp
+ *          -x c ../QAudioPlugin/qAudioSpeex.c ../../third-party/speexclient/speex_jitter_buffer.c
+ *          -lspeex -lspeexdsp -lboost_thread -lboost_date_time -lpthread -o qAudioBridge
+ */
+
+#include "qAudioBridge.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+
+#ifdef WIN32
+#define closesocket_(s) closesocket(s)
+#else
+#include <netdb.h>
+#include <unistd.h>
+#define closesocket_(s) close(s)
+#define INVALID_SOCKET (-1)
+#endif
+
+using namespace Qwaq;
+
+// The sinks stamp what they do with the VM's clock, which is the real one
+// here.  Logging is left uninitialized, and so silent.
+static usqLong getBridgeMicroseconds() { return qBridgeMicroseconds(); }
+static struct VirtualMachine bridgeVM;
+extern "C" { struct VirtualMachine* interpreterProxy = &bridgeVM; }
+
+const int DEFAULT_PORT = 5004;
+const int TICK_MSECS = 20;
+const int TICKS_PER_SECOND = 1000 / TICK_MSECS;
+const int SAMPLING_RATE = 16000;
+
+const int VOICES = 8;
+const int VOICE_TICKS = 4 * TICKS_PER_SECOND;	// of speech, played round and round
+const int TALK_TICKS = 2 * TICKS_PER_SECOND;	// mean length of a turn
+
+
+// One encoded frame, as a synthetic participant sends it.
+struct Frame
+{
+	std::string bytes;
+	int level;
+};
+typedef std::vector<Frame> Recording;
+
+
+// Something like voiced speech: a buzz at a wandering pitch, shaped into
+// syllables about four times a second.
+static void synthesize(int voice, std::vector<short>& samples)
+{
+	double pitch = 100 + 15 * voice;
+	double phase = 0;
+	samples.resize(VOICE_TICKS * FRAME_SIZE);
+	for (size_t i = 0; i < samples.size(); i++) {
+		double t = (double)i / SAMPLING_RATE;
+		double f0 = pitch * (1 + 0.1 * sin(2 * M_PI * 0.7 * t + voice));
+		phase += 2 * M_PI * f0 / SAMPLING_RATE;
+		double buzz = 0;
+		for (int h = 1; h <= 12; h++) buzz += sin(h * phase) / h;
+		double syllable = sin(M_PI * fmod(t * (3.5 + 0.25 * voice), 1.0));
+		double noise = (rand() / (double)RAND_MAX - 0.5) * 0.05;
+		samples[i] = (short)(6000 * (buzz * syllable * syllable + noise));
+	}
+}
+
+
+// Quiet background noise, for participants who aren't talking.
+static void background(std::vector<short>& samples)
+{
+	samples.resize(TICKS_PER_SECOND * FRAME_SIZE);
+	for (size_t i = 0; i < samples.size(); i++)
+		samples[i] = (short)((rand() % 61) - 30);
+}
+
+
+static void encode(const std::vector<short>& samples, Recording& recording)
+{
+	QSpeexCodecPtr codec = qSpeexCreateHandle();
+	for (size_t offset = 0; offset + FRAME_SIZE <= samples.size(); offset += FRAME_SIZE) {
+		Frame frame;
+		short* frameSamples = const_cast<short*>(&samples[offset]);
+		int size = qSpeexEncode(codec, frameSamples, FRAME_SIZE);
+		frame.bytes.resize(size);
+		qSpeexEncodeRead(codec, &frame.bytes[0], size);
+		frame.level = qBridgeLevel(frameSamples, FRAME_SIZE);
+		recording.push_back(frame);
+	}
+	qSpeexDestroyHandle(codec);
+}
+
+
+struct SyntheticParticipant
+{
+	unsigned id;
+	int voice;
+	bool talking;
+	int ticksLeft;			// in this turn, or until the next
+	unsigned position;		// in the recording being played
+	unsigned sequence;
+	unsigned received;
+};
+
+
+class LoadGenerator
+{
+	public:
+		LoadGenerator(int participantCount, int talkers);
+		~LoadGenerator();
+
+		bool open(const char* host, int port);
+		void run(int seconds);
+		void report();
+
+	protected:
+		std::vector<SyntheticParticipant> participants;
+		int participantCount;
+		int talkers;
+		std::vector<Recording> voices;
+		Recording quiet;
+
+		QSocket sock;
+		sockaddr_in bridge;
+		volatile bool stopping;
+
+		unsigned sent;
+		unsigned received;
+		std::vector<unsigned> latencies;	// microseconds
+		QSpeexCodecPtr listener;			// decodes what participant 1 hears
+		unsigned heardSpeech;
+
+		int turnLength(bool talking);
+		void sendLoop();
+		void receiveLoop();
+};
+
+
+LoadGenerator::LoadGenerator(int count, int talkerCount)
+{
+	participantCount = count;
+	talkers = talkerCount < count ? talkerCount : count;
+	sock = INVALID_SOCKET;
+	stopping = false;
+	sent = received = heardSpeech = 0;
+	listener = qSpeexCreateHandle();
+
+	voices.resize(VOICES);
+	for (int v = 0; v < VOICES; v++) {
+		std::vector<short> samples;
+		synthesize(v, samples);
+		encode(samples, voices[v]);
+	}
+	std::vector<short> samples;
+	background(samples);
+	encode(samples, quiet);
+
+	for (int i = 0; i < count; i++) {
+		SyntheticParticipant p;
+		p.id = i + 1;
+		p.voice = i % VOICES;
+		p.talking = i < talkers;
+		p.ticksLeft = rand() % turnLength(p.talking) + 1;
+		p.position = rand();
+		p.sequence = p.received = 0;
+		participants.push_back(p);
+	}
+}
+
+
+LoadGenerator::~LoadGenerator()
+{
+	if (sock != INVALID_SOCKET) closesocket_(sock);
+	qSpeexDestroyHandle(listener);
+}
+
+
+bool LoadGenerator::open(const char* host, int port)
+{
+	memset(&bridge, 0, sizeof(bridge));
+	bridge.sin_family = AF_INET;
+	bridge.sin_port = htons(port);
+	hostent* entry = gethostbyname(host);
+	if (!entry || entry->h_addrtype != AF_INET) return false;
+	memcpy(&bridge.sin_addr, entry->h_addr_list[0], sizeof(bridge.sin_addr));
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+	if (sock == INVALID_SOCKET) return false;
+	int bufferSize = 4 * 1024 * 1024;
+	setsockopt(sock, SOL_SOCKET, SO_SNDBUF, (char*)&bufferSize, sizeof(bufferSize));
+	setsockopt(sock, SOL_SOCKET, SO_RCVBUF, (char*)&bufferSize, sizeof(bufferSize));
+	return true;
+}
+
+
+// Draw the length of a turn of talking, or of keeping quiet, so that on
+// average 'talkers' participants are talking at once.
+int LoadGenerator::turnLength(bool talking)
+{
+	double mean = TALK_TICKS;
+	if (!talking) mean = talkers ? (double)TALK_TICKS * (participantCount - talkers) / talkers : 1e9;
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return 1 + (int)(-mean * log(u));
+}
+
+
+void LoadGenerator::run(int seconds)
+{
+	boost::thread receiver(boost::bind(&LoadGenerator::receiveLoop, this));
+	boost::thread sender(boost::bind(&LoadGenerator::sendLoop, this));
+	boost::this_thread::sleep(boost::posix_time::seconds(seconds));
+	stopping = true;
+	sender.join();
+	// Give the last mixes time to come back.
+	boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+	receiver.join();
+}
+
+
+void LoadGenerator::sendLoop()
+{
+	char bytes[sizeof(QBridgePacketHeader) + QBRIDGE_MAX_PACKET];
+	boost::system_time next = boost::get_system_time();
+	while (!stopping) {
+		for (size_t i = 0; i < participants.size(); i++) {
+			SyntheticParticipant& p = participants[i];
+			if (--p.ticksLeft <= 0) {
+				p.talking = !p.talking;
+				p.ticksLeft = turnLength(p.talking);
+			}
+			const Recording& recording = p.talking ? voices[p.voice] : quiet;
+			const Frame& frame = recording[p.position++ % recording.size()];
+
+			QBridgePacketHeader hdr;
+			hdr.magic[0] = 'Q';
+			hdr.magic[1] = 'B';
+			hdr.version = QBRIDGE_VERSION;
+			hdr.level = frame.level;
+			hdr.participant = htonl(p.id);
+			hdr.sequence = htonl(p.sequence++);
+			hdr.originMicroseconds = htonl((unsigned)qBridgeMicroseconds());
+			memcpy(bytes, &hdr, sizeof(hdr));
+			memcpy(bytes + sizeof(hdr), frame.bytes.data(), frame.bytes.size());
+			if (sendto(sock, bytes, sizeof(hdr) + frame.bytes.size(), 0, (sockaddr*)&bridge, sizeof(bridge)) > 0)
+				++sent;
+		}
+		next += boost::posix_time::milliseconds(TICK_MSECS);
+		boost::this_thread::sleep(next);
+	}
+}
+
+
+void LoadGenerator::receiveLoop()
+{
+	char bytes[sizeof(QBridgePacketHeader) + QBRIDGE_MAX_PACKET];
+	short samples[FRAME_SIZE];
+	while (!stopping) {
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(sock, &readable);
+		timeval timeout = { 0, 100000 };
+		if (select((int)sock + 1, &readable, NULL, NULL, &timeout) <= 0) continue;
+		int size = recv(sock, bytes, sizeof(bytes), 0);
+		unsigned now = (unsigned)qBridgeMicroseconds();
+
+		QBridgePacketHeader hdr;
+		if (size <= (int)sizeof(hdr)) continue;
+		memcpy(&hdr, bytes, sizeof(hdr));
+		unsigned id = ntohl(hdr.participant);
+		if (id < 1 || id > participants.size()) continue;
+		++received;
+		++participants[id - 1].received;
+
+		unsigned origin = ntohl(hdr.originMicroseconds);
+		if (origin) latencies.push_back(now - origin);
+
+		// Listen in on one participant, to check that there's something to hear.
+		if (id == 1) {
+			qSpeexDecode(listener, bytes + sizeof(hdr), size - sizeof(hdr), samples, FRAME_SIZE);
+			if (qBridgeLevel(samples, FRAME_SIZE) >= QBRIDGE_LEVEL_SPEECH) ++heardSpeech;
+		}
+	}
+}
+
+
+void LoadGenerator::report()
+{
+	unsigned least = participants.empty() ? 0 : participants[0].received;
+	for (size_t i = 0; i < participants.size(); i++)
+		least = std::min(least, participants[i].received);
+
+	printf("%u packets sent, %u received (%.1f%%); the least any participant received was %u\n",
+		sent, received, sent ? (100.0 * received) / sent : 0.0, least);
+	if (!participants.empty())
+		printf("participant 1 heard speech in %.1f%% of %u frames\n",
+			participants[0].received ? (100.0 * heardSpeech) / participants[0].received : 0.0,
+			participants[0].received);
+
+	if (latencies.empty()) {
+		printf("no speech came back, so there is no latency to report\n");
+		return;
+	}
+	std::sort(latencies.begin(), latencies.end());
+	double mean = 0;
+	for (size_t i = 0; i < latencies.size(); i++) mean += latencies[i];
+	mean /= latencies.size();
+	printf("latency from sending to receiving the mix (ms), over %u packets:\n"
+		"  mean %.1f  p50 %.1f  p95 %.1f  p99 %.1f  max %.1f\n",
+		(unsigned)latencies.size(), mean / 1000,
+		latencies[latencies.size() / 2] / 1000.0,
+		latencies[(latencies.size() * 95) / 100] / 1000.0,
+		latencies[(latencies.size() * 99) / 100] / 1000.0,
+		latencies.back() / 1000.0);
+}
+
+
+static int usage(const char* program)
+{
+	fprintf(stderr, "usage: %s [-port n] [-speakers n] [-threads n] [-report seconds] [-seconds n]\n", program);
+	fprintf(stderr, "       %s -load participants [-host address] [-port n] [-talkers n] [-seconds n]\n", program);
+	return 2;
+}
+
+
+static bool parseInt(const char* arg, int* value)
+{
+	char* end;
+	long v = strtol(arg, &end, 10);
+	if (end == arg || *end || v < 0) return false;
+	*value = (int)v;
+	return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+	QBridgeSettings settings;
+	settings.port = DEFAULT_PORT;
+	settings.maxSpeakers = 3;
+	settings.threads = boost::thread::hardware_concurrency();
+	if (settings.threads < 1) settings.threads = 1;
+	settings.reportSeconds = 5;
+	settings.timeoutSeconds = 10;
+	int load = 0, talkers = 3, seconds = 0;
+	const char* host = "127.0.0.1";
+
+	for (int i = 1; i < argc; i++) {
+		bool ok = i + 1 < argc;
+		if (!strcmp(argv[i], "-port")) ok = ok && parseInt(argv[++i], &settings.port);
+		else if (!strcmp(argv[i], "-speakers")) ok = ok && parseInt(argv[++i], &settings.maxSpeakers);
+		else if (!strcmp(argv[i], "-threads")) ok = ok && parseInt(argv[++i], &settings.threads) && settings.threads > 0;
+		else if (!strcmp(argv[i], "-report")) ok = ok && parseInt(argv[++i], &settings.reportSeconds);
+		else if (!strcmp(argv[i], "-seconds")) ok = ok && parseInt(argv[++i], &seconds);
+		else if (!strcmp(argv[i], "-load")) ok = ok && parseInt(argv[++i], &load) && load > 0;
+		else if (!strcmp(argv[i], "-talkers")) ok = ok && parseInt(argv[++i], &talkers);
+		else if (!strcmp(argv[i], "-host")) host = ok ? argv[++i] : NULL;
+		else ok = false;
+		if (!ok) return usage(argv[0]);
+	}
+
+#ifdef WIN32
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+	bridgeVM.utcMicroseconds = getBridgeMicroseconds;
+
+	if (load) {
+		LoadGenerator generator(load, talkers);
+		if (!generator.open(host, settings.port)) {
+			fprintf(stderr, "%s: can't send to %s:%d\n", argv[0], host, settings.port);
+			return 1;
+		}
+		printf("%d participants, about %d talking at once, for %d seconds\n", load, talkers, seconds ? seconds : 10);
+		fflush(stdout);
+		generator.run(seconds ? seconds : 10);
+		generator.report();
+		return 0;
+	}
+
+	QAudioBridge bridge(settings);
+	if (!bridge.start()) {
+		fprintf(stderr, "%s: can't listen on port %d\n", argv[0], settings.port);
+		return 1;
+	}
+	printf("bridging on port %d with up to %d speakers and %d threads\n",
+		settings.port, settings.maxSpeakers, settings.threads);
+	fflush(stdout);
+	if (seconds) boost::this_thread::sleep(boost::posix_time::seconds(seconds));
+	else for (;;) boost::this_thread::sleep(boost::posix_time::hours(1));
+	bridge.stop();
+	return 0;
+}
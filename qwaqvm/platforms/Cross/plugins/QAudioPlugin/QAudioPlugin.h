@@ -27,6 +27,7 @@
 #include "qAudioSpeex.h"
 #include "qAudioOpenAL.h"
 #include "qLogger.h"
+#include "qTrace.h"
 
 #include "qFeedbackChannel-interface.h"
 
@@ -63,6 +64,45 @@ typedef enum {
 	QPrimitiveResultBadSamplingRate = 20
 } QPrimitiveResultCode;
 
+/* qSinkControl() types that every sink answers: the time that the ticker
+ * has taken to tick it, to see which are expensive. */
+typedef enum {
+	QTickeeGetTickCount = 901,			/* ticks timed since the last reset */
+	QTickeeGetMeanTickMicroseconds,
+	QTickeeGetMaxTickMicroseconds,
+	QTickeeResetTickTimes
+} QTickeeControl;
+
+/* qSinkControl() types for QAudioSinkBufferedResampler.  Sets answer 0, or -1
+ * for a bad value; gets answer the value. */
+typedef enum {
+	QResamplerSetInputChannels = 1001,	/* 1 to 8 interleaved channels pushed; downmixed to mono */
+	QResamplerGetInputChannels,
+	QResamplerSetQuality,				/* 0 (cheapest) to 10 (best, longest filter) */
+	QResamplerGetQuality,
+	QResamplerGetLatency				/* filter delay, in 16kHz samples */
+} QResamplerControl;
+
+/* qSinkControl() types for QAudioSinkOpenAL.  Depths are in 20ms frames
+ * queued to OpenAL, from 1 to 14; latencies are in msecs.  Sets answer 0,
+ * or -1 for a bad value; gets answer the value. */
+typedef enum {
+	QOpenALSetAdaptive = 1101,			/* 0 to keep the depth at the minimum, unstretched */
+	QOpenALGetAdaptive,
+	QOpenALSetMinDepth,
+	QOpenALGetMinDepth,
+	QOpenALSetMaxDepth,
+	QOpenALGetMaxDepth,
+	QOpenALGetDepth,					/* the depth being aimed for */
+	QOpenALGetLatency,					/* queued ahead of the device as of the last tick */
+	QOpenALGetMeanLatency,				/* since the statistics were reset */
+	QOpenALGetUnderruns,				/* the source ran dry while there was audio to play */
+	QOpenALGetOverruns,					/* frames dropped for want of a free buffer */
+	QOpenALGetStretchedFrames,
+	QOpenALGetSqueezedFrames,
+	QOpenALResetStats
+} QOpenALControl;
+
 /* Some declarations from "iaxclient.h" (otherwise will have conflicts). */
 int iaxc_call(const char * num); 
 long iaxc_write_output_buffer(int index, void * data, long len);
@@ -107,6 +147,9 @@ void qTickerSetInterval(unsigned milliseconds);
 void qTickerStart();
 void qTickerStop();
 void qTickerTickNow();
+/* Threads, including the ticker's own, to tick sinks that may be ticked
+ * in parallel, such as the Speex sinks; 1 ticks everything in turn. */
+void qTickerSetWorkerThreads(unsigned threadCount);
 
 /* QAudioSink - creation and destruction */
 unsigned qCreateSinkOpenAL(void);
@@ -147,6 +190,11 @@ int qSinkSpeexGetJitterbufferStats(unsigned handle, QJitterbufferStats* stats);
 
 /* QAudioSinkBufferedResampler */
 QPrimitiveResultCode qSinkPushRawAudio(unsigned handle, short *bufferPtr, int sampleCount);
+/* Push audio for 'streamCount' sinks at once: sink i takes the next
+ * sampleCounts[i] samples of 'samples'.  If the counts don't fit in
+ * 'totalSamples', nothing is pushed; otherwise answers the first error, if
+ * any, having pushed to all the sinks that it could. */
+QPrimitiveResultCode qSinkPushRawAudioBatch(unsigned *handles, int *sampleCounts, int streamCount, short *samples, int totalSamples);
 QPrimitiveResultCode qSinkSetInputSamplingRate(unsigned handle, unsigned rate);
 QPrimitiveResultCode qSinkSetOutputSamplingRate(unsigned handle, unsigned rate);
 QPrimitiveResultCode qSinkSetBufferedFrameCount(unsigned handle, unsigned frameCount);
@@ -28,28 +28,33 @@
 #endif
 
 #include "qLogger.hpp"
+#include "qTrace.hpp"
 
 using namespace Qwaq;
 
-boost::mutex AudioDecoder::s_Mutex;
-unsigned AudioDecoder::s_Key = 0;
-AudioDecoder::map_type AudioDecoder::s_Map;
+AudioDecoder::table_type AudioDecoder::s_Table;
 
 unsigned qCreateAudioDecoder(unsigned codecType, unsigned char* config, unsigned configSize)
 {
 	AudioDecoder *decoder;
-	switch (codecType) {
-		case CodecTypeAAC:
+	try {
+		switch (codecType) {
+			case CodecTypeAAC:
 #ifdef _MAINCONCEPT_		
-			decoder = new AudioDecoderAAC(config, configSize);
+				decoder = new AudioDecoderAAC(config, configSize);
 #else
-			decoder = new AudioDecoderAAC_libav(config, configSize);
+				decoder = new AudioDecoderAAC_libav(config, configSize);
 #endif
-			break;
-		default:
-			qLog() << "qCreateAudioDecoder(): unexpected decoder type: " << codecType << flush;
-			return 0;
-	};
+				break;
+			default:
+				qLog() << "qCreateAudioDecoder(): unexpected decoder type: " << codecType << flush;
+				return 0;
+		};
+	}
+	catch (AudioDecoder::TableFull) {
+		qLog() << "qCreateAudioDecoder(): no free decoder keys" << flush;
+		return 0;
+	}
 	return decoder->key();
 }
 
@@ -60,11 +65,13 @@ void qDestroyAudioDecoder(unsigned handle)
 
 int qAudioDecode(unsigned handle, unsigned char* input, int inSize, short* output, int outSize, unsigned flags)
 {
+	QTRACE_SCOPE(QTracePrimitives, "qAudioDecode");
 	shared_ptr<AudioDecoder> decoder = AudioDecoder::withKey(handle);
 	if (!decoder.get()) {
 		qLog() << "qAudioDecode(): can't get audio-decoder with key: " << handle << flush;
 		return -1;
 	}
+	QTRACE_SCOPE(QTraceCodecs, "aac decode");
 	return decoder->decode(input, inSize, output, outSize, flags);
 }
 
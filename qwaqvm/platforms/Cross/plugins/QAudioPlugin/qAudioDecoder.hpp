@@ -27,6 +27,7 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
+#include "qHandleTable.hpp"
 using boost::shared_ptr;
 typedef boost::mutex::scoped_lock scoped_lock;
 
@@ -34,12 +34,11 @@
 #endif // _MAINCONCEPT_
 
 #include "qLogger.hpp"
+#include "qTrace.hpp"
 
 using namespace Qwaq;
 
-boost::mutex AudioEncoder::s_Mutex;
-unsigned AudioEncoder::s_Key = 0;
-AudioEncoder::map_type AudioEncoder::s_Map;
+AudioEncoder::table_type AudioEncoder::s_Table;
 
 // Also see Squeak class QEncodedAudioSegmentFeedback
 struct QEncodedAudioSegment
@@ -57,6 +56,9 @@ class QEncodedAudioSegmentFeedback : public FeedbackEvent
 		
 		QEncodedAudioSegment squeakEvent;
 };
+
+// Each stream pushes a segment every 20ms, so recycle them.
+static FeedbackEventPool<QEncodedAudioSegmentFeedback> segmentPool;
 		
 
 void AudioEncoder::pushFeedbackData(void* data, unsigned dataSize)
@@ -69,11 +71,7 @@ void AudioEncoder::pushFeedbackData(void* data, unsigned dataSize)
 		qLog() << "Exceeded maximum encoded audio segment size of " << MAX_ENCODED_SEGMENT_SIZE << " bytes";
 		return;
 	}
-	QEncodedAudioSegmentFeedback *evt = new QEncodedAudioSegmentFeedback;
-	if (!evt) {
-		qLog() << "Failed to allocate QEncodedAudioSegmentFeedback" << flush;
-		return;
-	}
+	boost::shared_ptr<QEncodedAudioSegmentFeedback> evt = segmentPool.acquire();
 	evt->squeakEvent.dataSize = dataSize;
 	memcpy(evt->squeakEvent.data, data, dataSize);
 	FeedbackEventPtr p(evt);
@@ -88,23 +86,29 @@ unsigned qCreateAudioEncoder(unsigned codecType, void* feedbackChannel, unsigned
 	FeedbackChannel *channel = NULL;
 	if (feedbackChannel) channel = *((FeedbackChannel**)feedbackChannel);
 	
-	switch (codecType) {
-		case CodecTypeAAC:
+	try {
+		switch (codecType) {
+			case CodecTypeAAC:
 #ifdef _MAINCONCEPT_		
-			encoder = new AudioEncoderAAC(channel, config, configSize);
+				encoder = new AudioEncoderAAC(channel, config, configSize);
 #else			
 #if defined __APPLE__
-			encoder = new AudioEncoderAAC_apple(channel, config, configSize);
+				encoder = new AudioEncoderAAC_apple(channel, config, configSize);
 #else
-			encoder = new AudioEncoderAAC_libav(channel, config, configSize);
+				encoder = new AudioEncoderAAC_libav(channel, config, configSize);
 #endif
 #endif
-			break;
+				break;
 
-		default:
-			qLog() << "qCreateAudioEncoder(): unexpected encoder type: " << codecType << flush;
-			return 0;
-	};
+			default:
+				qLog() << "qCreateAudioEncoder(): unexpected encoder type: " << codecType << flush;
+				return 0;
+		};
+	}
+	catch (AudioEncoder::TableFull) {
+		qLog() << "qCreateAudioEncoder(): no free encoder keys" << flush;
+		return 0;
+	}
 	return encoder->key();
 }
 
@@ -117,11 +121,13 @@ void qDestroyAudioEncoder(unsigned handle)
 
 int qAudioAsyncEncode(unsigned handle, short *bufferPtr, int sampleCount)
 {
+	QTRACE_SCOPE(QTracePrimitives, "qAudioAsyncEncode");
 	shared_ptr<AudioEncoder> encoder = AudioEncoder::withKey(handle);
 	if (!encoder.get()) {
 		qLog() << "qAudioAsyncEncode(): can't get audio-encoder with key: " << handle << flush;
 		return -1;
 	}
+	QTRACE_SCOPE(QTraceCodecs, "aac encode");
 	return encoder->asyncEncode(bufferPtr, sampleCount);
 }
 
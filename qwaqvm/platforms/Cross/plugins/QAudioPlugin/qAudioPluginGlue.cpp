@@ -22,6 +22,7 @@
 #include "QAudioPlugin.h"
 #include "qTicker.hpp"
 #include "qLogger.hpp"
+#include "qTrace.hpp"
 #include "qAudioSinkSpeex.hpp"
 #include "qAudioSinkOpenAL.hpp"
 #if __APPLE__ && __MACH__
@@ -71,14 +72,28 @@ void qTickerStop()
 
 void qTickerTickNow()
 {
+	QTRACE_SCOPE(QTracePrimitives, "qTickerTickNow");
 	g_Ticker.tick();
 }
 
 
+void qTickerSetWorkerThreads(unsigned threadCount)
+{
+	g_Ticker.setWorkerThreads(threadCount);
+}
+
+
 template<class Sink> 
 unsigned qCreateSink(void)
 {
-	Sink *sink = new Sink();
+	Sink *sink;
+	try {
+		sink = new Sink();
+	}
+	catch (typename Sink::TableFull) {
+		qLog() << "qCreateSink(): no free sink keys" << flush;
+		return 0;
+	}
 	if (!sink) {
 		qLog() << "qCreateSink(): failed to instantiate new sink" << flush;
 		return 0;
@@ -90,7 +105,14 @@ unsigned qCreateSink(void)
 
 unsigned qCreateSinkForDebugFeedback(void* feedbackChannel)
 {
-	QAudioSinkForDebugFeedback *sink = new QAudioSinkForDebugFeedback(*((FeedbackChannel**)feedbackChannel));
+	QAudioSinkForDebugFeedback *sink;
+	try {
+		sink = new QAudioSinkForDebugFeedback(*((FeedbackChannel**)feedbackChannel));
+	}
+	catch (Tickee::TableFull) {
+		qLog() << "qCreateSinkForDebugFeedback(): no free sink keys" << flush;
+		return 0;
+	}
 	if (!sink) return 0;
 	g_Ticker.addTickee(sink->ptr());
 	return sink->key();
@@ -265,6 +287,7 @@ QPrimitiveResultCode qSinkPlayDebugAudioDirectlyViaOpenAL(unsigned handle, void*
 // For Speex sinks.
 void qSinkPushEncodedSpeex(unsigned handle, void* bytes, int byteSize, int timestamp)
 {
+	QTRACE_SCOPE(QTracePrimitives, "qSinkPushEncodedSpeex");
 	shared_ptr<QAudioSinkSpeex> sink = boost::dynamic_pointer_cast<QAudioSinkSpeex>(Tickee::withKey(handle));
 	if (!sink.get()) {
 		qLog() << "qSinkPushEncodedSpeex():  can't get sink with key: " << handle << flush;
@@ -377,8 +400,32 @@ QPrimitiveResultCode qSinkPushRawAudio(unsigned handle, short *bufferPtr, int sa
 		qLog() << "qSinkPushRawAudio():  failed dynamic cast: " << handle << flush;
 		return QPrimitiveResultBadDynamicCast;
 	}
-	sink->pushRawAudio(bufferPtr, sampleCount);  // XXXXX: should return error code
-	return QPrimitiveResultOK;	
+	return sink->pushRawAudio(bufferPtr, sampleCount);
+}
+
+
+QPrimitiveResultCode qSinkPushRawAudioBatch(unsigned *handles, int *sampleCounts, int streamCount, short *samples, int totalSamples)
+{
+	QPrimitiveResultCode result = QPrimitiveResultOK;
+	int offset = 0;
+
+	// Check every count before pushing any, so a bad batch pushes nothing.
+	for (int i = 0; i < streamCount; i++) {
+		int sampleCount = sampleCounts[i];
+		if (sampleCount < 0 || sampleCount > totalSamples - offset) {
+			qLog() << "qSinkPushRawAudioBatch():  sample counts exceed the " << totalSamples << " samples given" << flush;
+			return QPrimitiveResultBadGlue;
+		}
+		offset += sampleCount;
+	}
+
+	offset = 0;
+	for (int i = 0; i < streamCount; i++) {
+		QPrimitiveResultCode r = qSinkPushRawAudio(handles[i], samples + offset, sampleCounts[i]);
+		if (r != QPrimitiveResultOK && result == QPrimitiveResultOK) result = r;
+		offset += sampleCounts[i];
+	}
+	return result;
 }
 
 
@@ -394,8 +441,7 @@ QPrimitiveResultCode qSinkSetInputSamplingRate(unsigned handle, unsigned rate)
 		qLog() << "qSinkSetInputSamplingRate():  failed dynamic cast: " << handle << flush;
 		return QPrimitiveResultBadDynamicCast;
 	}
-	sink->setInputSamplingRate(rate);  // XXXXX: should return error code
-	return QPrimitiveResultOK;	
+	return sink->setInputSamplingRate(rate);
 }
 
 
@@ -411,8 +457,7 @@ QPrimitiveResultCode qSinkSetOutputSamplingRate(unsigned handle, unsigned rate)
 		qLog() << "qSinkSetOuputSamplingRate():  failed dynamic cast: " << handle << flush;
 		return QPrimitiveResultBadDynamicCast;
 	}
-	sink->setOutputSamplingRate(rate);  // XXXXX: should return error code
-	return QPrimitiveResultOK;	
+	return sink->setOutputSamplingRate(rate);
 }
 
 
@@ -0,0 +1,225 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  qAudioResampler.cpp
+ *  QAudioPlugin
+ *
+ */
+
+#include "qAudioResampler.hpp"
+#include "qLogger.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace Qwaq;
+
+const unsigned MAX_RATE = 192000;
+
+
+QAudioResampler::QAudioResampler()
+{
+	state = NULL;
+	inRate = outRate = 0;
+	inChannels = outChannels = channels = 1;
+	filterQuality = 3;
+	scratch = NULL;
+}
+
+
+QAudioResampler::~QAudioResampler()
+{
+	freeState();
+	if (scratch) free(scratch);
+}
+
+
+bool QAudioResampler::configure(unsigned inputRate, unsigned outputRate,
+								unsigned inputChannels, unsigned outputChannels, int quality)
+{
+	if (inputRate == 0 || inputRate > MAX_RATE || outputRate == 0 || outputRate > MAX_RATE) return false;
+	if (inputChannels == 0 || inputChannels > QRESAMPLER_MAX_CHANNELS || outputChannels == 0 || outputChannels > QRESAMPLER_MAX_CHANNELS) return false;
+	if (inputChannels != outputChannels && inputChannels != 1 && outputChannels != 1) return false;
+	if (quality < QRESAMPLER_MIN_QUALITY || quality > QRESAMPLER_MAX_QUALITY) return false;
+
+	unsigned newChannels = inputChannels < outputChannels ? inputChannels : outputChannels;
+	short* newScratch = NULL;
+	if (inputChannels != outputChannels) {
+		newScratch = (short*) malloc(CHUNK_FRAMES * newChannels * sizeof(short));
+		if (!newScratch) return false;
+	}
+
+	freeState();
+	if (scratch) free(scratch);
+	scratch = newScratch;
+	inRate = inputRate;
+	outRate = outputRate;
+	inChannels = inputChannels;
+	outChannels = outputChannels;
+	channels = newChannels;
+	filterQuality = quality;
+	if (inRate != outRate && !makeState()) {
+		inRate = outRate = 0;
+		return false;
+	}
+	return true;
+}
+
+
+bool QAudioResampler::setRates(unsigned inputRate, unsigned outputRate)
+{
+	if (!isConfigured()) return false;
+	if (inputRate == inRate && outputRate == outRate) return true;
+	if (inputRate == 0 || inputRate > MAX_RATE || outputRate == 0 || outputRate > MAX_RATE) return false;
+
+	if (inputRate == outputRate) {
+		// Nothing to filter.  The little that the filter still holds is lost.
+		freeState();
+	}
+	else if (state) {
+		// Speex keeps the filter's history across the change.
+		if (speex_resampler_set_rate(state, inputRate, outputRate) != RESAMPLER_ERR_SUCCESS) return false;
+	}
+	else {
+		unsigned oldIn = inRate, oldOut = outRate;
+		inRate = inputRate;
+		outRate = outputRate;
+		if (!makeState()) {
+			inRate = oldIn;
+			outRate = oldOut;
+			return false;
+		}
+	}
+	inRate = inputRate;
+	outRate = outputRate;
+	return true;
+}
+
+
+bool QAudioResampler::setQuality(int quality)
+{
+	if (!isConfigured()) return false;
+	if (quality < QRESAMPLER_MIN_QUALITY || quality > QRESAMPLER_MAX_QUALITY) return false;
+	if (state && speex_resampler_set_quality(state, quality) != RESAMPLER_ERR_SUCCESS) return false;
+	filterQuality = quality;
+	return true;
+}
+
+
+bool QAudioResampler::setChannels(unsigned inputChannels, unsigned outputChannels)
+{
+	if (!isConfigured()) return false;
+	if (inputChannels == inChannels && outputChannels == outChannels) return true;
+	return configure(inRate, outRate, inputChannels, outputChannels, filterQuality);
+}
+
+
+unsigned QAudioResampler::latency()
+{
+	return state ? speex_resampler_get_output_latency(state) : 0;
+}
+
+
+unsigned QAudioResampler::maxOutputFrames(unsigned inputFrames)
+{
+	if (!isConfigured()) return 0;
+	// Plus what the filter may be holding back from earlier calls.
+	return (unsigned)(((unsigned long long)inputFrames * outRate + inRate - 1) / inRate) + latency() + 1;
+}
+
+
+unsigned QAudioResampler::process(const short* input, unsigned& inputFrames, short* output, unsigned outputFrames)
+{
+	if (!isConfigured()) {
+		inputFrames = 0;
+		return 0;
+	}
+
+	unsigned inDone = 0, outDone = 0;
+	while (inDone < inputFrames && outDone < outputFrames) {
+		const short* in = input + inDone * inChannels;
+		short* out = output + outDone * outChannels;
+		spx_uint32_t inLen = inputFrames - inDone;
+		spx_uint32_t outLen = outputFrames - outDone;
+
+		// Downmix a chunk of input into the scratch space...
+		if (inChannels > channels) {
+			if (inLen > CHUNK_FRAMES) inLen = CHUNK_FRAMES;
+			for (unsigned i = 0; i < inLen; i++) {
+				int sum = 0;
+				for (unsigned c = 0; c < inChannels; c++) sum += in[i * inChannels + c];
+				scratch[i] = sum / (int)inChannels;
+			}
+			in = scratch;
+		}
+		// ...or resample into it for copying out to more channels.
+		short* target = out;
+		if (outChannels > channels) {
+			if (outLen > CHUNK_FRAMES) outLen = CHUNK_FRAMES;
+			target = scratch;
+		}
+
+		if (state) {
+			speex_resampler_process_interleaved_int(state, in, &inLen, target, &outLen);
+		}
+		else {
+			if (inLen < outLen) outLen = inLen;
+			else inLen = outLen;
+			if (target != in) memcpy(target, in, outLen * channels * sizeof(short));
+		}
+
+		if (outChannels > channels) {
+			for (unsigned i = 0; i < outLen; i++)
+				for (unsigned c = 0; c < outChannels; c++) out[i * outChannels + c] = scratch[i];
+		}
+
+		inDone += inLen;
+		outDone += outLen;
+		if (inLen == 0 && outLen == 0) break;
+	}
+	inputFrames = inDone;
+	return outDone;
+}
+
+
+void QAudioResampler::reset()
+{
+	if (state) speex_resampler_reset_mem(state);
+}
+
+
+bool QAudioResampler::makeState()
+{
+	int err;
+	state = speex_resampler_init(channels, inRate, outRate, filterQuality, &err);
+	if (!state) {
+		qLog() << "QAudioResampler: resampler creation failed with status: " << err << flush;
+		return false;
+	}
+	// Start with output rather than the filter's run-in of silence.
+	speex_resampler_skip_zeros(state);
+	return true;
+}
+
+
+void QAudioResampler::freeState()
+{
+	if (state) {
+		speex_resampler_destroy(state);
+		state = NULL;
+	}
+}
@@ -0,0 +1,104 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  qAudioResampler.hpp
+ *  QAudioPlugin
+ *
+ *  Sample-rate and channel-count conversion of 16-bit interleaved audio,
+ *  using the Speex resampler.
+ *
+ *  Rates and quality can be changed while audio is flowing; the filter's
+ *  history is kept, so there is no click and no re-allocation.  Changing
+ *  the channel counts starts afresh.  Input may have any number of channels
+ *  and is downmixed by averaging if the output has one; mono input may be
+ *  copied into any number of output channels.  Conversion happens at the
+ *  smaller of the two channel counts, so 48kHz stereo to 16kHz mono costs
+ *  a mono resampler.  Equal rates skip the resampler entirely.
+ *
+ *  There is no limit to how much is processed in one call: input is taken
+ *  in chunks through fixed scratch space, as output room allows.
+ */
+
+#ifndef __Q_AUDIO_RESAMPLER_HPP__
+#define __Q_AUDIO_RESAMPLER_HPP__
+
+#include <speex/speex_resampler.h>
+
+namespace Qwaq
+{
+
+// Speex quality: 0 is cheapest with the shortest filter, 10 the best with
+// the longest.  Its default (and what VoIP applications generally use) is 3.
+const int QRESAMPLER_MIN_QUALITY = 0;
+const int QRESAMPLER_MAX_QUALITY = 10;
+
+// Most channels on either side; more than one is mixed down or copied.
+const unsigned QRESAMPLER_MAX_CHANNELS = 8;
+
+class QAudioResampler
+{
+	public:
+		QAudioResampler();
+		~QAudioResampler();
+
+		// Answer false if the settings are unusable, leaving the resampler as
+		// it was (or unconfigured, if Speex itself fails).  Channel counts must
+		// be equal, or one must be 1.
+		bool configure(unsigned inputRate, unsigned outputRate,
+					   unsigned inputChannels, unsigned outputChannels, int quality);
+		bool setRates(unsigned inputRate, unsigned outputRate);
+		bool setQuality(int quality);
+		bool setChannels(unsigned inputChannels, unsigned outputChannels);
+
+		bool isConfigured() { return inRate != 0; }
+		unsigned inputRate() { return inRate; }
+		unsigned outputRate() { return outRate; }
+		unsigned inputChannels() { return inChannels; }
+		unsigned outputChannels() { return outChannels; }
+		int quality() { return filterQuality; }
+
+		// Delay added by the filter, in output frames.
+		unsigned latency();
+
+		// Most output frames that 'inputFrames' of input can produce.
+		unsigned maxOutputFrames(unsigned inputFrames);
+
+		// Convert as much of 'inputFrames' frames of input as fits into
+		// 'outputFrames' frames of output.  Answer the number of frames
+		// written, and set 'inputFrames' to the number consumed.
+		unsigned process(const short* input, unsigned& inputFrames, short* output, unsigned outputFrames);
+
+		// Forget the filter's history, e.g. after a gap in the input.
+		void reset();
+
+	protected:
+		enum { CHUNK_FRAMES = 1024 };
+
+		SpeexResamplerState* state;	// NULL while the rates are equal
+		unsigned inRate, outRate;
+		unsigned inChannels, outChannels;
+		unsigned channels;			// channel count that is resampled
+		int filterQuality;
+		short* scratch;				// CHUNK_FRAMES frames of 'channels' channels
+
+		bool makeState();
+		void freeState();
+};
+
+}; // namespace Qwaq
+
+#endif // #ifndef __Q_AUDIO_RESAMPLER_HPP__
@@ -24,12 +24,16 @@
 
 using namespace Qwaq;
 
+const unsigned SAMPLING_RATE = 16000;  // the ticker's
+
 
 QAudioSinkBufferedResampler::QAudioSinkBufferedResampler() : ring(FRAME_SIZE*sizeof(short)*100)
 {
 	className = "QAudioSinkBufferedResampler"; // for logging
-	inputRate = outputRate = 0;
-	resampler = NULL;
+	inputRate = 0;
+	outputRate = SAMPLING_RATE;
+	inputChannels = 1;
+	quality = 8;  // pretty good quality (ranges from 0-10)
 	bufferedFrameCount = 1;
 	preBuffered = false;
 	pushFailed = false;
@@ -40,8 +44,6 @@ QAudioSinkBufferedResampler::QAudioSinkBufferedResampler() : ring(FRAME_SIZE*siz
 
 QAudioSinkBufferedResampler::~QAudioSinkBufferedResampler()
 {
-	if (resampler) { speex_resampler_destroy(resampler); }
-	
 	log() << " ** DESTROYED" << flush;
 }
 
@@ -69,81 +71,107 @@ void QAudioSinkBufferedResampler::tick()
 }
 
 
-void QAudioSinkBufferedResampler::pushRawAudio(short* bufferPtr, int sampleCount)
+// Make sure that the resampler matches the settings.  Rate changes are made
+// in place, so audio flows on without a click.
+bool QAudioSinkBufferedResampler::prepareResampler()
 {
-	if (!resampler) { // must lazily create the resampler
-		if (inputRate == 0) {
-			log() << "pushRawAudio()... no input-rate specified" << flush;
-			return;
-		}
-		if (outputRate == 0) {
-			log() << "pushRawAudio()... no output-rate specified" << flush;
-			return;
-		}
-		if (outputRate != 16000) {
-			log() << "pushRawAudio()... output-rate must be 16kHz" << flush;
-			return;
-		}
-		int err;
-		resampler = speex_resampler_init(1, // mono sound
-										inputRate, 
-										outputRate, 
-										8,  // pretty good quality (ranges from 1-10)
-										&err);
-		if (!resampler) {
-			log() << "pushRawAudio()... resampler creation failed with status: " << err << flush;
-			return;
-		}
-		else {
-			log() << "pushRawAudio()... instantiated resampler from " << inputRate << "kHz to " << outputRate << "kHz";
+	if (inputRate == 0) {
+		log() << "pushRawAudio()... no input-rate specified" << flush;
+		return false;
+	}
+	if (!resampler.isConfigured()) {
+		if (!resampler.configure(inputRate, outputRate, inputChannels, 1, quality)) {
+			log() << "pushRawAudio()... resampler creation failed" << flush;
+			return false;
 		}
+		log() << "pushRawAudio()... instantiated resampler from " << inputRate << "Hz to " << outputRate << "Hz"
+			<< " (" << inputChannels << " channels, quality " << quality << ")";
+		return true;
 	}
-	
-	unsigned inSize = sampleCount;
-	unsigned outSize = 10000;
-	short tempBuf[10000]; // More than enough for 200ms of 44.1kHz sound
-	if ((sampleCount / inputRate * outputRate) > 10000) { // Sanity check
-		log() << "pushRawAudio()... sample count incorrect for input/output rates: " << sampleCount;
-		printDebugInfo();
-		return;
+	if (resampler.inputRate() != inputRate || resampler.outputRate() != outputRate) {
+		if (!resampler.setRates(inputRate, outputRate)) return false;
+		log(1) << "pushRawAudio()... resampling from " << inputRate << "Hz to " << outputRate << "Hz";
 	}
-	speex_resampler_process_int(resampler, 0, bufferPtr, &inSize, tempBuf, &outSize);
-	try {
-		ring.put(tempBuf, outSize*sizeof(short));
-	} catch (std::string s) {
-		// If we're at default verbosity, only log once, otherwise log every time
-		log(pushFailed ? 1 : 0) 
-			<< "pushRawAudio(): ring-buffer push failed("
-			<< (outSize*sizeof(short)) << "/" << ring.dataSize() << "/" << ring.totalSize()
-			<< "): " << s << flush;
-		pushFailed = true;
+	if (resampler.inputChannels() != inputChannels && !resampler.setChannels(inputChannels, 1)) return false;
+	if (resampler.quality() != quality && !resampler.setQuality(quality)) return false;
+	return true;
+}
+
+
+QPrimitiveResultCode QAudioSinkBufferedResampler::pushRawAudio(short* bufferPtr, int sampleCount)
+{
+	if (!prepareResampler()) return QPrimitiveResultBadSamplingRate;
+	
+	// Resample through the scratch buffer, as much at a time as fits.
+	unsigned frames = sampleCount / inputChannels;
+	while (frames > 0) {
+		unsigned consumed = frames;
+		unsigned outSize = resampler.process(bufferPtr, consumed, scratch, SCRATCH_SAMPLES);
+		bufferPtr += consumed * inputChannels;
+		frames -= consumed;
+		if (outSize == 0) {
+			if (consumed == 0) break;
+			continue;
+		}
+		try {
+			ring.put(scratch, outSize*sizeof(short));
+		} catch (std::string s) {
+			// If we're at default verbosity, only log once, otherwise log every time
+			log(pushFailed ? 1 : 0) 
+				<< "pushRawAudio(): ring-buffer push failed("
+				<< (outSize*sizeof(short)) << "/" << ring.dataSize() << "/" << ring.totalSize()
+				<< "): " << s << flush;
+			pushFailed = true;
+			break;
+		}
 	}
+	return QPrimitiveResultOK;
 }
 
 
-void QAudioSinkBufferedResampler::setInputSamplingRate(unsigned rate)
+QPrimitiveResultCode QAudioSinkBufferedResampler::setInputSamplingRate(unsigned rate)
 {
-	if (inputRate == rate) return;
+	if (rate == 0) return QPrimitiveResultBadSamplingRate;
 	inputRate = rate;
-	if (resampler) {
-		speex_resampler_destroy(resampler);
-		resampler = NULL;
+	// the resampler picks this up with the next audio
+	return QPrimitiveResultOK;
+}
+
+
+// The output feeds the ticker, so this is only here for Squeak code that
+// sets it explicitly.
+QPrimitiveResultCode QAudioSinkBufferedResampler::setOutputSamplingRate(unsigned rate)
+{
+	if (rate != SAMPLING_RATE) {
+		log() << "setOutputSamplingRate()... output-rate must be " << SAMPLING_RATE << "Hz, not " << rate << flush;
+		return QPrimitiveResultBadSamplingRate;
 	}
-	// resampler will be lazily created when necessary
+	return QPrimitiveResultOK;
 }
 
 
-void QAudioSinkBufferedResampler::setOutputSamplingRate(unsigned rate)
+int QAudioSinkBufferedResampler::genericControl(int ctlType, int ctlVal)
 {
-	if (outputRate == rate) return;
-	outputRate = rate;
-	if (resampler) {
-		speex_resampler_destroy(resampler);
-		resampler = NULL;
+	switch (ctlType) {
+		case QResamplerSetInputChannels:
+			if (ctlVal < 1 || ctlVal > (int)QRESAMPLER_MAX_CHANNELS) return -1;
+			inputChannels = ctlVal;
+			return 0;
+		case QResamplerGetInputChannels:
+			return inputChannels;
+		case QResamplerSetQuality:
+			if (ctlVal < QRESAMPLER_MIN_QUALITY || ctlVal > QRESAMPLER_MAX_QUALITY) return -1;
+			quality = ctlVal;
+			return 0;
+		case QResamplerGetQuality:
+			return quality;
+		case QResamplerGetLatency:
+			return resampler.latency();
 	}
-	// resampler will be lazily created when necessary
+	return Tickee::genericControl(ctlType, ctlVal);
 }
 
+
 // Set the number of frames that should be buffered before starting to play.
 // This will take effect the next time that we receive the first frame after 
 // being completely drained.
@@ -168,5 +196,8 @@ void QAudioSinkBufferedResampler::printDebugInfo()
 	log()
 		<< "printDebugInfo(): " << "\n\t"
 		<< "input rate: " << inputRate << "\n\t"
-		<< "output rate: " << outputRate << flush;
+		<< "output rate: " << outputRate << "\n\t"
+		<< "input channels: " << inputChannels << "\n\t"
+		<< "quality: " << quality << "\n\t"
+		<< "latency: " << resampler.latency() << flush;
 }
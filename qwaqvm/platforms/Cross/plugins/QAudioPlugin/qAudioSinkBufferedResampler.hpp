@@ -17,6 +17,11 @@
  *  qAudioSinkBufferedResampler.hpp
  *  QAudioPlugin
  *
+ *  Plays raw audio pushed from Squeak (media playback, screen-share audio),
+ *  converted to the ticker's 16kHz mono by a QAudioResampler.  The input may
+ *  have any rate and number of channels, and the rate may change while
+ *  playing.  Channels and quality are set through qSinkControl() (see
+ *  QResamplerControl in QAudioPlugin.h).
  */
 
 #ifndef __Q_AUDIO_SINK_BUFFERED_RESAMPLER_HPP__
@@ -24,7 +29,8 @@
 
 #include "qTickee.hpp"
 #include "qRingBuffer.hpp"
-#include <speex/speex_resampler.h>
+#include "qAudioResampler.hpp"
+#include "QAudioPlugin.h"
 
 namespace Qwaq {
 
@@ -36,20 +42,30 @@ class QAudioSinkBufferedResampler : public Tickee
 		
 		virtual void tick();
 		virtual unsigned tickPriority() { return 10; }  // top priority
+		virtual bool tickInParallel() { return true; }  // plays only what is pushed to it
 		virtual void addSource(shared_tickee src) {} // meaningless for buffered-resampler
 		virtual void removeSource(shared_tickee src) {} // meaningless for buffered-resampler
 		virtual void printDebugInfo();
-		void pushRawAudio(short* bufferPtr, int sampleCount);
-		void setInputSamplingRate(unsigned rate);
-		void setOutputSamplingRate(unsigned rate);
+		virtual int genericControl(int ctlType, int ctlVal);
+		// 'sampleCount' counts every channel's samples.
+		QPrimitiveResultCode pushRawAudio(short* bufferPtr, int sampleCount);
+		QPrimitiveResultCode setInputSamplingRate(unsigned rate);
+		QPrimitiveResultCode setOutputSamplingRate(unsigned rate);
 		void setBufferedFrameCount(unsigned frameCount);
 		
 		
 	protected:
-		SpeexResamplerState *resampler;
+		enum { SCRATCH_SAMPLES = 2048 };
+
+		QAudioResampler resampler;
 		QRingBuffer ring;
 		unsigned inputRate;
 		unsigned outputRate;
+		unsigned inputChannels;
+		int quality;
+		short scratch[SCRATCH_SAMPLES];
+		
+		bool prepareResampler();
 		
 		unsigned bufferedFrameCount;
 		bool preBuffered;
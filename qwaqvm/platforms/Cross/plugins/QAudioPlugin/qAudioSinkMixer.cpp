@@ -24,6 +24,7 @@
 using namespace Qwaq;
 
 #include <algorithm>
+#include <string.h>
 
 QAudioSinkMixer::QAudioSinkMixer() 
 {
@@ -42,12 +43,11 @@ QAudioSinkMixer::~QAudioSinkMixer()
 void QAudioSinkMixer::tick()
 {
 	int sum[FRAME_SIZE];
-	int min=0, max=0;
-	int activeSources = 0;
-	for (int i=0; i<FRAME_SIZE; i++) sum[i]=0;
+	int min, max;
 	
-	// Obtain strong references to all Tickees.  If any weak-ref is now NULL,
-	// clean up the list.
+	// Obtain strong references to all Tickees that have a buffer for us.  If any 
+	// weak-ref is now NULL, clean up the list.  Sources with nothing to play (a 
+	// sink waiting for its sender to speak, say) cost only the check.
 
 	{
 		scoped_lock lk(mutex);
@@ -59,10 +59,8 @@ void QAudioSinkMixer::tick()
 				needsFixup = true;
 			}
 			else if (strong->hasValidBuffer()) {
-				// We found a source that has a buffer for us to mix.  So mix it.
-				activeSources++;
-				short *buf = strong->getBuffer();
-				for (int i=0; i<FRAME_SIZE; i++) sum[i] += buf[i];
+				// We found a source that has a buffer for us to mix.
+				active.push_back(strong);
 			}
 		}
 		
@@ -79,6 +77,7 @@ void QAudioSinkMixer::tick()
 		}
 	}
 	
+	int activeSources = active.size();
 	if (activeSources == 0) {
 		if (outputEvenIfNoInput) {
 			for (int i=0; i<FRAME_SIZE; i++) buffer[i] = 0;
@@ -88,7 +87,30 @@ void QAudioSinkMixer::tick()
 		return;
 	}
 	hasBuffer = true;
-		
+	
+	if (activeSources == 1) {
+		// Nothing to mix it with, so nothing can clip.
+		memcpy(buffer, active[0]->getBuffer(), FRAME_SIZE * sizeof(short));
+		active.clear();
+		return;
+	}
+	
+	for (int i=0; i<FRAME_SIZE; i++) sum[i]=0;
+	for (vector<shared_tickee>::iterator it = active.begin(); it != active.end(); ++it) {
+		short *buf = (*it)->getBuffer();
+		for (int i=0; i<FRAME_SIZE; i++) sum[i] += buf[i];
+	}
+	active.clear();  // don't keep sources alive until the next tick
+	
+	scaleToFit(sum, buffer, &min, &max);
+	
+	if (qLogEnabled(5))
+		log(5) << "ticked " << activeSources << " out of " << sources.size() << " sources...   max/min = " << max << "/" << min;
+}
+
+void QAudioSinkMixer::scaleToFit(const int* sum, short* output, int* minResult, int* maxResult)
+{
+	int min=0, max=0;
 	for (int i=0; i<FRAME_SIZE; i++) {
 		if (sum[i] < min) min = sum[i];
 		if (sum[i] > max) max = sum[i];
@@ -101,10 +123,10 @@ void QAudioSinkMixer::tick()
 	maxRatio = (maxRatio > minRatio) ? maxRatio : minRatio;
 	if (maxRatio < 1.0) maxRatio = 1;
 	for (int i=0; i<FRAME_SIZE; i++) 
-		buffer[i] = (short)(sum[i]/maxRatio);
-	hasBuffer = true;
+		output[i] = (short)(sum[i]/maxRatio);
 	
-	log(5) << "ticked " << activeSources << " out of " << sources.size() << " sources...   max/min = " << max << "/" << min;
+	if (minResult) *minResult = min;
+	if (maxResult) *maxResult = max;
 }
 
 void QAudioSinkMixer::addSource(shared_tickee src)
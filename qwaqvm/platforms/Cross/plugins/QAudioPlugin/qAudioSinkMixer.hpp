@@ -42,8 +42,13 @@ class QAudioSinkMixer : public Tickee
 		virtual void removeSource(shared_tickee src);
 		virtual void printDebugInfo();
 		
+		// Scale a frame of summed samples down into 'output' so that none clip,
+		// as tick() does; optionally answer the extremes of the sum.
+		static void scaleToFit(const int* sum, short* output, int* minResult = NULL, int* maxResult = NULL);
+		
 	protected:		
 		vector<weak_tickee> sources;
+		vector<shared_tickee> active;	// sources with a buffer this tick; kept to save allocating
 		boost::mutex mutex;
 		
 		bool outputEvenIfNoInput;
@@ -22,6 +22,13 @@
 #include "qAudioSinkOpenAL.hpp"
 #include "qAudioOpenAL.h"
 #include "qLogger.hpp"
+#include "QAudioPlugin.h"
+
+#include <limits.h>
+#include <math.h>
+
+extern "C" { extern struct VirtualMachine* interpreterProxy; }
+
 using namespace Qwaq;
 
 typedef boost::unique_lock<boost::shared_mutex> unique_mutex_lock;
@@ -46,8 +53,20 @@ QAudioSinkOpenAL::QAudioSinkOpenAL() : Tickee()
 	outerGain = 0.8;
 		
 	silentStreak = 0;
-	isStarted = false;
+	resetBuffers();
 	isGainBakedIn = false;
+	
+	isAdaptive = true;
+	minDepth = 2;
+	maxDepth = 8;
+	targetDepth = minDepth;
+	ticksSinceChange = 0;
+	leastSpare = INT_MAX;
+	depthError = 0;
+	stretching = 0;
+	lastSample = 0;
+	lastFrameMicroseconds = 0;
+	resetStats();
 	log() << " ** CREATED" << flush;
 }
 
@@ -64,6 +83,7 @@ void QAudioSinkOpenAL::tick()
 	if (strong.get() == NULL || !strong->hasValidBuffer()) {
 		
 		hasBuffer = false;
+		lastSample = 0;
 		
 		silentStreak++;
 		if (silentStreak == 3) {
@@ -79,18 +99,15 @@ void QAudioSinkOpenAL::tick()
 				}
 			}
 		} 
-		// If we've been playing, we must free buffers here (because playAudioDirectly won't be able 
-		// to do it later if not yet isStarted). Otherwise, we'll have no freeBuffers later on, and 
-		// the OS audio may extrapolate (as OSX is want to do, producing a machine gun sound).
-		// Note that this means that even when we bail here, the OS can keep playing what it has.
+		// If we've been playing, we free buffers here as they finish, so that we have them when
+		// the next utterance starts.  Otherwise the OS audio may extrapolate (as OSX is want to do,
+		// producing a machine gun sound).  An utterance too short to have started playing is 
+		// played now.  Note that even when we bail here, the OS can keep playing what it has.
 		if (oalSource != 0) {  
 			shared_mutex_lock lk(g_oal_mutex);
-			ALint nBuffAlloc = 0, nBuffProc = 0;
-			alGetSourcei(oalSource, AL_BUFFERS_QUEUED, &nBuffAlloc);
-			if (nBuffAlloc > 0) { // If we've been playing...
-				alGetSourcei(oalSource, AL_BUFFERS_PROCESSED, &nBuffProc);
-				while ( (nBuffProc-- > 0) && returnOneBuffer() );
-			}	
+			unique_mutex_lock lk2(mutex);
+			if (!isStarted && filledCount > 0) startPlaying();
+			else if (reclaimBuffers()) isStarted = false;  // played out; not an underrun
 		}
 		return;
 	}
@@ -104,7 +121,7 @@ void QAudioSinkOpenAL::tick()
 	short* sourceBuffer = strong->getBuffer();
 	memcpy(buffer, sourceBuffer, FRAME_SIZE * sizeof(short));
 	isGainBakedIn = (gain == 1.0f);
-	playAudioDirectly(sourceBuffer, FRAME_SIZE * sizeof(short));
+	playFrame(sourceBuffer);
 }
 
 
@@ -196,160 +213,381 @@ void QAudioSinkOpenAL::setGain(float newGain)
 }
 
 
-// Recover one buffer that has finished processing.
-// We exercise care here to discover any buffers returned twice,
-// as has been observed on Mac OS.
-// Private, called in loop from play-directly, which holds the locks.
-bool QAudioSinkOpenAL::returnOneBuffer () 
+int QAudioSinkOpenAL::genericControl(int ctlType, int ctlVal)
+{
+	unique_mutex_lock lk(mutex);
+	switch (ctlType) {
+		case QOpenALSetAdaptive:
+			isAdaptive = (ctlVal != 0);
+			if (!isAdaptive) {
+				targetDepth = minDepth;
+				stretching = 0;
+			}
+			return 0;
+		case QOpenALGetAdaptive:
+			return isAdaptive;
+		case QOpenALSetMinDepth:
+			if (ctlVal < 1 || ctlVal > maxDepth) return -1;
+			minDepth = ctlVal;
+			if (targetDepth < minDepth || !isAdaptive) targetDepth = minDepth;
+			return 0;
+		case QOpenALGetMinDepth:
+			return minDepth;
+		case QOpenALSetMaxDepth:
+			if (ctlVal < minDepth || ctlVal > NUM_BUFFERS - 2) return -1;
+			maxDepth = ctlVal;
+			if (targetDepth > maxDepth) targetDepth = maxDepth;
+			return 0;
+		case QOpenALGetMaxDepth:
+			return maxDepth;
+		case QOpenALGetDepth:
+			return targetDepth;
+		case QOpenALGetLatency:
+			return latencySamples * 1000 / SAMPLING_RATE;
+		case QOpenALGetMeanLatency:
+			return latencyCount ? (int)(latencySum / latencyCount * 1000 / SAMPLING_RATE) : 0;
+		case QOpenALGetUnderruns:
+			return (int)underruns;
+		case QOpenALGetOverruns:
+			return (int)overruns;
+		case QOpenALGetStretchedFrames:
+			return (int)stretchedFrames;
+		case QOpenALGetSqueezedFrames:
+			return (int)squeezedFrames;
+		case QOpenALResetStats:
+			resetStats();
+			return 0;
+	}
+	return Tickee::genericControl(ctlType, ctlVal);
+}
+
+
+void QAudioSinkOpenAL::resetStats()
+{
+	underruns = overruns = 0;
+	stretchedFrames = squeezedFrames = 0;
+	latencySum = 0;
+	latencyCount = 0;
+}
+
+
+// Forget the buffers; there are none free until they are generated.
+void QAudioSinkOpenAL::resetBuffers()
+{
+	freeCount = 0;
+	filledHead = filledCount = 0;
+	sourceQueuedCount = sourceQueuedSamples = 0;
+	latencySamples = 0;
+	isStarted = false;
+}
+
+
+// Take back the buffers that OpenAL has finished playing, and measure what
+// it has left to play.  Answer whether the source ran dry while playing.
+// Private; callers hold the locks.
+bool QAudioSinkOpenAL::reclaimBuffers()
+{
+	if (sourceQueuedCount == 0) {
+		latencySamples = 0;
+		return false;
+	}
+
+	ALint processed = 0, state = AL_INITIAL, offset = 0;
+	alGetSourcei(oalSource, AL_BUFFERS_PROCESSED, &processed);
+	alGetSourcei(oalSource, AL_SOURCE_STATE, &state);
+	ALenum err = alGetError();
+	if (err) {
+		log() << "reclaimBuffers: Cannot check buffers: " << err << flush;
+		return false;
+	}
+	bool ranDry = isStarted && (state == AL_STOPPED || processed >= sourceQueuedCount);
+
+	// We do one at a time here to try to avoid problems with MAC-OS OpenAL
+	// It sometimes gives the same buffer twice, and sometimes frees twice internally.
+	while ( (processed-- > 0) && returnOneBuffer() );
+
+	// The offset is into the oldest buffer still queued.
+	if (sourceQueuedCount > 0) {
+		alGetSourcei(oalSource, AL_SAMPLE_OFFSET, &offset);
+		if (alGetError() != AL_NO_ERROR) offset = 0;
+	}
+	latencySamples = sourceQueuedSamples - offset;
+	if (latencySamples < 0) latencySamples = 0;
+	return ranDry;
+}
+
+
+// Recover one buffer that has finished processing, which should be the
+// oldest one queued.  We exercise care here to discover any buffers
+// returned twice, as has been observed on Mac OS.
+// Private, called in loop from reclaimBuffers(), which holds the locks.
+bool QAudioSinkOpenAL::returnOneBuffer ()
 {
 	ALenum err;
-	ALuint reclaim[1];
-	alSourceUnqueueBuffers(oalSource, 1, reclaim);
+	ALuint bufid;
+	alSourceUnqueueBuffers(oalSource, 1, &bufid);
 	err = alGetError();
 	if (err) {
 		log() << "returnOneBuffer: Unqueue error " << err << flush;
 		return false;
 	}
-	ALuint bufid = reclaim[0];
-	bool goodToReclaim = true;
-	
-	for (int j = 0; j < freeBuffers.size(); j++) {
-		if (freeBuffers[j] == bufid) {
+
+	int index = filled[filledHead];
+	if (sourceQueuedCount > 0 && bufid == oalBuffers[index]) {
+		// Healthy... OpenAL is giving back the buffer we think it should.
+		filledHead = (filledHead + 1) % NUM_BUFFERS;
+		filledCount--;
+		sourceQueuedCount--;
+		sourceQueuedSamples -= bufferSamples[index];
+		freeList[freeCount++] = index;
+		return true;
+	}
+
+	// Say what's wrong with it.
+	for (int i = 0; i < freeCount; i++) {
+		if (oalBuffers[freeList[i]] == bufid) {
 			log() << "returnOneBuffer: BUF LISTED FREE: " << bufid << flush;
-			goodToReclaim = false;
-			goto DONE_CHECKS;
+			return false;
 		}
 	}
-	for (int j = 0; j < queuedBuffers.size(); j++) {
-		if (queuedBuffers[j] == bufid) {
-			log() << "returnOneBuffer: BUF QUEUED TO PLAY: " << bufid << flush;
-			goodToReclaim = false;
-			goto DONE_CHECKS;
+	for (int i = 0; i < filledCount; i++) {
+		if (oalBuffers[filled[(filledHead + i) % NUM_BUFFERS]] == bufid) {
+			if (i < sourceQueuedCount)
+				log() << "returnOneBuffer: BUF OUT OF ORDER: " << bufid << flush;
+			else
+				log() << "returnOneBuffer: BUF QUEUED TO PLAY: " << bufid << flush;
+			return false;
 		}
 	}
-	
-	// This last check is a positive one - do we know this buffer id?
-	goodToReclaim = false;
-	for (int j = 0; j < NUM_BUFFERS; j++) {
-		if (bufid == oalBuffers[j]) {
-			goodToReclaim = true;
-			goto DONE_CHECKS;
+	log() << "returnOneBuffer: BUF NOT MINE: " << bufid << flush;
+	return false;
+}
+
+
+// Fill a free buffer with 'data', after those waiting to be played.
+// Private; callers hold the locks and have checked that a buffer is free.
+void QAudioSinkOpenAL::queueBuffer(const ALvoid* data, ALsizei byteSize)
+{
+	int index = freeList[--freeCount];
+	alBufferData(oalBuffers[index], AL_FORMAT_MONO16, data, byteSize, SAMPLING_RATE);
+	ALenum err = alGetError();
+	if (err != AL_NO_ERROR) {
+		log() << "queueBuffer():  ERROR 2a code: " << err;
+		freeList[freeCount++] = index;
+		return;
+	}
+	bufferSamples[index] = byteSize / sizeof(short);
+	filled[(filledHead + filledCount) % NUM_BUFFERS] = index;
+	filledCount++;
+}
+
+
+// Give OpenAL every filled buffer that it doesn't have yet, and make sure
+// that it is playing them.  Private; callers hold the locks.
+void QAudioSinkOpenAL::startPlaying()
+{
+	ALenum err;
+	isStarted = true;
+
+	while (sourceQueuedCount < filledCount) {
+		int index = filled[(filledHead + sourceQueuedCount) % NUM_BUFFERS];
+		alSourceQueueBuffers(oalSource, 1, &oalBuffers[index]);
+		err = alGetError();
+		if (err != AL_NO_ERROR) {
+			// Free this buffer and those after it, to keep the rest in order.
+			log() << "startPlaying():  ERROR 2b (queuing): " << err << flush;
+			while (filledCount > sourceQueuedCount) {
+				filledCount--;
+				freeList[freeCount++] = filled[(filledHead + filledCount) % NUM_BUFFERS];
+			}
+			break;
 		}
+		sourceQueuedCount++;
+		sourceQueuedSamples += bufferSamples[index];
+	}
+
+	int isPlaying = AL_INITIAL;
+	alGetSourcei(oalSource, AL_SOURCE_STATE, &isPlaying);
+	err = alGetError();
+	if (err != AL_NO_ERROR) {
+		log() << "startPlaying():  ERROR 2c code: " << err << flush;
 	}
-	// If we fall through that last test, we didn't find a match.
-	if (! goodToReclaim) {
-		log() << "returnOneBuffer: BUF NOT MINE: " << bufid << flush;
+	if (isPlaying != AL_PLAYING) {
+		alSourcePlay(oalSource);
+		// Verify that it worked.
+		alGetSourcei(oalSource, AL_SOURCE_STATE, &isPlaying);
+		err = alGetError();
+		if (err || (isPlaying != AL_PLAYING)) {
+			log() << "startPlaying(): FAILED TO START PLAYING " << err << flush;
+		}
 	}
-	
-  DONE_CHECKS: 
-	if (goodToReclaim) {
-		// Healthy... OpenAL is giving back a buffer we think it should.
-		freeBuffers.push_back(bufid);
+
+	err = alGetError();
+	if (err != AL_NO_ERROR) {
+		log() << "startPlaying():  ERROR 3  code: " << err << flush;
 	}
-	return goodToReclaim;
 }
 
 
-void QAudioSinkOpenAL::playAudioDirectly(ALvoid* data, ALsizei byteSize)
+// Play a frame from our source, adapting the depth of the queue as we go.
+void QAudioSinkOpenAL::playFrame(const short* frame)
 {
 	// Ensure that the OpenAL context doesn't change out from under us.
 	shared_mutex_lock lk(g_oal_mutex);
 
-	ALenum	err;
-	ALint	freedBufferCount = 0;
-	
 	// This creates a source if we need one, return true iff it makes a new source.
-	bool	newSource = ensureValidSource();
-	
+	bool newSource = ensureValidSource();
+
 	// Now take the lock so we can trust the source.
 	unique_mutex_lock lk2(mutex);
 	if (oalSource == 0) {
-		// XXXXX: need error handling
-		log() << "playAudioDirectly():  invalid source";
+		log() << "playFrame():  invalid source";
 		return;
 	}
-	
-	// Reclaim buffers that are finished playing.
-	if (! newSource ) {
-		// We do one at a time here to try to avoid problems with MAC-OS OpenAL
-		// It sometimes gives the same buffer twice, and sometimes frees twice internally.
-		
-		alGetSourcei(oalSource, AL_BUFFERS_PROCESSED, &freedBufferCount);
-		err = alGetError();
-		if (err) {
-			log() << "playAudioDirectly: Cannot check buffers: " << err << flush;
-			freedBufferCount = 0;	// Paranoia
-		}
-		while ( (freedBufferCount > 0) && returnOneBuffer() ) {
-			freedBufferCount --;
-		}
+
+	usqLong now = interpreterProxy->utcMicroseconds();
+	int latencyAfterLast = latencySamples;
+	if (!newSource && reclaimBuffers()) {
+		// Build the queue back up before playing again, deep enough to have
+		// lasted since the last frame with half a frame to spare: the source's
+		// position lags the device's by as much as one of its periods.
+		int elapsed = (int)((now - lastFrameMicroseconds) * SAMPLING_RATE / 1000000);
+		underruns++;
+		isStarted = false;
+		adaptDepth(true, elapsed - latencyAfterLast);
 	}
-	
-	// Ensure that there is a free buffer.
-	if (freeBuffers.size() == 0) {
-		log(1) << "playAudioDirectly(): No free buffers" ;
+	else if (isStarted) {
+		adaptDepth(false, 0);
+	}
+	lastFrameMicroseconds = now;
+
+	const short* samples = frame;
+	int sampleCount = FRAME_SIZE;
+	if (isStarted && stretching != 0) {
+		sampleCount = stretchFrame(frame);
+		samples = stretched;
+	}
+	lastSample = frame[FRAME_SIZE - 1];
+
+	if (freeCount == 0) {
+		overruns++;
+		log(1) << "playFrame(): No free buffers" ;
 		return;
 	}
-	
-	// Play that funky music.
-	ALuint playBuffer = freeBuffers.back();
-	freeBuffers.pop_back();
-	alBufferData(playBuffer, AL_FORMAT_MONO16, data, byteSize, SAMPLING_RATE);
-	queuedBuffers.push_back(playBuffer);
-	
-	err = alGetError();
-	if (err != AL_NO_ERROR) {
-		log() << "playAudioDirectly():  ERROR 2a code: " << err;
-	}	
-	
-	// We don't start playing until we've got a couple of buffers to play,
-	// to avoid some static if there's lag while getting a new utterance going.
-	if (!isStarted) {
-		if (queuedBuffers.size() < 2) return;
-		isStarted = true;
-	}
-	// Once started, we give OpenAL everything we've got for it.
-	for (int i = 0; i < queuedBuffers.size(); i++) {
-		alSourceQueueBuffers(oalSource, 1, &(queuedBuffers[i]));
-		err = alGetError();
-		if (err != AL_NO_ERROR) {
-			log() << "playAudioDirectly():  ERROR 2b (queuing): " << err << flush;
-			freeBuffers.push_back(queuedBuffers[i]);
+	queueBuffer(samples, sampleCount * sizeof(short));
+
+	// We don't start playing until we've got as many buffers as we're aiming
+	// for, to avoid some static if there's lag while getting a new utterance going.
+	if (!isStarted && filledCount < targetDepth) return;
+	int played = sourceQueuedSamples - latencySamples;
+	startPlaying();
+	latencySamples = sourceQueuedSamples - played;
+	latencySum += latencySamples;
+	latencyCount++;
+}
+
+
+// Adjust the depth for a frame about to be queued, given the latency
+// measured just before, and after an underrun, how many samples short the
+// queue was.  Private; callers hold the locks.
+void QAudioSinkOpenAL::adaptDepth(bool underrun, int shortfall)
+{
+	if (underrun) {
+		if (isAdaptive && targetDepth < maxDepth) {
+			int frames = (shortfall + FRAME_SIZE / 2 + FRAME_SIZE - 1) / FRAME_SIZE;
+			targetDepth += (frames > 1) ? frames : 1;
+			if (targetDepth > maxDepth) targetDepth = maxDepth;
+			log(1) << "adaptDepth(): underrun " << shortfall << " samples short; depth now " << targetDepth;
 		}
+		ticksSinceChange = 0;
+		leastSpare = INT_MAX;
+		depthError = 0;
+		stretching = 0;
+		return;
+	}
+	if (!isAdaptive) return;
+
+	if (latencySamples < leastSpare) leastSpare = latencySamples;
+	if (++ticksSinceChange >= SHRINK_TICKS) {
+		// With a frame and a half to spare all along, one fewer would have done.
+		if (leastSpare >= 3 * FRAME_SIZE / 2 && targetDepth > minDepth) {
+			targetDepth--;
+			log(1) << "adaptDepth(): depth now " << targetDepth;
+		}
+		ticksSinceChange = 0;
+		leastSpare = INT_MAX;
 	}
-	queuedBuffers.clear();
 
-	// XXXXX: try to get some idea of how many buffers are available
-	if (freeBuffers.size() >= NUM_BUFFERS-1) {
-		log(7) << "playAudioDirectly(): FREE BUFFER COUNT: " << freeBuffers.size() ;
+	// Stretch or squeeze frames while the smoothed depth is more than half a
+	// frame off, until it is back within an eighth.
+	float error = (float)(latencySamples + FRAME_SIZE - targetDepth * FRAME_SIZE);
+	depthError += (error - depthError) / 16;
+	if (stretching == 0) {
+		if (depthError > FRAME_SIZE / 2) stretching = -1;
+		else if (depthError < -FRAME_SIZE / 2) stretching = 1;
 	}
-	
-	err = alGetError();
-	if (err != AL_NO_ERROR) {
-		log() << "playAudioDirectly():  ERROR 2c code: " << err << flush;
+	else if (depthError * stretching > -FRAME_SIZE / 8) {
+		stretching = 0;
 	}
-	
-	int isPlaying = AL_INITIAL;
-	alGetSourcei(oalSource, AL_SOURCE_STATE, &isPlaying);
-	err = alGetError();
-	if (err != AL_NO_ERROR) {
-		log() << "playAudioDirectly():  ERROR 2c code: " << err << flush;
+}
+
+
+// Resample 'frame' into 'stretched', STRETCH_SAMPLES longer or shorter as
+// 'stretching' says, interpolating from the end of the previous frame so
+// that they join up.  Answer the number of samples.  This changes the pitch
+// by 2.5%, which is hard to hear, and only while the depth is off.
+int QAudioSinkOpenAL::stretchFrame(const short* frame)
+{
+	int count = FRAME_SIZE + stretching * STRETCH_SAMPLES;
+
+	// Sample i comes from (i + 1) * step - 1 in 'frame', where -1 is lastSample.
+	double step = (double)FRAME_SIZE / count;
+	for (int i = 0; i < count; i++) {
+		double position = (i + 1) * step - 1;
+		int j = (int)floor(position);
+		double fraction = position - j;
+		double a = (j < 0) ? lastSample : frame[j];
+		double b = (j + 1 < FRAME_SIZE) ? frame[j + 1] : frame[FRAME_SIZE - 1];
+		stretched[i] = (short)(a + fraction * (b - a));
 	}
-	if (isPlaying != AL_PLAYING) {
-		alSourcePlay(oalSource);
-		// Verify that it worked.
-		alGetSourcei(oalSource, AL_SOURCE_STATE, &isPlaying);
-		err = alGetError();
-		if (err || (isPlaying != AL_PLAYING)) {
-			log() << "playAudioDirectly(): FAILED TO START PLAYING " << err << flush;
-		}
+
+	if (stretching > 0) stretchedFrames++;
+	else squeezedFrames++;
+	return count;
+}
+
+
+void QAudioSinkOpenAL::playAudioDirectly(ALvoid* data, ALsizei byteSize)
+{
+	// Ensure that the OpenAL context doesn't change out from under us.
+	shared_mutex_lock lk(g_oal_mutex);
+
+	// This creates a source if we need one, return true iff it makes a new source.
+	bool	newSource = ensureValidSource();
+
+	// Now take the lock so we can trust the source.
+	unique_mutex_lock lk2(mutex);
+	if (oalSource == 0) {
+		// XXXXX: need error handling
+		log() << "playAudioDirectly():  invalid source";
+		return;
 	}
-	
-	err = alGetError();
-	if (err != AL_NO_ERROR) {
-		log() << "playAudioDirectly():  ERROR 3  code: " << err << flush;
+
+	// Reclaim buffers that are finished playing.
+	if (! newSource ) reclaimBuffers();
+
+	// Ensure that there is a free buffer.
+	if (freeCount == 0) {
+		log(1) << "playAudioDirectly(): No free buffers" ;
+		return;
 	}
-	
+
+	// Play that funky music.
+	queueBuffer(data, byteSize);
+
+	// As for playFrame(), but without adapting the depth.
+	if (!isStarted && filledCount < 2) return;
+	startPlaying();
 }
 
 // Oddity: the following returns true if it makes a source.
@@ -406,16 +644,15 @@ bool QAudioSinkOpenAL::ensureValidSource()
 
 	// Let's generate some buffers.
 	// XXXXX: need error checking... must delete source before bailing
-	queuedBuffers.clear();
-	freeBuffers.clear();
+	resetBuffers();
 
 	alGenBuffers(NUM_BUFFERS, oalBuffers);
-	for (int i = 0; i < NUM_BUFFERS; i++) freeBuffers.push_back(oalBuffers[i]);
+	for (int i = 0; i < NUM_BUFFERS; i++) freeList[freeCount++] = i;
 	err = alGetError();
 	if (err != AL_NO_ERROR) {
 		log() << "ensureValidSource():  failed to allocate buffers " << oalSource << " code: " << err ;
 		alDeleteSources(1, &oalSource);
-		freeBuffers.clear();
+		resetBuffers();
 		oalSource = 0;
 		return false;
 	}
@@ -432,7 +669,11 @@ void QAudioSinkOpenAL::printDebugInfo()
 		<< "printDebugInfo(): " << "\n\t"
 		<< "pos( " << transform[0] << "," << transform[1] << "," << transform[2] << ")    dir(" << transform[3] << "," << transform[4] << "," << transform[5] << "\n\t"
 		<< "gain: " << gain << "\n\t"
-		<< "free/queued buffers: " << freeBuffers.size() << "/" << queuedBuffers.size() << "\n\t"
+		<< "free/filled/queued buffers: " << freeCount << "/" << filledCount << "/" << sourceQueuedCount << "\n\t"
+		<< "depth: " << targetDepth << " (" << minDepth << "-" << maxDepth << (isAdaptive ? ")" : ", fixed)")
+		<< "    latency: " << latencySamples * 1000 / SAMPLING_RATE << "ms"
+		<< "    underruns: " << underruns << "    overruns: " << overruns
+		<< "    stretched/squeezed: " << stretchedFrames << "/" << squeezedFrames << "\n\t"
 		<< "refDist: " << refDist << "    maxDist: " << maxDist << "    rolloff: " << rolloff << "\n\t"
 		<< "innerAngle: " << innerAngle << "    outerAngle: " << outerAngle << "    outerGain: " << outerGain << "\n\t"
 		<< (strong.get() == NULL ? "no audio source" : "audio source: (printed separately)") ;
@@ -468,8 +709,7 @@ void QAudioSinkOpenAL::deleteOpenALResources(int verbosity)
 			log() << "deleteOpenALResources: delete buffers error: " << err << flush;
 		}
 		
-		freeBuffers.clear();
-		queuedBuffers.clear();
+		resetBuffers();
 		oalSource = 0;
 	}
 }
@@ -17,6 +17,15 @@
  *  qAudioSinkOpenAL.hpp
  *  QAudioPlugin
  *
+ *  Plays its source through an OpenAL source, queueing a buffer per tick.
+ *
+ *  How far ahead of the device it queues (its depth) adapts to how regularly
+ *  it is ticked: each underrun deepens the queue by as many frames as it ran
+ *  short, up to a maximum, and ten seconds with more than a frame to spare
+ *  throughout make it shallower again, down to a minimum.  Between those
+ *  steps, the frames are stretched or squeezed by a few samples to keep the
+ *  queue at its depth, which also takes up any drift between the ticker's
+ *  clock and the device's.
  */
 
 #ifndef __Q_AUDIO_SINK_OPENAL_HPP__
@@ -37,6 +46,11 @@
 # include <OpenAL/al.h>
 #endif
 
+/* gcc version 4.1.2 20080704 (Red Hat 4.1.2-46) blows up compiling ctype defs
+ * if sqVirtualMachine.h is included early.
+ */
+#include "sqVirtualMachine.h"
+
 namespace Qwaq {
 
 class QAudioSinkOpenAL : public Tickee
@@ -58,9 +72,13 @@ class QAudioSinkOpenAL : public Tickee
 		
 		virtual void printDebugInfo();
 		
+		virtual int genericControl(int ctlType, int ctlVal);
+		
 	protected:
-		const static int NUM_BUFFERS = 4;  // Number of OpenAL audio buffers
+		const static int NUM_BUFFERS = 16;  // Number of OpenAL audio buffers
 		const static int SAMPLING_RATE = 16000; // It's what we use.  Love it.
+		const static int STRETCH_SAMPLES = 8;  // added to or taken from a frame to adjust the depth
+		const static int SHRINK_TICKS = 500;  // without an underrun before the depth shrinks
 	
 		boost::weak_ptr<Tickee> source;
 		ALuint oalSource;
@@ -76,18 +94,57 @@ class QAudioSinkOpenAL : public Tickee
 		double outerAngle;
 		double outerGain;
 
+		// Buffers are referred to by their index in oalBuffers.  Those not in
+		// use are on the free list; the rest are filled, oldest first, and the
+		// first 'sourceQueuedCount' of those are queued to the source.  OpenAL
+		// finishes with them in the order they were queued.
 		ALuint oalBuffers[NUM_BUFFERS];
-		std::vector<ALuint> freeBuffers;
-		std::vector<ALuint> queuedBuffers;
+		int bufferSamples[NUM_BUFFERS];
+		int freeList[NUM_BUFFERS];
+		int freeCount;
+		int filled[NUM_BUFFERS];	// a ring
+		int filledHead;
+		int filledCount;
+		int sourceQueuedCount;
+		int sourceQueuedSamples;
 		bool isStarted;
 		bool isGainBakedIn;
 		
 		unsigned silentStreak;
 		
+		// Playout control (see QOpenALControl).
+		bool isAdaptive;
+		int minDepth;
+		int maxDepth;
+		int targetDepth;			// frames to have queued just after queueing one
+		int ticksSinceChange;		// of the target depth
+		int leastSpare;				// fewest samples queued before queueing a frame, since then
+		float depthError;			// smoothed, in samples
+		int stretching;				// +1 stretching frames, -1 squeezing them, 0 neither
+		short lastSample;			// of the previous frame, to stretch from
+		short stretched[FRAME_SIZE + STRETCH_SAMPLES];
+		int latencySamples;			// queued ahead of the device, as of the last frame
+		usqLong lastFrameMicroseconds;
+		
+		long underruns;
+		long overruns;
+		long stretchedFrames;
+		long squeezedFrames;
+		double latencySum;
+		long latencyCount;
+		
 		bool ensureValidSource();  // Check if there is a valid source; if not, try to create one.
 		void setInitialSourceProperties();  // Set the initial properties for the source.
 		void deleteOpenALResources(int verbosity);  // Check if we are using any sources/buffers, and if so, release them
+		void resetBuffers();
+		bool reclaimBuffers();
 		bool returnOneBuffer();
+		void queueBuffer(const ALvoid* data, ALsizei byteSize);
+		void startPlaying();
+		void playFrame(const short* frame);
+		void adaptDepth(bool underrun, int shortfall);
+		int stretchFrame(const short* frame);
+		void resetStats();
 	
 		boost::shared_mutex mutex;
 };
@@ -21,6 +21,7 @@
 
 #include "qAudioSinkSpeex.hpp"
 #include "qLogger.hpp"
+#include "qTrace.hpp"
 using namespace Qwaq;
 
 #include <boost/thread/locks.hpp>
@@ -44,6 +45,7 @@ QAudioSinkSpeex::QAudioSinkSpeex() : Tickee(), timeLogger(100) // enough for 2 s
 	isRecording = false;
 	enableDropping = true;
 	bufferedPacketCount = 0;
+	silenceResetTicks = 0;
 	
 	{ scoped_lock lk(speexMutex); initSpeexState(); }
 	log() << " ** CREATED" << flush;
@@ -60,11 +62,9 @@ QAudioSinkSpeex::~QAudioSinkSpeex()
 	{ 
 		scoped_lock lk(speexMutex); 
 		destroySpeexState(); 
-		if (isRecording) {
-			recordFile.close();
-			isRecording = false;
-		}
+		isRecording = false;
 	}
+	trace.stop();
 	log() << " ** DESTROYED" << flush;
 }
 
@@ -75,24 +75,24 @@ void QAudioSinkSpeex::getBufferFromJitterbuffer()
 	++recent_gets;
 	
 	int ret;  // Speex return value
-	void* datagramTimestamp;
+	void* datagramTimestamp = NULL;  // not answered when decoding the rest of the last packet
 	int activity, activityThreshold;
 	int dropCount = 0;
 	
 	
 	while (1) {
-		ret = speex_jitter_get(&jitter, buffer, NULL, &datagramTimestamp);
+		{
+			QTRACE_SCOPE(QTraceCodecs, "speex jitter get");
+			ret = speex_jitter_get(&jitter, buffer, NULL, &datagramTimestamp);
+		}
 		speex_decoder_ctl(jitter.dec, SPEEX_GET_ACTIVITY, &activity);
 		jitter_buffer_ctl(jitter.packets, JITTER_BUFFER_GET_AVAILABLE_COUNT, &bufferedPacketCount);
 		
 		if (ret == 2) { //extrapolation
 			++total_extrapolations;
 			++recent_extrapolations;
-			if (isRecording) {
-				recordFile << "get2-[" << get_timestamp << "-" << bufferedPacketCount << "]-640-";
-				recordBytesOnFile(buffer, 640);
-				recordFile << endl;
-			}
+			++runOfExtrapolations;
+			if (isRecording) trace.add(QJT_GET, get_timestamp, bufferedPacketCount, activity, 0, ret);
 			return;
 		}
 		
@@ -115,17 +115,12 @@ void QAudioSinkSpeex::getBufferFromJitterbuffer()
 		}
 		if (activity >= activityThreshold) {
 			// We've decided not to drop this packet.
+			runOfExtrapolations = 0;
 			if (datagramTimestamp != NULL) {
 				// Allow Squeak to keep track of how long this packet was in the JB.
 				timeLogger.add((int)datagramTimestamp);
 			}
-			if (isRecording) {
-				recordFile 
-					<< "get0-[" << get_timestamp << "-" << bufferedPacketCount << "-" << activity 
-					<< "-" << ((int)((double)(int)datagramTimestamp) / 20.0) * 320 << "]-640-";
-				recordBytesOnFile(buffer, 640);
-				recordFile << endl;
-			}
+			if (isRecording) trace.add(QJT_GET, get_timestamp, bufferedPacketCount, activity, (int)datagramTimestamp, ret);
 			return;
 		}
 		else {
@@ -134,12 +129,7 @@ void QAudioSinkSpeex::getBufferFromJitterbuffer()
 			++total_drops;
 			++recent_drops;
 			++dropCount;
-			if (isRecording) {
-				recordFile 
-					<< "drop0-[" << get_timestamp << "-" << bufferedPacketCount << "-" << activity << "]-640-";
-				recordBytesOnFile(buffer, 640);
-				recordFile << endl;
-			}
+			if (isRecording) trace.add(QJT_DROP, get_timestamp, bufferedPacketCount, activity, (int)datagramTimestamp, ret);
 		}
 	}
 }
@@ -167,14 +157,13 @@ void QAudioSinkSpeex::tick()
 	// Do this here, because we'll potentially use the variable (and possibly its value) 
 	// in several places.
 	jitter_buffer_ctl(jitter.packets, JITTER_BUFFER_GET_AVAILABLE_COUNT, &bufferedPacketCount);
+	if (isRecording) trace.add(QJT_TICK, put_timestamp, get_timestamp, bufferedPacketCount);
 	
 	if (put_timestamp < margin && !wantsReset) {
 		// We haven't buffered enough audio yet.
 		hasBuffer = false;
 		
-		if (isRecording) {
-			recordFile << "get9-[" << get_timestamp << "-" << bufferedPacketCount << "]" << endl;
-		}
+		if (isRecording) trace.add(QJT_WAIT, get_timestamp, bufferedPacketCount);
 #if ITIMER_HEARTBEAT
 		speexMutex.unlock();
 #endif
@@ -184,10 +173,8 @@ void QAudioSinkSpeex::tick()
 	if (wantsReset && !bufferedPacketCount) {
 		// We want a reset, and have finished playing out the remaining buffers
 		
-		if (isRecording) {
-			// Log before we reset the timestamps
-			recordFile << "reset2-[" << put_timestamp << "-" << get_timestamp << "]" << endl;
-		}
+		// Log before we reset the timestamps
+		if (isRecording) trace.add(QJT_RESET, put_timestamp, get_timestamp);
 	
 		destroySpeexState();
 		initSpeexState();
@@ -201,12 +188,10 @@ void QAudioSinkSpeex::tick()
 			put_timestamp += FRAME_SIZE;
 			speex_jitter_put(&jitter, bytes, byteSize, put_timestamp, (void*)(it->appTimestamp));
 			
-			// Record the incoming buffer for debugging.
+			// Record the put for debugging; the bytes were recorded when they arrived.
 			if (isRecording) {
 				jitter_buffer_ctl(jitter.packets, JITTER_BUFFER_GET_AVAILABLE_COUNT, &bufferedPacketCount);
-				recordFile << "put3-[" << put_timestamp << "-" << bufferedPacketCount << "]-" << byteSize << "-";
-				recordBytesOnFile(bytes, byteSize);
-				recordFile << endl;
+				trace.add(QJT_PUT, put_timestamp, bufferedPacketCount, it->appTimestamp, QJT_PUT_UNDEFERRED);
 			}
 			
 			free(bytes); // was malloced in tick()
@@ -224,6 +209,14 @@ void QAudioSinkSpeex::tick()
 	getBufferFromJitterbuffer();
 	hasBuffer = true;
 
+	// Nothing has come for a while, perhaps because the sender has stopped
+	// sending between utterances (see QSpeexSetDTX).  Treat it as the end of
+	// one, rather than decoding ever-quieter extrapolations until the next.
+	if (silenceResetTicks && runOfExtrapolations >= silenceResetTicks && !bufferedPacketCount && !wantsReset) {
+		wantsReset = true;
+		if (isRecording) trace.add(QJT_RESET_REQUEST, put_timestamp, get_timestamp);
+	}
+
 #if ITIMER_HEARTBEAT
 	speexMutex.unlock();
 #endif
@@ -252,6 +245,7 @@ void QAudioSinkSpeex::initSpeexState()
 	
 	put_timestamp = get_timestamp = 0;
 	wantsReset = false;
+	runOfExtrapolations = 0;
 }
 
 // Must be called from within a function that has already locked the mutex.
@@ -283,16 +277,12 @@ void QAudioSinkSpeex::pushEncodedSpeex(void* bytes, int byteSize, int appTimesta
 			deferredPuts.push_back(DeferredPut(deferred, byteSize, appTimestamp));
 			if (isRecording) {
 				jitter_buffer_ctl(jitter.packets, JITTER_BUFFER_GET_AVAILABLE_COUNT, &bufferedPacketCount);
-				recordFile << "put2-[" << put_timestamp << "-" << bufferedPacketCount << "]-" << byteSize << "-";
-				recordBytesOnFile(bytes, byteSize);
-				recordFile << endl;
+				trace.add(QJT_PUT, put_timestamp, bufferedPacketCount, appTimestamp, QJT_PUT_DEFERRED, 0, bytes, byteSize);
 			}
 		}
 		else {
 			log() << "pushEncodedSpeex(): failed to instantiate deferred packet!!" << flush;
-			if (isRecording) {
-				recordFile << "error-[failed to instantiate deferred packet]" << endl;
-			}
+			if (isRecording) trace.add(QJT_ERROR);
 		}
 		return;
 	}
@@ -308,9 +298,7 @@ void QAudioSinkSpeex::pushEncodedSpeex(void* bytes, int byteSize, int appTimesta
 	// Record the incoming buffer for debugging.
 	if (isRecording) {
 		jitter_buffer_ctl(jitter.packets, JITTER_BUFFER_GET_AVAILABLE_COUNT, &bufferedPacketCount);
-		recordFile << "put1-[" << put_timestamp << "-" << bufferedPacketCount << "]-" << byteSize << "-";
-		recordBytesOnFile(bytes, byteSize);
-		recordFile << endl;
+		trace.add(QJT_PUT, put_timestamp, bufferedPacketCount, appTimestamp, QJT_PUT_DIRECT, 0, bytes, byteSize);
 	}
 }	
 
@@ -322,35 +310,41 @@ int QAudioSinkSpeex::jitterbufferCtl(int ctlType, int ctlVal)
 	switch (ctlType) {
 		case JITTER_BUFFER_SET_MARGIN:
 			margin = ctlVal;
-			if (isRecording) recordFile << "param-margin-" << margin << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, margin);
 			break;
 		case JITTER_BUFFER_SET_DELAY_STEP:
 			delayStep = ctlVal;
-			if (isRecording) recordFile << "param-delayStep-" << delayStep << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, delayStep);
 			break;
 		case JITTER_BUFFER_SET_CONCEALMENT_SIZE:
 			concealSize = ctlVal;
-			if (isRecording) recordFile << "param-concealSize-" << concealSize << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, concealSize);
 			break;
 		case JITTER_BUFFER_SET_MAX_LATE_RATE:
 			maxLateRate = ctlVal;
-			if (isRecording) recordFile << "param-maxLateRate-" << maxLateRate << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, maxLateRate);
 			break;
 		case JITTER_BUFFER_SET_LATE_COST:
 			lateCost = ctlVal;
-			if (isRecording) recordFile << "param-lateCost-" << lateCost << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, lateCost);
 			break;
 		case QWAQ_JITTER_BUFFER_SET_ACTIVITY_THRESHOLD:
 			jitter.activity_threshold = ctlVal;
-			if (isRecording) recordFile << "param-activityThreshold-" << ctlVal << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, ctlVal);
 			return ctlVal;
 		case QWAQ_JITTER_BUFFER_GET_ACTIVITY_THRESHOLD:
 			return jitter.activity_threshold;
 		case QWAQ_JITTER_BUFFER_SET_ENABLE_DROPPING:
 			enableDropping = (ctlVal == 0) ? false : true;
 			log() << "set ENABLE_DROPPING to: " << enableDropping << flush;
-			if (isRecording) recordFile << "param-enableDropping-" << enableDropping << endl;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, enableDropping);
 			return ctlVal;
+		case QWAQ_JITTER_BUFFER_SET_SILENCE_RESET:
+			silenceResetTicks = (ctlVal < 0) ? 0 : ctlVal;
+			if (isRecording) trace.add(QJT_PARAM, ctlType, silenceResetTicks);
+			return silenceResetTicks;
+		case QWAQ_JITTER_BUFFER_GET_SILENCE_RESET:
+			return silenceResetTicks;
 	}
 	
 	// Avoid messing with the stack variable if the command is a 'get'
@@ -369,9 +363,7 @@ void QAudioSinkSpeex::resetTimestamps()
 	// buffered frames (see tick() ).
 	wantsReset = true;
 	
-	if (isRecording) {
-		recordFile << "reset1-[" << put_timestamp << "-" << get_timestamp << "]" << endl;
-	}
+	if (isRecording) trace.add(QJT_RESET_REQUEST, put_timestamp, get_timestamp);
 }
 
 
@@ -423,49 +415,29 @@ void QAudioSinkSpeex::startDebugRecording(char* filePath)
 {
 	if (isRecording) stopDebugRecording();
 	
-	log() << "starting debug recording: " << filePath << flush;
+	log() << "starting debug recording: " << (filePath ? filePath : "(in memory)") << flush;
 
 	scoped_lock lk(speexMutex);
-	recordFile.open(filePath);
-	if (recordFile.fail()) return;
+	if (!trace.start(filePath, FRAME_SIZE, SAMPLING_RATE)) return;
 	isRecording = true;
-	/* 
-		version 1.1:
-			- added 'activityThreshold' parameter
-		version 1.2:
-			- added 'enableDropping' parameter
-	*/
-	recordFile << "version-1.2" << endl;
-	recordFile << "param-margin-" << margin << endl;
-	recordFile << "param-delayStep-" << delayStep << endl;
-	recordFile << "param-concealSize-" << concealSize << endl;
-	recordFile << "param-maxLateRate-" << maxLateRate << endl;
-	recordFile << "param-lateCost-" << lateCost << endl;
-	recordFile << "param-activityThreshold-" << jitter.activity_threshold << endl;
-	recordFile << "param-enableDropping-" << enableDropping << endl;
+	// Begin with the current settings, so that replay starts out as we did.
+	trace.add(QJT_PARAM, JITTER_BUFFER_SET_MARGIN, margin);
+	trace.add(QJT_PARAM, JITTER_BUFFER_SET_DELAY_STEP, delayStep);
+	trace.add(QJT_PARAM, JITTER_BUFFER_SET_CONCEALMENT_SIZE, concealSize);
+	trace.add(QJT_PARAM, JITTER_BUFFER_SET_MAX_LATE_RATE, maxLateRate);
+	trace.add(QJT_PARAM, JITTER_BUFFER_SET_LATE_COST, lateCost);
+	trace.add(QJT_PARAM, QWAQ_JITTER_BUFFER_SET_ACTIVITY_THRESHOLD, jitter.activity_threshold);
+	trace.add(QJT_PARAM, QWAQ_JITTER_BUFFER_SET_ENABLE_DROPPING, enableDropping);
+	trace.add(QJT_PARAM, QWAQ_JITTER_BUFFER_SET_SILENCE_RESET, silenceResetTicks);
 }
 
 void QAudioSinkSpeex::stopDebugRecording()
 {
 	log() << "stopping debug recording" << flush;
 
-	scoped_lock lk(speexMutex);
-	if (isRecording) recordFile.close();
-	isRecording = false;
-}
-
-// Utility method to record bytes as ASCII-hex.  Ugly but it works.
-void QAudioSinkSpeex::recordBytesOnFile(void* bytes, int byteSize)
-{
-	for (int i = 0; i < byteSize; i++) {
-		unsigned char byte = ((unsigned char*)bytes)[i];
-		unsigned char highNibble = byte >> 4;
-		unsigned char lowNibble = byte & 0x0f;
-		if (highNibble < 10) { recordFile << (unsigned char)('0' + highNibble); }
-		else { recordFile << (unsigned char)('a' + (highNibble-10)); }
-		if (lowNibble < 10) { recordFile << (unsigned char)('0' + lowNibble); }
-		else { recordFile << (unsigned char)('a' + (lowNibble-10)); }
-	}
+	{ scoped_lock lk(speexMutex); isRecording = false; }
+	// Nothing adds to the trace now, so it can be written out without the lock.
+	trace.stop();
 }
 
 // For now, only Speex-sinks support this.
@@ -30,8 +30,8 @@
 #include "QAudioPlugin.h"
 #include "qTickee.hpp"
 #include "qEventTimeLogger.hpp"
+#include "qJitterTrace.hpp"
 
-#include <fstream>
 #include <vector>
 
 namespace Qwaq {
@@ -47,6 +47,11 @@ typedef std::vector<DeferredPut> DeferredPutVect;
 #define QWAQ_JITTER_BUFFER_GET_ACTIVITY_THRESHOLD 101
 #define QWAQ_JITTER_BUFFER_SET_ACTIVITY_THRESHOLD 102
 #define QWAQ_JITTER_BUFFER_SET_ENABLE_DROPPING 103
+// Ticks of extrapolating with nothing buffered before resetting, as at the end
+// of an utterance; 0, the default, never resets.  Set it (10 is about right)
+// only when the sender uses DTX (see QSpeexSetDTX) and so stops between them.
+#define QWAQ_JITTER_BUFFER_SET_SILENCE_RESET 104
+#define QWAQ_JITTER_BUFFER_GET_SILENCE_RESET 105
 
 class QAudioSinkSpeex : public Tickee
 {
@@ -56,6 +61,7 @@ class QAudioSinkSpeex : public Tickee
 		
 		virtual void tick();
 		virtual unsigned tickPriority() { return 10; }	// top priority
+		virtual bool tickInParallel() { return true; }	// decodes only what is pushed to it
 		virtual void addSource(shared_tickee src) {} // meaningless for Speex sink
 		virtual void removeSource(shared_tickee src) {} // meaningless for Speex sink
 		
@@ -70,10 +76,12 @@ class QAudioSinkSpeex : public Tickee
 
 		virtual void printDebugInfo();
 
-		// Log for debugging... capture EVERYTHING
+		// Log for debugging... capture EVERYTHING (see qJitterTrace.hpp).
+		// With a NULL filePath, the trace is kept for readDebugRecording().
 		void startDebugRecording(char* filePath);
 		void stopDebugRecording();
 		bool isDebugRecording() { return isRecording; }
+		bool readDebugRecording(QJitterTraceRecord& record, char* payload) { return trace.next(record, payload); }
 		
 		virtual sqInt getEventTimings();
 						
@@ -111,6 +119,9 @@ class QAudioSinkSpeex : public Tickee
 		bool wantsReset;
 		// When true, we will drop packets if we start to buffer too many.
 		bool enableDropping;
+		// See QWAQ_JITTER_BUFFER_SET_SILENCE_RESET.
+		int silenceResetTicks;
+		int runOfExtrapolations;
 		// Keep track of how many packets are buffered in the Speex JB.
 		int bufferedPacketCount;
 		
@@ -124,10 +135,8 @@ class QAudioSinkSpeex : public Tickee
 		int runOfPuts;
 		
 		// For supporting debug-logging... capture EVERYTHING
-		std::ofstream recordFile;
+		QJitterTrace trace;
 		bool isRecording;
-		// Utility method to record bytes as ASCII-hex
-		void recordBytesOnFile(void* bytes, int byteSize);
 		
 		void getBufferFromJitterbuffer();
 		
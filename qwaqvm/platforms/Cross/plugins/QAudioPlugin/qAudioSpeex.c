@@ -17,17 +17,33 @@
  *  qAudioSpeex.c
  *  QAudioPlugin
  *
+ *  With VAD on, each frame is first checked for speech: frames quieter than
+ *  the VAD level aren't, and louder ones are if the Speex preprocessor thinks
+ *  them likely enough to be (less likely once speech has started).  Its own
+ *  VAD isn't used: it is a stop-gap in this release, and steady noise gets
+ *  past its thresholds.  Speech carries on for a few frames of hangover after
+ *  that, so that the ends of words aren't clipped.  With DTX on as well, a
+ *  buffer with no speech in it isn't encoded at all, and qSpeexEncode()
+ *  answers 0 bytes; a receiving QAudioSinkSpeex with a silence reset set
+ *  resets once it has run dry, and waits for the next talk-spurt.
  */
 
 #include "qAudioSpeex.h"
+#include "qTrace.h"
 #include <speex/speex.h>
+#include <speex/speex_preprocess.h>
 #include <speexclient/speex_jitter_buffer.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #define SAMPLING_RATE 16000
 #define FRAME_SIZE 320
+#define DEFAULT_HANGOVER 10
+#define DEFAULT_VAD_LEVEL 30
+#define SPEECH_PROB_START 90		/* percent; noise alone is 30-40, speech 95 or more */
+#define SPEECH_PROB_CONTINUE 80
 
 typedef struct QSpeexCodec
 {
@@ -41,6 +57,16 @@ typedef struct QSpeexCodec
 	
 	SpeexJitter jitter;
 	int fake_timestamp;
+	
+	SpeexPreprocessState* preprocess;  /* created when VAD is turned on */
+	int vad;
+	int dtx;
+	int hangover;
+	int vadLevel;
+	int hangoverLeft;			/* frames of speech still to come */
+	int wasSpeech;				/* the last frame was speech, before hangover */
+	int activity;				/* see QSpeexGetActivity */
+	int speechProbability;
 } QSpeexCodec;
 
 
@@ -56,6 +82,8 @@ void qSpeexDestroyHandle(QSpeexCodecPtr handle)
 	
 	speex_jitter_destroy(&handle->jitter);
 	
+	if (handle->preprocess) speex_preprocess_state_destroy(handle->preprocess);
+	
 	free(handle);
 }
 
@@ -78,23 +106,76 @@ QSpeexCodecPtr qSpeexCreateHandle(void)
 	// The sampling rate isn't used, but we add it since the example code does (speexclient.c)
 	speex_jitter_init(&handle->jitter, handle->decState, SAMPLING_RATE);
 	handle->fake_timestamp = 0;
+	
+	handle->preprocess = NULL;
+	handle->vad = handle->dtx = 0;
+	handle->hangover = DEFAULT_HANGOVER;
+	handle->vadLevel = DEFAULT_VAD_LEVEL;
+	handle->hangoverLeft = 0;
+	handle->wasSpeech = 0;
+	handle->activity = 0;
+	handle->speechProbability = 0;
 	return handle;
 }
 
 
+/* Answer non-zero if the frame is speech, or follows closely after it. */
+static int isSpeech(QSpeexCodecPtr handle, short* frame)
+{
+	short scratch[FRAME_SIZE];
+	double power = 0;
+	int i, speech = 0;
+	
+	for (i=0; i<handle->frameSize; i++) power += (double)frame[i] * frame[i];
+	power /= handle->frameSize;
+	
+	/* Too quiet to be worth asking the preprocessor about. */
+	if (power >= 1 && 10 * log10(power) >= handle->vadLevel) {
+		/* The preprocessor works in place, and the frame is still to be encoded. */
+		memcpy(scratch, frame, handle->frameSize * sizeof(short));
+		speex_preprocess_run(handle->preprocess, scratch);
+		speex_preprocess_ctl(handle->preprocess, SPEEX_PREPROCESS_GET_PROB, &handle->speechProbability);
+		speech = handle->speechProbability >= (handle->wasSpeech ? SPEECH_PROB_CONTINUE : SPEECH_PROB_START);
+	}
+	else handle->speechProbability = 0;
+	
+	handle->wasSpeech = speech;
+	if (speech) handle->hangoverLeft = handle->hangover;
+	else if (handle->hangoverLeft > 0) {
+		handle->hangoverLeft--;
+		speech = 1;
+	}
+	return speech;
+}
+
+
 int qSpeexEncode(QSpeexCodecPtr handle, void* samples, int sampleSize)
 {
-	int offset;
+	int offset, frame;
 
 	speex_bits_reset(&handle->encBits);
+	
+	if (handle->vad) {
+		QTRACE_BEGIN(QTraceCodecs, "speex vad");
+		handle->activity = 0;
+		for(offset=0, frame=0; offset<sampleSize; offset+=handle->frameSize, frame++) {
+			if (isSpeech(handle, ((short*)samples) + offset) && frame < 30)
+				handle->activity |= 1 << frame;
+		}
+		QTRACE_END(QTraceCodecs, "speex vad");
+		/* Nothing worth sending. */
+		if (handle->dtx && !handle->activity) return 0;
+	}
 
 	/** Floods the console **/
 	/**   fprintf(stderr, "encoding bytes: \n");	**/
+	QTRACE_BEGIN(QTraceCodecs, "speex encode");
 	for(offset=0; offset<sampleSize; offset+=handle->frameSize) {
 		short* ptr = ((short*)samples) + offset;
 		speex_encode_int(handle->encState, ptr, &handle->encBits);
 	}
 	speex_bits_insert_terminator(&handle->encBits);
+	QTRACE_END(QTraceCodecs, "speex encode");
 	return speex_bits_nbytes(&handle->encBits);
 }
 
@@ -105,7 +186,7 @@ void qSpeexEncodeRead(QSpeexCodecPtr handle, void* outputBytes, int outputSize)
 }
 
 
-int qSpeexDecode(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* outputSamples, int outputSize)
+static int decodeFrames(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* outputSamples, int outputSize)
 {
 	int offset, remaining;
 	short *out = (short*)outputSamples;
@@ -138,6 +219,68 @@ int qSpeexDecode(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* o
 }
 
 
+int qSpeexDecode(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* outputSamples, int outputSize)
+{
+	int result;
+	
+	QTRACE_BEGIN(QTraceCodecs, "speex decode");
+	result = decodeFrames(handle, inputBytes, inputSize, outputSamples, outputSize);
+	QTRACE_END(QTraceCodecs, "speex decode");
+	return result;
+}
+
+
+int qSpeexControl(QSpeexCodecPtr handle, int ctlType, int ctlValue)
+{
+	int on;
+
+	switch (ctlType) {
+		case QSpeexSetVAD:
+		case QSpeexSetDTX:
+			on = ctlValue != 0;
+			if (on && !handle->preprocess) {
+				handle->preprocess = speex_preprocess_state_init(handle->frameSize, SAMPLING_RATE);
+				if (!handle->preprocess) return -1;
+				/* Only the speech probability is wanted; the frames themselves are left alone. */
+				ctlValue = 0;
+				speex_preprocess_ctl(handle->preprocess, SPEEX_PREPROCESS_SET_DENOISE, &ctlValue);
+				speex_preprocess_ctl(handle->preprocess, SPEEX_PREPROCESS_SET_AGC, &ctlValue);
+			}
+			if (ctlType == QSpeexSetDTX) {
+				handle->dtx = on;
+				if (on) handle->vad = 1;
+			}
+			else {
+				handle->vad = on;
+				if (!on) handle->dtx = 0;
+			}
+			handle->activity = 0;
+			return 0;
+		case QSpeexGetVAD:
+			return handle->vad;
+		case QSpeexGetDTX:
+			return handle->dtx;
+		case QSpeexSetHangover:
+			if (ctlValue < 0) return -1;
+			handle->hangover = ctlValue;
+			return 0;
+		case QSpeexGetHangover:
+			return handle->hangover;
+		case QSpeexSetVADLevel:
+			if (ctlValue < 0 || ctlValue > 90) return -1;
+			handle->vadLevel = ctlValue;
+			return 0;
+		case QSpeexGetVADLevel:
+			return handle->vadLevel;
+		case QSpeexGetActivity:
+			return handle->activity;
+		case QSpeexGetSpeechProbability:
+			return handle->speechProbability;
+	}
+	return -1;
+}
+
+
 int qSpeexDecodeToTestJB(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* outputSamples, int outputSize)
 {
 	short *out = (short*)outputSamples;
@@ -22,14 +22,40 @@
 #ifndef __Q_AUDIO_SPEEX_H__
 #define __Q_AUDIO_SPEEX_H__
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 struct QSpeexCodec;
 typedef struct QSpeexCodec* QSpeexCodecPtr;
 
+/* qSpeexControl() types.  Sets answer 0, or -1 for a bad value; gets answer
+ * the value.  Levels are in dB above an RMS of one: silence is 0, a full-scale
+ * sine wave 87 and a full-scale square wave 90. */
+typedef enum {
+	QSpeexSetVAD = 1,				/* non-zero: decide which frames are speech */
+	QSpeexGetVAD,
+	QSpeexSetDTX,					/* non-zero: encode nothing unless there is speech (turns on VAD) */
+	QSpeexGetDTX,
+	QSpeexSetHangover,				/* frames still counted as speech after it stops (default 10) */
+	QSpeexGetHangover,
+	QSpeexSetVADLevel,				/* frames quieter than this are never speech (default 30) */
+	QSpeexGetVADLevel,
+	QSpeexGetActivity,				/* with VAD on, bit n set if frame n of the last qSpeexEncode() was speech;
+									   only the first 30 frames, so that it fits a SmallInteger */
+	QSpeexGetSpeechProbability		/* of the last frame, 0-100, from the Speex preprocessor */
+} QSpeexControl;
+
 void qSpeexDestroyHandle(QSpeexCodecPtr handle);
 QSpeexCodecPtr qSpeexCreateHandle(void);
 int qSpeexEncode(QSpeexCodecPtr handle, void* buffer, int bufferSize);
 void qSpeexEncodeRead(QSpeexCodecPtr handle, void* outputBytes, int outputSize);
 int qSpeexDecode(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* outputSamples, int outputSize);
 int qSpeexDecodeToTestJB(QSpeexCodecPtr handle, void* inputBytes, int inputSize, void* outputSamples, int outputSize);
+int qSpeexControl(QSpeexCodecPtr handle, int ctlType, int ctlValue);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* #define __Q_AUDIO_SPEEX_H__ */
@@ -0,0 +1,266 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qJitterTrace.cpp
+ *  QAudioPlugin
+ *
+ */
+
+#include "qJitterTrace.hpp"
+using namespace Qwaq;
+
+#include <string.h>
+#include <boost/bind.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#define qTraceFence() MemoryBarrier()
+#else
+#define qTraceFence() __sync_synchronize()
+#endif
+
+extern "C" { extern struct VirtualMachine* interpreterProxy; }
+
+// 256K; at 50 ticks a second and a put per tick the ring holds at least
+// 20 seconds, and it is emptied ten times a second.
+const unsigned RING_SIZE = 8192;
+const int FLUSH_INTERVAL_MSECS = 100;
+
+static unsigned payloadRecords(int payloadSize)
+{
+	return (payloadSize + sizeof(QJitterTraceRecord) - 1) / sizeof(QJitterTraceRecord);
+}
+
+
+QJitterTrace::QJitterTrace()
+{
+	ring = NULL;
+	ringSize = RING_SIZE;
+	writeCount = readCount = lost = 0;
+	flusher = NULL;
+	stopping = false;
+}
+
+
+QJitterTrace::~QJitterTrace()
+{
+	stop();
+}
+
+
+bool QJitterTrace::start(const char* filePath, int frameSize, int samplingRate)
+{
+	stop();
+	ring = (QJitterTraceRecord*) malloc(ringSize * sizeof(QJitterTraceRecord));
+	if (!ring) return false;
+	writeCount = readCount = lost = 0;
+	if (!filePath) return true;
+
+	file.open(filePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (file.fail()) {
+		file.clear();
+		free(ring);
+		ring = NULL;
+		return false;
+	}
+	QJitterTraceFileHeader hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, "QJTR", 4);
+	hdr.version = QJT_VERSION;
+	hdr.recordSize = sizeof(QJitterTraceRecord);
+	hdr.frameSize = frameSize;
+	hdr.samplingRate = samplingRate;
+	file.write((char*)&hdr, sizeof(hdr));
+
+	stopping = false;
+	flusher = new boost::thread(boost::bind(&QJitterTrace::flushLoop, this));
+	return true;
+}
+
+
+void QJitterTrace::stop()
+{
+	if (flusher) {
+		stopping = true;
+		flusher->join();
+		delete flusher;
+		flusher = NULL;
+		file.close();
+	}
+	if (ring) {
+		free(ring);
+		ring = NULL;
+	}
+}
+
+
+void QJitterTrace::add(int kind, int v0, int v1, int v2, int v3, int v4, const void* payload, int payloadSize)
+{
+	if (!ring) return;
+	if (!payload || payloadSize < 0) payloadSize = 0;
+	if (payloadSize > QJT_MAX_PAYLOAD) payloadSize = QJT_MAX_PAYLOAD;
+
+	unsigned count = 1 + payloadRecords(payloadSize);
+	unsigned w = writeCount;
+	qTraceFence();  // see the reader's latest readCount
+	unsigned room = ringSize - (w - readCount);
+	usqLong now = interpreterProxy->utcMicroseconds();
+
+	// Own up to earlier losses before adding anything else.
+	if (lost) {
+		if (room < count + 1) {
+			lost += count;
+			return;
+		}
+		QJitterTraceRecord* rec = &ring[w++ & (ringSize - 1)];
+		memset(rec, 0, sizeof(*rec));
+		rec->microseconds = now;
+		rec->kind = QJT_LOST;
+		rec->values[0] = lost;
+		lost = 0;
+	}
+	else if (room < count) {
+		lost += count;
+		return;
+	}
+
+	QJitterTraceRecord* rec = &ring[w++ & (ringSize - 1)];
+	rec->microseconds = now;
+	rec->kind = kind;
+	rec->reserved = 0;
+	rec->payloadSize = payloadSize;
+	rec->values[0] = v0;
+	rec->values[1] = v1;
+	rec->values[2] = v2;
+	rec->values[3] = v3;
+	rec->values[4] = v4;
+	for (int offset = 0; offset < payloadSize; offset += sizeof(QJitterTraceRecord)) {
+		int size = payloadSize - offset;
+		if (size > (int)sizeof(QJitterTraceRecord)) size = sizeof(QJitterTraceRecord);
+		memcpy(&ring[w++ & (ringSize - 1)], (char*)payload + offset, size);
+	}
+
+	qTraceFence();  // the records must be complete before the reader sees them
+	writeCount = w;
+}
+
+
+bool QJitterTrace::next(QJitterTraceRecord& record, char* payload)
+{
+	if (!ring) return false;
+	unsigned r = readCount;
+	if (writeCount == r) return false;
+	qTraceFence();  // see the records that writeCount covers
+
+	record = ring[r++ & (ringSize - 1)];
+	for (int offset = 0; offset < record.payloadSize; offset += sizeof(QJitterTraceRecord)) {
+		int size = record.payloadSize - offset;
+		if (size > (int)sizeof(QJitterTraceRecord)) size = sizeof(QJitterTraceRecord);
+		memcpy(payload + offset, &ring[r++ & (ringSize - 1)], size);
+	}
+
+	qTraceFence();  // finish reading before the writer may reuse the records
+	readCount = r;
+	return true;
+}
+
+
+void QJitterTrace::flushLoop()
+{
+	while (!stopping) {
+		flush();
+		boost::this_thread::sleep(boost::posix_time::milliseconds(FLUSH_INTERVAL_MSECS));
+	}
+	flush();
+}
+
+
+// Append everything in the ring to the file.  Payload records are written
+// as they are, so the file is simply a copy of the ring's contents.
+void QJitterTrace::flush()
+{
+	unsigned w = writeCount;
+	unsigned r = readCount;
+	qTraceFence();
+	while (r != w) {
+		unsigned first = r & (ringSize - 1);
+		unsigned count = w - r;
+		if (count > ringSize - first) count = ringSize - first;
+		file.write((char*)&ring[first], count * sizeof(QJitterTraceRecord));
+		r += count;
+	}
+	qTraceFence();
+	readCount = r;
+	file.flush();
+}
+
+
+QJitterTraceReader::QJitterTraceReader()
+{
+	memset(&header, 0, sizeof(header));
+}
+
+
+QJitterTraceReader::~QJitterTraceReader()
+{
+	close();
+}
+
+
+bool QJitterTraceReader::open(const char* filePath)
+{
+	close();
+	file.open(filePath, std::ios::in | std::ios::binary);
+	if (file.fail()) {
+		file.clear();
+		return false;
+	}
+	file.read((char*)&header, sizeof(header));
+	if (file.gcount() != sizeof(header)
+			|| memcmp(header.magic, "QJTR", 4) != 0
+			|| header.version > QJT_VERSION
+			|| header.recordSize != sizeof(QJitterTraceRecord)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+void QJitterTraceReader::close()
+{
+	if (file.is_open()) file.close();
+	file.clear();
+}
+
+
+bool QJitterTraceReader::next(QJitterTraceRecord& record, char* payload)
+{
+	if (!file.is_open()) return false;
+	file.read((char*)&record, sizeof(record));
+	if (file.gcount() != sizeof(record)) return false;
+	if (record.payloadSize > QJT_MAX_PAYLOAD) return false;  // not written by QJitterTrace
+
+	QJitterTraceRecord chunk;
+	for (int offset = 0; offset < record.payloadSize; offset += sizeof(chunk)) {
+		file.read((char*)&chunk, sizeof(chunk));
+		if (file.gcount() != sizeof(chunk)) return false;
+		int size = record.payloadSize - offset;
+		if (size > (int)sizeof(chunk)) size = sizeof(chunk);
+		memcpy(payload + offset, &chunk, size);
+	}
+	return true;
+}
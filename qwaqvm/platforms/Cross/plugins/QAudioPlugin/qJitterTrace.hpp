@@ -0,0 +1,154 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qJitterTrace.hpp
+ *  QAudioPlugin
+ *
+ *  Binary trace of the puts, gets and drops of a QAudioSinkSpeex, for replay
+ *  through the jitter-buffer with other settings (see QJitterReplay).
+ *
+ *  Records are added by the sink while it holds its mutex, so there is only
+ *  ever one writer.  They go into a ring that is emptied without locking, by
+ *  a background thread that appends them to the trace file, or by next() if
+ *  the trace was started without a file.  When the ring is full, records are
+ *  counted and discarded rather than holding up audio, and the count is
+ *  written as a QJT_LOST record once there is room again.
+ *
+ *  A trace file is a QJitterTraceFileHeader followed by records.  A record
+ *  with a payload is followed by the payload, padded out to whole records.
+ */
+
+#ifndef __Q_JITTER_TRACE_HPP__
+#define __Q_JITTER_TRACE_HPP__
+
+#include <fstream>
+#include <boost/thread/thread.hpp>
+
+/* gcc version 4.1.2 20080704 (Red Hat 4.1.2-46) blows up compiling ctype defs
+ * if sqVirtualMachine.h is included early.
+ */
+#include "sqVirtualMachine.h"
+
+namespace Qwaq
+{
+
+// Record kinds and their values.  These are written to trace files, so never
+// renumber them; only add new ones.
+enum QJitterTraceKind
+{
+	QJT_PARAM = 1,			// ctlType, value (as passed to jitterbufferCtl())
+	QJT_PUT = 2,			// put_timestamp, bufferedPacketCount, appTimestamp, how, plus payload
+	QJT_TICK = 3,			// put_timestamp, get_timestamp, bufferedPacketCount
+	QJT_WAIT = 4,			// get_timestamp, bufferedPacketCount (too little buffered to play yet)
+	QJT_GET = 5,			// get_timestamp, bufferedPacketCount, activity, appTimestamp, speex_jitter_get() result
+	QJT_DROP = 6,			// get_timestamp, bufferedPacketCount, activity, appTimestamp, speex_jitter_get() result
+	QJT_RESET_REQUEST = 7,	// put_timestamp, get_timestamp
+	QJT_RESET = 8,			// put_timestamp, get_timestamp
+	QJT_ERROR = 9,			// none
+	QJT_LOST = 10			// number of records discarded because the ring was full
+};
+
+// How a QJT_PUT came about.  Deferred puts carry the payload when they
+// arrive; the later put into the jitter-buffer has none.
+enum QJitterTracePut
+{
+	QJT_PUT_DIRECT = 1,
+	QJT_PUT_DEFERRED = 2,	// arrived while waiting to reset
+	QJT_PUT_UNDEFERRED = 3	// put into the jitter-buffer after the reset
+};
+
+const int QJT_VERSION = 1;
+const int QJT_MAX_PAYLOAD = 2048;  // as much as speex_jitter_get() will take
+
+#pragma pack(push, 1)
+struct QJitterTraceRecord
+{
+	usqLong microseconds;		// interpreterProxy->utcMicroseconds()
+	unsigned char kind;
+	unsigned char reserved;
+	unsigned short payloadSize;
+	int values[5];
+};
+struct QJitterTraceFileHeader
+{
+	char magic[4];				// "QJTR"
+	int version;
+	int recordSize;
+	int frameSize;				// samples per packet
+	int samplingRate;
+	int res1, res2, res3;		// reserved
+};
+#pragma pack(pop)
+
+class QJitterTrace
+{
+	public:
+		QJitterTrace();
+		~QJitterTrace();
+
+		// Start tracing into the file, or, if filePath is NULL, into memory
+		// for next() to read.  Answer false if the file can't be written.
+		bool start(const char* filePath, int frameSize, int samplingRate);
+		// Stop tracing, writing out any records still in the ring.
+		void stop();
+
+		// Writer side.  Calls must not overlap.
+		void add(int kind, int v0 = 0, int v1 = 0, int v2 = 0, int v3 = 0, int v4 = 0,
+				const void* payload = NULL, int payloadSize = 0);
+
+		// Reader side, for traces started without a file.  Answer the next
+		// record and copy its payload (at most QJT_MAX_PAYLOAD bytes), or
+		// answer false if there is none yet.
+		bool next(QJitterTraceRecord& record, char* payload);
+
+	protected:
+		QJitterTraceRecord* ring;
+		unsigned ringSize;					// records; a power of two
+		volatile unsigned writeCount;		// records ever added
+		volatile unsigned readCount;		// records ever removed
+		unsigned lost;
+
+		std::ofstream file;
+		boost::thread* flusher;
+		volatile bool stopping;
+
+		void flushLoop();
+		void flush();
+};
+
+// Reads back what QJitterTrace wrote to a file.
+class QJitterTraceReader
+{
+	public:
+		QJitterTraceReader();
+		~QJitterTraceReader();
+
+		// Answer false if the file can't be read or isn't a trace.
+		bool open(const char* filePath);
+		void close();
+
+		// Answer the next record and copy its payload, or answer false at the end.
+		bool next(QJitterTraceRecord& record, char* payload);
+
+		QJitterTraceFileHeader header;
+
+	protected:
+		std::ifstream file;
+};
+
+}; // namespace Qwaq
+
+#endif // #ifndef __Q_JITTER_TRACE_HPP__
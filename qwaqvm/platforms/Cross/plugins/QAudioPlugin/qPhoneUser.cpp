@@ -34,9 +34,7 @@ unsigned qDestroyPhoneInterfaceIAX(unsigned handle) { return 1; }
 
 using namespace Qwaq;
 
-boost::mutex PhoneUser::s_Mutex;
-unsigned PhoneUser::s_Key = 0;
-PhoneUser::map_type PhoneUser::s_Map;
+PhoneUser::table_type PhoneUser::s_Table;
 
 
 extern "C" {
@@ -45,14 +43,16 @@ extern int isIaxInitialized;  // defined in a C file
 
 // XXXXX: SOOOOOPER-HACK!!!!  This mofo assumes that the PhoneUser that we want 
 // to handle the event (i.e. pass it back on its feedback-channel) exists and
-// has key==1.
+// is the one in iaxUserKey: the first created while no other was registered
+// (this used to be whichever had key==1).
+static unsigned iaxUserKey = 0;
 // A note on return values... iaxclient expects <0 to mean error, ==0 means fall
 // through to default event handling (currently no-op except for text events), and
 // and >0 to mean sucessfully handled event.  I learnied this from the extensive
 // documentation known as "iaxclient_lib.c".  We pretend to always be successful.
 int phoneUserIAXCallback(iaxc_event e) 
 {
-	PhoneUser::ptr_type p = PhoneUser::withKey(1);
+	PhoneUser::ptr_type p = PhoneUser::withKey(iaxUserKey);
 	if (!p.get()) {
 		qLog() << "phoneUserIAXCallback(): could not find PhoneUser to handle IAX event" << flush;
 		return 1;
@@ -63,7 +63,7 @@ int phoneUserIAXCallback(iaxc_event e)
 // XXXXX: also a hack
 int phoneUserGSMAudioCallback(unsigned char* data, int datalen)
 {
-	PhoneUser::ptr_type p = PhoneUser::withKey(1);
+	PhoneUser::ptr_type p = PhoneUser::withKey(iaxUserKey);
 	if (!p.get()) {
 		qLog() << "phoneUserGSMAudioCallback(): could not find PhoneUser to handle audio event" << flush;
 		return 1;
@@ -120,7 +120,14 @@ unsigned qCreatePhoneUser(char* username, char* password, char* hostname, void*
 {
 	FeedbackChannel* channel = *((FeedbackChannel**)feedbackChannelHandle);
 
-	PhoneUser *user = new PhoneUser(username, password, hostname, channel);
+	PhoneUser *user;
+	try {
+		user = new PhoneUser(username, password, hostname, channel);
+	}
+	catch (PhoneUser::TableFull) {
+		qLog() << "qCreatePhoneUser(): no free phone user keys" << flush;
+		return 0;
+	}
 	if (!user) {
 		qLog() << "Failed to create PhoneUser (" << 
 			username << ", " <<
@@ -129,6 +136,7 @@ unsigned qCreatePhoneUser(char* username, char* password, char* hostname, void*
 		return 0;
 	}
 
+	if (!PhoneUser::withKey(iaxUserKey).get()) iaxUserKey = user->key();
 	return user->key();
 }
 
@@ -28,6 +28,7 @@ using std::string;
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread/locks.hpp>
+#include "qHandleTable.hpp"
 using boost::shared_ptr;
 typedef boost::mutex::scoped_lock scoped_lock;
 
@@ -56,6 +56,7 @@ int qShutdownModule(void)
 {
 	qLog() << "SHUTDOWN QAudioPlugin" << flush;
 	qTickerStop();
+	qTickerSetWorkerThreads(1);	// stop its workers too
 	Qwaq::Tickee::releaseAll();
 #if !EXCLUDE_IAX
 	qIaxShutdown();
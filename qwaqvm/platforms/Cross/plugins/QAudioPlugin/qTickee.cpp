@@ -22,6 +22,7 @@
 #include "qTickee.hpp"
 #include "qTicker.hpp"
 #include "qLogger.hpp"
+#include "QAudioPlugin.h"
 
 #include "sqVirtualMachine.h"
 
@@ -30,12 +31,13 @@ using namespace Qwaq;
 extern Ticker g_Ticker;
 extern "C" { extern struct VirtualMachine* interpreterProxy; }
 
-boost::mutex Tickee::s_Mutex;
-unsigned Tickee::s_Key = 0;
-Tickee::map_type Tickee::s_Map;
+Tickee::table_type Tickee::s_Table;
 
 Tickee::Tickee() : className("Tickee")
 {
+	timedTicks = 0;
+	tickNanoseconds = maxTickNanoseconds = 0;
+
 	// XXXXX: Debugging: allocate some extra space with a known 
 	// bit-pattern on each side of the buffer.  
 /*
@@ -69,6 +71,7 @@ Tickee::~Tickee()
 
 std::ostream& Tickee::log(int verbosity)
 {
+	if (!qLogEnabled(verbosity)) return qLog(verbosity);
 	return qLog(verbosity) << className << "[" << key() << "]::";
 }
 
@@ -79,3 +82,31 @@ sqInt Tickee::getEventTimings()
 	interpreterProxy->primitiveFailFor(PrimErrUnsupported);
 	return 0;
 }
+
+
+void Tickee::noteTickTime(usqLong nanoseconds)
+{
+	scoped_lock lk(timingMutex);
+	timedTicks++;
+	tickNanoseconds += nanoseconds;
+	if (nanoseconds > maxTickNanoseconds) maxTickNanoseconds = nanoseconds;
+}
+
+
+int Tickee::genericControl(int ctlType, int ctlVal)
+{
+	scoped_lock lk(timingMutex);
+	switch (ctlType) {
+		case QTickeeGetTickCount:
+			return timedTicks;
+		case QTickeeGetMeanTickMicroseconds:
+			return timedTicks ? (int)(tickNanoseconds / timedTicks / 1000) : 0;
+		case QTickeeGetMaxTickMicroseconds:
+			return (int)(maxTickNanoseconds / 1000);
+		case QTickeeResetTickTimes:
+			timedTicks = 0;
+			tickNanoseconds = maxTickNanoseconds = 0;
+			return 0;
+	}
+	return 0;
+}
@@ -27,11 +27,13 @@
 #include <boost/shared_ptr.hpp>
 #include <boost/weak_ptr.hpp>
 #include <boost/thread/locks.hpp>
+#include "qHandleTable.hpp"
 
 /* gcc version 4.1.2 20080704 (Red Hat 4.1.2-46) blows up compiling ctype defs
- * if sqMemoryAccess.h is included early.
+ * if sqMemoryAccess.h or sqVirtualMachine.h is included early.
  */
 #include "sqMemoryAccess.h"
+#include "sqVirtualMachine.h"
 
 using boost::shared_ptr;
 typedef boost::mutex::scoped_lock scoped_lock;
@@ -60,6 +62,12 @@ class Tickee
 		// side-effect actions (these will vary widely between subclasses); 
 		virtual void tick() = 0;
 		virtual unsigned tickPriority() = 0;
+		// Answer true if tick() reads and writes nothing that another tickee
+		// answering true at the same priority does, so that the Ticker may
+		// tick them all at once on its workers (see Ticker::setWorkerThreads()).
+		virtual bool tickInParallel() { return false; }
+		// The Ticker notes how long each tick took.
+		void noteTickTime(usqLong nanoseconds);
 		//BufferPtr getBuffer() { return buffer; }
 		virtual short* getBuffer() { return buffer; }
 		bool hasValidBuffer() { return hasBuffer; }
@@ -68,10 +76,14 @@ class Tickee
 		virtual void removeSource(shared_ptr<Tickee> src) = 0;
 		virtual void printDebugInfo() = 0;
 		
-		virtual int genericControl(int ctlType, int ctlVal) { return 0; }
+		// Subclasses answer their own control types, and pass the rest on to
+		// this, which answers the QTickeeControl types and 0 for others.
+		virtual int genericControl(int ctlType, int ctlVal);
 		
 		virtual sqInt getEventTimings();
 		
+		const char* getClassName() { return className; }
+		
 	protected:
 		// MAGIC HERE!!!
 		typedef shared_tickee ptr_type;
@@ -85,7 +97,14 @@ class Tickee
 		short buffer[FRAME_SIZE];
 		//short *buffer;
 		bool hasBuffer;
-		const char* className;  //for logging
+		const char* className;  //for logging and tracing
+
+		// Since the tick times were last reset.  Written by whichever thread
+		// ticked us, and read by Squeak's.
+		boost::mutex timingMutex;
+		unsigned timedTicks;
+		usqLong tickNanoseconds;
+		usqLong maxTickNanoseconds;
 };
 
 
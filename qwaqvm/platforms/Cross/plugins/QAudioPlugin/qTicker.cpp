@@ -23,11 +23,13 @@
 #include "qTickee.hpp"
 #include "qLogger.hpp"
 #include "qThreadUtils.hpp"
+#include "qTrace.hpp"
 using namespace Qwaq;
 
 #include <boost/thread/locks.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/bind.hpp>
+#include <algorithm>
 typedef boost::mutex::scoped_lock scoped_lock;
 
 static Ticker* ticker;
@@ -59,6 +61,7 @@ void rootTickee(void)
 
 	if (!ticker->queryIsRunning())
 		return;
+	if (!tickCount) qTraceSetThreadName("audio ticker");
 
 	nowUsecs = interpreterProxy->utcMicroseconds();
 	targetTime += ticker->queryInterval() * 1000;
@@ -74,6 +77,7 @@ void rootTickee(void)
 		errorMsecs = (targetTime - nowUsecs) / -1000;
 
 	// All of this is to check how accurate our ticks are
+	QTRACE_COUNTER(QTraceTicks, "tick lateness (msecs)", errorMsecs);
 	tickCount++;
 	if (!squashAudioBleats) {
 		if (errorMsecs > 2) {
@@ -85,8 +89,9 @@ void rootTickee(void)
 			else {
 				badTickCount++;
 				if (errorMsecs > 40) {
-					// The OpenAL sinks buffer one 20ms frame worth of sound, so as long as the 
-					// error is less that 40ms we should be glitch-free.
+					// The OpenAL sinks buffer at least one 20ms frame worth of sound, so as long as the 
+					// error is less that 40ms we should be glitch-free.  Beyond that they underrun,
+					// and buffer more from then on.
 					qLog() << "rootTickee():  WAITED WAY TOO LONG: " << errorMsecs << "msecs" << flush;
 				}
 			}
@@ -155,6 +160,20 @@ void Ticker::setInterval(unsigned msecs)
 }
 
 
+void Ticker::setWorkerThreads(unsigned threadCount)
+{
+	if (threadCount < 1) threadCount = 1;
+	if (threadCount > TICKER_MAX_THREADS) threadCount = TICKER_MAX_THREADS;
+	qLog() << "Ticker::setWorkerThreads(): " << threadCount << flush;
+
+	shared_ptr<QWorkerPool> pool;
+	if (threadCount > 1) pool.reset(new QWorkerPool(threadCount, "audio ticker worker"));
+	scoped_lock lk(mutex);
+	// A tick in progress keeps the old workers until it is done with them.
+	workers.swap(pool);
+}
+
+
 void Ticker::addTickee(StrongTickee tickee)
 {
 	if (!tickee.get()) {
@@ -178,23 +197,54 @@ void Ticker::addTickee(StrongTickee tickee)
 
 void Ticker::tick(void)
 {
-	qLog(8) << "(tick)" << flush;
+	QLOG(8) << "(tick)" << flush;
+	QTRACE_SCOPE(QTraceTicks, "tick");
 
 	// We will fill this with strong references to the tickees that we will tick.
+	// Those at each priority that may be ticked in parallel come first, up to
+	// parallelEnds[priority], and then the rest, up to ends[priority].
 	StrongTickeeVect strongs;
+	size_t parallelEnds[TICKER_PRIORITY_LEVELS+1];
+	size_t ends[TICKER_PRIORITY_LEVELS+1];
+	shared_ptr<QWorkerPool> pool;
 
 	{
 		// Only lock mutex while obtaining strong references.
 		scoped_lock lk(mutex);
 		for (unsigned priority = TICKER_PRIORITY_LEVELS; priority > 0; priority--) {
+			size_t begin = strongs.size();
 			obtainStrongRefsForPriority(priority, strongs);
+			parallelEnds[priority] = std::stable_partition(strongs.begin() + begin, strongs.end(),
+				boost::bind(&Tickee::tickInParallel, _1)) - strongs.begin();
+			ends[priority] = strongs.size();
 		}
+		pool = workers;
 	}
 
-	// Tick those tickees!
-	for (StrongTickeeVect::iterator it = strongs.begin(); it != strongs.end(); it++) {
-		(*it)->tick();
-	}	
+	// Tick those tickees!  run() answers once all of a batch are ticked, so
+	// they are done before anything of a lower priority, such as a mixer of
+	// them, is ticked.
+	size_t next = 0;
+	for (unsigned priority = TICKER_PRIORITY_LEVELS; priority > 0; priority--) {
+		int parallelCount = parallelEnds[priority] - next;
+		if (pool.get() && parallelCount > 1) {
+			QTRACE_SCOPE(QTraceTicks, "parallel ticks");
+			pool->run(parallelCount, boost::bind(&Ticker::tickOne, this, &strongs[next], _1));
+			next += parallelCount;
+		}
+		for (; next < ends[priority]; next++) tickOne(&strongs[next], 0);
+	}
+}
+
+
+// Tick batch[index], timing it.  Called from a worker for a parallel batch.
+void Ticker::tickOne(StrongTickee* batch, int index)
+{
+	Tickee* tickee = batch[index].get();
+	QTRACE_SCOPE(QTraceTicks, tickee->getClassName());
+	usqLong start = qTraceNanoseconds();
+	tickee->tick();
+	tickee->noteTickTime(qTraceNanoseconds() - start);
 }
 
 
@@ -209,7 +259,7 @@ void Ticker::obtainStrongRefsForPriority(unsigned priority, StrongTickeeVect& st
 
 	WeakTickeeVect &weaks = tickees[priority];
 	if (weaks.size() > 0) {
-		qLog(9) << "ticker priority " << priority << ":  scheduling " << weaks.size() << " tickees" << flush;
+		QLOG(9) << "ticker priority " << priority << ":  scheduling " << weaks.size() << " tickees" << flush;
 
 		WeakTickeeVect::iterator it = weaks.begin();
 		while (it != weaks.end()) {
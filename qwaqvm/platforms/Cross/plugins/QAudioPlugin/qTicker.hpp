@@ -30,11 +30,14 @@
 #include <boost/thread/barrier.hpp>
 #include <boost/thread/thread.hpp>
 
+#include "qWorkerPool.hpp"
+
 using std::vector;
 using boost::weak_ptr;
 using boost::shared_ptr;
 
 const int TICKER_PRIORITY_LEVELS = 10;
+const unsigned TICKER_MAX_THREADS = 32;
 
 namespace Qwaq
 {
@@ -56,6 +59,9 @@ class Ticker
 		void stop();
 		void setVerbosity(unsigned v) { verbosity = v; }
 		void setInterval(unsigned msecs);
+		// Tick the tickees that answer tickInParallel() on 'threadCount'
+		// threads, this one included.  1, the default, ticks them in turn.
+		void setWorkerThreads(unsigned threadCount);
 
 		// Under normal conditions, tick() is not called directly.  Instead,
 		// it is called by rootTickee(), which itself is called from the VM's
@@ -77,8 +83,10 @@ class Ticker
 		unsigned verbosity;
 		unsigned interval;
 		bool isRunning;
+		shared_ptr<QWorkerPool> workers;	// none for a single thread
 
 		void obtainStrongRefsForPriority(unsigned priority, StrongTickeeVect& strongs);
+		void tickOne(StrongTickee* batch, int index);
 };
 
 };
@@ -0,0 +1,337 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qJitterReplay.cpp
+ *  QJitterReplay
+ *
+ *  Command-line tool for tuning the Speex jitter-buffer offline.  It reads a
+ *  trace recorded by QAudioSinkSpeex::startDebugRecording() (see
+ *  qJitterTrace.hpp), reports what the sink did, and then feeds the same
+ *  packets and ticks through a fresh QAudioSinkSpeex for every combination of
+ *  the settings given, reporting what it would have done instead:
+ *
+ *      qJitterReplay [-dump] [-margin n,...] [-delayStep n,...] [-maxLateRate n,...] trace
+ *
+ *  Settings not given are taken from the trace, including any changes made
+ *  while it was recorded.  -dump prints the trace's records first.
+ *
+ *  Delays are counted in ticks, from the tick after a packet arrived to the
+ *  tick that played it, so the recorded and replayed figures compare.
+ *
+ *  It is built from the sink's own sources rather than as part of the plugin,
+ *  e.g. on unix:
+ *
+ *      g++ -O2 -DEXCLUDE_IAX=1 -DEXCLUDE_PORTAUDIO=1 -I../QAudioPlugin -I../QwaqLib
+ *          -I../../vm -I../../../unix/vm -I../../third-party -I../../third-party/speexclient
+ *          -I../../../unix/third-party/openal-soft-1.10.622/include
+ *          qJitterReplay.cpp ../QAudioPlugin/qAudioSinkSpeex.cpp ../QAudioPlugin/qJitterTrace.cpp
+ *          ../QAudioPlugin/qTickee.cpp ../QwaqLib/qEventTimeLogger.cpp ../QwaqLib/qLogger.cpp
+ *          ../QwaqLib/qTrace.cpp
+ *          ../../third-party/speexclient/speex_jitter_buffer.c
+ *          -lspeex -lspeexdsp -lboost_thread -lpthread -o qJitterReplay
+ */
+
+#include "qAudioSinkSpeex.hpp"
+#include "qJitterTrace.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+using namespace Qwaq;
+
+// The sink stamps what it does with the VM's clock.  Here that clock follows
+// the trace being replayed.  Logging is left uninitialized, and so silent.
+static usqLong replayMicroseconds = 0;
+static usqLong getReplayMicroseconds() { return replayMicroseconds; }
+static struct VirtualMachine replayVM;
+extern "C" { struct VirtualMachine* interpreterProxy = &replayVM; }
+
+static char payload[QJT_MAX_PAYLOAD];
+
+
+// The settings that a replay can vary; -1 means as recorded.
+struct JitterSettings
+{
+	int margin;
+	int delayStep;
+	int maxLateRate;
+};
+
+
+// What the sink did, gathered from its trace records.
+class JitterStats
+{
+	public:
+		JitterStats();
+		void add(const QJitterTraceRecord& rec);
+		void report(const char* label, int frameMsecs);
+
+	protected:
+		long ticks, waits, gets, concealed, drops, puts, resets, lostRecords;
+		double bufferedSum;
+		JitterSettings initial;						// at the first tick
+		std::vector<long> delays;					// in ticks, one per packet played
+		std::map<int, std::deque<long> > arrivals;	// appTimestamp -> ticks when it arrived
+
+		bool departed(int appTimestamp, long* delay);
+};
+
+
+JitterStats::JitterStats()
+{
+	ticks = waits = gets = concealed = drops = puts = resets = lostRecords = 0;
+	bufferedSum = 0;
+	initial.margin = initial.delayStep = initial.maxLateRate = -1;
+}
+
+
+void JitterStats::add(const QJitterTraceRecord& rec)
+{
+	long delay;
+	int ret;
+
+	switch (rec.kind) {
+		case QJT_PARAM:
+			// Report the settings in force when the first tick came.
+			if (ticks) break;
+			if (rec.values[0] == JITTER_BUFFER_SET_MARGIN) initial.margin = rec.values[1];
+			if (rec.values[0] == JITTER_BUFFER_SET_DELAY_STEP) initial.delayStep = rec.values[1];
+			if (rec.values[0] == JITTER_BUFFER_SET_MAX_LATE_RATE) initial.maxLateRate = rec.values[1];
+			break;
+		case QJT_PUT:
+			// Deferred packets are counted when they arrive, not when put.
+			if (rec.values[3] == QJT_PUT_UNDEFERRED) break;
+			++puts;
+			arrivals[rec.values[2]].push_back(ticks);
+			break;
+		case QJT_TICK:
+			++ticks;
+			break;
+		case QJT_WAIT:
+			++waits;
+			break;
+		case QJT_GET:
+			++gets;
+			bufferedSum += rec.values[1];
+			ret = rec.values[4];
+			if (ret == 2) ++concealed;
+			// Only 0 and 3 take a packet from the jitter-buffer; 1 decodes more of the last one.
+			if ((ret == 0 || ret == 3) && departed(rec.values[3], &delay)) delays.push_back(delay);
+			break;
+		case QJT_DROP:
+			++drops;
+			ret = rec.values[4];
+			if (ret == 0 || ret == 3) departed(rec.values[3], &delay);
+			break;
+		case QJT_RESET:
+			++resets;
+			break;
+		case QJT_LOST:
+			lostRecords += rec.values[0];
+			break;
+	}
+}
+
+
+bool JitterStats::departed(int appTimestamp, long* delay)
+{
+	std::map<int, std::deque<long> >::iterator it = arrivals.find(appTimestamp);
+	if (it == arrivals.end() || it->second.empty()) return false;
+	*delay = ticks - it->second.front();
+	it->second.pop_front();
+	return true;
+}
+
+
+void JitterStats::report(const char* label, int frameMsecs)
+{
+	long unplayed = 0;
+	for (std::map<int, std::deque<long> >::iterator it = arrivals.begin(); it != arrivals.end(); it++)
+		unplayed += it->second.size();
+
+	std::sort(delays.begin(), delays.end());
+	double mean = 0;
+	for (size_t i = 0; i < delays.size(); i++) mean += delays[i];
+	if (!delays.empty()) mean /= delays.size();
+	long p50 = delays.empty() ? 0 : delays[delays.size() / 2];
+	long p95 = delays.empty() ? 0 : delays[(delays.size() * 95) / 100];
+	long max = delays.empty() ? 0 : delays.back();
+
+	printf("%-9s %6d %6d %5d %7ld %6ld %5.1f%% %6ld %6ld %7.1f %5ld %5ld %5ld %8.1f %4ld\n",
+		label,
+		initial.margin, initial.delayStep, initial.maxLateRate,
+		puts, gets, gets ? (100.0 * concealed) / gets : 0.0, drops, unplayed,
+		mean * frameMsecs, p50 * frameMsecs, p95 * frameMsecs, max * frameMsecs,
+		gets ? (bufferedSum * frameMsecs) / gets : 0.0, resets);
+	if (waits) printf("          %ld ticks waited for the margin to fill\n", waits);
+	if (lostRecords) printf("          %ld records were lost when recording; figures may be off\n", lostRecords);
+}
+
+
+static void dumpRecord(const QJitterTraceRecord& rec, usqLong start)
+{
+	static const char* names[] = { "?", "param", "put", "tick", "wait", "get", "drop", "reset?", "reset", "error", "lost" };
+	const char* name = rec.kind < sizeof(names) / sizeof(names[0]) ? names[rec.kind] : "?";
+
+	printf("%12.3f %-6s %7d %7d %7d %7d %7d",
+		(rec.microseconds - start) / 1000.0, name,
+		rec.values[0], rec.values[1], rec.values[2], rec.values[3], rec.values[4]);
+	if (rec.payloadSize) printf("  [%d bytes]", rec.payloadSize);
+	printf("\n");
+}
+
+
+static bool overridden(int ctlType, const JitterSettings& settings)
+{
+	return (ctlType == JITTER_BUFFER_SET_MARGIN && settings.margin >= 0)
+		|| (ctlType == JITTER_BUFFER_SET_DELAY_STEP && settings.delayStep >= 0)
+		|| (ctlType == JITTER_BUFFER_SET_MAX_LATE_RATE && settings.maxLateRate >= 0);
+}
+
+
+static void drain(QAudioSinkSpeex* sink, JitterStats& stats)
+{
+	static char replayedPayload[QJT_MAX_PAYLOAD];
+	QJitterTraceRecord rec;
+	while (sink->readDebugRecording(rec, replayedPayload)) stats.add(rec);
+}
+
+
+// Feed the trace's packets, ticks and resets through a new sink.  Packets
+// are numbered in the order they arrived, so that they can be told apart.
+static bool replay(const char* tracePath, const JitterSettings& settings, JitterStats& stats)
+{
+	QJitterTraceReader reader;
+	if (!reader.open(tracePath)) return false;
+
+	// Sinks belong to the Tickee map (see qMappedResourceBoilerplate.hpp).
+	QAudioSinkSpeex* sink = new QAudioSinkSpeex();
+	unsigned key = sink->key();
+	sink->startDebugRecording(NULL);
+	if (settings.margin >= 0) sink->jitterbufferCtl(JITTER_BUFFER_SET_MARGIN, settings.margin);
+	if (settings.delayStep >= 0) sink->jitterbufferCtl(JITTER_BUFFER_SET_DELAY_STEP, settings.delayStep);
+	if (settings.maxLateRate >= 0) sink->jitterbufferCtl(JITTER_BUFFER_SET_MAX_LATE_RATE, settings.maxLateRate);
+	drain(sink, stats);
+
+	QJitterTraceRecord rec;
+	int packets = 0;
+	while (reader.next(rec, payload)) {
+		replayMicroseconds = rec.microseconds;
+		switch (rec.kind) {
+			case QJT_PARAM:
+				if (!overridden(rec.values[0], settings)) sink->jitterbufferCtl(rec.values[0], rec.values[1]);
+				break;
+			case QJT_PUT:
+				if (rec.values[3] != QJT_PUT_UNDEFERRED) sink->pushEncodedSpeex(payload, rec.payloadSize, ++packets);
+				break;
+			case QJT_TICK:
+				sink->tick();
+				break;
+			case QJT_RESET_REQUEST:
+				sink->resetTimestamps();
+				break;
+		}
+		drain(sink, stats);
+	}
+
+	sink->stopDebugRecording();
+	Tickee::releaseKey(key);
+	return true;
+}
+
+
+static bool parseList(const char* arg, std::vector<int>& values)
+{
+	values.clear();
+	while (*arg) {
+		char* end;
+		long value = strtol(arg, &end, 10);
+		if (end == arg || value < 0) return false;
+		values.push_back((int)value);
+		arg = (*end == ',') ? end + 1 : end;
+		if (*end && *end != ',') return false;
+	}
+	return !values.empty();
+}
+
+
+static int usage(const char* program)
+{
+	fprintf(stderr, "usage: %s [-dump] [-margin n,...] [-delayStep n,...] [-maxLateRate n,...] trace\n", program);
+	return 2;
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::vector<int> margins(1, -1), delaySteps(1, -1), maxLateRates(1, -1);
+	bool dump = false;
+	const char* tracePath = NULL;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-dump")) dump = true;
+		else if (!strcmp(argv[i], "-margin") && i + 1 < argc) { if (!parseList(argv[++i], margins)) return usage(argv[0]); }
+		else if (!strcmp(argv[i], "-delayStep") && i + 1 < argc) { if (!parseList(argv[++i], delaySteps)) return usage(argv[0]); }
+		else if (!strcmp(argv[i], "-maxLateRate") && i + 1 < argc) { if (!parseList(argv[++i], maxLateRates)) return usage(argv[0]); }
+		else if (argv[i][0] != '-' && !tracePath) tracePath = argv[i];
+		else return usage(argv[0]);
+	}
+	if (!tracePath) return usage(argv[0]);
+
+	replayVM.utcMicroseconds = getReplayMicroseconds;
+
+	QJitterTraceReader reader;
+	if (!reader.open(tracePath)) {
+		fprintf(stderr, "%s: can't read %s as a jitter-buffer trace\n", argv[0], tracePath);
+		return 1;
+	}
+	if (reader.header.frameSize != FRAME_SIZE) {
+		fprintf(stderr, "%s: %s has %d-sample frames; the sink has %d\n", argv[0], tracePath, reader.header.frameSize, FRAME_SIZE);
+		return 1;
+	}
+	int frameMsecs = (FRAME_SIZE * 1000) / reader.header.samplingRate;
+
+	JitterStats recorded;
+	QJitterTraceRecord rec;
+	bool first = true;
+	usqLong start = 0;
+	while (reader.next(rec, payload)) {
+		if (first) { start = rec.microseconds; first = false; }
+		if (dump) dumpRecord(rec, start);
+		recorded.add(rec);
+	}
+	reader.close();
+
+	printf("%-9s %6s %6s %5s %7s %6s %6s %6s %6s %7s %5s %5s %5s %8s %4s\n",
+		"", "margin", "dStep", "mLate", "packets", "gets", "concl", "drops", "unplyd",
+		"delay", "p50", "p95", "max", "buffered", "rsts");
+	recorded.report("recorded", frameMsecs);
+
+	for (size_t m = 0; m < margins.size(); m++)
+		for (size_t d = 0; d < delaySteps.size(); d++)
+			for (size_t l = 0; l < maxLateRates.size(); l++) {
+				JitterSettings settings = { margins[m], delaySteps[d], maxLateRates[l] };
+				JitterStats replayed;
+				if (!replay(tracePath, settings, replayed)) return 1;
+				replayed.report("replayed", frameMsecs);
+			}
+	return 0;
+}
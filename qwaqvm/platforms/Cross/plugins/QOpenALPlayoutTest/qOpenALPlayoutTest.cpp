@@ -0,0 +1,267 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  qOpenALPlayoutTest.cpp
+ *  QOpenALPlayoutTest
+ *
+ *  Command-line test of QAudioSinkOpenAL's playout queue, with no sound card:
+ *  OpenAL Soft plays to a wave file in real time instead (see alsoft.conf).
+ *
+ *      ALSOFT_CONF=alsoft.conf qOpenALPlayoutTest [-seconds n]
+ *
+ *  A tone is played through the sink for each combination of a fixed and an
+ *  adaptive queue, and of ticks that come on time and ticks that come up to
+ *  15ms late, with a stall of 70ms every two seconds.  For each, it reports
+ *  what the sink counted and the gaps in what the device played, and fails
+ *  if the adaptive queue leaves gaps in the steady part of a jittery run.
+ *
+ *  It is built from the sink's own sources rather than as part of the plugin,
+ *  with the OpenAL Soft in the tree, e.g. on unix:
+ *
+ *      g++ -O2 -DEXCLUDE_IAX=1 -DEXCLUDE_PORTAUDIO=1 -I../QAudioPlugin -I../QwaqLib
+ *          -I../../vm -I../../../unix/vm -I../../third-party -I../../third-party/speexclient
+ *          -I../../../unix/third-party/openal-soft-1.10.622/include
+ *          qOpenALPlayoutTest.cpp ../QAudioPlugin/qAudioSinkOpenAL.cpp ../QAudioPlugin/qAudioOpenAL.cpp
+ *          ../QAudioPlugin/qTickee.cpp ../QwaqLib/qLogger.cpp
+ *          -lopenal -lboost_thread -lboost_date_time -lpthread -o qOpenALPlayoutTest
+ */
+
+#include "qAudioSinkOpenAL.hpp"
+#include "qAudioOpenAL.h"
+#include "QAudioPlugin.h"
+
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/* gcc version 4.1.2 20080704 (Red Hat 4.1.2-46) blows up compiling ctype defs
+ * if sqVirtualMachine.h is included early.
+ */
+#include "sqVirtualMachine.h"
+
+using namespace Qwaq;
+using boost::posix_time::ptime;
+using boost::posix_time::microsec_clock;
+using boost::posix_time::microseconds;
+
+// Logging is left uninitialized, and so silent.
+static usqLong realMicroseconds()
+{
+	static ptime epoch(boost::gregorian::date(1970, 1, 1));
+	return (microsec_clock::universal_time() - epoch).total_microseconds();
+}
+static struct VirtualMachine testVM;
+extern "C" { struct VirtualMachine* interpreterProxy = &testVM; }
+
+const int TICK_MSECS = 20;
+const int TICKS_PER_SECOND = 1000 / TICK_MSECS;
+const int SAMPLING_RATE = 16000;
+const char* WAVE_FILE = "qOpenALPlayoutTest.wav";
+
+const int LATE_MSECS = 15;				// the most that a tick is late
+const int STALL_MSECS = 70;
+const int STALL_TICKS = 2 * TICKS_PER_SECOND;	// between stalls
+
+// Samples quieter than this, for at least GAP_SAMPLES, are a gap in the tone.
+const int GAP_LEVEL = 200;
+const int GAP_SAMPLES = SAMPLING_RATE / 500;
+
+
+// A steady 440Hz tone.
+class ToneSource : public Tickee
+{
+	public:
+		ToneSource() : phase(0)
+		{
+			className = (char*) "ToneSource";
+			hasBuffer = true;
+		}
+
+		virtual void tick()
+		{
+			for (int i = 0; i < FRAME_SIZE; i++) {
+				buffer[i] = (short)(8000 * sin(phase));
+				phase += 2 * M_PI * 440 / SAMPLING_RATE;
+			}
+			phase = fmod(phase, 2 * M_PI);
+		}
+		virtual unsigned tickPriority() { return 10; }
+		virtual void addSource(shared_tickee src) { }
+		virtual void removeSource(shared_tickee src) { }
+		virtual void printDebugInfo() { }
+
+	protected:
+		double phase;
+};
+
+
+struct Mode
+{
+	const char* name;
+	int adaptive;
+	int jittery;
+};
+
+
+struct Gaps
+{
+	int count;
+	int samples;
+	int lateCount;		// in the second half of the run
+};
+
+
+// Read back what the device played, from its first sound to its last.
+static Gaps findGaps(const char* fileName)
+{
+	Gaps gaps = { 0, 0, 0 };
+	FILE* f = fopen(fileName, "rb");
+	if (!f) {
+		fprintf(stderr, "can't read %s\n", fileName);
+		return gaps;
+	}
+	std::vector<short> samples;
+	char header[12];
+	char chunk[8];
+	if (fread(header, 1, sizeof(header), f) == sizeof(header)) {
+		while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+			unsigned size = (unsigned char)chunk[4] | ((unsigned char)chunk[5] << 8)
+				| ((unsigned char)chunk[6] << 16) | ((unsigned)(unsigned char)chunk[7] << 24);
+			if (memcmp(chunk, "data", 4)) {
+				fseek(f, size, SEEK_CUR);
+				continue;
+			}
+			short sample;
+			while (fread(&sample, sizeof(sample), 1, f) == 1) samples.push_back(sample);
+			break;
+		}
+	}
+	fclose(f);
+
+	size_t first = 0, last = samples.size();
+	while (first < last && abs(samples[first]) < GAP_LEVEL * 5) first++;
+	while (last > first && abs(samples[last - 1]) < GAP_LEVEL * 5) last--;
+	size_t run = 0;
+	for (size_t i = first; i < last; i++) {
+		if (abs(samples[i]) < GAP_LEVEL) { run++; continue; }
+		if (run >= (size_t)GAP_SAMPLES) {
+			gaps.count++;
+			gaps.samples += run;
+			if (i > first + (last - first) / 2) gaps.lateCount++;
+		}
+		run = 0;
+	}
+	return gaps;
+}
+
+
+static bool testMode(const Mode& mode, int seconds)
+{
+	if (!qOalCreateContext()) {
+		fprintf(stderr, "can't open an OpenAL device; is ALSOFT_CONF set?\n");
+		return false;
+	}
+
+	ToneSource* t = new ToneSource();
+	unsigned toneKey = t->key();
+	shared_tickee tone = Tickee::withKey(toneKey);
+	QAudioSinkOpenAL* s = new QAudioSinkOpenAL();
+	unsigned sinkKey = s->key();
+	shared_tickee sink = Tickee::withKey(sinkKey);
+	sink->addSource(tone);
+	sink->genericControl(QOpenALSetAdaptive, mode.adaptive);
+
+	srand(1);
+	ptime start = microsec_clock::universal_time();
+	ptime last = start;
+	int ticks = seconds * TICKS_PER_SECOND;
+	for (int tick = 0; tick < ticks; tick++) {
+		// Like the ticker, a late tick is followed by the ones it held up.
+		int lateMsecs = 0;
+		if (mode.jittery) {
+			lateMsecs = rand() % (LATE_MSECS + 1);
+			if (tick % STALL_TICKS == STALL_TICKS / 2) lateMsecs = STALL_MSECS;
+		}
+		ptime when = start + microseconds((tick * TICK_MSECS + lateMsecs) * 1000);
+		if (when < last) when = last;
+		boost::this_thread::sleep(when);
+		last = when;
+
+		tone->tick();
+		sink->tick();
+	}
+
+	int depth = sink->genericControl(QOpenALGetDepth, 0);
+	int meanLatency = sink->genericControl(QOpenALGetMeanLatency, 0);
+	int underruns = sink->genericControl(QOpenALGetUnderruns, 0);
+	int overruns = sink->genericControl(QOpenALGetOverruns, 0);
+	int stretched = sink->genericControl(QOpenALGetStretchedFrames, 0);
+	int squeezed = sink->genericControl(QOpenALGetSqueezedFrames, 0);
+
+	sink.reset();
+	Tickee::releaseKey(sinkKey);
+	tone.reset();
+	Tickee::releaseKey(toneKey);
+	qOalShutdown();		// closing the device finishes the file
+	qOalInit();
+
+	Gaps gaps = findGaps(WAVE_FILE);
+	printf("%-22s underruns %3d  overruns %3d  stretched %4d  squeezed %4d  depth %d  mean latency %3dms  gaps %3d (%4dms)\n",
+		mode.name, underruns, overruns, stretched, squeezed, depth, meanLatency,
+		gaps.count, gaps.samples * 1000 / SAMPLING_RATE);
+
+	// Once the adaptive queue has found its depth, it should play through.
+	return !(mode.adaptive && gaps.lateCount > 0);
+}
+
+
+int main(int argc, char** argv)
+{
+	int seconds = 20;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: ALSOFT_CONF=alsoft.conf %s [-seconds n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (seconds < 4) {
+		fprintf(stderr, "%s: need at least 4 seconds\n", argv[0]);
+		return 1;
+	}
+	testVM.utcMicroseconds = realMicroseconds;
+	qOalInit();
+
+	printf("%d seconds of a tone for each: what the sink counted, and the gaps in what was played\n\n", seconds);
+	static const Mode modes[] = {
+		{ "fixed, on time", 0, 0 },
+		{ "fixed, jittery", 0, 1 },
+		{ "adaptive, on time", 1, 0 },
+		{ "adaptive, jittery", 1, 1 }
+	};
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		if (!testMode(modes[i], seconds)) ok = false;
+	}
+	printf("\n%s\n", ok ? "SUCCESS" : "FAILURE: the adaptive queue still has gaps");
+	return ok ? 0 : 1;
+}
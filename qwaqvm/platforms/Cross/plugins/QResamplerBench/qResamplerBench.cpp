@@ -0,0 +1,169 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  qResamplerBench.cpp
+ *  QResamplerBench
+ *
+ *  Command-line benchmark of QAudioResampler, the converter behind
+ *  QAudioSinkBufferedResampler.  For each input format and quality it feeds
+ *  a batch of streams a tick's worth of audio at a time, as the sink does,
+ *  and reports the CPU time per stream per 20ms tick, and the share of one
+ *  core that a stream takes:
+ *
+ *      qResamplerBench [-streams n] [-seconds n]
+ *
+ *  It also times a change of input rate, made in place, against destroying
+ *  and re-creating the Speex resampler as the sink used to.
+ *
+ *  It is built from the resampler's own sources rather than as part of the
+ *  plugin, e.g. on unix:
+ *
+ *      g++ -O2 -I../QAudioPlugin -I../QwaqLib -I../../vm -I../../../unix/vm
+ *          qResamplerBench.cpp ../QAudioPlugin/qAudioResampler.cpp ../QwaqLib/qLogger.cpp
+ *          -lspeexdsp -lboost_thread -lpthread -o qResamplerBench
+ */
+
+#include "qAudioResampler.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace Qwaq;
+
+// Logging is left uninitialized, and so silent.
+extern "C" { struct VirtualMachine* interpreterProxy = NULL; }
+
+const unsigned OUTPUT_RATE = 16000;
+const unsigned TICK_MSECS = 20;
+
+static double cpuSeconds()
+{
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// A tick of interleaved audio: a different tone in each channel, so that
+// downmixing has something to do.
+static void fillTone(std::vector<short>& samples, unsigned rate, unsigned channels, unsigned frames)
+{
+	samples.resize(frames * channels);
+	for (unsigned i = 0; i < frames; i++)
+		for (unsigned c = 0; c < channels; c++)
+			samples[i * channels + c] = (short)(8000 * sin(2 * M_PI * (440 + 110 * c) * i / rate));
+}
+
+struct Format
+{
+	const char* name;
+	unsigned rate;
+	unsigned channels;
+};
+
+static void benchmarkFormat(const Format& format, int quality, int streams, int seconds)
+{
+	unsigned frames = format.rate * TICK_MSECS / 1000;
+	std::vector<short> input;
+	fillTone(input, format.rate, format.channels, frames);
+	std::vector<short> output(OUTPUT_RATE * TICK_MSECS / 1000 * 2 + 64);
+
+	std::vector<QAudioResampler*> bank;
+	for (int i = 0; i < streams; i++) {
+		QAudioResampler* r = new QAudioResampler;
+		r->configure(format.rate, OUTPUT_RATE, format.channels, 1, quality);
+		bank.push_back(r);
+	}
+
+	int ticks = seconds * 1000 / TICK_MSECS;
+	unsigned produced = 0;
+	double start = cpuSeconds();
+	for (int t = 0; t < ticks; t++) {
+		for (int i = 0; i < streams; i++) {
+			unsigned consumed = frames;
+			produced += bank[i]->process(&input[0], consumed, &output[0], output.size());
+		}
+	}
+	double elapsed = cpuSeconds() - start;
+
+	double usPerTick = elapsed * 1e6 / ((double)ticks * streams);
+	printf("%-14s quality %2d:  %7.1f us per stream per tick,  %5.2f%% of a core per stream,  latency %u samples\n",
+		format.name, quality, usPerTick, usPerTick / (TICK_MSECS * 10.0), bank[0]->latency());
+	if (produced < (unsigned)(ticks * streams) * (OUTPUT_RATE * TICK_MSECS / 1000 - 1))
+		printf("    (only %u samples produced)\n", produced);
+
+	for (int i = 0; i < streams; i++) delete bank[i];
+}
+
+static void benchmarkRateChange(int quality)
+{
+	const int changes = 2000;
+	SpeexResamplerState* state;
+	int err;
+
+	double start = cpuSeconds();
+	state = speex_resampler_init(1, 44100, OUTPUT_RATE, quality, &err);
+	for (int i = 0; i < changes; i++) {
+		speex_resampler_destroy(state);
+		state = speex_resampler_init(1, (i & 1) ? 44100 : 48000, OUTPUT_RATE, quality, &err);
+	}
+	speex_resampler_destroy(state);
+	double recreate = (cpuSeconds() - start) * 1e6 / changes;
+
+	QAudioResampler resampler;
+	resampler.configure(44100, OUTPUT_RATE, 1, 1, quality);
+	start = cpuSeconds();
+	for (int i = 0; i < changes; i++) resampler.setRates((i & 1) ? 44100 : 48000, OUTPUT_RATE);
+	double inPlace = (cpuSeconds() - start) * 1e6 / changes;
+
+	printf("rate change,   quality %2d:  re-created %7.1f us,  in place %7.1f us\n", quality, recreate, inPlace);
+}
+
+int main(int argc, char* argv[])
+{
+	int streams = 16;
+	int seconds = 10;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-streams") && i + 1 < argc) streams = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-streams n] [-seconds n]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	Format formats[] = {
+		{ "16kHz mono", 16000, 1 },
+		{ "22.05kHz mono", 22050, 1 },
+		{ "44.1kHz stereo", 44100, 2 },
+		{ "48kHz stereo", 48000, 2 },
+		{ "48kHz 5.1", 48000, 6 }
+	};
+	int qualities[] = { 0, 3, 5, 8, 10 };
+
+	printf("%d streams, %d seconds of audio each, to %uHz mono\n", streams, seconds, OUTPUT_RATE);
+	for (unsigned f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+		for (unsigned q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++) {
+			benchmarkFormat(formats[f], qualities[q], streams, seconds);
+			if (formats[f].rate == OUTPUT_RATE) break;  // no filter to vary
+		}
+	}
+	for (unsigned q = 0; q < sizeof(qualities) / sizeof(qualities[0]); q++)
+		benchmarkRateChange(qualities[q]);
+	return 0;
+}
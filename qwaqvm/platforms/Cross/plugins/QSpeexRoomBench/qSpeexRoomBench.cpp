@@ -0,0 +1,239 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  qSpeexRoomBench.cpp
+ *  QSpeexRoomBench
+ *
+ *  Command-line benchmark of the CPU that a room full of people takes to
+ *  talk to each other through the Speex path of QAudioPlugin, with VAD and
+ *  DTX off, with VAD alone, and with both:
+ *
+ *      qSpeexRoomBench [-people n] [-talkers n] [-seconds n]
+ *
+ *  Everyone encodes what their microphone hears; a few of them talk, taking
+ *  a breath now and then, and the rest only pick up the room.  Everyone
+ *  hears everyone else through a QAudioSinkSpeex each, mixed by a
+ *  QAudioSinkMixer.  Listeners all do the same work, so one of them stands
+ *  in for the rest, and the room's decode and mix figures are theirs times
+ *  the number of people.  Time is simulated, so it runs as fast as it can,
+ *  and the figures are CPU time as a share of one core.
+ *
+ *  It is built from the plugin's own sources rather than as part of it, e.g.
+ *  on unix:
+ *
+ *      g++ -O2 -DEXCLUDE_IAX=1 -DEXCLUDE_PORTAUDIO=1 -I../QAudioPlugin -I../QwaqLib
+ *          -I../../vm -I../../../unix/vm -I../../third-party -I../../third-party/speexclient
+ *          -I../../../unix/third-party/openal-soft-1.10.622/include
+ *          qSpeexRoomBench.cpp ../QAudioPlugin/qAudioSinkSpeex.cpp
+ *          ../QAudioPlugin/qAudioSinkMixer.cpp ../QAudioPlugin/qJitterTrace.cpp
+ *          ../QAudioPlugin/qTickee.cpp ../QwaqLib/qEventTimeLogger.cpp ../QwaqLib/qLogger.cpp
+ *          ../QwaqLib/qTrace.cpp
+ *          -x c ../QAudioPlugin/qAudioSpeex.c ../../third-party/speexclient/speex_jitter_buffer.c
+ *          -lspeex -lspeexdsp -lboost_thread -lboost_date_time -lpthread -o qSpeexRoomBench
+ */
+
+#include "qAudioSinkSpeex.hpp"
+#include "qAudioSinkMixer.hpp"
+#include "qAudioSpeex.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+using namespace Qwaq;
+
+// The sinks stamp what they do with the VM's clock, which is simulated here.
+// Logging is left uninitialized, and so silent.
+static usqLong simulatedMicroseconds = 0;
+static usqLong getSimulatedMicroseconds() { return simulatedMicroseconds; }
+static struct VirtualMachine benchVM;
+extern "C" { struct VirtualMachine* interpreterProxy = &benchVM; }
+
+const int TICK_MSECS = 20;
+const int TICKS_PER_SECOND = 1000 / TICK_MSECS;
+const int SAMPLING_RATE = 16000;
+
+const int TALK_TICKS = 3 * TICKS_PER_SECOND;	// between breaths
+const int BREATH_TICKS = TICKS_PER_SECOND;
+
+static double cpuSeconds()
+{
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+
+// Something like voiced speech: a buzz at a wandering pitch, shaped into
+// syllables about four times a second, with a pause for breath now and then.
+// Everyone hears the room, a little noise, whether they are talking or not.
+class Microphone
+{
+	public:
+		Microphone(int person, bool talker) : person(person), talker(talker), phase(0), sample(0) { }
+
+		void read(short* frame)
+		{
+			double pitch = 100 + 15 * (person % 8);
+			for (int i = 0; i < FRAME_SIZE; i++, sample++) {
+				double t = (double)sample / SAMPLING_RATE;
+				double noise = (rand() / (double)RAND_MAX - 0.5) * 200;
+				double voice = 0;
+				int tick = sample / FRAME_SIZE + person * 17;
+				if (talker && tick % (TALK_TICKS + BREATH_TICKS) < TALK_TICKS) {
+					double f0 = pitch * (1 + 0.1 * sin(2 * M_PI * 0.7 * t + person));
+					phase += 2 * M_PI * f0 / SAMPLING_RATE;
+					double buzz = 0;
+					for (int h = 1; h <= 12; h++) buzz += sin(h * phase) / h;
+					double syllable = sin(M_PI * fmod(t * (3.5 + 0.25 * (person % 8)), 1.0));
+					voice = 6000 * buzz * syllable * syllable;
+				}
+				frame[i] = (short)(voice + noise);
+			}
+		}
+
+	protected:
+		int person;
+		bool talker;
+		double phase;
+		long sample;
+};
+
+
+struct Mode
+{
+	const char* name;
+	int vad;
+	int dtx;
+};
+
+
+static void benchmarkMode(const Mode& mode, int people, int talkers, int seconds)
+{
+	std::vector<Microphone> microphones;
+	std::vector<QSpeexCodecPtr> encoders;
+	for (int i = 0; i < people; i++) {
+		microphones.push_back(Microphone(i, i < talkers));
+		encoders.push_back(qSpeexCreateHandle());
+		qSpeexControl(encoders[i], QSpeexSetVAD, mode.vad);
+		qSpeexControl(encoders[i], QSpeexSetDTX, mode.dtx);
+	}
+
+	// The listener is the last person, who doesn't talk.
+	int listener = people - 1;
+	std::vector<unsigned> sinkKeys;
+	std::vector<boost::shared_ptr<QAudioSinkSpeex> > sinks;
+	QAudioSinkMixer* m = new QAudioSinkMixer();
+	unsigned mixerKey = m->key();
+	boost::shared_ptr<QAudioSinkMixer> mixer = boost::dynamic_pointer_cast<QAudioSinkMixer>(Tickee::withKey(mixerKey));
+	for (int i = 0; i < people; i++) {
+		if (i == listener) { sinks.push_back(boost::shared_ptr<QAudioSinkSpeex>()); continue; }
+		QAudioSinkSpeex* s = new QAudioSinkSpeex();
+		if (mode.dtx) s->jitterbufferCtl(QWAQ_JITTER_BUFFER_SET_SILENCE_RESET, 10);
+		sinkKeys.push_back(s->key());
+		sinks.push_back(boost::dynamic_pointer_cast<QAudioSinkSpeex>(Tickee::withKey(s->key())));
+		mixer->addSource(sinks[i]);
+	}
+
+	short frame[FRAME_SIZE];
+	char encoded[2048];
+	double encodeSeconds = 0, decodeSeconds = 0, mixSeconds = 0;
+	long sent = 0, played = 0, mixed = 0;
+	int ticks = seconds * TICKS_PER_SECOND;
+	for (int tick = 0; tick < ticks; tick++) {
+		simulatedMicroseconds += TICK_MSECS * 1000;
+		for (int i = 0; i < people; i++) {
+			microphones[i].read(frame);
+			double start = cpuSeconds();
+			int size = qSpeexEncode(encoders[i], frame, FRAME_SIZE);
+			if (size > 0) qSpeexEncodeRead(encoders[i], encoded, size);
+			encodeSeconds += cpuSeconds() - start;
+			if (size <= 0) continue;
+			sent++;
+			if (i == listener) continue;
+
+			start = cpuSeconds();
+			sinks[i]->pushEncodedSpeex(encoded, size, (int)(simulatedMicroseconds / 1000));
+			decodeSeconds += cpuSeconds() - start;
+		}
+
+		double start = cpuSeconds();
+		for (int i = 0; i < people; i++) {
+			if (i == listener) continue;
+			sinks[i]->tick();
+			if (sinks[i]->hasValidBuffer()) played++;
+		}
+		decodeSeconds += cpuSeconds() - start;
+
+		start = cpuSeconds();
+		mixer->tick();
+		mixSeconds += cpuSeconds() - start;
+		mixed++;
+	}
+
+	// Every listener decodes and mixes as much as this one.
+	decodeSeconds *= people;
+	mixSeconds *= people;
+	double total = encodeSeconds + decodeSeconds + mixSeconds;
+	printf("%-10s %5.1f%% sent %5.1f%% decoded   encode %6.1f%%  decode %6.1f%%  mix %5.1f%%  total %6.1f%% of a core\n",
+		mode.name,
+		100.0 * sent / ((double)people * ticks),
+		100.0 * played / ((double)(people - 1) * ticks),
+		100.0 * encodeSeconds / seconds,
+		100.0 * decodeSeconds / seconds,
+		100.0 * mixSeconds / seconds,
+		100.0 * total / seconds);
+
+	mixer.reset();
+	Tickee::releaseKey(mixerKey);
+	sinks.clear();
+	for (size_t i = 0; i < sinkKeys.size(); i++) Tickee::releaseKey(sinkKeys[i]);
+	for (int i = 0; i < people; i++) qSpeexDestroyHandle(encoders[i]);
+}
+
+
+int main(int argc, char** argv)
+{
+	int people = 40, talkers = 3, seconds = 20;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-people") && i + 1 < argc) people = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-talkers") && i + 1 < argc) talkers = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-people n] [-talkers n] [-seconds n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (people < 2 || talkers < 0 || talkers >= people || seconds < 1) {
+		fprintf(stderr, "%s: need at least 2 people, a listener who doesn't talk, and a second\n", argv[0]);
+		return 1;
+	}
+	benchVM.utcMicroseconds = getSimulatedMicroseconds;
+
+	printf("%d people, %d talking, %d simulated seconds: CPU for the whole room\n\n", people, talkers, seconds);
+	static const Mode modes[] = {
+		{ "plain", 0, 0 },
+		{ "VAD", 1, 0 },
+		{ "VAD+DTX", 1, 1 }
+	};
+	for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+		srand(1);
+		benchmarkMode(modes[i], people, talkers, seconds);
+	}
+	return 0;
+}
@@ -0,0 +1,195 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  qTickerBench.cpp
+ *  QTickerBench
+ *
+ *  Command-line benchmark of the time that a Ticker takes to tick a room's
+ *  worth of QAudioSinkSpeex decoding at once, and the QAudioSinkMixer that
+ *  mixes them, on one thread and on a pool of workers:
+ *
+ *      qTickerBench [-threads n] [-seconds n]
+ *
+ *  For 8, 32 and 128 sinks, each is pushed a packet of speech every tick, and
+ *  the ticker is ticked with 1, 2, 4 ... up to -threads threads (by default,
+ *  the number of cores).  It reports the mean and worst time that a tick took,
+ *  and what the sinks' own tick timings say (see QTickeeControl).  Time is
+ *  simulated, so it runs as fast as it can.
+ *
+ *  It is built from the plugin's own sources rather than as part of it, e.g.
+ *  on unix:
+ *
+ *      g++ -O2 -DEXCLUDE_IAX=1 -DEXCLUDE_PORTAUDIO=1 -I../QAudioPlugin -I../QwaqLib
+ *          -I../../vm -I../../../unix/vm -I../../third-party -I../../third-party/speexclient
+ *          -I../../../unix/third-party/openal-soft-1.10.622/include
+ *          qTickerBench.cpp ../QAudioPlugin/qTicker.cpp ../QAudioPlugin/qTickee.cpp
+ *          ../QAudioPlugin/qAudioSinkSpeex.cpp ../QAudioPlugin/qAudioSinkMixer.cpp
+ *          ../QAudioPlugin/qJitterTrace.cpp ../QwaqLib/qEventTimeLogger.cpp ../QwaqLib/qLogger.cpp
+ *          ../QwaqLib/qTrace.cpp ../QwaqLib/qWorkerPool.cpp
+ *          -x c ../QAudioPlugin/qAudioSpeex.c ../../third-party/speexclient/speex_jitter_buffer.c
+ *          -lspeex -lspeexdsp -lboost_thread -lboost_date_time -lpthread -o qTickerBench
+ */
+
+#include "qTicker.hpp"
+#include "qAudioSinkSpeex.hpp"
+#include "qAudioSinkMixer.hpp"
+#include "qAudioSpeex.h"
+#include "qTrace.hpp"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace Qwaq;
+
+// The sinks stamp what they do with the VM's clock, which is simulated here.
+// Logging is left uninitialized, and so silent.
+static usqLong simulatedMicroseconds = 0;
+static usqLong getSimulatedMicroseconds() { return simulatedMicroseconds; }
+static struct VirtualMachine benchVM;
+extern "C" { struct VirtualMachine* interpreterProxy = &benchVM; }
+
+const int TICK_MSECS = 20;
+const int TICKS_PER_SECOND = 1000 / TICK_MSECS;
+const int SAMPLING_RATE = 16000;
+const int VOICES = 8;			// sinks take turns at these
+
+
+// A packet per tick of something like voiced speech, from one of several
+// speakers, encoded before the benchmark starts.
+class Speech
+{
+	public:
+		Speech(int voice, int ticks)
+		{
+			QSpeexCodecPtr encoder = qSpeexCreateHandle();
+			double pitch = 100 + 15 * voice, phase = 0;
+			short frame[FRAME_SIZE];
+			char encoded[2048];
+			for (int tick = 0; tick < ticks; tick++) {
+				for (int i = 0; i < FRAME_SIZE; i++) {
+					double t = (double)(tick * FRAME_SIZE + i) / SAMPLING_RATE;
+					phase += 2 * M_PI * pitch * (1 + 0.1 * sin(2 * M_PI * 0.7 * t + voice)) / SAMPLING_RATE;
+					double buzz = 0;
+					for (int h = 1; h <= 12; h++) buzz += sin(h * phase) / h;
+					double syllable = sin(M_PI * fmod(t * (3.5 + 0.25 * voice), 1.0));
+					frame[i] = (short)(6000 * buzz * syllable * syllable + (rand() / (double)RAND_MAX - 0.5) * 200);
+				}
+				int size = qSpeexEncode(encoder, frame, FRAME_SIZE);
+				if (size > 0) qSpeexEncodeRead(encoder, encoded, size);
+				packets.push_back(std::string(encoded, size > 0 ? size : 0));
+			}
+			qSpeexDestroyHandle(encoder);
+		}
+
+		std::vector<std::string> packets;
+};
+
+
+static void benchmarkRoom(const std::vector<Speech>& voices, int sinkCount, int threads, int seconds)
+{
+	Ticker ticker;
+	ticker.setWorkerThreads(threads);
+
+	QAudioSinkMixer* m = new QAudioSinkMixer();
+	unsigned mixerKey = m->key();
+	shared_tickee mixer = Tickee::withKey(mixerKey);
+	ticker.addTickee(mixer);
+	std::vector<unsigned> sinkKeys;
+	std::vector<boost::shared_ptr<QAudioSinkSpeex> > sinks;
+	for (int i = 0; i < sinkCount; i++) {
+		QAudioSinkSpeex* s = new QAudioSinkSpeex();
+		sinkKeys.push_back(s->key());
+		sinks.push_back(boost::dynamic_pointer_cast<QAudioSinkSpeex>(Tickee::withKey(s->key())));
+		ticker.addTickee(sinks[i]);
+		mixer->addSource(sinks[i]);
+	}
+
+	int ticks = seconds * TICKS_PER_SECOND;
+	std::vector<double> tickMicros;
+	for (int tick = 0; tick < ticks; tick++) {
+		simulatedMicroseconds += TICK_MSECS * 1000;
+		for (int i = 0; i < sinkCount; i++) {
+			const std::string& packet = voices[i % VOICES].packets[(tick + i) % voices[i % VOICES].packets.size()];
+			if (!packet.empty()) sinks[i]->pushEncodedSpeex((void*)packet.data(), packet.size(), (int)(simulatedMicroseconds / 1000));
+		}
+		usqLong start = qTraceNanoseconds();
+		ticker.tick();
+		tickMicros.push_back((qTraceNanoseconds() - start) / 1000.0);
+	}
+
+	// What the sinks' own timings say (see QTickeeControl).
+	double sinkMean = 0;
+	int sinkMax = 0;
+	for (int i = 0; i < sinkCount; i++) {
+		sinkMean += sinks[i]->genericControl(QTickeeGetMeanTickMicroseconds, 0);
+		sinkMax = std::max(sinkMax, sinks[i]->genericControl(QTickeeGetMaxTickMicroseconds, 0));
+	}
+	sinkMean /= sinkCount;
+
+	double mean = 0;
+	for (size_t i = 0; i < tickMicros.size(); i++) mean += tickMicros[i];
+	mean /= tickMicros.size();
+	std::sort(tickMicros.begin(), tickMicros.end());
+	printf("%4d sinks  %2d threads   tick mean %7.0fus  99%% %7.0fus  worst %7.0fus   per sink mean %4.0fus  worst %5dus   mixer mean %4dus\n",
+		sinkCount, threads, mean, tickMicros[tickMicros.size() * 99 / 100], tickMicros.back(),
+		sinkMean, sinkMax, mixer->genericControl(QTickeeGetMeanTickMicroseconds, 0));
+
+	mixer.reset();
+	Tickee::releaseKey(mixerKey);
+	sinks.clear();
+	for (size_t i = 0; i < sinkKeys.size(); i++) Tickee::releaseKey(sinkKeys[i]);
+}
+
+
+int main(int argc, char** argv)
+{
+	int threads = boost::thread::hardware_concurrency(), seconds = 10;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-threads") && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-seconds") && i + 1 < argc) seconds = atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: %s [-threads n] [-seconds n]\n", argv[0]);
+			return 1;
+		}
+	}
+	if (threads < 1 || seconds < 1) {
+		fprintf(stderr, "%s: need at least a thread and a second\n", argv[0]);
+		return 1;
+	}
+	benchVM.utcMicroseconds = getSimulatedMicroseconds;
+
+	srand(1);
+	std::vector<Speech> voices;
+	for (int v = 0; v < VOICES; v++) voices.push_back(Speech(v, 5 * TICKS_PER_SECOND));
+
+	printf("%d simulated seconds of %dms ticks, on %d cores\n\n", seconds, TICK_MSECS, boost::thread::hardware_concurrency());
+	static const int sinkCounts[] = { 8, 32, 128 };
+	for (size_t i = 0; i < sizeof(sinkCounts) / sizeof(sinkCounts[0]); i++) {
+		for (int t = 1; ; t *= 2) {
+			if (t > threads) t = threads;
+			benchmarkRoom(voices, sinkCounts[i], t, seconds);
+			if (t == threads) break;
+		}
+		printf("\n");
+	}
+	return 0;
+}
@@ -41,7 +41,7 @@ void qInitDecoderStorage(void);
 	 width:
 	 height:
    Return value: 
-     The index of the created decoder, or one of the following
+     The (positive) index of the created decoder, or one of the following
      negative values if the decoder could not be created:
        -4 : The maximum number of decoders has been reached.
        -2 : There was an error while initializing the decoder.
@@ -51,7 +51,7 @@ int qCreateDecoder(char* decoderArgs, int decoderArgsSize, int semaIndex, int wi
 
 
 /*	qDestroyDecoder:	Destroy the indicated decoder.  Does nothing
-						if the index is invalid or if the decoder 
+						if the index is invalid or stale, or if the decoder 
 						has not been instantiated.
 	Arguments:
 		decoderIndex: The index of the decoder to destroy.
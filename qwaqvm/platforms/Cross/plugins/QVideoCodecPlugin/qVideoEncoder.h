@@ -41,7 +41,7 @@ void qInitEncoderStorage(void);
 	 width:
 	 height:
    Return value: 
-     The index of the created encoder, or one of the following
+     The (positive) index of the created encoder, or one of the following
      negative values if the encoder could not be created:
        -4 : The maximum number of encoder has been reached.
        -2 : There was an error while initializing the encoder.
@@ -51,7 +51,7 @@ int qCreateEncoder(char* encoderArgs, int encoderArgsSize, int semaIndex, int wi
 
 
 /*	qDestroyEncoder:	Destroy the indicated encoder.  Does nothing
-						if the index is invalid or if the encoder 
+						if the index is invalid or stale, or if the encoder 
 						has not been instantiated.
 	Arguments:
 		encoderIndex: The index of the encoder to destroy.
@@ -61,6 +61,19 @@ void
 qFeedbackChannelPopEvent(char* address);
 
 
+//
+// Copy as many of the specified channel's events as fit into 'buffer', and
+// remove them from the channel.  Each event is copied as a 32-bit size
+// followed by the bytes that qFeedbackChannelReadEvent would have answered,
+// padded to a multiple of 4 bytes.  Answer the number of bytes used, or, if
+// the next event doesn't fit into an empty buffer, minus the buffer size that
+// it needs.  After the first drain, the channel signals its semaphore once
+// per batch of events rather than once per event; if the buffer fills before
+// the channel is empty, the semaphore is signalled again.
+int
+qFeedbackChannelDrain(char* address, char* buffer, int bufferSize);
+
+
 //
 // Turn logging on or off for the specified channel. 'trueOrFalse' is 1
 // for true and 0 for false.
@@ -17,7 +17,9 @@
 #include "qFeedbackChannel-interface.h"
 #include "qLogger.hpp"
 #include "qException.h"
+#include "qTrace.hpp"
 #include "sqVirtualMachine.h"
+#include <string.h>
 
 using namespace Qwaq;
 
@@ -130,6 +132,18 @@ qFeedbackChannelPopEvent(char* address)
 }
 
 
+int
+qFeedbackChannelDrain(char* address, char* buffer, int bufferSize)
+{
+	FeedbackChannel* fc = *((FeedbackChannel**) address);
+	if (!fc) {
+		qerr << endl << qTime() << "qFeedbackChannelDrain(): channel address is NULL!";
+		return 0;
+	}
+	return fc->drain(buffer, bufferSize);
+}
+
+
 void
 qFeedbackChannelSetLogging(char* address, int trueOrFalse)
 {
@@ -186,11 +200,19 @@ FeedbackChannel::pop()
 void
 FeedbackChannel::push(FeedbackEventPtr& ptr)
 {
+	bool signal;
+	int queued;
 	{
 		scoped_lock lk(mutex);
 		queue.push(ptr);
+		queued = queue.size();
+		// A draining reader will take this event along with the others
+		// that it has already been signalled about.
+		signal = !(isDrained && signalPending);
+		signalPending = true;
 	}
-	interpreterProxy->signalSemaphoreWithIndex(semaphoreIndex);
+	if (signal) interpreterProxy->signalSemaphoreWithIndex(semaphoreIndex);
+	QTRACE_INSTANT(QTraceFeedback, "feedback push", queued);
 	
 	if (isLogging) {
 		qerr << endl << " pushed event " << ptr->description() << " on feedback-channel " << (unsigned)this;
@@ -198,6 +220,46 @@ FeedbackChannel::push(FeedbackEventPtr& ptr)
 }
 
 
+int
+FeedbackChannel::drain(char* buffer, int bufferSize)
+{
+	QTRACE_SCOPE(QTraceFeedback, "feedback drain");
+	const int headerSize = 4;
+	int used = 0;
+	int count = 0;
+	bool signal;
+	{
+		scoped_lock lk(mutex);
+		isDrained = true;
+		while (!queue.empty()) {
+			FeedbackEventPtr& evt = queue.front();
+			int size = evt->getSqueakEventSize();
+			int recordSize = headerSize + ((size + 3) & ~3);
+			if (used + recordSize > bufferSize) {
+				if (!count) return -recordSize;
+				break;
+			}
+			*((int*)(buffer + used)) = size;
+			evt->fillInSqueakEvent(buffer + used + headerSize);
+			memset(buffer + used + headerSize + size, 0, recordSize - headerSize - size);
+			used += recordSize;
+			count++;
+			queue.pop();
+		}
+		// If we ran out of room, make sure the reader comes back for the rest.
+		signal = !queue.empty();
+		signalPending = signal;
+	}
+	if (signal) interpreterProxy->signalSemaphoreWithIndex(semaphoreIndex);
+	QTRACE_COUNTER(QTraceFeedback, "feedback drained", count);
+
+	if (isLogging) {
+		qerr << endl << " drained " << count << " events (" << used << " bytes) from channel " << (unsigned)this;
+	}
+	return used;
+}
+
+
 void 
 FeedbackChannel::setLogging(bool trueOrFalse)
 { 
@@ -39,6 +39,15 @@
  *                 - payload data is read into a ByteArray that must be at least
  *                   as big as the size specified by Stage 1.
  *
+ * Alternatively, the Squeak Process can drain the channel: copy all of the
+ * queued events into one ByteArray that it supplies (see qFeedbackChannelDrain
+ * in qFeedbackChannel-interface.h).  Once a channel has been drained, its
+ * semaphore is signalled once for each batch of events instead of once for
+ * each event.
+ *
+ * Events that are pushed often should come from a FeedbackEventPool, so that
+ * they are recycled rather than allocated each time.
+ *
  ******************************************************************************/
 
 #ifndef __Q_FEEDBACK_CHANNEL_H__
@@ -47,6 +56,7 @@
 #define BOOST_DYN_LINK
 #include <queue>
 #include <map>
+#include <vector>
 #include <boost/thread/mutex.hpp>
 #include <boost/shared_ptr.hpp>
 
@@ -68,24 +78,63 @@ namespace Qwaq {
 	};
 	
 
+	// Recycles events of one type.  An event is free again once the pool holds
+	// the only reference to it, i.e. once every channel it was pushed onto has
+	// popped or drained it, so a pool only grows to the number of its events
+	// in flight at once.
+	template <class T>
+	class FeedbackEventPool
+	{
+	public:
+		FeedbackEventPool() : next(0) { }
+
+		boost::shared_ptr<T> acquire()
+		{
+			scoped_lock lk(mutex);
+			for (unsigned i = 0; i < events.size(); i++) {
+				if (next >= events.size()) next = 0;
+				boost::shared_ptr<T>& evt = events[next++];
+				if (evt.unique()) return evt;
+			}
+			events.push_back(boost::shared_ptr<T>(new T));
+			return events.back();
+		}
+
+		unsigned size() { scoped_lock lk(mutex); return events.size(); }
+
+	protected:
+		typedef boost::mutex::scoped_lock scoped_lock;
+
+		std::vector< boost::shared_ptr<T> > events;
+		unsigned next; // where to start looking for a free event
+		boost::mutex mutex;
+	};
+
+
 	class FeedbackChannel
 	{
 	public:
 		static void releaseAllChannels();
 
 	public:
-		FeedbackChannel(int semInd) : semaphoreIndex(semInd), isLogging(false) { }
+		FeedbackChannel(int semInd) : semaphoreIndex(semInd), isLogging(false), isDrained(false), signalPending(false) { }
 
 		FeedbackEventPtr front();
 		void pop();
 		void push(FeedbackEventPtr& ptr);
 		void setLogging(bool trueOrFalse);
 
+		// Copy as many events as fit into 'buffer' (see qFeedbackChannelDrain),
+		// and remove them from the channel.
+		int drain(char* buffer, int bufferSize);
+
 	protected:
 		typedef boost::mutex::scoped_lock scoped_lock;
 
 		int semaphoreIndex; // index of the Squeak semaphore to notify when an event arrives
 		bool isLogging;
+		bool isDrained;     // the reader drains, so one signal per batch is enough
+		bool signalPending; // signalled since the last drain
 		std::queue<FeedbackEventPtr> queue;
 		boost::mutex mutex;
 	};
@@ -0,0 +1,243 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qHandleTable.hpp
+ *  QwaqLib
+ *
+ *  Maps the integer handles that Squeak passes to primitives onto plugin-side
+ *  objects held by shared_ptr.  A handle is a slot index (low 16 bits) and
+ *  the slot's generation (next 14 bits), so handles are positive SmallIntegers
+ *  and a handle that outlives its object is refused rather than answering
+ *  whatever reuses the slot.
+ *
+ *  get() takes no lock: it pins the slot with a compare-and-swap on a word
+ *  holding the generation, a live bit and a pin count, copies the shared_ptr
+ *  and unpins.  add() and remove() are serialised by a mutex; remove() clears
+ *  the live bit and waits for pins to drain before releasing the object, which
+ *  is only ever a copy's worth of time.  Slots are allocated in chunks that
+ *  never move, so the table grows without disturbing readers.
+ */
+
+#ifndef __Q_HANDLE_TABLE_HPP__
+#define __Q_HANDLE_TABLE_HPP__
+
+#include <string.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/interprocess/detail/atomic.hpp>
+
+namespace Qwaq {
+
+template <class T>
+class HandleTable
+{
+	public:
+		typedef boost::shared_ptr<T> ptr_type;
+
+		HandleTable();
+		~HandleTable();
+
+		// Answer a new handle for 'object', or 0 if the table is full.
+		unsigned add(const ptr_type& object);
+
+		// Like add(), but takes ownership of a bare 'object' only once there
+		// is a slot for it; if the table is full, answer 0 and the caller
+		// still owns 'object'.
+		unsigned adopt(T* object);
+
+		// Answer the object with the given handle, or an empty pointer.
+		ptr_type get(unsigned handle);
+
+		// Forget the object with the given handle; answer false if there was
+		// none.  The object itself lives on for as long as others refer to it.
+		bool remove(unsigned handle);
+
+		// Forget every object.
+		void clear();
+
+		// Number of objects in the table.
+		unsigned size() { return count; }
+
+	protected:
+		typedef boost::uint32_t word_type;
+		typedef boost::mutex::scoped_lock scoped_lock;
+
+		enum {
+			INDEX_BITS = 16,
+			CHUNK_BITS = 8,
+			CHUNK_SIZE = 1 << CHUNK_BITS,
+			MAX_CHUNKS = (1 << INDEX_BITS) / CHUNK_SIZE,
+			MAX_GENERATION = (1 << 14) - 1,
+			PIN_MASK = 0x7FFF,			// word: pin count...
+			LIVE = 0x8000				// ...live bit, generation << 16
+		};
+
+		struct Slot
+		{
+			volatile word_type word;
+			unsigned nextFree;
+			ptr_type object;
+		};
+
+		Slot* volatile chunks[MAX_CHUNKS];
+		volatile word_type capacity;	// slots in allocated chunks
+		unsigned firstFree;		// index of a free slot, or capacity if none
+		unsigned count;
+		boost::mutex mutex;		// serialises add() and remove()
+
+		Slot* slotAt(unsigned index) { return &chunks[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]; }
+		static word_type generationOf(word_type word) { return word >> INDEX_BITS; }
+		bool grow();
+		unsigned insert(const ptr_type& object);
+};
+
+
+template <class T>
+HandleTable<T>::HandleTable()
+{
+	memset((void*)chunks, 0, sizeof(chunks));
+	capacity = firstFree = count = 0;
+}
+
+
+template <class T>
+HandleTable<T>::~HandleTable()
+{
+	clear();
+	for (unsigned i = 0; i < MAX_CHUNKS; i++) delete [] (Slot*)chunks[i];
+}
+
+
+template <class T>
+unsigned HandleTable<T>::add(const ptr_type& object)
+{
+	scoped_lock lk(mutex);
+	if (firstFree == capacity && !grow()) return 0;
+	return insert(object);
+}
+
+
+template <class T>
+unsigned HandleTable<T>::adopt(T* object)
+{
+	scoped_lock lk(mutex);
+	if (firstFree == capacity && !grow()) return 0;
+	return insert(ptr_type(object));
+}
+
+
+// Put 'object' in the first free slot.  Called with the mutex held, and
+// with a free slot.
+template <class T>
+unsigned HandleTable<T>::insert(const ptr_type& object)
+{
+	unsigned index = firstFree;
+	Slot* slot = slotAt(index);
+	firstFree = slot->nextFree;
+	count++;
+
+	slot->object = object;
+	// Publishing the live bit also publishes the object (the CAS is a barrier).
+	word_type word = slot->word;
+	boost::interprocess::detail::atomic_cas32(&slot->word, word | LIVE, word);
+	return (generationOf(word) << INDEX_BITS) | index;
+}
+
+
+template <class T>
+typename HandleTable<T>::ptr_type HandleTable<T>::get(unsigned handle)
+{
+	unsigned index = handle & ((1 << INDEX_BITS) - 1);
+	if (index >= capacity || !generationOf(handle)) return ptr_type();
+	Slot* slot = slotAt(index);
+
+	// Pin the slot, unless it is dead or has been reused.
+	for (;;) {
+		word_type word = slot->word;
+		if (!(word & LIVE) || generationOf(word) != generationOf(handle)) return ptr_type();
+		if ((word & PIN_MASK) == PIN_MASK) { boost::this_thread::yield(); continue; }
+		if (boost::interprocess::detail::atomic_cas32(&slot->word, word + 1, word) == word) break;
+	}
+	ptr_type result = slot->object;
+	boost::interprocess::detail::atomic_dec32(&slot->word);
+	return result;
+}
+
+
+template <class T>
+bool HandleTable<T>::remove(unsigned handle)
+{
+	ptr_type released;  // so that the object is destroyed after unlocking
+	{
+		scoped_lock lk(mutex);
+		unsigned index = handle & ((1 << INDEX_BITS) - 1);
+		if (index >= capacity || !generationOf(handle)) return false;
+		Slot* slot = slotAt(index);
+
+		// Clear the live bit, so that no new pins are taken...
+		word_type word;
+		for (;;) {
+			word = slot->word;
+			if (!(word & LIVE) || generationOf(word) != generationOf(handle)) return false;
+			if (boost::interprocess::detail::atomic_cas32(&slot->word, word & ~LIVE, word) == word) break;
+		}
+		// ...and wait for those in get() to finish copying.
+		while (boost::interprocess::detail::atomic_read32(&slot->word) & PIN_MASK)
+			boost::this_thread::yield();
+
+		released.swap(slot->object);
+		word_type generation = generationOf(word) == MAX_GENERATION ? 1 : generationOf(word) + 1;
+		boost::interprocess::detail::atomic_write32(&slot->word, generation << INDEX_BITS);
+		slot->nextFree = firstFree;
+		firstFree = index;
+		count--;
+	}
+	return true;
+}
+
+
+template <class T>
+void HandleTable<T>::clear()
+{
+	for (unsigned index = 0; index < capacity; index++) {
+		word_type word = slotAt(index)->word;
+		if (word & LIVE) remove((generationOf(word) << INDEX_BITS) | index);
+	}
+}
+
+
+// Add a chunk of free slots.  Called with the mutex held.
+template <class T>
+bool HandleTable<T>::grow()
+{
+	unsigned chunk = capacity >> CHUNK_BITS;
+	if (chunk >= MAX_CHUNKS) return false;
+	Slot* slots = new Slot[CHUNK_SIZE];
+	for (unsigned i = 0; i < CHUNK_SIZE; i++) {
+		slots[i].word = 1 << INDEX_BITS;  // generation 1, not live
+		slots[i].nextFree = capacity + i + 1;
+	}
+	chunks[chunk] = slots;
+	firstFree = capacity;
+	// The chunk must be visible before get() will look in it.
+	boost::interprocess::detail::atomic_cas32(&capacity, capacity + CHUNK_SIZE, capacity);
+	return true;
+}
+
+}; // namespace Qwaq
+
+#endif // #ifndef __Q_HANDLE_TABLE_HPP__
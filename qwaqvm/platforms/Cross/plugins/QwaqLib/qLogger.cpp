@@ -13,6 +13,20 @@
  *
  */
 
+/*
+ *  Once logging has been initialised, 'qerr' writes into a buffer belonging
+ *  to the calling thread rather than into the file.  Text is collected into
+ *  an entry until the entry is flushed (by 'flush', 'endl' or the start of
+ *  the thread's next qLog() entry), and is then copied as a record into the
+ *  thread's ring.  Each ring has a single writer (its thread) and a single
+ *  reader (whoever holds gOutputMutex), so neither side locks.  A background
+ *  thread empties the rings every LOG_WRITE_INTERVAL_MSECS, oldest record
+ *  first, formats the timestamps and writes to the file or to cerr.
+ *
+ *  A full ring discards records rather than holding up the thread (which may
+ *  be the audio ticker); the writer notes how many were lost.
+ */
+
 #include "qLogger.hpp"
 
 extern "C" {
@@ -24,8 +38,78 @@ extern struct VirtualMachine* interpreterProxy;
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
+#include <vector>
 //#include <windows.h>
+#include <stdio.h>
+#include <string.h>
 #include <time.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+typedef boost::mutex::scoped_lock scoped_lock;
+
+#ifdef WIN32
+#include <windows.h>
+#define qLogFence() MemoryBarrier()
+#else
+#define qLogFence() __sync_synchronize()
+#endif
+
+const unsigned LOG_RING_BYTES = 64 * 1024;		// per thread; a power of two
+const unsigned LOG_MAX_ENTRY = 1024;			// longer entries are split
+const int LOG_WRITE_INTERVAL_MSECS = 20;
+const usqLong SECONDS_FROM_1901_TO_1970 = 2177452800ULL;
+
+struct QLogRecord
+{
+	usqLong microseconds;	// interpreterProxy->utcMicroseconds() when the entry began
+	unsigned size;			// bytes of text following the record
+	unsigned stamped;		// started by qLog(), so gets a new line and the time
+};
+
+
+class QLogThreadBuffer
+{
+	public:
+		QLogThreadBuffer();
+		~QLogThreadBuffer();
+
+		// Owning thread only.
+		void startEntry();
+		void append(const char* text, unsigned size);
+		void commit();
+
+		// Only with gOutputMutex held.
+		bool peek(QLogRecord& record);
+		void take(QLogRecord& record, char* text);
+
+		volatile unsigned dropped;		// records discarded because the ring was full
+		unsigned droppedReported;
+		volatile bool retired;			// the owning thread has exited
+
+	protected:
+		char* ring;
+		volatile unsigned writePos;		// bytes ever written
+		volatile unsigned readPos;		// bytes ever read
+		QLogRecord entry;
+		char entryText[LOG_MAX_ENTRY];
+		bool entryOpen;
+
+		void copyIn(unsigned pos, const void* src, unsigned size);
+		void copyOut(unsigned pos, void* dst, unsigned size);
+};
+
+
+// Routes everything written to 'qerr' into the calling thread's buffer.
+class QLogStreamBuf : public std::streambuf
+{
+	protected:
+		virtual int_type overflow(int_type c);
+		virtual std::streamsize xsputn(const char* s, std::streamsize n);
+		virtual int sync();
+};
+
 
 std::ostream qerr(NULL);
 std::ostream qnull(NULL);
@@ -33,32 +117,357 @@ static std::ofstream *gpFileStream;
 static std::string gFileName;
 int gVerbosity;
 static void cacheLogTime();
+static void formatLogTime(time_t seconds, char* buffer);
 
-void qInitLogging()
+static QLogStreamBuf gLogStreamBuf;
+static volatile bool gRunning = false;
+static boost::thread* gWriter = NULL;
+static volatile bool gWriterStopping;
+
+// Threads' buffers outlive the threads until they have been emptied.
+static void retireThreadBuffer(QLogThreadBuffer* buffer);
+static boost::thread_specific_ptr<QLogThreadBuffer> gThreadBuffer(retireThreadBuffer);
+static std::vector<QLogThreadBuffer*> gThreadBuffers;
+static boost::mutex gRegistryMutex;	// guards gThreadBuffers
+
+// Guards the output (gpFileStream and the rotation settings), and makes the
+// holder the only reader of the rings.
+static boost::mutex gOutputMutex;
+static std::streamoff gFileBytes;
+static unsigned gMaxFileBytes = 0;	// 0: never rotate
+static unsigned gMaxOldFiles = 0;
+static volatile unsigned gDroppedTotal = 0;
+
+
+QLogThreadBuffer::QLogThreadBuffer()
 {
-	gpFileStream = NULL;
-	gFileName = "";
-	qerr.rdbuf(std::cerr.rdbuf());
-	gVerbosity = 0;
-	/* update the cached log time every second on the second. */
-	interpreterProxy->addSynchronousTickee(cacheLogTime, 1000, 1000);
+	ring = (char*) malloc(LOG_RING_BYTES);
+	writePos = readPos = 0;
+	dropped = droppedReported = 0;
+	retired = false;
+	entryOpen = false;
+}
+
+
+QLogThreadBuffer::~QLogThreadBuffer()
+{
+	free(ring);
+}
+
+
+void QLogThreadBuffer::startEntry()
+{
+	commit();
+	entry.microseconds = interpreterProxy->utcMicroseconds();
+	entry.size = 0;
+	entry.stamped = 1;
+	entryOpen = true;
+}
+
+
+void QLogThreadBuffer::append(const char* text, unsigned size)
+{
+	while (size) {
+		if (!entryOpen) {
+			// Text written without qLog(), e.g. qerr << "  (already running)".
+			entry.microseconds = interpreterProxy->utcMicroseconds();
+			entry.size = 0;
+			entry.stamped = 0;
+			entryOpen = true;
+		}
+		unsigned n = LOG_MAX_ENTRY - entry.size;
+		if (n > size) n = size;
+		memcpy(entryText + entry.size, text, n);
+		entry.size += n;
+		text += n;
+		size -= n;
+		if (entry.size == LOG_MAX_ENTRY) commit();
+	}
+}
+
+
+void QLogThreadBuffer::commit()
+{
+	if (!entryOpen) return;
+	entryOpen = false;
+	if (!entry.size && !entry.stamped) return;
+	if (!ring) { dropped++; return; }
+
+	unsigned need = sizeof(entry) + entry.size;
+	unsigned w = writePos;
+	qLogFence();  // see the reader's latest readPos
+	if (LOG_RING_BYTES - (w - readPos) < need) {
+		dropped++;
+		return;
+	}
+	copyIn(w, &entry, sizeof(entry));
+	copyIn(w + sizeof(entry), entryText, entry.size);
+	qLogFence();  // the record must be complete before the reader sees it
+	writePos = w + need;
+}
+
+
+bool QLogThreadBuffer::peek(QLogRecord& record)
+{
+	unsigned r = readPos;
+	if (writePos == r) return false;
+	qLogFence();  // see the records that writePos covers
+	copyOut(r, &record, sizeof(record));
+	return true;
+}
+
+
+void QLogThreadBuffer::take(QLogRecord& record, char* text)
+{
+	unsigned r = readPos;
+	copyOut(r, &record, sizeof(record));
+	copyOut(r + sizeof(record), text, record.size);
+	qLogFence();  // finish reading before the writer may reuse the bytes
+	readPos = r + sizeof(record) + record.size;
+}
+
+
+void QLogThreadBuffer::copyIn(unsigned pos, const void* src, unsigned size)
+{
+	unsigned offset = pos & (LOG_RING_BYTES - 1);
+	unsigned first = LOG_RING_BYTES - offset;
+	if (first > size) first = size;
+	memcpy(ring + offset, src, first);
+	memcpy(ring, (const char*)src + first, size - first);
+}
+
+
+void QLogThreadBuffer::copyOut(unsigned pos, void* dst, unsigned size)
+{
+	unsigned offset = pos & (LOG_RING_BYTES - 1);
+	unsigned first = LOG_RING_BYTES - offset;
+	if (first > size) first = size;
+	memcpy(dst, ring + offset, first);
+	memcpy((char*)dst + first, ring, size - first);
+}
+
+
+static QLogThreadBuffer* threadBuffer()
+{
+	QLogThreadBuffer* buffer = gThreadBuffer.get();
+	if (!buffer) {
+		buffer = new QLogThreadBuffer;
+		{
+			scoped_lock lk(gRegistryMutex);
+			gThreadBuffers.push_back(buffer);
+		}
+		gThreadBuffer.reset(buffer);
+	}
+	return buffer;
+}
+
+
+// Called as a thread exits.  The writer deletes the buffer once it is empty.
+static void retireThreadBuffer(QLogThreadBuffer* buffer)
+{
+	buffer->commit();
+	qLogFence();
+	buffer->retired = true;
+}
+
+
+QLogStreamBuf::int_type QLogStreamBuf::overflow(int_type c)
+{
+	if (!traits_type::eq_int_type(c, traits_type::eof())) {
+		char ch = traits_type::to_char_type(c);
+		threadBuffer()->append(&ch, 1);
+	}
+	return traits_type::not_eof(c);
+}
+
+
+std::streamsize QLogStreamBuf::xsputn(const char* s, std::streamsize n)
+{
+	threadBuffer()->append(s, (unsigned)n);
+	return n;
+}
+
+
+int QLogStreamBuf::sync()
+{
+	threadBuffer()->commit();
+	return 0;
+}
+
+
+static void writeText(const char* text, unsigned size)
+{
+	if (gpFileStream != NULL) {
+		gpFileStream->write(text, size);
+		gFileBytes += size;
+	}
+	else std::cerr.write(text, size);
+}
+
+
+static void writeRecord(const QLogRecord& record, const char* text)
+{
+	static time_t formattedSeconds = 0;
+	static char formattedTime[26];
+
+	if (record.stamped) {
+		time_t seconds = (time_t)(record.microseconds / 1000000 - SECONDS_FROM_1901_TO_1970);
+		if (seconds != formattedSeconds) {
+			formatLogTime(seconds, formattedTime);
+			formattedSeconds = seconds;
+		}
+		writeText("\n", 1);
+		writeText(formattedTime, strlen(formattedTime));
+		writeText(" :  ", 4);
+	}
+	writeText(text, record.size);
+}
+
+
+static std::string oldLogFileName(unsigned n)
+{
+	std::ostringstream name;
+	name << gFileName << "." << n;
+	return name.str();
+}
+
+
+static void openLogFile()
+{
+	gpFileStream = new std::ofstream(gFileName.c_str(), std::ios::app);
+	if (gpFileStream->fail()) {
+		delete gpFileStream;
+		gpFileStream = NULL;
+		return;
+	}
+	gpFileStream->seekp(0, std::ios::end);
+	gFileBytes = gpFileStream->tellp();
 }
 
+
 // If we currently have a file open, close it.
 static void closeLogFile()
 {
 	if (gpFileStream != NULL) {
-		qerr.rdbuf(std::cerr.rdbuf());
 		gpFileStream->close();
 		delete gpFileStream;
 		gpFileStream = NULL;
 	}
 }
 
+
+// Move 'name' to 'name.1', 'name.1' to 'name.2' and so on, forgetting the
+// oldest, and start a new 'name'.
+static void rotateLogFile()
+{
+	closeLogFile();
+	remove((gMaxOldFiles ? oldLogFileName(gMaxOldFiles) : gFileName).c_str());
+	for (unsigned n = gMaxOldFiles; n > 1; n--)
+		rename(oldLogFileName(n - 1).c_str(), oldLogFileName(n).c_str());
+	if (gMaxOldFiles) rename(gFileName.c_str(), oldLogFileName(1).c_str());
+	openLogFile();
+}
+
+
+// Write out every record in the rings, oldest first.  Once a thread's entry
+// has been started, its continuations follow it without other threads'
+// records in between.
+static void writeRecords()
+{
+	static char text[LOG_MAX_ENTRY];
+	scoped_lock lk(gOutputMutex);
+	std::vector<QLogThreadBuffer*> buffers;
+	QLogRecord record;
+
+	{
+		scoped_lock rlk(gRegistryMutex);
+		std::vector<QLogThreadBuffer*>::iterator it = gThreadBuffers.begin();
+		while (it != gThreadBuffers.end()) {
+			if ((*it)->retired && !(*it)->peek(record)) {
+				delete *it;
+				it = gThreadBuffers.erase(it);
+			}
+			else ++it;
+		}
+		buffers = gThreadBuffers;
+	}
+
+	bool wrote = false;
+	for (;;) {
+		QLogThreadBuffer* oldest = NULL;
+		usqLong oldestTime = 0;
+		for (unsigned i = 0; i < buffers.size(); i++) {
+			if (buffers[i]->peek(record) && (!oldest || record.microseconds < oldestTime)) {
+				oldest = buffers[i];
+				oldestTime = record.microseconds;
+			}
+		}
+		if (!oldest) break;
+		do {
+			oldest->take(record, text);
+			writeRecord(record, text);
+		} while (oldest->peek(record) && !record.stamped);
+		wrote = true;
+	}
+
+	for (unsigned i = 0; i < buffers.size(); i++) {
+		unsigned dropped = buffers[i]->dropped;
+		if (dropped != buffers[i]->droppedReported) {
+			std::ostringstream note;
+			note << endl << "[qLogger: " << dropped - buffers[i]->droppedReported
+				 << " entries were lost because a thread's log buffer was full]";
+			writeText(note.str().data(), note.str().size());
+			gDroppedTotal += dropped - buffers[i]->droppedReported;
+			buffers[i]->droppedReported = dropped;
+			wrote = true;
+		}
+	}
+
+	if (!wrote) return;
+	if (gpFileStream != NULL) {
+		gpFileStream->flush();
+		if (gMaxFileBytes && gFileBytes >= (std::streamoff)gMaxFileBytes) rotateLogFile();
+	}
+	else std::cerr.flush();
+}
+
+
+static void writerLoop()
+{
+	while (!gWriterStopping) {
+		writeRecords();
+		boost::this_thread::sleep(boost::posix_time::milliseconds(LOG_WRITE_INTERVAL_MSECS));
+	}
+	writeRecords();
+}
+
+
+void qInitLogging()
+{
+	gpFileStream = NULL;
+	gFileName = "";
+	gVerbosity = 0;
+	qerr.rdbuf(&gLogStreamBuf);
+	gRunning = true;
+	gWriterStopping = false;
+	if (!gWriter) gWriter = new boost::thread(writerLoop);
+	/* update the cached log time every second on the second. */
+	interpreterProxy->addSynchronousTickee(cacheLogTime, 1000, 1000);
+}
+
 void qShutdownLogging()
 {
 	interpreterProxy->addSynchronousTickee(cacheLogTime, 0, 0);
 	qerr.flush();
+	gRunning = false;
+	if (gWriter) {
+		gWriterStopping = true;
+		gWriter->join();
+		delete gWriter;
+		gWriter = NULL;
+	}
+	qerr.rdbuf(std::cerr.rdbuf());
+	scoped_lock lk(gOutputMutex);
 	closeLogFile();
 }
 
@@ -69,18 +478,22 @@ void qLogToFile(std::string fileName)
 			<< "Changing error output from: " 
 			<< (gFileName.empty() ? "cerr" : gFileName)
 			<< "  to: "
-			<< (fileName.empty() ? "cerr" : fileName);			
-	gFileName = fileName;
+			<< (fileName.empty() ? "cerr" : fileName)
+			<< flush;
+	writeRecords();  // so that the message goes to the old output
 
-	// If we currently have a file open, close it.
-	closeLogFile();
+	{
+		scoped_lock lk(gOutputMutex);
+		gFileName = fileName;
 
-	// If a new fileName is specified, attempt to open and use
-	// the file with that name.
+		// If we currently have a file open, close it.
+		closeLogFile();
+
+		// If a new fileName is specified, attempt to open and use
+		// the file with that name.
+		if (!gFileName.empty()) openLogFile();
+	}
 	if (gFileName.empty()) return;  // no file was specified.
-	gpFileStream = new std::ofstream(gFileName.c_str(), std::ios::app);
-	if (gpFileStream != NULL)
-		qerr.rdbuf(gpFileStream->rdbuf());
 
 	qerr	<< endl
 			<< "Error output changed to: "
@@ -95,6 +508,17 @@ void qLogToFile(const char* fileName)
 }
 
 
+void qSetLogRotation(unsigned maxFileBytes, unsigned maxOldFiles)
+{
+	scoped_lock lk(gOutputMutex);
+	gMaxFileBytes = maxFileBytes;
+	gMaxOldFiles = maxOldFiles;
+}
+
+
+unsigned qGetLogDroppedCount() { return gDroppedTotal; }
+
+
 void qSetLogVerbosity(int verbosityLevel)
 {
 	qLog() << "changing log verbosity from: " << gVerbosity << "  to: " << verbosityLevel << flush;
@@ -108,16 +532,22 @@ int qGetLogVerbosity() { return gVerbosity; }
 static char cached_log_time[26];
 
 static void
-cacheLogTime()
+formatLogTime(time_t seconds, char* buffer)
 {
-	time_t rawtime;
-	time(&rawtime);
 #if defined(WIN32)
-	strcpy(cached_log_time,ctime(&rawtime));
+	ctime_s(buffer, 26, &seconds);
 #else
-	ctime_r(&rawtime,cached_log_time);
+	ctime_r(&seconds, buffer);
 #endif
-	cached_log_time[24] = 0; // hack: trim off carriage return at end of string
+	buffer[24] = 0; // hack: trim off carriage return at end of string
+}
+
+static void
+cacheLogTime()
+{
+	time_t rawtime;
+	time(&rawtime);
+	formatLogTime(rawtime, cached_log_time);
 }
 
 // Current time in format: Www Mmm dd hh:mm:ss yyyy
@@ -133,7 +563,8 @@ std::ostream& qLog()
 std::ostream& qLog(int verbosity)
 {
 	if (verbosity <= gVerbosity) {
-		qerr << endl << qTime() << " :  ";
+		if (gRunning) threadBuffer()->startEntry();
+		else qerr << endl << qTime() << " :  ";
 		return qerr;
 	}
 	return qnull;
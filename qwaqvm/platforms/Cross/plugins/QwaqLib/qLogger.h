@@ -25,6 +25,12 @@
  * In order to use this in a plugin, you must call qInitLogging() and
  * qShutdownLogging() from initialise/shutdownModule(), respectively.
  *
+ * Logging doesn't block: each thread's output is buffered and written out
+ * by a background thread, so an entry appears once it has been flushed
+ * (with 'flush' or 'endl') or the thread has started its next entry.  If a
+ * thread logs faster than it can be written out, entries are dropped and
+ * the loss is noted in the log.
+ *
  ******************************************************************************/
 
 
@@ -43,6 +49,14 @@ void qLogToFile(const char* fileName);
 void qSetLogVerbosity(int verbosityLevel);
 int qGetLogVerbosity();
 
+// Once the log-file reaches maxFileBytes, rename it to 'fileName.1' (and
+// 'fileName.1' to 'fileName.2', and so on, keeping maxOldFiles of them) and
+// start a new one.  A maxFileBytes of 0 (the default) never rotates.
+void qSetLogRotation(unsigned maxFileBytes, unsigned maxOldFiles);
+
+// Number of entries dropped so far because a thread's buffer was full.
+unsigned qGetLogDroppedCount();
+
 // Hacky functions so that we can still log from C files (not only C++)
 void qLogFromC(const char* stringToLog);
 void qLogResultFromC(const char* stringToLog, int result);
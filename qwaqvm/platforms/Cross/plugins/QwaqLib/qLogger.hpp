@@ -42,4 +42,12 @@ std::ostream& qLog();
 // silently gobbles any output.
 std::ostream& qLog(int verbosity);
 
+extern int gVerbosity;
+inline bool qLogEnabled(int verbosity) { return verbosity <= gVerbosity; }
+
+// Like qLog(verbosity), but the rest of the statement isn't evaluated at all
+// unless the entry would be logged.  Use this on the audio tick path, e.g.
+//    QLOG(8) << "(tick)" << flush;
+#define QLOG(verbosity) if (!qLogEnabled(verbosity)) ; else qLog(verbosity)
+
 #endif // #ifndef __Q_LOGGER_HPP__
@@ -19,8 +19,8 @@
  *
  *  This code snippet is intended to be inserted into a class declaration.  By 
  *  following a few simple rules (described below), new class instances are 
- *  automatically registered in a map with an automatically-assigned integer key.
- *  The map contains a reference-counting shared-pointer to the object.
+ *  automatically registered in a table with an automatically-assigned integer key.
+ *  The table contains a reference-counting shared-pointer to the object.
  *
  *  The typical usage is for plugin-side objects that Squeak code needs to refer
  *  to in repeated primitive calls.  Why the shared-pointers?  The (ill-conceived?)
@@ -30,12 +30,21 @@
  *  is used, for example, by QAudioPlugin "tickees" so that Squeak can immediately
  *  release them even if it might be in use by the high-priority ticker thread.
  *
+ *  Keys are Qwaq::HandleTable handles (see qHandleTable.hpp): withKey() doesn't
+ *  lock, and a key that has been released stays invalid even once its slot is
+ *  reused by another instance.
+ *
  *  Requirements/Usage:
- *      - client class must already #include std::map, boost::shared_ptr, and boost::mutex::scoped_lock
+ *      - client class must already #include qHandleTable.hpp
  *		- instances of client classes MUST be allocated on the heap via 'new'.
  *      - 'ptr_type' must be defined by client class
  *			- eg: 'typedef boost::shared_ptr<CLIENT_CLASS> ptr_type;
+ *		- define the table in the client's .cpp
+ *			- eg: 'CLIENT_CLASS::table_type CLIENT_CLASS::s_Table;'
  *		- use 'addToMap()' in the client class constructor
+ *		- when all 65536 keys are in use, 'addToMap()' throws TableFull and
+ *		  the instance is freed as for any throwing constructor; factories
+ *		  should catch it and answer key 0 so that the primitive fails.
  *      - use 'withKey()' to obtain the client class instance with the given key.
  *		- use 'releaseKey()' when the client class instance is no longer needed.
  */
@@ -43,51 +52,33 @@
 public:
 	unsigned key() { return m_Key; }
 	ptr_type ptr() { return withKey(m_Key); }
+
+	struct TableFull {};
 	
 protected:
-	typedef std::map<unsigned, ptr_type> map_type;
-	typedef map_type::iterator iterator_type;
+	typedef Qwaq::HandleTable<ptr_type::element_type> table_type;
 	
 	unsigned m_Key;
 
-	static boost::mutex s_Mutex;
-	static map_type s_Map;
-	static unsigned s_Key;  // Would like "s_Key = 1;" but compiler barfs.
-	static unsigned nextKey() {
-		// Valid range is 1..UINT_MAX.  Here because I can't init s_Key in-line.
-		if (s_Key == 0) s_Key = 1;  // 
-	
-		// XXXXX: if your map is full, you're screwed
-		while(true) {
-			iterator_type it = s_Map.find(s_Key);
-			if (it == s_Map.end()) return s_Key;  // found an empty slot
-			if (++s_Key == UINT_MAX) s_Key = 1;
-		}
-	}
+	static table_type s_Table;
 
 public:
 	static ptr_type withKey(unsigned key) {
-		scoped_lock lk(s_Mutex);
-		iterator_type it = s_Map.find(key);
-		ptr_type result;
-		if (it != s_Map.end()) result = it->second;
-		return result;
+		return s_Table.get(key);
 	}
 	
 	static void releaseKey(unsigned key) {
-		scoped_lock lk(s_Mutex);
-		iterator_type it = s_Map.find(key);
-		if (it != s_Map.end()) s_Map.erase(it);
+		s_Table.remove(key);
 	}
 	
 	static void releaseAll() {
-		scoped_lock lk(s_Mutex);
-		s_Map.clear();
+		s_Table.clear();
 	}
 	
 private:
 	void addToMap() {
-		scoped_lock lk(s_Mutex);
-		m_Key = nextKey();
-		s_Map[m_Key] = ptr_type(this);
+		// The table only takes ownership if it has room, so that a full
+		// table doesn't delete the instance out from under its constructor.
+		m_Key = s_Table.adopt(this);
+		if (!m_Key) throw TableFull();
 	}
@@ -0,0 +1,455 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qTrace.cpp
+ *  QwaqLib (cross-platform)
+ *
+ *  Each thread that records an event gets a ring of fixed-size records.  As
+ *  with qLogger's rings, the thread is the only writer and whoever holds
+ *  gDrainMutex the only reader, so neither locks; a full ring drops events
+ *  rather than hold up the thread.  Records hold a pointer to their name and
+ *  a reading of a monotonic clock, which unlike utcMicroseconds (updated by
+ *  the heartbeat) resolves the microseconds that codec work takes.
+ */
+
+#include "qTrace.hpp"
+
+extern "C" {
+extern struct VirtualMachine* interpreterProxy;
+}
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+typedef boost::mutex::scoped_lock scoped_lock;
+
+#ifdef WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+// A writer only needs its stores to stay in order, which x86 keeps without
+// a fence; the reader fences fully, as qLogger's do.
+#ifdef WIN32
+#define qTraceFence() MemoryBarrier()
+#define qTraceWriteFence() _WriteBarrier()
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define qTraceFence() __sync_synchronize()
+#define qTraceWriteFence() __asm__ __volatile__("" ::: "memory")
+#else
+#define qTraceFence() __sync_synchronize()
+#define qTraceWriteFence() __sync_synchronize()
+#endif
+
+using namespace Qwaq;
+
+const unsigned TRACE_RING_EVENTS = 4096;	// per thread; a power of two
+
+struct QTraceRecord
+{
+	usqLong nanoseconds;	// clockNanoseconds()
+	const char* name;
+	int value;
+	unsigned short category;
+	unsigned short kind;
+};
+
+// As copied for Squeak by qTraceDrainInto().
+#pragma pack(push, 1)
+struct QTraceDrainedHeader
+{
+	int version;
+	int numEvents;
+	int numDropped;
+	int namesSize;
+	int res1, res2, res3, res4;  // reserved
+	usqLong originMicroseconds;
+};
+struct QTraceDrainedEvent
+{
+	usqLong nanoseconds;
+	int value;
+	int nameOffset;			// into the names following the events
+	unsigned short category;
+	unsigned short kind;
+	unsigned thread;
+};
+#pragma pack(pop)
+
+
+class QTraceThreadBuffer
+{
+	public:
+		QTraceThreadBuffer(unsigned thread) : thread(thread), name(NULL), dropped(0), droppedReported(0), retired(false), writePos(0), readPos(0) { }
+
+		// Owning thread only.
+		void record(unsigned category, int kind, const char* eventName, int value, usqLong nanoseconds)
+		{
+			unsigned w = writePos;
+			if (w - readPos >= TRACE_RING_EVENTS) { dropped++; return; }
+			QTraceRecord& r = ring[w & (TRACE_RING_EVENTS - 1)];
+			r.nanoseconds = nanoseconds;
+			r.name = eventName;
+			r.value = value;
+			r.category = (unsigned short)category;
+			r.kind = (unsigned short)kind;
+			qTraceWriteFence();  // the record must be complete before the reader sees it
+			writePos = w + 1;
+		}
+
+		// Only with gDrainMutex held.
+		void drain(std::vector<QTraceEvent>& events, usqLong origin);
+
+		unsigned thread;
+		const char* volatile name;
+		volatile unsigned dropped;		// events discarded because the ring was full
+		unsigned droppedReported;
+		volatile bool retired;			// the owning thread has exited
+
+	protected:
+		volatile unsigned writePos;		// events ever written
+		volatile unsigned readPos;		// events ever read
+		QTraceRecord ring[TRACE_RING_EVENTS];
+};
+
+
+volatile unsigned gTraceCategories = 0;
+static usqLong gOriginNanoseconds = 0;
+static usqLong gOriginMicroseconds = 0;
+
+// Threads' buffers outlive the threads until they have been drained.
+static void retireThreadBuffer(QTraceThreadBuffer* buffer);
+static boost::thread_specific_ptr<QTraceThreadBuffer> gThreadBuffer(retireThreadBuffer);
+#if defined(__GNUC__) && !defined(__APPLE__)
+// A compiler-supported copy is much quicker to look up; the boost one is
+// still needed to hear when the thread exits.
+static __thread QTraceThreadBuffer* tThreadBuffer = NULL;
+#define QTRACE_FAST_THREAD_BUFFER 1
+#endif
+static std::vector<QTraceThreadBuffer*> gThreadBuffers;
+static unsigned gThreadCount = 0;
+static unsigned gDroppedByRetired = 0;
+static boost::mutex gRegistryMutex;	// guards the above
+
+// Makes the holder the only reader of the rings, and guards what has been
+// read from them but not yet taken by qTraceDrainInto().
+static boost::mutex gDrainMutex;
+static std::vector<QTraceEvent> gPending;
+static unsigned gPendingDropped = 0;
+
+
+static usqLong clockNanoseconds()
+{
+#ifdef WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER now;
+	if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (usqLong)(now.QuadPart / (double)frequency.QuadPart * 1e9);
+#elif defined(__APPLE__)
+	static mach_timebase_info_data_t timebase = { 0, 0 };
+	if (!timebase.denom) mach_timebase_info(&timebase);
+	return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (usqLong)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+
+void QTraceThreadBuffer::drain(std::vector<QTraceEvent>& events, usqLong origin)
+{
+	QTraceEvent event;
+	event.thread = thread;
+
+	unsigned w = writePos;
+	unsigned r = readPos;
+	if (w == r) return;
+	qTraceFence();  // see the records that writePos covers
+
+	if (name) {
+		event.nanoseconds = 0;
+		event.name = name;
+		event.value = 0;
+		event.category = 0;
+		event.kind = 'M';
+		events.push_back(event);
+	}
+	for (; r != w; r++) {
+		const QTraceRecord& record = ring[r & (TRACE_RING_EVENTS - 1)];
+		event.nanoseconds = record.nanoseconds > origin ? record.nanoseconds - origin : 0;
+		event.name = record.name;
+		event.value = record.value;
+		event.category = record.category;
+		event.kind = record.kind;
+		events.push_back(event);
+	}
+	qTraceFence();  // finish reading before the writer may reuse the records
+	readPos = w;
+}
+
+
+static QTraceThreadBuffer* threadBuffer()
+{
+#if QTRACE_FAST_THREAD_BUFFER
+	if (tThreadBuffer) return tThreadBuffer;
+#endif
+	QTraceThreadBuffer* buffer = gThreadBuffer.get();
+	if (!buffer) {
+		{
+			scoped_lock lk(gRegistryMutex);
+			buffer = new QTraceThreadBuffer(++gThreadCount);
+			gThreadBuffers.push_back(buffer);
+		}
+		gThreadBuffer.reset(buffer);
+	}
+#if QTRACE_FAST_THREAD_BUFFER
+	tThreadBuffer = buffer;
+#endif
+	return buffer;
+}
+
+
+// Called as a thread exits.  A drain deletes the buffer once it is empty, so
+// anything the thread still traces while exiting must not find it again.
+static void retireThreadBuffer(QTraceThreadBuffer* buffer)
+{
+#if QTRACE_FAST_THREAD_BUFFER
+	if (tThreadBuffer == buffer) tThreadBuffer = NULL;
+#endif
+	qTraceFence();
+	buffer->retired = true;
+}
+
+
+void qTraceSetCategories(unsigned categories)
+{
+	if (categories && !gOriginNanoseconds) {
+		gOriginNanoseconds = clockNanoseconds();
+		gOriginMicroseconds = interpreterProxy->utcMicroseconds();
+	}
+	gTraceCategories = categories;
+}
+
+
+unsigned qTraceGetCategories(void)
+{
+	return gTraceCategories;
+}
+
+
+void qTraceSetThreadName(const char* name)
+{
+	threadBuffer()->name = name;
+}
+
+
+void qTraceRecord(unsigned category, int kind, const char* name, int value)
+{
+	threadBuffer()->record(category, kind, name, value, clockNanoseconds());
+}
+
+
+unsigned qTraceGetDroppedCount(void)
+{
+	scoped_lock lk(gRegistryMutex);
+	unsigned total = gDroppedByRetired;
+	for (unsigned i = 0; i < gThreadBuffers.size(); i++) total += gThreadBuffers[i]->dropped;
+	return total;
+}
+
+
+// Called with gDrainMutex held.
+static unsigned drainRings(std::vector<QTraceEvent>& events)
+{
+	std::vector<QTraceThreadBuffer*> buffers;
+	{
+		scoped_lock rlk(gRegistryMutex);
+		buffers = gThreadBuffers;
+	}
+
+	unsigned dropped = 0;
+	for (unsigned i = 0; i < buffers.size(); i++) {
+		QTraceThreadBuffer* buffer = buffers[i];
+		// Read 'retired' first: once it is set, nothing more will be written.
+		bool retired = buffer->retired;
+		qTraceFence();
+		buffer->drain(events, gOriginNanoseconds);
+		unsigned d = buffer->dropped;
+		dropped += d - buffer->droppedReported;
+		buffer->droppedReported = d;
+		if (retired) {
+			scoped_lock rlk(gRegistryMutex);
+			gDroppedByRetired += d;
+			for (std::vector<QTraceThreadBuffer*>::iterator it = gThreadBuffers.begin(); it != gThreadBuffers.end(); ++it) {
+				if (*it == buffer) { gThreadBuffers.erase(it); break; }
+			}
+			delete buffer;
+		}
+	}
+	return dropped;
+}
+
+
+unsigned Qwaq::qTraceDrain(std::vector<QTraceEvent>& events)
+{
+	scoped_lock lk(gDrainMutex);
+	events.insert(events.end(), gPending.begin(), gPending.end());
+	gPending.clear();
+	unsigned dropped = gPendingDropped + drainRings(events);
+	gPendingDropped = 0;
+	return dropped;
+}
+
+
+usqLong Qwaq::qTraceOriginMicroseconds()
+{
+	return gOriginMicroseconds;
+}
+
+
+usqLong Qwaq::qTraceNanoseconds()
+{
+	return clockNanoseconds();
+}
+
+
+static const char* categoryName(unsigned category)
+{
+	switch (category) {
+		case QTraceTicks: return "ticks";
+		case QTraceCodecs: return "codecs";
+		case QTraceFeedback: return "feedback";
+		case QTracePrimitives: return "primitives";
+	}
+	return "other";
+}
+
+
+static void writeJsonString(std::ostream& out, const char* s)
+{
+	out << '"';
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') out << '\\' << *s;
+		else if ((unsigned char)*s < ' ') out << ' ';
+		else out << *s;
+	}
+	out << '"';
+}
+
+
+void Qwaq::qTraceWriteChrome(const std::vector<QTraceEvent>& events, std::ostream& out, bool first)
+{
+	if (first) out << "[\n";
+	for (std::vector<QTraceEvent>::const_iterator it = events.begin(); it != events.end(); ++it) {
+		if (it->kind == 'M') {
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->thread << ",\"args\":{\"name\":";
+			writeJsonString(out, it->name);
+			out << "}},\n";
+			continue;
+		}
+		// Microseconds, to the nanosecond.
+		char ts[32];
+		sprintf(ts, "%llu.%03u", (unsigned long long)(it->nanoseconds / 1000), (unsigned)(it->nanoseconds % 1000));
+		out << "{\"name\":";
+		writeJsonString(out, it->name);
+		out << ",\"cat\":\"" << categoryName(it->category) << "\",\"ph\":\"" << (char)it->kind
+			<< "\",\"ts\":" << ts << ",\"pid\":1,\"tid\":" << it->thread;
+		if (it->kind == QTraceInstant) out << ",\"s\":\"t\",\"args\":{\"value\":" << it->value << "}";
+		else if (it->kind == QTraceCounter) out << ",\"args\":{\"value\":" << it->value << "}";
+		out << "},\n";
+	}
+}
+
+
+int qTraceDrainInto(char* buffer, int bufferSize)
+{
+	scoped_lock lk(gDrainMutex);
+	gPendingDropped += drainRings(gPending);
+
+	// Take events while they fit, storing each name once, where first met.
+	std::map<const char*, int> nameOffsets;
+	std::string names;
+	std::vector<QTraceDrainedEvent> drained;
+	int used = sizeof(QTraceDrainedHeader);
+	unsigned count = 0;
+	for (; count < gPending.size(); count++) {
+		const QTraceEvent& event = gPending[count];
+		std::map<const char*, int>::iterator it = nameOffsets.find(event.name);
+		int nameSize = (it == nameOffsets.end()) ? strlen(event.name) + 1 : 0;
+		int need = used + sizeof(QTraceDrainedEvent) + nameSize;
+		if (need > bufferSize) {
+			if (!count) return -need;
+			break;
+		}
+		used = need;
+		if (nameSize) {
+			it = nameOffsets.insert(std::make_pair(event.name, (int)names.size())).first;
+			names.append(event.name, nameSize);
+		}
+		QTraceDrainedEvent d;
+		d.nanoseconds = event.nanoseconds;
+		d.value = event.value;
+		d.nameOffset = it->second;
+		d.category = event.category;
+		d.kind = event.kind;
+		d.thread = event.thread;
+		drained.push_back(d);
+	}
+	if (used > bufferSize) return -used;  // not even room for the header
+
+	QTraceDrainedHeader* hdr = (QTraceDrainedHeader*)buffer;
+	hdr->version = 1;
+	hdr->numEvents = count;
+	hdr->numDropped = gPendingDropped;
+	hdr->namesSize = names.size();
+	hdr->res1 = hdr->res2 = hdr->res3 = hdr->res4 = 0;
+	hdr->originMicroseconds = gOriginMicroseconds;
+	char* ptr = buffer + sizeof(QTraceDrainedHeader);
+	if (count) memcpy(ptr, &drained[0], count * sizeof(QTraceDrainedEvent));
+	ptr += count * sizeof(QTraceDrainedEvent);
+	if (names.size()) memcpy(ptr, names.data(), names.size());
+
+	gPending.erase(gPending.begin(), gPending.begin() + count);
+	gPendingDropped = 0;
+	return used;
+}
+
+
+int qTraceWriteChromeFile(const char* fileName)
+{
+	bool first;
+	{
+		std::ifstream existing(fileName, std::ios::binary | std::ios::ate);
+		first = !existing.is_open() || existing.tellg() == (std::streampos)0;
+	}
+	std::ofstream out(fileName, std::ios::app | std::ios::binary);
+	if (!out.is_open()) return -1;
+
+	std::vector<QTraceEvent> events;
+	qTraceDrain(events);
+	qTraceWriteChrome(events, out, first);
+	out.close();
+	return out.fail() ? -1 : (int)events.size();
+}
@@ -0,0 +1,101 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/******************************************************************************
+ *
+ * qTrace.h
+ * QwaqLib (cross-platform)
+ *
+ * Timeline tracing for plugins: code marks the beginning and end of what it
+ * does, instants and counter values, each in a category that can be turned
+ * on and off.  Events go into a ring belonging to the calling thread, so
+ * recording one takes no lock; Squeak drains them all, or has them written
+ * out in Chrome's trace-event format (chrome://tracing) to see every thread
+ * on one timeline.
+ *
+ * With a category off, its QTRACE_* macros cost a test of a global.  Names
+ * must be string constants: only the pointer is recorded.
+ *
+ ******************************************************************************/
+
+
+#ifndef __Q_TRACE_H__
+#define __Q_TRACE_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Categories, to be traced or not together. */
+typedef enum {
+	QTraceTicks = 1,				/* the audio ticker and its tickees */
+	QTraceCodecs = 2,				/* encoding and decoding */
+	QTraceFeedback = 4,				/* feedback-channel pushes and drains */
+	QTracePrimitives = 8,			/* calls from Squeak */
+	QTraceAll = 0xFFFF
+} QTraceCategory;
+
+/* Kinds of event; the values are Chrome's "ph" letters. */
+typedef enum {
+	QTraceBegin = 'B',
+	QTraceEnd = 'E',
+	QTraceInstant = 'i',
+	QTraceCounter = 'C'
+} QTraceKind;
+
+/* Categories being traced; none at first. */
+extern volatile unsigned gTraceCategories;
+#define qTraceEnabled(category) (gTraceCategories & (category))
+
+void qTraceSetCategories(unsigned categories);
+unsigned qTraceGetCategories(void);
+
+/* Name the calling thread, for the exported timeline. */
+void qTraceSetThreadName(const char* name);
+
+/* Record an event, whether or not its category is on; see the macros. */
+void qTraceRecord(unsigned category, int kind, const char* name, int value);
+
+#define QTRACE_BEGIN(category, name) \
+	do { if (qTraceEnabled(category)) qTraceRecord((category), QTraceBegin, (name), 0); } while (0)
+#define QTRACE_END(category, name) \
+	do { if (qTraceEnabled(category)) qTraceRecord((category), QTraceEnd, (name), 0); } while (0)
+#define QTRACE_INSTANT(category, name, value) \
+	do { if (qTraceEnabled(category)) qTraceRecord((category), QTraceInstant, (name), (value)); } while (0)
+#define QTRACE_COUNTER(category, name, value) \
+	do { if (qTraceEnabled(category)) qTraceRecord((category), QTraceCounter, (name), (value)); } while (0)
+
+/* Number of events dropped so far because a thread's ring was full. */
+unsigned qTraceGetDroppedCount(void);
+
+/* Copy as many recorded events as fit into 'buffer', and forget them: a
+ * header (version, event count, events dropped since the last drain, bytes
+ * of names, 4 reserved ints, and the clock's origin as utcMicroseconds), the
+ * events (see QTraceDrainedEvent in qTrace.cpp), and their names, each
+ * NUL-terminated.  Answer the number of bytes used, or, if the next event
+ * doesn't fit into an empty buffer, minus the buffer size that it needs.
+ * Events that don't fit are kept for the next drain. */
+int qTraceDrainInto(char* buffer, int bufferSize);
+
+/* Take every recorded event and append it to a Chrome trace-event file,
+ * starting it if need be.  Answer the number of events written, or -1 if
+ * the file can't be written. */
+int qTraceWriteChromeFile(const char* fileName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //#ifndef __Q_TRACE_H__
@@ -0,0 +1,94 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qTrace.hpp
+ *  QwaqLib (cross-platform)
+ *
+ *  C++ additions to 'qTrace.h'.
+ */
+
+#ifndef __Q_TRACE_HPP__
+#define __Q_TRACE_HPP__
+
+#include <ostream>
+#include <vector>
+
+#include "qTrace.h"
+
+/* gcc version 4.1.2 20080704 (Red Hat 4.1.2-46) blows up compiling ctype defs
+ * if sqVirtualMachine.h is included early.
+ */
+#include "sqVirtualMachine.h"
+
+namespace Qwaq
+{
+
+// Traces the lifetime of a block, e.g.
+//    QTRACE_SCOPE(QTraceCodecs, "speex decode");
+class QTraceScope
+{
+	public:
+		QTraceScope(unsigned category, const char* name) : category(category), name(name)
+		{
+			active = qTraceEnabled(category) != 0;
+			if (active) qTraceRecord(category, QTraceBegin, name, 0);
+		}
+		~QTraceScope()
+		{
+			if (active) qTraceRecord(category, QTraceEnd, name, 0);
+		}
+
+	protected:
+		unsigned category;
+		const char* name;
+		bool active;
+};
+
+#define QTRACE_SCOPE_NAME2(line) qTraceScope##line
+#define QTRACE_SCOPE_NAME(line) QTRACE_SCOPE_NAME2(line)
+#define QTRACE_SCOPE(category, name) Qwaq::QTraceScope QTRACE_SCOPE_NAME(__LINE__)((category), (name))
+
+// An event as drained.  Each thread's events are in the order they happened.
+// A thread with a name starts with an event of kind 'M' naming it.
+struct QTraceEvent
+{
+	usqLong nanoseconds;	// since the clock's origin
+	const char* name;
+	int value;
+	unsigned short category;
+	unsigned short kind;
+	unsigned thread;		// numbered from 1 as threads first record
+};
+
+// Append every recorded event to 'events', and answer the number dropped
+// since the last drain.
+unsigned qTraceDrain(std::vector<QTraceEvent>& events);
+
+// utcMicroseconds at the clock's origin.
+usqLong qTraceOriginMicroseconds();
+
+// The clock that events are stamped with: monotonic, and fine enough to time
+// a codec call, in nanoseconds from an arbitrary origin.
+usqLong qTraceNanoseconds();
+
+// Write 'events' in Chrome's trace-event format: the opening '[' if 'first',
+// and then one object per line, each followed by a comma.  Chrome accepts
+// the array without its closing ']', so later drains can be appended.
+void qTraceWriteChrome(const std::vector<QTraceEvent>& events, std::ostream& out, bool first);
+
+}; // namespace Qwaq
+
+#endif // #ifndef __Q_TRACE_HPP__
@@ -0,0 +1,98 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qWorkerPool.cpp
+ *  QwaqLib (cross-platform)
+ *
+ */
+
+#include "qWorkerPool.hpp"
+#include "qTrace.h"
+using namespace Qwaq;
+
+#include <boost/bind.hpp>
+
+
+QWorkerPool::QWorkerPool(int threadCount, const char* name) : threadName(name)
+{
+	batch = NULL;
+	batchSize = nextJob = unfinished = 0;
+	generation = 0;
+	stopping = false;
+	// The thread calling run() is one of the workers.
+	for (int i = 1; i < threadCount; i++)
+		threads.push_back(new boost::thread(boost::bind(&QWorkerPool::workLoop, this)));
+}
+
+
+QWorkerPool::~QWorkerPool()
+{
+	{
+		boost::unique_lock<boost::mutex> lk(mutex);
+		stopping = true;
+		started.notify_all();
+	}
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i]->join();
+		delete threads[i];
+	}
+}
+
+
+void QWorkerPool::run(int count, const boost::function<void (int)>& job)
+{
+	if (count <= 0) return;
+	boost::unique_lock<boost::mutex> lk(mutex);
+	batch = &job;
+	batchSize = count;
+	nextJob = 0;
+	unfinished = count;
+	++generation;
+	if (count > 1) started.notify_all();
+
+	work(lk);
+	while (unfinished) finished.wait(lk);
+	batch = NULL;
+}
+
+
+void QWorkerPool::workLoop()
+{
+	if (threadName) qTraceSetThreadName(threadName);
+	boost::unique_lock<boost::mutex> lk(mutex);
+	unsigned done = generation;
+	for (;;) {
+		while (!stopping && (generation == done || !batch)) started.wait(lk);
+		if (stopping) return;
+		done = generation;
+		work(lk);
+	}
+}
+
+
+// Run jobs from the current batch until none are left to start.  Called,
+// and answers, with the lock held.
+void QWorkerPool::work(boost::unique_lock<boost::mutex>& lk)
+{
+	while (batch && nextJob < batchSize) {
+		int job = nextJob++;
+		const boost::function<void (int)>* f = batch;
+		lk.unlock();
+		(*f)(job);
+		lk.lock();
+		if (--unfinished == 0) finished.notify_all();
+	}
+}
@@ -0,0 +1,71 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+/*
+ *  qWorkerPool.hpp
+ *  QwaqLib (cross-platform)
+ *
+ *  A fixed set of threads that run a batch of jobs at a time.  The thread
+ *  that hands them the batch works on it too, and carries on only once every
+ *  job in it has returned, so a batch is also a barrier.
+ */
+
+#ifndef __Q_WORKER_POOL_HPP__
+#define __Q_WORKER_POOL_HPP__
+
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+namespace Qwaq
+{
+
+class QWorkerPool
+{
+	public:
+		// 'threadCount' includes the thread calling run(), so 1 runs every
+		// job in that thread.  The others are named 'threadName' in traces.
+		QWorkerPool(int threadCount, const char* threadName = NULL);
+		~QWorkerPool();
+
+		int threadCount() { return threads.size() + 1; }
+
+		// Call job(0) ... job(count-1), spread over the threads, and answer
+		// once they have all returned.
+		void run(int count, const boost::function<void (int)>& job);
+
+	protected:
+		std::vector<boost::thread*> threads;
+		const char* threadName;
+		boost::mutex mutex;
+		boost::condition_variable started;
+		boost::condition_variable finished;
+
+		const boost::function<void (int)>* batch;
+		int batchSize;
+		int nextJob;
+		int unfinished;
+		unsigned generation;		// of batches, so that a thread runs each one once
+		bool stopping;
+
+		void workLoop();
+		void work(boost::unique_lock<boost::mutex>& lk);
+};
+
+}; // namespace Qwaq
+
+#endif // #ifndef __Q_WORKER_POOL_HPP__
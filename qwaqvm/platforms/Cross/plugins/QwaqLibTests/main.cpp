@@ -14,13 +14,47 @@
  */
 
 
-#include "qLogger.h"
+#include "qLogger.hpp"
 
 #include "qTestBufferPool.h"
 #include "qTestReaderWriter.h"
+#include "qTestLogger.h"
+#include "qTestFeedbackChannel.h"
+#include "qTestHandleTable.h"
+#include "qTestTrace.h"
+#include "qTestWorkerPool.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+extern "C" {
+
+#include "sqVirtualMachine.h"
+struct VirtualMachine* interpreterProxy;
+
+}
+
+// Just enough of the VM for QwaqLib.
+static struct VirtualMachine testVM;
+
+static void addTickee(void (*ticker)(void), unsigned periodms, unsigned roundms) { }
+
+int testSemaphoreSignals = 0;
+static sqInt signalSemaphoreWithIndex(sqInt semaIndex) { testSemaphoreSignals++; return 1; }
+
+static usqLong utcMicroseconds(void)
+{
+	using namespace boost::posix_time;
+	static const ptime epoch(boost::gregorian::date(1901, 1, 1));
+	return (microsec_clock::universal_time() - epoch).total_microseconds();
+}
 
 int main(int argc, char* argv[])
 {	
+	testVM.addSynchronousTickee = addTickee;
+	testVM.utcMicroseconds = utcMicroseconds;
+	testVM.signalSemaphoreWithIndex = signalSemaphoreWithIndex;
+	interpreterProxy = &testVM;
+
 	qInitLogging();
 	qerr << endl << "Testing BufferPool... ";
 	
@@ -33,5 +67,29 @@ int main(int argc, char* argv[])
 	qerr << "success!";
 	
 	testReaderWriter_1();
+	qShutdownLogging();
+
+	testLogger_1();
+	testLogger_2();
+	benchmarkLogger_1();
+
+	testFeedbackChannel_1();
+	testFeedbackChannel_2();
+	testFeedbackChannel_3();
+	benchmarkFeedbackChannel_1();
+
+	testHandleTable_1();
+	testHandleTable_2();
+	testHandleTable_3();
+	testHandleTable_4();
+	benchmarkHandleTable_1();
+
+	testTrace_1();
+	testTrace_2();
+	benchmarkTrace_1();
+
+	testWorkerPool_1();
+	testWorkerPool_2();
+	benchmarkWorkerPool_1();
 }
 
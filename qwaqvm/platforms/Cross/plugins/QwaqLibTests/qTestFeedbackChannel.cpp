@@ -0,0 +1,240 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+#include "qTestFeedbackChannel.h"
+#include "qFeedbackChannel.h"
+#include "qLogger.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+using namespace Qwaq;
+
+// Laid out like QEncodedAudioSegmentFeedback in QAudioPlugin.
+const int SEGMENT_CAPACITY = 2000;
+struct TestSegment
+{
+	int type;
+	unsigned dataSize;
+	unsigned char data[SEGMENT_CAPACITY];
+};
+class TestSegmentEvent : public FeedbackEvent
+{
+	public:
+		TestSegmentEvent() { segment.type = 2; segment.dataSize = 0; }
+		virtual int getSqueakEventSize() { return segment.dataSize + 8; }
+		virtual void fillInSqueakEvent(char* ptr) { memcpy(ptr, &segment, segment.dataSize + 8); }
+
+		TestSegment segment;
+};
+
+static FeedbackEventPtr makeSegment(unsigned dataSize, unsigned char fill)
+{
+	TestSegmentEvent* evt = new TestSegmentEvent;
+	evt->segment.dataSize = dataSize;
+	memset(evt->segment.data, fill, dataSize);
+	return FeedbackEventPtr(evt);
+}
+
+// Check that 'buffer' holds 'count' records for segments made with sizes
+// firstSize, firstSize + 1, ... and fills firstFill, firstFill + 1, ...
+static bool checkRecords(char* buffer, int used, int count, unsigned firstSize, unsigned char firstFill)
+{
+	int offset = 0;
+	for (int i = 0; i < count; i++) {
+		if (offset + 4 > used) return false;
+		int size = *((int*)(buffer + offset));
+		TestSegment* segment = (TestSegment*)(buffer + offset + 4);
+		if (size != (int)(firstSize + i + 8)) return false;
+		if (segment->type != 2 || segment->dataSize != firstSize + i) return false;
+		for (unsigned j = 0; j < segment->dataSize; j++)
+			if (segment->data[j] != (unsigned char)(firstFill + i)) return false;
+		for (int j = size; j < ((size + 3) & ~3); j++)
+			if (buffer[offset + 4 + j] != 0) return false;
+		offset += 4 + ((size + 3) & ~3);
+	}
+	return offset == used;
+}
+
+static void report(const char* test, bool success)
+{
+	qerr << test << "():  " << (success ? "SUCCESS" : "FAILURE") << endl;
+}
+
+
+// Draining packs events into length-prefixed records.
+void testFeedbackChannel_1(void)
+{
+	static char buffer[8192];
+	FeedbackChannel channel(1);
+	bool success = true;
+
+	for (int i = 0; i < 10; i++) {
+		FeedbackEventPtr evt = makeSegment(100 + i, 'a' + i);
+		channel.push(evt);
+	}
+	int used = channel.drain(buffer, sizeof(buffer));
+	success = success && checkRecords(buffer, used, 10, 100, 'a');
+	success = success && channel.drain(buffer, sizeof(buffer)) == 0;
+
+	// A small buffer takes what fits and leaves the rest.
+	for (int i = 0; i < 5; i++) {
+		FeedbackEventPtr evt = makeSegment(200 + i, 'A' + i);
+		channel.push(evt);
+	}
+	used = channel.drain(buffer, 500);
+	success = success && checkRecords(buffer, used, 2, 200, 'A');
+	// Too small for even one event: answer the size needed.
+	success = success && channel.drain(buffer, 100) == -(4 + 212);
+	used = channel.drain(buffer, sizeof(buffer));
+	success = success && checkRecords(buffer, used, 3, 202, 'A' + 2);
+
+	report("testFeedbackChannel_1", success);
+}
+
+
+// Drained channels signal once per batch.
+void testFeedbackChannel_2(void)
+{
+	static char buffer[8192];
+	FeedbackChannel channel(1);
+	bool success = true;
+
+	// Until the first drain, every push signals (for read-and-pop readers).
+	testSemaphoreSignals = 0;
+	for (int i = 0; i < 3; i++) {
+		FeedbackEventPtr evt = makeSegment(10, 0);
+		channel.push(evt);
+	}
+	success = success && testSemaphoreSignals == 3;
+	channel.drain(buffer, sizeof(buffer));
+
+	testSemaphoreSignals = 0;
+	for (int i = 0; i < 20; i++) {
+		FeedbackEventPtr evt = makeSegment(10, 0);
+		channel.push(evt);
+	}
+	success = success && testSemaphoreSignals == 1;
+	channel.drain(buffer, sizeof(buffer));
+	FeedbackEventPtr evt = makeSegment(10, 0);
+	channel.push(evt);
+	success = success && testSemaphoreSignals == 2;
+
+	// A drain that can't take everything signals for the rest.
+	for (int i = 0; i < 20; i++) {
+		FeedbackEventPtr evt = makeSegment(10, 0);
+		channel.push(evt);
+	}
+	success = success && testSemaphoreSignals == 2;
+	channel.drain(buffer, 100);
+	success = success && testSemaphoreSignals == 3;
+	channel.drain(buffer, sizeof(buffer));
+	success = success && testSemaphoreSignals == 3;
+
+	report("testFeedbackChannel_2", success);
+}
+
+
+// Pooled events are recycled once drained.
+void testFeedbackChannel_3(void)
+{
+	static char buffer[65536];
+	FeedbackChannel channel(1);
+	FeedbackEventPool<TestSegmentEvent> pool;
+	bool success = true;
+
+	for (int round = 0; round < 100; round++) {
+		for (int i = 0; i < 5; i++) {
+			boost::shared_ptr<TestSegmentEvent> evt = pool.acquire();
+			evt->segment.dataSize = 50 + i;
+			memset(evt->segment.data, round + i, evt->segment.dataSize);
+			FeedbackEventPtr p(evt);
+			channel.push(p);
+		}
+		int used = channel.drain(buffer, sizeof(buffer));
+		success = success && checkRecords(buffer, used, 5, 50, round);
+	}
+	success = success && pool.size() == 5;
+
+	report("testFeedbackChannel_3", success);
+}
+
+
+static double seconds()
+{
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// Events/second, read-and-pop versus pooled-and-drained.  Events are 200-byte
+// encoded audio segments, consumed in batches of 'batch' as the Squeak reader
+// would find them after a wake-up.
+void benchmarkFeedbackChannel_1(void)
+{
+	static char buffer[65536];
+	const int events = 1000000;
+	const int batch = 10;
+	const unsigned dataSize = 200;
+	unsigned char data[dataSize];
+	memset(data, 0x55, dataSize);
+
+	// As before: a new event per push, a signal per push, and for each event
+	// a freshly allocated object (standing in for the ByteArray that
+	// qFeedbackChannelReadEvent instantiates) and a separate pop.
+	FeedbackChannel readChannel(1);
+	testSemaphoreSignals = 0;
+	double start = seconds();
+	for (int i = 0; i < events; i += batch) {
+		for (int j = 0; j < batch; j++) {
+			TestSegmentEvent* evt = new TestSegmentEvent;
+			evt->segment.dataSize = dataSize;
+			memcpy(evt->segment.data, data, dataSize);
+			FeedbackEventPtr p(evt);
+			readChannel.push(p);
+		}
+		for (int j = 0; j < batch; j++) {
+			FeedbackEventPtr evt = readChannel.front();
+			char* bytes = (char*)malloc(evt->getSqueakEventSize());
+			evt->fillInSqueakEvent(bytes);
+			free(bytes);
+			readChannel.pop();
+		}
+	}
+	double readSeconds = seconds() - start;
+	int readSignals = testSemaphoreSignals;
+
+	FeedbackChannel drainChannel(1);
+	FeedbackEventPool<TestSegmentEvent> pool;
+	drainChannel.drain(buffer, sizeof(buffer));
+	testSemaphoreSignals = 0;
+	start = seconds();
+	for (int i = 0; i < events; i += batch) {
+		for (int j = 0; j < batch; j++) {
+			boost::shared_ptr<TestSegmentEvent> evt = pool.acquire();
+			evt->segment.dataSize = dataSize;
+			memcpy(evt->segment.data, data, dataSize);
+			FeedbackEventPtr p(evt);
+			drainChannel.push(p);
+		}
+		drainChannel.drain(buffer, sizeof(buffer));
+	}
+	double drainSeconds = seconds() - start;
+	int drainSignals = testSemaphoreSignals;
+
+	qerr << "benchmarkFeedbackChannel_1():  read and pop:  " << (int)(events / readSeconds)
+		 << " events/second,  " << readSignals << " signals" << endl;
+	qerr << "benchmarkFeedbackChannel_1():  pooled and drained:  " << (int)(events / drainSeconds)
+		 << " events/second,  " << drainSignals << " signals" << endl;
+}
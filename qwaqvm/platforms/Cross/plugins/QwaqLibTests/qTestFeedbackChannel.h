@@ -0,0 +1,21 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+extern int testSemaphoreSignals; // counted by the interpreterProxy in main.cpp
+
+void testFeedbackChannel_1(void); // Draining packs events into length-prefixed records.
+void testFeedbackChannel_2(void); // Drained channels signal once per batch.
+void testFeedbackChannel_3(void); // Pooled events are recycled once drained.
+void benchmarkFeedbackChannel_1(void); // Events/second, read-and-pop versus pooled-and-drained.
@@ -0,0 +1,269 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+#include "qTestHandleTable.h"
+#include "qHandleTable.hpp"
+#include "qLogger.hpp"
+
+#include <map>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using namespace Qwaq;
+
+class TestResource
+{
+	public:
+		TestResource(int v) : value(v), alive(true) { liveCount++; }
+		~TestResource() { alive = false; liveCount--; }
+
+		int value;
+		volatile bool alive;
+		static int liveCount;
+};
+int TestResource::liveCount = 0;
+
+typedef HandleTable<TestResource> TestTable;
+
+static void report(const char* test, bool success)
+{
+	qerr << test << "():  " << (success ? "SUCCESS" : "FAILURE") << endl;
+}
+
+
+// Handles find their objects, and stale handles find nothing.
+void testHandleTable_1(void)
+{
+	TestTable table;
+	bool success = true;
+
+	unsigned a = table.add(TestTable::ptr_type(new TestResource(1)));
+	unsigned b = table.add(TestTable::ptr_type(new TestResource(2)));
+	success = success && a && b && a != b;
+	success = success && a <= 0x3FFFFFFF && b <= 0x3FFFFFFF;  // SmallIntegers
+	success = success && table.get(a)->value == 1 && table.get(b)->value == 2;
+	success = success && !table.get(0) && !table.get(a + 1000) && table.size() == 2;
+
+	// An object that is still in use outlives its removal.
+	TestTable::ptr_type held = table.get(a);
+	success = success && table.remove(a) && !table.remove(a);
+	success = success && !table.get(a) && held->alive && TestResource::liveCount == 2;
+	held.reset();
+	success = success && TestResource::liveCount == 1;
+
+	// The slot is reused, but not the handle.
+	unsigned c = table.add(TestTable::ptr_type(new TestResource(3)));
+	success = success && c != a && (c & 0xFFFF) == (a & 0xFFFF);
+	success = success && !table.get(a) && !table.remove(a) && table.get(c)->value == 3;
+
+	// Generations wrap around without ever answering 0.
+	for (int i = 0; i < 40000; i++) {
+		unsigned h = table.add(TestTable::ptr_type(new TestResource(i)));
+		success = success && h && table.get(h)->value == i && table.remove(h);
+	}
+	success = success && table.size() == 2 && table.get(b)->value == 2 && table.get(c)->value == 3;
+
+	report("testHandleTable_1", success);
+}
+
+
+// The table grows, and clear() releases everything.
+void testHandleTable_2(void)
+{
+	TestTable table;
+	std::vector<unsigned> handles;
+	bool success = true;
+
+	for (int i = 0; i < 1000; i++) handles.push_back(table.add(TestTable::ptr_type(new TestResource(i))));
+	for (int i = 0; i < 1000; i++) success = success && handles[i] && table.get(handles[i])->value == i;
+	success = success && table.size() == 1000 && TestResource::liveCount == 1000;
+
+	table.clear();
+	success = success && table.size() == 0 && TestResource::liveCount == 0;
+	for (int i = 0; i < 1000; i++) success = success && !table.get(handles[i]);
+
+	// The table is full at 65536 objects.
+	for (int i = 0; i < 65536; i++) success = success && table.add(TestTable::ptr_type(new TestResource(i)));
+	TestTable::ptr_type extra(new TestResource(-1));
+	success = success && table.add(extra) == 0 && extra.unique();
+	TestResource* bare = new TestResource(-2);
+	success = success && table.adopt(bare) == 0 && bare->alive && TestResource::liveCount == 65538;
+	delete bare;
+	table.clear();
+
+	report("testHandleTable_2", success);
+}
+
+
+// A client of qMappedResourceBoilerplate.hpp; 'resource' is destroyed if the
+// constructor throws, so it shows whether the instance was freed.
+class TestMappedResource
+{
+	public:
+		typedef boost::shared_ptr<TestMappedResource> ptr_type;
+		TestMappedResource(int v) : resource(v) { addToMap(); }
+		TestResource resource;
+
+#include "qMappedResourceBoilerplate.hpp"
+};
+TestMappedResource::table_type TestMappedResource::s_Table;
+
+// Creating a mapped resource with the table full throws, without leaking.
+void testHandleTable_4(void)
+{
+	std::vector<unsigned> keys;
+	bool success = true;
+
+	for (int i = 0; i < 65536; i++) keys.push_back((new TestMappedResource(i))->key());
+	for (int i = 0; i < 65536; i += 4099) success = success && TestMappedResource::withKey(keys[i])->resource.value == i;
+	success = success && TestResource::liveCount == 65536;
+
+	bool thrown = false;
+	try {
+		new TestMappedResource(-1);
+	}
+	catch (TestMappedResource::TableFull) {
+		thrown = true;
+	}
+	success = success && thrown && TestResource::liveCount == 65536;
+
+	// Once a key is released there is room again.
+	TestMappedResource::releaseKey(keys[0]);
+	unsigned key = (new TestMappedResource(-2))->key();
+	success = success && key && TestMappedResource::withKey(key)->resource.value == -2;
+
+	TestMappedResource::releaseAll();
+	success = success && TestResource::liveCount == 0;
+
+	report("testHandleTable_4", success);
+}
+
+
+struct RaceState
+{
+	TestTable table;
+	unsigned handles[64];
+	volatile bool stop;
+	volatile int badLookups;
+	boost::mutex mutex;		// guards 'handles' for the remover
+};
+
+static void raceLookups(RaceState* state, int seed)
+{
+	unsigned i = seed;
+	int bad = 0;
+	while (!state->stop) {
+		i = i * 1103515245 + 12345;
+		TestTable::ptr_type p = state->table.get(state->handles[(i >> 16) & 63]);
+		if (p && !p->alive) bad++;
+	}
+	boost::mutex::scoped_lock lk(state->mutex);
+	state->badLookups += bad;
+}
+
+// Lookups racing removals never see a released object.
+void testHandleTable_3(void)
+{
+	RaceState state;
+	state.stop = false;
+	state.badLookups = 0;
+	for (int i = 0; i < 64; i++) state.handles[i] = state.table.add(TestTable::ptr_type(new TestResource(i)));
+
+	boost::thread_group readers;
+	for (int i = 0; i < 4; i++) readers.create_thread(boost::bind(raceLookups, &state, i));
+
+	bool success = true;
+	for (int round = 0; round < 200000; round++) {
+		int i = round & 63;
+		unsigned old = state.handles[i];
+		state.handles[i] = state.table.add(TestTable::ptr_type(new TestResource(round)));
+		success = success && state.table.remove(old);
+	}
+	state.stop = true;
+	readers.join_all();
+
+	success = success && state.badLookups == 0 && state.table.size() == 64;
+	report("testHandleTable_3", success);
+}
+
+
+// The registry as it was before qHandleTable (see qMappedResourceBoilerplate.hpp).
+struct TestMap
+{
+	typedef std::map<unsigned, TestTable::ptr_type> map_type;
+	map_type map;
+	boost::mutex mutex;
+
+	TestTable::ptr_type get(unsigned key) {
+		boost::mutex::scoped_lock lk(mutex);
+		map_type::iterator it = map.find(key);
+		TestTable::ptr_type result;
+		if (it != map.end()) result = it->second;
+		return result;
+	}
+};
+
+template <class Registry>
+static void benchmarkLookups(Registry* registry, unsigned* handles, int lookups, volatile int* found)
+{
+	unsigned i = 0;
+	int n = 0;
+	for (int j = 0; j < lookups; j++) {
+		i = i * 1103515245 + 12345;
+		if (registry->get(handles[(i >> 16) & 63])) n++;
+	}
+	*found = n;
+}
+
+template <class Registry>
+static int lookupsPerSecond(Registry* registry, unsigned* handles, int threads, int lookups)
+{
+	using namespace boost::posix_time;
+	volatile int found[64];
+	boost::thread_group group;
+	ptime start = microsec_clock::universal_time();
+	for (int i = 0; i < threads; i++)
+		group.create_thread(boost::bind(benchmarkLookups<Registry>, registry, handles, lookups, &found[i]));
+	group.join_all();
+	double seconds = (microsec_clock::universal_time() - start).total_microseconds() / 1e6;
+	return (int)(threads * lookups / seconds);
+}
+
+// Lookups/second from many threads, handle table versus locked std::map.  Each
+// thread stands in for a primitive or the ticker resolving one of 64 handles.
+void benchmarkHandleTable_1(void)
+{
+	const int lookups = 1000000;
+	TestTable table;
+	TestMap map;
+	unsigned tableHandles[64], mapKeys[64];
+	for (int i = 0; i < 64; i++) {
+		TestTable::ptr_type p(new TestResource(i));
+		tableHandles[i] = table.add(p);
+		mapKeys[i] = i + 1;
+		map.map[i + 1] = p;
+	}
+
+	int threadCounts[] = { 1, 2, 4, 8 };
+	for (int i = 0; i < 4; i++) {
+		int threads = threadCounts[i];
+		int mapRate = lookupsPerSecond(&map, mapKeys, threads, lookups);
+		int tableRate = lookupsPerSecond(&table, tableHandles, threads, lookups);
+		qerr << "benchmarkHandleTable_1():  " << threads << " threads:  locked map:  " << mapRate
+			 << " lookups/second,  handle table:  " << tableRate << " lookups/second" << endl;
+	}
+}
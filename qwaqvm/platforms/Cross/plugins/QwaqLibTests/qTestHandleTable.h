@@ -0,0 +1,21 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+void testHandleTable_1(void); // Handles find their objects, and stale handles find nothing.
+void testHandleTable_2(void); // The table grows, and clear() releases everything.
+void testHandleTable_3(void); // Lookups racing removals never see a released object.
+void testHandleTable_4(void); // Creating a mapped resource with the table full throws, without leaking.
+void benchmarkHandleTable_1(void); // Lookups/second from many threads, handle table versus locked std::map.
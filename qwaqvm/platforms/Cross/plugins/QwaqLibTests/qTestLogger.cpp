@@ -0,0 +1,209 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+#include "qTestLogger.h"
+#include "qLogger.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+const char* TEST_LOG_FILE = "qTestLogger.log";
+const int LOGGING_THREADS = 4;
+const int ENTRIES_PER_THREAD = 2000;
+
+static void loggingThread(int index)
+{
+	for (int i = 0; i < ENTRIES_PER_THREAD; i++) {
+		qLog() << "thread " << index << " entry " << i << flush;
+		// Stay within what the writer can keep up with.
+		if (i % 100 == 99) boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+	}
+}
+
+static std::string oldLogFile(int n)
+{
+	std::ostringstream name;
+	name << TEST_LOG_FILE << "." << n;
+	return name.str();
+}
+
+static bool logFileExists(std::string name)
+{
+	std::ifstream file(name.c_str());
+	return file.good();
+}
+
+// Entries from several threads all arrive, in order per thread.
+void testLogger_1(void)
+{
+	remove(TEST_LOG_FILE);
+	qInitLogging();
+	qLogToFile(TEST_LOG_FILE);
+
+	std::vector<boost::thread*> threads;
+	for (int i = 0; i < LOGGING_THREADS; i++)
+		threads.push_back(new boost::thread(boost::bind(&loggingThread, i)));
+	for (int i = 0; i < LOGGING_THREADS; i++) {
+		threads[i]->join();
+		delete threads[i];
+	}
+	unsigned dropped = qGetLogDroppedCount();
+	qShutdownLogging();
+
+	int next[LOGGING_THREADS] = { 0 };
+	bool success = dropped == 0;
+	std::ifstream file(TEST_LOG_FILE);
+	std::string line;
+	while (std::getline(file, line)) {
+		int index, entry;
+		std::string::size_type at = line.find("thread ");
+		if (at == std::string::npos) continue;
+		if (sscanf(line.c_str() + at, "thread %d entry %d", &index, &entry) != 2
+				|| index < 0 || index >= LOGGING_THREADS
+				|| entry != next[index]) {
+			success = false;
+			break;
+		}
+		next[index]++;
+	}
+	for (int i = 0; i < LOGGING_THREADS; i++)
+		if (next[i] != ENTRIES_PER_THREAD) success = false;
+
+	qerr << "testLogger_1():  ";
+	if (success) qerr << "SUCCESS" << endl;
+	else {
+		qerr << "FAILURE (dropped: " << dropped << "   entries per thread: ";
+		for (int i = 0; i < LOGGING_THREADS; i++) qerr << next[i] << ", ";
+		qerr << ")" << endl;
+	}
+}
+
+// Size-based rotation of the log-file.
+void testLogger_2(void)
+{
+	remove(TEST_LOG_FILE);
+	for (int n = 1; n <= 3; n++) remove(oldLogFile(n).c_str());
+	qInitLogging();
+	qLogToFile(TEST_LOG_FILE);
+	qSetLogRotation(4096, 2);
+
+	for (int i = 0; i < 1000; i++) {
+		qLog() << "rotating entry " << i << flush;
+		if (i % 50 == 49) boost::this_thread::sleep(boost::posix_time::milliseconds(30));
+	}
+	qShutdownLogging();
+	qSetLogRotation(0, 0);
+
+	bool success = logFileExists(TEST_LOG_FILE)
+		&& logFileExists(oldLogFile(1))
+		&& logFileExists(oldLogFile(2))
+		&& !logFileExists(oldLogFile(3));
+
+	qerr << "testLogger_2():  " << (success ? "SUCCESS" : "FAILURE") << endl;
+}
+
+static double nanoseconds()
+{
+#ifdef WIN32
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return now.QuadPart * 1e9 / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+#endif
+}
+
+// Log 'calls' entries as rootTickee() does when a tick is late, a few per
+// tick, and answer the mean and worst cost of a call in nanoseconds.
+template <class LogCall>
+static void timeLogCalls(LogCall logCall, int calls, double& mean, double& worst)
+{
+	double total = 0;
+	worst = 0;
+	for (int i = 0; i < calls; i++) {
+		double start = nanoseconds();
+		logCall(i);
+		double took = nanoseconds() - start;
+		total += took;
+		if (took > worst) worst = took;
+		if (i % 5 == 4) boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+	}
+	mean = total / calls;
+}
+
+static std::ofstream* synchronousLog;
+
+// What qLog() used to do: format the time and write through to the file.
+static void synchronousLogCall(int i)
+{
+	*synchronousLog << endl << qTime() << " :  "
+		<< "rootTickee():  WAITED WAY TOO LONG: " << i << "msecs" << flush;
+}
+
+static void asynchronousLogCall(int i)
+{
+	qLog() << "rootTickee():  WAITED WAY TOO LONG: " << i << "msecs" << flush;
+}
+
+static void filteredLogCall(int i)
+{
+	qLog(9) << "ticker priority " << i << ":  scheduling " << i << " tickees" << flush;
+}
+
+static void filteredQLOGCall(int i)
+{
+	QLOG(9) << "ticker priority " << i << ":  scheduling " << i << " tickees" << flush;
+}
+
+// Cost of a log call on the audio tick path, old and new.
+void benchmarkLogger_1(void)
+{
+	const int calls = 5000;
+	const char* names[4] = { "synchronous write", "buffered write", "filtered qLog(9)", "filtered QLOG(9)" };
+	double mean[4], worst[4];
+
+	remove(TEST_LOG_FILE);
+	synchronousLog = new std::ofstream(TEST_LOG_FILE, std::ios::app);
+	timeLogCalls(synchronousLogCall, calls, mean[0], worst[0]);
+	delete synchronousLog;
+
+	remove(TEST_LOG_FILE);
+	qInitLogging();
+	qLogToFile(TEST_LOG_FILE);
+	timeLogCalls(asynchronousLogCall, calls, mean[1], worst[1]);
+	timeLogCalls(filteredLogCall, calls, mean[2], worst[2]);
+	timeLogCalls(filteredQLOGCall, calls, mean[3], worst[3]);
+	qShutdownLogging();
+	remove(TEST_LOG_FILE);
+
+	for (int i = 0; i < 4; i++)
+		qerr << "benchmarkLogger_1():  " << names[i] << ":  mean " << (int)mean[i]
+			 << "ns   worst " << (int)worst[i] << "ns" << endl;
+}
@@ -0,0 +1,18 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+void testLogger_1(void); // Entries from several threads all arrive, in order per thread.
+void testLogger_2(void); // Size-based rotation of the log-file.
+void benchmarkLogger_1(void); // Cost of a log call on the audio tick path, old and new.
@@ -14,7 +14,7 @@
  */
 
 #include "qTestReaderWriter.h"
-#include "qLogger.h"
+#include "qLogger.hpp"
 
 #include <boost/thread.hpp>
 #include <boost/thread/shared_mutex.hpp>
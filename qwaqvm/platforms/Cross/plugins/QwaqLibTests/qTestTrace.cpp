@@ -0,0 +1,271 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+#include "qTestTrace.h"
+#include "qTrace.hpp"
+#include "qEventTimeLogger.hpp"
+#include "qLogger.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace Qwaq;
+
+const char* TEST_TRACE_FILE = "qTestTrace.json";
+
+static void report(const char* test, bool success)
+{
+	qerr << test << "():  " << (success ? "SUCCESS" : "FAILURE") << endl;
+}
+
+// Answer the events of the given thread, leaving out its name.
+static std::vector<QTraceEvent> eventsOf(const std::vector<QTraceEvent>& events, unsigned thread)
+{
+	std::vector<QTraceEvent> result;
+	for (unsigned i = 0; i < events.size(); i++)
+		if (events[i].thread == thread && events[i].kind != 'M') result.push_back(events[i]);
+	return result;
+}
+
+
+// Events drain in order, filtered by category, and a full ring drops and counts.
+void testTrace_1(void)
+{
+	std::vector<QTraceEvent> events;
+	bool success = true;
+
+	qTraceSetThreadName("testTrace_1");
+	qTraceDrain(events);  // whatever came before
+	events.clear();
+
+	qTraceSetCategories(QTraceCodecs);
+	QTRACE_BEGIN(QTraceCodecs, "outer");
+	QTRACE_INSTANT(QTraceTicks, "filtered", 1);
+	QTRACE_COUNTER(QTraceCodecs, "count", 7);
+	{
+		QTRACE_SCOPE(QTraceCodecs, "scope");
+		QTRACE_SCOPE(QTraceFeedback, "filtered");
+	}
+	QTRACE_END(QTraceCodecs, "outer");
+	success = success && qTraceDrain(events) == 0;
+
+	// The thread's name comes first.
+	success = success && events.size() == 6 && events[0].kind == 'M' && !strcmp(events[0].name, "testTrace_1");
+	std::vector<QTraceEvent> mine = eventsOf(events, events[0].thread);
+	const char* names[5] = { "outer", "count", "scope", "scope", "outer" };
+	int kinds[5] = { QTraceBegin, QTraceCounter, QTraceBegin, QTraceEnd, QTraceEnd };
+	for (unsigned i = 0; success && i < 5; i++) {
+		success = mine.size() == 5 && !strcmp(mine[i].name, names[i]) && mine[i].kind == kinds[i]
+			&& mine[i].category == QTraceCodecs && (i == 0 || mine[i].nanoseconds >= mine[i-1].nanoseconds);
+	}
+	success = success && mine[1].value == 7;
+
+	// A full ring keeps the oldest events and counts the rest.
+	unsigned droppedBefore = qTraceGetDroppedCount();
+	for (int i = 0; i < 5000; i++) QTRACE_COUNTER(QTraceCodecs, "fill", i);
+	events.clear();
+	unsigned dropped = qTraceDrain(events);
+	mine = eventsOf(events, mine[0].thread);
+	success = success && dropped > 0 && mine.size() + dropped == 5000 && mine.back().value == (int)mine.size() - 1;
+	success = success && qTraceGetDroppedCount() == droppedBefore + dropped;
+
+	// Squeak drains into buffers of its own, in as many goes as it takes: a
+	// 40-byte header, 24-byte events, then names.
+	for (int i = 0; i < 100; i++) QTRACE_COUNTER(QTraceCodecs, "drained", i);
+	char buffer[1000];
+	int needed = qTraceDrainInto(buffer, 50);
+	success = success && needed == -(40 + 24 + (int)strlen("testTrace_1") + 1);
+	int counted = 0, used, drains = 0;
+	while ((used = qTraceDrainInto(buffer, sizeof(buffer))) > 40) {
+		int count, namesSize;
+		memcpy(&count, buffer + 4, 4);
+		memcpy(&namesSize, buffer + 12, 4);
+		success = success && used == 40 + 24 * count + namesSize;
+		for (int i = 0; i < count; i++) {
+			const char* event = buffer + 40 + 24 * i;
+			int value, nameOffset;
+			unsigned short kind;
+			memcpy(&value, event + 8, 4);
+			memcpy(&nameOffset, event + 12, 4);
+			memcpy(&kind, event + 18, 2);
+			if (kind == 'M') continue;
+			success = success && kind == QTraceCounter && value == counted++
+				&& !strcmp(buffer + 40 + 24 * count + nameOffset, "drained");
+		}
+		drains++;
+	}
+	success = success && used == 40 && counted == 100 && drains > 1;
+
+	// Nothing is recorded with tracing off.
+	qTraceSetCategories(0);
+	QTRACE_INSTANT(QTraceCodecs, "off", 0);
+	events.clear();
+	success = success && qTraceDrain(events) == 0 && events.empty();
+
+	report("testTrace_1", success);
+}
+
+
+static void tracingThread(int index, int count)
+{
+	static const char* names[4] = { "thread 0", "thread 1", "thread 2", "thread 3" };
+	qTraceSetThreadName(names[index]);
+	for (int i = 0; i < count; i++) {
+		QTRACE_SCOPE(QTraceTicks, "work");
+		QTRACE_COUNTER(QTraceTicks, names[index], i);
+	}
+}
+
+static int countOf(const std::string& text, const std::string& part)
+{
+	int n = 0;
+	for (size_t pos = text.find(part); pos != std::string::npos; pos = text.find(part, pos + 1)) n++;
+	return n;
+}
+
+// Events from several threads, some finished, all drain; Chrome output has them all.
+void testTrace_2(void)
+{
+	const int threads = 4;
+	const int count = 300;  // three events each, so the rings don't fill
+	std::vector<QTraceEvent> events;
+	bool success = true;
+
+	qTraceDrain(events);
+	events.clear();
+	qTraceSetCategories(QTraceAll);
+
+	boost::thread_group group;
+	for (int i = 0; i < threads; i++) group.create_thread(boost::bind(tracingThread, i, count));
+	group.join_all();
+	success = success && qTraceDrain(events) == 0;
+
+	// Each thread's counter counts up, on its own thread.
+	int counters = 0;
+	for (unsigned i = 0; i < events.size(); i++) {
+		if (events[i].kind != 'M') continue;
+		std::vector<QTraceEvent> theirs = eventsOf(events, events[i].thread);
+		success = success && theirs.size() == 3 * count;
+		for (unsigned j = 0; success && j < theirs.size(); j++) {
+			if (theirs[j].kind != QTraceCounter) continue;
+			success = !strcmp(theirs[j].name, events[i].name) && theirs[j].value == counters % count;
+			counters++;
+		}
+	}
+	success = success && counters == threads * count;
+
+	// The finished threads' rings have gone.
+	std::vector<QTraceEvent> again;
+	tracingThread(0, 1);
+	qTraceDrain(again);
+	success = success && again.size() == 4 && again[0].thread != events[0].thread;
+
+	std::ostringstream chrome;
+	qTraceWriteChrome(events, chrome, true);
+	std::string text = chrome.str();
+	success = success && text.substr(0, 2) == "[\n"
+		&& countOf(text, "\"ph\":\"B\"") == threads * count
+		&& countOf(text, "\"ph\":\"C\"") == threads * count
+		&& countOf(text, "\"thread_name\"") == threads
+		&& countOf(text, "\n") == (int)events.size() + 1;
+
+	// Drains appended to a file start it only once.
+	remove(TEST_TRACE_FILE);
+	tracingThread(1, 10);
+	int first = qTraceWriteChromeFile(TEST_TRACE_FILE);
+	tracingThread(2, 10);
+	int second = qTraceWriteChromeFile(TEST_TRACE_FILE);
+	std::ifstream file(TEST_TRACE_FILE);
+	std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	success = success && first == 31 && second == 31 && countOf(contents, "[") == 1 && countOf(contents, "\n") == 63;
+	file.close();
+	remove(TEST_TRACE_FILE);
+
+	qTraceSetCategories(0);
+	report("testTrace_2", success);
+}
+
+
+static double nanoseconds()
+{
+#ifdef WIN32
+	LARGE_INTEGER now, frequency;
+	QueryPerformanceCounter(&now);
+	QueryPerformanceFrequency(&frequency);
+	return now.QuadPart * 1e9 / frequency.QuadPart;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1e9 + now.tv_nsec;
+#endif
+}
+
+static QEventTimeLogger* timeLogger;
+
+static void untracedCall(int i) { QTRACE_INSTANT(QTraceCodecs, "instant", i); }
+static void tracedCall(int i) { QTRACE_INSTANT(QTraceTicks, "instant", i); }
+static void scopeCall(int i) { QTRACE_SCOPE(QTraceTicks, "scope"); }
+static void timeLoggerCall(int i) { timeLogger->add(i); }
+
+// Make 'calls' calls, in batches that fit a ring and are drained between
+// times, and answer the mean cost of a call in nanoseconds.
+template <class Call>
+static double timeCalls(Call call, int calls)
+{
+	const int batch = 2000;
+	char drained[sizeof(int) * 8 + batch * 12];
+	std::vector<QTraceEvent> events;
+	double total = 0;
+	for (int done = 0; done < calls; done += batch) {
+		double start = nanoseconds();
+		for (int i = 0; i < batch; i++) call(i);
+		total += nanoseconds() - start;
+		events.clear();
+		qTraceDrain(events);
+		timeLogger->getInto(drained, sizeof(drained));
+	}
+	return total / calls;
+}
+
+// Cost of an event, traced and not, versus QEventTimeLogger::add().
+void benchmarkTrace_1(void)
+{
+	const int calls = 2000000;
+	char drained[sizeof(int) * 8];
+	timeLogger = new QEventTimeLogger(2000);
+	timeLogger->getInto(drained, sizeof(drained));  // starts it recording
+
+	qTraceSetCategories(QTraceTicks);
+	double untraced = timeCalls(untracedCall, calls);
+	double traced = timeCalls(tracedCall, calls);
+	double scope = timeCalls(scopeCall, calls);
+	double logged = timeCalls(timeLoggerCall, calls);
+	qTraceSetCategories(0);
+	delete timeLogger;
+
+	qerr << "benchmarkTrace_1():  category off:  " << untraced << "ns   instant:  " << traced
+		 << "ns   scope (two events):  " << scope << "ns   QEventTimeLogger::add():  " << logged << "ns" << endl;
+}
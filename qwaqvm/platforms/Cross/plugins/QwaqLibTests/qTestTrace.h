@@ -0,0 +1,19 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+void testTrace_1(void); // Events drain in order, filtered by category, and a full ring drops and counts.
+void testTrace_2(void); // Events from several threads, some finished, all drain; Chrome output has them all.
+void benchmarkTrace_1(void); // Cost of an event, traced and not, versus QEventTimeLogger::add().
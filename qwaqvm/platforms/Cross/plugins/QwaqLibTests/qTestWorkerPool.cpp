@@ -0,0 +1,110 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+#include "qTestWorkerPool.h"
+#include "qWorkerPool.hpp"
+#include "qTrace.hpp"
+#include "qLogger.hpp"
+
+#include <set>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+using namespace Qwaq;
+
+static void report(const char* test, bool success)
+{
+	qerr << test << "():  " << (success ? "SUCCESS" : "FAILURE") << endl;
+}
+
+
+static void countJob(std::vector<int>* counts, int job)
+{
+	(*counts)[job]++;
+}
+
+
+// Every job of every batch runs once, whatever the number of threads.
+void testWorkerPool_1(void)
+{
+	bool success = true;
+	int threadCounts[] = { 1, 2, 5 };
+	for (int t = 0; t < 3; t++) {
+		QWorkerPool pool(threadCounts[t]);
+		success = success && pool.threadCount() == threadCounts[t];
+		for (int size = 0; size < 70; size += 3) {
+			std::vector<int> counts(size, 0);
+			pool.run(size, boost::bind(countJob, &counts, _1));
+			for (int i = 0; i < size; i++) success = success && counts[i] == 1;
+		}
+	}
+	report("testWorkerPool_1", success);
+}
+
+
+static void noteThread(boost::mutex* mutex, std::set<boost::thread::id>* threads, int job)
+{
+	boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+	boost::mutex::scoped_lock lk(*mutex);
+	threads->insert(boost::this_thread::get_id());
+}
+
+
+// Jobs run on the workers as well as the caller, which waits for them all.
+void testWorkerPool_2(void)
+{
+	bool success = true;
+	boost::mutex mutex;
+	std::set<boost::thread::id> threads;
+	QWorkerPool pool(4);
+	for (int batch = 0; batch < 5; batch++) {
+		pool.run(16, boost::bind(noteThread, &mutex, &threads, _1));
+	}
+	// Each job sleeps, so that none of the threads can take them all.
+	success = success && threads.size() > 1 && threads.size() <= 4;
+	success = success && threads.count(boost::this_thread::get_id()) == 1;
+	report("testWorkerPool_2", success);
+}
+
+
+static void smallJob(volatile unsigned* sink, int job)
+{
+	unsigned x = job;
+	for (int i = 0; i < 100; i++) x = x * 31 + i;
+	*sink = x;
+}
+
+
+// Cost of handing out a batch of small jobs, by threads and batch size.
+void benchmarkWorkerPool_1(void)
+{
+	const int batches = 2000;
+	volatile unsigned sink = 0;
+	qerr << "benchmarkWorkerPool_1():  microseconds per batch of small jobs" << endl;
+	int threadCounts[] = { 1, 2, 4 };
+	for (int t = 0; t < 3; t++) {
+		QWorkerPool pool(threadCounts[t]);
+		qerr << "    threads " << threadCounts[t] << ":";
+		int sizes[] = { 8, 32, 128 };
+		for (int s = 0; s < 3; s++) {
+			usqLong start = qTraceNanoseconds();
+			for (int i = 0; i < batches; i++) pool.run(sizes[s], boost::bind(smallJob, &sink, _1));
+			double micros = (qTraceNanoseconds() - start) / 1000.0 / batches;
+			qerr << "   " << sizes[s] << " jobs:  " << micros;
+		}
+		qerr << endl;
+	}
+}
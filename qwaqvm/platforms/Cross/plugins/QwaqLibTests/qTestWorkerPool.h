@@ -0,0 +1,19 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+void testWorkerPool_1(void); // Every job of every batch runs once, whatever the number of threads.
+void testWorkerPool_2(void); // Jobs run on the workers as well as the caller, which waits for them all.
+void benchmarkWorkerPool_1(void); // Cost of handing out a batch of small jobs, by threads and batch size.
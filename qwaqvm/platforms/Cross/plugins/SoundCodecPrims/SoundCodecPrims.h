@@ -12,6 +12,18 @@ void gsmDecode(
 	int dst, int dstIndex, int dstSize,
 	int *srcDelta, int *dstDelta);
 	
+void gsmEncodeStreams(
+	int *states, int streamCount, int frameCount,
+	int *srcs, int srcIndex, int *srcSizes,
+	int *dsts, int dstIndex, int *dstSizes,
+	int *srcDelta, int *dstDelta);
+
+void gsmDecodeStreams(
+	int *states, int streamCount, int frameCount,
+	int *srcs, int srcIndex, int *srcSizes,
+	int *dsts, int dstIndex, int *dstSizes,
+	int *srcDelta, int *dstDelta);
+
 void gsmInitState(int state);
 
 int gsmStateBytes(void);
@@ -350,6 +350,32 @@ extern void Gsm_Update_of_reconstructed_short_time_residual_signal P((
 		word	* ep,		/* [0...39]	IN	*/
 		word	* dp));		/* [-120...-1]  IN/OUT 	*/
 
+/*
+ *  The stages of gsm_encode and gsm_decode either side of the short
+ *  term filters, which gsm_encode_streams and gsm_decode_streams run
+ *  for several streams at once.
+ */
+static void Gsm_RPE_LTP_Coder P((
+		struct gsm_state * S,
+		word	* so,		/* [0..159]		IN	*/
+		word	* Nc,		/* [0..3]		OUT	*/
+		word	* bc,		/* [0..3]		OUT	*/
+		word	* Mc,		/* [0..3]		OUT	*/
+		word	* xmaxc,	/* [0..3]		OUT	*/
+		word	* xMc));	/* [0..13*4]		OUT	*/
+
+static void Gsm_RPE_LTP_Decoder P((
+		struct gsm_state * S,
+		word	* Ncr,		/* [0..3] 		IN 	*/
+		word	* bcr,		/* [0..3]		IN	*/
+		word	* Mcr,		/* [0..3] 		IN 	*/
+		word	* xmaxcr,	/* [0..3]		IN 	*/
+		word	* xMcr,		/* [0..13*4]		IN	*/
+		word	* wt));		/* [0..159]		OUT 	*/
+
+static void gsm_pack P((gsm, word *, word *, word *, word *, word *, word *, gsm_byte *));
+static int  gsm_unpack P((gsm, gsm_byte *, word *, word *, word *, word *, word *, word *));
+
 /*
  *  Tables from table.c
  */
@@ -641,17 +667,29 @@ void Gsm_Coder P8((S,s,LARc,Nc,bc,Mc,xmaxc,xMc),
 	word	* xMc	/* [13*4] normalized RPE samples	OUT	*/
 )
 {
-	int	k;
-	word	* dp  = S->dp0 + 120;	/* [ -120...-1 ] */
-	word	* dpp = dp;		/* [ 0...39 ]	 */
-
-	static word e[50];
-
 	word	so[160];
 
 	Gsm_Preprocess			(S, s, so);
 	Gsm_LPC_Analysis		(S, so, LARc);
 	Gsm_Short_Term_Analysis_Filter	(S, LARc, so);
+	Gsm_RPE_LTP_Coder		(S, so, Nc, bc, Mc, xmaxc, xMc);
+}
+
+static void Gsm_RPE_LTP_Coder P7((S,so,Nc,bc,Mc,xmaxc,xMc),
+	struct gsm_state	* S,
+	word	* so,	/* [0..159] short term residual	IN	*/
+	word	* Nc,	/* [0..3] LTP lag			OUT 	*/
+	word	* bc,	/* [0..3] coded LTP gain		OUT 	*/
+	word	* Mc,	/* [0..3] RPE grid selection		OUT     */
+	word	* xmaxc,/* [0..3] Coded maximum amplitude	OUT	*/
+	word	* xMc	/* [13*4] normalized RPE samples	OUT	*/
+)
+{
+	int	k;
+	word	* dp  = S->dp0 + 120;	/* [ -120...-1 ] */
+	word	* dpp = dp;		/* [ 0...39 ]	 */
+
+	static word e[50];
 
 	for (k = 0; k <= 3; k++, xMc += 13) {
 
@@ -719,9 +757,27 @@ void Gsm_Decoder P8((S,LARcr, Ncr,bcr,Mcr,xmaxcr,xMcr,s),
 	word		* xMcr,		/* [0..13*4]		IN	*/
 
 	word		* s)		/* [0..159]		OUT 	*/
+{
+	word		wt[160];
+
+	Gsm_RPE_LTP_Decoder( S, Ncr, bcr, Mcr, xmaxcr, xMcr, wt );
+	Gsm_Short_Term_Synthesis_Filter( S, LARcr, wt, s );
+	Postprocessing(S, s);
+}
+
+static void Gsm_RPE_LTP_Decoder P7((S,Ncr,bcr,Mcr,xmaxcr,xMcr,wt),
+	struct gsm_state	* S,
+
+	word		* Ncr,		/* [0..3] 		IN 	*/
+	word		* bcr,		/* [0..3]		IN	*/
+	word		* Mcr,		/* [0..3] 		IN 	*/
+	word		* xmaxcr,	/* [0..3]		IN 	*/
+	word		* xMcr,		/* [0..13*4]		IN	*/
+
+	word		* wt)		/* [0..159]		OUT 	*/
 {
 	int		j, k;
-	word		erp[40], wt[160];
+	word		erp[40];
 	word		* drp = S->dp0 + 120;
 
 	for (j=0; j <= 3; j++, xmaxcr++, bcr++, Ncr++, Mcr++, xMcr += 13) {
@@ -731,9 +787,6 @@ void Gsm_Decoder P8((S,LARcr, Ncr,bcr,Mcr,xmaxcr,xMcr,s),
 
 		for (k = 0; k <= 39; k++) wt[ j * 40 + k ] =  drp[ k ];
 	}
-
-	Gsm_Short_Term_Synthesis_Filter( S, LARcr, wt, s );
-	Postprocessing(S, s);
 }
 
 /****** begin "gsm_decode.c" *****/
@@ -742,6 +795,18 @@ int gsm_decode P3((s, c, target), gsm s, gsm_byte * c, gsm_signal * target)
 {
 	word  	LARc[8], Nc[4], Mc[4], bc[4], xmaxc[4], xmc[13*4];
 
+	if (gsm_unpack(s, c, LARc, Nc, bc, Mc, xmaxc, xmc)) return -1;
+
+	Gsm_Decoder(s, LARc, Nc, bc, Mc, xmaxc, xmc, target);
+
+	return 0;
+}
+
+static int gsm_unpack P8((s, c, LARc, Nc, bc, Mc, xmaxc, xmc),
+	gsm s, gsm_byte * c,
+	word * LARc, word * Nc, word * bc, word * Mc, word * xmaxc, word * xmc)
+{
+
 #ifdef WAV49
 	if (s->wav_fmt) {
 
@@ -1082,8 +1147,6 @@ int gsm_decode P3((s, c, target), gsm s, gsm_byte * c, gsm_signal * target)
 		xmc[51]  = *c & 0x7;			/* 33 */
 	}
 
-	Gsm_Decoder(s, LARc, Nc, bc, Mc, xmaxc, xmc, target);
-
 	return 0;
 }
 
@@ -1094,7 +1157,14 @@ void gsm_encode P3((s, source, c), gsm s, gsm_signal * source, gsm_byte * c)
 	word	 	LARc[8], Nc[4], Mc[4], bc[4], xmaxc[4], xmc[13*4];
 
 	Gsm_Coder(s, source, LARc, Nc, bc, Mc, xmaxc, xmc);
+	gsm_pack(s, LARc, Nc, bc, Mc, xmaxc, xmc, c);
+}
 
+static void gsm_pack P8((s, LARc, Nc, bc, Mc, xmaxc, xmc, c),
+	gsm s,
+	word * LARc, word * Nc, word * bc, word * Mc, word * xmaxc, word * xmc,
+	gsm_byte * c)
+{
 
 	/*	variable	size
 
@@ -3700,6 +3770,34 @@ static void Fast_Short_term_synthesis_filtering P5((S,rrp,k,wt,sr),
 
 #endif /* defined(FAST) && defined(USE_FLOAT_MUL) */
 
+/*
+ *  The reflection coefficients of the four parts of a frame, in which
+ *  the analysis and synthesis filters interpolate between the LARs of
+ *  the previous frame and those of this one (4.2.8 and 4.2.9).
+ */
+static void Short_term_reflection_coefficients P3((S,LARc,rp),
+	struct gsm_state * S,
+	word	* LARc,		/* coded log area ratio [0..7]  IN	*/
+	word	rp[4][8])	/* for s [0..12], [13..26], [27..39] and [40..159] OUT */
+{
+	word		* LARpp_j	= S->LARpp[ S->j      ];
+	word		* LARpp_j_1	= S->LARpp[ S->j ^= 1 ];
+
+	Decoding_of_the_coded_Log_Area_Ratios( LARc, LARpp_j );
+
+	Coefficients_0_12(  LARpp_j_1, LARpp_j, rp[0] );
+	LARp_to_rp( rp[0] );
+
+	Coefficients_13_26( LARpp_j_1, LARpp_j, rp[1] );
+	LARp_to_rp( rp[1] );
+
+	Coefficients_27_39( LARpp_j_1, LARpp_j, rp[2] );
+	LARp_to_rp( rp[2] );
+
+	Coefficients_40_159( LARpp_j, rp[3] );
+	LARp_to_rp( rp[3] );
+}
+
 void Gsm_Short_Term_Analysis_Filter P3((S,LARc,s),
 
 	struct gsm_state * S,
@@ -3708,10 +3806,7 @@ void Gsm_Short_Term_Analysis_Filter P3((S,LARc,s),
 	word	* s		/* signal [0..159]		IN/OUT	*/
 )
 {
-	word		* LARpp_j	= S->LARpp[ S->j      ];
-	word		* LARpp_j_1	= S->LARpp[ S->j ^= 1 ];
-
-	word		LARp[8];
+	word		rp[4][8];
 
 #undef	FILTER
 #if 	defined(FAST) && defined(USE_FLOAT_MUL)
@@ -3723,23 +3818,12 @@ void Gsm_Short_Term_Analysis_Filter P3((S,LARc,s),
 # 	define	FILTER	Short_term_analysis_filtering
 #endif
 
-	Decoding_of_the_coded_Log_Area_Ratios( LARc, LARpp_j );
-
-	Coefficients_0_12(  LARpp_j_1, LARpp_j, LARp );
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 13, s);
-
-	Coefficients_13_26( LARpp_j_1, LARpp_j, LARp);
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 14, s + 13);
-
-	Coefficients_27_39( LARpp_j_1, LARpp_j, LARp);
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 13, s + 27);
+	Short_term_reflection_coefficients( S, LARc, rp );
 
-	Coefficients_40_159( LARpp_j, LARp);
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 120, s + 40);
+	FILTER( S, rp[0], 13, s);
+	FILTER( S, rp[1], 14, s + 13);
+	FILTER( S, rp[2], 13, s + 27);
+	FILTER( S, rp[3], 120, s + 40);
 }
 
 void Gsm_Short_Term_Synthesis_Filter P4((S, LARcr, wt, s),
@@ -3751,10 +3835,7 @@ void Gsm_Short_Term_Synthesis_Filter P4((S, LARcr, wt, s),
 	word	* s		/* signal   s [0..159]		  OUT  */
 )
 {
-	word		* LARpp_j	= S->LARpp[ S->j     ];
-	word		* LARpp_j_1	= S->LARpp[ S->j ^=1 ];
-
-	word		LARp[8];
+	word		rrp[4][8];
 
 #undef	FILTER
 #if 	defined(FAST) && defined(USE_FLOAT_MUL)
@@ -3766,23 +3847,12 @@ void Gsm_Short_Term_Synthesis_Filter P4((S, LARcr, wt, s),
 #	define	FILTER	Short_term_synthesis_filtering
 #endif
 
-	Decoding_of_the_coded_Log_Area_Ratios( LARcr, LARpp_j );
-
-	Coefficients_0_12( LARpp_j_1, LARpp_j, LARp );
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 13, wt, s );
-
-	Coefficients_13_26( LARpp_j_1, LARpp_j, LARp);
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 14, wt + 13, s + 13 );
+	Short_term_reflection_coefficients( S, LARcr, rrp );
 
-	Coefficients_27_39( LARpp_j_1, LARpp_j, LARp);
-	LARp_to_rp( LARp );
-	FILTER( S, LARp, 13, wt + 27, s + 27 );
-
-	Coefficients_40_159( LARpp_j, LARp );
-	LARp_to_rp( LARp );
-	FILTER(S, LARp, 120, wt + 40, s + 40);
+	FILTER( S, rrp[0], 13, wt, s );
+	FILTER( S, rrp[1], 14, wt + 13, s + 13 );
+	FILTER( S, rrp[2], 13, wt + 27, s + 27 );
+	FILTER( S, rrp[3], 120, wt + 40, s + 40 );
 }
 
 /****** begin "table.c" *****/
@@ -3840,6 +3910,275 @@ word gsm_NRFAC[8] = { 29128, 26215, 23832, 21846, 20165, 18725, 17476, 16384 };
 word gsm_FAC[8]	= { 18431, 20479, 22527, 24575, 26623, 28671, 30719, 32767 };
 
 
+/****** Coding several streams at a time *****/
+
+/*
+ *  gsm_encode_streams and gsm_decode_streams code the next frame of each
+ *  of up to GSM_STREAMS streams, every one exactly as gsm_encode and
+ *  gsm_decode would. Most of the time of a frame goes to the short term
+ *  filters, which take each of 160 samples through a lattice of eight
+ *  stages, every sample depending on the one before. With SSE2 the
+ *  filters of the streams run together, one stream to each 16 bit lane:
+ *  GSM_ADD and GSM_SUB are the saturating adds, and GSM_MULT_R a pmaddwd
+ *  of (a, 1) with (b, 16384) and a saturating pack, which differs from
+ *  GSM_MULT_R only for MIN_WORD * MIN_WORD. LARp_to_rp never answers
+ *  MIN_WORD and 28180 is not MIN_WORD, so that never arises.
+ *  Preprocessing, LPC analysis and the RPE-LTP loops stay per stream.
+ */
+
+#define GSM_STREAMS	8
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define GSM_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#ifdef GSM_SSE2
+
+/* Transpose the eight rows of eight words in r */
+static void transpose_lanes(__m128i * r)
+{
+	__m128i	a0 = _mm_unpacklo_epi16(r[0], r[1]), a1 = _mm_unpackhi_epi16(r[0], r[1]);
+	__m128i	a2 = _mm_unpacklo_epi16(r[2], r[3]), a3 = _mm_unpackhi_epi16(r[2], r[3]);
+	__m128i	a4 = _mm_unpacklo_epi16(r[4], r[5]), a5 = _mm_unpackhi_epi16(r[4], r[5]);
+	__m128i	a6 = _mm_unpacklo_epi16(r[6], r[7]), a7 = _mm_unpackhi_epi16(r[6], r[7]);
+	__m128i	b0 = _mm_unpacklo_epi32(a0, a2), b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i	b2 = _mm_unpacklo_epi32(a1, a3), b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i	b4 = _mm_unpacklo_epi32(a4, a6), b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i	b6 = _mm_unpacklo_epi32(a5, a7), b7 = _mm_unpackhi_epi32(a5, a7);
+
+	r[0] = _mm_unpacklo_epi64(b0, b4); r[1] = _mm_unpackhi_epi64(b0, b4);
+	r[2] = _mm_unpacklo_epi64(b1, b5); r[3] = _mm_unpackhi_epi64(b1, b5);
+	r[4] = _mm_unpacklo_epi64(b2, b6); r[5] = _mm_unpackhi_epi64(b2, b6);
+	r[6] = _mm_unpacklo_epi64(b3, b7); r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/* lanes[i] = word i of each of the count rows, for i in [0..n-1], n a multiple of 8 */
+static void load_lanes(word ** rows, int count, int n, __m128i * lanes)
+{
+	int	i, k;
+
+	for (i = 0; i < n; i += 8) {
+		for (k = 0; k < GSM_STREAMS; k++)
+			lanes[i + k] = k < count
+				? _mm_loadu_si128((__m128i *) (rows[k] + i))
+				: _mm_setzero_si128();
+		transpose_lanes(lanes + i);
+	}
+}
+
+static void store_lanes(__m128i * lanes, int n, word ** rows, int count)
+{
+	__m128i	block[8];
+	int	i, k;
+
+	for (i = 0; i < n; i += 8) {
+		for (k = 0; k < 8; k++) block[k] = lanes[i + k];
+		transpose_lanes(block);
+		for (k = 0; k < count; k++)
+			_mm_storeu_si128((__m128i *) (rows[k] + i), block[k]);
+	}
+}
+
+/* GSM_MULT_R(a, b) in each lane, given (a, 1) as the pairs aLo and aHi */
+static __m128i mult_r_lanes(__m128i aLo, __m128i aHi, __m128i b)
+{
+	__m128i	round = _mm_set1_epi16(16384);
+
+	return _mm_packs_epi32(
+		_mm_srai_epi32(_mm_madd_epi16(aLo, _mm_unpacklo_epi16(b, round)), 15),
+		_mm_srai_epi32(_mm_madd_epi16(aHi, _mm_unpackhi_epi16(b, round)), 15));
+}
+
+/* Short_term_analysis_filtering in each lane */
+static void Short_term_analysis_filtering_lanes(
+	__m128i * u, __m128i * rp, int k_n, __m128i * s)
+{
+	__m128i	rpLo[8], rpHi[8], one = _mm_set1_epi16(1);
+	__m128i	di, sav, ui;
+	int	i;
+
+	for (i = 0; i < 8; i++) {
+		rpLo[i] = _mm_unpacklo_epi16(rp[i], one);
+		rpHi[i] = _mm_unpackhi_epi16(rp[i], one);
+	}
+	for (; k_n--; s++) {
+		di = sav = *s;
+		for (i = 0; i < 8; i++) {
+			ui   = u[i];
+			u[i] = sav;
+			sav  = _mm_adds_epi16(ui, mult_r_lanes(rpLo[i], rpHi[i], di));
+			di   = _mm_adds_epi16(di, mult_r_lanes(rpLo[i], rpHi[i], ui));
+		}
+		*s = di;
+	}
+}
+
+/* Short_term_synthesis_filtering in each lane */
+static void Short_term_synthesis_filtering_lanes(
+	__m128i * v, __m128i * rrp, int k, __m128i * wt, __m128i * sr)
+{
+	__m128i	rrpLo[8], rrpHi[8], one = _mm_set1_epi16(1);
+	__m128i	sri;
+	int	i;
+
+	for (i = 0; i < 8; i++) {
+		rrpLo[i] = _mm_unpacklo_epi16(rrp[i], one);
+		rrpHi[i] = _mm_unpackhi_epi16(rrp[i], one);
+	}
+	while (k--) {
+		sri = *wt++;
+		for (i = 8; i--;) {
+			sri    = _mm_subs_epi16(sri, mult_r_lanes(rrpLo[i], rrpHi[i], v[i]));
+			v[i+1] = _mm_adds_epi16(v[i], mult_r_lanes(rrpLo[i], rrpHi[i], sri));
+		}
+		*sr++ = v[0] = sri;
+	}
+}
+
+/* Postprocessing in each lane */
+static void Postprocessing_lanes(__m128i * msr_io, __m128i * s)
+{
+	__m128i	one = _mm_set1_epi16(1), factor = _mm_set1_epi16(28180);
+	__m128i	factorLo = _mm_unpacklo_epi16(factor, one), factorHi = _mm_unpackhi_epi16(factor, one);
+	__m128i	mask = _mm_set1_epi16((short) 0xFFF8);
+	__m128i	msr = *msr_io;
+	int	k;
+
+	for (k = 160; k--; s++) {
+		msr = _mm_adds_epi16(*s, mult_r_lanes(factorLo, factorHi, msr));
+		*s  = _mm_and_si128(_mm_adds_epi16(msr, msr), mask);
+	}
+	*msr_io = msr;
+}
+
+#endif /* GSM_SSE2 */
+
+/* Filter so[k] of each of the count streams S[k] with the coefficients rp[k] */
+static void Short_term_analysis_filtering_streams(
+	gsm * S, word rp[][4][8], word so[][160], int count)
+{
+#ifdef GSM_SSE2
+	__m128i	u[8], rpl[4][8], s[160];
+	word	* rows[GSM_STREAMS];
+	int	j, k;
+
+	for (k = 0; k < count; k++) rows[k] = S[k]->u;
+	load_lanes(rows, count, 8, u);
+	for (j = 0; j <= 3; j++) {
+		for (k = 0; k < count; k++) rows[k] = rp[k][j];
+		load_lanes(rows, count, 8, rpl[j]);
+	}
+	for (k = 0; k < count; k++) rows[k] = so[k];
+	load_lanes(rows, count, 160, s);
+
+	Short_term_analysis_filtering_lanes(u, rpl[0], 13, s);
+	Short_term_analysis_filtering_lanes(u, rpl[1], 14, s + 13);
+	Short_term_analysis_filtering_lanes(u, rpl[2], 13, s + 27);
+	Short_term_analysis_filtering_lanes(u, rpl[3], 120, s + 40);
+
+	store_lanes(s, 160, rows, count);
+	for (k = 0; k < count; k++) rows[k] = S[k]->u;
+	store_lanes(u, 8, rows, count);
+#else
+	int	k;
+
+	for (k = 0; k < count; k++) {
+		Short_term_analysis_filtering(S[k], rp[k][0], 13, so[k]);
+		Short_term_analysis_filtering(S[k], rp[k][1], 14, so[k] + 13);
+		Short_term_analysis_filtering(S[k], rp[k][2], 13, so[k] + 27);
+		Short_term_analysis_filtering(S[k], rp[k][3], 120, so[k] + 40);
+	}
+#endif
+}
+
+/* Synthesize and postprocess s[k] of each of the count streams S[k] from wt[k] */
+static void Short_term_synthesis_streams(
+	gsm * S, word rrp[][4][8], word wt[][160], gsm_signal ** s, int count)
+{
+#ifdef GSM_SSE2
+	__m128i	v[9], rrpl[4][8], wtl[160], sl[160], msr;
+	word	* rows[GSM_STREAMS], last[GSM_STREAMS];
+	int	j, k;
+
+	for (k = 0; k < count; k++) rows[k] = S[k]->v;
+	load_lanes(rows, count, 8, v);
+	for (j = 0; j <= 3; j++) {
+		for (k = 0; k < count; k++) rows[k] = rrp[k][j];
+		load_lanes(rows, count, 8, rrpl[j]);
+	}
+	for (k = 0; k < count; k++) rows[k] = wt[k];
+	load_lanes(rows, count, 160, wtl);
+	for (k = 0; k < GSM_STREAMS; k++) last[k] = k < count ? S[k]->msr : 0;
+	msr = _mm_loadu_si128((__m128i *) last);
+
+	Short_term_synthesis_filtering_lanes(v, rrpl[0], 13, wtl, sl);
+	Short_term_synthesis_filtering_lanes(v, rrpl[1], 14, wtl + 13, sl + 13);
+	Short_term_synthesis_filtering_lanes(v, rrpl[2], 13, wtl + 27, sl + 27);
+	Short_term_synthesis_filtering_lanes(v, rrpl[3], 120, wtl + 40, sl + 40);
+	Postprocessing_lanes(&msr, sl);
+
+	for (k = 0; k < count; k++) rows[k] = s[k];
+	store_lanes(sl, 160, rows, count);
+	for (k = 0; k < count; k++) rows[k] = S[k]->v;
+	store_lanes(v, 8, rows, count);
+	_mm_storeu_si128((__m128i *) last, v[8]);
+	for (k = 0; k < count; k++) S[k]->v[8] = last[k];
+	_mm_storeu_si128((__m128i *) last, msr);
+	for (k = 0; k < count; k++) S[k]->msr = last[k];
+#else
+	int	k;
+
+	for (k = 0; k < count; k++) {
+		Short_term_synthesis_filtering(S[k], rrp[k][0], 13, wt[k], s[k]);
+		Short_term_synthesis_filtering(S[k], rrp[k][1], 14, wt[k] + 13, s[k] + 13);
+		Short_term_synthesis_filtering(S[k], rrp[k][2], 13, wt[k] + 27, s[k] + 27);
+		Short_term_synthesis_filtering(S[k], rrp[k][3], 120, wt[k] + 40, s[k] + 40);
+		Postprocessing(S[k], s[k]);
+	}
+#endif
+}
+
+/* gsm_encode of the next frame of each of count (<= GSM_STREAMS) distinct streams */
+static void gsm_encode_streams(gsm * S, gsm_signal ** source, gsm_byte ** c, int count)
+{
+	word	LARc[GSM_STREAMS][8], so[GSM_STREAMS][160], rp[GSM_STREAMS][4][8];
+	word	Nc[4], Mc[4], bc[4], xmaxc[4], xmc[13*4];
+	int	k;
+
+	for (k = 0; k < count; k++) {
+		Gsm_Preprocess(S[k], source[k], so[k]);
+		Gsm_LPC_Analysis(S[k], so[k], LARc[k]);
+		Short_term_reflection_coefficients(S[k], LARc[k], rp[k]);
+	}
+	Short_term_analysis_filtering_streams(S, rp, so, count);
+	for (k = 0; k < count; k++) {
+		Gsm_RPE_LTP_Coder(S[k], so[k], Nc, bc, Mc, xmaxc, xmc);
+		gsm_pack(S[k], LARc[k], Nc, bc, Mc, xmaxc, xmc, c[k]);
+	}
+}
+
+/* gsm_decode of the next frame of each of count (<= GSM_STREAMS) distinct
+   streams, answering -1 if any was not a GSM frame, as gsm_decode does */
+static int gsm_decode_streams(gsm * S, gsm_byte ** c, gsm_signal ** target, int count)
+{
+	word		LARc[8], Nc[4], Mc[4], bc[4], xmaxc[4], xmc[13*4];
+	word		wt[GSM_STREAMS][160], rrp[GSM_STREAMS][4][8];
+	gsm		decoding[GSM_STREAMS];
+	gsm_signal	* s[GSM_STREAMS];
+	int		k, n = 0;
+
+	for (k = 0; k < count; k++) {
+		if (gsm_unpack(S[k], c[k], LARc, Nc, bc, Mc, xmaxc, xmc)) continue;
+		Gsm_RPE_LTP_Decoder(S[k], Nc, bc, Mc, xmaxc, xmc, wt[n]);
+		Short_term_reflection_coefficients(S[k], LARc, rrp[n]);
+		decoding[n] = S[k];
+		s[n++] = target[k];
+	}
+	Short_term_synthesis_streams(decoding, rrp, wt, s, n);
+	return n == count ? 0 : -1;
+}
+
 /***** Squeak Interface Code Starts Here *****/
 
 /* prototypes */
@@ -3855,6 +4194,18 @@ void gsmDecode(
 	int dst, int dstIndex, int dstSize,
 	int *srcDelta, int *dstDelta);
 	
+void gsmEncodeStreams(
+	int *states, int streamCount, int frameCount,
+	int *srcs, int srcIndex, int *srcSizes,
+	int *dsts, int dstIndex, int *dstSizes,
+	int *srcDelta, int *dstDelta);
+
+void gsmDecodeStreams(
+	int *states, int streamCount, int frameCount,
+	int *srcs, int srcIndex, int *srcSizes,
+	int *dsts, int dstIndex, int *dstSizes,
+	int *srcDelta, int *dstDelta);
+
 void gsmInitState(int state);
 
 int gsmStateBytes(void);
@@ -3907,6 +4258,86 @@ void gsmDecode(
 	*dstDelta = frameCount * 160;
 }
 
+void gsmEncodeStreams(
+  int *states, int streamCount, int frameCount,
+  int *srcs, int srcIndex, int *srcSizes,
+  int *dsts, int dstIndex, int *dstSizes,
+  int *srcDelta, int *dstDelta) {
+	/* Encode frameCount frames of each of the streams, as gsmEncode would
+	   one at a time. The states must be distinct. frameCount is limited
+	   to the frames every stream has room for. */
+	gsm S[GSM_STREAMS];
+	gsm_signal *srcPtrs[GSM_STREAMS];
+	gsm_byte *dstPtrs[GSM_STREAMS];
+	int maxSrcFrames, maxDstFrames, first, count, i, k;
+
+	for (k = 0; k < streamCount; k++) {
+		maxSrcFrames = (srcSizes[k] + 1 - srcIndex) / 160;
+		maxDstFrames = (dstSizes[k] + 1 - dstIndex) / 33;
+		if (frameCount > maxSrcFrames) frameCount = maxSrcFrames;
+		if (frameCount > maxDstFrames) frameCount = maxDstFrames;
+	}
+
+	for (first = 0; first < streamCount; first += count) {
+		count = streamCount - first;
+		if (count > GSM_STREAMS) count = GSM_STREAMS;
+		for (k = 0; k < count; k++) {
+			S[k] = (gsm) states[first + k];
+			srcPtrs[k] = (gsm_signal *) (srcs[first + k] + 4 + ((srcIndex - 1) * 2));
+			dstPtrs[k] = (gsm_byte *) (dsts[first + k] + 4 + (dstIndex - 1));
+		}
+		for (i = 1; i <= frameCount; i++) {
+			gsm_encode_streams(S, srcPtrs, dstPtrs, count);
+			for (k = 0; k < count; k++) {
+				srcPtrs[k] += 160;
+				dstPtrs[k] += 33;
+			}
+		}
+	}
+	*srcDelta = frameCount * 160;
+	*dstDelta = frameCount * 33;
+}
+
+void gsmDecodeStreams(
+  int *states, int streamCount, int frameCount,
+  int *srcs, int srcIndex, int *srcSizes,
+  int *dsts, int dstIndex, int *dstSizes,
+  int *srcDelta, int *dstDelta) {
+	/* Decode frameCount frames of each of the streams, as gsmDecode would
+	   one at a time. The states must be distinct. frameCount is limited
+	   to the frames every stream has room for. */
+	gsm S[GSM_STREAMS];
+	gsm_byte *srcPtrs[GSM_STREAMS];
+	gsm_signal *dstPtrs[GSM_STREAMS];
+	int maxSrcFrames, maxDstFrames, first, count, i, k;
+
+	for (k = 0; k < streamCount; k++) {
+		maxSrcFrames = (srcSizes[k] + 1 - srcIndex) / 33;
+		maxDstFrames = (dstSizes[k] + 1 - dstIndex) / 160;
+		if (frameCount > maxSrcFrames) frameCount = maxSrcFrames;
+		if (frameCount > maxDstFrames) frameCount = maxDstFrames;
+	}
+
+	for (first = 0; first < streamCount; first += count) {
+		count = streamCount - first;
+		if (count > GSM_STREAMS) count = GSM_STREAMS;
+		for (k = 0; k < count; k++) {
+			S[k] = (gsm) states[first + k];
+			srcPtrs[k] = (gsm_byte *) (srcs[first + k] + 4 + (srcIndex - 1));
+			dstPtrs[k] = (gsm_signal *) (dsts[first + k] + 4 + ((dstIndex - 1) * 2));
+		}
+		for (i = 1; i <= frameCount; i++) {
+			gsm_decode_streams(S, srcPtrs, dstPtrs, count);
+			for (k = 0; k < count; k++) {
+				srcPtrs[k] += 33;
+				dstPtrs[k] += 160;
+			}
+		}
+	}
+	*srcDelta = frameCount * 33;
+	*dstDelta = frameCount * 160;
+}
+
 void gsmInitState(int state) {
 	/* Initialize the given GSM state record. */
 	memset((char *) state, 0, sizeof(struct gsm_state));
@@ -4,3 +4,28 @@ int oldprimSampledSoundmixSampleCountintostartingAtleftVolrightVol(void);
 int primPluckedSoundmixSampleCountintostartingAtpan(void);
 int primSampledSoundmixSampleCountintostartingAtpan(void);
 int primWaveTableSoundmixSampleCountintostartingAtpan(void);
+
+/* Imported from sqSoundMixer.c. The loops of primitiveMixSampledSound,
+   primitiveMixFMSound, primitiveMixLoopedSampledSound and
+   primitiveApplyReverb, taking the sound's fields and answering the ones
+   they update through pointers. out is the first stereo frame to mix
+   into and sample arrays are indexed from 0. Each answers -1, changing
+   nothing, if the fields are outside the range it handles exactly, and
+   the primitive must then do the work itself. soundMixLooped answers 1
+   when the sound runs out of samples. */
+int soundMixSampled(short *out, sqInt n, sqInt leftVol, sqInt rightVol,
+		    sqInt *scaledVol, sqInt *scaledVolIncr, sqInt scaledVolLimit,
+		    short *samples, sqInt samplesSize,
+		    sqInt *scaledIndex, sqInt *indexHighBits, sqInt scaledIncrement);
+int soundMixFM(short *out, sqInt n, sqInt leftVol, sqInt rightVol,
+	       sqInt *scaledVol, sqInt *scaledVolIncr, sqInt scaledVolLimit,
+	       short *waveTable, sqInt scaledWaveTableSize,
+	       sqInt *scaledIndex, sqInt scaledIndexIncr, sqInt normalizedModulation,
+	       sqInt *scaledOffsetIndex, sqInt scaledOffsetIndexIncr);
+int soundMixLooped(short *out, sqInt n, sqInt leftVol, sqInt rightVol,
+		   sqInt *scaledVol, sqInt *scaledVolIncr, sqInt scaledVolLimit,
+		   short *leftSamples, short *rightSamples, sqInt count, sqInt releaseCount,
+		   sqInt lastSample, sqInt loopEnd, sqInt scaledLoopLength,
+		   sqInt *scaledIndex, sqInt scaledIndexIncr);
+int soundApplyReverb(short *out, sqInt n, int *tapDelays, int *tapGains, sqInt tapCount,
+		     short *leftBuffer, short *rightBuffer, sqInt bufferSize, sqInt *bufferIndex);
@@ -0,0 +1,568 @@
+/*
+ *  sqSoundMixer.c
+ *  SoundGenerationPlugin
+ *
+ *  The inner loops of the sampled, looped sampled and FM sound mixing
+ *  primitives and of the reverb primitive.
+ *
+ *  The mixing loops keep the frame to frame work that has to be serial in
+ *  scalar code and do the rest four frames at a time with SSE2: the
+ *  volume and pan scaling, the looped sounds' interpolation, and the
+ *  clipped adds into the stereo buffer. Volume envelopes and the sampled
+ *  sounds' resampling positions are linear in the frame number, so they
+ *  are computed rather than stepped, and the FM sounds wrap their table
+ *  indices by subtraction rather than division. The reverb sums its taps
+ *  eight frames at a time, in runs no longer than its shortest delay so
+ *  that no frame of a run reads a sample written by another.
+ *
+ *  Results are exactly those of the generated loops. The products those
+ *  loops take in sqInts are taken here in 32 bits, so each function first
+ *  checks that the volumes, gains and indices keep them in range, and
+ *  answers -1 without touching anything when they might not; the
+ *  primitive then runs its own loop. Sounds with a loudness of at most 1.0
+ *  and reverbs whose tap gains add up to less than 2.0 are always mixed
+ *  here.
+ */
+
+#include "sq.h"
+#include "SoundGenerationPlugin.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define SOUND_SSE2 1
+# include <emmintrin.h>
+#endif
+
+/* the limits within which 32 bit products are exact (see above) */
+#define MaxScaledVol 0xFFFF
+#define MaxChannelVol 0x8000
+#define MaxGainSum 0xFFFF
+#define MaxIndex 0x20000000
+#define MaxLoopedIndex 0x40000000
+#define MaxIncrement 0x1000000
+
+#define IncrementFractionBits 16
+#define IncrementFractionMask 0xFFFF
+#define LoopIndexFractionMask 0x1FF
+#define LoopIndexScaleFactor 0x200
+#define ScaledIndexOverflow 0x20000000
+
+#define clip(s) ((s) > 32767 ? 32767 : ((s) < -32767 ? -32767 : (s)))
+
+
+/*** Volumes ***/
+
+/* A volume envelope as a function of the frame number: frame k has volume
+   vol + (k * incr) before frame clampAt and limit from then on */
+typedef struct {
+	int vol, incr, limit, clampAt;
+} Envelope;
+
+#define volumeAt(env, k) ((k) < (env).clampAt ? (env).vol + ((k) * (env).incr) : (env).limit)
+
+static int
+loadEnvelope(Envelope *env, sqInt scaledVol, sqInt scaledVolIncr, sqInt scaledVolLimit)
+{
+	int distance, step;
+
+	if(scaledVol < 0 || scaledVol > MaxScaledVol) return 0;
+	if(scaledVolIncr != 0
+	 && (scaledVolLimit < 0 || scaledVolLimit > MaxScaledVol
+	  || scaledVolIncr < -MaxScaledVol || scaledVolIncr > MaxScaledVol))
+		return 0;
+	env->vol = (int) scaledVol;
+	env->incr = (int) scaledVolIncr;
+	env->limit = (int) scaledVolLimit;
+	if(env->incr == 0) {
+		env->clampAt = 0x7FFFFFFF;
+		return 1;
+	}
+	/* the first step that reaches the limit */
+	distance = env->incr > 0 ? env->limit - env->vol : env->vol - env->limit;
+	step = env->incr > 0 ? env->incr : -env->incr;
+	env->clampAt = distance <= step ? 1 : (distance + step - 1) / step;
+	return 1;
+}
+
+/* Answer the envelope as the generated loops leave it after frames steps */
+static void
+storeEnvelope(Envelope *env, int frames, sqInt *scaledVol, sqInt *scaledVolIncr)
+{
+	if(frames >= env->clampAt) {
+		*scaledVol = env->limit;
+		*scaledVolIncr = 0;
+	} else
+		*scaledVol = env->vol + (frames * env->incr);
+}
+
+/* The channel volumes, zero for a channel that is not mixed */
+typedef struct {
+	int left, right;
+#ifdef SOUND_SSE2
+	__m128i leftVol, rightVol;
+	__m128i floor;		/* -32767, or -32768 to leave a channel alone */
+#endif
+} Channels;
+
+static int
+loadChannels(Channels *ch, sqInt leftVol, sqInt rightVol)
+{
+	if(leftVol > MaxChannelVol || rightVol > MaxChannelVol) return 0;
+	ch->left = leftVol > 0 ? (int) leftVol : 0;
+	ch->right = rightVol > 0 ? (int) rightVol : 0;
+#ifdef SOUND_SSE2
+	ch->leftVol = _mm_set1_epi32(ch->left);
+	ch->rightVol = _mm_set1_epi32(ch->right);
+	ch->floor = _mm_set_epi16(ch->right ? -32767 : -32768, ch->left ? -32767 : -32768,
+				  ch->right ? -32767 : -32768, ch->left ? -32767 : -32768,
+				  ch->right ? -32767 : -32768, ch->left ? -32767 : -32768,
+				  ch->right ? -32767 : -32768, ch->left ? -32767 : -32768);
+#endif
+	return 1;
+}
+
+
+/*** Frames ***/
+
+static void
+addFrame(short *out, int left, int right, Channels *ch)
+{
+	int s;
+
+	if(ch->left) {
+		s = out[0] + left;
+		out[0] = clip(s);
+	}
+	if(ch->right) {
+		s = out[1] + right;
+		out[1] = clip(s);
+	}
+}
+
+/* Scale a sample by its volume and by the channel volumes, as the sampled
+   and FM sounds do, and add it into a frame */
+static void
+mixScaled(short *out, int raw, int vol, Channels *ch)
+{
+	int sample = (raw * vol) >> 15;
+
+	addFrame(out, (sample * ch->left) >> 15, (sample * ch->right) >> 15, ch);
+}
+
+/* Interpolate between the samples a and b at m / 512, scale by the
+   composite volumes, as the looped sampled sounds do, and add into a frame */
+static void
+mixInterpolated(short *out, int a, int b, int rightA, int rightB, int m, int vol, Channels *ch)
+{
+	int leftVal = ((a * (LoopIndexScaleFactor - m)) + (b * m)) >> 9;
+	int rightVal = ((rightA * (LoopIndexScaleFactor - m)) + (rightB * m)) >> 9;
+
+	addFrame(out, (((ch->left * vol) >> 15) * leftVal) >> 15,
+		 (((ch->right * vol) >> 15) * rightVal) >> 15, ch);
+}
+
+#ifdef SOUND_SSE2
+/* The low 32 bits of the products of four pairs of ints */
+static __m128i
+mul32(__m128i a, __m128i b)
+{
+	__m128i even = _mm_mul_epu32(a, b);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+				  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static void
+addFrames4(short *out, __m128i left, __m128i right, Channels *ch)
+{
+	__m128i frames = _mm_loadu_si128((__m128i *) out);
+	__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(frames, frames), 16);
+	__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(frames, frames), 16);
+
+	lo = _mm_add_epi32(lo, _mm_unpacklo_epi32(left, right));
+	hi = _mm_add_epi32(hi, _mm_unpackhi_epi32(left, right));
+	_mm_storeu_si128((__m128i *) out, _mm_max_epi16(_mm_packs_epi32(lo, hi), ch->floor));
+}
+
+static void
+mixScaled4(short *out, __m128i raw, __m128i vol, Channels *ch)
+{
+	__m128i sample = _mm_srai_epi32(mul32(raw, vol), 15);
+
+	addFrames4(out, _mm_srai_epi32(mul32(sample, ch->leftVol), 15),
+		   _mm_srai_epi32(mul32(sample, ch->rightVol), 15), ch);
+}
+
+/* pairs hold a and b for each frame, weights 512 - m and m */
+static void
+mixInterpolated4(short *out, __m128i leftPairs, __m128i rightPairs, __m128i weights, __m128i vol, Channels *ch)
+{
+	__m128i leftVal = _mm_srai_epi32(_mm_madd_epi16(leftPairs, weights), 9);
+	__m128i rightVal = _mm_srai_epi32(_mm_madd_epi16(rightPairs, weights), 9);
+	__m128i leftComposite = _mm_srai_epi32(mul32(ch->leftVol, vol), 15);
+	__m128i rightComposite = _mm_srai_epi32(mul32(ch->rightVol, vol), 15);
+
+	addFrames4(out, _mm_srai_epi32(mul32(leftComposite, leftVal), 15),
+		   _mm_srai_epi32(mul32(rightComposite, rightVal), 15), ch);
+}
+
+#define volumes4(env, k) \
+	_mm_set_epi32(volumeAt(env, (k) + 3), volumeAt(env, (k) + 2), volumeAt(env, (k) + 1), volumeAt(env, k))
+#endif
+
+
+/*** Sampled sounds ***/
+
+int
+soundMixSampled(short *out, sqInt n, sqInt leftVol, sqInt rightVol,
+		sqInt *scaledVol, sqInt *scaledVolIncr, sqInt scaledVolLimit,
+		short *samples, sqInt samplesSize,
+		sqInt *scaledIndex, sqInt *indexHighBits, sqInt scaledIncrement)
+{
+	Envelope env;
+	Channels ch;
+	short *src;
+	sqLong span;
+	int index, highBits, incr, sampleIndex, fraction, frames, steps, k;
+
+	if(n < 0 || !loadChannels(&ch, leftVol, rightVol)
+	 || !loadEnvelope(&env, *scaledVol, *scaledVolIncr, scaledVolLimit)
+	 || *scaledIndex < 0 || *scaledIndex >= ScaledIndexOverflow
+	 || scaledIncrement < 0 || scaledIncrement >= MaxIncrement
+	 || *indexHighBits < 0 || *indexHighBits >= MaxIndex
+	 || samplesSize < 0 || samplesSize >= MaxIndex)
+		return -1;
+	index = (int) *scaledIndex;
+	highBits = (int) *indexHighBits;
+	incr = (int) scaledIncrement;
+
+	/* Frame k plays sample sampleIndex + ((fraction + (k * incr)) >> 16);
+	   mixing stops at the end of the samples */
+	sampleIndex = highBits + (index >> IncrementFractionBits);
+	fraction = index & IncrementFractionMask;
+	if(sampleIndex > samplesSize)
+		frames = 0;
+	else if(incr == 0)
+		frames = (int) n;
+	else {
+		span = ((sqLong) (samplesSize - sampleIndex + 1) << IncrementFractionBits) - fraction;
+		span = (span + incr - 1) / incr;
+		frames = span < n ? (int) span : (int) n;
+	}
+	src = samples + sampleIndex - 1;
+	k = 0;
+#ifdef SOUND_SSE2
+	for(; k + 4 <= frames; k += 4) {
+		int r0, r1, r2, r3;
+
+		r0 = src[fraction >> IncrementFractionBits];
+		r1 = src[(fraction + incr) >> IncrementFractionBits];
+		r2 = src[(fraction + (2 * incr)) >> IncrementFractionBits];
+		r3 = src[(fraction + (3 * incr)) >> IncrementFractionBits];
+		fraction += 4 * incr;
+		src += fraction >> IncrementFractionBits;
+		fraction &= IncrementFractionMask;
+		mixScaled4(out + (2 * k), _mm_set_epi32(r3, r2, r1, r0), volumes4(env, k), &ch);
+	}
+#endif
+	for(; k < frames; k++) {
+		mixScaled(out + (2 * k), src[fraction >> IncrementFractionBits], volumeAt(env, k), &ch);
+		fraction += incr;
+		src += fraction >> IncrementFractionBits;
+		fraction &= IncrementFractionMask;
+	}
+	storeEnvelope(&env, frames, scaledVol, scaledVolIncr);
+
+	/* The generated loop moves whole samples from scaledIndex into
+	   indexHighBits whenever scaledIndex reaches ScaledIndexOverflow */
+	for(steps = frames; steps > 0 && incr > 0; ) {
+		int toOverflow = ((ScaledIndexOverflow - index) + incr - 1) / incr;
+		int overflow;
+
+		if(toOverflow > steps) {
+			index += steps * incr;
+			break;
+		}
+		index += toOverflow * incr;
+		overflow = index >> IncrementFractionBits;
+		highBits += overflow;
+		index -= overflow << IncrementFractionBits;
+		steps -= toOverflow;
+	}
+	*scaledIndex = index;
+	*indexHighBits = highBits;
+	return 0;
+}
+
+
+/*** FM sounds ***/
+
+typedef struct {
+	short *waveTable;
+	int size, index, incr, offsetIndex, offsetIncr, modulation, doingFM;
+} Oscillator;
+
+/* a mod size, for a within a few sizes of 0..size-1 */
+static int
+wrapIndex(int a, int size)
+{
+	if(a >= size) {
+		a -= size;
+		if(a >= size) a %= size;
+	} else if(a < 0) {
+		a += size;
+		if(a < 0) {
+			a %= size;
+			if(a < 0) a += size;
+		}
+	}
+	return a;
+}
+
+/* Answer the oscillator's sample and step it to the next frame */
+static int
+nextSample(Oscillator *osc)
+{
+	int sample = osc->waveTable[osc->index >> 15];
+
+	if(osc->doingFM) {
+		int offset = osc->modulation * osc->waveTable[osc->offsetIndex >> 15];
+
+		osc->offsetIndex = wrapIndex(osc->offsetIndex + osc->offsetIncr, osc->size);
+		osc->index = wrapIndex((osc->index + osc->incr) + offset, osc->size);
+	} else
+		osc->index = wrapIndex(osc->index + osc->incr, osc->size);
+	return sample;
+}
+
+int
+soundMixFM(short *out, sqInt n, sqInt leftVol, sqInt rightVol,
+	   sqInt *scaledVol, sqInt *scaledVolIncr, sqInt scaledVolLimit,
+	   short *waveTable, sqInt scaledWaveTableSize,
+	   sqInt *scaledIndex, sqInt scaledIndexIncr, sqInt normalizedModulation,
+	   sqInt *scaledOffsetIndex, sqInt scaledOffsetIndexIncr)
+{
+	Envelope env;
+	Channels ch;
+	Oscillator osc;
+	int k;
+
+	osc.doingFM = normalizedModulation != 0 && scaledOffsetIndexIncr != 0;
+	if(n < 0 || !loadChannels(&ch, leftVol, rightVol)
+	 || !loadEnvelope(&env, *scaledVol, *scaledVolIncr, scaledVolLimit)
+	 || scaledWaveTableSize <= 0 || scaledWaveTableSize >= MaxIndex
+	 || *scaledIndex < 0 || *scaledIndex >= scaledWaveTableSize
+	 || scaledIndexIncr <= -MaxIndex || scaledIndexIncr >= MaxIndex
+	 || (!osc.doingFM && scaledIndexIncr < 0))
+		return -1;
+	if(osc.doingFM
+	 && (*scaledOffsetIndex < 0 || *scaledOffsetIndex >= scaledWaveTableSize
+	  || scaledOffsetIndexIncr <= -MaxIndex || scaledOffsetIndexIncr >= MaxIndex
+	  || normalizedModulation <= -(MaxIndex >> 15) || normalizedModulation >= (MaxIndex >> 15)))
+		return -1;
+	osc.waveTable = waveTable;
+	osc.size = (int) scaledWaveTableSize;
+	osc.index = (int) *scaledIndex;
+	osc.offsetIndex = (int) *scaledOffsetIndex;
+	osc.modulation = (int) normalizedModulation;
+	/* the increments mod size, which the generated loop's remainders
+	   amount to since the indices stay in 0..size-1 */
+	osc.incr = wrapIndex((int) (scaledIndexIncr % osc.size), osc.size);
+	osc.offsetIncr = wrapIndex((int) (scaledOffsetIndexIncr % osc.size), osc.size);
+	k = 0;
+#ifdef SOUND_SSE2
+	for(; k + 4 <= n; k += 4) {
+		int r0, r1, r2, r3;
+
+		r0 = nextSample(&osc);
+		r1 = nextSample(&osc);
+		r2 = nextSample(&osc);
+		r3 = nextSample(&osc);
+		mixScaled4(out + (2 * k), _mm_set_epi32(r3, r2, r1, r0), volumes4(env, k), &ch);
+	}
+#endif
+	for(; k < n; k++)
+		mixScaled(out + (2 * k), nextSample(&osc), volumeAt(env, k), &ch);
+	storeEnvelope(&env, (int) n, scaledVol, scaledVolIncr);
+	*scaledIndex = osc.index;
+	if(osc.doingFM) *scaledOffsetIndex = osc.offsetIndex;
+	return 0;
+}
+
+
+/*** Looped sampled sounds ***/
+
+int
+soundMixLooped(short *out, sqInt n, sqInt leftVol, sqInt rightVol,
+	       sqInt *scaledVol, sqInt *scaledVolIncr, sqInt scaledVolLimit,
+	       short *leftSamples, short *rightSamples, sqInt count, sqInt releaseCount,
+	       sqInt lastSample, sqInt loopEnd, sqInt scaledLoopLength,
+	       sqInt *scaledIndex, sqInt scaledIndexIncr)
+{
+	Envelope env;
+	Channels ch;
+	int index, incr, loopLength, last, end, looping, k;
+
+	if(n < 0 || !loadChannels(&ch, leftVol, rightVol)
+	 || !loadEnvelope(&env, *scaledVol, *scaledVolIncr, scaledVolLimit)
+	 || *scaledIndex < 0 || *scaledIndex >= MaxLoopedIndex
+	 || scaledIndexIncr < 0 || scaledIndexIncr >= MaxLoopedIndex
+	 || (scaledIndexIncr > 0 && n >= (MaxLoopedIndex - *scaledIndex) / scaledIndexIncr)
+	 || scaledLoopLength < 0 || scaledLoopLength >= MaxLoopedIndex
+	 || lastSample < 0 || lastSample >= MaxLoopedIndex
+	 || loopEnd < 0 || loopEnd >= MaxLoopedIndex)
+		return -1;
+	index = (int) *scaledIndex;
+	incr = (int) scaledIndexIncr;
+	loopLength = (int) scaledLoopLength;
+	last = (int) lastSample;
+	end = (int) loopEnd;
+	/* count only changes after the loop, so looping holds for every frame.
+	   A mono sound has the same array for both channels. */
+	looping = count > releaseCount;
+	for(k = 0; k < n; ) {
+		int sampleIndex, nextSampleIndex, m;
+#ifdef SOUND_SSE2
+		/* four frames that neither loop back nor reach the last sample */
+		sampleIndex = (index + (4 * incr)) >> 9;
+		if(k + 4 <= n && sampleIndex < last && (sampleIndex <= end || !looping)) {
+			__m128i indices = _mm_add_epi32(_mm_set1_epi32(index),
+							_mm_set_epi32(4 * incr, 3 * incr, 2 * incr, incr));
+			__m128i fractions = _mm_and_si128(indices, _mm_set1_epi32(LoopIndexFractionMask));
+			__m128i weights = _mm_or_si128(_mm_sub_epi32(_mm_set1_epi32(LoopIndexScaleFactor), fractions),
+						       _mm_slli_epi32(fractions, 16));
+			int s0 = ((index + incr) >> 9) - 1;
+			int s1 = ((index + (2 * incr)) >> 9) - 1;
+			int s2 = ((index + (3 * incr)) >> 9) - 1;
+			int s3 = sampleIndex - 1;
+
+			mixInterpolated4(out + (2 * k),
+					 _mm_set_epi16(leftSamples[s3 + 1], leftSamples[s3], leftSamples[s2 + 1], leftSamples[s2],
+						       leftSamples[s1 + 1], leftSamples[s1], leftSamples[s0 + 1], leftSamples[s0]),
+					 _mm_set_epi16(rightSamples[s3 + 1], rightSamples[s3], rightSamples[s2 + 1], rightSamples[s2],
+						       rightSamples[s1 + 1], rightSamples[s1], rightSamples[s0 + 1], rightSamples[s0]),
+					 weights, volumes4(env, k), &ch);
+			index += 4 * incr;
+			k += 4;
+			continue;
+		}
+#endif
+		/* one frame, as the generated loop steps it */
+		sampleIndex = (index += incr) >> 9;
+		if(sampleIndex > end && looping)
+			sampleIndex = (index -= loopLength) >> 9;
+		if((nextSampleIndex = sampleIndex + 1) > last) {
+			if(sampleIndex > last) {
+				storeEnvelope(&env, k, scaledVol, scaledVolIncr);
+				*scaledIndex = index;
+				return 1;
+			}
+			nextSampleIndex = loopLength == 0 ? sampleIndex : ((index - loopLength) >> 9) + 1;
+		}
+		m = index & LoopIndexFractionMask;
+		mixInterpolated(out + (2 * k), leftSamples[sampleIndex - 1], leftSamples[nextSampleIndex - 1],
+				rightSamples[sampleIndex - 1], rightSamples[nextSampleIndex - 1], m,
+				volumeAt(env, k), &ch);
+		k++;
+	}
+	storeEnvelope(&env, k, scaledVol, scaledVolIncr);
+	*scaledIndex = index;
+	return 0;
+}
+
+
+/*** Reverb ***/
+
+int
+soundApplyReverb(short *out, sqInt n, int *tapDelays, int *tapGains, sqInt tapCount,
+		 short *leftBuffer, short *rightBuffer, sqInt bufferSize, sqInt *bufferIndex)
+{
+	int bi, size, minDelay, gainSum, run, t, k;
+
+	if(n < 0 || tapCount < 1 || bufferSize < 2 || bufferSize >= MaxIndex
+	 || *bufferIndex < 1 || *bufferIndex > bufferSize)
+		return -1;
+	size = (int) bufferSize;
+	minDelay = size;
+	gainSum = 0;
+	for(t = 0; t < tapCount; t++) {
+		if(tapDelays[t] < 1 || tapDelays[t] >= size
+		 || tapGains[t] < -32767 || tapGains[t] > 32767)
+			return -1;
+		if(tapDelays[t] < minDelay) minDelay = tapDelays[t];
+		gainSum += tapGains[t] < 0 ? -tapGains[t] : tapGains[t];
+		if(gainSum > MaxGainSum) return -1;
+	}
+	bi = (int) *bufferIndex;
+	while(n > 0) {
+		/* a run of frames that neither wraps around the delay buffers nor
+		   reads what it writes */
+		run = n < minDelay ? (int) n : minDelay;
+		if(run > size - bi + 1) run = size - bi + 1;
+		for(t = 0; t < tapCount; t++) {
+			int i = bi - tapDelays[t];
+
+			if(i < 1) i += size;
+			if(run > size - i + 1) run = size - i + 1;
+		}
+		k = 0;
+#ifdef SOUND_SSE2
+		for(; k + 8 <= run; k += 8) {
+			__m128i l0 = _mm_setzero_si128(), l1 = l0, r0 = l0, r1 = l0;
+			__m128i v0, v1, sl0, sl1, sr0, sr1, newLeft, newRight;
+			__m128i floor = _mm_set1_epi16(-32767);
+
+			for(t = 0; t < tapCount; t++) {
+				int i = bi + k - tapDelays[t];
+				__m128i gain = _mm_set1_epi16((short) tapGains[t]);
+				__m128i x, lo, hi;
+
+				if(i < 1) i += size;
+				x = _mm_loadu_si128((__m128i *) (leftBuffer + i - 1));
+				lo = _mm_mullo_epi16(x, gain);
+				hi = _mm_mulhi_epi16(x, gain);
+				l0 = _mm_add_epi32(l0, _mm_unpacklo_epi16(lo, hi));
+				l1 = _mm_add_epi32(l1, _mm_unpackhi_epi16(lo, hi));
+				x = _mm_loadu_si128((__m128i *) (rightBuffer + i - 1));
+				lo = _mm_mullo_epi16(x, gain);
+				hi = _mm_mulhi_epi16(x, gain);
+				r0 = _mm_add_epi32(r0, _mm_unpacklo_epi16(lo, hi));
+				r1 = _mm_add_epi32(r1, _mm_unpackhi_epi16(lo, hi));
+			}
+			v0 = _mm_loadu_si128((__m128i *) (out + 2 * k));
+			v1 = _mm_loadu_si128((__m128i *) (out + 2 * k + 8));
+			sl0 = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(v0, 16), 16), _mm_srai_epi32(l0, 15));
+			sl1 = _mm_add_epi32(_mm_srai_epi32(_mm_slli_epi32(v1, 16), 16), _mm_srai_epi32(l1, 15));
+			sr0 = _mm_add_epi32(_mm_srai_epi32(v0, 16), _mm_srai_epi32(r0, 15));
+			sr1 = _mm_add_epi32(_mm_srai_epi32(v1, 16), _mm_srai_epi32(r1, 15));
+			newLeft = _mm_max_epi16(_mm_packs_epi32(sl0, sl1), floor);
+			newRight = _mm_max_epi16(_mm_packs_epi32(sr0, sr1), floor);
+			_mm_storeu_si128((__m128i *) (out + 2 * k), _mm_unpacklo_epi16(newLeft, newRight));
+			_mm_storeu_si128((__m128i *) (out + 2 * k + 8), _mm_unpackhi_epi16(newLeft, newRight));
+			_mm_storeu_si128((__m128i *) (leftBuffer + bi + k - 1), newLeft);
+			_mm_storeu_si128((__m128i *) (rightBuffer + bi + k - 1), newRight);
+		}
+#endif
+		for(; k < run; k++) {
+			int delayedLeft = 0, delayedRight = 0, s;
+
+			for(t = 0; t < tapCount; t++) {
+				int i = bi + k - tapDelays[t];
+
+				if(i < 1) i += size;
+				delayedLeft += tapGains[t] * leftBuffer[i - 1];
+				delayedRight += tapGains[t] * rightBuffer[i - 1];
+			}
+			s = out[2 * k] + (delayedLeft >> 15);
+			out[2 * k] = leftBuffer[bi + k - 1] = s > 32767 ? 32767 : (s < -32767 ? -32767 : s);
+			s = out[2 * k + 1] + (delayedRight >> 15);
+			out[2 * k + 1] = rightBuffer[bi + k - 1] = s > 32767 ? 32767 : (s < -32767 ? -32767 : s);
+		}
+		out += 2 * run;
+		n -= run;
+		bi += run;
+		if(bi > size) bi = 1;
+	}
+	*bufferIndex = bi;
+	return 0;
+}
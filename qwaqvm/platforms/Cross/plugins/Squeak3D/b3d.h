@@ -61,8 +61,17 @@ typedef struct B3DRasterizerState {
 	/* Function to call on drawing the output buffer */
 	b3dDrawBufferFunction spanDrawer;
 
+	/* Which span shaders to use (B3D_FILL_DEFAULT or B3D_FILL_SCALAR).
+	   B3D_FILL_DEFAULT defers to the mode set by b3dSetFillMode(). */
+	int fillMode;
+
 } B3DRasterizerState;
 
+/* Span shader selection. The default picks the fastest shaders
+   available on this CPU; the scalar ones are mainly for comparison. */
+#define B3D_FILL_DEFAULT 0
+#define B3D_FILL_SCALAR  1
+
 extern B3DRasterizerState *currentState;
 
 /* from b3dInit.c */
@@ -99,6 +108,8 @@ int b3dValidateAndRemapState(B3DRasterizerState *state);
 /* from b3dDraw.c */
 typedef void (*b3dPixelDrawer) (int leftX, int rightX, int yValue, B3DPrimitiveFace *face);
 extern b3dPixelDrawer B3D_FILL_FUNCTIONS[];
+b3dPixelDrawer *b3dFillFunctionsFor(B3DRasterizerState *state);
+int b3dSetFillMode(int mode);
 
 /* from b3dMain.c */
 void b3dAbort(char *msg);
@@ -94,6 +94,12 @@ double attrValueAt(B3DPrimitiveFace *face, B3DPrimitiveAttribute *attr, double x
 	attr = attr->next;\
 	CLAMP_RGB(rValue, gValue, bValue);
 
+#define SETUP_A \
+	aValue = (int)(attrValueAt(face, attr, floatX, floatY) * B3D_FloatToFixed); \
+	deltaA = (int) (attr->dvdx * B3D_FloatToFixed); \
+	attr = attr->next; \
+	CLAMP(aValue, B3D_FixedHalf, (255 << B3D_IntToFixedShift) + B3D_FixedHalf);
+
 #define SETUP_STW \
 	wValue = attrValueAt(face, attr, floatX, floatY); \
 	wDelta = attr->dvdx; \
@@ -209,6 +215,21 @@ static void MULTBL_Init(void)
 	DO_RGB_INTERPOLATION(sf, si, tf, ti)\
 }
 
+#define INTERPOLATE_RGBA_TEXEL(fixedS, fixedT)\
+{	int sf, si, tf, ti;\
+	sf = (fixedS >> (B3D_FixedToIntShift - 4)) & 15; si = 16 - sf;\
+	tf = (fixedT >> (B3D_FixedToIntShift - 4)) & 15; ti = 16 - tf;\
+	DO_RGBA_INTERPOLATION(sf, si, tf, ti)\
+}
+
+#if USE_MULTBL
+#define MODULATE_TEXEL(value, texel) \
+	((unsigned char) (MULTBL[(value) >> (B3D_FixedToIntShift+4)][texel]))
+#else
+#define MODULATE_TEXEL(value, texel) \
+	((unsigned char) (((texel) * (value)) >> (B3D_FixedToIntShift + 8)))
+#endif
+
 void b3dNoDraw     (int leftX, int rightX, int yValue, B3DPrimitiveFace *face);
 void b3dDrawRGB    (int leftX, int rightX, int yValue, B3DPrimitiveFace *face);
 void b3dDrawRGBA   (int leftX, int rightX, int yValue, B3DPrimitiveFace *face);
@@ -476,14 +497,181 @@ void b3dDrawSTWRGB(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
 	}
 }
 
-void b3dDrawSTWARGB(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
+void b3dDrawRGBA(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
 {
-	/* not yet implemented */
+	struct b3dPixelColor { B3DPrimitiveColor color; } pv, *bits;
+	int rValue, gValue, bValue, aValue;
+	int deltaR, deltaG, deltaB, deltaA;
+	int deltaX, pixelShift;
+
+	{
+		B3DPrimitiveAttribute *attr = face->attributes;
+		/* See above */
+		double floatX = leftX;
+		double floatY = yValue+0.5;
+
+		if(b3dDebug)
+			if(!attr) b3dAbort("face has no RGBA attributes");
+
+		SETUP_RGB;
+		SETUP_A;
+	}
+
+	bits = (struct b3dPixelColor *) currentState->spanBuffer;
+
+	/* Same as b3dDrawRGB but interpolating alpha as well */
+	deltaX = rightX - leftX + 1;
+	for(pixelShift= MAX_PIXEL_SHIFT; pixelShift> 0; pixelShift--) {
+		int nPixels = 1 << pixelShift;
+		while(deltaX >= nPixels) {	
+			{	/* Compute right most values of color interpolation */
+				int maxR = rValue + (deltaR << pixelShift);
+				int maxG = gValue + (deltaG << pixelShift);
+				int maxB = bValue + (deltaB << pixelShift);
+				int maxA = aValue + (deltaA << pixelShift);
+				/* Clamp those guys */
+				CLAMP_RGB(maxR, maxG, maxB);
+				CLAMP(maxA, B3D_FixedHalf, (255 << B3D_IntToFixedShift) + B3D_FixedHalf);
+				/* And compute the actual delta */
+				deltaR = (maxR - rValue) >> pixelShift;
+				deltaG = (maxG - gValue) >> pixelShift;
+				deltaB = (maxB - bValue) >> pixelShift;
+				deltaA = (maxA - aValue) >> pixelShift;
+			}
+			/* Do the inner loop */
+			{	int n = nPixels;
+				while(n--) {
+					pv.redValue   = (unsigned char) (rValue >> B3D_FixedToIntShift);
+					pv.greenValue = (unsigned char) (gValue >> B3D_FixedToIntShift);
+					pv.blueValue  = (unsigned char) (bValue >> B3D_FixedToIntShift);
+					pv.alphaValue = (unsigned char) (aValue >> B3D_FixedToIntShift);
+					bits[leftX++] = pv;
+					rValue += deltaR;
+					gValue += deltaG;
+					bValue += deltaB;
+					aValue += deltaA;
+				}
+			}
+			/* Finally, adjust the number of pixels left */
+			deltaX -= nPixels;
+		}
+	}
+	/* The last pixel is done separately */
+	if(deltaX) {
+		pv.redValue   = (unsigned char) (rValue >> B3D_FixedToIntShift);
+		pv.greenValue = (unsigned char) (gValue >> B3D_FixedToIntShift);
+		pv.blueValue  = (unsigned char) (bValue >> B3D_FixedToIntShift);
+		pv.alphaValue = (unsigned char) (aValue >> B3D_FixedToIntShift);
+		bits[leftX++] = pv;
+	}
 }
 
-void b3dDrawRGBA(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
+void b3dDrawSTWARGB(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
 {
-	/* not yet implemented */
+	struct b3dPixelColor { B3DPrimitiveColor color; } pv, *bits, *tex00, *tex10, *tex01, *tex11;
+	double sValue, tValue, wValue, sDelta, tDelta, wDelta, oneOverW;
+	int rValue, gValue, bValue, aValue;
+	int deltaR, deltaG, deltaB, deltaA;
+	int tr, tg, tb, ta;
+	int fixedLeftS, fixedRightS, fixedLeftT, fixedRightT, fixedDeltaS, fixedDeltaT;
+	int deltaX, pixelShift;
+
+	B3DTexture *texture = face->texture;
+
+	INIT_MULTBL;
+
+	if(!texture) {
+		/* If no texture simply draw RGBA */
+		b3dDrawRGBA(leftX, rightX, yValue, face);
+		return;
+	}
+	if(texture->depth < 16 && (texture->cmSize < (1 << texture->depth)))
+		return; /* Colormap not installed */
+
+	{
+		B3DPrimitiveAttribute *attr = face->attributes;
+		/* See above */
+		double floatX = leftX;
+		double floatY = yValue+0.5;
+
+		if(b3dDebug)
+			if(!attr) b3dAbort("face has no RGBA attributes");
+
+		SETUP_RGB;
+		SETUP_A;
+		SETUP_STW;
+	}
+
+	bits = (struct b3dPixelColor *) currentState->spanBuffer;
+
+	/* Same as b3dDrawSTWRGB but modulating the texel's alpha as well */
+	deltaX = rightX - leftX + 1;
+	if(wValue) oneOverW = 1.0 / wValue;
+	else oneOverW = 0.0;
+	fixedLeftS = (int) (sValue * oneOverW * (texture->width << B3D_IntToFixedShift));
+	fixedLeftT = (int) (tValue * oneOverW * (texture->height << B3D_IntToFixedShift));
+
+	for(pixelShift = MAX_PIXEL_SHIFT; pixelShift > 0; pixelShift--) {
+		int nPixels = 1 << pixelShift;
+		while(deltaX >= nPixels) {
+			{	/* Compute right most values of color interpolation */
+				int maxR = rValue + (deltaR << pixelShift);
+				int maxG = gValue + (deltaG << pixelShift);
+				int maxB = bValue + (deltaB << pixelShift);
+				int maxA = aValue + (deltaA << pixelShift);
+				/* Clamp those guys */
+				CLAMP_RGB(maxR, maxG, maxB);
+				CLAMP(maxA, B3D_FixedHalf, (255 << B3D_IntToFixedShift) + B3D_FixedHalf);
+				/* And compute the actual delta */
+				deltaR = (maxR - rValue) >> pixelShift;
+				deltaG = (maxG - gValue) >> pixelShift;
+				deltaB = (maxB - bValue) >> pixelShift;
+				deltaA = (maxA - aValue) >> pixelShift;
+			}
+			/* Compute the RIGHT s/t values (the left ones are kept from the last loop) */
+			wValue += wDelta * nPixels;
+			sValue += sDelta * nPixels;
+			tValue += tDelta * nPixels;
+			if(wValue) oneOverW = 1.0 / wValue;
+			else oneOverW = 0.0;
+			fixedRightS = (int) (sValue * oneOverW * (texture->width << B3D_IntToFixedShift));
+			fixedDeltaS = (fixedRightS - fixedLeftS) >> pixelShift;
+			fixedRightT = (int) (tValue * oneOverW * (texture->height << B3D_IntToFixedShift));
+			fixedDeltaT = (fixedRightT - fixedLeftT) >> pixelShift;
+			/* Do the inner loop */
+			{	int n = nPixels;
+				while(n--) {
+					LOAD_4_RGB_TEXEL_32(fixedLeftS, fixedLeftT, texture);
+					INTERPOLATE_RGBA_TEXEL(fixedLeftS, fixedLeftT);
+					pv.redValue   = MODULATE_TEXEL(rValue, tr);
+					pv.greenValue = MODULATE_TEXEL(gValue, tg);
+					pv.blueValue  = MODULATE_TEXEL(bValue, tb);
+					pv.alphaValue = MODULATE_TEXEL(aValue, ta);
+					bits[leftX++] = pv;
+					rValue += deltaR;
+					gValue += deltaG;
+					bValue += deltaB;
+					aValue += deltaA;
+					fixedLeftS += fixedDeltaS;
+					fixedLeftT += fixedDeltaT;
+				}
+			}
+			/* Finally, adjust the number of pixels left and update s/t */
+			deltaX -= nPixels;
+			fixedLeftS = fixedRightS;
+			fixedLeftT = fixedRightT;
+		}
+	}
+	/* The last pixel is done separately */
+	if(deltaX) {
+		LOAD_4_RGB_TEXEL_32(fixedLeftS, fixedLeftT, texture);
+		INTERPOLATE_RGBA_TEXEL(fixedLeftS, fixedLeftT);
+		pv.redValue   = MODULATE_TEXEL(rValue, tr);
+		pv.greenValue = MODULATE_TEXEL(gValue, tg);
+		pv.blueValue  = MODULATE_TEXEL(bValue, tb);
+		pv.alphaValue = MODULATE_TEXEL(aValue, ta);
+		bits[leftX++] = pv;
+	}
 }
 
 void b3dDrawSTW(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
@@ -495,3 +683,430 @@ void b3dDrawSTWA(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
 {
 	/* not yet implemented */
 }
+
+/****************************************************************************
+*	SSE2 span shaders
+*
+*	These produce exactly the same pixels as the scalar versions above
+*	(including the MULTBL rounding) but shade four pixels per iteration.
+*	Texel addresses are still computed per pixel since SSE2 has no gather,
+*	but the bilinear filter, the color modulation and the packing of the
+*	results are done for all four pixels at once.
+*
+*****************************************************************************/
+#if defined(__SSE2__) && USE_MULTBL && !defined(MSB_FIRST)
+
+#define B3D_HAVE_SSE2 1
+
+#include <emmintrin.h>
+#if defined(__GNUC__) && !defined(__x86_64__)
+# include <cpuid.h>
+#elif defined(_MSC_VER) && !defined(_M_X64)
+# include <intrin.h>
+#endif
+
+#define RED_SHIFT   (RED_INDEX * 8)
+#define GREEN_SHIFT (GREEN_INDEX * 8)
+#define BLUE_SHIFT  (BLUE_INDEX * 8)
+#define ALPHA_SHIFT (ALPHA_INDEX * 8)
+
+/* Four fixed point values starting at value and stepping by delta */
+#define FIXED4(value, delta) \
+	_mm_set_epi32((value) + 3*(delta), (value) + 2*(delta), (value) + (delta), (value))
+
+/* Four pixels from four fixed point channel vectors; shift selects
+   either the integer part (B3D_FixedToIntShift) or the MULTBL index
+   (B3D_FixedToIntShift+4) of each channel */
+#define PACK4(r, g, b, a, shift) \
+	_mm_or_si128( \
+		_mm_or_si128( \
+			_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(r, shift), byteMask), RED_SHIFT), \
+			_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(g, shift), byteMask), GREEN_SHIFT)), \
+		_mm_or_si128( \
+			_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(b, shift), byteMask), BLUE_SHIFT), \
+			_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(a, shift), byteMask), ALPHA_SHIFT)))
+
+/* Bilinearly filter the texels of four pixels and modulate the result
+   by four pixels worth of MULTBL indices (0-16 per channel). Equivalent
+   to DO_RGBA_INTERPOLATION followed by MULTBL[modulator][texel]. */
+static __m128i b3dFilterAndModulate4(
+	__m128i t00, __m128i t01, __m128i t10, __m128i t11,
+	__m128i sf, __m128i tf, __m128i modulator)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i sixteen = _mm_set1_epi16(16);
+	__m128i sfLo, sfHi, siLo, siHi, tfLo, tfHi, tiLo, tiHi;
+	__m128i lo, hi;
+
+	/* Spread the per pixel weights across the four channels of each pixel */
+	sf = _mm_packs_epi32(sf, sf);
+	sf = _mm_unpacklo_epi16(sf, sf);
+	sfLo = _mm_unpacklo_epi32(sf, sf);
+	sfHi = _mm_unpackhi_epi32(sf, sf);
+	siLo = _mm_sub_epi16(sixteen, sfLo);
+	siHi = _mm_sub_epi16(sixteen, sfHi);
+	tf = _mm_packs_epi32(tf, tf);
+	tf = _mm_unpacklo_epi16(tf, tf);
+	tfLo = _mm_unpacklo_epi32(tf, tf);
+	tfHi = _mm_unpackhi_epi32(tf, tf);
+	tiLo = _mm_sub_epi16(sixteen, tfLo);
+	tiHi = _mm_sub_epi16(sixteen, tfHi);
+
+#define MULTBL16(i, j) _mm_srli_epi16(_mm_mullo_epi16(i, j), 4)
+#define FILTER(half, si, sf, ti, tf) \
+	_mm_add_epi16( \
+		MULTBL16(ti, _mm_add_epi16( \
+			MULTBL16(si, _mm_unpack##half##_epi8(t00, zero)), \
+			MULTBL16(sf, _mm_unpack##half##_epi8(t01, zero)))), \
+		MULTBL16(tf, _mm_add_epi16( \
+			MULTBL16(si, _mm_unpack##half##_epi8(t10, zero)), \
+			MULTBL16(sf, _mm_unpack##half##_epi8(t11, zero)))))
+
+	lo = MULTBL16(_mm_unpacklo_epi8(modulator, zero), FILTER(lo, siLo, sfLo, tiLo, tfLo));
+	hi = MULTBL16(_mm_unpackhi_epi8(modulator, zero), FILTER(hi, siHi, sfHi, tiHi, tfHi));
+
+#undef FILTER
+#undef MULTBL16
+
+	return _mm_packus_epi16(lo, hi);
+}
+
+/* Shared body of b3dDrawRGB_SSE2 and b3dDrawRGBA_SSE2 */
+static void b3dDrawRGBx_SSE2(int leftX, int rightX, int yValue, B3DPrimitiveFace *face, int hasAlpha)
+{
+	unsigned int *bits;
+	int rValue, gValue, bValue, aValue;
+	int deltaR, deltaG, deltaB, deltaA;
+	int deltaX, pixelShift;
+	__m128i byteMask = _mm_set1_epi32(255);
+
+	{
+		B3DPrimitiveAttribute *attr = face->attributes;
+		/* See above */
+		double floatX = leftX;
+		double floatY = yValue+0.5;
+
+		if(b3dDebug)
+			if(!attr) b3dAbort("face has no RGB attributes");
+
+		SETUP_RGB;
+		if(hasAlpha) {
+			SETUP_A;
+		} else {
+			/* Constant alpha of 255 */
+			aValue = 255 << B3D_IntToFixedShift;
+			deltaA = 0;
+		}
+	}
+
+	bits = currentState->spanBuffer;
+
+	deltaX = rightX - leftX + 1;
+	for(pixelShift= MAX_PIXEL_SHIFT; pixelShift> 0; pixelShift--) {
+		int nPixels = 1 << pixelShift;
+		while(deltaX >= nPixels) {	
+			{	/* Compute right most values of color interpolation */
+				int maxR = rValue + (deltaR << pixelShift);
+				int maxG = gValue + (deltaG << pixelShift);
+				int maxB = bValue + (deltaB << pixelShift);
+				int maxA = aValue + (deltaA << pixelShift);
+				/* Clamp those guys */
+				CLAMP_RGB(maxR, maxG, maxB);
+				if(hasAlpha) {
+					CLAMP(maxA, B3D_FixedHalf, (255 << B3D_IntToFixedShift) + B3D_FixedHalf);
+				}
+				/* And compute the actual delta */
+				deltaR = (maxR - rValue) >> pixelShift;
+				deltaG = (maxG - gValue) >> pixelShift;
+				deltaB = (maxB - bValue) >> pixelShift;
+				deltaA = (maxA - aValue) >> pixelShift;
+			}
+			if(nPixels >= 4) {
+				__m128i r = FIXED4(rValue, deltaR), stepR = _mm_set1_epi32(deltaR << 2);
+				__m128i g = FIXED4(gValue, deltaG), stepG = _mm_set1_epi32(deltaG << 2);
+				__m128i b = FIXED4(bValue, deltaB), stepB = _mm_set1_epi32(deltaB << 2);
+				__m128i a = FIXED4(aValue, deltaA), stepA = _mm_set1_epi32(deltaA << 2);
+				int n = nPixels >> 2;
+				while(n--) {
+					_mm_storeu_si128((__m128i *) (bits + leftX),
+						PACK4(r, g, b, a, B3D_FixedToIntShift));
+					leftX += 4;
+					r = _mm_add_epi32(r, stepR);
+					g = _mm_add_epi32(g, stepG);
+					b = _mm_add_epi32(b, stepB);
+					a = _mm_add_epi32(a, stepA);
+				}
+				rValue += deltaR << pixelShift;
+				gValue += deltaG << pixelShift;
+				bValue += deltaB << pixelShift;
+				aValue += deltaA << pixelShift;
+			} else {
+				int n = nPixels;
+				while(n--) {
+					bits[leftX++] =
+						((unsigned int)((rValue >> B3D_FixedToIntShift) & 255) << RED_SHIFT) |
+						((unsigned int)((gValue >> B3D_FixedToIntShift) & 255) << GREEN_SHIFT) |
+						((unsigned int)((bValue >> B3D_FixedToIntShift) & 255) << BLUE_SHIFT) |
+						((unsigned int)((aValue >> B3D_FixedToIntShift) & 255) << ALPHA_SHIFT);
+					rValue += deltaR;
+					gValue += deltaG;
+					bValue += deltaB;
+					aValue += deltaA;
+				}
+			}
+			deltaX -= nPixels;
+		}
+	}
+	/* The last pixel is done separately */
+	if(deltaX) {
+		bits[leftX++] =
+			((unsigned int)((rValue >> B3D_FixedToIntShift) & 255) << RED_SHIFT) |
+			((unsigned int)((gValue >> B3D_FixedToIntShift) & 255) << GREEN_SHIFT) |
+			((unsigned int)((bValue >> B3D_FixedToIntShift) & 255) << BLUE_SHIFT) |
+			((unsigned int)((aValue >> B3D_FixedToIntShift) & 255) << ALPHA_SHIFT);
+	}
+}
+
+void b3dDrawRGB_SSE2(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
+{
+	b3dDrawRGBx_SSE2(leftX, rightX, yValue, face, 0);
+}
+
+void b3dDrawRGBA_SSE2(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
+{
+	b3dDrawRGBx_SSE2(leftX, rightX, yValue, face, 1);
+}
+
+/* Shared body of b3dDrawSTWRGB_SSE2 and b3dDrawSTWARGB_SSE2 */
+static void b3dDrawSTWxRGB_SSE2(int leftX, int rightX, int yValue, B3DPrimitiveFace *face, int hasAlpha)
+{
+	struct b3dPixelColor { B3DPrimitiveColor color; } *tex00, *tex10, *tex01, *tex11;
+	unsigned int *bits;
+	double sValue, tValue, wValue, sDelta, tDelta, wDelta, oneOverW;
+	int rValue, gValue, bValue, aValue;
+	int deltaR, deltaG, deltaB, deltaA;
+	int fixedLeftS, fixedRightS, fixedLeftT, fixedRightT, fixedDeltaS, fixedDeltaT;
+	int deltaX, pixelShift;
+	unsigned int t00[4], t01[4], t10[4], t11[4];
+	__m128i byteMask = _mm_set1_epi32(255);
+	__m128i fracMask = _mm_set1_epi32(15);
+	/* Pixels come out of the filter with whatever alpha the modulator
+	   had; for opaque faces that's zero and we OR in 255 */
+	__m128i alphaBits = hasAlpha ? _mm_setzero_si128() : _mm_set1_epi32(255 << ALPHA_SHIFT);
+
+	B3DTexture *texture = face->texture;
+
+	if(!texture) {
+		b3dDrawRGBx_SSE2(leftX, rightX, yValue, face, hasAlpha);
+		return;
+	}
+	if(texture->depth < 16 && (texture->cmSize < (1 << texture->depth)))
+		return; /* Colormap not installed */
+
+	{
+		B3DPrimitiveAttribute *attr = face->attributes;
+		/* See above */
+		double floatX = leftX;
+		double floatY = yValue+0.5;
+
+		if(b3dDebug)
+			if(!attr) b3dAbort("face has no RGB attributes");
+
+		SETUP_RGB;
+		if(hasAlpha) {
+			SETUP_A;
+		} else {
+			aValue = deltaA = 0;
+		}
+		SETUP_STW;
+	}
+
+	bits = currentState->spanBuffer;
+
+	deltaX = rightX - leftX + 1;
+	if(wValue) oneOverW = 1.0 / wValue;
+	else oneOverW = 0.0;
+	fixedLeftS = (int) (sValue * oneOverW * (texture->width << B3D_IntToFixedShift));
+	fixedLeftT = (int) (tValue * oneOverW * (texture->height << B3D_IntToFixedShift));
+
+	for(pixelShift = MAX_PIXEL_SHIFT; pixelShift > 0; pixelShift--) {
+		int nPixels = 1 << pixelShift;
+		while(deltaX >= nPixels) {
+			{	/* Compute right most values of color interpolation */
+				int maxR = rValue + (deltaR << pixelShift);
+				int maxG = gValue + (deltaG << pixelShift);
+				int maxB = bValue + (deltaB << pixelShift);
+				int maxA = aValue + (deltaA << pixelShift);
+				/* Clamp those guys */
+				CLAMP_RGB(maxR, maxG, maxB);
+				if(hasAlpha) {
+					CLAMP(maxA, B3D_FixedHalf, (255 << B3D_IntToFixedShift) + B3D_FixedHalf);
+				}
+				/* And compute the actual delta */
+				deltaR = (maxR - rValue) >> pixelShift;
+				deltaG = (maxG - gValue) >> pixelShift;
+				deltaB = (maxB - bValue) >> pixelShift;
+				deltaA = (maxA - aValue) >> pixelShift;
+			}
+			/* Compute the RIGHT s/t values (the left ones are kept from the last loop) */
+			wValue += wDelta * nPixels;
+			sValue += sDelta * nPixels;
+			tValue += tDelta * nPixels;
+			if(wValue) oneOverW = 1.0 / wValue;
+			else oneOverW = 0.0;
+			fixedRightS = (int) (sValue * oneOverW * (texture->width << B3D_IntToFixedShift));
+			fixedDeltaS = (fixedRightS - fixedLeftS) >> pixelShift;
+			fixedRightT = (int) (tValue * oneOverW * (texture->height << B3D_IntToFixedShift));
+			fixedDeltaT = (fixedRightT - fixedLeftT) >> pixelShift;
+			/* Do the inner loop in groups of four; 2 pixel blocks are
+			   padded to four with the last two results being discarded */
+			{	__m128i r = FIXED4(rValue, deltaR), stepR = _mm_set1_epi32(deltaR << 2);
+				__m128i g = FIXED4(gValue, deltaG), stepG = _mm_set1_epi32(deltaG << 2);
+				__m128i b = FIXED4(bValue, deltaB), stepB = _mm_set1_epi32(deltaB << 2);
+				__m128i a = FIXED4(aValue, deltaA), stepA = _mm_set1_epi32(deltaA << 2);
+				__m128i s = FIXED4(fixedLeftS, fixedDeltaS), stepS = _mm_set1_epi32(fixedDeltaS << 2);
+				__m128i t = FIXED4(fixedLeftT, fixedDeltaT), stepT = _mm_set1_epi32(fixedDeltaT << 2);
+				int n = nPixels;
+				while(n > 0) {
+					__m128i pixels;
+					int i;
+					for(i = 0; i < 4; i++) {
+						if(i < n) {
+							LOAD_4_RGB_TEXEL_32(fixedLeftS, fixedLeftT, texture);
+							fixedLeftS += fixedDeltaS;
+							fixedLeftT += fixedDeltaT;
+							t00[i] = *(unsigned int *) tex00;
+							t01[i] = *(unsigned int *) tex01;
+							t10[i] = *(unsigned int *) tex10;
+							t11[i] = *(unsigned int *) tex11;
+						} else { /* pad with the previous texels; n > 0 so i > 0 here */
+							t00[i] = t00[i-1];
+							t01[i] = t01[i-1];
+							t10[i] = t10[i-1];
+							t11[i] = t11[i-1];
+						}
+					}
+					pixels = b3dFilterAndModulate4(
+						_mm_loadu_si128((__m128i *) t00), _mm_loadu_si128((__m128i *) t01),
+						_mm_loadu_si128((__m128i *) t10), _mm_loadu_si128((__m128i *) t11),
+						_mm_and_si128(_mm_srli_epi32(s, B3D_FixedToIntShift - 4), fracMask),
+						_mm_and_si128(_mm_srli_epi32(t, B3D_FixedToIntShift - 4), fracMask),
+						PACK4(r, g, b, a, B3D_FixedToIntShift + 4));
+					pixels = _mm_or_si128(pixels, alphaBits);
+					if(n >= 4) {
+						_mm_storeu_si128((__m128i *) (bits + leftX), pixels);
+					} else {
+						_mm_storel_epi64((__m128i *) (bits + leftX), pixels);
+					}
+					leftX += n >= 4 ? 4 : n;
+					n -= 4;
+					r = _mm_add_epi32(r, stepR);
+					g = _mm_add_epi32(g, stepG);
+					b = _mm_add_epi32(b, stepB);
+					a = _mm_add_epi32(a, stepA);
+					s = _mm_add_epi32(s, stepS);
+					t = _mm_add_epi32(t, stepT);
+				}
+				rValue += deltaR << pixelShift;
+				gValue += deltaG << pixelShift;
+				bValue += deltaB << pixelShift;
+				aValue += deltaA << pixelShift;
+			}
+			/* Finally, adjust the number of pixels left and update s/t */
+			deltaX -= nPixels;
+			fixedLeftS = fixedRightS;
+			fixedLeftT = fixedRightT;
+		}
+	}
+	/* The last pixel is done separately */
+	if(deltaX) {
+		__m128i pixels;
+		LOAD_4_RGB_TEXEL_32(fixedLeftS, fixedLeftT, texture);
+		pixels = b3dFilterAndModulate4(
+			_mm_cvtsi32_si128(*(int *) tex00), _mm_cvtsi32_si128(*(int *) tex01),
+			_mm_cvtsi32_si128(*(int *) tex10), _mm_cvtsi32_si128(*(int *) tex11),
+			_mm_cvtsi32_si128((fixedLeftS >> (B3D_FixedToIntShift - 4)) & 15),
+			_mm_cvtsi32_si128((fixedLeftT >> (B3D_FixedToIntShift - 4)) & 15),
+			PACK4(_mm_cvtsi32_si128(rValue), _mm_cvtsi32_si128(gValue),
+				_mm_cvtsi32_si128(bValue), _mm_cvtsi32_si128(aValue),
+				B3D_FixedToIntShift + 4));
+		bits[leftX++] = (unsigned int) _mm_cvtsi128_si32(_mm_or_si128(pixels, alphaBits));
+	}
+}
+
+void b3dDrawSTWRGB_SSE2(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
+{
+	b3dDrawSTWxRGB_SSE2(leftX, rightX, yValue, face, 0);
+}
+
+void b3dDrawSTWARGB_SSE2(int leftX, int rightX, int yValue, B3DPrimitiveFace *face)
+{
+	b3dDrawSTWxRGB_SSE2(leftX, rightX, yValue, face, 1);
+}
+
+b3dPixelDrawer B3D_FILL_FUNCTIONS_SSE2[B3D_MAX_ATTRIBUTES] = {
+	b3dNoDraw,           /* No attributes */
+	b3dDrawRGB_SSE2,     /* B3D_FACE_RGB */
+	b3dNoDraw,           /* B3D_FACE_ALPHA -- IGNORED!!! */
+	b3dDrawRGBA_SSE2,    /* B3D_FACE_RGB | B3D_FACE_ALPHA */
+	b3dDrawSTW,          /* B3D_FACE_STW */
+	b3dDrawSTWRGB_SSE2,  /* B3D_FACE_STW | B3D_FACE_RGB */
+	b3dDrawSTWA,         /* B3D_FACE_STW | B3D_FACE_ALPHA */
+	b3dDrawSTWARGB_SSE2  /* B3D_FACE_STW | B3D_FACE_RGB | B3D_FACE_ALPHA */
+};
+
+static int b3dHasSSE2(void)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+	return 1; /* part of the base architecture */
+#elif defined(__GNUC__)
+	unsigned int eax, ebx, ecx, edx;
+	if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return 0;
+	return (edx & bit_SSE2) != 0;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[3] & (1 << 26)) != 0;
+#else
+	return 0;
+#endif
+}
+
+#endif /* __SSE2__ && USE_MULTBL */
+
+/* The span shaders used for states that leave fillMode at B3D_FILL_DEFAULT.
+   Set through b3dSetFillMode() (primitiveSetFillMode in sqB3DFillMode.c). */
+static int b3dFillMode = B3D_FILL_DEFAULT;
+
+/* b3dSetFillMode:
+	Select the span shaders for all subsequent rendering.
+	Answer the previous mode, or -1 if the mode is unknown.
+*/
+int b3dSetFillMode(int mode)
+{
+	int oldMode = b3dFillMode;
+
+	if(mode != B3D_FILL_DEFAULT && mode != B3D_FILL_SCALAR) return -1;
+	b3dFillMode = mode;
+	return oldMode;
+}
+
+/* b3dFillFunctionsFor:
+	Answer the span shaders to use for the given rasterizer state.
+	Unless the state (or, if the state does not say, the module-wide
+	fill mode) asks for B3D_FILL_SCALAR we use the vectorized shaders
+	if they were compiled in and the CPU supports them.
+*/
+b3dPixelDrawer *b3dFillFunctionsFor(B3DRasterizerState *state)
+{
+#ifdef B3D_HAVE_SSE2
+	static int hasSSE2 = -1;
+	int mode = state->fillMode != B3D_FILL_DEFAULT ? state->fillMode : b3dFillMode;
+
+	if(hasSSE2 < 0)
+		hasSSE2 = b3dHasSSE2();
+	if(hasSSE2 && mode != B3D_FILL_SCALAR)
+		return B3D_FILL_FUNCTIONS_SSE2;
+#endif
+	return B3D_FILL_FUNCTIONS;
+}
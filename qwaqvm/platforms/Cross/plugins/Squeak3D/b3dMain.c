@@ -1157,6 +1157,7 @@ int b3dMainLoop(B3DRasterizerState *state, int stopReason)
 	int yValue, nextObjY, nextEdgeY;
 	B3DFillList *fillList;
 	B3DPrimitiveEdge *lastIntersection, *nextIntersection;
+	b3dPixelDrawer *fillFunctions;
 
 
 	if(!state)
@@ -1187,6 +1188,7 @@ int b3dMainLoop(B3DRasterizerState *state, int stopReason)
 	addedEdges = state->addedEdges;
 	fillList = state->fillList;
 	aet = state->aet;
+	fillFunctions = b3dFillFunctionsFor(state);
 	nextIntersection = aet->nextIntersection;
 	lastIntersection = aet->lastIntersection;
 
@@ -1396,7 +1398,7 @@ RESUME_PAINTING:
 									FAIL_PAINTING(B3D_NO_MORE_ATTRS);
 							}
 							/* And dispatch on the actual pixel drawers */
-							(*B3D_FILL_FUNCTIONS[(topFace->flags >> B3D_ATTR_SHIFT) & B3D_ATTR_MASK])
+							(*fillFunctions[(topFace->flags >> B3D_ATTR_SHIFT) & B3D_ATTR_MASK])
 								(leftX, rightX, yValue, topFace);
 						}
 					}
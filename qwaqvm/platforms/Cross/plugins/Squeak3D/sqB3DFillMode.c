@@ -0,0 +1,33 @@
+/*
+ *  sqB3DFillMode.c
+ *  Squeak3D
+ *
+ *  Selects the span shaders used by the software rasterizer. The rasterizer
+ *  state loaded by the plugin leaves fillMode at B3D_FILL_DEFAULT, so the
+ *  module-wide mode set here decides between the vectorized and the scalar
+ *  shaders (see b3dFillFunctionsFor() in b3dDraw.c).
+ *
+ *  primitiveSetFillMode: mode
+ *		mode is 0 (B3D_FILL_DEFAULT) or 1 (B3D_FILL_SCALAR).
+ *		Answer the previous mode. Fail for any other mode.
+ */
+
+#include "sq.h"
+#include "sqVirtualMachine.h"
+#include "b3d.h"
+
+extern struct VirtualMachine *interpreterProxy;
+
+EXPORT(sqInt) primitiveSetFillMode(void)
+{
+	sqInt modeOop = interpreterProxy->stackValue(0);
+	int oldMode;
+
+	if (!interpreterProxy->isIntegerObject(modeOop))
+		return interpreterProxy->primitiveFail();
+	oldMode = b3dSetFillMode(interpreterProxy->integerValueOf(modeOop));
+	if (oldMode < 0)
+		return interpreterProxy->primitiveFail();
+	interpreterProxy->pop(2);
+	return interpreterProxy->pushInteger(oldMode);
+}
@@ -0,0 +1,268 @@
+/**
+ * Project OpenQwaq
+ *
+ * Copyright (c) 2005-2011, Teleplace, Inc., All Rights Reserved
+ *
+ * Redistributions in source code form must reproduce the above
+ * copyright and this condition.
+ *
+ * The contents of this file are subject to the GNU General Public
+ * License, Version 2 (the "License"); you may not use this file
+ * except in compliance with the License. A copy of the License is
+ * available at http://www.opensource.org/licenses/gpl-2.0.php.
+ *
+ */
+
+
+/*
+ *  vcacheBench.cpp
+ *  VCacheBench
+ *
+ *  Command-line check and benchmark of the CroquetPlugin's vertex cache
+ *  optimizer (VertexCacheOptimizer in vcacheopt.h):
+ *
+ *      vcacheBench [-meshes n] [-size n]
+ *
+ *  First -meshes small random meshes (random triangles, repeated and
+ *  degenerate ones included) are run through Optimize() and OptimizeFetch(),
+ *  and each result must draw the same triangles, with the same winding, as
+ *  the input did.  An index list with a bad index must be left untouched by
+ *  OptimizeFetch().  Then a grid of -size by -size quads is optimized in
+ *  row order, with its triangles shuffled, and with its triangles and
+ *  vertices shuffled, both by the optimizer as it was before its rework
+ *  (vcacheoptOld.h) and by the current one. The time each takes and the
+ *  ACMR (cache misses per triangle, for a 32 entry LRU cache) before and
+ *  after are reported. Exits non-zero if any check fails.
+ *
+ *  It is built from the plugin's header alone, e.g. on unix:
+ *
+ *      g++ -O2 -I../CroquetPlugin vcacheBench.cpp -o vcacheBench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+
+#include "vcacheopt.h"
+#include "vcacheoptOld.h"
+
+struct Triangle
+{
+	int v[3];
+
+	bool operator<(const Triangle &other) const
+	{
+		for (int i = 0; i < 3; i++)
+			if (v[i] != other.v[i]) return v[i] < other.v[i];
+		return false;
+	}
+	bool operator==(const Triangle &other) const
+	{
+		return v[0] == other.v[0] && v[1] == other.v[1] && v[2] == other.v[2];
+	}
+};
+
+static double
+now(void)
+{
+	return clock() / (double)CLOCKS_PER_SEC;
+}
+
+// The triangles of an index list, each rotated to start at its smallest
+// index so that winding is kept but the starting corner doesn't matter,
+// and sorted. remap, if given, renames the vertices first.
+static std::vector<Triangle>
+triangles(const std::vector<int> &inds, const std::vector<int> *remap = NULL)
+{
+	std::vector<Triangle> tris(inds.size() / 3);
+	for (size_t t = 0; t < tris.size(); t++)
+	{
+		int v[3], first = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			v[k] = remap ? (*remap)[inds[3 * t + k]] : inds[3 * t + k];
+			if (v[k] < v[first]) first = k;
+		}
+		for (int k = 0; k < 3; k++)
+			tris[t].v[k] = v[(first + k) % 3];
+	}
+	std::sort(tris.begin(), tris.end());
+	return tris;
+}
+
+static double
+acmr(std::vector<int> &inds)
+{
+	VertexCache cache;
+	int tri_count = (int)inds.size() / 3;
+	return tri_count ? cache.GetCacheMissCount(&inds[0], tri_count) / (double)tri_count : 0;
+}
+
+static int
+checkRandomMeshes(int meshes)
+{
+	int failures = 0;
+
+	for (int m = 0; m < meshes; m++)
+	{
+		int vertex_count = 1 + rand() % 300;
+		int tri_count = 1 + rand() % 1000;
+		std::vector<int> inds(3 * tri_count);
+
+		for (int i = 0; i < 3 * tri_count; i++)
+			inds[i] = rand() % vertex_count;
+		// some repeated triangles, and some touching just a few vertices
+		for (int t = 1; t < tri_count; t += 1 + rand() % 16)
+			for (int k = 0; k < 3; k++)
+				inds[3 * t + k] = rand() & 1 ? inds[3 * (t - 1) + k] : rand() % 4 % vertex_count;
+
+		std::vector<Triangle> expected = triangles(inds);
+		std::vector<int> optimized(inds);
+		VertexCacheOptimizer vco;
+		if (VertexCacheOptimizer::Failed(vco.Optimize(&optimized[0], tri_count))
+			|| triangles(optimized) != expected)
+		{
+			if (failures++ < 10)
+				printf("  mesh %d (%d triangles, %d vertices): Optimize() changed the triangles\n",
+					   m, tri_count, vertex_count);
+			continue;
+		}
+
+		std::vector<int> fetched(optimized), remap(vertex_count);
+		int used = VertexCacheOptimizer::OptimizeFetch(&fetched[0], tri_count, &remap[0], vertex_count);
+		bool ok = used > 0 && used <= vertex_count && triangles(optimized, &remap) == triangles(fetched);
+		// vertices are numbered in the order they are first used
+		for (int i = 0, next = 0; ok && i < 3 * tri_count; i++)
+		{
+			ok = fetched[i] <= next && fetched[i] < used;
+			if (fetched[i] == next) next++;
+		}
+		if (!ok)
+		{
+			if (failures++ < 10)
+				printf("  mesh %d (%d triangles, %d vertices): OptimizeFetch() changed the triangles\n",
+					   m, tri_count, vertex_count);
+			continue;
+		}
+
+		std::vector<int> bad(inds);
+		bad[rand() % (3 * tri_count)] = rand() & 1 ? -1 : vertex_count;
+		std::vector<int> before(bad);
+		if (VertexCacheOptimizer::OptimizeFetch(&bad[0], tri_count, &remap[0], vertex_count) != -1
+			|| bad != before)
+		{
+			if (failures++ < 10)
+				printf("  mesh %d: OptimizeFetch() did not reject a bad index cleanly\n", m);
+		}
+	}
+	printf("%d random meshes: %d failed\n", meshes, failures);
+	return failures;
+}
+
+// A size by size grid of quads, two triangles each, in row order
+static std::vector<int>
+gridMesh(int size)
+{
+	std::vector<int> inds;
+	inds.reserve(6 * size * size);
+	for (int y = 0; y < size; y++)
+		for (int x = 0; x < size; x++)
+		{
+			int v = y * (size + 1) + x;
+			int quad[6] = { v, v + 1, v + size + 1, v + 1, v + size + 2, v + size + 1 };
+			inds.insert(inds.end(), quad, quad + 6);
+		}
+	return inds;
+}
+
+static void
+shuffleTriangles(std::vector<int> &inds)
+{
+	for (int t = (int)inds.size() / 3 - 1; t > 0; t--)
+	{
+		int other = rand() % (t + 1);
+		for (int k = 0; k < 3; k++)
+			std::swap(inds[3 * t + k], inds[3 * other + k]);
+	}
+}
+
+static void
+shuffleVertices(std::vector<int> &inds, int vertex_count)
+{
+	std::vector<int> order(vertex_count);
+	for (int i = 0; i < vertex_count; i++) order[i] = i;
+	for (int i = vertex_count - 1; i > 0; i--)
+		std::swap(order[i], order[rand() % (i + 1)]);
+	for (size_t i = 0; i < inds.size(); i++)
+		inds[i] = order[inds[i]];
+}
+
+static int
+benchmark(const char *name, const std::vector<int> &inds)
+{
+	int tri_count = (int)inds.size() / 3;
+	std::vector<Triangle> expected = triangles(inds);
+
+	std::vector<int> oldInds(inds);
+	OldVCache::VertexCacheOptimizer oldVco;
+	double start = now();
+	OldVCache::VertexCacheOptimizer::Result oldResult = oldVco.Optimize(&oldInds[0], tri_count);
+	double oldElapsed = now() - start;
+
+	std::vector<int> newInds(inds);
+	VertexCacheOptimizer vco;
+	start = now();
+	VertexCacheOptimizer::Result result = vco.Optimize(&newInds[0], tri_count);
+	double elapsed = now() - start;
+
+	bool ok = !OldVCache::VertexCacheOptimizer::Failed(oldResult)
+		&& !VertexCacheOptimizer::Failed(result) && triangles(newInds) == expected;
+	std::vector<int> in(inds);
+	printf("%-22s %9d %8.3f %8.3f %8.3f %10.1f %10.1f %8.2fx  %s\n", name, tri_count,
+		   acmr(in), acmr(oldInds), acmr(newInds), oldElapsed * 1e3, elapsed * 1e3,
+		   elapsed > 0 ? oldElapsed / elapsed : 0.0, ok ? "" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+int
+main(int argc, char *argv[])
+{
+	int meshes = 2000, size = 300;
+	int failures;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-meshes") && i + 1 < argc)
+			meshes = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-size") && i + 1 < argc)
+			size = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: %s [-meshes n] [-size n]\n", argv[0]);
+			return 2;
+		}
+	}
+	if (size < 1 || size > 4000)
+	{
+		fprintf(stderr, "size must be 1..4000\n");
+		return 2;
+	}
+
+	srand(1);
+	failures = checkRandomMeshes(meshes);
+
+	printf("%-22s %9s %8s %8s %8s %10s %10s %9s\n", "mesh", "triangles", "ACMR in",
+		   "ACMR old", "ACMR new", "old ms", "new ms", "speedup");
+	std::vector<int> grid = gridMesh(size);
+	failures += benchmark("grid, row order", grid);
+	shuffleTriangles(grid);
+	failures += benchmark("grid, shuffled", grid);
+	shuffleVertices(grid, (size + 1) * (size + 1));
+	failures += benchmark("grid, shuffled+renamed", grid);
+
+	printf("%s\n", failures ? "FAILURE" : "SUCCESS");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,32 @@
+/* ZipPlugin.h: support for the ZipPlugin (DeflatePlugin/InflatePlugin) */
+
+/* Imported from sqZipChecksums.c. Both update a running value with len
+   bytes. The CRC is the raw gzip CRC-32 register, i.e. the caller does
+   the initial and final inversion as ZipWriteStream does. */
+unsigned int zipUpdateCrc32(unsigned int crc, unsigned char *bytes, int len);
+unsigned int zipUpdateAdler32(unsigned int adler, unsigned char *bytes, int len);
+
+/* Imported from sqZipStream.c. Deflate and inflate streams named by
+   small integer handles; see that file for details. */
+#define ZIP_FORMAT_RAW 0	/* bare deflate data */
+#define ZIP_FORMAT_ZLIB 1	/* RFC 1950 header and Adler-32 trailer */
+#define ZIP_FORMAT_GZIP 2	/* RFC 1952 header and CRC-32 trailer */
+
+#define ZIP_STREAM_OK 0
+#define ZIP_STREAM_END 1
+#define ZIP_STREAM_ERROR -1
+
+#define ZIP_MAX_STREAMS 64
+
+int zipStreamInit(void);
+int zipStreamShutdown(void);
+int zipStreamCreate(int inflating, int level, int format);
+int zipStreamDestroy(int handle);
+int zipStreamIsValid(int handle);
+int zipStreamProcess(int handle, unsigned char *in, int inSize, int *inUsed,
+		     unsigned char *out, int outSize, int *outUsed, int finish);
+int zipStreamStart(int handle, unsigned char *bytes, int size, int semaIndex);
+int zipStreamStartFile(int handle, char *fileName, int nameSize,
+		       long long offset, long long length, int semaIndex);
+int zipStreamResultSize(int handle);
+int zipStreamResultCopy(int handle, unsigned char *dst, int dstSize);
@@ -0,0 +1,283 @@
+/*
+ *  sqZipChecksums.c
+ *  ZipPlugin
+ *
+ *  CRC-32 (gzip, zip) and Adler-32 (zlib) checksums.
+ *
+ *  The portable CRC is slice-by-8: eight derived tables let it consume
+ *  eight bytes per step instead of one. On x86 CPUs with PCLMULQDQ, runs
+ *  of 64 bytes or more are folded with carry-less multiplication as
+ *  described in Intel's "Fast CRC Computation for Generic Polynomials
+ *  Using PCLMULQDQ Instruction" and only the tail goes through the tables.
+ *
+ *  Adler-32 takes the modulo only every ZIP_NMAX bytes, the most for which
+ *  the sums cannot overflow 32 bits. With SSE2 it adds 16 bytes per step.
+ *
+ *  The vector kernels are compiled with target attributes and selected at
+ *  run time, so the plugin still loads on CPUs without them.
+ */
+
+#include "ZipPlugin.h"
+
+#define ZIP_BASE 65521U	/* largest prime below 65536 */
+#define ZIP_NMAX 5552	/* largest n with 255n(n+1)/2 + (n+1)(BASE-1) < 2^32 */
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) \
+	&& (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+# define ZIP_HAVE_X86_SIMD 1
+# define ZIP_TARGET(isa) __attribute__((target(isa)))
+# include <cpuid.h>
+#elif defined(_MSC_VER) && _MSC_VER >= 1600 && (defined(_M_X64) || defined(_M_IX86))
+# define ZIP_HAVE_X86_SIMD 1
+# define ZIP_TARGET(isa)
+# include <intrin.h>
+#endif
+
+#ifdef ZIP_HAVE_X86_SIMD
+# include <emmintrin.h>
+# include <wmmintrin.h>
+#endif
+
+static unsigned int crcTables[8][256];
+static int crcTablesReady = 0;
+
+static void
+makeCrcTables(void)
+{
+	unsigned int c;
+	int i, k;
+
+	for(i = 0; i < 256; i++) {
+		c = i;
+		for(k = 0; k < 8; k++)
+			c = c & 1 ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+		crcTables[0][i] = c;
+	}
+	for(i = 0; i < 256; i++) {
+		c = crcTables[0][i];
+		for(k = 1; k < 8; k++) {
+			c = crcTables[0][c & 255] ^ (c >> 8);
+			crcTables[k][i] = c;
+		}
+	}
+	crcTablesReady = 1;
+}
+
+static unsigned int
+crc32Slice8(unsigned int crc, unsigned char *p, int len)
+{
+	unsigned int one, two;
+
+	if(!crcTablesReady) makeCrcTables();
+	for(; len >= 8; len -= 8, p += 8) {
+		one = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24));
+		two = p[4] | (p[5] << 8) | (p[6] << 16) | ((unsigned int) p[7] << 24);
+		crc = crcTables[7][one & 255] ^ crcTables[6][(one >> 8) & 255]
+			^ crcTables[5][(one >> 16) & 255] ^ crcTables[4][one >> 24]
+			^ crcTables[3][two & 255] ^ crcTables[2][(two >> 8) & 255]
+			^ crcTables[1][(two >> 16) & 255] ^ crcTables[0][two >> 24];
+	}
+	for(; len > 0; len--, p++)
+		crc = crcTables[0][(crc ^ *p) & 255] ^ (crc >> 8);
+	return crc;
+}
+
+static unsigned int
+adler32Scalar(unsigned int adler, unsigned char *p, int len)
+{
+	unsigned int s1 = adler & 0xFFFF, s2 = adler >> 16;
+	int n;
+
+	while(len > 0) {
+		n = len < ZIP_NMAX ? len : ZIP_NMAX;
+		len -= n;
+		for(; n >= 8; n -= 8, p += 8) {
+			s1 += p[0]; s2 += s1; s1 += p[1]; s2 += s1;
+			s1 += p[2]; s2 += s1; s1 += p[3]; s2 += s1;
+			s1 += p[4]; s2 += s1; s1 += p[5]; s2 += s1;
+			s1 += p[6]; s2 += s1; s1 += p[7]; s2 += s1;
+		}
+		for(; n > 0; n--, p++) {
+			s1 += *p; s2 += s1;
+		}
+		s1 %= ZIP_BASE;
+		s2 %= ZIP_BASE;
+	}
+	return (s2 << 16) | s1;
+}
+
+#ifdef ZIP_HAVE_X86_SIMD
+
+static void
+zipCpuid(unsigned int info[4])
+{
+#if defined(_MSC_VER)
+	__cpuid((int *) info, 1);
+#else
+	if(!__get_cpuid(1, &info[0], &info[1], &info[2], &info[3]))
+		info[2] = info[3] = 0;
+#endif
+}
+
+/* Fold len bytes (len >= 64, a multiple of 16) into the CRC; the
+   constants are x^(k*32) mod P in the bit-reflected domain */
+ZIP_TARGET("sse2,pclmul") static unsigned int
+crc32Pclmul(unsigned int crc, unsigned char *p, int len)
+{
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8, mask;
+
+	x1 = _mm_loadu_si128((__m128i *) (p + 0x00));
+	x2 = _mm_loadu_si128((__m128i *) (p + 0x10));
+	x3 = _mm_loadu_si128((__m128i *) (p + 0x20));
+	x4 = _mm_loadu_si128((__m128i *) (p + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+	x0 = _mm_set_epi32(0x00000001, 0xC6E41596, 0x00000001, 0x54442BD4); /* k1, k2 */
+	p += 64;
+	len -= 64;
+
+	/* fold four lanes by 512 bits */
+	for(; len >= 64; len -= 64, p += 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		y5 = _mm_loadu_si128((__m128i *) (p + 0x00));
+		y6 = _mm_loadu_si128((__m128i *) (p + 0x10));
+		y7 = _mm_loadu_si128((__m128i *) (p + 0x20));
+		y8 = _mm_loadu_si128((__m128i *) (p + 0x30));
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+	}
+
+	/* fold the four lanes into one */
+	x0 = _mm_set_epi32(0x00000000, 0xCCAA009E, 0x00000001, 0x751997D0); /* k3, k4 */
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	/* fold the remaining 16 byte blocks */
+	for(; len >= 16; len -= 16, p += 16) {
+		x2 = _mm_loadu_si128((__m128i *) p);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	}
+
+	/* 128 -> 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x0 = _mm_set_epi32(0, 0, 0x00000001, 0x63CD6124); /* k5 */
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, mask);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* Barrett reduction to 32 bits */
+	x0 = _mm_set_epi32(0x00000001, 0xF7011641, 0x00000001, 0xDB710641); /* P, mu */
+	x2 = _mm_and_si128(x1, mask);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, mask);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+	return (unsigned int) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+/* Per 16 byte block: s2 += 16 * s1 + sum (16 - i) * b[i], s1 += sum b[i].
+   The 16 * s1 terms are collected in vps and applied once per ZIP_NMAX. */
+ZIP_TARGET("sse2") static unsigned int
+adler32Sse2(unsigned int adler, unsigned char *p, int len)
+{
+	unsigned int s1 = adler & 0xFFFF, s2 = adler >> 16;
+	unsigned int sums[4];
+	__m128i zero = _mm_setzero_si128();
+	__m128i wHi = _mm_setr_epi16(16, 15, 14, 13, 12, 11, 10, 9);
+	__m128i wLo = _mm_setr_epi16(8, 7, 6, 5, 4, 3, 2, 1);
+	__m128i vs1, vs2, vps, bytes;
+	int n, blocks;
+
+	while(len >= 16) {
+		n = len < ZIP_NMAX ? len : ZIP_NMAX;
+		blocks = n / 16;
+		len -= blocks * 16;
+		vs1 = vs2 = vps = zero;
+		s2 += s1 * 16 * blocks;
+		for(; blocks > 0; blocks--, p += 16) {
+			bytes = _mm_loadu_si128((__m128i *) p);
+			vps = _mm_add_epi32(vps, vs1);
+			vs1 = _mm_add_epi32(vs1, _mm_sad_epu8(bytes, zero));
+			vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpacklo_epi8(bytes, zero), wHi));
+			vs2 = _mm_add_epi32(vs2, _mm_madd_epi16(_mm_unpackhi_epi8(bytes, zero), wLo));
+		}
+		vs2 = _mm_add_epi32(vs2, _mm_slli_epi32(vps, 4));
+		_mm_storeu_si128((__m128i *) sums, vs1);
+		s1 += sums[0] + sums[2];
+		_mm_storeu_si128((__m128i *) sums, vs2);
+		s2 += sums[0] + sums[1] + sums[2] + sums[3];
+		s1 %= ZIP_BASE;
+		s2 %= ZIP_BASE;
+	}
+	return len ? adler32Scalar((s2 << 16) | s1, p, len) : (s2 << 16) | s1;
+}
+
+#define ZIP_CPU_UNKNOWN -1
+#define ZIP_CPU_SSE2 1
+#define ZIP_CPU_PCLMUL 2
+
+static int zipCpu = ZIP_CPU_UNKNOWN;
+
+static int
+zipCpuFeatures(void)
+{
+	unsigned int info[4];
+	int features = 0;
+
+	zipCpuid(info);
+	if(info[3] & (1 << 26)) features |= ZIP_CPU_SSE2;
+	if((features & ZIP_CPU_SSE2) && (info[2] & (1 << 1))) features |= ZIP_CPU_PCLMUL;
+	return features;
+}
+
+#endif /* ZIP_HAVE_X86_SIMD */
+
+unsigned int
+zipUpdateCrc32(unsigned int crc, unsigned char *bytes, int len)
+{
+#ifdef ZIP_HAVE_X86_SIMD
+	if(len >= 64) {
+		if(zipCpu == ZIP_CPU_UNKNOWN) zipCpu = zipCpuFeatures();
+		if(zipCpu & ZIP_CPU_PCLMUL) {
+			int folded = len & ~15;
+			crc = crc32Pclmul(crc, bytes, folded);
+			bytes += folded;
+			len -= folded;
+		}
+	}
+#endif
+	return crc32Slice8(crc, bytes, len);
+}
+
+unsigned int
+zipUpdateAdler32(unsigned int adler, unsigned char *bytes, int len)
+{
+#ifdef ZIP_HAVE_X86_SIMD
+	if(len >= 64) {
+		if(zipCpu == ZIP_CPU_UNKNOWN) zipCpu = zipCpuFeatures();
+		if(zipCpu & ZIP_CPU_SSE2)
+			return adler32Sse2(adler, bytes, len);
+	}
+#endif
+	return adler32Scalar(adler, bytes, len);
+}
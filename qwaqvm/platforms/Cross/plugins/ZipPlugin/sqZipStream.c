@@ -0,0 +1,1770 @@
+/*
+ *  sqZipStream.c
+ *  ZipPlugin
+ *
+ *  Self-contained deflate/inflate streams (RFC 1950/1951/1952).
+ *
+ *  Streams are referred to by small integer handles, an index into a
+ *  fixed table. Each stream either compresses or decompresses and can be
+ *  driven incrementally with zipStreamProcess(), or given a whole buffer
+ *  or file region with zipStreamStart()/zipStreamStartFile(). Large whole
+ *  buffer jobs run on a worker thread which signals a Squeak semaphore
+ *  when the result is ready; the result is then fetched with
+ *  zipStreamResultSize() and zipStreamResultCopy().
+ *
+ *  The compressor follows the usual hash chain design: a 64k window of
+ *  which the upper half is the lookahead, 3 byte hashes chained through
+ *  prev[], greedy matching for levels 1-3 and lazy matching for 4-9.
+ *  Each block is sent as stored, fixed or dynamic Huffman, whichever is
+ *  smallest.
+ *
+ *  The decompressor decodes whole symbols only. When the input runs out
+ *  part way through a symbol or block header it backs up to the start of
+ *  that unit and keeps the remaining bytes in a small hold buffer, so a
+ *  caller may feed input in pieces of any size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sqVirtualMachine.h"
+#include "ZipPlugin.h"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+extern struct VirtualMachine *interpreterProxy;
+
+#define WSIZE 32768
+#define WMASK (WSIZE - 1)
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+#define MIN_LOOKAHEAD (MAX_MATCH + MIN_MATCH + 1)
+#define MAX_DIST (WSIZE - MIN_LOOKAHEAD)
+#define TOO_FAR 4096
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define LIT_BUFSIZE 16384
+#define PENDING_SIZE (256 * 1024)
+#define HOLD_SIZE 1024
+#define FAST_BITS 10
+#define FAST_MASK ((1 << FAST_BITS) - 1)
+#define THREAD_THRESHOLD (256 * 1024)
+#define FILE_CHUNK (64 * 1024)
+
+/* zipInflateRun() results */
+#define RUN_NEED_INPUT 0
+#define RUN_WINDOW_FULL 1
+#define RUN_END 2
+#define RUN_ERROR -1
+
+/* deflate step results */
+#define STEP_NEED_INPUT 0
+#define STEP_BLOCK 1
+#define STEP_DONE 2
+
+enum {
+	ModeHeader, ModeGZipHeader, ModeGZipExtraLength, ModeGZipExtra,
+	ModeGZipName, ModeGZipComment, ModeGZipHeaderCrc,
+	ModeBlock, ModeStored, ModeHuffman, ModeCheck, ModeLength, ModeDone
+};
+
+typedef struct {
+	unsigned short fast[1 << FAST_BITS];	/* (symbol << 4) | length, 0 if longer */
+	unsigned short count[16];
+	unsigned short symbol[288];
+} ZipHuffman;
+
+typedef struct ZipStream {
+	int inflating;
+	int format;
+	int level;
+	int status;
+	unsigned int check;
+	unsigned int totalIn;
+	unsigned int totalOut;
+
+	unsigned char *nextIn;
+	int availIn;
+	unsigned long long bitBuf;
+	int bitCount;
+
+	unsigned char *window;
+
+	/* deflate */
+	unsigned short *head;
+	unsigned short *prev;
+	int strstart, lookahead, blockStart;
+	int matchStart, matchLength, prevMatch, prevLength, matchAvailable;
+	int goodMatch, maxLazy, niceMatch, maxChain;
+	unsigned short *symLit;
+	unsigned short *symDist;
+	int symCount;
+	unsigned int litFreq[286];
+	unsigned int distFreq[30];
+	unsigned char *pending;
+	int pendingStart, pendingEnd;
+	int headerDone, finished;
+
+	/* inflate */
+	int mode, lastBlock, storedLeft, headerFlags, headerCount, headerValue;
+	int wpos, wread, wsum;
+	unsigned char *hold;
+	int holdLen;
+	ZipHuffman *litCode;
+	ZipHuffman *distCode;
+
+	/* whole buffer jobs */
+	int busy, destroyRequested, failed, semaIndex;
+	unsigned char *source;
+	int sourceSize;
+	char *fileName;
+	long long fileOffset;
+	long long fileLength;
+	unsigned char *result;
+	int resultSize, resultCapacity;
+} ZipStream;
+
+static ZipStream *zipStreams[ZIP_MAX_STREAMS];
+static int runningWorkers;	/* job threads that have not finished yet */
+
+#ifdef _WIN32
+static CRITICAL_SECTION zipLock;
+static HANDLE workersIdle;	/* manual reset; set while runningWorkers is zero */
+# define LOCK() EnterCriticalSection(&zipLock)
+# define UNLOCK() LeaveCriticalSection(&zipLock)
+#else
+static pthread_mutex_t zipLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workersIdle = PTHREAD_COND_INITIALIZER;
+# define LOCK() pthread_mutex_lock(&zipLock)
+# define UNLOCK() pthread_mutex_unlock(&zipLock)
+#endif
+
+#if defined(_WIN32)
+# define zipFseek(f, offset) _fseeki64(f, offset, SEEK_SET)
+#else
+# define zipFseek(f, offset) fseeko(f, (off_t) (offset), SEEK_SET)
+#endif
+
+static const unsigned short lengthBase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char lengthExtra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short distanceBase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char distanceExtra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned char codeLengthOrder[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/* good, lazy (max insert length for greedy levels), nice, chain */
+static const unsigned short levelConfig[10][4] = {
+	{0, 0, 0, 0},
+	{4, 4, 8, 4},
+	{4, 5, 16, 8},
+	{4, 6, 32, 32},
+	{4, 4, 16, 16},
+	{8, 16, 32, 32},
+	{8, 16, 128, 128},
+	{8, 32, 128, 256},
+	{32, 128, 258, 1024},
+	{32, 258, 258, 4096}};
+
+static unsigned char lengthCode[256];	/* match length - 3 -> code */
+static unsigned char distCodeTable[512];	/* see distanceCode() */
+static unsigned char fixedLitLengths[288];
+static unsigned char fixedDistLengths[30];
+static unsigned short fixedLitCodes[288];
+static unsigned short fixedDistCodes[30];
+static ZipHuffman fixedLitDecode, fixedDistDecode;
+static int tablesReady = 0;
+
+static int buildDecoder(ZipHuffman *h, unsigned char *lengths, int n);
+static void buildCodes(unsigned char *lengths, int n, unsigned short *codes);
+
+static void
+makeTables(void)
+{
+	int code, i, n;
+
+	for(code = 0; code < 28; code++)
+		for(n = 0; n < (1 << lengthExtra[code]); n++)
+			lengthCode[lengthBase[code] - 3 + n] = code;
+	lengthCode[255] = 28;
+	for(code = 0; code < 16; code++)
+		for(n = 0; n < (1 << distanceExtra[code]); n++)
+			distCodeTable[distanceBase[code] - 1 + n] = code;
+	for(code = 16; code < 30; code++)
+		for(n = 0; n < (1 << (distanceExtra[code] - 7)); n++)
+			distCodeTable[256 + ((distanceBase[code] - 1) >> 7) + n] = code;
+	for(i = 0; i < 144; i++) fixedLitLengths[i] = 8;
+	for(; i < 256; i++) fixedLitLengths[i] = 9;
+	for(; i < 280; i++) fixedLitLengths[i] = 7;
+	for(; i < 288; i++) fixedLitLengths[i] = 8;
+	for(i = 0; i < 30; i++) fixedDistLengths[i] = 5;
+	buildCodes(fixedLitLengths, 288, fixedLitCodes);
+	buildCodes(fixedDistLengths, 30, fixedDistCodes);
+	buildDecoder(&fixedLitDecode, fixedLitLengths, 288);
+	buildDecoder(&fixedDistDecode, fixedDistLengths, 30);
+	tablesReady = 1;
+}
+
+static int
+distanceCode(int dist)
+{
+	return dist <= 256 ? distCodeTable[dist - 1] : distCodeTable[256 + ((dist - 1) >> 7)];
+}
+
+static unsigned int
+reverseBits(unsigned int code, int length)
+{
+	unsigned int result = 0;
+
+	while(length-- > 0) {
+		result = (result << 1) | (code & 1);
+		code >>= 1;
+	}
+	return result;
+}
+
+/* Canonical codes for the given lengths, bit reversed for LSB first output */
+static void
+buildCodes(unsigned char *lengths, int n, unsigned short *codes)
+{
+	int count[16], next[16], bits, code, i;
+
+	memset(count, 0, sizeof(count));
+	for(i = 0; i < n; i++) count[lengths[i]]++;
+	count[0] = 0;
+	code = 0;
+	for(bits = 1; bits < 16; bits++) {
+		code = (code + count[bits - 1]) << 1;
+		next[bits] = code;
+	}
+	for(i = 0; i < n; i++)
+		codes[i] = lengths[i] ? reverseBits(next[lengths[i]]++, lengths[i]) : 0;
+}
+
+/* Huffman code lengths no longer than maxBits for freq[0..n-1]. Every
+   used symbol gets a length; the caller makes sure at least two are used. */
+static void
+buildLengths(unsigned int *freq, int n, int maxBits, unsigned char *lengths)
+{
+	int syms[288], parent[2 * 288], depth[2 * 288], numCodes[33];
+	unsigned int weight[2 * 288];
+	int used = 0, leaf, node, next, a, b, i, j, k, len;
+	unsigned int total;
+
+	memset(lengths, 0, n);
+	for(i = 0; i < n; i++)
+		if(freq[i]) {
+			/* insertion sort by frequency; n is at most 288 */
+			for(j = used; j > 0 && freq[syms[j - 1]] > freq[i]; j--)
+				syms[j] = syms[j - 1];
+			syms[j] = i;
+			used++;
+		}
+	if(used == 0) return;
+	if(used == 1) {
+		lengths[syms[0]] = 1;
+		return;
+	}
+
+	/* two queue construction: leaves in order, then internal nodes in order */
+	for(i = 0; i < used; i++) weight[i] = freq[syms[i]];
+	leaf = 0; node = used; next = used;
+	for(k = 0; k < used - 1; k++) {
+		a = (leaf < used && (node >= next || weight[leaf] <= weight[node])) ? leaf++ : node++;
+		b = (leaf < used && (node >= next || weight[leaf] <= weight[node])) ? leaf++ : node++;
+		weight[next] = weight[a] + weight[b];
+		parent[a] = parent[b] = next;
+		next++;
+	}
+	depth[next - 1] = 0;
+	for(i = next - 2; i >= 0; i--) depth[i] = depth[parent[i]] + 1;
+
+	memset(numCodes, 0, sizeof(numCodes));
+	for(i = 0; i < used; i++) numCodes[depth[i] > 32 ? 32 : depth[i]]++;
+
+	/* fold overlong codes into maxBits, then repair the Kraft sum */
+	for(i = maxBits + 1; i <= 32; i++) {
+		numCodes[maxBits] += numCodes[i];
+		numCodes[i] = 0;
+	}
+	total = 0;
+	for(i = maxBits; i > 0; i--) total += ((unsigned int) numCodes[i]) << (maxBits - i);
+	while(total != (1U << maxBits)) {
+		numCodes[maxBits]--;
+		for(i = maxBits - 1; i > 0; i--)
+			if(numCodes[i]) {
+				numCodes[i]--;
+				numCodes[i + 1] += 2;
+				break;
+			}
+		total--;
+	}
+
+	/* the most frequent symbols get the shortest codes */
+	j = used;
+	for(len = 1; len <= maxBits; len++)
+		for(k = numCodes[len]; k > 0; k--)
+			lengths[syms[--j]] = len;
+}
+
+/* Make sure at least two symbols are used so every code is complete */
+static void
+ensureTwoCodes(unsigned int *freq, int n)
+{
+	int used = 0, i;
+
+	for(i = 0; i < n; i++) if(freq[i]) used++;
+	for(i = 0; i < n && used < 2; i++)
+		if(!freq[i]) {
+			freq[i] = 1;
+			used++;
+		}
+}
+
+
+/*** Deflate output ***/
+
+static void
+putBits(ZipStream *zs, unsigned int value, int length)
+{
+	unsigned char *p;
+
+	zs->bitBuf |= ((unsigned long long) value) << zs->bitCount;
+	zs->bitCount += length;
+	if(zs->bitCount >= 32) {
+		p = zs->pending + zs->pendingEnd;
+		p[0] = (unsigned char) zs->bitBuf;
+		p[1] = (unsigned char) (zs->bitBuf >> 8);
+		p[2] = (unsigned char) (zs->bitBuf >> 16);
+		p[3] = (unsigned char) (zs->bitBuf >> 24);
+		zs->pendingEnd += 4;
+		zs->bitBuf >>= 32;
+		zs->bitCount -= 32;
+	}
+}
+
+static void
+alignBits(ZipStream *zs)
+{
+	while(zs->bitCount > 0) {
+		zs->pending[zs->pendingEnd++] = (unsigned char) zs->bitBuf;
+		zs->bitBuf >>= 8;
+		zs->bitCount -= 8;
+	}
+	zs->bitBuf = 0;
+	zs->bitCount = 0;
+}
+
+static void
+putByte(ZipStream *zs, int byte)
+{
+	zs->pending[zs->pendingEnd++] = (unsigned char) byte;
+}
+
+static void
+putStored(ZipStream *zs, unsigned char *data, int length, int last)
+{
+	int n;
+
+	do {
+		n = length > 65535 ? 65535 : length;
+		length -= n;
+		putBits(zs, (last && length == 0) ? 1 : 0, 3);
+		alignBits(zs);
+		putByte(zs, n & 255); putByte(zs, n >> 8);
+		putByte(zs, ~n & 255); putByte(zs, (~n >> 8) & 255);
+		memcpy(zs->pending + zs->pendingEnd, data, n);
+		zs->pendingEnd += n;
+		data += n;
+	} while(length > 0);
+}
+
+static void
+putSymbols(ZipStream *zs, unsigned short *litCodes, unsigned char *litLengths,
+	   unsigned short *distCodes, unsigned char *distLengths)
+{
+	int i, lit, dist, code;
+
+	for(i = 0; i < zs->symCount; i++) {
+		lit = zs->symLit[i];
+		dist = zs->symDist[i];
+		if(dist == 0) {
+			putBits(zs, litCodes[lit], litLengths[lit]);
+		} else {
+			code = lengthCode[lit];
+			putBits(zs, litCodes[257 + code], litLengths[257 + code]);
+			if(lengthExtra[code])
+				putBits(zs, lit + 3 - lengthBase[code], lengthExtra[code]);
+			code = distanceCode(dist);
+			putBits(zs, distCodes[code], distLengths[code]);
+			if(distanceExtra[code])
+				putBits(zs, dist - distanceBase[code], distanceExtra[code]);
+		}
+	}
+	putBits(zs, litCodes[256], litLengths[256]);
+}
+
+/* Emit the buffered symbols as one block, choosing the smallest encoding */
+static void
+flushBlock(ZipStream *zs, int last)
+{
+	unsigned char litLengths[286], distLengths[30], clLengths[19];
+	unsigned short litCodes[286], distCodes[30], clCodes[19];
+	unsigned char all[286 + 30], clSym[286 + 30], clExtra[286 + 30];
+	unsigned int clFreq[19];
+	int numLit, numDist, numCl, nAll, nCl, i, j, run, storedLen;
+	unsigned long long extraBits, dynamicBits, fixedBits, storedBits;
+
+	zs->litFreq[256] = 1;
+	ensureTwoCodes(zs->litFreq, 286);
+	ensureTwoCodes(zs->distFreq, 30);
+	buildLengths(zs->litFreq, 286, 15, litLengths);
+	buildLengths(zs->distFreq, 30, 15, distLengths);
+	for(numLit = 286; numLit > 257 && !litLengths[numLit - 1]; numLit--);
+	for(numDist = 30; numDist > 1 && !distLengths[numDist - 1]; numDist--);
+
+	/* run length encode the code lengths */
+	memcpy(all, litLengths, numLit);
+	memcpy(all + numLit, distLengths, numDist);
+	nAll = numLit + numDist;
+	memset(clFreq, 0, sizeof(clFreq));
+	nCl = 0;
+	for(i = 0; i < nAll; i += run) {
+		for(run = 1; i + run < nAll && all[i + run] == all[i]; run++);
+		if(all[i] == 0 && run >= 3) {
+			if(run > 138) run = 138;
+			clSym[nCl] = run <= 10 ? 17 : 18;
+			clExtra[nCl++] = run <= 10 ? run - 3 : run - 11;
+		} else if(all[i] != 0 && run >= 4) {
+			if(run > 7) run = 7;
+			clSym[nCl] = all[i]; clExtra[nCl++] = 0;
+			clSym[nCl] = 16; clExtra[nCl++] = run - 4;
+		} else {
+			run = 1;
+			clSym[nCl] = all[i]; clExtra[nCl++] = 0;
+		}
+	}
+	for(i = 0; i < nCl; i++) clFreq[clSym[i]]++;
+	ensureTwoCodes(clFreq, 19);
+	buildLengths(clFreq, 19, 7, clLengths);
+	for(numCl = 19; numCl > 4 && !clLengths[codeLengthOrder[numCl - 1]]; numCl--);
+
+	/* sizes of the three encodings */
+	extraBits = 0;
+	for(i = 0; i < 29; i++) extraBits += (unsigned long long) zs->litFreq[257 + i] * lengthExtra[i];
+	for(i = 0; i < 30; i++) extraBits += (unsigned long long) zs->distFreq[i] * distanceExtra[i];
+	dynamicBits = 3 + 14 + 3 * numCl + extraBits;
+	fixedBits = 3 + extraBits;
+	for(i = 0; i < 19; i++)
+		dynamicBits += (unsigned long long) clFreq[i] * clLengths[i];
+	dynamicBits += 2 * clFreq[16] + 3 * clFreq[17] + 7 * clFreq[18];
+	for(i = 0; i < 286; i++) {
+		dynamicBits += (unsigned long long) zs->litFreq[i] * litLengths[i];
+		fixedBits += (unsigned long long) zs->litFreq[i] * fixedLitLengths[i];
+	}
+	for(i = 0; i < 30; i++) {
+		dynamicBits += (unsigned long long) zs->distFreq[i] * distLengths[i];
+		fixedBits += (unsigned long long) zs->distFreq[i] * 5;
+	}
+	storedLen = zs->strstart - zs->blockStart;
+	storedBits = (unsigned long long) (storedLen + 5 * (storedLen / 65535 + 1)) * 8 + 7;
+
+	if(zs->blockStart >= 0 && storedBits <= dynamicBits && storedBits <= fixedBits) {
+		putStored(zs, zs->window + zs->blockStart, storedLen, last);
+	} else if(fixedBits <= dynamicBits) {
+		putBits(zs, 2 + last, 3);
+		putSymbols(zs, fixedLitCodes, fixedLitLengths, fixedDistCodes, fixedDistLengths);
+	} else {
+		buildCodes(litLengths, 286, litCodes);
+		buildCodes(distLengths, 30, distCodes);
+		buildCodes(clLengths, 19, clCodes);
+		putBits(zs, 4 + last, 3);
+		putBits(zs, numLit - 257, 5);
+		putBits(zs, numDist - 1, 5);
+		putBits(zs, numCl - 4, 4);
+		for(i = 0; i < numCl; i++) putBits(zs, clLengths[codeLengthOrder[i]], 3);
+		for(i = 0; i < nCl; i++) {
+			j = clSym[i];
+			putBits(zs, clCodes[j], clLengths[j]);
+			if(j == 16) putBits(zs, clExtra[i], 2);
+			else if(j == 17) putBits(zs, clExtra[i], 3);
+			else if(j == 18) putBits(zs, clExtra[i], 7);
+		}
+		putSymbols(zs, litCodes, litLengths, distCodes, distLengths);
+	}
+	zs->symCount = 0;
+	memset(zs->litFreq, 0, sizeof(zs->litFreq));
+	memset(zs->distFreq, 0, sizeof(zs->distFreq));
+	zs->blockStart = zs->strstart;
+}
+
+static void
+putHeader(ZipStream *zs)
+{
+	int flags;
+
+	if(zs->format == ZIP_FORMAT_ZLIB) {
+		flags = zs->level < 2 ? 0 : zs->level < 6 ? 1 : zs->level == 6 ? 2 : 3;
+		flags <<= 6;
+		flags += 31 - ((0x78 * 256 + flags) % 31);
+		putByte(zs, 0x78);
+		putByte(zs, flags);
+	} else if(zs->format == ZIP_FORMAT_GZIP) {
+		putByte(zs, 0x1f); putByte(zs, 0x8b); putByte(zs, 8); putByte(zs, 0);
+		putByte(zs, 0); putByte(zs, 0); putByte(zs, 0); putByte(zs, 0);
+		putByte(zs, zs->level == 9 ? 2 : zs->level == 1 ? 4 : 0);
+		putByte(zs, 255);
+	}
+	zs->headerDone = 1;
+}
+
+static void
+putTrailer(ZipStream *zs)
+{
+	alignBits(zs);
+	if(zs->format == ZIP_FORMAT_ZLIB) {
+		putByte(zs, zs->check >> 24); putByte(zs, zs->check >> 16);
+		putByte(zs, zs->check >> 8); putByte(zs, zs->check);
+	} else if(zs->format == ZIP_FORMAT_GZIP) {
+		unsigned int crc = ~zs->check;
+		putByte(zs, crc); putByte(zs, crc >> 8); putByte(zs, crc >> 16); putByte(zs, crc >> 24);
+		putByte(zs, zs->totalIn); putByte(zs, zs->totalIn >> 8);
+		putByte(zs, zs->totalIn >> 16); putByte(zs, zs->totalIn >> 24);
+	}
+	zs->finished = 1;
+}
+
+
+/*** Deflate matching ***/
+
+static void
+updateCheck(ZipStream *zs, unsigned char *bytes, int length)
+{
+	if(zs->format == ZIP_FORMAT_ZLIB)
+		zs->check = zipUpdateAdler32(zs->check, bytes, length);
+	else if(zs->format == ZIP_FORMAT_GZIP)
+		zs->check = zipUpdateCrc32(zs->check, bytes, length);
+}
+
+static void
+fillWindow(ZipStream *zs)
+{
+	int more, n, i;
+
+	if(zs->availIn == 0) return;
+	if(zs->strstart >= (zs->level == 0 ? WSIZE : WSIZE + MAX_DIST)) {
+		memcpy(zs->window, zs->window + WSIZE, WSIZE);
+		zs->matchStart -= WSIZE;
+		zs->strstart -= WSIZE;
+		zs->blockStart -= WSIZE;
+		if(zs->level > 0) {
+			for(i = 0; i < HASH_SIZE; i++)
+				zs->head[i] = zs->head[i] >= WSIZE ? zs->head[i] - WSIZE : 0;
+			for(i = 0; i < WSIZE; i++)
+				zs->prev[i] = zs->prev[i] >= WSIZE ? zs->prev[i] - WSIZE : 0;
+		}
+	}
+	more = 2 * WSIZE - zs->lookahead - zs->strstart;
+	n = zs->availIn < more ? zs->availIn : more;
+	memcpy(zs->window + zs->strstart + zs->lookahead, zs->nextIn, n);
+	updateCheck(zs, zs->nextIn, n);
+	zs->nextIn += n;
+	zs->availIn -= n;
+	zs->lookahead += n;
+	zs->totalIn += n;
+}
+
+#define HASH(p) ((((unsigned int) (p)[0] | ((unsigned int) (p)[1] << 8) | ((unsigned int) (p)[2] << 16)) \
+			* 0x9E3779B1U) >> (32 - HASH_BITS))
+
+/* Insert the string at pos and answer the previous head of its chain */
+static int
+insertString(ZipStream *zs, int pos)
+{
+	unsigned int h = HASH(zs->window + pos);
+	int match = zs->head[h];
+
+	zs->prev[pos & WMASK] = match;
+	zs->head[h] = pos;
+	return match;
+}
+
+static int
+longestMatch(ZipStream *zs, int curMatch)
+{
+	unsigned char *window = zs->window;
+	unsigned char *scan = window + zs->strstart;
+	unsigned char *match;
+	int chain = zs->maxChain;
+	int best = zs->prevLength < MIN_MATCH - 1 ? MIN_MATCH - 1 : zs->prevLength;
+	int nice = zs->niceMatch < zs->lookahead ? zs->niceMatch : zs->lookahead;
+	int limit = zs->strstart > MAX_DIST ? zs->strstart - MAX_DIST : 0;
+	int len;
+	unsigned long long a, b;
+
+	if(zs->prevLength >= zs->goodMatch) chain >>= 2;
+	do {
+		match = window + curMatch;
+		if(match[best] != scan[best] || match[best - 1] != scan[best - 1]
+		   || match[0] != scan[0] || match[1] != scan[1])
+			continue;
+		/* compare eight bytes at a time; the window has slack at the end */
+		for(len = 2; len < MAX_MATCH; len += 8) {
+			memcpy(&a, scan + len, 8);
+			memcpy(&b, match + len, 8);
+			if(a != b) {
+				a ^= b;
+				while(!(a & 255)) {
+					a >>= 8;
+					len++;
+				}
+				break;
+			}
+		}
+		if(len > MAX_MATCH) len = MAX_MATCH;
+		if(len > best) {
+			zs->matchStart = curMatch;
+			best = len;
+			if(len >= nice) break;
+		}
+	} while((curMatch = zs->prev[curMatch & WMASK]) > limit && --chain != 0);
+	return best <= zs->lookahead ? best : zs->lookahead;
+}
+
+static int
+tallyLiteral(ZipStream *zs, int lit)
+{
+	zs->symLit[zs->symCount] = lit;
+	zs->symDist[zs->symCount++] = 0;
+	zs->litFreq[lit]++;
+	return zs->symCount == LIT_BUFSIZE - 1;
+}
+
+static int
+tallyMatch(ZipStream *zs, int dist, int length)
+{
+	zs->symLit[zs->symCount] = length - MIN_MATCH;
+	zs->symDist[zs->symCount++] = dist;
+	zs->litFreq[257 + lengthCode[length - MIN_MATCH]]++;
+	zs->distFreq[distanceCode(dist)]++;
+	return zs->symCount == LIT_BUFSIZE - 1;
+}
+
+static int
+finishDeflate(ZipStream *zs)
+{
+	flushBlock(zs, 1);
+	putTrailer(zs);
+	return STEP_DONE;
+}
+
+static int
+deflateStored(ZipStream *zs, int finish)
+{
+	int n, last;
+
+	if(zs->lookahead < WSIZE) {
+		fillWindow(zs);
+		if(zs->lookahead < WSIZE && !finish) return STEP_NEED_INPUT;
+	}
+	n = zs->lookahead < WSIZE ? zs->lookahead : WSIZE;
+	last = finish && zs->availIn == 0 && n == zs->lookahead;
+	putStored(zs, zs->window + zs->strstart, n, last);
+	zs->strstart += n;
+	zs->lookahead -= n;
+	zs->blockStart = zs->strstart;
+	if(!last) return STEP_BLOCK;
+	putTrailer(zs);
+	return STEP_DONE;
+}
+
+static int
+deflateGreedy(ZipStream *zs, int finish)
+{
+	int hashHead, length;
+
+	for(;;) {
+		if(zs->lookahead < MIN_LOOKAHEAD) {
+			fillWindow(zs);
+			if(zs->lookahead < MIN_LOOKAHEAD && !finish) return STEP_NEED_INPUT;
+			if(zs->lookahead == 0) return finishDeflate(zs);
+		}
+		hashHead = zs->lookahead >= MIN_MATCH ? insertString(zs, zs->strstart) : 0;
+		length = 0;
+		if(hashHead && zs->strstart - hashHead <= MAX_DIST) {
+			zs->prevLength = MIN_MATCH - 1;
+			length = longestMatch(zs, hashHead);
+		}
+		if(length >= MIN_MATCH) {
+			int full = tallyMatch(zs, zs->strstart - zs->matchStart, length);
+			zs->lookahead -= length;
+			if(length <= zs->maxLazy && zs->lookahead >= MIN_MATCH) {
+				while(--length > 0)
+					insertString(zs, ++zs->strstart);
+				zs->strstart++;
+			} else {
+				zs->strstart += length;
+			}
+			if(full) {
+				flushBlock(zs, 0);
+				return STEP_BLOCK;
+			}
+		} else {
+			int full = tallyLiteral(zs, zs->window[zs->strstart]);
+			zs->lookahead--;
+			zs->strstart++;
+			if(full) {
+				flushBlock(zs, 0);
+				return STEP_BLOCK;
+			}
+		}
+	}
+}
+
+static int
+deflateLazy(ZipStream *zs, int finish)
+{
+	int hashHead, maxInsert, full;
+
+	for(;;) {
+		if(zs->lookahead < MIN_LOOKAHEAD) {
+			fillWindow(zs);
+			if(zs->lookahead < MIN_LOOKAHEAD && !finish) return STEP_NEED_INPUT;
+			if(zs->lookahead == 0) break;
+		}
+		hashHead = zs->lookahead >= MIN_MATCH ? insertString(zs, zs->strstart) : 0;
+		zs->prevLength = zs->matchLength;
+		zs->prevMatch = zs->matchStart;
+		zs->matchLength = MIN_MATCH - 1;
+		if(hashHead && zs->prevLength < zs->maxLazy && zs->strstart - hashHead <= MAX_DIST) {
+			zs->matchLength = longestMatch(zs, hashHead);
+			if(zs->matchLength == MIN_MATCH && zs->strstart - zs->matchStart > TOO_FAR)
+				zs->matchLength = MIN_MATCH - 1;
+		}
+		if(zs->prevLength >= MIN_MATCH && zs->matchLength <= zs->prevLength) {
+			/* the previous match is better; emit it */
+			maxInsert = zs->strstart + zs->lookahead - MIN_MATCH;
+			full = tallyMatch(zs, zs->strstart - 1 - zs->prevMatch, zs->prevLength);
+			zs->lookahead -= zs->prevLength - 1;
+			zs->prevLength -= 2;
+			do {
+				if(++zs->strstart <= maxInsert) insertString(zs, zs->strstart);
+			} while(--zs->prevLength != 0);
+			zs->matchAvailable = 0;
+			zs->matchLength = MIN_MATCH - 1;
+			zs->strstart++;
+			if(full) {
+				flushBlock(zs, 0);
+				return STEP_BLOCK;
+			}
+		} else if(zs->matchAvailable) {
+			/* no better match; emit the previous byte as a literal */
+			full = tallyLiteral(zs, zs->window[zs->strstart - 1]);
+			if(full) flushBlock(zs, 0);
+			zs->strstart++;
+			zs->lookahead--;
+			if(full) return STEP_BLOCK;
+		} else {
+			zs->matchAvailable = 1;
+			zs->strstart++;
+			zs->lookahead--;
+		}
+	}
+	if(zs->matchAvailable) {
+		tallyLiteral(zs, zs->window[zs->strstart - 1]);
+		zs->matchAvailable = 0;
+	}
+	return finishDeflate(zs);
+}
+
+static int
+deflateProcess(ZipStream *zs, unsigned char *in, int inSize, int *inUsed,
+	       unsigned char *out, int outSize, int *outUsed, int finish)
+{
+	int produced = 0, n, step;
+
+	zs->nextIn = in;
+	zs->availIn = inSize;
+	for(;;) {
+		n = zs->pendingEnd - zs->pendingStart;
+		if(n > outSize - produced) n = outSize - produced;
+		memcpy(out + produced, zs->pending + zs->pendingStart, n);
+		produced += n;
+		zs->pendingStart += n;
+		zs->totalOut += n;
+		if(zs->pendingStart < zs->pendingEnd) break;
+		zs->pendingStart = zs->pendingEnd = 0;
+		if(zs->finished) {
+			zs->status = ZIP_STREAM_END;
+			break;
+		}
+		if(!zs->headerDone) {
+			putHeader(zs);
+			continue;
+		}
+		if(zs->level == 0) step = deflateStored(zs, finish);
+		else if(zs->level <= 3) step = deflateGreedy(zs, finish);
+		else step = deflateLazy(zs, finish);
+		if(step == STEP_NEED_INPUT) break;
+	}
+	*inUsed = inSize - zs->availIn;
+	*outUsed = produced;
+	return zs->status;
+}
+
+
+/*** Inflate ***/
+
+/* Answer 0 if the code is complete, 1 if incomplete, -1 if over-subscribed */
+static int
+buildDecoder(ZipHuffman *h, unsigned char *lengths, int n)
+{
+	int offsets[16], next[16], left, len, sym, code, i, r;
+
+	memset(h->count, 0, sizeof(h->count));
+	for(sym = 0; sym < n; sym++) h->count[lengths[sym]]++;
+	if(h->count[0] == n) {
+		/* no codes at all; anything decoded with this is an error */
+		memset(h->fast, 0, sizeof(h->fast));
+		h->count[0] = 0;
+		return 1;
+	}
+	left = 1;
+	for(len = 1; len < 16; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if(left < 0) return -1;
+	}
+	offsets[1] = 0;
+	for(len = 1; len < 15; len++) offsets[len + 1] = offsets[len] + h->count[len];
+	for(sym = 0; sym < n; sym++)
+		if(lengths[sym]) h->symbol[offsets[lengths[sym]]++] = sym;
+
+	memset(h->fast, 0, sizeof(h->fast));
+	code = 0;
+	h->count[0] = 0;
+	for(len = 1; len < 16; len++) {
+		code = (code + h->count[len - 1]) << 1;
+		next[len] = code;
+	}
+	for(sym = 0; sym < n; sym++) {
+		len = lengths[sym];
+		if(len == 0) continue;
+		code = next[len]++;
+		if(len > FAST_BITS) continue;
+		r = reverseBits(code, len);
+		for(i = r; i < (1 << FAST_BITS); i += 1 << len)
+			h->fast[i] = (sym << 4) | len;
+	}
+	return left > 0;
+}
+
+/* An incomplete code is only allowed if it is a single one bit code */
+static int
+singleCode(ZipHuffman *h)
+{
+	int len;
+
+	for(len = 2; len < 16; len++)
+		if(h->count[len]) return 0;
+	return h->count[1] <= 1;
+}
+
+/* Canonical decode of codes longer than FAST_BITS. Answer the symbol, or
+   -1 with *length > 15 for an invalid code or > bits for too few bits. */
+static int
+decodeSlow(ZipHuffman *h, unsigned long long bits, int bitCount, int *length)
+{
+	int code = 0, first = 0, index = 0, len, count;
+
+	for(len = 1; len <= 15 && len <= bitCount; len++) {
+		code |= (int) (bits & 1);
+		bits >>= 1;
+		count = h->count[len];
+		if(code - count < first) {
+			*length = len;
+			return h->symbol[index + (code - first)];
+		}
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	*length = len;
+	return -1;
+}
+
+/* The bit reader and window position are locals which are written back
+   at checkpoints, i.e. after every complete unit. Running out of input jumps to
+   underflow, which returns without saving so the next call resumes at
+   the last checkpoint. REFILL may leave bits of the next unread byte above
+   k; ORing in that byte later is harmless as the bits are the same. */
+#define NEEDBITS(n) \
+	while(k < (n)) { \
+		if(avail == 0) goto underflow; \
+		b |= ((unsigned long long) *in++) << k; \
+		avail--; \
+		k += 8; \
+	}
+#define REFILL() \
+	if(avail >= 8) { \
+		unsigned long long w_; \
+		int n_ = (63 - k) >> 3; \
+		memcpy(&w_, in, 8); \
+		b |= w_ << k; \
+		in += n_; avail -= n_; k += n_ << 3; \
+	} else { \
+		while(k <= 56 && avail > 0) { \
+			b |= ((unsigned long long) *in++) << k; \
+			avail--; \
+			k += 8; \
+		} \
+	}
+#define DROPBITS(n) (b >>= (n), k -= (n))
+#define CHECKPOINT() \
+	(zs->bitBuf = b, zs->bitCount = k, zs->nextIn = in, zs->availIn = avail, zs->wpos = out)
+#define DECODE(h, sym) { \
+	int e_ = (h)->fast[b & FAST_MASK], l_; \
+	if(e_) { \
+		l_ = e_ & 15; \
+		if(l_ > k) goto underflow; \
+		sym = e_ >> 4; \
+	} else { \
+		sym = decodeSlow(h, b, k, &l_); \
+		if(sym < 0) { \
+			if(l_ > 15) goto bad; \
+			goto underflow; \
+		} \
+	} \
+	DROPBITS(l_); \
+}
+
+static void
+inflateSum(ZipStream *zs)
+{
+	if(zs->wpos > zs->wsum) {
+		updateCheck(zs, zs->window + zs->wsum, zs->wpos - zs->wsum);
+		zs->totalOut += zs->wpos - zs->wsum;
+		zs->wsum = zs->wpos;
+	}
+}
+
+static int
+readDynamicTables(ZipStream *zs, unsigned long long *bp, int *kp, unsigned char **inp, int *availp)
+{
+	unsigned long long b = *bp;
+	int k = *kp, avail = *availp;
+	unsigned char *in = *inp;
+	unsigned char lengths[286 + 30], clLengths[19];
+	ZipHuffman *cl = zs->distCode;	/* reused for the code length code */
+	int numLit, numDist, numCl, i, sym, prev, repeat, err;
+
+	NEEDBITS(14);
+	numLit = (int) (b & 31) + 257; DROPBITS(5);
+	numDist = (int) (b & 31) + 1; DROPBITS(5);
+	numCl = (int) (b & 15) + 4; DROPBITS(4);
+	if(numLit > 286 || numDist > 30) return RUN_ERROR;
+	memset(clLengths, 0, sizeof(clLengths));
+	for(i = 0; i < numCl; i++) {
+		NEEDBITS(3);
+		clLengths[codeLengthOrder[i]] = (unsigned char) (b & 7);
+		DROPBITS(3);
+	}
+	if(buildDecoder(cl, clLengths, 19) != 0) return RUN_ERROR;
+	for(i = 0; i < numLit + numDist; ) {
+		REFILL();
+		DECODE(cl, sym);
+		if(sym < 16) {
+			lengths[i++] = sym;
+			continue;
+		}
+		if(sym == 16) {
+			if(i == 0) return RUN_ERROR;
+			prev = lengths[i - 1];
+			NEEDBITS(2); repeat = 3 + (int) (b & 3); DROPBITS(2);
+		} else if(sym == 17) {
+			prev = 0;
+			NEEDBITS(3); repeat = 3 + (int) (b & 7); DROPBITS(3);
+		} else {
+			prev = 0;
+			NEEDBITS(7); repeat = 11 + (int) (b & 127); DROPBITS(7);
+		}
+		if(i + repeat > numLit + numDist) return RUN_ERROR;
+		while(repeat--) lengths[i++] = prev;
+	}
+	if(lengths[256] == 0) return RUN_ERROR;
+	err = buildDecoder(zs->litCode, lengths, numLit);
+	if(err < 0 || (err > 0 && !singleCode(zs->litCode))) return RUN_ERROR;
+	err = buildDecoder(zs->distCode, lengths + numLit, numDist);
+	if(err < 0 || (err > 0 && !singleCode(zs->distCode))) return RUN_ERROR;
+	*bp = b; *kp = k; *inp = in; *availp = avail;
+	return 1;
+underflow:
+	return RUN_NEED_INPUT;
+bad:
+	return RUN_ERROR;
+}
+
+static int
+zipInflateRun(ZipStream *zs)
+{
+	unsigned long long b = zs->bitBuf;
+	int k = zs->bitCount;
+	unsigned char *in = zs->nextIn;
+	int avail = zs->availIn;
+	unsigned char *window = zs->window;
+	int out = zs->wpos;
+	int sym, length, dist, last, n, r;
+	unsigned int value;
+	ZipHuffman *lit, *dst;
+
+	for(;;) switch(zs->mode) {
+
+	case ModeHeader:
+		if(zs->format == ZIP_FORMAT_GZIP) {
+			zs->mode = ModeGZipHeader;
+			zs->headerCount = 0;
+			break;
+		}
+		if(zs->format == ZIP_FORMAT_ZLIB) {
+			NEEDBITS(16);
+			n = (int) (b & 0xFFFF);
+			if((n & 0x0F) != 8 || ((n & 0xFF) >> 4) > 7 || (n & 0x2000)
+			   || ((n & 0xFF) * 256 + (n >> 8)) % 31)
+				goto bad;
+			DROPBITS(16);
+			CHECKPOINT();
+		}
+		zs->mode = ModeBlock;
+		break;
+
+	case ModeGZipHeader:
+		/* magic, method, flags, mtime, xfl, os */
+		while(zs->headerCount < 10) {
+			NEEDBITS(8);
+			n = (int) (b & 255);
+			DROPBITS(8);
+			if((zs->headerCount == 0 && n != 0x1f) || (zs->headerCount == 1 && n != 0x8b)
+			   || (zs->headerCount == 2 && n != 8))
+				goto bad;
+			if(zs->headerCount == 3) zs->headerFlags = n;
+			zs->headerCount++;
+			CHECKPOINT();
+		}
+		zs->headerCount = 0;
+		zs->headerValue = 0;
+		zs->mode = ModeGZipExtraLength;
+		break;
+
+	case ModeGZipExtraLength:
+		if(zs->headerFlags & 4) {
+			while(zs->headerCount < 2) {
+				NEEDBITS(8);
+				zs->headerValue |= (int) (b & 255) << (8 * zs->headerCount);
+				DROPBITS(8);
+				zs->headerCount++;
+				CHECKPOINT();
+			}
+		}
+		zs->mode = ModeGZipExtra;
+		break;
+
+	case ModeGZipExtra:
+		if(zs->headerFlags & 4) {
+			while(zs->headerValue > 0) {
+				NEEDBITS(8);
+				DROPBITS(8);
+				zs->headerValue--;
+				CHECKPOINT();
+			}
+		}
+		zs->mode = ModeGZipName;
+		break;
+
+	case ModeGZipName:
+	case ModeGZipComment:
+		if(zs->headerFlags & (zs->mode == ModeGZipName ? 8 : 16)) {
+			do {
+				NEEDBITS(8);
+				n = (int) (b & 255);
+				DROPBITS(8);
+				CHECKPOINT();
+			} while(n != 0);
+		}
+		zs->headerCount = 0;
+		zs->mode++;
+		break;
+
+	case ModeGZipHeaderCrc:
+		if(zs->headerFlags & 2) {
+			NEEDBITS(16);
+			DROPBITS(16);
+			CHECKPOINT();
+		}
+		zs->mode = ModeBlock;
+		break;
+
+	case ModeBlock:
+		if(zs->lastBlock) {
+			DROPBITS(k & 7);
+			CHECKPOINT();
+			inflateSum(zs);
+			zs->headerCount = 0;
+			zs->headerValue = 0;
+			zs->mode = zs->format == ZIP_FORMAT_RAW ? ModeDone : ModeCheck;
+			break;
+		}
+		NEEDBITS(3);
+		last = (int) (b & 1);
+		n = (int) (b >> 1) & 3;
+		DROPBITS(3);
+		if(n == 0) {
+			DROPBITS(k & 7);
+			NEEDBITS(32);
+			length = (int) (b & 0xFFFF);
+			if(length != (int) ((~b >> 16) & 0xFFFF)) goto bad;
+			DROPBITS(32);
+			zs->storedLeft = length;
+			zs->mode = ModeStored;
+		} else if(n == 1) {
+			memcpy(zs->litCode, &fixedLitDecode, sizeof(ZipHuffman));
+			memcpy(zs->distCode, &fixedDistDecode, sizeof(ZipHuffman));
+			zs->mode = ModeHuffman;
+		} else if(n == 2) {
+			r = readDynamicTables(zs, &b, &k, &in, &avail);
+			if(r == RUN_ERROR) goto bad;
+			if(r == RUN_NEED_INPUT) goto underflow;
+			zs->mode = ModeHuffman;
+		} else {
+			goto bad;
+		}
+		zs->lastBlock = last;
+		CHECKPOINT();
+		break;
+
+	case ModeStored:
+		while(zs->storedLeft > 0) {
+			if(out >= 2 * WSIZE) goto windowFull;
+			if(k >= 8) {
+				window[out++] = (unsigned char) b;
+				DROPBITS(8);
+				zs->storedLeft--;
+			} else {
+				if(avail == 0) goto underflow;
+				/* k is 0 here but REFILL may have left bits of *in above
+				   it; they must not survive skipping past *in */
+				b = 0;
+				n = zs->storedLeft;
+				if(n > avail) n = avail;
+				if(n > 2 * WSIZE - out) n = 2 * WSIZE - out;
+				memcpy(window + out, in, n);
+				out += n; in += n; avail -= n;
+				zs->storedLeft -= n;
+			}
+			CHECKPOINT();
+		}
+		zs->mode = ModeBlock;
+		break;
+
+	case ModeHuffman:
+		lit = zs->litCode;
+		dst = zs->distCode;
+		/* With 8 bytes of input there are at least 56 bits after a refill,
+		   enough for a whole length/distance pair without checks */
+		while(avail >= 8 && out < 2 * WSIZE) {
+			REFILL();
+			DECODE(lit, sym);
+			if(sym < 256) {
+				window[out++] = sym;
+				continue;
+			}
+			if(sym == 256) {
+				zs->mode = ModeBlock;
+				break;
+			}
+			sym -= 257;
+			if(sym >= 29) goto bad;
+			length = lengthBase[sym] + (int) (b & ((1 << lengthExtra[sym]) - 1));
+			DROPBITS(lengthExtra[sym]);
+			DECODE(dst, sym);
+			if(sym >= 30) goto bad;
+			dist = distanceBase[sym] + (int) (b & ((1 << distanceExtra[sym]) - 1));
+			DROPBITS(distanceExtra[sym]);
+			if(dist > out) goto bad;
+			if(dist >= 8) {
+				unsigned char *d = window + out, *s = d - dist;
+				for(n = 0; n < length; n += 8) memcpy(d + n, s + n, 8);
+			} else {
+				for(n = 0; n < length; n++) window[out + n] = window[out + n - dist];
+			}
+			out += length;
+		}
+		CHECKPOINT();
+		if(zs->mode != ModeHuffman) break;
+		/* near the end of the input: one checkpointed symbol at a time */
+		for(;;) {
+			if(out >= 2 * WSIZE) goto windowFull;
+			REFILL();
+			DECODE(lit, sym);
+			if(sym < 256) {
+				window[out++] = sym;
+				CHECKPOINT();
+				continue;
+			}
+			if(sym == 256) {
+				zs->mode = ModeBlock;
+				break;
+			}
+			sym -= 257;
+			if(sym >= 29) goto bad;
+			NEEDBITS(lengthExtra[sym]);
+			length = lengthBase[sym] + (int) (b & ((1 << lengthExtra[sym]) - 1));
+			DROPBITS(lengthExtra[sym]);
+			REFILL();
+			DECODE(dst, sym);
+			if(sym >= 30) goto bad;
+			NEEDBITS(distanceExtra[sym]);
+			dist = distanceBase[sym] + (int) (b & ((1 << distanceExtra[sym]) - 1));
+			DROPBITS(distanceExtra[sym]);
+			if(dist > out) goto bad;
+			for(n = 0; n < length; n++) window[out + n] = window[out + n - dist];
+			out += length;
+			CHECKPOINT();
+		}
+		CHECKPOINT();
+		break;
+
+	case ModeCheck:
+		NEEDBITS(32);
+		value = (unsigned int) (b & 0xFFFFFFFF);
+		if(zs->format == ZIP_FORMAT_ZLIB) {
+			value = (value << 24) | ((value & 0xFF00) << 8) | ((value >> 8) & 0xFF00) | (value >> 24);
+			if(value != zs->check) goto bad;
+		} else {
+			if(value != ~zs->check) goto bad;
+		}
+		DROPBITS(32);
+		CHECKPOINT();
+		zs->mode = zs->format == ZIP_FORMAT_GZIP ? ModeLength : ModeDone;
+		break;
+
+	case ModeLength:
+		NEEDBITS(32);
+		if((unsigned int) (b & 0xFFFFFFFF) != zs->totalOut) goto bad;
+		DROPBITS(32);
+		CHECKPOINT();
+		zs->mode = ModeDone;
+		break;
+
+	case ModeDone:
+		CHECKPOINT();
+		return RUN_END;
+
+	default:
+		goto bad;
+	}
+
+windowFull:
+	CHECKPOINT();
+	return RUN_WINDOW_FULL;
+underflow:
+	return RUN_NEED_INPUT;
+bad:
+	zs->status = ZIP_STREAM_ERROR;
+	return RUN_ERROR;
+}
+
+static int
+inflateProcess(ZipStream *zs, unsigned char *in, int inSize, int *inUsed,
+	       unsigned char *out, int outSize, int *outUsed, int finish)
+{
+	int used = 0, produced = 0, n, r;
+
+	for(;;) {
+		n = zs->wpos - zs->wread;
+		if(n > outSize - produced) n = outSize - produced;
+		memcpy(out + produced, zs->window + zs->wread, n);
+		produced += n;
+		zs->wread += n;
+		if(zs->wread < zs->wpos) break;
+		if(zs->mode == ModeDone) {
+			zs->status = ZIP_STREAM_END;
+			break;
+		}
+		if(zs->wpos >= 2 * WSIZE) {
+			inflateSum(zs);
+			memmove(zs->window, zs->window + zs->wpos - WSIZE, WSIZE);
+			zs->wpos = zs->wread = zs->wsum = WSIZE;
+		}
+		if(zs->holdLen > 0) {
+			n = HOLD_SIZE - zs->holdLen;
+			if(n > inSize - used) n = inSize - used;
+			memcpy(zs->hold + zs->holdLen, in + used, n);
+			zs->holdLen += n;
+			used += n;
+			zs->nextIn = zs->hold;
+			zs->availIn = zs->holdLen;
+			r = zipInflateRun(zs);
+			n = (int) (zs->nextIn - zs->hold);
+			memmove(zs->hold, zs->hold + n, zs->holdLen - n);
+			zs->holdLen -= n;
+			if(r == RUN_NEED_INPUT && (used == inSize || zs->holdLen == HOLD_SIZE)) {
+				if(finish || zs->holdLen == HOLD_SIZE) zs->status = ZIP_STREAM_ERROR;
+				break;
+			}
+		} else {
+			zs->nextIn = in + used;
+			zs->availIn = inSize - used;
+			r = zipInflateRun(zs);
+			used = (int) (zs->nextIn - in);
+			if(r == RUN_NEED_INPUT) {
+				/* keep the bytes of the incomplete unit */
+				if(zs->availIn > HOLD_SIZE) {
+					zs->status = ZIP_STREAM_ERROR;
+					break;
+				}
+				memcpy(zs->hold, zs->nextIn, zs->availIn);
+				zs->holdLen = zs->availIn;
+				used = inSize;
+				if(finish) zs->status = ZIP_STREAM_ERROR;
+				break;
+			}
+		}
+		if(r == RUN_ERROR) break;
+	}
+	*inUsed = used;
+	*outUsed = produced;
+	return zs->status;
+}
+
+
+/*** Streams ***/
+
+static void
+resetStream(ZipStream *zs)
+{
+	zs->status = ZIP_STREAM_OK;
+	zs->check = zs->format == ZIP_FORMAT_GZIP ? 0xFFFFFFFF : 1;
+	zs->totalIn = zs->totalOut = 0;
+	zs->bitBuf = 0;
+	zs->bitCount = 0;
+	if(zs->inflating) {
+		zs->mode = ModeHeader;
+		zs->lastBlock = 0;
+		zs->wpos = zs->wread = zs->wsum = 0;
+		zs->holdLen = 0;
+	} else {
+		zs->strstart = zs->lookahead = zs->blockStart = 0;
+		zs->matchStart = zs->prevMatch = zs->matchAvailable = 0;
+		zs->matchLength = zs->prevLength = MIN_MATCH - 1;
+		zs->symCount = 0;
+		zs->pendingStart = zs->pendingEnd = 0;
+		zs->headerDone = zs->finished = 0;
+		memset(zs->litFreq, 0, sizeof(zs->litFreq));
+		memset(zs->distFreq, 0, sizeof(zs->distFreq));
+		if(zs->head) memset(zs->head, 0, HASH_SIZE * sizeof(unsigned short));
+	}
+}
+
+static void
+freeStream(ZipStream *zs)
+{
+	free(zs->window);
+	free(zs->head);
+	free(zs->prev);
+	free(zs->symLit);
+	free(zs->symDist);
+	free(zs->pending);
+	free(zs->hold);
+	free(zs->litCode);
+	free(zs->distCode);
+	free(zs->source);
+	free(zs->fileName);
+	free(zs->result);
+	free(zs);
+}
+
+/* The window has room for a maximal match and 8 byte copies past its end */
+#define WINDOW_ALLOC (2 * WSIZE + MAX_MATCH + 16)
+
+int
+zipStreamCreate(int inflating, int level, int format)
+{
+	ZipStream *zs;
+	int index, ok;
+
+	if(format < ZIP_FORMAT_RAW || format > ZIP_FORMAT_GZIP) return -1;
+	if(level < 0 || level > 9) level = 6;
+	if(!tablesReady) makeTables();
+	LOCK();
+	for(index = 0; index < ZIP_MAX_STREAMS && zipStreams[index]; index++);
+	UNLOCK();
+	if(index >= ZIP_MAX_STREAMS) return -1;
+
+	zs = calloc(1, sizeof(ZipStream));
+	if(!zs) return -1;
+	zs->inflating = inflating;
+	zs->level = level;
+	zs->format = format;
+	zs->window = calloc(1, WINDOW_ALLOC);
+	if(inflating) {
+		zs->hold = malloc(HOLD_SIZE);
+		zs->litCode = malloc(sizeof(ZipHuffman));
+		zs->distCode = malloc(sizeof(ZipHuffman));
+		ok = zs->window && zs->hold && zs->litCode && zs->distCode;
+	} else {
+		zs->head = calloc(HASH_SIZE, sizeof(unsigned short));
+		zs->prev = calloc(WSIZE, sizeof(unsigned short));
+		zs->symLit = malloc(LIT_BUFSIZE * sizeof(unsigned short));
+		zs->symDist = malloc(LIT_BUFSIZE * sizeof(unsigned short));
+		zs->pending = malloc(PENDING_SIZE);
+		ok = zs->window && zs->head && zs->prev && zs->symLit && zs->symDist && zs->pending;
+		zs->goodMatch = levelConfig[level][0];
+		zs->maxLazy = levelConfig[level][1];
+		zs->niceMatch = levelConfig[level][2];
+		zs->maxChain = levelConfig[level][3];
+	}
+	if(!ok) {
+		freeStream(zs);
+		return -1;
+	}
+	resetStream(zs);
+	LOCK();
+	if(zipStreams[index]) {
+		/* taken meanwhile; only the VM thread creates streams so this is paranoia */
+		UNLOCK();
+		freeStream(zs);
+		return -1;
+	}
+	zipStreams[index] = zs;
+	UNLOCK();
+	return index;
+}
+
+static ZipStream *
+idleStream(int handle)
+{
+	ZipStream *zs;
+
+	if(handle < 0 || handle >= ZIP_MAX_STREAMS) return NULL;
+	LOCK();
+	zs = zipStreams[handle];
+	if(zs && zs->busy) zs = NULL;
+	UNLOCK();
+	return zs;
+}
+
+int
+zipStreamIsValid(int handle)
+{
+	return handle >= 0 && handle < ZIP_MAX_STREAMS && zipStreams[handle] != NULL;
+}
+
+int
+zipStreamDestroy(int handle)
+{
+	ZipStream *zs;
+	int busy;
+
+	if(!zipStreamIsValid(handle)) return 0;
+	LOCK();
+	zs = zipStreams[handle];
+	zipStreams[handle] = NULL;
+	busy = zs->busy;
+	if(busy) zs->destroyRequested = 1;
+	UNLOCK();
+	if(!busy) freeStream(zs);
+	return 1;
+}
+
+int
+zipStreamProcess(int handle, unsigned char *in, int inSize, int *inUsed,
+		 unsigned char *out, int outSize, int *outUsed, int finish)
+{
+	ZipStream *zs = idleStream(handle);
+
+	*inUsed = *outUsed = 0;
+	if(!zs) return ZIP_STREAM_ERROR;
+	if(zs->status != ZIP_STREAM_OK) return zs->status;
+	return zs->inflating
+		? inflateProcess(zs, in, inSize, inUsed, out, outSize, outUsed, finish)
+		: deflateProcess(zs, in, inSize, inUsed, out, outSize, outUsed, finish);
+}
+
+/* Run all of the given input through the stream, appending to result */
+static int
+processInto(ZipStream *zs, unsigned char *in, int inSize, int finish)
+{
+	int inUsed, outUsed, status, grow;
+	unsigned char *bigger;
+
+	for(;;) {
+		if(zs->resultCapacity - zs->resultSize < 65536) {
+			grow = zs->resultCapacity < 65536 ? 65536 : zs->resultCapacity;
+			if(zs->resultCapacity > 0x7FFFFFFF - grow) return ZIP_STREAM_ERROR;
+			bigger = realloc(zs->result, zs->resultCapacity + grow);
+			if(!bigger) return ZIP_STREAM_ERROR;
+			zs->result = bigger;
+			zs->resultCapacity += grow;
+		}
+		status = zs->inflating
+			? inflateProcess(zs, in, inSize, &inUsed, zs->result + zs->resultSize,
+					 zs->resultCapacity - zs->resultSize, &outUsed, finish)
+			: deflateProcess(zs, in, inSize, &inUsed, zs->result + zs->resultSize,
+					 zs->resultCapacity - zs->resultSize, &outUsed, finish);
+		zs->resultSize += outUsed;
+		in += inUsed;
+		inSize -= inUsed;
+		if(status != ZIP_STREAM_OK) return status;
+		/* done when all input is taken and output was not the limit */
+		if(inSize == 0 && zs->resultSize < zs->resultCapacity) return status;
+	}
+}
+
+static void
+runJob(ZipStream *zs)
+{
+	int status;
+
+	if(zs->fileName) {
+		unsigned char *chunk = malloc(FILE_CHUNK);
+		FILE *f = fopen(zs->fileName, "rb");
+		long long left = zs->fileLength;
+		int n;
+
+		status = ZIP_STREAM_ERROR;
+		if(chunk && f && zipFseek(f, zs->fileOffset) == 0) {
+			do {
+				n = (left >= 0 && left < FILE_CHUNK) ? (int) left : FILE_CHUNK;
+				n = (int) fread(chunk, 1, n, f);
+				if(left >= 0) left -= n;
+				status = processInto(zs, chunk, n, n == 0 || left == 0);
+			} while(status == ZIP_STREAM_OK && n > 0 && left != 0);
+			if(left > 0) status = ZIP_STREAM_ERROR;	/* file shorter than requested */
+		}
+		if(f) fclose(f);
+		free(chunk);
+	} else {
+		status = processInto(zs, zs->source, zs->sourceSize, 1);
+	}
+	zs->failed = status != ZIP_STREAM_END;
+	free(zs->source);
+	zs->source = NULL;
+	free(zs->fileName);
+	zs->fileName = NULL;
+}
+
+static void
+finishJob(ZipStream *zs)
+{
+	int destroy, semaIndex;
+
+	/* once busy is clear the VM thread may free the stream, so take
+	   everything needed from it first */
+	LOCK();
+	zs->busy = 0;
+	destroy = zs->destroyRequested;
+	semaIndex = zs->semaIndex;
+	UNLOCK();
+	if(destroy)
+		freeStream(zs);
+	else
+		interpreterProxy->signalSemaphoreWithIndex(semaIndex);
+}
+
+static void
+addWorker(void)
+{
+	LOCK();
+	runningWorkers++;
+#ifdef _WIN32
+	ResetEvent(workersIdle);
+#endif
+	UNLOCK();
+}
+
+/* The last thing a job thread does; zipStreamShutdown() waits for this */
+static void
+removeWorker(void)
+{
+	LOCK();
+	if(--runningWorkers == 0) {
+#ifdef _WIN32
+		SetEvent(workersIdle);
+#else
+		pthread_cond_broadcast(&workersIdle);
+#endif
+	}
+	UNLOCK();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+zipWorker(LPVOID arg)
+#else
+static void *
+zipWorker(void *arg)
+#endif
+{
+	runJob((ZipStream *) arg);
+	finishJob((ZipStream *) arg);
+	removeWorker();
+	return 0;
+}
+
+static int
+startJob(ZipStream *zs, int size, int semaIndex)
+{
+	free(zs->result);
+	zs->result = NULL;
+	zs->resultSize = zs->resultCapacity = 0;
+	zs->failed = 0;
+	zs->semaIndex = semaIndex;
+	resetStream(zs);
+	LOCK();
+	zs->busy = 1;
+	UNLOCK();
+	if(size >= THREAD_THRESHOLD) {
+#ifdef _WIN32
+		HANDLE thread;
+
+		addWorker();
+		thread = CreateThread(NULL, 0, zipWorker, zs, 0, NULL);
+		if(thread) {
+			CloseHandle(thread);
+			return 1;
+		}
+#else
+		pthread_t thread;
+		pthread_attr_t attr;
+		int err;
+
+		addWorker();
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		err = pthread_create(&thread, &attr, zipWorker, zs);
+		pthread_attr_destroy(&attr);
+		if(!err) return 1;
+#endif
+		removeWorker();
+	}
+	/* small job, or no thread: do it now and signal right away */
+	runJob(zs);
+	finishJob(zs);
+	return 1;
+}
+
+int
+zipStreamStart(int handle, unsigned char *bytes, int size, int semaIndex)
+{
+	ZipStream *zs = idleStream(handle);
+
+	if(!zs || size < 0) return 0;
+	free(zs->source);
+	zs->source = malloc(size > 0 ? size : 1);
+	if(!zs->source) return 0;
+	memcpy(zs->source, bytes, size);
+	zs->sourceSize = size;
+	return startJob(zs, size, semaIndex);
+}
+
+int
+zipStreamStartFile(int handle, char *fileName, int nameSize,
+		   long long offset, long long length, int semaIndex)
+{
+	ZipStream *zs = idleStream(handle);
+	char cFileName[1000];
+
+	if(!zs || offset < 0 || nameSize <= 0 || nameSize >= 1000) return 0;
+	/* convert the name as the FilePlugin does; the job opens it later,
+	   possibly on a worker thread that may not call into the VM */
+	interpreterProxy->ioFilenamefromStringofLengthresolveAliases(cFileName, fileName, nameSize, 1);
+	free(zs->fileName);
+	zs->fileName = malloc(strlen(cFileName) + 1);
+	if(!zs->fileName) return 0;
+	strcpy(zs->fileName, cFileName);
+	zs->fileOffset = offset;
+	zs->fileLength = length;
+	return startJob(zs, THREAD_THRESHOLD, semaIndex);
+}
+
+int
+zipStreamResultSize(int handle)
+{
+	ZipStream *zs;
+	int size;
+
+	if(!zipStreamIsValid(handle)) return -2;
+	LOCK();
+	zs = zipStreams[handle];
+	size = zs->busy ? -1 : zs->failed ? -2 : zs->resultSize;
+	UNLOCK();
+	return size;
+}
+
+int
+zipStreamResultCopy(int handle, unsigned char *dst, int dstSize)
+{
+	ZipStream *zs = idleStream(handle);
+	int size;
+
+	if(!zs || zs->failed || dstSize < zs->resultSize) return -1;
+	size = zs->resultSize;
+	memcpy(dst, zs->result, size);
+	free(zs->result);
+	zs->result = NULL;
+	zs->resultSize = zs->resultCapacity = 0;
+	return size;
+}
+
+int
+zipStreamInit(void)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(&zipLock);
+	workersIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+#endif
+	memset(zipStreams, 0, sizeof(zipStreams));
+	runningWorkers = 0;
+	if(!tablesReady) makeTables();
+	return 1;
+}
+
+int
+zipStreamShutdown(void)
+{
+	int i;
+
+	/* busy streams are left to their job threads to free, without
+	   signalling; wait for those threads before the plugin goes away */
+	for(i = 0; i < ZIP_MAX_STREAMS; i++)
+		if(zipStreams[i]) zipStreamDestroy(i);
+	LOCK();
+#ifdef _WIN32
+	while(runningWorkers) {
+		UNLOCK();
+		WaitForSingleObject(workersIdle, INFINITE);
+		LOCK();
+	}
+#else
+	while(runningWorkers)
+		pthread_cond_wait(&workersIdle, &zipLock);
+#endif
+	UNLOCK();
+#ifdef _WIN32
+	CloseHandle(workersIdle);
+#endif
+	return 1;
+}
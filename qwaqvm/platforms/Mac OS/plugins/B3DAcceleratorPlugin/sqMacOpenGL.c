@@ -231,6 +231,7 @@ int glDestroyRenderer(int handle)
 	if(renderer == current)
 		glMakeCurrentRenderer(NULL);
 	aglDestroyContext(renderer->context);
+	glForgetBufferState(renderer);
 	if(renderer->gWorld) {
 		UnlockPixels(renderer->pixMap);
 		DisposeGWorld(renderer->gWorld);
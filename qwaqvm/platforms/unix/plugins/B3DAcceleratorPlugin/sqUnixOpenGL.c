@@ -184,6 +184,7 @@ int glDestroyRenderer(int handle)
       if (!glMakeCurrentRenderer(0))
 	return 0;
       dpy->ioGLdestroyRenderer(renderer);
+      glForgetBufferState(renderer);
       renderer->drawable = 0;
       renderer->context  = 0;
       renderer->used     = 0;
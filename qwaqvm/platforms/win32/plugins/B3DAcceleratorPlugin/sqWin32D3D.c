@@ -2217,4 +2217,42 @@ int d3dShutdown(void)
 }
 
 
+/*****************************************************************************/
+/*****************************************************************************/
+/* Buffer objects and partial texture uploads are OpenGL only; the D3D
+   renderer fails them and clients use vertex arrays and full uploads. */
+
+int d3dCreateBuffer(int handle, int target, int usage, int size, void *data) {
+  return 0;
+}
+
+int d3dUpdateBuffer(int handle, int buffer, int offset, int size, void *data) {
+  return 0;
+}
+
+int d3dDestroyBuffer(int handle, int buffer) {
+  return 0;
+}
+
+int d3dLoadBufferState(int handle, int vtxBuffer, int colorBuffer, int normalBuffer, int txBuffer, int txSize) {
+  return 0;
+}
+
+int d3dDrawBufferElements(int handle, int mode, int idxBuffer, int first, int count) {
+  return 0;
+}
+
+int d3dDrawBufferArrays(int handle, int mode, int first, int count) {
+  return 0;
+}
+
+int d3dCheckBufferElements(int handle, int idxBuffer, int first, int count) {
+  return 0;
+}
+
+int d3dUploadTextureRects(int rendererHandle, int handle, int w, int h, int d, void *bits, int *rects, int nRects, int streaming) {
+  return 0;
+}
+
+
 #endif /* defined(B3DX_D3D) */
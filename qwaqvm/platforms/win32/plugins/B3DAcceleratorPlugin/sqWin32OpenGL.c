@@ -231,6 +231,7 @@ int glDestroyRenderer(int handle) {
   if(!renderer) return 1; /* already destroyed */
   if(!glMakeCurrentRenderer(NULL)) return 0;
   wglDeleteContext(renderer->context);
+  glForgetBufferState(renderer);
   ReleaseDC(renderer->hWnd, renderer->hDC);
   DestroyWindow(renderer->hWnd);
   renderer->hWnd = NULL;
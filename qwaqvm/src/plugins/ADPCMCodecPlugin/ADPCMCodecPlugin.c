@@ -34,6 +34,7 @@ static char __buildInfo[] = "ADPCMCodecPlugin VMMaker-eem.715 uuid: 707ba1f8-c82
 #endif
 
 #include "sqMemoryAccess.h"
+#include "ADPCMCodecPlugin.h"
 
 
 /*** Proxy Functions ***/
@@ -46,10 +47,16 @@ static char __buildInfo[] = "ADPCMCodecPlugin VMMaker-eem.715 uuid: 707ba1f8-c82
 #define fetchArrayofObject(idx,oop) (interpreterProxy->fetchArrayofObject(idx,oop))
 #define fetchFloatofObject(idx,oop) (interpreterProxy->fetchFloatofObject(idx,oop))
 #define fetchIntegerofObject(idx,oop) (interpreterProxy->fetchIntegerofObject(idx,oop))
+#define fetchPointerofObject(idx,oop) (interpreterProxy->fetchPointerofObject(idx,oop))
+#define firstIndexableField(oop) (interpreterProxy->firstIndexableField(oop))
 #define floatValueOf(oop) (interpreterProxy->floatValueOf(oop))
+#define isBytes(oop) (interpreterProxy->isBytes(oop))
+#define isPointers(oop) (interpreterProxy->isPointers(oop))
+#define isWords(oop) (interpreterProxy->isWords(oop))
 #define pop(n) (interpreterProxy->pop(n))
 #define pushInteger(n) (interpreterProxy->pushInteger(n))
 #define sizeOfSTArrayFromCPrimitive(cPtr) (interpreterProxy->sizeOfSTArrayFromCPrimitive(cPtr))
+#define slotSizeOf(oop) (interpreterProxy->slotSizeOf(oop))
 #define storeIntegerofObjectwithValue(idx,oop,value) (interpreterProxy->storeIntegerofObjectwithValue(idx,oop,value))
 #define primitiveFail() interpreterProxy->primitiveFail()
 /* allows accessing Strings in both C and Smalltalk */
@@ -58,6 +65,9 @@ static char __buildInfo[] = "ADPCMCodecPlugin VMMaker-eem.715 uuid: 707ba1f8-c82
 
 
 /*** Constants ***/
+#define CodecSlots 16
+#define MaxStreamSamples 0x1000000
+#define StreamBatchSize 64
 
 
 /*** Variables ***/
@@ -76,18 +86,102 @@ static const char *moduleName =
 
 
 /*** Function Prototypes ***/
+static sqInt codeMonoStreams(sqInt decoding);
 static VirtualMachine * getInterpreter(void);
 EXPORT(const char*) getModuleName(void);
 static sqInt halt(void);
+static sqInt indexTableEntriesFor(ADPCMFormat *format);
+static sqInt loadFormatfrom(ADPCMFormat *format, sqInt codec);
+static sqInt loadStreamfromcountbitsdecoding(ADPCMStream *stream, sqInt codec, sqInt count, sqInt bits, sqInt decoding);
 static sqInt msg(char *s);
 EXPORT(sqInt) primitiveDecodeMono(void);
+EXPORT(sqInt) primitiveDecodeMonoStreams(void);
 EXPORT(sqInt) primitiveDecodeStereo(void);
 EXPORT(sqInt) primitiveEncodeMono(void);
+EXPORT(sqInt) primitiveEncodeMonoStreams(void);
 EXPORT(sqInt) primitiveEncodeStereo(void);
+static sqInt sameFormatas(ADPCMFormat *format, ADPCMFormat *other);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
+static sqInt storeStreaminto(ADPCMStream *stream, sqInt codec);
 
 
 
+/*	Code count samples of each of the mono ADPCMCodecs in the Array codecs,
+	as primitiveDecodeMono or primitiveEncodeMono would code them one by
+	one. The codecs must share one format and each may appear only once.
+	Every codec is checked before any is changed, and the primitive fails
+	if any would run past the end of its encodedBytes or samples. */
+
+static sqInt
+codeMonoStreams(sqInt decoding)
+{
+    sqInt bits;
+    sqInt codec;
+    sqInt codecs;
+    sqInt count;
+    sqInt first;
+    ADPCMFormat format;
+    sqInt j;
+    sqInt k;
+    sqInt n;
+    ADPCMFormat other;
+    sqInt streamCount;
+    ADPCMStream streams[StreamBatchSize];
+
+	codecs = stackValue(1);
+	count = stackIntegerValue(0);
+	if (!(successFlag)) {
+		return null;
+	}
+	success((isPointers(codecs))
+	 && ((count >= 0) && (count <= MaxStreamSamples)));
+	if (!(successFlag)) {
+		return null;
+	}
+	streamCount = slotSizeOf(codecs);
+	if (streamCount == 0) {
+		pop(2);
+		return null;
+	}
+	success(loadFormatfrom((&format), fetchPointerofObject(0, codecs)));
+	if (!(successFlag)) {
+		return null;
+	}
+	bits = adpcmStreamBits((&format), count);
+	for (k = 0; k < streamCount; k += 1) {
+		codec = fetchPointerofObject(k, codecs);
+		success((loadFormatfrom((&other), codec))
+		 && ((sameFormatas((&format), (&other)))
+		 && (loadStreamfromcountbitsdecoding(streams, codec, count, bits, decoding))));
+		for (j = 0; j <= (k - 1); j += 1) {
+			success((fetchPointerofObject(j, codecs)) != codec);
+		}
+		if (!(successFlag)) {
+			return null;
+		}
+	}
+	for (first = 0; first < streamCount; first += StreamBatchSize) {
+		n = ((streamCount - first) < StreamBatchSize) ? (streamCount - first) : StreamBatchSize;
+		for (k = 0; k < n; k += 1) {
+			loadStreamfromcountbitsdecoding(streams + k, fetchPointerofObject(first + k, codecs), count, bits, decoding);
+		}
+		if (decoding) {
+			adpcmDecodeStreams((&format), streams, n, count);
+		}
+		else {
+			adpcmEncodeStreams((&format), streams, n, count);
+		}
+		for (k = 0; k < n; k += 1) {
+			storeStreaminto(streams + k, fetchPointerofObject(first + k, codecs));
+		}
+	}
+	if (!(successFlag)) {
+		return null;
+	}
+	pop(2);
+}
+
+
 /*	Note: This is coded so that plugins can be run from Squeak. */
 
 static VirtualMachine *
@@ -115,6 +209,118 @@ halt(void)
 	return 0;
 }
 
+
+
+/*	Answer how many entries of the indexTable the format's deltas reach */
+
+static sqInt
+indexTableEntriesFor(ADPCMFormat *format)
+{
+	return ((format->deltaValueMask) >= (2 * (format->deltaValueHighBit)))
+		? (format->deltaValueMask) + 1
+		: 2 * (format->deltaValueHighBit);
+}
+
+
+/*	Answer whether codec is an ADPCMCodec with a format the stream coders
+	handle, filling in format if so. */
+
+static sqInt
+loadFormatfrom(ADPCMFormat *format, sqInt codec)
+{
+    sqInt i;
+    sqInt indexTable;
+    sqInt stepSizeTable;
+
+	if (!((isPointers(codec))
+		 && ((slotSizeOf(codec)) >= CodecSlots))) {
+		return 0;
+	}
+	format->deltaSignMask = fetchIntegerofObject(2, codec);
+	format->deltaValueMask = fetchIntegerofObject(3, codec);
+	format->deltaValueHighBit = fetchIntegerofObject(4, codec);
+	format->frameSizeMask = fetchIntegerofObject(5, codec);
+	format->bitsPerSample = fetchIntegerofObject(13, codec);
+	stepSizeTable = fetchPointerofObject(14, codec);
+	indexTable = fetchPointerofObject(15, codec);
+	if (!(successFlag)) {
+		return 0;
+	}
+	if (!(((format->bitsPerSample) >= 1) && ((format->bitsPerSample) <= 16))) {
+		return 0;
+	}
+	if (!(((format->deltaSignMask) > 0)
+		 && (((format->deltaValueMask) >= 0) && ((format->deltaValueMask) < 65536))
+		 && (((format->deltaValueHighBit) >= 0) && ((format->deltaValueHighBit) < 65536)))) {
+		return 0;
+	}
+	if (!((isWords(stepSizeTable))
+		 && ((isWords(indexTable))
+		 && ((((slotSizeOf(stepSizeTable)) * 2) > ADPCM_MAX_INDEX)
+		 && (((slotSizeOf(indexTable)) * 2) >= (indexTableEntriesFor(format))))))) {
+		return 0;
+	}
+	format->stepSizeTable = ((short *) (firstIndexableField(stepSizeTable)));
+	format->indexTable = ((short *) (firstIndexableField(indexTable)));
+	for (i = 0; i <= ADPCM_MAX_INDEX; i += 1) {
+		if ((format->stepSizeTable[i]) < 0) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+/*	Answer whether codec can code count samples, taking bits bits, filling
+	in stream if so. */
+
+static sqInt
+loadStreamfromcountbitsdecoding(ADPCMStream *stream, sqInt codec, sqInt count, sqInt bits, sqInt decoding)
+{
+    sqInt byteSize;
+    sqInt encodedBytes;
+    sqInt sampleSize;
+    sqInt samples;
+    sqInt usedBytes;
+
+	stream->predicted = fetchIntegerofObject(0, codec);
+	stream->index = fetchIntegerofObject(1, codec);
+	stream->currentByte = fetchIntegerofObject(6, codec);
+	stream->bitPosition = fetchIntegerofObject(7, codec);
+	stream->byteIndex = fetchIntegerofObject(8, codec);
+	encodedBytes = fetchPointerofObject(9, codec);
+	samples = fetchPointerofObject(10, codec);
+	stream->sampleIndex = fetchIntegerofObject(12, codec);
+	if (!(successFlag)) {
+		return 0;
+	}
+	if (!((isBytes(encodedBytes))
+		 && (isWords(samples)))) {
+		return 0;
+	}
+	if (!(((stream->predicted) >= -32768) && ((stream->predicted) <= 32767)
+		 && (((stream->index) >= 0) && ((stream->index) <= ADPCM_MAX_INDEX))
+		 && (((stream->bitPosition) >= 0) && ((stream->bitPosition) <= 8))
+		 && (((stream->currentByte) >= 0) && ((stream->currentByte) <= (decoding ? 255 : 65535))))) {
+		return 0;
+	}
+
+	/* bytes read by nextBits: or written by nextBits:put: and the final flush */
+
+	usedBytes = (decoding
+		? ((bits > (stream->bitPosition)) ? ((bits - (stream->bitPosition)) + 7) / 8 : 0)
+		: (((stream->bitPosition) + bits) + 7) / 8);
+	byteSize = slotSizeOf(encodedBytes);
+	sampleSize = (slotSizeOf(samples)) * 2;
+	if (!(((stream->byteIndex) >= 0) && ((stream->byteIndex) <= (byteSize - usedBytes))
+		 && (((stream->sampleIndex) >= 0) && ((stream->sampleIndex) <= (sampleSize - count))))) {
+		return 0;
+	}
+	stream->encodedBytes = ((unsigned char *) (firstIndexableField(encodedBytes)));
+	stream->samples = ((short *) (firstIndexableField(samples)));
+	return 1;
+}
+
 static sqInt
 msg(char *s)
 {
@@ -903,6 +1109,26 @@ primitiveEncodeMono(void)
 }
 
 
+/*	Decode count samples of each of the mono ADPCMCodecs in an Array,
+	which must share one format. See codeMonoStreams. */
+
+EXPORT(sqInt)
+primitiveDecodeMonoStreams(void)
+{
+	codeMonoStreams(1);
+}
+
+
+/*	Encode count samples of each of the mono ADPCMCodecs in an Array,
+	which must share one format. See codeMonoStreams. */
+
+EXPORT(sqInt)
+primitiveEncodeMonoStreams(void)
+{
+	codeMonoStreams(0);
+}
+
+
 /*	not yet implemented */
 
 EXPORT(sqInt)
@@ -923,6 +1149,18 @@ primitiveEncodeStereo(void)
 	pop(1);
 }
 
+static sqInt
+sameFormatas(ADPCMFormat *format, ADPCMFormat *other)
+{
+	return ((format->bitsPerSample) == (other->bitsPerSample))
+	 && (((format->deltaSignMask) == (other->deltaSignMask))
+	 && (((format->deltaValueMask) == (other->deltaValueMask))
+	 && (((format->deltaValueHighBit) == (other->deltaValueHighBit))
+	 && (((format->frameSizeMask) == (other->frameSizeMask))
+	 && (((memcmp(format->stepSizeTable, other->stepSizeTable, (ADPCM_MAX_INDEX + 1) * sizeof(short))) == 0)
+	 && ((memcmp(format->indexTable, other->indexTable, (indexTableEntriesFor(format)) * sizeof(short))) == 0))))));
+}
+
 
 /*	Note: This is coded so that is can be run from Squeak. */
 
@@ -940,14 +1178,27 @@ setInterpreter(struct VirtualMachine*anInterpreter)
 	return ok;
 }
 
+static sqInt
+storeStreaminto(ADPCMStream *stream, sqInt codec)
+{
+	storeIntegerofObjectwithValue(0, codec, stream->predicted);
+	storeIntegerofObjectwithValue(1, codec, stream->index);
+	storeIntegerofObjectwithValue(6, codec, stream->currentByte);
+	storeIntegerofObjectwithValue(7, codec, stream->bitPosition);
+	storeIntegerofObjectwithValue(8, codec, stream->byteIndex);
+	storeIntegerofObjectwithValue(12, codec, stream->sampleIndex);
+}
+
 
 #ifdef SQUEAK_BUILTIN_PLUGIN
 
 void* ADPCMCodecPlugin_exports[][3] = {
 	{"ADPCMCodecPlugin", "getModuleName", (void*)getModuleName},
 	{"ADPCMCodecPlugin", "primitiveDecodeMono", (void*)primitiveDecodeMono},
+	{"ADPCMCodecPlugin", "primitiveDecodeMonoStreams", (void*)primitiveDecodeMonoStreams},
 	{"ADPCMCodecPlugin", "primitiveDecodeStereo", (void*)primitiveDecodeStereo},
 	{"ADPCMCodecPlugin", "primitiveEncodeMono", (void*)primitiveEncodeMono},
+	{"ADPCMCodecPlugin", "primitiveEncodeMonoStreams", (void*)primitiveEncodeMonoStreams},
 	{"ADPCMCodecPlugin", "primitiveEncodeStereo", (void*)primitiveEncodeStereo},
 	{"ADPCMCodecPlugin", "setInterpreter", (void*)setInterpreter},
 	{NULL, NULL, NULL}
@@ -55,11 +55,15 @@ EXPORT(sqInt) primitiveAllocateTexture(void);
 EXPORT(sqInt) primitiveClearDepthBuffer(void);
 EXPORT(sqInt) primitiveClearViewport(void);
 EXPORT(sqInt) primitiveCompositeTexture(void);
+EXPORT(sqInt) primitiveCreateBuffer(void);
 EXPORT(sqInt) primitiveCreateRenderer(void);
 EXPORT(sqInt) primitiveCreateRendererFlags(void);
+EXPORT(sqInt) primitiveDestroyBuffer(void);
 EXPORT(sqInt) primitiveDestroyRenderer(void);
 EXPORT(sqInt) primitiveDestroyTexture(void);
 EXPORT(sqInt) primitiveDrawArrays(void);
+EXPORT(sqInt) primitiveDrawBufferArrays(void);
+EXPORT(sqInt) primitiveDrawBufferElements(void);
 EXPORT(sqInt) primitiveDrawElements(void);
 EXPORT(sqInt) primitiveDrawRangeElements(void);
 EXPORT(sqInt) primitiveEnableDrawRangeChecks(void);
@@ -72,6 +76,7 @@ EXPORT(sqInt) primitiveGetRendererSurfaceHandle(void);
 EXPORT(sqInt) primitiveGetRendererSurfaceHeight(void);
 EXPORT(sqInt) primitiveGetRendererSurfaceWidth(void);
 EXPORT(sqInt) primitiveIsOverlayRenderer(void);
+EXPORT(sqInt) primitiveLoadBufferState(void);
 EXPORT(sqInt) primitiveRendererVersion(void);
 EXPORT(sqInt) primitiveRenderVertexBuffer(void);
 EXPORT(sqInt) primitiveSetBufferRect(void);
@@ -88,6 +93,8 @@ EXPORT(sqInt) primitiveTextureDepth(void);
 EXPORT(sqInt) primitiveTextureGetColorMasks(void);
 EXPORT(sqInt) primitiveTextureSurfaceHandle(void);
 EXPORT(sqInt) primitiveTextureUpload(void);
+EXPORT(sqInt) primitiveTextureUploadRects(void);
+EXPORT(sqInt) primitiveUpdateBuffer(void);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
 EXPORT(sqInt) shutdownModule(void);
 static sqInt stackLightArrayValue(sqInt stackIndex);
@@ -359,6 +366,52 @@ primitiveCompositeTexture(void) {
 }
 
 
+/*	Primitive. Create a retained vertex or index buffer on the given renderer.
+	The buffer is initialized from the contents of a Bitmap, IntegerArray or
+	FloatArray, or left undefined when given the size in words instead.
+	Answer the buffer handle. */
+
+EXPORT(sqInt)
+primitiveCreateBuffer(void) {
+    sqInt data;
+    void *dataPtr;
+    sqInt handle;
+    sqInt result;
+    sqInt size;
+    sqInt target;
+    sqInt usage;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 4)) {
+		return interpreterProxy->primitiveFail();
+	}
+	data = interpreterProxy->stackValue(0);
+	if ((data & 1)) {
+		size = (data >> 1);
+		dataPtr = null;
+	} else {
+		if (!(interpreterProxy->isWords(data))) {
+			return interpreterProxy->primitiveFail();
+		}
+		size = interpreterProxy->slotSizeOf(data);
+		dataPtr = interpreterProxy->firstIndexableField(data);
+	}
+	if (size < 0) {
+		return interpreterProxy->primitiveFail();
+	}
+	usage = interpreterProxy->stackIntegerValue(1);
+	target = interpreterProxy->stackIntegerValue(2);
+	handle = interpreterProxy->stackIntegerValue(3);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	result = b3dxCreateBuffer(handle, target, usage, size * 4, dataPtr);
+	if (result == 0) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(5);
+	return interpreterProxy->pushInteger(result);
+}
+
 /*	NOTE: This primitive is obsolete but should be supported for older images */
 
 EXPORT(sqInt)
@@ -419,6 +472,27 @@ primitiveCreateRendererFlags(void) {
 	return interpreterProxy->pushInteger(result);
 }
 
+EXPORT(sqInt)
+primitiveDestroyBuffer(void) {
+    sqInt buffer;
+    sqInt handle;
+    sqInt result;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	buffer = interpreterProxy->stackIntegerValue(0);
+	handle = interpreterProxy->stackIntegerValue(1);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	result = b3dxDestroyBuffer(handle, buffer);
+	if (!(result)) {
+		return interpreterProxy->primitiveFail();
+	}
+	return interpreterProxy->pop(2);
+}
+
 EXPORT(sqInt)
 primitiveDestroyRenderer(void) {
     sqInt handle;
@@ -529,6 +603,73 @@ primitiveDrawArrays(void) {
 }
 
 
+/*	Primitive. Draw count vertices starting at first from the buffers set up
+	by primitiveLoadBufferState. Fail if the range goes beyond the vertices
+	that the buffers hold. */
+
+EXPORT(sqInt)
+primitiveDrawBufferArrays(void) {
+    sqInt count;
+    sqInt first;
+    sqInt handle;
+    sqInt mode;
+    sqInt ok;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 4)) {
+		return interpreterProxy->primitiveFail();
+	}
+	count = interpreterProxy->stackIntegerValue(0);
+	first = interpreterProxy->stackIntegerValue(1);
+	mode = interpreterProxy->stackIntegerValue(2);
+	handle = interpreterProxy->stackIntegerValue(3);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	ok = b3dxDrawBufferArrays(handle, mode, first, count);
+	if (!(ok)) {
+		return interpreterProxy->primitiveFail();
+	}
+	return interpreterProxy->pop(4);
+}
+
+
+/*	Primitive. Draw count indices starting at first from the given index
+	buffer using the buffers set up by primitiveLoadBufferState. Fail if the
+	range goes beyond the index buffer or, when range checks are enabled, if
+	any of the indices goes beyond the vertices of the loaded buffers. */
+
+EXPORT(sqInt)
+primitiveDrawBufferElements(void) {
+    sqInt count;
+    sqInt first;
+    sqInt handle;
+    sqInt idxBuffer;
+    sqInt mode;
+    sqInt ok;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 5)) {
+		return interpreterProxy->primitiveFail();
+	}
+	count = interpreterProxy->stackIntegerValue(0);
+	first = interpreterProxy->stackIntegerValue(1);
+	idxBuffer = interpreterProxy->stackIntegerValue(2);
+	mode = interpreterProxy->stackIntegerValue(3);
+	handle = interpreterProxy->stackIntegerValue(4);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (doRangeChecks) {
+		if (!(b3dxCheckBufferElements(handle, idxBuffer, first, count))) {
+			return interpreterProxy->primitiveFail();
+		}
+	}
+	ok = b3dxDrawBufferElements(handle, mode, idxBuffer, first, count);
+	if (!(ok)) {
+		return interpreterProxy->primitiveFail();
+	}
+	return interpreterProxy->pop(5);
+}
+
 /*	Primitive. Setup non-VBO client state and call drawElements in one go to
 	avoid garbage collection to move the buffers underneith. */
 
@@ -902,6 +1043,43 @@ primitiveIsOverlayRenderer(void) {
 	return interpreterProxy->pushBool(result);
 }
 
+/*	Primitive. Set up the vertex, color, normal and texture coordinate arrays
+	from retained buffers. A buffer handle of zero disables that array. */
+
+EXPORT(sqInt)
+primitiveLoadBufferState(void) {
+    sqInt colorBuffer;
+    sqInt handle;
+    sqInt normalBuffer;
+    sqInt ok;
+    sqInt txBuffer;
+    sqInt txSize;
+    sqInt vtxBuffer;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 6)) {
+		return interpreterProxy->primitiveFail();
+	}
+	txSize = interpreterProxy->stackIntegerValue(0);
+	txBuffer = interpreterProxy->stackIntegerValue(1);
+	normalBuffer = interpreterProxy->stackIntegerValue(2);
+	colorBuffer = interpreterProxy->stackIntegerValue(3);
+	vtxBuffer = interpreterProxy->stackIntegerValue(4);
+	handle = interpreterProxy->stackIntegerValue(5);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if ((txBuffer != 0)
+	 && ((txSize < 1)
+ || (txSize > 4))) {
+		return interpreterProxy->primitiveFail();
+	}
+	ok = b3dxLoadBufferState(handle, vtxBuffer, colorBuffer, normalBuffer, txBuffer, txSize);
+	if (!(ok)) {
+		return interpreterProxy->primitiveFail();
+	}
+	return interpreterProxy->pop(6);
+}
+
 EXPORT(sqInt)
 primitiveRendererVersion(void) {
 	if (!((interpreterProxy->methodArgumentCount()) == 0)) {
@@ -1321,6 +1499,105 @@ primitiveTextureUpload(void) {
 	return interpreterProxy->pop(3);
 }
 
+/*	Primitive. Upload only the dirty rectangles of the form into the texture.
+	The rectangles are given as x, y, width, height quadruples in an
+	IntegerArray; if streaming is true the upload goes through pixel buffer
+	objects where available. */
+
+EXPORT(sqInt)
+primitiveTextureUploadRects(void) {
+    sqInt bits;
+    void*bitsPtr;
+    sqInt d;
+    sqInt form;
+    sqInt h;
+    sqInt handle;
+    sqInt nRects;
+    sqInt ppw;
+    sqInt rects;
+    sqInt renderer;
+    sqInt result;
+    sqInt streaming;
+    sqInt w;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 5)) {
+		return interpreterProxy->primitiveFail();
+	}
+	streaming = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(0));
+	rects = interpreterProxy->stackValue(1);
+	if (!((interpreterProxy->isWords(rects))
+		 && (((interpreterProxy->slotSizeOf(rects)) % 4) == 0))) {
+		return interpreterProxy->primitiveFail();
+	}
+	nRects = (interpreterProxy->slotSizeOf(rects)) / 4;
+	form = interpreterProxy->stackValue(2);
+	if (!((interpreterProxy->isPointers(form))
+		 && ((interpreterProxy->slotSizeOf(form)) >= 4))) {
+		return interpreterProxy->primitiveFail();
+	}
+	bits = interpreterProxy->fetchPointerofObject(0, form);
+	w = interpreterProxy->fetchIntegerofObject(1, form);
+	h = interpreterProxy->fetchIntegerofObject(2, form);
+	d = interpreterProxy->fetchIntegerofObject(3, form);
+	ppw = 32 / d;
+	if (!(interpreterProxy->isWords(bits))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if (!((interpreterProxy->slotSizeOf(bits)) == ((((w + ppw) - 1) / ppw) * h))) {
+		return interpreterProxy->primitiveFail();
+	}
+	bitsPtr = interpreterProxy->firstIndexableField(bits);
+	handle = interpreterProxy->stackIntegerValue(3);
+	renderer = interpreterProxy->stackIntegerValue(4);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	result = b3dxUploadTextureRects(renderer, handle, w, h, d, bitsPtr, interpreterProxy->firstIndexableField(rects), nRects, streaming);
+	if (!(result)) {
+		return interpreterProxy->primitiveFail();
+	}
+	return interpreterProxy->pop(5);
+}
+
+/*	Primitive. Upload the words start through stop of data into the buffer
+	at the same position, so that only the modified range of a mesh needs to
+	be sent to the card. */
+
+EXPORT(sqInt)
+primitiveUpdateBuffer(void) {
+    sqInt buffer;
+    sqInt data;
+    sqInt handle;
+    sqInt result;
+    sqInt start;
+    sqInt stop;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 5)) {
+		return interpreterProxy->primitiveFail();
+	}
+	stop = interpreterProxy->stackIntegerValue(0);
+	start = interpreterProxy->stackIntegerValue(1);
+	data = interpreterProxy->stackValue(2);
+	if (!(interpreterProxy->isWords(data))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if ((start < 1)
+	 || ((stop < (start - 1))
+ || (stop > (interpreterProxy->slotSizeOf(data))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	buffer = interpreterProxy->stackIntegerValue(3);
+	handle = interpreterProxy->stackIntegerValue(4);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	result = b3dxUpdateBuffer(handle, buffer, (start - 1) * 4, ((stop - start) + 1) * 4, ((int *) (interpreterProxy->firstIndexableField(data))) + (start - 1));
+	if (!(result)) {
+		return interpreterProxy->primitiveFail();
+	}
+	return interpreterProxy->pop(5);
+}
+
 
 /*	Note: This is coded so that is can be run from Squeak. */
 
@@ -1500,6 +1777,11 @@ stackPrimitiveVertex(sqInt index) {
 
 #ifdef SQUEAK_BUILTIN_PLUGIN
 
+#ifdef SQUEAK3D_FILL_MODE
+/* Defined in Squeak3D/sqB3DFillMode.c in VMs that link the software rasterizer */
+extern sqInt primitiveSetFillMode(void);
+#endif
+
 void* B3DAcceleratorPlugin_exports[][3] = {
 	{"B3DAcceleratorPlugin", "getModuleName", (void*)getModuleName},
 	{"B3DAcceleratorPlugin", "initialiseModule", (void*)initialiseModule},
@@ -1507,11 +1789,15 @@ void* B3DAcceleratorPlugin_exports[][3] = {
 	{"B3DAcceleratorPlugin", "primitiveClearDepthBuffer", (void*)primitiveClearDepthBuffer},
 	{"B3DAcceleratorPlugin", "primitiveClearViewport", (void*)primitiveClearViewport},
 	{"B3DAcceleratorPlugin", "primitiveCompositeTexture", (void*)primitiveCompositeTexture},
+	{"B3DAcceleratorPlugin", "primitiveCreateBuffer", (void*)primitiveCreateBuffer},
 	{"B3DAcceleratorPlugin", "primitiveCreateRenderer", (void*)primitiveCreateRenderer},
 	{"B3DAcceleratorPlugin", "primitiveCreateRendererFlags", (void*)primitiveCreateRendererFlags},
+	{"B3DAcceleratorPlugin", "primitiveDestroyBuffer", (void*)primitiveDestroyBuffer},
 	{"B3DAcceleratorPlugin", "primitiveDestroyRenderer", (void*)primitiveDestroyRenderer},
 	{"B3DAcceleratorPlugin", "primitiveDestroyTexture", (void*)primitiveDestroyTexture},
 	{"B3DAcceleratorPlugin", "primitiveDrawArrays", (void*)primitiveDrawArrays},
+	{"B3DAcceleratorPlugin", "primitiveDrawBufferArrays", (void*)primitiveDrawBufferArrays},
+	{"B3DAcceleratorPlugin", "primitiveDrawBufferElements", (void*)primitiveDrawBufferElements},
 	{"B3DAcceleratorPlugin", "primitiveDrawElements", (void*)primitiveDrawElements},
 	{"B3DAcceleratorPlugin", "primitiveDrawRangeElements", (void*)primitiveDrawRangeElements},
 	{"B3DAcceleratorPlugin", "primitiveEnableDrawRangeChecks", (void*)primitiveEnableDrawRangeChecks},
@@ -1524,9 +1810,13 @@ void* B3DAcceleratorPlugin_exports[][3] = {
 	{"B3DAcceleratorPlugin", "primitiveGetRendererSurfaceHeight", (void*)primitiveGetRendererSurfaceHeight},
 	{"B3DAcceleratorPlugin", "primitiveGetRendererSurfaceWidth", (void*)primitiveGetRendererSurfaceWidth},
 	{"B3DAcceleratorPlugin", "primitiveIsOverlayRenderer", (void*)primitiveIsOverlayRenderer},
+	{"B3DAcceleratorPlugin", "primitiveLoadBufferState", (void*)primitiveLoadBufferState},
 	{"B3DAcceleratorPlugin", "primitiveRendererVersion", (void*)primitiveRendererVersion},
 	{"B3DAcceleratorPlugin", "primitiveRenderVertexBuffer", (void*)primitiveRenderVertexBuffer},
 	{"B3DAcceleratorPlugin", "primitiveSetBufferRect", (void*)primitiveSetBufferRect},
+#ifdef SQUEAK3D_FILL_MODE
+	{"B3DAcceleratorPlugin", "primitiveSetFillMode", (void*)primitiveSetFillMode},
+#endif
 	{"B3DAcceleratorPlugin", "primitiveSetFog", (void*)primitiveSetFog},
 	{"B3DAcceleratorPlugin", "primitiveSetIntProperty", (void*)primitiveSetIntProperty},
 	{"B3DAcceleratorPlugin", "primitiveSetLights", (void*)primitiveSetLights},
@@ -1540,6 +1830,8 @@ void* B3DAcceleratorPlugin_exports[][3] = {
 	{"B3DAcceleratorPlugin", "primitiveTextureGetColorMasks", (void*)primitiveTextureGetColorMasks},
 	{"B3DAcceleratorPlugin", "primitiveTextureSurfaceHandle", (void*)primitiveTextureSurfaceHandle},
 	{"B3DAcceleratorPlugin", "primitiveTextureUpload", (void*)primitiveTextureUpload},
+	{"B3DAcceleratorPlugin", "primitiveTextureUploadRects", (void*)primitiveTextureUploadRects},
+	{"B3DAcceleratorPlugin", "primitiveUpdateBuffer", (void*)primitiveUpdateBuffer},
 	{"B3DAcceleratorPlugin", "setInterpreter", (void*)setInterpreter},
 	{"B3DAcceleratorPlugin", "shutdownModule", (void*)shutdownModule},
 	{NULL, NULL, NULL}
@@ -53,10 +53,15 @@ EXPORT(sqInt) primitiveGatherEntropy(void);
 EXPORT(sqInt) primitiveInplaceHouseHolderInvert(void);
 EXPORT(sqInt) primitiveInverseByAdjoint(void);
 EXPORT(sqInt) primitiveMD5Transform(void);
+EXPORT(sqInt) primitiveOptimizeVertexFetch(void);
 EXPORT(sqInt) primitiveOptimizeVertexIndicesForCacheLocality(void);
 EXPORT(sqInt) primitiveOrthoNormInverseMatrix(void);
+EXPORT(sqInt) primitiveTransformBoxesInto(void);
 EXPORT(sqInt) primitiveTransformDirection(void);
+EXPORT(sqInt) primitiveTransformDirectionsInto(void);
+EXPORT(sqInt) primitiveTransformMatricesInto(void);
 EXPORT(sqInt) primitiveTransformMatrixWithInto(void);
+EXPORT(sqInt) primitiveTransformPointsInto(void);
 EXPORT(sqInt) primitiveTransformVector3(void);
 EXPORT(sqInt) primitiveTransposeMatrix(void);
 EXPORT(sqInt) primitiveTriBoxIntersects(void);
@@ -558,6 +563,52 @@ primitiveMD5Transform(void) {
 }
 
 
+/*	Given a list of integer indices for rendering a triangle-mesh in
+	indexed-triangles mode (typically already optimized for cache locality),
+	renumber the vertices in the order the indices first use them so that
+	vertex fetches walk memory sequentially. The indices are rewritten
+	in-place and the second argument, an IntegerArray with one slot per
+	vertex, receives the new index of each vertex (or -1 if unused). The
+	caller reorders its vertex arrays accordingly. Answer the number of
+	vertices used. */
+
+EXPORT(sqInt)
+primitiveOptimizeVertexFetch(void) {
+    sqInt byteSize;
+    void *indices;
+    sqInt indicesOop;
+    void *remap;
+    sqInt remapOop;
+    sqInt result;
+    sqInt triCount;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	remapOop = interpreterProxy->stackObjectValue(0);
+	indicesOop = interpreterProxy->stackObjectValue(1);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isWords(indicesOop))
+		 && (interpreterProxy->isWords(remapOop)))) {
+		return interpreterProxy->primitiveFail();
+	}
+	byteSize = interpreterProxy->byteSizeOf(indicesOop);
+	triCount = byteSize / 12;
+	if (!((triCount * 12) == byteSize)) {
+		return interpreterProxy->primitiveFail();
+	}
+	indices = interpreterProxy->firstIndexableField(indicesOop);
+	remap = interpreterProxy->firstIndexableField(remapOop);
+	result = optimizeVertexFetch((int*)indices, triCount, (int*)remap, interpreterProxy->slotSizeOf(remapOop));
+	if (result < 0) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(3);
+	return interpreterProxy->pushInteger(result);
+}
+
 /*	Given a list of integer indices for rendering a triangle-mesh in
 	indexed-triangles mode, reorganize the indices in-place to provide better
 	vertex cache locality.
@@ -655,6 +706,49 @@ primitiveOrthoNormInverseMatrix(void) {
 	return interpreterProxy->push(dstOop);
 }
 
+
+/*	Transform all the axis aligned boxes in the first argument, a FloatArray
+	of min x, y, z and max x, y, z values, by the receiver and store the
+	boxes enclosing the results into the second argument (which may be the
+	same array). The receiver must be an affine transform. */
+
+EXPORT(sqInt)
+primitiveTransformBoxesInto(void) {
+    sqInt count;
+    float *dst;
+    sqInt dstOop;
+    float *matrix;
+    float *src;
+    sqInt srcOop;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	dstOop = interpreterProxy->stackObjectValue(0);
+	srcOop = interpreterProxy->stackObjectValue(1);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isWords(srcOop))
+		 && ((interpreterProxy->isWords(dstOop))
+ && ((interpreterProxy->slotSizeOf(srcOop)) == (interpreterProxy->slotSizeOf(dstOop)))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	count = (interpreterProxy->slotSizeOf(srcOop)) / 6;
+	if (!((count * 6) == (interpreterProxy->slotSizeOf(srcOop)))) {
+		return interpreterProxy->primitiveFail();
+	}
+	matrix = stackMatrix(2);
+	if (matrix == null) {
+		return interpreterProxy->primitiveFail();
+	}
+	src = interpreterProxy->firstIndexableField(srcOop);
+	dst = interpreterProxy->firstIndexableField(dstOop);
+	transformBoxes(matrix, src, dst, count);
+	interpreterProxy->pop(3);
+	return interpreterProxy->push(dstOop);
+}
+
 EXPORT(sqInt)
 primitiveTransformDirection(void) {
     float *matrix;
@@ -699,6 +793,111 @@ primitiveTransformDirection(void) {
 }
 
 
+/*	Transform all the directions in the first argument, a FloatArray of
+	x, y, z triples, by the receiver and store the results into the second
+	argument (which may be the same array). */
+
+EXPORT(sqInt)
+primitiveTransformDirectionsInto(void) {
+    sqInt count;
+    float *dst;
+    sqInt dstOop;
+    float *matrix;
+    float *src;
+    sqInt srcOop;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	dstOop = interpreterProxy->stackObjectValue(0);
+	srcOop = interpreterProxy->stackObjectValue(1);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isWords(srcOop))
+		 && ((interpreterProxy->isWords(dstOop))
+ && ((interpreterProxy->slotSizeOf(srcOop)) == (interpreterProxy->slotSizeOf(dstOop)))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	count = (interpreterProxy->slotSizeOf(srcOop)) / 3;
+	if (!((count * 3) == (interpreterProxy->slotSizeOf(srcOop)))) {
+		return interpreterProxy->primitiveFail();
+	}
+	matrix = stackMatrix(2);
+	if (matrix == null) {
+		return interpreterProxy->primitiveFail();
+	}
+	src = interpreterProxy->firstIndexableField(srcOop);
+	dst = interpreterProxy->firstIndexableField(dstOop);
+	transformDirections(matrix, src, dst, count);
+	interpreterProxy->pop(3);
+	return interpreterProxy->push(dstOop);
+}
+
+
+/*	Multiply each of the matrices in the receiver, a FloatArray of 4x4
+	matrices, with the corresponding one in the first argument and store the
+	result into the second argument. If the receiver is a single matrix it
+	is used for all of them, e.g., to compute the global transforms of the
+	children of a node. The result may be stored into the receiver but not
+	into the first argument. */
+
+EXPORT(sqInt)
+primitiveTransformMatricesInto(void) {
+    sqInt count;
+    float *m1;
+    sqInt m1Oop;
+    sqInt m1Step;
+    float *m2;
+    sqInt m2Oop;
+    float *m3;
+    sqInt m3Oop;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	m3Oop = interpreterProxy->stackObjectValue(0);
+	m2Oop = interpreterProxy->stackObjectValue(1);
+	m1Oop = interpreterProxy->stackObjectValue(2);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isWords(m1Oop))
+		 && ((interpreterProxy->isWords(m2Oop))
+ && (interpreterProxy->isWords(m3Oop))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if (m2Oop == m3Oop) {
+		return interpreterProxy->primitiveFail();
+	}
+	count = (interpreterProxy->slotSizeOf(m2Oop)) / 16;
+	if (!(((count * 16) == (interpreterProxy->slotSizeOf(m2Oop)))
+		 && ((interpreterProxy->slotSizeOf(m3Oop)) == (interpreterProxy->slotSizeOf(m2Oop))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if ((interpreterProxy->slotSizeOf(m1Oop)) == 16) {
+		m1Step = 0;
+	}
+	else {
+		if (!((interpreterProxy->slotSizeOf(m1Oop)) == (interpreterProxy->slotSizeOf(m2Oop)))) {
+			return interpreterProxy->primitiveFail();
+		}
+		m1Step = 16;
+	}
+	if ((m1Step == 0)
+	 && (m1Oop == m3Oop)
+	 && (count > 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	m1 = interpreterProxy->firstIndexableField(m1Oop);
+	m2 = interpreterProxy->firstIndexableField(m2Oop);
+	m3 = interpreterProxy->firstIndexableField(m3Oop);
+	transformMatrices(m1, m1Step, m2, m3, count);
+	interpreterProxy->pop(3);
+	return interpreterProxy->push(m3Oop);
+}
+
+
 /*	Transform two matrices into the third */
 
 EXPORT(sqInt)
@@ -749,6 +948,49 @@ primitiveTransformMatrixWithInto(void) {
 	return interpreterProxy->pop(3);
 }
 
+
+/*	Transform all the points in the first argument, a FloatArray of x, y, z
+	triples, by the receiver and store the results into the second argument
+	(which may be the same array). Like primitiveTransformVector3 this does
+	the perspective division if needed. */
+
+EXPORT(sqInt)
+primitiveTransformPointsInto(void) {
+    sqInt count;
+    float *dst;
+    sqInt dstOop;
+    float *matrix;
+    float *src;
+    sqInt srcOop;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	dstOop = interpreterProxy->stackObjectValue(0);
+	srcOop = interpreterProxy->stackObjectValue(1);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isWords(srcOop))
+		 && ((interpreterProxy->isWords(dstOop))
+ && ((interpreterProxy->slotSizeOf(srcOop)) == (interpreterProxy->slotSizeOf(dstOop)))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	count = (interpreterProxy->slotSizeOf(srcOop)) / 3;
+	if (!((count * 3) == (interpreterProxy->slotSizeOf(srcOop)))) {
+		return interpreterProxy->primitiveFail();
+	}
+	matrix = stackMatrix(2);
+	if (matrix == null) {
+		return interpreterProxy->primitiveFail();
+	}
+	src = interpreterProxy->firstIndexableField(srcOop);
+	dst = interpreterProxy->firstIndexableField(dstOop);
+	transformPoints(matrix, src, dst, count);
+	interpreterProxy->pop(3);
+	return interpreterProxy->push(dstOop);
+}
+
 EXPORT(sqInt)
 primitiveTransformVector3(void) {
     float *matrix;
@@ -984,10 +1226,15 @@ void* CroquetPlugin_exports[][3] = {
 	{"CroquetPlugin", "primitiveInplaceHouseHolderInvert", (void*)primitiveInplaceHouseHolderInvert},
 	{"CroquetPlugin", "primitiveInverseByAdjoint", (void*)primitiveInverseByAdjoint},
 	{"CroquetPlugin", "primitiveMD5Transform", (void*)primitiveMD5Transform},
+	{"CroquetPlugin", "primitiveOptimizeVertexFetch", (void*)primitiveOptimizeVertexFetch},
 	{"CroquetPlugin", "primitiveOptimizeVertexIndicesForCacheLocality", (void*)primitiveOptimizeVertexIndicesForCacheLocality},
 	{"CroquetPlugin", "primitiveOrthoNormInverseMatrix", (void*)primitiveOrthoNormInverseMatrix},
+	{"CroquetPlugin", "primitiveTransformBoxesInto", (void*)primitiveTransformBoxesInto},
 	{"CroquetPlugin", "primitiveTransformDirection", (void*)primitiveTransformDirection},
+	{"CroquetPlugin", "primitiveTransformDirectionsInto", (void*)primitiveTransformDirectionsInto},
+	{"CroquetPlugin", "primitiveTransformMatricesInto", (void*)primitiveTransformMatricesInto},
 	{"CroquetPlugin", "primitiveTransformMatrixWithInto", (void*)primitiveTransformMatrixWithInto},
+	{"CroquetPlugin", "primitiveTransformPointsInto", (void*)primitiveTransformPointsInto},
 	{"CroquetPlugin", "primitiveTransformVector3", (void*)primitiveTransformVector3},
 	{"CroquetPlugin", "primitiveTransposeMatrix", (void*)primitiveTransposeMatrix},
 	{"CroquetPlugin", "primitiveTriBoxIntersects", (void*)primitiveTriBoxIntersects},
@@ -35,6 +35,7 @@ static char __buildInfo[] = "FFTPlugin VMMaker-eem.524 uuid: 9b748596-0986-4ca7-
 #endif
 
 #include "sqMemoryAccess.h"
+#include "FFTPlugin.h"
 
 
 
@@ -47,14 +48,21 @@ static unsigned int * checkedWordPtrOf(sqInt oop);
 static VirtualMachine * getInterpreter(void);
 EXPORT(const char*) getModuleName(void);
 static sqInt halt(void);
+EXPORT(sqInt) initialiseModule(void);
 static sqInt loadFFTFrom(sqInt fftOop);
 static sqInt msg(char *s);
 static sqInt permuteData(void);
 EXPORT(sqInt) primitiveFFTPermuteData(void);
+EXPORT(sqInt) primitiveFFTPlanCreate(void);
+EXPORT(sqInt) primitiveFFTPlanDestroy(void);
+EXPORT(sqInt) primitiveFFTPlanRealForward(void);
+EXPORT(sqInt) primitiveFFTPlanRealInverse(void);
+EXPORT(sqInt) primitiveFFTPlanTransform(void);
 EXPORT(sqInt) primitiveFFTScaleData(void);
 EXPORT(sqInt) primitiveFFTTransformData(void);
 static sqInt scaleData(void);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
+EXPORT(sqInt) shutdownModule(void);
 static sqInt transformData(sqInt forward);
 static sqInt transformForward(sqInt forward);
 
@@ -134,6 +142,11 @@ halt(void) {
 	return 0;
 }
 
+EXPORT(sqInt)
+initialiseModule(void) {
+	return 1;
+}
+
 static sqInt
 loadFFTFrom(sqInt fftOop) {
     sqInt oop;
@@ -230,6 +243,161 @@ primitiveFFTPermuteData(void) {
 	}
 }
 
+
+/*	Answer a handle for a plan of the given power of two size. A real plan
+	transforms size samples into size/2+1 frequencies and back; a complex
+	plan transforms size points in place. Fail if the size is not a power of
+	two or all handles are in use. */
+
+EXPORT(sqInt)
+primitiveFFTPlanCreate(void) {
+    sqInt handle;
+    sqInt isReal;
+    sqInt size;
+
+	size = interpreterProxy->stackIntegerValue(1);
+	isReal = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(0));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	handle = fftPlanCreate(size, isReal);
+	interpreterProxy->success(handle >= 0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->popthenPush(3, interpreterProxy->integerObjectOf(handle));
+	return null;
+}
+
+EXPORT(sqInt)
+primitiveFFTPlanDestroy(void) {
+    sqInt handle;
+
+	handle = interpreterProxy->stackIntegerValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(fftPlanDestroy(handle));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->pop(1);
+	return null;
+}
+
+
+/*	Transform the samples of one or more frames of a real plan's size into
+	size/2+1 frequencies per frame, stored in realOut and imagOut */
+
+EXPORT(sqInt)
+primitiveFFTPlanRealForward(void) {
+    sqInt frames;
+    sqInt handle;
+    float * imagOut;
+    sqInt n;
+    float * realOut;
+    float * samples;
+    sqInt samplesSize;
+
+	handle = interpreterProxy->stackIntegerValue(3);
+	samples = checkedFloatPtrOf(interpreterProxy->stackValue(2));
+	realOut = checkedFloatPtrOf(interpreterProxy->stackValue(1));
+	imagOut = checkedFloatPtrOf(interpreterProxy->stackValue(0));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	n = fftPlanSize(handle);
+	interpreterProxy->success((n > 0) && (fftPlanIsReal(handle)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	samplesSize = interpreterProxy->stSizeOf(interpreterProxy->stackValue(2));
+	frames = samplesSize / n;
+	interpreterProxy->success(((frames * n) == samplesSize)
+	 && (((interpreterProxy->stSizeOf(interpreterProxy->stackValue(1))) == (frames * ((n / 2) + 1)))
+	 && ((interpreterProxy->stSizeOf(interpreterProxy->stackValue(0))) == (frames * ((n / 2) + 1)))));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	fftPlanRealForward(handle, samples, realOut, imagOut, frames);
+	interpreterProxy->pop(4);
+	return null;
+}
+
+
+/*	The inverse of primitiveFFTPlanRealForward, including the 1/size scaling */
+
+EXPORT(sqInt)
+primitiveFFTPlanRealInverse(void) {
+    sqInt frames;
+    sqInt handle;
+    float * imagIn;
+    sqInt n;
+    float * realIn;
+    float * samples;
+    sqInt samplesSize;
+
+	handle = interpreterProxy->stackIntegerValue(3);
+	realIn = checkedFloatPtrOf(interpreterProxy->stackValue(2));
+	imagIn = checkedFloatPtrOf(interpreterProxy->stackValue(1));
+	samples = checkedFloatPtrOf(interpreterProxy->stackValue(0));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	n = fftPlanSize(handle);
+	interpreterProxy->success((n > 0) && (fftPlanIsReal(handle)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	samplesSize = interpreterProxy->stSizeOf(interpreterProxy->stackValue(0));
+	frames = samplesSize / n;
+	interpreterProxy->success(((frames * n) == samplesSize)
+	 && (((interpreterProxy->stSizeOf(interpreterProxy->stackValue(2))) == (frames * ((n / 2) + 1)))
+	 && ((interpreterProxy->stSizeOf(interpreterProxy->stackValue(1))) == (frames * ((n / 2) + 1)))));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	fftPlanRealInverse(handle, realIn, imagIn, samples, frames);
+	interpreterProxy->pop(4);
+	return null;
+}
+
+
+/*	Transform in place every frame of a complex plan's size held in realData
+	and imagData, scaling by 1/size when not forward */
+
+EXPORT(sqInt)
+primitiveFFTPlanTransform(void) {
+    sqInt dataSize;
+    sqInt forward;
+    sqInt handle;
+    float * imag;
+    sqInt n;
+    float * real;
+
+	handle = interpreterProxy->stackIntegerValue(3);
+	real = checkedFloatPtrOf(interpreterProxy->stackValue(2));
+	imag = checkedFloatPtrOf(interpreterProxy->stackValue(1));
+	forward = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(0));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	n = fftPlanSize(handle);
+	interpreterProxy->success((n > 0) && (!(fftPlanIsReal(handle))));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	dataSize = interpreterProxy->stSizeOf(interpreterProxy->stackValue(2));
+	interpreterProxy->success(((dataSize % n) == 0)
+	 && (dataSize == (interpreterProxy->stSizeOf(interpreterProxy->stackValue(1)))));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	fftPlanTransform(handle, real, imag, dataSize / n, forward);
+	interpreterProxy->pop(4);
+	return null;
+}
+
 EXPORT(sqInt)
 primitiveFFTScaleData(void) {
     sqInt rcvr;
@@ -355,6 +523,11 @@ setInterpreter(struct VirtualMachine*anInterpreter) {
 	return ok;
 }
 
+EXPORT(sqInt)
+shutdownModule(void) {
+	return fftPlansShutdown();
+}
+
 static sqInt
 transformData(sqInt forward) {
     sqInt fftScale;
@@ -487,10 +660,17 @@ transformForward(sqInt forward) {
 
 void* FFTPlugin_exports[][3] = {
 	{"FFTPlugin", "getModuleName", (void*)getModuleName},
+	{"FFTPlugin", "initialiseModule", (void*)initialiseModule},
 	{"FFTPlugin", "primitiveFFTPermuteData", (void*)primitiveFFTPermuteData},
+	{"FFTPlugin", "primitiveFFTPlanCreate", (void*)primitiveFFTPlanCreate},
+	{"FFTPlugin", "primitiveFFTPlanDestroy", (void*)primitiveFFTPlanDestroy},
+	{"FFTPlugin", "primitiveFFTPlanRealForward", (void*)primitiveFFTPlanRealForward},
+	{"FFTPlugin", "primitiveFFTPlanRealInverse", (void*)primitiveFFTPlanRealInverse},
+	{"FFTPlugin", "primitiveFFTPlanTransform", (void*)primitiveFFTPlanTransform},
 	{"FFTPlugin", "primitiveFFTScaleData", (void*)primitiveFFTScaleData},
 	{"FFTPlugin", "primitiveFFTTransformData", (void*)primitiveFFTTransformData},
 	{"FFTPlugin", "setInterpreter", (void*)setInterpreter},
+	{"FFTPlugin", "shutdownModule", (void*)shutdownModule},
 	{NULL, NULL, NULL}
 };
 
@@ -35,6 +35,7 @@ static char __buildInfo[] = "FloatArrayPlugin VMMaker-eem.666 uuid: 4edd7d00-3db
 #endif
 
 #include "sqMemoryAccess.h"
+#include "FloatArrayPlugin.h"
 
 
 /*** Constants ***/
@@ -47,14 +48,23 @@ static sqInt halt(void);
 static sqInt msg(char *s);
 EXPORT(sqInt) primitiveAddFloatArray(void);
 EXPORT(sqInt) primitiveAddScalar(void);
+EXPORT(sqInt) primitiveAddScaledFloatArray(void);
 EXPORT(sqInt) primitiveAt(void);
 EXPORT(sqInt) primitiveAtPut(void);
+EXPORT(sqInt) primitiveClamp(void);
 EXPORT(sqInt) primitiveDivFloatArray(void);
 EXPORT(sqInt) primitiveDivScalar(void);
 EXPORT(sqInt) primitiveDotProduct(void);
 EXPORT(sqInt) primitiveEqual(void);
+EXPORT(sqInt) primitiveGatherFrom(void);
 EXPORT(sqInt) primitiveHashArray(void);
 EXPORT(sqInt) primitiveLength(void);
+EXPORT(sqInt) primitiveMax(void);
+EXPORT(sqInt) primitiveMaxIndex(void);
+EXPORT(sqInt) primitiveMin(void);
+EXPORT(sqInt) primitiveMinIndex(void);
+EXPORT(sqInt) primitiveMulAddFloatArray(void);
+EXPORT(sqInt) primitiveMulAddScalar(void);
 EXPORT(sqInt) primitiveMulFloatArray(void);
 EXPORT(sqInt) primitiveMulScalar(void);
 EXPORT(sqInt) primitiveNormalize(void);
@@ -119,7 +129,6 @@ EXPORT(sqInt)
 primitiveAddFloatArray(void) {
     sqInt arg;
     float *argPtr;
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -141,9 +150,7 @@ primitiveAddFloatArray(void) {
 	}
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
 	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) + (((double) (argPtr[i]))));
-	}
+	floatArrayAddArray(rcvrPtr, argPtr, length);
 	interpreterProxy->pop(1);
 }
 
@@ -152,7 +159,6 @@ primitiveAddFloatArray(void) {
 
 EXPORT(sqInt)
 primitiveAddScalar(void) {
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -169,12 +175,47 @@ primitiveAddScalar(void) {
 	}
 	length = interpreterProxy->stSizeOf(rcvr);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) + value);
-	}
+	floatArrayAddScalar(rcvrPtr, value, length);
 	interpreterProxy->pop(1);
 }
 
+
+/*	Primitive. Add the first argument, a FloatArray, multiplied by the second
+	argument, a scalar value, to the receiver, a FloatArray (rcvr := rcvr +
+	(x * scale)).
+ */
+
+EXPORT(sqInt)
+primitiveAddScaledFloatArray(void) {
+    sqInt arg;
+    float *argPtr;
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+    double  scale;
+
+	scale = interpreterProxy->stackFloatValue(0);
+	arg = interpreterProxy->stackObjectValue(1);
+	rcvr = interpreterProxy->stackObjectValue(2);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(arg));
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(arg);
+	interpreterProxy->success(length == (interpreterProxy->stSizeOf(rcvr)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
+	floatArrayAxpy(rcvrPtr, scale, argPtr, length);
+	interpreterProxy->pop(2);
+}
+
 EXPORT(sqInt)
 primitiveAt(void) {
     float *floatPtr;
@@ -233,6 +274,36 @@ primitiveAtPut(void) {
 }
 
 
+/*	Primitive. Limit each element of the receiver, a FloatArray, to the range
+	given by the arguments. NaNs are left as they are.
+ */
+
+EXPORT(sqInt)
+primitiveClamp(void) {
+    double  hi;
+    sqInt length;
+    double  lo;
+    sqInt rcvr;
+    float *rcvrPtr;
+
+	hi = interpreterProxy->stackFloatValue(0);
+	lo = interpreterProxy->stackFloatValue(1);
+	rcvr = interpreterProxy->stackObjectValue(2);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	interpreterProxy->success(((float) lo) <= ((float) hi));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	floatArrayClamp(rcvrPtr, ((float) lo), ((float) hi), length);
+	interpreterProxy->pop(2);
+}
+
+
 /*	Primitive. Add the receiver and the argument, both FloatArrays and store
 	the result into the receiver.
  */
@@ -241,7 +312,6 @@ EXPORT(sqInt)
 primitiveDivFloatArray(void) {
     sqInt arg;
     float *argPtr;
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -266,14 +336,10 @@ primitiveDivFloatArray(void) {
 	/* Check if any of the argument's values is zero */
 
 	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		if ((intAtPointer(((char*) (argPtr + i)))) == 0) {
-			return interpreterProxy->primitiveFail();
-		}
-	}
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) / (((double) (argPtr[i]))));
+	if (floatArrayHasZero(argPtr, length)) {
+		return interpreterProxy->primitiveFail();
 	}
+	floatArrayDivArray(rcvrPtr, argPtr, length);
 	interpreterProxy->pop(1);
 }
 
@@ -282,7 +348,6 @@ primitiveDivFloatArray(void) {
 
 EXPORT(sqInt)
 primitiveDivScalar(void) {
-    sqInt i;
     double  inverse;
     sqInt length;
     sqInt rcvr;
@@ -304,9 +369,7 @@ primitiveDivScalar(void) {
 	length = interpreterProxy->stSizeOf(rcvr);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
 	inverse = 1.0 / value;
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) * inverse);
-	}
+	floatArrayMulScalar(rcvrPtr, inverse, length);
 	interpreterProxy->pop(1);
 }
 
@@ -320,7 +383,6 @@ EXPORT(sqInt)
 primitiveDotProduct(void) {
     sqInt arg;
     float *argPtr;
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -343,10 +405,7 @@ primitiveDotProduct(void) {
 	}
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
 	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
-	result = 0.0;
-	for (i = 0; i <= (length - 1); i += 1) {
-		result += (((double) (rcvrPtr[i]))) * (((double) (argPtr[i])));
-	}
+	result = floatArrayDotProduct(rcvrPtr, argPtr, length);
 	interpreterProxy->pop(2);
 	interpreterProxy->pushFloat(result);
 }
@@ -355,7 +414,6 @@ EXPORT(sqInt)
 primitiveEqual(void) {
     sqInt arg;
     float *argPtr;
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -377,17 +435,62 @@ primitiveEqual(void) {
 	}
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
 	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		if (!((rcvrPtr[i]) == (argPtr[i]))) {
-			return interpreterProxy->pushBool(0);
-		}
+	return interpreterProxy->pushBool(floatArrayEqual(rcvrPtr, argPtr, length));
+}
+
+
+/*	Primitive. Fill the receiver, a FloatArray, with every stride-th element
+	of the first argument, a FloatArray, beginning at the index start. The
+	stride may be zero or negative.
+ */
+
+EXPORT(sqInt)
+primitiveGatherFrom(void) {
+    double  last;
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+    sqInt src;
+    float *srcPtr;
+    sqInt srcSize;
+    sqInt start;
+    sqInt stride;
+
+	stride = interpreterProxy->stackIntegerValue(0);
+	start = interpreterProxy->stackIntegerValue(1);
+	src = interpreterProxy->stackObjectValue(2);
+	rcvr = interpreterProxy->stackObjectValue(3);
+	if (interpreterProxy->failed()) {
+		return null;
 	}
-	return interpreterProxy->pushBool(1);
+	interpreterProxy->success(interpreterProxy->isWords(src));
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	srcSize = interpreterProxy->stSizeOf(src);
+	if (length > 0) {
+
+		/* Both ends of the gathered range must lie within src */
+
+		last = (((double) start)) + ((((double) (length - 1))) * stride);
+		interpreterProxy->success((start >= 1)
+		 && ((start <= srcSize)
+		 && ((last >= 1)
+		 && (last <= srcSize))));
+	}
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	srcPtr = ((float *) (interpreterProxy->firstIndexableField(src)));
+	floatArrayGather(rcvrPtr, srcPtr + (start - 1), stride, length);
+	interpreterProxy->pop(3);
 }
 
 EXPORT(sqInt)
 primitiveHashArray(void) {
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     int *rcvrPtr;
@@ -403,10 +506,7 @@ primitiveHashArray(void) {
 	}
 	length = interpreterProxy->stSizeOf(rcvr);
 	rcvrPtr = ((int *) (interpreterProxy->firstIndexableField(rcvr)));
-	result = 0;
-	for (i = 0; i <= (length - 1); i += 1) {
-		result += rcvrPtr[i];
-	}
+	result = floatArrayHashWords(rcvrPtr, length);
 	interpreterProxy->pop(1);
 	return interpreterProxy->pushInteger(result & 536870911);
 }
@@ -418,7 +518,6 @@ primitiveHashArray(void) {
 
 EXPORT(sqInt)
 primitiveLength(void) {
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -435,15 +534,206 @@ primitiveLength(void) {
 	length = interpreterProxy->stSizeOf(rcvr);
 	interpreterProxy->success(1);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
-	result = 0.0;
-	for (i = 0; i <= (length - 1); i += 1) {
-		result += (((double) (rcvrPtr[i]))) * (((double) (rcvrPtr[i])));
-	}
-	result = sqrt(result);
+	result = sqrt(floatArrayDotProduct(rcvrPtr, rcvrPtr, length));
 	interpreterProxy->popthenPush(1, interpreterProxy->floatObjectOf(result));
 }
 
 
+/*	Primitive. Answer the largest element of the receiver, a FloatArray,
+	ignoring NaNs. Fail if the receiver is empty.
+ */
+
+EXPORT(sqInt)
+primitiveMax(void) {
+    sqInt index;
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+
+	rcvr = interpreterProxy->stackObjectValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	interpreterProxy->success(length > 0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	index = floatArrayMaxIndex(rcvrPtr, length);
+	interpreterProxy->popthenPush(1, interpreterProxy->floatObjectOf(((double) (rcvrPtr[index]))));
+}
+
+
+/*	Primitive. Answer the index of the first largest element of the
+	receiver, a FloatArray, ignoring NaNs. Answer 1 if all the elements are
+	NaNs and fail if the receiver is empty.
+ */
+
+EXPORT(sqInt)
+primitiveMaxIndex(void) {
+    sqInt index;
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+
+	rcvr = interpreterProxy->stackObjectValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	interpreterProxy->success(length > 0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	index = floatArrayMaxIndex(rcvrPtr, length);
+	interpreterProxy->pop(1);
+	return interpreterProxy->pushInteger(index + 1);
+}
+
+
+/*	Primitive. Answer the smallest element of the receiver, a FloatArray,
+	ignoring NaNs. Fail if the receiver is empty.
+ */
+
+EXPORT(sqInt)
+primitiveMin(void) {
+    sqInt index;
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+
+	rcvr = interpreterProxy->stackObjectValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	interpreterProxy->success(length > 0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	index = floatArrayMinIndex(rcvrPtr, length);
+	interpreterProxy->popthenPush(1, interpreterProxy->floatObjectOf(((double) (rcvrPtr[index]))));
+}
+
+
+/*	Primitive. Answer the index of the first smallest element of the
+	receiver, a FloatArray, ignoring NaNs. Answer 1 if all the elements are
+	NaNs and fail if the receiver is empty.
+ */
+
+EXPORT(sqInt)
+primitiveMinIndex(void) {
+    sqInt index;
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+
+	rcvr = interpreterProxy->stackObjectValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	interpreterProxy->success(length > 0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	index = floatArrayMinIndex(rcvrPtr, length);
+	interpreterProxy->pop(1);
+	return interpreterProxy->pushInteger(index + 1);
+}
+
+
+/*	Primitive. Add the products of the elements of the arguments, both
+	FloatArrays, to the receiver, a FloatArray (rcvr := rcvr + (x * y)).
+	Each result is rounded once.
+ */
+
+EXPORT(sqInt)
+primitiveMulAddFloatArray(void) {
+    sqInt length;
+    sqInt rcvr;
+    float *rcvrPtr;
+    sqInt x;
+    float *xPtr;
+    sqInt y;
+    float *yPtr;
+
+	y = interpreterProxy->stackObjectValue(0);
+	x = interpreterProxy->stackObjectValue(1);
+	rcvr = interpreterProxy->stackObjectValue(2);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(x));
+	interpreterProxy->success(interpreterProxy->isWords(y));
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	interpreterProxy->success(length == (interpreterProxy->stSizeOf(x)));
+	interpreterProxy->success(length == (interpreterProxy->stSizeOf(y)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	xPtr = ((float *) (interpreterProxy->firstIndexableField(x)));
+	yPtr = ((float *) (interpreterProxy->firstIndexableField(y)));
+	floatArrayMulAdd(rcvrPtr, xPtr, yPtr, length);
+	interpreterProxy->pop(2);
+}
+
+
+/*	Primitive. Multiply the receiver, a FloatArray, by the first argument
+	and add the second argument, both scalar values (rcvr := rcvr * scale
+	+ offset).
+ */
+
+EXPORT(sqInt)
+primitiveMulAddScalar(void) {
+    sqInt length;
+    double  offset;
+    sqInt rcvr;
+    float *rcvrPtr;
+    double  scale;
+
+	offset = interpreterProxy->stackFloatValue(0);
+	scale = interpreterProxy->stackFloatValue(1);
+	rcvr = interpreterProxy->stackObjectValue(2);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isWords(rcvr));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	length = interpreterProxy->stSizeOf(rcvr);
+	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
+	floatArrayScaleAdd(rcvrPtr, scale, offset, length);
+	interpreterProxy->pop(2);
+}
+
+
 /*	Primitive. Add the receiver and the argument, both FloatArrays and store
 	the result into the receiver.
  */
@@ -452,7 +742,6 @@ EXPORT(sqInt)
 primitiveMulFloatArray(void) {
     sqInt arg;
     float *argPtr;
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -474,9 +763,7 @@ primitiveMulFloatArray(void) {
 	}
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
 	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) * (((double) (argPtr[i]))));
-	}
+	floatArrayMulArray(rcvrPtr, argPtr, length);
 	interpreterProxy->pop(1);
 }
 
@@ -485,7 +772,6 @@ primitiveMulFloatArray(void) {
 
 EXPORT(sqInt)
 primitiveMulScalar(void) {
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -502,9 +788,7 @@ primitiveMulScalar(void) {
 	}
 	length = interpreterProxy->stSizeOf(rcvr);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) * value);
-	}
+	floatArrayMulScalar(rcvrPtr, value, length);
 	interpreterProxy->pop(1);
 }
 
@@ -513,7 +797,6 @@ primitiveMulScalar(void) {
 
 EXPORT(sqInt)
 primitiveNormalize(void) {
-    sqInt i;
     double  len;
     sqInt length;
     sqInt rcvr;
@@ -530,18 +813,13 @@ primitiveNormalize(void) {
 	length = interpreterProxy->stSizeOf(rcvr);
 	interpreterProxy->success(1);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
-	len = 0.0;
-	for (i = 0; i <= (length - 1); i += 1) {
-		len += (((double) (rcvrPtr[i]))) * (((double) (rcvrPtr[i])));
-	}
+	len = floatArrayDotProduct(rcvrPtr, rcvrPtr, length);
 	interpreterProxy->success(len > 0.0);
 	if (interpreterProxy->failed()) {
 		return null;
 	}
 	len = sqrt(len);
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) / len);
-	}
+	floatArrayDivScalar(rcvrPtr, len, length);
 }
 
 
@@ -553,7 +831,6 @@ EXPORT(sqInt)
 primitiveSubFloatArray(void) {
     sqInt arg;
     float *argPtr;
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -575,9 +852,7 @@ primitiveSubFloatArray(void) {
 	}
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
 	argPtr = ((float *) (interpreterProxy->firstIndexableField(arg)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) - (((double) (argPtr[i]))));
-	}
+	floatArraySubArray(rcvrPtr, argPtr, length);
 	interpreterProxy->pop(1);
 }
 
@@ -586,7 +861,6 @@ primitiveSubFloatArray(void) {
 
 EXPORT(sqInt)
 primitiveSubScalar(void) {
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -603,9 +877,7 @@ primitiveSubScalar(void) {
 	}
 	length = interpreterProxy->stSizeOf(rcvr);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
-	for (i = 0; i <= (length - 1); i += 1) {
-		rcvrPtr[i] = ((((double) (rcvrPtr[i]))) - value);
-	}
+	floatArrayAddScalar(rcvrPtr, 0.0 - value, length);
 	interpreterProxy->pop(1);
 }
 
@@ -616,7 +888,6 @@ primitiveSubScalar(void) {
 
 EXPORT(sqInt)
 primitiveSum(void) {
-    sqInt i;
     sqInt length;
     sqInt rcvr;
     float *rcvrPtr;
@@ -632,10 +903,7 @@ primitiveSum(void) {
 	}
 	length = interpreterProxy->stSizeOf(rcvr);
 	rcvrPtr = ((float *) (interpreterProxy->firstIndexableField(rcvr)));
-	sum = 0.0;
-	for (i = 0; i <= (length - 1); i += 1) {
-		sum += ((double) (rcvrPtr[i]));
-	}
+	sum = floatArraySum(rcvrPtr, length);
 	interpreterProxy->popthenPush(1, interpreterProxy->floatObjectOf(sum));
 }
 
@@ -662,14 +930,23 @@ void* FloatArrayPlugin_exports[][3] = {
 	{"FloatArrayPlugin", "getModuleName", (void*)getModuleName},
 	{"FloatArrayPlugin", "primitiveAddFloatArray", (void*)primitiveAddFloatArray},
 	{"FloatArrayPlugin", "primitiveAddScalar", (void*)primitiveAddScalar},
+	{"FloatArrayPlugin", "primitiveAddScaledFloatArray", (void*)primitiveAddScaledFloatArray},
 	{"FloatArrayPlugin", "primitiveAt", (void*)primitiveAt},
 	{"FloatArrayPlugin", "primitiveAtPut", (void*)primitiveAtPut},
+	{"FloatArrayPlugin", "primitiveClamp", (void*)primitiveClamp},
 	{"FloatArrayPlugin", "primitiveDivFloatArray", (void*)primitiveDivFloatArray},
 	{"FloatArrayPlugin", "primitiveDivScalar", (void*)primitiveDivScalar},
 	{"FloatArrayPlugin", "primitiveDotProduct", (void*)primitiveDotProduct},
 	{"FloatArrayPlugin", "primitiveEqual", (void*)primitiveEqual},
+	{"FloatArrayPlugin", "primitiveGatherFrom", (void*)primitiveGatherFrom},
 	{"FloatArrayPlugin", "primitiveHashArray", (void*)primitiveHashArray},
 	{"FloatArrayPlugin", "primitiveLength", (void*)primitiveLength},
+	{"FloatArrayPlugin", "primitiveMax", (void*)primitiveMax},
+	{"FloatArrayPlugin", "primitiveMaxIndex", (void*)primitiveMaxIndex},
+	{"FloatArrayPlugin", "primitiveMin", (void*)primitiveMin},
+	{"FloatArrayPlugin", "primitiveMinIndex", (void*)primitiveMinIndex},
+	{"FloatArrayPlugin", "primitiveMulAddFloatArray", (void*)primitiveMulAddFloatArray},
+	{"FloatArrayPlugin", "primitiveMulAddScalar", (void*)primitiveMulAddScalar},
 	{"FloatArrayPlugin", "primitiveMulFloatArray", (void*)primitiveMulFloatArray},
 	{"FloatArrayPlugin", "primitiveMulScalar", (void*)primitiveMulScalar},
 	{"FloatArrayPlugin", "primitiveNormalize", (void*)primitiveNormalize},
@@ -39,9 +39,11 @@ static char __buildInfo[] = "JPEGReadWriter2Plugin VMMaker-eem.666 uuid: 4edd7d0
 
 
 /*** Constants ***/
+#define PrimErrBadArgument 3
 
 
 /*** Function Prototypes ***/
+static unsigned * formBitsOf(sqInt form);
 static VirtualMachine * getInterpreter(void);
 EXPORT(const char*) getModuleName(void);
 static sqInt halt(void);
@@ -50,11 +52,17 @@ static sqInt msg(char *s);
 EXPORT(sqInt) primImageHeight(void);
 EXPORT(sqInt) primImageWidth(void);
 EXPORT(sqInt) primJPEGCompressStructSize(void);
+EXPORT(sqInt) primJPEGDecodeStatus(void);
 EXPORT(sqInt) primJPEGDecompressStructSize(void);
 EXPORT(sqInt) primJPEGErrorMgr2StructSize(void);
+EXPORT(sqInt) primJPEGFinishDecodeonFormdoDithering(void);
 EXPORT(sqInt) primJPEGPluginIsPresent(void);
 EXPORT(sqInt) primJPEGReadHeaderfromByteArrayerrorMgr(void);
 EXPORT(sqInt) primJPEGReadImagefromByteArrayonFormdoDitheringerrorMgr(void);
+EXPORT(sqInt) primJPEGReadScaledonFormscalexydoDithering(void);
+EXPORT(sqInt) primJPEGReleaseDecode(void);
+EXPORT(sqInt) primJPEGScaledExtentscale(void);
+EXPORT(sqInt) primJPEGStartDecodescalexywidthheightsemaphore(void);
 EXPORT(sqInt) primJPEGWriteImageonByteArrayformqualityprogressiveJPEGerrorMgr(void);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
 EXPORT(sqInt) shutdownModule(void);
@@ -77,6 +85,45 @@ static const char *moduleName =
 
 
 
+
+/*	Answer the bits of a 32 or 16 bit Form, after checking that they match
+	its extent, or fail. */
+
+static unsigned *
+formBitsOf(sqInt form) {
+	sqInt formBits;
+	sqInt formWidth;
+	sqInt formHeight;
+	sqInt formDepth;
+	sqInt pixPerWord;
+
+	interpreterProxy->success((interpreterProxy->isPointers(form))
+	 && ((interpreterProxy->slotSizeOf(form)) >= 4));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	formBits = interpreterProxy->fetchPointerofObject(0, form);
+	formWidth = interpreterProxy->fetchIntegerofObject(1, form);
+	formHeight = interpreterProxy->fetchIntegerofObject(2, form);
+	formDepth = interpreterProxy->fetchIntegerofObject(3, form);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(((formDepth == 32) || (formDepth == 16))
+	 && ((formWidth >= 0) && (formHeight >= 0)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	pixPerWord = 32 / formDepth;
+	interpreterProxy->success((interpreterProxy->isWords(formBits))
+	 && ((interpreterProxy->byteSizeOf(formBits)) == ((((formWidth + (pixPerWord - 1)) / pixPerWord) * 4) * formHeight)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	return ((unsigned *) (interpreterProxy->firstIndexableField(formBits)));
+}
+
+
 /*	Note: This is coded so that plugins can be run from Squeak. */
 
 static VirtualMachine *
@@ -103,7 +150,7 @@ halt(void) {
 
 EXPORT(sqInt)
 initialiseModule(void) {
-	return 1;
+	return jpegDecodeInit();
 }
 
 static sqInt
@@ -170,6 +217,26 @@ primJPEGCompressStructSize(void) {
 	return null;
 }
 
+
+/*	Answer -1 while the decode is running, -2 if it failed, 0 when it is done */
+
+EXPORT(sqInt)
+primJPEGDecodeStatus(void) {
+	sqInt handle;
+	sqInt _return_value;
+
+	handle = interpreterProxy->stackIntegerValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	_return_value = interpreterProxy->integerObjectOf((jpegDecodeStatus(handle)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->popthenPush(2, _return_value);
+	return null;
+}
+
 EXPORT(sqInt)
 primJPEGDecompressStructSize(void) {
 	sqInt _return_value;
@@ -194,6 +261,39 @@ primJPEGErrorMgr2StructSize(void) {
 	return null;
 }
 
+
+/*	Store a finished decode into form, which must have the extent of the
+	decoded region, and release the handle */
+
+EXPORT(sqInt)
+primJPEGFinishDecodeonFormdoDithering(void) {
+	unsigned *  formBits;
+	sqInt handle;
+	sqInt form;
+	sqInt ditherFlag;
+
+	handle = interpreterProxy->stackIntegerValue(2);
+	form = interpreterProxy->stackValue(1);
+	ditherFlag = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(0));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	formBits = formBitsOf(form);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(jpegDecodeResult(handle, formBits,
+		interpreterProxy->fetchIntegerofObject(1, form),
+		interpreterProxy->fetchIntegerofObject(2, form),
+		interpreterProxy->fetchIntegerofObject(3, form),
+		ditherFlag));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->pop(3);
+	return null;
+}
+
 EXPORT(sqInt)
 primJPEGPluginIsPresent(void) {
 	sqInt _return_value;
@@ -508,6 +608,146 @@ primJPEGReadImagefromByteArrayonFormdoDitheringerrorMgr(void) {
 	return null;
 }
 
+
+/*	Decode the region of the image in source, scaled by 1/scale (1, 2, 4 or
+	8), that starts at x@y in scaled pixels and has the extent of form */
+
+EXPORT(sqInt)
+primJPEGReadScaledonFormscalexydoDithering(void) {
+	unsigned *  formBits;
+	char *source;
+	sqInt form;
+	sqInt scale;
+	sqInt x;
+	sqInt y;
+	sqInt ditherFlag;
+
+	interpreterProxy->success(interpreterProxy->isBytes(interpreterProxy->stackValue(5)));
+	source = ((char *) (interpreterProxy->firstIndexableField(interpreterProxy->stackValue(5))));
+	form = interpreterProxy->stackValue(4);
+	scale = interpreterProxy->stackIntegerValue(3);
+	x = interpreterProxy->stackIntegerValue(2);
+	y = interpreterProxy->stackIntegerValue(1);
+	ditherFlag = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(0));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!(jpegValidScale(scale))) {
+		return interpreterProxy->primitiveFailFor(PrimErrBadArgument);
+	}
+	formBits = formBitsOf(form);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(jpegDecodeScaled(source, interpreterProxy->stSizeOf(interpreterProxy->stackValue(5)),
+		scale, x, y, formBits,
+		interpreterProxy->fetchIntegerofObject(1, form),
+		interpreterProxy->fetchIntegerofObject(2, form),
+		interpreterProxy->fetchIntegerofObject(3, form),
+		ditherFlag));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->pop(6);
+	return null;
+}
+
+
+/*	Release a decode handle, abandoning the decode if it has not finished */
+
+EXPORT(sqInt)
+primJPEGReleaseDecode(void) {
+	sqInt handle;
+
+	handle = interpreterProxy->stackIntegerValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(jpegDecodeRelease(handle));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->pop(1);
+	return null;
+}
+
+
+/*	Answer the extent of the image in source scaled by 1/scale, where scale
+	is 1, 2, 4 or 8, as a Point */
+
+EXPORT(sqInt)
+primJPEGScaledExtentscale(void) {
+	int width;
+	int height;
+	char *source;
+	sqInt scale;
+	sqInt _return_value;
+
+	interpreterProxy->success(interpreterProxy->isBytes(interpreterProxy->stackValue(1)));
+	source = ((char *) (interpreterProxy->firstIndexableField(interpreterProxy->stackValue(1))));
+	scale = interpreterProxy->stackIntegerValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!(jpegValidScale(scale))) {
+		return interpreterProxy->primitiveFailFor(PrimErrBadArgument);
+	}
+	width = 0;
+	height = 0;
+	interpreterProxy->success(jpegScaledExtent(source, interpreterProxy->stSizeOf(interpreterProxy->stackValue(1)), scale, &width, &height));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	_return_value = interpreterProxy->makePointwithxValueyValue(width, height);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->popthenPush(3, _return_value);
+	return null;
+}
+
+
+/*	Queue the decode of a width by height region of the image in source,
+	scaled by 1/scale, on the worker threads. Answer a handle; the semaphore
+	at semaIndex is signalled when the decode has finished. */
+
+EXPORT(sqInt)
+primJPEGStartDecodescalexywidthheightsemaphore(void) {
+	sqInt handle;
+	char *source;
+	sqInt scale;
+	sqInt x;
+	sqInt y;
+	sqInt width;
+	sqInt height;
+	sqInt semaIndex;
+	sqInt _return_value;
+
+	interpreterProxy->success(interpreterProxy->isBytes(interpreterProxy->stackValue(6)));
+	source = ((char *) (interpreterProxy->firstIndexableField(interpreterProxy->stackValue(6))));
+	scale = interpreterProxy->stackIntegerValue(5);
+	x = interpreterProxy->stackIntegerValue(4);
+	y = interpreterProxy->stackIntegerValue(3);
+	width = interpreterProxy->stackIntegerValue(2);
+	height = interpreterProxy->stackIntegerValue(1);
+	semaIndex = interpreterProxy->stackIntegerValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!(jpegValidScale(scale))) {
+		return interpreterProxy->primitiveFailFor(PrimErrBadArgument);
+	}
+	handle = jpegDecodeStart(source, interpreterProxy->stSizeOf(interpreterProxy->stackValue(6)),
+		scale, x, y, width, height, semaIndex);
+	interpreterProxy->success(handle >= 0);
+	_return_value = interpreterProxy->integerObjectOf(handle);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->popthenPush(8, _return_value);
+	return null;
+}
+
 EXPORT(sqInt)
 primJPEGWriteImageonByteArrayformqualityprogressiveJPEGerrorMgr(void) {
 	sqInt formWidth;
@@ -681,7 +921,7 @@ setInterpreter(struct VirtualMachine*anInterpreter) {
 
 EXPORT(sqInt)
 shutdownModule(void) {
-	return 1;
+	return jpegDecodeShutdown();
 }
 
 static void
@@ -698,11 +938,17 @@ void* JPEGReadWriter2Plugin_exports[][3] = {
 	{"JPEGReadWriter2Plugin", "primImageHeight", (void*)primImageHeight},
 	{"JPEGReadWriter2Plugin", "primImageWidth", (void*)primImageWidth},
 	{"JPEGReadWriter2Plugin", "primJPEGCompressStructSize", (void*)primJPEGCompressStructSize},
+	{"JPEGReadWriter2Plugin", "primJPEGDecodeStatus", (void*)primJPEGDecodeStatus},
 	{"JPEGReadWriter2Plugin", "primJPEGDecompressStructSize", (void*)primJPEGDecompressStructSize},
 	{"JPEGReadWriter2Plugin", "primJPEGErrorMgr2StructSize", (void*)primJPEGErrorMgr2StructSize},
+	{"JPEGReadWriter2Plugin", "primJPEGFinishDecodeonFormdoDithering", (void*)primJPEGFinishDecodeonFormdoDithering},
 	{"JPEGReadWriter2Plugin", "primJPEGPluginIsPresent", (void*)primJPEGPluginIsPresent},
 	{"JPEGReadWriter2Plugin", "primJPEGReadHeaderfromByteArrayerrorMgr", (void*)primJPEGReadHeaderfromByteArrayerrorMgr},
 	{"JPEGReadWriter2Plugin", "primJPEGReadImagefromByteArrayonFormdoDitheringerrorMgr", (void*)primJPEGReadImagefromByteArrayonFormdoDitheringerrorMgr},
+	{"JPEGReadWriter2Plugin", "primJPEGReadScaledonFormscalexydoDithering", (void*)primJPEGReadScaledonFormscalexydoDithering},
+	{"JPEGReadWriter2Plugin", "primJPEGReleaseDecode", (void*)primJPEGReleaseDecode},
+	{"JPEGReadWriter2Plugin", "primJPEGScaledExtentscale", (void*)primJPEGScaledExtentscale},
+	{"JPEGReadWriter2Plugin", "primJPEGStartDecodescalexywidthheightsemaphore", (void*)primJPEGStartDecodescalexywidthheightsemaphore},
 	{"JPEGReadWriter2Plugin", "primJPEGWriteImageonByteArrayformqualityprogressiveJPEGerrorMgr", (void*)primJPEGWriteImageonByteArrayformqualityprogressiveJPEGerrorMgr},
 	{"JPEGReadWriter2Plugin", "setInterpreter", (void*)setInterpreter},
 	{"JPEGReadWriter2Plugin", "shutdownModule", (void*)shutdownModule},
@@ -35,6 +35,7 @@ static char __buildInfo[] = "JPEGReaderPlugin VMMaker-eem.666 uuid: 4edd7d00-3db
 #endif
 
 #include "sqMemoryAccess.h"
+#include "JPEGReaderPlugin.h"
 
 
 /*** Constants ***/
@@ -101,8 +102,10 @@ static sqInt nextSampleFromblocks(int *aComponent, int **aBlockArray);
 static sqInt nextSampleY(void);
 EXPORT(sqInt) primitiveColorConvertGrayscaleMCU(void);
 EXPORT(sqInt) primitiveColorConvertMCU(void);
+EXPORT(sqInt) primitiveDecodeImageInto(void);
 EXPORT(sqInt) primitiveDecodeMCU(void);
 EXPORT(sqInt) primitiveIdctInt(void);
+EXPORT(sqInt) primitiveImageInfo(void);
 static sqInt scaleAndSignExtendinFieldWidth(sqInt aNumber, sqInt w);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
 static sqInt stInit(void);
@@ -598,7 +601,7 @@ idctBlockIntqt(int *anArray, int *qt) {
 			}
 		}
 		if (anACTerm == -1) {
-			dcval = ((usqInt) ((anArray[i]) * (qt[0])) << 2);
+			dcval = ((usqInt) ((anArray[i]) * (qt[i])) << 2);
 			for (j = 0; j <= (DCTSize - 1); j += 1) {
 				ws[(j * DCTSize) + i] = dcval;
 			}
@@ -1227,6 +1230,63 @@ primitiveColorConvertMCU(void) {
 }
 
 
+/*	Decode a whole JPEG into a 32 bit Form, on up to the given number of
+	threads. Fails for the images that primitiveImageInfo fails for, and
+	if the Form is not 32 bits deep.
+	Requires:
+	ByteArray (the JPEG data)
+	Form
+	Integer (threads)
+	 */
+
+EXPORT(sqInt)
+primitiveDecodeImageInto(void) {
+    sqInt bitsOop;
+    sqInt dataOop;
+    sqInt depth;
+    sqInt formOop;
+    sqInt height;
+    sqInt threads;
+    sqInt width;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 3)) {
+		return interpreterProxy->primitiveFail();
+	}
+	threads = interpreterProxy->stackIntegerValue(0);
+	formOop = interpreterProxy->stackObjectValue(1);
+	dataOop = interpreterProxy->stackObjectValue(2);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isBytes(dataOop))
+		 && ((interpreterProxy->isPointers(formOop))
+		 && ((interpreterProxy->slotSizeOf(formOop)) >= 4)))) {
+		return interpreterProxy->primitiveFail();
+	}
+	bitsOop = interpreterProxy->fetchPointerofObject(0, formOop);
+	width = interpreterProxy->fetchIntegerofObject(1, formOop);
+	height = interpreterProxy->fetchIntegerofObject(2, formOop);
+	depth = interpreterProxy->fetchIntegerofObject(3, formOop);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!(((depth == 32) || (depth == -32))
+		 && ((width >= 0)
+		 && ((height >= 0)
+		 && (interpreterProxy->isWords(bitsOop)))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if ((height > 0)
+	 && (width > ((interpreterProxy->slotSizeOf(bitsOop)) / height))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if (!(jpegDecodeImage(interpreterProxy->firstIndexableField(dataOop), interpreterProxy->byteSizeOf(dataOop), interpreterProxy->firstIndexableField(bitsOop), width, height, threads))) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(3);
+}
+
+
 /*	In:
 	anArray WordArray of: DCTSize2
 	aColorComponent JPEGColorComponent
@@ -1411,6 +1471,43 @@ primitiveIdctInt(void) {
 	interpreterProxy->pop(2);
 }
 
+
+/*	Answer an Array with the width, height and number of components of
+	a JPEG that primitiveDecodeImageInto can decode. Fails for
+	progressive, arithmetic coded, CMYK and multi-scan images, which are
+	left to the Smalltalk decoder.
+	Requires:
+	ByteArray (the JPEG data)
+	 */
+
+EXPORT(sqInt)
+primitiveImageInfo(void) {
+    int components;
+    sqInt dataOop;
+    int height;
+    sqInt resultOop;
+    int width;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	dataOop = interpreterProxy->stackObjectValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!(interpreterProxy->isBytes(dataOop))) {
+		return interpreterProxy->primitiveFail();
+	}
+	if (!(jpegImageInfo(interpreterProxy->firstIndexableField(dataOop), interpreterProxy->byteSizeOf(dataOop), &width, &height, &components))) {
+		return interpreterProxy->primitiveFail();
+	}
+	resultOop = interpreterProxy->instantiateClassindexableSize(interpreterProxy->classArray(), 3);
+	interpreterProxy->storeIntegerofObjectwithValue(0, resultOop, width);
+	interpreterProxy->storeIntegerofObjectwithValue(1, resultOop, height);
+	interpreterProxy->storeIntegerofObjectwithValue(2, resultOop, components);
+	interpreterProxy->popthenPush(2, resultOop);
+}
+
 static sqInt
 scaleAndSignExtendinFieldWidth(sqInt aNumber, sqInt w) {
 	if (aNumber < ((((w - 1) < 0) ? ((usqInt) 1 >> -(w - 1)) : ((usqInt) 1 << (w - 1))))) {
@@ -1462,8 +1559,10 @@ void* JPEGReaderPlugin_exports[][3] = {
 	{"JPEGReaderPlugin", "getModuleName", (void*)getModuleName},
 	{"JPEGReaderPlugin", "primitiveColorConvertGrayscaleMCU", (void*)primitiveColorConvertGrayscaleMCU},
 	{"JPEGReaderPlugin", "primitiveColorConvertMCU", (void*)primitiveColorConvertMCU},
+	{"JPEGReaderPlugin", "primitiveDecodeImageInto", (void*)primitiveDecodeImageInto},
 	{"JPEGReaderPlugin", "primitiveDecodeMCU", (void*)primitiveDecodeMCU},
 	{"JPEGReaderPlugin", "primitiveIdctInt", (void*)primitiveIdctInt},
+	{"JPEGReaderPlugin", "primitiveImageInfo", (void*)primitiveImageInfo},
 	{"JPEGReaderPlugin", "setInterpreter", (void*)setInterpreter},
 	{NULL, NULL, NULL}
 };
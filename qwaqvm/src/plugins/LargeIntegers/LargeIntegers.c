@@ -33,6 +33,7 @@ static char __buildInfo[] = "LargeIntegersPlugin VMMaker-eem.666 uuid: 4edd7d00-
 // was #undef EXPORT(returnType) but screws NorCroft cc
 #define EXPORT(returnType) static returnType
 #endif
+#include "LargeIntegers.h"
 
 #include "sqMemoryAccess.h"
 
@@ -66,6 +67,7 @@ static sqInt createLargeFromSmallInteger(sqInt anOop);
 static sqInt digitAddLargewith(sqInt firstInteger, sqInt secondInteger);
 static sqInt digitBitLogicwithopIndex(sqInt firstInteger, sqInt secondInteger, sqInt opIx);
 static sqInt digitCompareLargewith(sqInt firstInteger, sqInt secondInteger);
+static sqInt digitDivLargeLimbswithnegative(sqInt firstInteger, sqInt secondInteger, sqInt neg);
 static sqInt digitDivLargewithnegative(sqInt firstInteger, sqInt secondInteger, sqInt neg);
 static sqInt digitLength(sqInt oop);
 static sqInt digitMultiplyLargewithnegative(sqInt firstInteger, sqInt secondInteger, sqInt neg);
@@ -799,6 +801,10 @@ cDigitMultiplylenwithleninto(unsigned char *  pByteShort, sqInt shortLen, unsign
 	sqInt k;
 	sqInt limitShort;
 
+	if ((shortLen >= LI_MULTIPLY_THRESHOLD)
+	 && (liMultiply(pByteShort, shortLen, pByteLong, longLen, pByteRes))) {
+		return 0;
+	}
 	if ((shortLen == 1)
 	 && ((pByteShort[0]) == 0)) {
 		return 0;
@@ -1165,6 +1171,73 @@ digitCompareLargewith(sqInt firstInteger, sqInt secondInteger) {
 }
 
 
+/*	Like digitDiv:neg: but dividing 32-bit limbs. Both arguments must be 
+	normalized LargeIntegers with firstLen >= secondLen. Answer null if the 
+	scratch memory could not be allocated; the quotient and remainder have 
+	been allocated by then, so the caller must remap its arguments. */
+
+static sqInt
+digitDivLargeLimbswithnegative(sqInt firstInteger, sqInt secondInteger, sqInt neg) {
+	sqInt resultClass;
+	sqInt remClass;
+	sqInt result;
+	sqInt rem;
+	sqInt quo;
+	sqInt trimmed;
+	sqInt firstLen;
+	sqInt secondLen;
+	sqInt remLen;
+	unsigned char *  pRem;
+
+	firstLen = interpreterProxy->slotSizeOf(firstInteger);
+	secondLen = interpreterProxy->slotSizeOf(secondInteger);
+	if (neg) {
+		resultClass = interpreterProxy->classLargeNegativeInteger();
+	}
+	else {
+		resultClass = interpreterProxy->classLargePositiveInteger();
+	}
+	remClass = interpreterProxy->fetchClassOf(firstInteger);
+	interpreterProxy->pushRemappableOop(firstInteger);
+	interpreterProxy->pushRemappableOop(secondInteger);
+	quo = interpreterProxy->instantiateClassindexableSize(resultClass, (firstLen - secondLen) + 1);
+	interpreterProxy->pushRemappableOop(quo);
+	rem = interpreterProxy->instantiateClassindexableSize(remClass, secondLen);
+	quo = interpreterProxy->popRemappableOop();
+	secondInteger = interpreterProxy->popRemappableOop();
+	firstInteger = interpreterProxy->popRemappableOop();
+	if (!(liDivide(interpreterProxy->firstIndexableField(firstInteger), firstLen, interpreterProxy->firstIndexableField(secondInteger), secondLen, interpreterProxy->firstIndexableField(quo), interpreterProxy->firstIndexableField(rem)))) {
+		return null;
+	}
+
+	/* Answer the remainder without leading zero bytes, as bytesRshift:bytes:lookfirst: does */
+
+	pRem = interpreterProxy->firstIndexableField(rem);
+	remLen = secondLen;
+	while ((remLen > 1)
+	 && ((pRem[remLen - 1]) == 0)) {
+		remLen -= 1;
+	}
+	if (remLen < secondLen) {
+		interpreterProxy->pushRemappableOop(quo);
+		interpreterProxy->pushRemappableOop(rem);
+		trimmed = interpreterProxy->instantiateClassindexableSize(remClass, remLen);
+		rem = interpreterProxy->popRemappableOop();
+		quo = interpreterProxy->popRemappableOop();
+		cBytesCopyFromtolen(interpreterProxy->firstIndexableField(rem), interpreterProxy->firstIndexableField(trimmed), remLen);
+		rem = trimmed;
+	}
+	interpreterProxy->pushRemappableOop(quo);
+	interpreterProxy->pushRemappableOop(rem);
+	result = interpreterProxy->instantiateClassindexableSize(interpreterProxy->classArray(), 2);
+	rem = interpreterProxy->popRemappableOop();
+	quo = interpreterProxy->popRemappableOop();
+	interpreterProxy->stObjectatput(result,1,quo);
+	interpreterProxy->stObjectatput(result,2,rem);
+	return result;
+}
+
+
 /*	Does not normalize. */
 /*	Division by zero has to be checked in caller. */
 
@@ -1220,6 +1293,18 @@ digitDivLargewithnegative(sqInt firstInteger, sqInt secondInteger, sqInt neg) {
 		interpreterProxy->stObjectatput(result,2,firstInteger);
 		return result;
 	}
+	if ((firstLen >= LI_DIVIDE_THRESHOLD)
+	 && (((interpreterProxy->stObjectat(firstInteger, firstLen)) >> 1) != 0)
+	 && (((interpreterProxy->stObjectat(secondInteger, secondLen)) >> 1) != 0)) {
+		interpreterProxy->pushRemappableOop(firstInteger);
+		interpreterProxy->pushRemappableOop(secondInteger);
+		result = digitDivLargeLimbswithnegative(firstInteger, secondInteger, neg);
+		secondInteger = interpreterProxy->popRemappableOop();
+		firstInteger = interpreterProxy->popRemappableOop();
+		if (result != null) {
+			return result;
+		}
+	}
 	d = 8 - (cHighBit(((interpreterProxy->stObjectat(secondInteger, secondLen)) >> 1)));
 	interpreterProxy->pushRemappableOop(firstInteger);
 	div = bytesLshift(secondInteger, d);
@@ -1510,6 +1595,10 @@ digitMultiplyLargewithnegative(sqInt firstInteger, sqInt secondInteger, sqInt ne
 	pByteShort = interpreterProxy->firstIndexableField(shortInt);
 	pByteLong = interpreterProxy->firstIndexableField(longInt);
 	pByteRes = interpreterProxy->firstIndexableField(prod);
+	if ((shortLen >= LI_MULTIPLY_THRESHOLD)
+	 && (liMultiply(pByteShort, shortLen, pByteLong, longLen, pByteRes))) {
+		goto l1;
+	}
 	if ((shortLen == 1)
 	 && ((pByteShort[0]) == 0)) {
 		goto l1;
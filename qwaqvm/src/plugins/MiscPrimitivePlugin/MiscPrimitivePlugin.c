@@ -35,6 +35,7 @@ static char __buildInfo[] = "MiscPrimitivePlugin VMMaker-eem.584 uuid: 1dab8071-
 #endif
 
 #include "sqMemoryAccess.h"
+#include "MiscPrimitivePlugin.h"
 
 
 
@@ -177,13 +178,11 @@ msg(char *s) {
 
 EXPORT(sqInt)
 primitiveCompareString(void) {
-    sqInt c1;
-    sqInt c2;
-    sqInt i;
     sqInt len1;
     sqInt len2;
     unsigned char *order;
     sqInt rcvr;
+    sqInt result;
     unsigned char *string1;
     unsigned char *string2;
 
@@ -199,52 +198,13 @@ primitiveCompareString(void) {
 	}
 	len1 = sizeOfSTArrayFromCPrimitive(string1 + 1);
 	len2 = sizeOfSTArrayFromCPrimitive(string2 + 1);
-	for (i = 1; i <= (((len1 < len2) ? len1 : len2)); i += 1) {
-		c1 = order[(string1[i]) + 1];
-		c2 = order[(string2[i]) + 1];
-		if (!(c1 == c2)) {
-			if (c1 < c2) {
-				if (!(successFlag)) {
-					return null;
-				}
-				pop(4);
-				pushInteger(1);
-				return null;
-			}
-			else {
-				if (!(successFlag)) {
-					return null;
-				}
-				pop(4);
-				pushInteger(3);
-				return null;
-			}
-		}
-	}
-	if (len1 == len2) {
-		if (!(successFlag)) {
-			return null;
-		}
-		pop(4);
-		pushInteger(2);
-		return null;
-	}
-	if (len1 < len2) {
-		if (!(successFlag)) {
-			return null;
-		}
-		pop(4);
-		pushInteger(1);
-		return null;
-	}
-	else {
-		if (!(successFlag)) {
-			return null;
-		}
-		pop(4);
-		pushInteger(3);
+	result = miscCompareStrings(string1 + 1, len1, string2 + 1, len2, order + 1);
+	if (!(successFlag)) {
 		return null;
 	}
+	pop(4);
+	pushInteger(result);
+	return null;
 }
 
 
@@ -641,13 +601,14 @@ primitiveFindFirstInString(void) {
 		pushInteger(0);
 		return null;
 	}
-	i = start;
-	stringSize = sizeOfSTArrayFromCPrimitive(aString + 1);
-	while ((i <= stringSize)
- && ((inclusionMap[(asciiValue(aString[i])) + 1]) == 0)) {
-		i += 1;
+	if (start < 1) {
+		start = 1;
 	}
-	if (i > stringSize) {
+	stringSize = sizeOfSTArrayFromCPrimitive(aString + 1);
+	i = (start > stringSize
+		? -1
+		: miscIndexOfByteInMap(aString + start, stringSize - start + 1, inclusionMap + 1));
+	if (i < 0) {
 		if (!(successFlag)) {
 			return null;
 		}
@@ -659,7 +620,7 @@ primitiveFindFirstInString(void) {
 		return null;
 	}
 	pop(4);
-	pushInteger(i);
+	pushInteger(start + i);
 	return null;
 }
 
@@ -669,8 +630,8 @@ primitiveFindFirstInString(void) {
 	which can be used to effect, eg, case-insensitive matches. If no match is
 	found, zero will be returned.
 	
-	The algorithm below is not optimum -- it is intended to be translated to C
-	which will go so fast that it wont matter.
+	Positions before 1 are not searched. Fail if matchTable has fewer than 256
+	entries.
  */
 
 EXPORT(sqInt)
@@ -681,7 +642,6 @@ primitiveFindSubstring(void) {
     unsigned char *matchTable;
     sqInt rcvr;
     sqInt start;
-    sqInt startIndex;
 
 	rcvr = stackValue(4);
 	key = arrayValueOf(stackValue(3));
@@ -694,6 +654,10 @@ primitiveFindSubstring(void) {
 	if (!(successFlag)) {
 		return null;
 	}
+	if ((sizeOfSTArrayFromCPrimitive(matchTable + 1)) < 256) {
+		primitiveFail();
+		return null;
+	}
 	if ((sizeOfSTArrayFromCPrimitive(key + 1)) == 0) {
 		if (!(successFlag)) {
 			return null;
@@ -702,25 +666,15 @@ primitiveFindSubstring(void) {
 		pushInteger(0);
 		return null;
 	}
-	for (startIndex = start; startIndex <= (((sizeOfSTArrayFromCPrimitive(body + 1)) - (sizeOfSTArrayFromCPrimitive(key + 1))) + 1); startIndex += 1) {
-		index = 1;
-		while ((matchTable[(asciiValue(body[(startIndex + index) - 1])) + 1]) == (matchTable[(asciiValue(key[index])) + 1])) {
-			if (index == (sizeOfSTArrayFromCPrimitive(key + 1))) {
-				if (!(successFlag)) {
-					return null;
-				}
-				pop(5);
-				pushInteger(startIndex);
-				return null;
-			}
-			index += 1;
-		}
+	if (start < 1) {
+		start = 1;
 	}
+	index = miscFindSubstring(key + 1, sizeOfSTArrayFromCPrimitive(key + 1), body + 1, sizeOfSTArrayFromCPrimitive(body + 1), start - 1, matchTable + 1);
 	if (!(successFlag)) {
 		return null;
 	}
 	pop(5);
-	pushInteger(0);
+	pushInteger(index + 1);
 	return null;
 }
 
@@ -741,22 +695,20 @@ primitiveIndexOfAsciiInString(void) {
 	if (!(successFlag)) {
 		return null;
 	}
-	stringSize = sizeOfSTArrayFromCPrimitive(aString + 1);
-	for (pos = start; pos <= stringSize; pos += 1) {
-		if ((asciiValue(aString[pos])) == anInteger) {
-			if (!(successFlag)) {
-				return null;
-			}
-			pop(4);
-			pushInteger(pos);
-			return null;
-		}
+	if (start < 1) {
+		start = 1;
 	}
+	stringSize = sizeOfSTArrayFromCPrimitive(aString + 1);
+	pos = (start > stringSize
+		? -1
+		: miscIndexOfByte(aString + start, stringSize - start + 1, anInteger));
 	if (!(successFlag)) {
 		return null;
 	}
 	pop(4);
-	pushInteger(0);
+	pushInteger((pos < 0
+		? 0
+		: start + pos));
 	return null;
 }
 
@@ -774,8 +726,6 @@ primitiveStringHash(void) {
     unsigned char *aByteArray;
     sqInt byteArraySize;
     sqInt hash;
-    sqInt low;
-    sqInt pos;
     sqInt rcvr;
     sqInt speciesHash;
 
@@ -787,15 +737,7 @@ primitiveStringHash(void) {
 		return null;
 	}
 	byteArraySize = sizeOfSTArrayFromCPrimitive(aByteArray + 1);
-	hash = speciesHash & 268435455;
-	for (pos = 1; pos <= byteArraySize; pos += 1) {
-
-		/* Begin hashMultiply */
-
-		hash += aByteArray[pos];
-		low = hash & 16383;
-		hash = ((9741 * low) + ((((9741 * (((usqInt) hash >> 14))) + (101 * low)) & 16383) * 16384)) & 268435455;
-	}
+	hash = miscStringHash(aByteArray + 1, byteArraySize, speciesHash & 268435455);
 	if (!(successFlag)) {
 		return null;
 	}
@@ -64,6 +64,7 @@ EXPORT(sqInt) primitiveDestroyAudioEncoder(void);
 EXPORT(sqInt) primitiveDestroyFeedbackChannel(void);
 EXPORT(sqInt) primitiveDestroyPhoneInterfaceIAX(void);
 EXPORT(sqInt) primitiveDestroySink(void);
+EXPORT(sqInt) primitiveFeedbackChannelDrain(void);
 EXPORT(sqInt) primitiveFeedbackChannelPopEvent(void);
 EXPORT(sqInt) primitiveFeedbackChannelReadEvent(void);
 EXPORT(sqInt) primitiveFeedbackChannelSetLogging(void);
@@ -99,6 +100,7 @@ EXPORT(sqInt) primitiveSinkPlayDebugAudioDirectlyViaOpenAL(void);
 EXPORT(sqInt) primitiveSinkPushEncodedSpeex(void);
 EXPORT(sqInt) primitiveSinkPushEncodedSpeexWithTimestamp(void);
 EXPORT(sqInt) primitiveSinkPushRawAudio(void);
+EXPORT(sqInt) primitiveSinkPushRawAudioBatch(void);
 EXPORT(sqInt) primitiveSinkRemoveSource(void);
 EXPORT(sqInt) primitiveSinkResetJitterbufferTimestamps(void);
 EXPORT(sqInt) primitiveSinkSetBufferedFrameCount(void);
@@ -109,6 +111,7 @@ EXPORT(sqInt) primitiveSinkSetOutputSamplingRate(void);
 EXPORT(sqInt) primitiveSinkSetTransformOpenAL(void);
 EXPORT(sqInt) primitiveSinkStartSpeexDebugRecording(void);
 EXPORT(sqInt) primitiveSinkStopSpeexDebugRecording(void);
+EXPORT(sqInt) primitiveSpeexControl(void);
 EXPORT(sqInt) primitiveSpeexCreateHandle(void);
 EXPORT(sqInt) primitiveSpeexDecode(void);
 EXPORT(sqInt) primitiveSpeexDecodeToTestJB(void);
@@ -117,9 +120,13 @@ EXPORT(sqInt) primitiveSpeexEncode(void);
 EXPORT(sqInt) primitiveTestBufferSize(void);
 EXPORT(sqInt) primitiveTickerSetInterval(void);
 EXPORT(sqInt) primitiveTickerSetVerbosity(void);
+EXPORT(sqInt) primitiveTickerSetWorkerThreads(void);
 EXPORT(sqInt) primitiveTickerStart(void);
 EXPORT(sqInt) primitiveTickerStop(void);
 EXPORT(sqInt) primitiveTickerTickNow(void);
+EXPORT(sqInt) primitiveTraceDrain(void);
+EXPORT(sqInt) primitiveTraceSetCategories(void);
+EXPORT(sqInt) primitiveTraceWriteChromeFile(void);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
 EXPORT(sqInt) shutdownModule(void);
 static sqInt stackBooleanValue(sqInt index);
@@ -694,6 +701,45 @@ primitiveDestroySink(void)
 }
 
 
+/*	Copy as many of the channel's events as fit into 'buffer', and answer
+	the number of bytes used. Each event is a 32-bit size followed by the
+	bytes that #primitiveFeedbackChannelReadEvent: would have answered,
+	padded to a multiple of 4. If the next event doesn't fit at all, answer
+	minus the buffer size it needs. Once drained, the channel signals its
+	semaphore once per batch of events rather than once per event. */
+/*	arguments: name(type, stack offset)
+	address(ExternalAddress, 1)
+	buffer(ByteArray, 0) */
+
+EXPORT(sqInt)
+primitiveFeedbackChannelDrain(void)
+{
+    void* addressPtr;
+    sqInt bufferOop;
+    char* buffer;
+    sqInt bufferSize;
+    sqInt result;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	addressPtr = stackPointerPointer(1);
+	;
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	bufferOop = interpreterProxy->stackObjectValue(0);
+	interpreterProxy->success(interpreterProxy->isBytes(bufferOop));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	buffer = interpreterProxy->firstIndexableField(bufferOop);
+	bufferSize = interpreterProxy->byteSizeOf(bufferOop);
+	result = qFeedbackChannelDrain(addressPtr, buffer, bufferSize);
+	return interpreterProxy->popthenPush(3, interpreterProxy->integerObjectOf(result));
+}
+
+
 /*	Pop the frontmost event from the channel identified by 'externalAddress'. */
 /*	arguments: name(type, stack offset)
 	address(ExternalAddress, 0) */
@@ -1626,6 +1672,59 @@ primitiveSinkPushRawAudio(void)
 }
 
 
+/*	Push raw audio to many buffered-resampler sinks in one call, e.g. once
+	per tick for all media streams. Sink i takes the next (counts at: i)
+	16-bit samples of 'buffer'.
+	arguments: name(type, stack offset)
+	handles(WordArray, 2)
+	counts(WordArray, 1)
+	buffer(words, 0) */
+
+EXPORT(sqInt)
+primitiveSinkPushRawAudioBatch(void)
+{
+    sqInt bufferOop;
+    void*bufferPtr;
+    sqInt countsOop;
+    int*counts;
+    sqInt handlesOop;
+    unsigned*handles;
+    sqInt result;
+    sqInt sampleCount;
+    sqInt streamCount;
+
+	if (!(validateArgCount(3))) {
+		return null;
+	}
+	handlesOop = interpreterProxy->stackObjectValue(2);
+	countsOop = interpreterProxy->stackObjectValue(1);
+	bufferOop = interpreterProxy->stackObjectValue(0);
+	interpreterProxy->success(interpreterProxy->isWords(handlesOop));
+	interpreterProxy->success(interpreterProxy->isWords(countsOop));
+	interpreterProxy->success(interpreterProxy->isWords(bufferOop));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	streamCount = interpreterProxy->slotSizeOf(handlesOop);
+	if (!((interpreterProxy->slotSizeOf(countsOop)) == streamCount)) {
+		return interpreterProxy->primitiveFailFor(3);
+	}
+	handles = interpreterProxy->firstIndexableField(handlesOop);
+	counts = interpreterProxy->firstIndexableField(countsOop);
+	bufferPtr = interpreterProxy->firstIndexableField(bufferOop);
+
+	/* number of 16-bit samples */
+
+	sampleCount = ((sqInt) (interpreterProxy->byteSizeOf(bufferOop)) >> 1);
+	result = qSinkPushRawAudioBatch(handles, counts, streamCount, (short*)bufferPtr, sampleCount);
+	if (!(result == 0)) {
+		return interpreterProxy->primitiveFailFor(result);
+	}
+	interpreterProxy->pop(3);
+	return null;
+}
+
+
 /*	arguments: name(type, stack offset)
 	sinkHandle(integer, 1)
 	sourceHandle(integer,0) */
@@ -1930,6 +2029,36 @@ primitiveSinkStopSpeexDebugRecording(void)
 	return interpreterProxy->pop(1);
 }
 
+/*	Set or get the VAD/DTX settings of a Speex handle, or the activity of the
+	frames it last encoded (see QSpeexControl in qAudioSpeex.h).
+	arguments: name(type, stack offset)
+	handle(integer, 2)
+	ctlType(integer, 1)
+	ctlValue(integer, 0) */
+
+EXPORT(sqInt)
+primitiveSpeexControl(void)
+{
+    sqInt ctlType;
+    sqInt ctlValue;
+    sqInt handle;
+    sqInt result;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 3)) {
+		return interpreterProxy->primitiveFail();
+	}
+	handle = interpreterProxy->positive32BitValueOf(interpreterProxy->stackValue(2));
+	ctlType = interpreterProxy->stackIntegerValue(1);
+	ctlValue = interpreterProxy->stackIntegerValue(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	;
+	result = qSpeexControl((QSpeexCodecPtr)handle, ctlType, ctlValue);
+	interpreterProxy->pop(4);
+	return interpreterProxy->pushInteger(result);
+}
+
 EXPORT(sqInt)
 primitiveSpeexCreateHandle(void)
 {
@@ -2176,6 +2305,27 @@ primitiveTickerSetVerbosity(void)
 	return interpreterProxy->pop(1);
 }
 
+
+/*	Tick the sinks that may be ticked in parallel, such as the Speex sinks, on
+	this many threads, the ticker's own included. 1 ticks them in turn. */
+
+EXPORT(sqInt)
+primitiveTickerSetWorkerThreads(void)
+{
+    sqInt threadCount;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	threadCount = interpreterProxy->positive32BitValueOf(interpreterProxy->stackValue(0));
+	;
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	qTickerSetWorkerThreads((unsigned)threadCount);
+	return interpreterProxy->pop(1);
+}
+
 EXPORT(sqInt)
 primitiveTickerStart(void)
 {
@@ -2207,6 +2357,87 @@ primitiveTickerTickNow(void)
 }
 
 
+/*	Copy as many of the recorded trace events as fit into 'buffer', and
+	answer the number of bytes used, or, if the next event doesn't fit at
+	all, minus the buffer size it needs. See qTraceDrainInto() for the
+	layout. */
+/*	arguments: name(type, stack offset)
+	buffer(ByteArray, 0) */
+
+EXPORT(sqInt)
+primitiveTraceDrain(void)
+{
+    sqInt bufferOop;
+    char* buffer;
+    sqInt bufferSize;
+    sqInt result;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	bufferOop = interpreterProxy->stackObjectValue(0);
+	interpreterProxy->success(interpreterProxy->isBytes(bufferOop));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	buffer = interpreterProxy->firstIndexableField(bufferOop);
+	bufferSize = interpreterProxy->byteSizeOf(bufferOop);
+	result = qTraceDrainInto(buffer, bufferSize);
+	return interpreterProxy->popthenPush(2, interpreterProxy->integerObjectOf(result));
+}
+
+
+/*	Trace the categories whose bits are set in 'categories' (see QTraceCategory),
+	and answer those that were being traced. */
+/*	arguments: name(type, stack offset)
+	categories(integer, 0) */
+
+EXPORT(sqInt)
+primitiveTraceSetCategories(void)
+{
+    sqInt categories;
+    sqInt previous;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	categories = interpreterProxy->positive32BitValueOf(interpreterProxy->stackValue(0));
+	;
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	previous = qTraceGetCategories();
+	qTraceSetCategories((unsigned)categories);
+	return interpreterProxy->popthenPush(2, interpreterProxy->positive32BitIntegerFor(previous));
+}
+
+
+/*	Append every recorded trace event to the Chrome trace-event file at
+	'filePath', and answer how many were written, or -1 if it can't be. */
+/*	arguments: name(type, stack offset)
+	filePath(String, 0) */
+
+EXPORT(sqInt)
+primitiveTraceWriteChromeFile(void)
+{
+    char*filePath;
+    sqInt result;
+
+	if (!(validateArgCount(1))) {
+		return null;
+	}
+	filePath = stackStringValue(0);
+	if (interpreterProxy->failed()) {
+		free(filePath);
+		return null;
+	}
+	result = qTraceWriteChromeFile(filePath);
+	free(filePath);
+	interpreterProxy->pop(2);
+	return interpreterProxy->pushInteger(result);
+}
+
+
 /*	Note: This is coded so that is can be run from Squeak. */
 
 EXPORT(sqInt)
@@ -2318,6 +2549,7 @@ void* QAudioPlugin_exports[][3] = {
 	{"QAudioPlugin", "primitiveDestroyFeedbackChannel", (void*)primitiveDestroyFeedbackChannel},
 	{"QAudioPlugin", "primitiveDestroyPhoneInterfaceIAX", (void*)primitiveDestroyPhoneInterfaceIAX},
 	{"QAudioPlugin", "primitiveDestroySink", (void*)primitiveDestroySink},
+	{"QAudioPlugin", "primitiveFeedbackChannelDrain", (void*)primitiveFeedbackChannelDrain},
 	{"QAudioPlugin", "primitiveFeedbackChannelPopEvent", (void*)primitiveFeedbackChannelPopEvent},
 	{"QAudioPlugin", "primitiveFeedbackChannelReadEvent", (void*)primitiveFeedbackChannelReadEvent},
 	{"QAudioPlugin", "primitiveFeedbackChannelSetLogging", (void*)primitiveFeedbackChannelSetLogging},
@@ -2353,6 +2585,7 @@ void* QAudioPlugin_exports[][3] = {
 	{"QAudioPlugin", "primitiveSinkPushEncodedSpeex", (void*)primitiveSinkPushEncodedSpeex},
 	{"QAudioPlugin", "primitiveSinkPushEncodedSpeexWithTimestamp", (void*)primitiveSinkPushEncodedSpeexWithTimestamp},
 	{"QAudioPlugin", "primitiveSinkPushRawAudio", (void*)primitiveSinkPushRawAudio},
+	{"QAudioPlugin", "primitiveSinkPushRawAudioBatch", (void*)primitiveSinkPushRawAudioBatch},
 	{"QAudioPlugin", "primitiveSinkRemoveSource", (void*)primitiveSinkRemoveSource},
 	{"QAudioPlugin", "primitiveSinkResetJitterbufferTimestamps", (void*)primitiveSinkResetJitterbufferTimestamps},
 	{"QAudioPlugin", "primitiveSinkSetBufferedFrameCount", (void*)primitiveSinkSetBufferedFrameCount},
@@ -2363,6 +2596,7 @@ void* QAudioPlugin_exports[][3] = {
 	{"QAudioPlugin", "primitiveSinkSetTransformOpenAL", (void*)primitiveSinkSetTransformOpenAL},
 	{"QAudioPlugin", "primitiveSinkStartSpeexDebugRecording", (void*)primitiveSinkStartSpeexDebugRecording},
 	{"QAudioPlugin", "primitiveSinkStopSpeexDebugRecording", (void*)primitiveSinkStopSpeexDebugRecording},
+	{"QAudioPlugin", "primitiveSpeexControl", (void*)primitiveSpeexControl},
 	{"QAudioPlugin", "primitiveSpeexCreateHandle", (void*)primitiveSpeexCreateHandle},
 	{"QAudioPlugin", "primitiveSpeexDecode", (void*)primitiveSpeexDecode},
 	{"QAudioPlugin", "primitiveSpeexDecodeToTestJB", (void*)primitiveSpeexDecodeToTestJB},
@@ -2371,9 +2605,13 @@ void* QAudioPlugin_exports[][3] = {
 	{"QAudioPlugin", "primitiveTestBufferSize", (void*)primitiveTestBufferSize},
 	{"QAudioPlugin", "primitiveTickerSetInterval", (void*)primitiveTickerSetInterval},
 	{"QAudioPlugin", "primitiveTickerSetVerbosity", (void*)primitiveTickerSetVerbosity},
+	{"QAudioPlugin", "primitiveTickerSetWorkerThreads", (void*)primitiveTickerSetWorkerThreads},
 	{"QAudioPlugin", "primitiveTickerStart", (void*)primitiveTickerStart},
 	{"QAudioPlugin", "primitiveTickerStop", (void*)primitiveTickerStop},
 	{"QAudioPlugin", "primitiveTickerTickNow", (void*)primitiveTickerTickNow},
+	{"QAudioPlugin", "primitiveTraceDrain", (void*)primitiveTraceDrain},
+	{"QAudioPlugin", "primitiveTraceSetCategories", (void*)primitiveTraceSetCategories},
+	{"QAudioPlugin", "primitiveTraceWriteChromeFile", (void*)primitiveTraceWriteChromeFile},
 	{"QAudioPlugin", "setInterpreter", (void*)setInterpreter},
 	{"QAudioPlugin", "shutdownModule", (void*)shutdownModule},
 	{NULL, NULL, NULL}
@@ -40,15 +40,19 @@ static char __buildInfo[] = "SoundCodecPlugin VMMaker-eem.524 uuid: 9b748596-098
 
 
 /*** Constants ***/
+#define GSMStreamBatchSize 8
 
 
 /*** Function Prototypes ***/
 static VirtualMachine * getInterpreter(void);
 EXPORT(const char*) getModuleName(void);
+static sqInt gsmStreamsencoding(sqInt encoding);
 static sqInt halt(void);
 static sqInt msg(char *s);
 EXPORT(sqInt) primitiveGSMDecode(void);
+EXPORT(sqInt) primitiveGSMDecodeStreams(void);
 EXPORT(sqInt) primitiveGSMEncode(void);
+EXPORT(sqInt) primitiveGSMEncodeStreams(void);
 EXPORT(sqInt) primitiveGSMNewState(void);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
 
@@ -87,6 +91,128 @@ getModuleName(void) {
 	return moduleName;
 }
 
+
+/*	Code frameCount frames of each of several GSM streams, encoding or
+	decoding. The arguments are those of primitiveGSMEncode and
+	primitiveGSMDecode with Arrays of states, sources and destinations, one
+	of each per stream; the states must be distinct. Every stream is coded
+	exactly as those primitives would code it on its own, for the frames
+	every one of them has room for, and the answer is the Point of source
+	and destination counts that each stream moved on by. */
+
+static sqInt
+gsmStreamsencoding(sqInt encoding) {
+    sqInt count;
+    sqInt dst;
+    int dstDelta;
+    sqInt dstIndex;
+    int dstOops[GSMStreamBatchSize];
+    sqInt dstSize;
+    int dstSizes[GSMStreamBatchSize];
+    sqInt dsts;
+    sqInt first;
+    sqInt frameCount;
+    sqInt i;
+    sqInt j;
+    sqInt maxFrames;
+    sqInt result;
+    sqInt src;
+    int srcDelta;
+    sqInt srcIndex;
+    int srcOops[GSMStreamBatchSize];
+    sqInt srcSize;
+    int srcSizes[GSMStreamBatchSize];
+    sqInt srcs;
+    sqInt state;
+    int stateOops[GSMStreamBatchSize];
+    sqInt states;
+    sqInt streamCount;
+
+	dstIndex = interpreterProxy->stackIntegerValue(0);
+	dsts = interpreterProxy->stackObjectValue(1);
+	srcIndex = interpreterProxy->stackIntegerValue(2);
+	srcs = interpreterProxy->stackObjectValue(3);
+	frameCount = interpreterProxy->stackIntegerValue(4);
+	states = interpreterProxy->stackObjectValue(5);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->success(interpreterProxy->isPointers(states));
+	interpreterProxy->success(interpreterProxy->isPointers(srcs));
+	interpreterProxy->success(interpreterProxy->isPointers(dsts));
+	interpreterProxy->success((frameCount >= 0) && ((srcIndex >= 1) && (dstIndex >= 1)));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	streamCount = interpreterProxy->slotSizeOf(states);
+	interpreterProxy->success(((interpreterProxy->slotSizeOf(srcs)) == streamCount) && ((interpreterProxy->slotSizeOf(dsts)) == streamCount));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	for (i = 0; i <= (streamCount - 1); i += 1) {
+		state = interpreterProxy->fetchPointerofObject(i, states);
+		src = interpreterProxy->fetchPointerofObject(i, srcs);
+		dst = interpreterProxy->fetchPointerofObject(i, dsts);
+		interpreterProxy->success(interpreterProxy->isBytes(state));
+		if (encoding) {
+			interpreterProxy->success(interpreterProxy->isWords(src));
+			interpreterProxy->success(interpreterProxy->isBytes(dst));
+		} else {
+			interpreterProxy->success(interpreterProxy->isBytes(src));
+			interpreterProxy->success(interpreterProxy->isWords(dst));
+		}
+		if (interpreterProxy->failed()) {
+			return null;
+		}
+		interpreterProxy->success((interpreterProxy->slotSizeOf(state)) >= (gsmStateBytes()));
+		for (j = 0; j <= (i - 1); j += 1) {
+			interpreterProxy->success((interpreterProxy->fetchPointerofObject(j, states)) != state);
+		}
+		if (encoding) {
+			srcSize = (interpreterProxy->slotSizeOf(src)) * 2;
+			dstSize = interpreterProxy->slotSizeOf(dst);
+			interpreterProxy->success((srcIndex <= (srcSize + 1)) && (dstIndex <= (dstSize + 1)));
+			maxFrames = ((((srcSize + 1) - srcIndex) / 160) < (((dstSize + 1) - dstIndex) / 33)) ? (((srcSize + 1) - srcIndex) / 160) : (((dstSize + 1) - dstIndex) / 33);
+		} else {
+			srcSize = interpreterProxy->slotSizeOf(src);
+			dstSize = (interpreterProxy->slotSizeOf(dst)) * 2;
+			interpreterProxy->success((srcIndex <= (srcSize + 1)) && (dstIndex <= (dstSize + 1)));
+			maxFrames = ((((srcSize + 1) - srcIndex) / 33) < (((dstSize + 1) - dstIndex) / 160)) ? (((srcSize + 1) - srcIndex) / 33) : (((dstSize + 1) - dstIndex) / 160);
+		}
+		if (interpreterProxy->failed()) {
+			return null;
+		}
+		if (maxFrames < frameCount) {
+			frameCount = maxFrames;
+		}
+	}
+	srcDelta = (dstDelta = 0);
+	for (first = 0; first <= (streamCount - 1); first += GSMStreamBatchSize) {
+		count = ((streamCount - first) < GSMStreamBatchSize) ? (streamCount - first) : GSMStreamBatchSize;
+		for (i = 0; i <= (count - 1); i += 1) {
+			state = interpreterProxy->fetchPointerofObject(first + i, states);
+			src = interpreterProxy->fetchPointerofObject(first + i, srcs);
+			dst = interpreterProxy->fetchPointerofObject(first + i, dsts);
+			stateOops[i] = state + 4;
+			srcOops[i] = src;
+			dstOops[i] = dst;
+			srcSizes[i] = encoding ? (interpreterProxy->slotSizeOf(src)) * 2 : interpreterProxy->slotSizeOf(src);
+			dstSizes[i] = encoding ? interpreterProxy->slotSizeOf(dst) : (interpreterProxy->slotSizeOf(dst)) * 2;
+		}
+		if (encoding) {
+			gsmEncodeStreams(stateOops, count, frameCount, srcOops, srcIndex, srcSizes, dstOops, dstIndex, dstSizes, &srcDelta, &dstDelta);
+		} else {
+			gsmDecodeStreams(stateOops, count, frameCount, srcOops, srcIndex, srcSizes, dstOops, dstIndex, dstSizes, &srcDelta, &dstDelta);
+		}
+	}
+	result = interpreterProxy->makePointwithxValueyValue(srcDelta, dstDelta);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->pop(6);
+	interpreterProxy->push(result);
+}
+
 static sqInt
 halt(void) {
 	;
@@ -139,6 +265,15 @@ primitiveGSMDecode(void) {
 	interpreterProxy->push(result);
 }
 
+
+/*	Decode frameCount frames of each of several GSM streams. See
+	gsmStreamsencoding. */
+
+EXPORT(sqInt)
+primitiveGSMDecodeStreams(void) {
+	gsmStreamsencoding(0);
+}
+
 EXPORT(sqInt)
 primitiveGSMEncode(void) {
     sqInt dst;
@@ -179,6 +314,15 @@ primitiveGSMEncode(void) {
 	interpreterProxy->push(result);
 }
 
+
+/*	Encode frameCount frames of each of several GSM streams. See
+	gsmStreamsencoding. */
+
+EXPORT(sqInt)
+primitiveGSMEncodeStreams(void) {
+	gsmStreamsencoding(1);
+}
+
 EXPORT(sqInt)
 primitiveGSMNewState(void) {
     sqInt state;
@@ -213,7 +357,9 @@ setInterpreter(struct VirtualMachine*anInterpreter) {
 void* SoundCodecPrims_exports[][3] = {
 	{"SoundCodecPrims", "getModuleName", (void*)getModuleName},
 	{"SoundCodecPrims", "primitiveGSMDecode", (void*)primitiveGSMDecode},
+	{"SoundCodecPrims", "primitiveGSMDecodeStreams", (void*)primitiveGSMDecodeStreams},
 	{"SoundCodecPrims", "primitiveGSMEncode", (void*)primitiveGSMEncode},
+	{"SoundCodecPrims", "primitiveGSMEncodeStreams", (void*)primitiveGSMEncodeStreams},
 	{"SoundCodecPrims", "primitiveGSMNewState", (void*)primitiveGSMNewState},
 	{"SoundCodecPrims", "setInterpreter", (void*)setInterpreter},
 	{NULL, NULL, NULL}
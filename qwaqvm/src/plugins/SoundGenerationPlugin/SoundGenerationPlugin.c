@@ -34,6 +34,7 @@ static char __buildInfo[] = "SoundGenerationPlugin VMMaker-eem.715 uuid: 707ba1f
 #endif
 
 #include "sqMemoryAccess.h"
+#include "SoundGenerationPlugin.h"
 
 
 /*** Proxy Functions ***/
@@ -170,38 +171,40 @@ primitiveApplyReverb(void)
 	if (!(successFlag)) {
 		return null;
 	}
-	for (sliceIndex = startIndex; sliceIndex <= ((startIndex + n) - 1); sliceIndex += 1) {
-		delayedLeft = delayedRight = 0;
-		for (tapIndex = 1; tapIndex <= tapCount; tapIndex += 1) {
-			i = bufferIndex - (tapDelays[tapIndex]);
-			if (i < 1) {
-				i += bufferSize;
+	if ((soundApplyReverb(aSoundBuffer + ((2 * startIndex) - 1), n, tapDelays + 1, tapGains + 1, tapCount, leftBuffer + 1, rightBuffer + 1, bufferSize, &bufferIndex)) < 0) {
+		for (sliceIndex = startIndex; sliceIndex <= ((startIndex + n) - 1); sliceIndex += 1) {
+			delayedLeft = delayedRight = 0;
+			for (tapIndex = 1; tapIndex <= tapCount; tapIndex += 1) {
+				i = bufferIndex - (tapDelays[tapIndex]);
+				if (i < 1) {
+					i += bufferSize;
+				}
+				tapGain = tapGains[tapIndex];
+				delayedLeft += tapGain * (leftBuffer[i]);
+				delayedRight += tapGain * (rightBuffer[i]);
 			}
-			tapGain = tapGains[tapIndex];
-			delayedLeft += tapGain * (leftBuffer[i]);
-			delayedRight += tapGain * (rightBuffer[i]);
-		}
-		j = (2 * sliceIndex) - 1;
-		out = (aSoundBuffer[j]) + (((sqInt) delayedLeft >> 15));
-		if (out > 32767) {
-			out = 32767;
-		}
-		if (out < -32767) {
-			out = -32767;
-		}
-		aSoundBuffer[j] = out;
-		leftBuffer[bufferIndex] = out;
-		j += 1;
-		out = (aSoundBuffer[j]) + (((sqInt) delayedRight >> 15));
-		if (out > 32767) {
-			out = 32767;
-		}
-		if (out < -32767) {
-			out = -32767;
+			j = (2 * sliceIndex) - 1;
+			out = (aSoundBuffer[j]) + (((sqInt) delayedLeft >> 15));
+			if (out > 32767) {
+				out = 32767;
+			}
+			if (out < -32767) {
+				out = -32767;
+			}
+			aSoundBuffer[j] = out;
+			leftBuffer[bufferIndex] = out;
+			j += 1;
+			out = (aSoundBuffer[j]) + (((sqInt) delayedRight >> 15));
+			if (out > 32767) {
+				out = 32767;
+			}
+			if (out < -32767) {
+				out = -32767;
+			}
+			aSoundBuffer[j] = out;
+			rightBuffer[bufferIndex] = out;
+			bufferIndex = (bufferIndex % bufferSize) + 1;
 		}
-		aSoundBuffer[j] = out;
-		rightBuffer[bufferIndex] = out;
-		bufferIndex = (bufferIndex % bufferSize) + 1;
 	}
 	if (!(successFlag)) {
 		return null;
@@ -269,56 +272,58 @@ primitiveMixFMSound(void)
 	}
 	doingFM = (normalizedModulation != 0)
 	 && (scaledOffsetIndexIncr != 0);
-	lastIndex = (startIndex + n) - 1;
-	for (sliceIndex = startIndex; sliceIndex <= lastIndex; sliceIndex += 1) {
-		sample = ((sqInt) (scaledVol * (waveTable[(((sqInt) scaledIndex >> 15)) + 1])) >> 15);
-		if (doingFM) {
-			offset = normalizedModulation * (waveTable[(((sqInt) scaledOffsetIndex >> 15)) + 1]);
-			scaledOffsetIndex = (scaledOffsetIndex + scaledOffsetIndexIncr) % scaledWaveTableSize;
-			if (scaledOffsetIndex < 0) {
-				scaledOffsetIndex += scaledWaveTableSize;
-			}
-			scaledIndex = ((scaledIndex + scaledIndexIncr) + offset) % scaledWaveTableSize;
-			if (scaledIndex < 0) {
-				scaledIndex += scaledWaveTableSize;
-			}
-		}
-		else {
-			scaledIndex = (scaledIndex + scaledIndexIncr) % scaledWaveTableSize;
-		}
-		if (leftVol > 0) {
-			i = (2 * sliceIndex) - 1;
-			s = (aSoundBuffer[i]) + (((sqInt) (sample * leftVol) >> 15));
-			if (s > 32767) {
-				s = 32767;
+	if ((soundMixFM(aSoundBuffer + ((2 * startIndex) - 1), n, leftVol, rightVol, &scaledVol, &scaledVolIncr, scaledVolLimit, waveTable + 1, scaledWaveTableSize, &scaledIndex, scaledIndexIncr, normalizedModulation, &scaledOffsetIndex, scaledOffsetIndexIncr)) < 0) {
+		lastIndex = (startIndex + n) - 1;
+		for (sliceIndex = startIndex; sliceIndex <= lastIndex; sliceIndex += 1) {
+			sample = ((sqInt) (scaledVol * (waveTable[(((sqInt) scaledIndex >> 15)) + 1])) >> 15);
+			if (doingFM) {
+				offset = normalizedModulation * (waveTable[(((sqInt) scaledOffsetIndex >> 15)) + 1]);
+				scaledOffsetIndex = (scaledOffsetIndex + scaledOffsetIndexIncr) % scaledWaveTableSize;
+				if (scaledOffsetIndex < 0) {
+					scaledOffsetIndex += scaledWaveTableSize;
+				}
+				scaledIndex = ((scaledIndex + scaledIndexIncr) + offset) % scaledWaveTableSize;
+				if (scaledIndex < 0) {
+					scaledIndex += scaledWaveTableSize;
+				}
 			}
-			if (s < -32767) {
-				s = -32767;
+			else {
+				scaledIndex = (scaledIndex + scaledIndexIncr) % scaledWaveTableSize;
 			}
-			aSoundBuffer[i] = s;
-		}
-		if (rightVol > 0) {
-			i = 2 * sliceIndex;
-			s = (aSoundBuffer[i]) + (((sqInt) (sample * rightVol) >> 15));
-			if (s > 32767) {
-				s = 32767;
+			if (leftVol > 0) {
+				i = (2 * sliceIndex) - 1;
+				s = (aSoundBuffer[i]) + (((sqInt) (sample * leftVol) >> 15));
+				if (s > 32767) {
+					s = 32767;
+				}
+				if (s < -32767) {
+					s = -32767;
+				}
+				aSoundBuffer[i] = s;
 			}
-			if (s < -32767) {
-				s = -32767;
+			if (rightVol > 0) {
+				i = 2 * sliceIndex;
+				s = (aSoundBuffer[i]) + (((sqInt) (sample * rightVol) >> 15));
+				if (s > 32767) {
+					s = 32767;
+				}
+				if (s < -32767) {
+					s = -32767;
+				}
+				aSoundBuffer[i] = s;
 			}
-			aSoundBuffer[i] = s;
-		}
-		if (scaledVolIncr != 0) {
-			scaledVol += scaledVolIncr;
-			if (((scaledVolIncr > 0)
- && (scaledVol >= scaledVolLimit))
-			 || ((scaledVolIncr < 0)
- && (scaledVol <= scaledVolLimit))) {
+			if (scaledVolIncr != 0) {
+				scaledVol += scaledVolIncr;
+				if (((scaledVolIncr > 0)
+	 && (scaledVol >= scaledVolLimit))
+				 || ((scaledVolIncr < 0)
+	 && (scaledVol <= scaledVolLimit))) {
 
-				/* reached the limit; stop incrementing */
+					/* reached the limit; stop incrementing */
 
-				scaledVol = scaledVolLimit;
-				scaledVolIncr = 0;
+					scaledVol = scaledVolLimit;
+					scaledVolIncr = 0;
+				}
 			}
 		}
 	}
@@ -360,6 +365,7 @@ primitiveMixLoopedSampledSound(void)
     sqInt leftVol;
     sqInt loopEnd;
     sqInt m;
+    sqInt mixResult;
     sqInt n;
     sqInt nextSampleIndex;
     sqInt rcvr;
@@ -406,82 +412,101 @@ primitiveMixLoopedSampledSound(void)
 	compositeLeftVol = ((sqInt) (leftVol * scaledVol) >> 15);
 	compositeRightVol = ((sqInt) (rightVol * scaledVol) >> 15);
 	i = (2 * startIndex) - 1;
-	lastIndex = (startIndex + n) - 1;
-	for (sliceIndex = startIndex; sliceIndex <= lastIndex; sliceIndex += 1) {
-		sampleIndex = ((sqInt) ((scaledIndex += scaledIndexIncr)) >> 9);
-		if ((sampleIndex > loopEnd)
-		 && (count > releaseCount)) {
+	mixResult = soundMixLooped(aSoundBuffer + i, n, leftVol, rightVol, &scaledVol, &scaledVolIncr, scaledVolLimit, leftSamples + 1, rightSamples + 1, count, releaseCount, lastSample, loopEnd, scaledLoopLength, &scaledIndex, scaledIndexIncr);
+	if (mixResult > 0) {
 
-			/* loop back if not within releaseCount of the note end */
-			/* note: unlooped sounds will have loopEnd = lastSample */
+		/* ran out of samples */
 
-			sampleIndex = ((sqInt) ((scaledIndex -= scaledLoopLength)) >> 9);
+		count = 0;
+		if (!(successFlag)) {
+			return null;
 		}
-		if (((nextSampleIndex = sampleIndex + 1)) > lastSample) {
-			if (sampleIndex > lastSample) {
-				count = 0;
-				if (!(successFlag)) {
+		storeIntegerofObjectwithValue(3, rcvr, scaledVol);
+		storeIntegerofObjectwithValue(4, rcvr, scaledVolIncr);
+		storeIntegerofObjectwithValue(7, rcvr, count);
+		storeIntegerofObjectwithValue(19, rcvr, scaledIndex);
+		pop(6);
+		pushInteger(null);
+		return null;
+	}
+	if (mixResult < 0) {
+		lastIndex = (startIndex + n) - 1;
+		for (sliceIndex = startIndex; sliceIndex <= lastIndex; sliceIndex += 1) {
+			sampleIndex = ((sqInt) ((scaledIndex += scaledIndexIncr)) >> 9);
+			if ((sampleIndex > loopEnd)
+			 && (count > releaseCount)) {
+
+				/* loop back if not within releaseCount of the note end */
+				/* note: unlooped sounds will have loopEnd = lastSample */
+
+				sampleIndex = ((sqInt) ((scaledIndex -= scaledLoopLength)) >> 9);
+			}
+			if (((nextSampleIndex = sampleIndex + 1)) > lastSample) {
+				if (sampleIndex > lastSample) {
+					count = 0;
+					if (!(successFlag)) {
+						return null;
+					}
+					storeIntegerofObjectwithValue(3, rcvr, scaledVol);
+					storeIntegerofObjectwithValue(4, rcvr, scaledVolIncr);
+					storeIntegerofObjectwithValue(7, rcvr, count);
+					storeIntegerofObjectwithValue(19, rcvr, scaledIndex);
+					pop(6);
+					pushInteger(null);
 					return null;
 				}
-				storeIntegerofObjectwithValue(3, rcvr, scaledVol);
-				storeIntegerofObjectwithValue(4, rcvr, scaledVolIncr);
-				storeIntegerofObjectwithValue(7, rcvr, count);
-				storeIntegerofObjectwithValue(19, rcvr, scaledIndex);
-				pop(6);
-				pushInteger(null);
-				return null;
-			}
-			if (scaledLoopLength == 0) {
-				nextSampleIndex = sampleIndex;
-			}
-			else {
-				nextSampleIndex = (((sqInt) (scaledIndex - scaledLoopLength) >> 9)) + 1;
-			}
-		}
-		m = scaledIndex & LoopIndexFractionMask;
-		rightVal = leftVal = ((sqInt) (((leftSamples[sampleIndex]) * (LoopIndexScaleFactor - m)) + ((leftSamples[nextSampleIndex]) * m)) >> 9);
-		if (isInStereo) {
-			rightVal = ((sqInt) (((rightSamples[sampleIndex]) * (LoopIndexScaleFactor - m)) + ((rightSamples[nextSampleIndex]) * m)) >> 9);
-		}
-		if (leftVol > 0) {
-			s = (aSoundBuffer[i]) + (((sqInt) (compositeLeftVol * leftVal) >> 15));
-			if (s > 32767) {
-				s = 32767;
+				if (scaledLoopLength == 0) {
+					nextSampleIndex = sampleIndex;
+				}
+				else {
+					nextSampleIndex = (((sqInt) (scaledIndex - scaledLoopLength) >> 9)) + 1;
+				}
 			}
-			if (s < -32767) {
-				s = -32767;
+			m = scaledIndex & LoopIndexFractionMask;
+			rightVal = leftVal = ((sqInt) (((leftSamples[sampleIndex]) * (LoopIndexScaleFactor - m)) + ((leftSamples[nextSampleIndex]) * m)) >> 9);
+			if (isInStereo) {
+				rightVal = ((sqInt) (((rightSamples[sampleIndex]) * (LoopIndexScaleFactor - m)) + ((rightSamples[nextSampleIndex]) * m)) >> 9);
 			}
-			aSoundBuffer[i] = s;
-		}
-		i += 1;
-		if (rightVol > 0) {
-			s = (aSoundBuffer[i]) + (((sqInt) (compositeRightVol * rightVal) >> 15));
-			if (s > 32767) {
-				s = 32767;
+			if (leftVol > 0) {
+				s = (aSoundBuffer[i]) + (((sqInt) (compositeLeftVol * leftVal) >> 15));
+				if (s > 32767) {
+					s = 32767;
+				}
+				if (s < -32767) {
+					s = -32767;
+				}
+				aSoundBuffer[i] = s;
 			}
-			if (s < -32767) {
-				s = -32767;
+			i += 1;
+			if (rightVol > 0) {
+				s = (aSoundBuffer[i]) + (((sqInt) (compositeRightVol * rightVal) >> 15));
+				if (s > 32767) {
+					s = 32767;
+				}
+				if (s < -32767) {
+					s = -32767;
+				}
+				aSoundBuffer[i] = s;
 			}
-			aSoundBuffer[i] = s;
-		}
-		i += 1;
-		if (scaledVolIncr != 0) {
+			i += 1;
+			if (scaledVolIncr != 0) {
 
-			/* update volume envelope if it is changing */
+				/* update volume envelope if it is changing */
 
-			scaledVol += scaledVolIncr;
-			if (((scaledVolIncr > 0)
- && (scaledVol >= scaledVolLimit))
-			 || ((scaledVolIncr < 0)
- && (scaledVol <= scaledVolLimit))) {
+				scaledVol += scaledVolIncr;
+				if (((scaledVolIncr > 0)
+	 && (scaledVol >= scaledVolLimit))
+				 || ((scaledVolIncr < 0)
+	 && (scaledVol <= scaledVolLimit))) {
 
-				/* reached the limit; stop incrementing */
+					/* reached the limit; stop incrementing */
 
-				scaledVol = scaledVolLimit;
-				scaledVolIncr = 0;
+					scaledVol = scaledVolLimit;
+					scaledVolIncr = 0;
+				}
+				compositeLeftVol = ((sqInt) (leftVol * scaledVol) >> 15);
+				compositeRightVol = ((sqInt) (rightVol * scaledVol) >> 15);
 			}
-			compositeLeftVol = ((sqInt) (leftVol * scaledVol) >> 15);
-			compositeRightVol = ((sqInt) (rightVol * scaledVol) >> 15);
 		}
 	}
 	count -= n;
@@ -663,58 +688,60 @@ primitiveMixSampledSound(void)
 	if (!(successFlag)) {
 		return null;
 	}
-	lastIndex = (startIndex + n) - 1;
+	if ((soundMixSampled(aSoundBuffer + ((2 * startIndex) - 1), n, leftVol, rightVol, &scaledVol, &scaledVolIncr, scaledVolLimit, samples + 1, samplesSize, &scaledIndex, &indexHighBits, scaledIncrement)) < 0) {
+		lastIndex = (startIndex + n) - 1;
 
-	/* index of next stereo output sample pair */
+		/* index of next stereo output sample pair */
 
-	outIndex = startIndex;
-	sampleIndex = indexHighBits + (((usqInt) scaledIndex) >> IncrementFractionBits);
-	while ((sampleIndex <= samplesSize)
- && (outIndex <= lastIndex)) {
-		sample = ((sqInt) ((samples[sampleIndex]) * scaledVol) >> 15);
-		if (leftVol > 0) {
-			i = (2 * outIndex) - 1;
-			s = (aSoundBuffer[i]) + (((sqInt) (sample * leftVol) >> 15));
-			if (s > 32767) {
-				s = 32767;
-			}
-			if (s < -32767) {
-				s = -32767;
-			}
-			aSoundBuffer[i] = s;
-		}
-		if (rightVol > 0) {
-			i = 2 * outIndex;
-			s = (aSoundBuffer[i]) + (((sqInt) (sample * rightVol) >> 15));
-			if (s > 32767) {
-				s = 32767;
+		outIndex = startIndex;
+		sampleIndex = indexHighBits + (((usqInt) scaledIndex) >> IncrementFractionBits);
+		while ((sampleIndex <= samplesSize)
+	 && (outIndex <= lastIndex)) {
+			sample = ((sqInt) ((samples[sampleIndex]) * scaledVol) >> 15);
+			if (leftVol > 0) {
+				i = (2 * outIndex) - 1;
+				s = (aSoundBuffer[i]) + (((sqInt) (sample * leftVol) >> 15));
+				if (s > 32767) {
+					s = 32767;
+				}
+				if (s < -32767) {
+					s = -32767;
+				}
+				aSoundBuffer[i] = s;
 			}
-			if (s < -32767) {
-				s = -32767;
+			if (rightVol > 0) {
+				i = 2 * outIndex;
+				s = (aSoundBuffer[i]) + (((sqInt) (sample * rightVol) >> 15));
+				if (s > 32767) {
+					s = 32767;
+				}
+				if (s < -32767) {
+					s = -32767;
+				}
+				aSoundBuffer[i] = s;
 			}
-			aSoundBuffer[i] = s;
-		}
-		if (scaledVolIncr != 0) {
-			scaledVol += scaledVolIncr;
-			if (((scaledVolIncr > 0)
- && (scaledVol >= scaledVolLimit))
-			 || ((scaledVolIncr < 0)
- && (scaledVol <= scaledVolLimit))) {
+			if (scaledVolIncr != 0) {
+				scaledVol += scaledVolIncr;
+				if (((scaledVolIncr > 0)
+	 && (scaledVol >= scaledVolLimit))
+				 || ((scaledVolIncr < 0)
+	 && (scaledVol <= scaledVolLimit))) {
 
-				/* reached the limit; stop incrementing */
+					/* reached the limit; stop incrementing */
 
-				scaledVol = scaledVolLimit;
-				scaledVolIncr = 0;
+					scaledVol = scaledVolLimit;
+					scaledVolIncr = 0;
+				}
 			}
+			scaledIndex += scaledIncrement;
+			if (scaledIndex >= ScaledIndexOverflow) {
+				overflow = ((usqInt) scaledIndex) >> IncrementFractionBits;
+				indexHighBits += overflow;
+				scaledIndex -= overflow << IncrementFractionBits;
+			}
+			sampleIndex = indexHighBits + (((usqInt) scaledIndex) >> IncrementFractionBits);
+			outIndex += 1;
 		}
-		scaledIndex += scaledIncrement;
-		if (scaledIndex >= ScaledIndexOverflow) {
-			overflow = ((usqInt) scaledIndex) >> IncrementFractionBits;
-			indexHighBits += overflow;
-			scaledIndex -= overflow << IncrementFractionBits;
-		}
-		sampleIndex = indexHighBits + (((usqInt) scaledIndex) >> IncrementFractionBits);
-		outIndex += 1;
 	}
 	count -= n;
 	if (!(successFlag)) {
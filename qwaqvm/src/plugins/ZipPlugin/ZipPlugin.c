@@ -35,6 +35,7 @@ static char __buildInfo[] = "DeflatePlugin VMMaker-eem.666 uuid: 4edd7d00-3db5-4
 #endif
 
 #include "sqMemoryAccess.h"
+#include "ZipPlugin.h"
 
 
 /*** Constants ***/
@@ -61,6 +62,7 @@ static sqInt findMatchlastLengthlastMatchchainLengthgoodMatch(sqInt here, sqInt
 static VirtualMachine * getInterpreter(void);
 EXPORT(const char*) getModuleName(void);
 static sqInt halt(void);
+EXPORT(sqInt) initialiseModule(void);
 static sqInt insertStringAt(sqInt here);
 static sqInt loadDeflateStreamFrom(sqInt rcvr);
 static sqInt loadZipEncoderFrom(sqInt rcvr);
@@ -72,14 +74,23 @@ EXPORT(sqInt) primitiveInflateDecompressBlock(void);
 EXPORT(sqInt) primitiveUpdateAdler32(void);
 EXPORT(sqInt) primitiveUpdateGZipCrc32(void);
 EXPORT(sqInt) primitiveZipSendBlock(void);
+EXPORT(sqInt) primitiveZipStreamCreate(void);
+EXPORT(sqInt) primitiveZipStreamDestroy(void);
+EXPORT(sqInt) primitiveZipStreamProcess(void);
+EXPORT(sqInt) primitiveZipStreamResultInto(void);
+EXPORT(sqInt) primitiveZipStreamResultSize(void);
+EXPORT(sqInt) primitiveZipStreamStart(void);
+EXPORT(sqInt) primitiveZipStreamStartFile(void);
 static sqInt sendBlockwithwithwith(sqInt literalStream, sqInt distanceStream, sqInt litTree, sqInt distTree);
 EXPORT(sqInt) setInterpreter(struct VirtualMachine*anInterpreter);
 static sqInt shouldFlush(void);
+EXPORT(sqInt) shutdownModule(void);
 static sqInt updateHashAt(sqInt here);
 static sqInt updateHash(sqInt nextValue);
 static sqInt zipDecodeValueFromsize(unsigned int *table, sqInt tableSize);
 static sqInt zipDecompressBlock(void);
 static sqInt zipNextBits(sqInt n);
+static sqInt zipStreamHandleAt(sqInt index);
 
 
 /*** Variables ***/
@@ -95,6 +106,7 @@ static const char *moduleName =
 	"ZipPlugin VMMaker-eem.666 (e)"
 #endif
 ;
+static void * sCOFfn;
 static unsigned int zipBaseDistance[] = {
 0, 1, 2, 3, 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128, 192, 
 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192, 12288, 16384, 24576};
@@ -107,23 +119,6 @@ static sqInt zipBlockPos;
 static sqInt zipBlockStart;
 static unsigned char* zipCollection;
 static sqInt zipCollectionSize;
-static unsigned int zipCrcTable[] = {
-0, 1996959894, 3993919788U, 2567524794U, 124634137, 1886057615, 3915621685U, 2657392035U, 249268274, 2044508324, 3772115230U, 2547177864U, 162941995, 2125561021, 3887607047U, 2428444049U, 
-498536548, 1789927666, 4089016648U, 2227061214U, 450548861, 1843258603, 4107580753U, 2211677639U, 325883990, 1684777152, 4251122042U, 2321926636U, 335633487, 1661365465, 4195302755U, 2366115317U, 
-997073096, 1281953886, 3579855332U, 2724688242U, 1006888145, 1258607687, 3524101629U, 2768942443U, 901097722, 1119000684, 3686517206U, 2898065728U, 853044451, 1172266101, 3705015759U, 2882616665U, 
-651767980, 1373503546, 3369554304U, 3218104598U, 565507253, 1454621731, 3485111705U, 3099436303U, 671266974, 1594198024, 3322730930U, 2970347812U, 795835527, 1483230225, 3244367275U, 3060149565U, 
-1994146192, 31158534, 2563907772U, 4023717930U, 1907459465, 112637215, 2680153253U, 3904427059U, 2013776290, 251722036, 2517215374U, 3775830040U, 2137656763, 141376813, 2439277719U, 3865271297U, 
-1802195444, 476864866, 2238001368U, 4066508878U, 1812370925, 453092731, 2181625025U, 4111451223U, 1706088902, 314042704, 2344532202U, 4240017532U, 1658658271, 366619977, 2362670323U, 4224994405U, 
-1303535960, 984961486, 2747007092U, 3569037538U, 1256170817, 1037604311, 2765210733U, 3554079995U, 1131014506, 879679996, 2909243462U, 3663771856U, 1141124467, 855842277, 2852801631U, 3708648649U, 
-1342533948, 654459306, 3188396048U, 3373015174U, 1466479909, 544179635, 3110523913U, 3462522015U, 1591671054, 702138776, 2966460450U, 3352799412U, 1504918807, 783551873, 3082640443U, 3233442989U, 
-3988292384U, 2596254646U, 62317068, 1957810842, 3939845945U, 2647816111U, 81470997, 1943803523, 3814918930U, 2489596804U, 225274430, 2053790376, 3826175755U, 2466906013U, 167816743, 2097651377, 
-4027552580U, 2265490386U, 503444072, 1762050814, 4150417245U, 2154129355U, 426522225, 1852507879, 4275313526U, 2312317920U, 282753626, 1742555852, 4189708143U, 2394877945U, 397917763, 1622183637, 
-3604390888U, 2714866558U, 953729732, 1340076626, 3518719985U, 2797360999U, 1068828381, 1219638859, 3624741850U, 2936675148U, 906185462, 1090812512, 3747672003U, 2825379669U, 829329135, 1181335161, 
-3412177804U, 3160834842U, 628085408, 1382605366, 3423369109U, 3138078467U, 570562233, 1426400815, 3317316542U, 2998733608U, 733239954, 1555261956, 3268935591U, 3050360625U, 752459403, 1541320221, 
-2607071920U, 3965973030U, 1969922972, 40735498, 2617837225U, 3943577151U, 1913087877, 83908371, 2512341634U, 3803740692U, 2075208622, 213261112, 2463272603U, 3855990285U, 2094854071, 198958881, 
-2262029012U, 4057260610U, 1759359992, 534414190, 2176718541U, 4139329115U, 1873836001, 414664567, 2282248934U, 4279200368U, 1711684554, 285281116, 2405801727U, 4167216745U, 1634467795, 376229701, 
-2685067896U, 3608007406U, 1308918612, 956543938, 2808555105U, 3495958263U, 1231636301, 1047427035, 2932959818U, 3654703836U, 1088359270, 936918000, 2847714899U, 3736837829U, 1202900863, 817233897, 
-3183342108U, 3401237130U, 1404277552, 615818150, 3134207493U, 3453421203U, 1423857449, 601450431, 3009837614U, 3294710456U, 1567103746, 711928724, 3020668471U, 3272380065U, 1510334235, 755167117};
 static unsigned int zipDistanceCodes[] = {
 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 
 8, 8, 8, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 9, 9, 9, 
@@ -521,6 +516,12 @@ halt(void) {
 	return 0;
 }
 
+EXPORT(sqInt)
+initialiseModule(void) {
+	sCOFfn = interpreterProxy->ioLoadFunctionFrom("secCanOpenFileOfSizeWritable", "SecurityPlugin");
+	return zipStreamInit();
+}
+
 
 /*	Insert the string at the given start position into the hash table.
 	Note: The hash value is updated starting at MinMatch-1 since
@@ -852,13 +853,9 @@ primitiveInflateDecompressBlock(void) {
 EXPORT(sqInt)
 primitiveUpdateAdler32(void) {
     unsigned int  adler32;
-    sqInt b;
     unsigned char *bytePtr;
     sqInt collection;
-    sqInt i;
     sqInt length;
-    sqInt s1;
-    sqInt s2;
     sqInt startIndex;
     sqInt stopIndex;
 
@@ -884,14 +881,7 @@ primitiveUpdateAdler32(void) {
 	bytePtr = interpreterProxy->firstIndexableField(collection);
 	startIndex -= 1;
 	stopIndex -= 1;
-	s1 = adler32 & 65535;
-	s2 = (((usqInt) adler32) >> 16) & 65535;
-	for (i = startIndex; i <= stopIndex; i += 1) {
-		b = bytePtr[i];
-		s1 = (s1 + b) % 65521;
-		s2 = (s2 + s1) % 65521;
-	}
-	adler32 = (((usqInt) s2 << 16)) + s1;
+	adler32 = zipUpdateAdler32(adler32, bytePtr + startIndex, (stopIndex - startIndex) + 1);
 	interpreterProxy->pop(5);
 	interpreterProxy->push(interpreterProxy->positive32BitIntegerFor(adler32));
 }
@@ -904,7 +894,6 @@ primitiveUpdateGZipCrc32(void) {
     unsigned char *bytePtr;
     sqInt collection;
     unsigned int  crc;
-    sqInt i;
     sqInt length;
     sqInt startIndex;
     sqInt stopIndex;
@@ -932,9 +921,7 @@ primitiveUpdateGZipCrc32(void) {
 	;
 	startIndex -= 1;
 	stopIndex -= 1;
-	for (i = startIndex; i <= stopIndex; i += 1) {
-		crc = (zipCrcTable[(crc ^ (bytePtr[i])) & 255]) ^ (((usqInt) crc) >> 8);
-	}
+	crc = zipUpdateCrc32(crc, bytePtr + startIndex, (stopIndex - startIndex) + 1);
 	interpreterProxy->pop(5);
 	interpreterProxy->push(interpreterProxy->positive32BitIntegerFor(crc));
 }
@@ -1233,6 +1220,249 @@ l7:	/* end sendBlock:with:with:with: */;
 }
 
 
+/*	Primitive. Create a compression (inflating = false) or decompression
+	stream for the given level (0-9) and format (0 raw deflate, 1 zlib,
+	2 gzip). Answer its handle. */
+
+EXPORT(sqInt)
+primitiveZipStreamCreate(void) {
+    sqInt format;
+    sqInt handle;
+    sqInt inflating;
+    sqInt level;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 3)) {
+		return interpreterProxy->primitiveFail();
+	}
+	format = interpreterProxy->stackIntegerValue(0);
+	level = interpreterProxy->stackIntegerValue(1);
+	inflating = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(2));
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	handle = zipStreamCreate(inflating, level, format);
+	if (handle < 0) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(4);
+	return interpreterProxy->pushInteger(handle);
+}
+
+
+/*	Primitive. Destroy the given stream. A whole buffer job still running
+	on it is abandoned and its semaphore is not signalled. */
+
+EXPORT(sqInt)
+primitiveZipStreamDestroy(void) {
+    sqInt handle;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	handle = zipStreamHandleAt(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	zipStreamDestroy(handle);
+	interpreterProxy->pop(1);
+}
+
+
+/*	Primitive. Run the bytes from srcStart to srcStop of the source through
+	the given stream, writing output into the destination from dstStart on.
+	If finish is true this is the last of the input. Answer an Array of
+	the stream status (0 more to come, 1 done, -1 error), the number of
+	source bytes consumed and the number of destination bytes written.
+	Fewer source bytes are consumed if the destination fills up. */
+
+EXPORT(sqInt)
+primitiveZipStreamProcess(void) {
+    unsigned char *dst;
+    sqInt dstOop;
+    sqInt dstSize;
+    sqInt dstStart;
+    sqInt finish;
+    sqInt handle;
+    int inUsed;
+    int outUsed;
+    sqInt result;
+    unsigned char *src;
+    sqInt srcOop;
+    sqInt srcStart;
+    sqInt srcStop;
+    sqInt status;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 7)) {
+		return interpreterProxy->primitiveFail();
+	}
+	finish = interpreterProxy->booleanValueOf(interpreterProxy->stackValue(0));
+	dstStart = interpreterProxy->stackIntegerValue(1);
+	dstOop = interpreterProxy->stackObjectValue(2);
+	srcStop = interpreterProxy->stackIntegerValue(3);
+	srcStart = interpreterProxy->stackIntegerValue(4);
+	srcOop = interpreterProxy->stackObjectValue(5);
+	handle = zipStreamHandleAt(6);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isBytes(srcOop))
+		 && (interpreterProxy->isBytes(dstOop)))) {
+		return interpreterProxy->primitiveFail();
+	}
+	dstSize = interpreterProxy->byteSizeOf(dstOop);
+	if (!((srcStart >= 1)
+		 && ((srcStop >= (srcStart - 1))
+ && ((srcStop <= (interpreterProxy->byteSizeOf(srcOop)))
+ && ((dstStart >= 1)
+ && (dstStart <= (dstSize + 1))))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	src = interpreterProxy->firstIndexableField(srcOop);
+	dst = interpreterProxy->firstIndexableField(dstOop);
+	status = zipStreamProcess(handle, src + (srcStart - 1), (srcStop - srcStart) + 1, &inUsed, dst + (dstStart - 1), (dstSize - dstStart) + 1, &outUsed, finish);
+	result = interpreterProxy->instantiateClassindexableSize(interpreterProxy->classArray(), 3);
+	interpreterProxy->storeIntegerofObjectwithValue(0, result, status);
+	interpreterProxy->storeIntegerofObjectwithValue(1, result, inUsed);
+	interpreterProxy->storeIntegerofObjectwithValue(2, result, outUsed);
+	interpreterProxy->pop(8);
+	return interpreterProxy->push(result);
+}
+
+
+/*	Primitive. Copy the result of the last whole buffer job on the given
+	stream into the argument, which must be large enough, and release it.
+	Answer the number of bytes copied. */
+
+EXPORT(sqInt)
+primitiveZipStreamResultInto(void) {
+    sqInt dstOop;
+    sqInt handle;
+    sqInt size;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 2)) {
+		return interpreterProxy->primitiveFail();
+	}
+	dstOop = interpreterProxy->stackObjectValue(0);
+	handle = zipStreamHandleAt(1);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!(interpreterProxy->isBytes(dstOop))) {
+		return interpreterProxy->primitiveFail();
+	}
+	size = zipStreamResultCopy(handle, interpreterProxy->firstIndexableField(dstOop), interpreterProxy->byteSizeOf(dstOop));
+	if (size < 0) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(3);
+	return interpreterProxy->pushInteger(size);
+}
+
+
+/*	Primitive. Answer the size of the result of the last whole buffer job
+	on the given stream, -1 if it is still running or -2 if it failed. */
+
+EXPORT(sqInt)
+primitiveZipStreamResultSize(void) {
+    sqInt handle;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 1)) {
+		return interpreterProxy->primitiveFail();
+	}
+	handle = zipStreamHandleAt(0);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	interpreterProxy->pop(2);
+	return interpreterProxy->pushInteger(zipStreamResultSize(handle));
+}
+
+
+/*	Primitive. Start compressing or decompressing the bytes from startIndex
+	to stopIndex of the argument as one complete stream. The bytes are
+	copied, so the argument may change afterwards. Large inputs are
+	processed on a worker thread; in any case the semaphore with the given
+	index is signalled when the result is ready. */
+
+EXPORT(sqInt)
+primitiveZipStreamStart(void) {
+    unsigned char *bytePtr;
+    sqInt collection;
+    sqInt handle;
+    sqInt semaIndex;
+    sqInt startIndex;
+    sqInt stopIndex;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 5)) {
+		return interpreterProxy->primitiveFail();
+	}
+	semaIndex = interpreterProxy->stackIntegerValue(0);
+	stopIndex = interpreterProxy->stackIntegerValue(1);
+	startIndex = interpreterProxy->stackIntegerValue(2);
+	collection = interpreterProxy->stackObjectValue(3);
+	handle = zipStreamHandleAt(4);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isBytes(collection))
+		 && ((startIndex >= 1)
+ && ((stopIndex >= (startIndex - 1))
+ && (stopIndex <= (interpreterProxy->byteSizeOf(collection))))))) {
+		return interpreterProxy->primitiveFail();
+	}
+	bytePtr = interpreterProxy->firstIndexableField(collection);
+	if (!(zipStreamStart(handle, bytePtr + (startIndex - 1), (stopIndex - startIndex) + 1, semaIndex))) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(5);
+}
+
+
+/*	Primitive. Like primitiveZipStreamStart, but read length bytes of the
+	named file from offset on, or all of the rest if length is negative.
+	The file is always read on a worker thread. */
+
+EXPORT(sqInt)
+primitiveZipStreamStartFile(void) {
+    sqInt handle;
+    sqLong length;
+    char *nameIndex;
+    sqInt nameOop;
+    sqInt nameSize;
+    sqLong offset;
+    sqInt okToOpen;
+    sqInt semaIndex;
+
+	if (!((interpreterProxy->methodArgumentCount()) == 5)) {
+		return interpreterProxy->primitiveFail();
+	}
+	semaIndex = interpreterProxy->stackIntegerValue(0);
+	length = interpreterProxy->signed64BitValueOf(interpreterProxy->stackValue(1));
+	offset = interpreterProxy->signed64BitValueOf(interpreterProxy->stackValue(2));
+	nameOop = interpreterProxy->stackObjectValue(3);
+	handle = zipStreamHandleAt(4);
+	if (interpreterProxy->failed()) {
+		return null;
+	}
+	if (!((interpreterProxy->isBytes(nameOop))
+		 && (offset >= 0))) {
+		return interpreterProxy->primitiveFail();
+	}
+	nameIndex = interpreterProxy->firstIndexableField(nameOop);
+	nameSize = interpreterProxy->byteSizeOf(nameOop);
+	if (sCOFfn != 0) {
+		okToOpen = ((sqInt (*) (char *, sqInt, sqInt)) sCOFfn)(nameIndex, nameSize, 0);
+		if (!(okToOpen)) {
+			return interpreterProxy->primitiveFail();
+		}
+	}
+	if (!(zipStreamStartFile(handle, nameIndex, nameSize, offset, length, semaIndex))) {
+		return interpreterProxy->primitiveFail();
+	}
+	interpreterProxy->pop(5);
+}
+
+
 /*	Require: 
 	zipCollection, zipCollectionSize, zipPosition,
 	zipBitBuf, zipBitPos.
@@ -1507,6 +1737,11 @@ shouldFlush(void) {
 	return (nLits * 4) <= zipMatchCount;
 }
 
+EXPORT(sqInt)
+shutdownModule(void) {
+	return zipStreamShutdown();
+}
+
 
 /*	Update the hash value at position here (one based) */
 
@@ -1668,17 +1903,45 @@ zipNextBits(sqInt n) {
 }
 
 
+/*	Answer the stream handle at the given stack offset, failing the
+	primitive if it does not name a live stream. */
+
+static sqInt
+zipStreamHandleAt(sqInt index) {
+    sqInt handle;
+
+	handle = interpreterProxy->stackIntegerValue(index);
+	if (interpreterProxy->failed()) {
+		return 0;
+	}
+	if (!(zipStreamIsValid(handle))) {
+		interpreterProxy->primitiveFail();
+		return 0;
+	}
+	return handle;
+}
+
+
 #ifdef SQUEAK_BUILTIN_PLUGIN
 
 void* ZipPlugin_exports[][3] = {
 	{"ZipPlugin", "getModuleName", (void*)getModuleName},
+	{"ZipPlugin", "initialiseModule", (void*)initialiseModule},
 	{"ZipPlugin", "primitiveDeflateBlock", (void*)primitiveDeflateBlock},
 	{"ZipPlugin", "primitiveDeflateUpdateHashTable", (void*)primitiveDeflateUpdateHashTable},
 	{"ZipPlugin", "primitiveInflateDecompressBlock", (void*)primitiveInflateDecompressBlock},
 	{"ZipPlugin", "primitiveUpdateAdler32", (void*)primitiveUpdateAdler32},
 	{"ZipPlugin", "primitiveUpdateGZipCrc32", (void*)primitiveUpdateGZipCrc32},
 	{"ZipPlugin", "primitiveZipSendBlock", (void*)primitiveZipSendBlock},
+	{"ZipPlugin", "primitiveZipStreamCreate", (void*)primitiveZipStreamCreate},
+	{"ZipPlugin", "primitiveZipStreamDestroy", (void*)primitiveZipStreamDestroy},
+	{"ZipPlugin", "primitiveZipStreamProcess", (void*)primitiveZipStreamProcess},
+	{"ZipPlugin", "primitiveZipStreamResultInto", (void*)primitiveZipStreamResultInto},
+	{"ZipPlugin", "primitiveZipStreamResultSize", (void*)primitiveZipStreamResultSize},
+	{"ZipPlugin", "primitiveZipStreamStart", (void*)primitiveZipStreamStart},
+	{"ZipPlugin", "primitiveZipStreamStartFile", (void*)primitiveZipStreamStartFile},
 	{"ZipPlugin", "setInterpreter", (void*)setInterpreter},
+	{"ZipPlugin", "shutdownModule", (void*)shutdownModule},
 	{NULL, NULL, NULL}
 };
 